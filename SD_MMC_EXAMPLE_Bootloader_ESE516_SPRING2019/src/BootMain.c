@@ -20,6 +20,8 @@
 #include "SD Card/SdCard.h"
 #include "Systick/Systick.h"
 #include "SerialConsole/SerialConsole.h"
+#include "SerialUpload/SerialUpload.h"
+#include "ImageInstall/ImageInstall.h"
 #include "ASF/sam0/drivers/dsu/crc32/crc32.h"
 
 
@@ -32,6 +34,7 @@
 #define APP_START_ADDRESS  ((uint32_t)0x12000) ///<Start of main application. Must be address of start of main application
 #define APP_START_RESET_VEC_ADDRESS (APP_START_ADDRESS+(uint32_t)0x04) ///< Main application reset vector address
 #define MEM_EXAMPLE 1 //COMMENT ME TO REMOVE THE MEMORY WRITE EXAMPLE BELOW
+#define BOOT_CHECK_CACHED true ///<Trust the CRC-32 cached in the boot record. false hashes and checks the signature on every boot
 
 /******************************************************************************
 * Structures and Enumerations
@@ -44,9 +47,13 @@ struct usart_module cdc_uart_module; ///< Structure for UART module connected to
 ******************************************************************************/
 static int check_for_bootflag(void);
 static void copy_binary_file(int BOOTLOADER_FLAG);
+static bool install_binary_file(char *binFile);
+static void exitBootloader(void);
+static void checkApplication(void);
 static void jumpToApplication(void);
 static bool StartFilesystemAndTest(void);
 static void configure_nvm(void);
+static uint32_t getApplicationEndAddress(void);
 
 
 /******************************************************************************
@@ -84,10 +91,7 @@ int main(void)
 	/*1.) INIT SYSTEM PERIPHERALS INITIALIZATION*/
 	system_init();
 	delay_init();
-	InitializeSerialConsole();
 	system_interrupt_enable_global();
-	/* Initialize SD MMC stack */
-	sd_mmc_init();
 
 	//Initialize the NVM driver
 	configure_nvm();
@@ -98,10 +102,32 @@ int main(void)
 	//Configure CRC32
 	dsu_crc32_init();
 
+	//A host on the console UART can write the main application without an SD card. Runs before the console starts,
+	//as it uses the same SERCOM
+	enum eSerialUploadResult uploadResult = SerialUploadRun(APP_START_ADDRESS, getApplicationEndAddress(), SERIAL_UPLOAD_WAIT_MS);
+
+	InitializeSerialConsole();
+	/* Initialize SD MMC stack */
+	sd_mmc_init();
+
 	SerialConsoleWriteString("ESE516 - ENTER BOOTLOADER");	//Order to add string to TX Buffer
 
+	#ifdef IMAGE_INSTALL_BENCHMARK
+	ImageInstallBenchmark();
+	#endif
+
 	/*END SYSTEM PERIPHERALS INITIALIZATION*/
 
+	if(uploadResult == SERIAL_UPLOAD_DONE)
+	{
+		SerialConsoleWriteString("\r\nSerial upload done!\r\n");
+		exitBootloader();
+	}
+	else if(uploadResult == SERIAL_UPLOAD_FAILED)
+	{
+		SerialConsoleWriteString("\r\nSerial upload did not complete!\r\n");
+	}
+
 
 	/*2.) STARTS SIMPLE SD CARD MOUNTING AND TEST!*/
 
@@ -127,15 +153,7 @@ int main(void)
 	
 	#ifdef MEM_EXAMPLE
 			//4.) DEINITIALIZE HW AND JUMP TO MAIN APPLICATION!
-			SerialConsoleWriteString("ESE516 - EXIT BOOTLOADER");	//Order to add string to TX Buffer
-			delay_cycles_ms(100); //Delay to allow print
-		
-			//Deinitialize HW - deinitialize started HW here!
-			DeinitializeSerialConsole(); //Deinitializes UART
-			sd_mmc_deinit(); //Deinitialize SD CARD
-
-			//Jump to application
-			jumpToApplication();
+			exitBootloader();
 	#endif
 
 	//PERFORM BOOTLOADER HERE!
@@ -207,7 +225,7 @@ static int check_for_bootflag(void)
 /**************************************************************************//**
 * function      static void copy_binary_file(int BOOTLOADER_FLAG)
 * @brief        Copy the binary file in the SD card to the NVM
-* @details      Copy the indicated binary file on a row-by-row basis
+* @details      Installs the signed binary file named by the flag, then jumps to the application
 * @param        BOOTLOADER_FLAG: the flag indicates which binary file to load
 * @return  
 ******************************************************************************/
@@ -221,274 +239,96 @@ static void copy_binary_file(int BOOTLOADER_FLAG)
 	SerialConsoleWriteString(helpStr);
 	
 	if (BOOTLOADER_FLAG == 1)
-	{	
-		//Open the binary file in the SD card
-		BIN_FILE_A[0] = LUN_ID_SD_MMC_0_MEM + '0';
-		res = f_open(&file_object, (char const *)BIN_FILE_A, FA_READ);
-		if (res != FR_OK)
-		{
-			SerialConsoleWriteString("Could not open TestA.bin!\r\n");
-		}
-		//Debug output
-		SerialConsoleWriteString("TestA.bin Loaded\r\n");
-		
-		//Check the file size
-		res = f_stat((char const *)BIN_FILE_A, &fno);
-		int numSize = fno.fsize;
-		int numTotalRows = (numSize-1)/256 + 1;
-		//Debug output
-		//SerialConsoleWriteString("TestA.bin Size is: ");
-		//SerialConsoleWriteString("\r\n");
-		//SerialConsoleWriteString("TestA.bin Size in rows is: ");
-		//SerialConsoleWriteString("\r\n");
-		
-		//Write data to NVM in current row. Writes are per page, so we need four writes to write a complete row
-		uint32_t CURRENT_ROW_START_ADDRESS = APP_START_ADDRESS;
-		//ERASE-READ-WRITE the file in rows, in total row number of the file
-		for (int ROW = 0; ROW < numTotalRows ; ROW++)
-		{
-			//SerialConsoleWriteString("a");
-			//Erase the current row
-			enum status_code nvmError = nvm_erase_row(APP_START_ADDRESS + ROW * 256);
-			if(nvmError != STATUS_OK)
-			{
-				SerialConsoleWriteString("Erase error");
-			}
-			
-			//Advance the file pointer to current row			
-			f_lseek(&file_object, ROW * 256);
-			
-			uint8_t readBuffer[256]; //Buffer the size of one row
-			uint32_t numBytesRead = 0;
-			
-			int numBytesLeft = 256;
-			numBytesRead = 0;
-			int numberBytesTotal = 0;
-			//READ BINARY FILE INTO BUFFER by row
-			while(numBytesLeft != 0) 
-			{
-				res = f_read(&file_object, &readBuffer[numberBytesTotal], numBytesLeft, &numBytesRead); //Question to students: What is numBytesRead? What are we doing here?
-				numBytesLeft -= numBytesRead; 
-				numberBytesTotal += numBytesRead;
-				
-				if (ROW == (numTotalRows - 1) && numBytesRead == (numSize - ROW *256))
-				{
-					break;
-				}
-				
-			}
-			//Debug output
-			//SerialConsoleWriteString("Read a row \r\n");
+	{
+		install_binary_file(BIN_FILE_A);
+	} else if (BOOTLOADER_FLAG == 2)
+	{
+		install_binary_file(BIN_FILE_B);
+	}
 
-	
+	//4.) DEINITIALIZE HW AND JUMP TO MAIN APPLICATION!
+	exitBootloader();
+}
 
-			//Update current row start address pointer
-			CURRENT_ROW_START_ADDRESS = APP_START_ADDRESS + ROW * 256;
-			//Write buffer in one row
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS, &readBuffer[0], 64);
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS + 64, &readBuffer[64], 64);
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS + 128, &readBuffer[128], 64);
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS + 192, &readBuffer[192], 64);
-			//Debug output
-			if (res != FR_OK)
-			{
-				SerialConsoleWriteString("Test write to NVM failed!\r\n");
-			}
-			
-			//CRC of SD Card
-			uint32_t resultCrcSd = 0xFFFFFFFF;
-			*((volatile unsigned int*) 0x41007058) &= ~0x30000UL;
-			enum status_code crcres = dsu_crc32_cal	(readBuffer	,256, &resultCrcSd); //Instructor note: Was it the third parameter used for? Please check how you can use the third parameter to do the CRC of a long data stream in chunks - you will need it!
-			*((volatile unsigned int*) 0x41007058) |= 0x20000UL;
-			//CRC of memory (NVM)
-			uint32_t resultCrcNvm = 0xFFFFFFFF;
-			crcres |= dsu_crc32_cal	(CURRENT_ROW_START_ADDRESS,256, &resultCrcNvm);
-
-			//Check CRC
-			if (crcres != STATUS_OK)
-			{
-				SerialConsoleWriteString("Could not calculate CRC!!\r\n");
-			}
-			else
-			{
-				snprintf(helpStr, 63,"CRC SD CARD: %lu  CRC NVM: %lu \r\n", resultCrcNvm, resultCrcSd);
-				//SerialConsoleWriteString(helpStr);
-				if (resultCrcNvm != resultCrcSd)
-				{
-					snprintf(helpStr, 63,"Error Detected While Copying Row %d \r\n", ROW);
-					SerialConsoleWriteString(helpStr);
-				}
-				else
-				{
-					//SerialConsoleWriteString("Copy Verified! \r\n");
-				}
-			}
-		}
-		
-		//Close the file
-		res = f_lseek(&file_object, 0);
-		res = f_close(&file_object);
-		//Debug output
+
+/**************************************************************************//**
+* function      static bool install_binary_file(char *binFile)
+* @brief        Installs a signed binary file from the SD card into the NVM
+* @details      The file is made by tools/image_sign.py: the image in whole rows, then the signature trailer. The
+*				trailer is read first, so a file that is not signed leaves the application in place. The rows are then
+*				written in order through ImageInstall, which hashes them as they are written; the application only
+*				becomes bootable if the signature is valid. Otherwise its first row stays erased and jumpToApplication
+*				waits for a serial upload.
+* @param        binFile: name of the file, its drive number is set here
+* @return       Returns true if the new application is installed
+******************************************************************************/
+static bool install_binary_file(char *binFile)
+{
+	uint8_t readBuffer[IMAGE_INSTALL_ROW_SIZE]; //Buffer the size of one row
+	uint8_t trailer[IMAGE_INSTALL_TRAILER_SIZE];
+	uint32_t imageSize = 0;
+	UINT numBytesRead = 0;
+	enum eImageInstallStatus installStatus;
+	char helpStr[64]; //Used to help print values
+
+	//Open the binary file in the SD card
+	binFile[0] = LUN_ID_SD_MMC_0_MEM + '0';
+	res = f_open(&file_object, (char const *)binFile, FA_READ);
+	if (res != FR_OK)
+	{
+		SerialConsoleWriteString("Could not open the binary file!\r\n");
+		return false;
+	}
+
+	//Check the signature trailer before erasing anything
+	if (f_size(&file_object) >= IMAGE_INSTALL_TRAILER_SIZE)
+	{
+		res = f_lseek(&file_object, f_size(&file_object) - IMAGE_INSTALL_TRAILER_SIZE);
 		if (res == FR_OK)
 		{
-			SerialConsoleWriteString("TestA.bin Closed");
-		} else 
-		{
-			SerialConsoleWriteString("ERROR: TestA.bin Cannot be Closed");
+			res = f_read(&file_object, trailer, IMAGE_INSTALL_TRAILER_SIZE, &numBytesRead);
 		}
-		
-		//4.) DEINITIALIZE HW AND JUMP TO MAIN APPLICATION!
-		SerialConsoleWriteString("ESE516 - EXIT BOOTLOADER");	//Order to add string to TX Buffer
-		delay_cycles_ms(100); //Delay to allow print
-		
-		//Deinitialize HW - deinitialize started HW here!
-		DeinitializeSerialConsole(); //Deinitializes UART
-		sd_mmc_deinit(); //Deinitialize SD CARD
+	}
+	if (res != FR_OK || numBytesRead != IMAGE_INSTALL_TRAILER_SIZE || !ImageInstallCheckTrailer(trailer, f_size(&file_object), &imageSize))
+	{
+		SerialConsoleWriteString("The binary file is not signed! Sign it with tools/image_sign.py\r\n");
+		f_close(&file_object);
+		return false;
+	}
 
-		//Jump to application
-		jumpToApplication();
-		
-	} else if (BOOTLOADER_FLAG == 2)
-	{	
-		//Open the binary file in the SD card
-		BIN_FILE_B[0] = LUN_ID_SD_MMC_0_MEM + '0';
-		res = f_open(&file_object, (char const *)BIN_FILE_B, FA_READ);
-		if (res != FR_OK)
-		{
-			SerialConsoleWriteString("Could not open TestB.bin!\r\n");
-		}
-		//Debug output
-		SerialConsoleWriteString("TestB.bin Loaded\r\n");
-		
-		//Check the file size
-		res = f_stat((char const *)BIN_FILE_B, &fno);
-		int numSize = fno.fsize;
-		int numTotalRows = (numSize-1)/256 + 1;
-		//Debug output
-		SerialConsoleWriteString("TestB.bin Size is: ");
-		delay_cycles_ms(100); //Delay to allow print
-		SerialConsoleWriteString((char)numSize);
-		SerialConsoleWriteString("\r\n");
-		SerialConsoleWriteString("TestB.bin Size in rows is: ");
-		delay_cycles_ms(100); //Delay to allow print
-		SerialConsoleWriteString((char)numTotalRows);
-		SerialConsoleWriteString("\r\n");
-		
-		//Write data to NVM in current row. Writes are per page, so we need four writes to write a complete row
-		uint32_t CURRENT_ROW_START_ADDRESS = APP_START_ADDRESS;
-		//Read the file in rows, in total row number of the file
-		for (int ROW = 0; ROW < numTotalRows ; ROW++)
-		{
-			//Erase the current row
-			enum status_code nvmError = nvm_erase_row(APP_START_ADDRESS + ROW * 256);
-			if(nvmError != STATUS_OK)
-			{
-				SerialConsoleWriteString("Erase error");
-			}
-			
-			//Advance the file pointer to current row			
-			f_lseek(&file_object, ROW * 256);
-			
-			uint8_t readBuffer[256]; //Buffer the size of one row
-			uint32_t numBytesRead = 0;
-			
-			int numBytesLeft = 256;
-			numBytesRead = 0;
-			int numberBytesTotal = 0;
-			//READ BINARY FILE INTO BUFFER by row
-			while(numBytesLeft  != 0) 
-			{
-				res = f_read(&file_object, &readBuffer[numberBytesTotal], numBytesLeft, &numBytesRead); //Question to students: What is numBytesRead? What are we doing here?
-				numBytesLeft -= numBytesRead; 
-				numberBytesTotal += numBytesRead;
-				
-				if (ROW == (numTotalRows - 1) && numBytesRead == (numSize - ROW *256))
-				{
-					break;
-				}
-			}
-			//Debug output
-			//SerialConsoleWriteString("Read a row \r\n");
-
-			//Update current row start address pointer
-			CURRENT_ROW_START_ADDRESS = APP_START_ADDRESS + ROW * 256;
-			//Write buffer in one row
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS, &readBuffer[0], 64);
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS + 64, &readBuffer[64], 64);
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS + 128, &readBuffer[128], 64);
-			res = nvm_write_buffer (CURRENT_ROW_START_ADDRESS + 192, &readBuffer[192], 64);
-			//Debug output
-			if (res != FR_OK)
-			{
-				SerialConsoleWriteString("Test write to NVM failed!\r\n");
-			}
-
-			//CRC of SD Card
-			uint32_t resultCrcSd = 0xFFFFFFFF;
-			*((volatile unsigned int*) 0x41007058) &= ~0x30000UL;
-			enum status_code crcres = dsu_crc32_cal	(readBuffer	,256, &resultCrcSd); //Instructor note: Was it the third parameter used for? Please check how you can use the third parameter to do the CRC of a long data stream in chunks - you will need it!
-			*((volatile unsigned int*) 0x41007058) |= 0x20000UL;
-			
-			//CRC of memory (NVM)
-			uint32_t resultCrcNvm = 0xFFFFFFFF;
-			crcres |= dsu_crc32_cal	(CURRENT_ROW_START_ADDRESS,256, &resultCrcNvm);
-
-			//Check CRC
-			if (crcres != STATUS_OK)
-			{
-				SerialConsoleWriteString("Could not calculate CRC!!\r\n");
-			}
-			else
-			{
-				snprintf(helpStr, 63,"CRC SD CARD: %lu  CRC NVM: %lu \r\n", resultCrcNvm, resultCrcSd);
-				//SerialConsoleWriteString(helpStr);
-				if (resultCrcNvm != resultCrcSd)
-				{
-					snprintf(helpStr, 63,"Error Detected While Copying Row %d \r\n", ROW);
-					SerialConsoleWriteString(helpStr);
-				}
-				else
-				{
-					//SerialConsoleWriteString("Copy Verified! \r\n");
-				}
-			}
-		}
-		//Close the file
-		res = f_lseek(&file_object, 0);
-		res = f_close(&file_object);
-		//Debug output
-		if (res == FR_OK)
-		{
-			SerialConsoleWriteString("TestB.bin Closed");
-		} else 
+	installStatus = ImageInstallStart(APP_START_ADDRESS, getApplicationEndAddress(), imageSize);
+	snprintf(helpStr, 63,"Installing %lu bytes (%lu rows)\r\n", imageSize, imageSize / IMAGE_INSTALL_ROW_SIZE);
+	SerialConsoleWriteString(helpStr);
+
+	//Write the rows in order: each row is hashed as soon as it is in the flash
+	res = f_lseek(&file_object, 0);
+	for (uint16_t row = 0; installStatus == IMAGE_INSTALL_OK && row < imageSize / IMAGE_INSTALL_ROW_SIZE; row++)
+	{
+		res = f_read(&file_object, readBuffer, IMAGE_INSTALL_ROW_SIZE, &numBytesRead);
+		if (res != FR_OK || numBytesRead != IMAGE_INSTALL_ROW_SIZE)
 		{
-			SerialConsoleWriteString("ERROR: TestB.bin Cannot be Closed");
+			snprintf(helpStr, 63,"Could not read row %d of the binary file!\r\n", row);
+			SerialConsoleWriteString(helpStr);
+			installStatus = IMAGE_INSTALL_MISSING;
+			break;
 		}
-		
-		//4.) DEINITIALIZE HW AND JUMP TO MAIN APPLICATION!
-		SerialConsoleWriteString("ESE516 - EXIT BOOTLOADER \r\n");	//Order to add string to TX Buffer
-		delay_cycles_ms(100); //Delay to allow print
-		
-		//Deinitialize HW - deinitialize started HW here!
-		DeinitializeSerialConsole(); //Deinitializes UART
-		sd_mmc_deinit(); //Deinitialize SD CARD
+		installStatus = ImageInstallWriteRow(row, readBuffer);
+	}
+	f_close(&file_object);
 
-		//Jump to application
-		jumpToApplication();
-		
-	} else
+	if (installStatus == IMAGE_INSTALL_OK)
 	{
-		//4.) DEINITIALIZE HW AND JUMP TO MAIN APPLICATION!
-		SerialConsoleWriteString("ESE516 - EXIT BOOTLOADER \r\n");	//Order to add string to TX Buffer
-		delay_cycles_ms(100); //Delay to allow print
-		
-		//Deinitialize HW - deinitialize started HW here!
-		DeinitializeSerialConsole(); //Deinitializes UART
-		sd_mmc_deinit(); //Deinitialize SD CARD
+		installStatus = ImageInstallFinish(&trailer[IMAGE_INSTALL_SIGNATURE_OFFSET]);
+	}
 
-		//Jump to application
-		jumpToApplication();
+	switch (installStatus)
+	{
+		case IMAGE_INSTALL_OK:				SerialConsoleWriteString("Signature valid. New application installed!\r\n"); break;
+		case IMAGE_INSTALL_BAD_SIGNATURE:	SerialConsoleWriteString("ERROR: Signature invalid! The application was erased.\r\n"); break;
+		case IMAGE_INSTALL_BAD_ARG:			SerialConsoleWriteString("ERROR: The image does not fit in the application region!\r\n"); break;
+		default:							SerialConsoleWriteString("ERROR: Could not write the application! It was erased.\r\n"); break;
 	}
+	return installStatus == IMAGE_INSTALL_OK;
 }
 
 
@@ -605,6 +445,92 @@ static bool StartFilesystemAndTest(void)
 
 
 
+/**************************************************************************//**
+* function      static void exitBootloader(void)
+* @brief        Checks the main application, deinitializes the hardware and jumps to it
+* @return       
+******************************************************************************/
+static void exitBootloader(void)
+{
+	checkApplication();
+
+	SerialConsoleWriteString("ESE516 - EXIT BOOTLOADER \r\n");	//Order to add string to TX Buffer
+	delay_cycles_ms(100); //Delay to allow print
+
+	//Deinitialize HW - deinitialize started HW here!
+	DeinitializeSerialConsole(); //Deinitializes UART
+	sd_mmc_deinit(); //Deinitialize SD CARD
+
+	//Jump to application
+	jumpToApplication();
+}
+
+
+
+/**************************************************************************//**
+* function      static void checkApplication(void)
+* @brief        Checks the main application against its boot record and prints how long the check took
+* @details      See ImageInstall.h. An application that fails the check gets its first row erased, so
+*				jumpToApplication waits for a serial upload instead of starting it. An application without a boot
+*				record, e.g. one written by the debugger, is started with a warning.
+*				With IMAGE_INSTALL_BENCHMARK the full check is also timed, to compare boot times with and without
+*				the cache.
+* @return       
+******************************************************************************/
+static void checkApplication(void)
+{
+	enum eImageCheckResult checkResult;
+	uint32_t version = 0;
+	uint32_t cycles;
+	uint32_t cyclesPerUs = system_gclk_gen_get_hz(GCLK_GENERATOR_0) / 1000000;
+	char helpStr[64]; //Used to help print values
+	enum status_code nvmError;
+
+	if(*(uint32_t *) APP_START_ADDRESS == 0xFFFFFFFF) return; //No application, jumpToApplication waits for one
+
+	//Delays reprogram SysTick: none may run while it counts cycles
+	InitSystickCycleCounter();
+	cycles = GetSystickCycles();
+	checkResult = ImageInstallCheckApplication(APP_START_ADDRESS, getApplicationEndAddress(), BOOT_CHECK_CACHED, &version);
+	cycles = GetSystickCycles() - cycles;
+	DeinitSystick();
+	delay_init();
+
+	switch(checkResult)
+	{
+		case IMAGE_CHECK_CACHED:	snprintf(helpStr, 63, "Application %lu: cached CRC matches (%lu us)\r\n", version, cycles / cyclesPerUs); break;
+		case IMAGE_CHECK_VERIFIED:	snprintf(helpStr, 63, "Application %lu: signature verified (%lu us)\r\n", version, cycles / cyclesPerUs); break;
+		case IMAGE_CHECK_NO_RECORD:	snprintf(helpStr, 63, "WARNING: Application not installed by the bootloader!\r\n"); break;
+		default:					snprintf(helpStr, 63, "ERROR: Application %lu failed its check! Erasing it\r\n", version); break;
+	}
+	SerialConsoleWriteString(helpStr);
+
+	if(checkResult == IMAGE_CHECK_FAILED)
+	{
+		do
+		{
+			nvmError = nvm_erase_row(APP_START_ADDRESS);
+		} while(nvmError == STATUS_BUSY);
+		return;
+	}
+
+	#ifdef IMAGE_INSTALL_BENCHMARK
+	if(checkResult == IMAGE_CHECK_CACHED)
+	{
+		InitSystickCycleCounter();
+		cycles = GetSystickCycles();
+		checkResult = ImageInstallCheckApplication(APP_START_ADDRESS, getApplicationEndAddress(), false, &version);
+		cycles = GetSystickCycles() - cycles;
+		DeinitSystick();
+		delay_init();
+		snprintf(helpStr, 63, "Without the cache: %s (%lu us)\r\n", checkResult == IMAGE_CHECK_VERIFIED ? "verified" : "FAILED", cycles / cyclesPerUs);
+		SerialConsoleWriteString(helpStr);
+	}
+	#endif
+}
+
+
+
 /**************************************************************************//**
 * function      static void jumpToApplication(void)
 * @brief        Jumps to main application
@@ -614,6 +540,13 @@ static bool StartFilesystemAndTest(void)
 ******************************************************************************/
 static void jumpToApplication(void)
 {
+// A serial upload that did not complete leaves the first row erased. Wait for the host to finish it instead of
+// jumping to erased flash. The console is already deinitialized by the callers
+while(*(uint32_t *) APP_START_ADDRESS == 0xFFFFFFFF)
+{
+	SerialUploadRun(APP_START_ADDRESS, getApplicationEndAddress(), SERIAL_UPLOAD_WAIT_FOREVER);
+}
+
 // Function pointer to application section
 void (*applicationCodeEntry)(void);
 
@@ -649,4 +582,19 @@ static void configure_nvm(void)
 }
 
 
+/**************************************************************************//**
+* function      static uint32_t getApplicationEndAddress(void)
+* @brief        Returns the address after the last row the main application may use
+* @details      The application runs up to the end of the flash, minus the EEPROM emulation area set by the fuses and
+*				the row before it, which holds the boot record (ImageInstall.h)
+* @return       End address of the application region, and address of the boot record
+******************************************************************************/
+static uint32_t getApplicationEndAddress(void)
+{
+	struct nvm_parameters parameters;
+	nvm_get_parameters(&parameters);
+	return (parameters.nvm_number_of_pages - parameters.eeprom_number_of_pages) * (uint32_t) parameters.page_size - IMAGE_INSTALL_ROW_SIZE;
+}
+
+
 
@@ -0,0 +1,725 @@
+/**************************************************************************//**
+* @file      Ed25519.c
+* @brief     Ed25519 signature verification (RFC 8032). Verification only: the bootloader never holds a private key.
+* @details   Field elements mod 2^255 - 19 are 16 limbs of 16 bits held in 32-bit words. Every limb product then fits
+*			the single cycle 32x32 multiplier of the Cortex-M0+, and only the column sums need 64-bit additions; the
+*			libgcc 64-bit multiply is never called in the field arithmetic. Multiplications accumulate by column and
+*			fold the upper half (2^256 = 38) as they go.
+*			[S]B - [k]A is computed in one pass of doublings (Shamir's trick), with extended coordinates.
+*			Verification only handles public data, so nothing here tries to run in constant time.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "Crypto/Ed25519.h"
+#include <string.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define SHA512_BLOCK_SIZE	128	///<Bytes compressed at a time by SHA-512
+#define SHA512_DIGEST_SIZE	64	///<Bytes of a SHA-512 digest
+
+#define ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+typedef uint32_t Fe[16];	///<Field element, 16 limbs of 16 bits, least significant first
+
+//Point in extended coordinates: x = X/Z, y = Y/Z, x * y = T/Z
+typedef struct Ed25519Point
+{
+	Fe x;
+	Fe y;
+	Fe z;
+	Fe t;
+} Ed25519Point;
+
+//SHA-512 of the message, for the challenge k = SHA-512(R || A || M)
+typedef struct Sha512Context
+{
+	uint64_t state[8];
+	uint32_t length;
+	uint8_t block[SHA512_BLOCK_SIZE];
+	uint8_t blockLen;
+} Sha512Context;
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static const Fe feZero = {0};
+static const Fe feOne = {1};
+static const Fe feP = {0xffed, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff,
+						0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0x7fff};	///<2^255 - 19
+static const Fe fe4P = {0x3ffb4, 0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc,
+						0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc, 0x3fffc, 0x1fffc};	///<4p, added before subtracting
+static const Fe feD = {0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070,
+						0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203};	///<d = -121665/121666
+static const Fe feD2 = {0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0,
+						0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406};	///<2d
+static const Fe feSqrtM1 = {0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43,
+						0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83};	///<sqrt(-1)
+
+static const Ed25519Point ed25519Base = {	///<Base point B
+	{0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c, 0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169},
+	{0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666},
+	{1},
+	{0xdda3, 0xa5b7, 0x8ab3, 0x6dde, 0x52f5, 0x7751, 0x9f80, 0x20f0, 0xe37d, 0x64ab, 0x4e8e, 0x66ea, 0x7665, 0xd78b, 0x5f0f, 0x6787}
+};
+
+static const uint8_t ed25519L[32] = {	///<Group order L = 2^252 + 27742317777372353535851937790883648493, little endian
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+static const uint64_t sha512K[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static void FeCarry(Fe o);
+static void FeAdd(Fe o, const Fe a, const Fe b);
+static void FeSub(Fe o, const Fe a, const Fe b);
+static void FeMul(Fe o, const Fe a, const Fe b);
+static void FeSqN(Fe o, const Fe a, uint8_t n);
+static void FeInvert(Fe o, const Fe z);
+static void FePow2523(Fe o, const Fe z);
+static void FePack(uint8_t out[32], const Fe a);
+static void FeUnpack(Fe o, const uint8_t in[32]);
+static bool FeEqual(const Fe a, const Fe b);
+static uint8_t FeParity(const Fe a);
+static void PointAdd(Ed25519Point *r, const Ed25519Point *p, const Ed25519Point *q);
+static void PointDouble(Ed25519Point *r, const Ed25519Point *p);
+static bool PointDecodeNegate(Ed25519Point *r, const uint8_t in[32]);
+static void PointEncode(uint8_t out[32], const Ed25519Point *p);
+static void PointDoubleScalarMult(Ed25519Point *r, const uint8_t s[32], const uint8_t k[32], const Ed25519Point *a);
+static bool ScalarIsReduced(const uint8_t s[32]);
+static void ScalarReduce(uint8_t r[32], const uint8_t in[64]);
+static void Sha512Init(Sha512Context *ctx);
+static void Sha512Update(Sha512Context *ctx, const uint8_t *data, size_t len);
+static void Sha512Final(Sha512Context *ctx, uint8_t digest[SHA512_DIGEST_SIZE]);
+static void Sha512Compress(uint64_t state[8], const uint8_t *block);
+
+/******************************************************************************
+* Local Functions - field arithmetic
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void FeCarry(Fe o)
+* @brief	Brings every limb below 2^16. Limbs may be up to 2^31 on entry.
+*****************************************************************************/
+static void FeCarry(Fe o)
+{
+	uint32_t c;
+
+	do
+	{
+		c = 0;
+		for(uint8_t i = 0; i < 16; i++)
+		{
+			o[i] += c;
+			c = o[i] >> 16;
+			o[i] &= 0xFFFF;
+		}
+		o[0] += 38 * c; //2^256 = 38 mod p
+	} while(c != 0);
+}
+
+/**************************************************************************//**
+* @fn		static void FeAdd(Fe o, const Fe a, const Fe b)
+* @brief	o = a + b
+*****************************************************************************/
+static void FeAdd(Fe o, const Fe a, const Fe b)
+{
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		o[i] = a[i] + b[i];
+	}
+	FeCarry(o);
+}
+
+/**************************************************************************//**
+* @fn		static void FeSub(Fe o, const Fe a, const Fe b)
+* @brief	o = a - b, computed as a + 4p - b so no limb goes negative
+*****************************************************************************/
+static void FeSub(Fe o, const Fe a, const Fe b)
+{
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		o[i] = a[i] + fe4P[i] - b[i];
+	}
+	FeCarry(o);
+}
+
+/**************************************************************************//**
+* @fn		static void FeMul(Fe o, const Fe a, const Fe b)
+* @brief	o = a * b. o may be a or b.
+* @details	Column k of the result gets the products of column k and 38 times those of column k + 16. A column
+*			holds at most 16 products below 2^32, so the sums fit 64 bits with room for the carry.
+*****************************************************************************/
+static void FeMul(Fe o, const Fe a, const Fe b)
+{
+	Fe r;
+	uint64_t carry = 0;
+
+	for(uint8_t k = 0; k < 16; k++)
+	{
+		uint64_t low = 0, high = 0;
+		for(uint8_t i = 0; i <= k; i++)
+		{
+			low += a[i] * b[k - i];
+		}
+		for(uint8_t i = k + 1; i < 16; i++)
+		{
+			high += a[i] * b[k + 16 - i];
+		}
+		carry += low + 38 * high;
+		r[k] = (uint32_t) carry & 0xFFFF;
+		carry >>= 16;
+	}
+	r[0] += 38 * (uint32_t) carry;
+	FeCarry(r);
+	memcpy(o, r, sizeof(Fe));
+}
+
+/**************************************************************************//**
+* @fn		static void FeSqN(Fe o, const Fe a, uint8_t n)
+* @brief	o = a^(2^n), n >= 1
+*****************************************************************************/
+static void FeSqN(Fe o, const Fe a, uint8_t n)
+{
+	FeMul(o, a, a);
+	while(--n)
+	{
+		FeMul(o, o, o);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void FeInvert(Fe o, const Fe z)
+* @brief	o = 1/z = z^(p - 2), with 254 squarings and 11 multiplications
+*****************************************************************************/
+static void FeInvert(Fe o, const Fe z)
+{
+	Fe t0, t1, t2, t3;
+
+	FeMul(t0, z, z);		//z^2
+	FeSqN(t1, t0, 2);		//z^8
+	FeMul(t1, z, t1);		//z^9
+	FeMul(t0, t0, t1);		//z^11
+	FeMul(t2, t0, t0);		//z^22
+	FeMul(t1, t1, t2);		//z^(2^5 - 1)
+	FeSqN(t2, t1, 5);
+	FeMul(t1, t2, t1);		//z^(2^10 - 1)
+	FeSqN(t2, t1, 10);
+	FeMul(t2, t2, t1);		//z^(2^20 - 1)
+	FeSqN(t3, t2, 20);
+	FeMul(t2, t3, t2);		//z^(2^40 - 1)
+	FeSqN(t2, t2, 10);
+	FeMul(t1, t2, t1);		//z^(2^50 - 1)
+	FeSqN(t2, t1, 50);
+	FeMul(t2, t2, t1);		//z^(2^100 - 1)
+	FeSqN(t3, t2, 100);
+	FeMul(t2, t3, t2);		//z^(2^200 - 1)
+	FeSqN(t2, t2, 50);
+	FeMul(t1, t2, t1);		//z^(2^250 - 1)
+	FeSqN(t1, t1, 5);		//z^(2^255 - 32)
+	FeMul(o, t1, t0);		//z^(2^255 - 21)
+}
+
+/**************************************************************************//**
+* @fn		static void FePow2523(Fe o, const Fe z)
+* @brief	o = z^((p - 5) / 8) = z^(2^252 - 3), used for the square root when decoding a point
+*****************************************************************************/
+static void FePow2523(Fe o, const Fe z)
+{
+	Fe t0, t1, t2;
+
+	FeMul(t0, z, z);		//z^2
+	FeSqN(t1, t0, 2);		//z^8
+	FeMul(t1, z, t1);		//z^9
+	FeMul(t0, t0, t1);		//z^11
+	FeMul(t0, t0, t0);		//z^22
+	FeMul(t0, t1, t0);		//z^(2^5 - 1)
+	FeSqN(t1, t0, 5);
+	FeMul(t0, t1, t0);		//z^(2^10 - 1)
+	FeSqN(t1, t0, 10);
+	FeMul(t1, t1, t0);		//z^(2^20 - 1)
+	FeSqN(t2, t1, 20);
+	FeMul(t1, t2, t1);		//z^(2^40 - 1)
+	FeSqN(t1, t1, 10);
+	FeMul(t0, t1, t0);		//z^(2^50 - 1)
+	FeSqN(t1, t0, 50);
+	FeMul(t1, t1, t0);		//z^(2^100 - 1)
+	FeSqN(t2, t1, 100);
+	FeMul(t1, t2, t1);		//z^(2^200 - 1)
+	FeSqN(t1, t1, 50);
+	FeMul(t0, t1, t0);		//z^(2^250 - 1)
+	FeSqN(t0, t0, 2);		//z^(2^252 - 4)
+	FeMul(o, t0, z);		//z^(2^252 - 3)
+}
+
+/**************************************************************************//**
+* @fn		static void FePack(uint8_t out[32], const Fe a)
+* @brief	Writes the canonical encoding of a, little endian
+*****************************************************************************/
+static void FePack(uint8_t out[32], const Fe a)
+{
+	Fe t, m;
+
+	memcpy(t, a, sizeof(Fe));
+	FeCarry(t);
+	//t is below 2^256 < 3p: two conditional subtractions of p make it canonical
+	for(uint8_t pass = 0; pass < 2; pass++)
+	{
+		int32_t borrow = 0;
+		for(uint8_t i = 0; i < 16; i++)
+		{
+			int32_t v = (int32_t) t[i] - (int32_t) feP[i] - borrow;
+			borrow = (v < 0);
+			m[i] = (uint32_t) v & 0xFFFF;
+		}
+		if(!borrow) memcpy(t, m, sizeof(Fe));
+	}
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		out[2 * i] = (uint8_t) t[i];
+		out[2 * i + 1] = (uint8_t)(t[i] >> 8);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void FeUnpack(Fe o, const uint8_t in[32])
+* @brief	Reads a little endian field element, ignoring bit 255
+*****************************************************************************/
+static void FeUnpack(Fe o, const uint8_t in[32])
+{
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		o[i] = in[2 * i] | ((uint32_t) in[2 * i + 1] << 8);
+	}
+	o[15] &= 0x7FFF;
+}
+
+/**************************************************************************//**
+* @fn		static bool FeEqual(const Fe a, const Fe b)
+* @brief	Compares two field elements by their canonical encodings
+*****************************************************************************/
+static bool FeEqual(const Fe a, const Fe b)
+{
+	uint8_t packedA[32], packedB[32];
+
+	FePack(packedA, a);
+	FePack(packedB, b);
+	return memcmp(packedA, packedB, 32) == 0;
+}
+
+/**************************************************************************//**
+* @fn		static uint8_t FeParity(const Fe a)
+* @brief	Returns the lowest bit of the canonical value of a: the sign of x in an encoded point
+*****************************************************************************/
+static uint8_t FeParity(const Fe a)
+{
+	uint8_t packed[32];
+
+	FePack(packed, a);
+	return packed[0] & 1;
+}
+
+/******************************************************************************
+* Local Functions - points and scalars
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void PointAdd(Ed25519Point *r, const Ed25519Point *p, const Ed25519Point *q)
+* @brief	r = p + q (add-2008-hwcd-3, 9 multiplications). r may be p or q.
+*****************************************************************************/
+static void PointAdd(Ed25519Point *r, const Ed25519Point *p, const Ed25519Point *q)
+{
+	Fe a, b, c, d, t;
+
+	FeSub(a, p->y, p->x);
+	FeSub(t, q->y, q->x);
+	FeMul(a, a, t);			//A = (Y1 - X1) * (Y2 - X2)
+	FeAdd(b, p->y, p->x);
+	FeAdd(t, q->y, q->x);
+	FeMul(b, b, t);			//B = (Y1 + X1) * (Y2 + X2)
+	FeMul(c, p->t, q->t);
+	FeMul(c, c, feD2);		//C = 2d * T1 * T2
+	FeMul(d, p->z, q->z);
+	FeAdd(d, d, d);			//D = 2 * Z1 * Z2
+
+	FeSub(t, b, a);			//E = B - A
+	FeAdd(b, b, a);			//H = B + A
+	FeSub(a, d, c);			//F = D - C
+	FeAdd(d, d, c);			//G = D + C
+	FeMul(r->x, t, a);		//X3 = E * F
+	FeMul(r->y, b, d);		//Y3 = H * G
+	FeMul(r->z, d, a);		//Z3 = G * F
+	FeMul(r->t, t, b);		//T3 = E * H
+}
+
+/**************************************************************************//**
+* @fn		static void PointDouble(Ed25519Point *r, const Ed25519Point *p)
+* @brief	r = 2p (dbl-2008-hwcd, 4 squarings and 4 multiplications). r may be p.
+* @details	F is computed negated; that negates all four output coordinates, which is the same projective point.
+*****************************************************************************/
+static void PointDouble(Ed25519Point *r, const Ed25519Point *p)
+{
+	Fe a, b, c, e, g;
+
+	FeMul(a, p->x, p->x);	//A = X1^2
+	FeMul(b, p->y, p->y);	//B = Y1^2
+	FeMul(c, p->z, p->z);
+	FeAdd(c, c, c);			//C = 2 * Z1^2
+	FeAdd(e, p->x, p->y);
+	FeMul(e, e, e);
+	FeSub(e, e, a);
+	FeSub(e, e, b);			//E = (X1 + Y1)^2 - A - B
+	FeSub(g, b, a);			//G = B - A
+	FeAdd(a, a, b);			//-H = A + B
+	FeSub(c, c, g);			//-F = C - G
+	FeMul(r->x, e, c);		//-X3 = E * -F
+	FeMul(r->y, g, a);		//-Y3 = G * -H
+	FeMul(r->t, e, a);		//-T3 = E * -H
+	FeMul(r->z, c, g);		//-Z3 = -F * G
+}
+
+/**************************************************************************//**
+* @fn		static bool PointDecodeNegate(Ed25519Point *r, const uint8_t in[32])
+* @brief	Decodes a point and negates it, so the verification only needs additions
+* @details	x is recovered from y as sqrt((y^2 - 1) / (d y^2 + 1)), with a single exponentiation that also does the
+*			division (RFC 8032 section 5.1.3).
+* @return	false if in is not the canonical encoding of a point on the curve
+*****************************************************************************/
+static bool PointDecodeNegate(Ed25519Point *r, const uint8_t in[32])
+{
+	Fe num, den, t, check;
+	uint8_t packed[32];
+	uint8_t sign = in[31] >> 7;
+
+	FeUnpack(r->y, in);
+	FePack(packed, r->y);
+	if(memcmp(packed, in, 31) != 0 || packed[31] != (in[31] & 0x7F)) return false; //y >= p
+	memcpy(r->z, feOne, sizeof(Fe));
+
+	FeMul(num, r->y, r->y);
+	FeMul(den, num, feD);
+	FeSub(num, num, feOne);		//u = y^2 - 1
+	FeAdd(den, den, feOne);		//v = d y^2 + 1
+
+	FeMul(t, den, den);
+	FeMul(t, t, den);			//v^3
+	FeMul(r->x, t, num);		//u v^3
+	FeMul(t, t, t);
+	FeMul(t, t, den);
+	FeMul(t, t, num);			//u v^7
+	FePow2523(t, t);
+	FeMul(r->x, r->x, t);		//x = u v^3 (u v^7)^((p - 5) / 8)
+
+	FeMul(check, r->x, r->x);
+	FeMul(check, check, den);
+	if(!FeEqual(check, num))
+	{
+		FeMul(r->x, r->x, feSqrtM1);
+		FeMul(check, r->x, r->x);
+		FeMul(check, check, den);
+		if(!FeEqual(check, num)) return false; //Not on the curve
+	}
+
+	if(sign && FeEqual(r->x, feZero)) return false; //-0 is not a valid encoding
+	if(FeParity(r->x) == sign)
+	{
+		FeSub(r->x, feZero, r->x); //Negated: the parity of -x is the opposite of the sign bit
+	}
+	FeMul(r->t, r->x, r->y);
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		static void PointEncode(uint8_t out[32], const Ed25519Point *p)
+* @brief	Encodes a point: y, with the parity of x in bit 255
+*****************************************************************************/
+static void PointEncode(uint8_t out[32], const Ed25519Point *p)
+{
+	Fe zInv, x, y;
+
+	FeInvert(zInv, p->z);
+	FeMul(x, p->x, zInv);
+	FeMul(y, p->y, zInv);
+	FePack(out, y);
+	out[31] ^= FeParity(x) << 7;
+}
+
+/**************************************************************************//**
+* @fn		static void PointDoubleScalarMult(Ed25519Point *r, const uint8_t s[32], const uint8_t k[32], const Ed25519Point *a)
+* @brief	r = [s]B + [k]a, both scalars below 2^253
+* @details	Both products share the 253 doublings; each bit adds B, a or the precomputed B + a.
+*****************************************************************************/
+static void PointDoubleScalarMult(Ed25519Point *r, const uint8_t s[32], const uint8_t k[32], const Ed25519Point *a)
+{
+	Ed25519Point sum;
+
+	PointAdd(&sum, &ed25519Base, a);
+
+	memcpy(r->x, feZero, sizeof(Fe));
+	memcpy(r->y, feOne, sizeof(Fe));
+	memcpy(r->z, feOne, sizeof(Fe));
+	memcpy(r->t, feZero, sizeof(Fe));
+
+	for(int16_t i = 252; i >= 0; i--)
+	{
+		uint8_t sBit = (s[i >> 3] >> (i & 7)) & 1;
+		uint8_t kBit = (k[i >> 3] >> (i & 7)) & 1;
+
+		PointDouble(r, r);
+		if(sBit && kBit) PointAdd(r, r, &sum);
+		else if(sBit) PointAdd(r, r, &ed25519Base);
+		else if(kBit) PointAdd(r, r, a);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static bool ScalarIsReduced(const uint8_t s[32])
+* @brief	Returns true if s < L. RFC 8032 rejects signatures with a larger S, which would make them malleable.
+*****************************************************************************/
+static bool ScalarIsReduced(const uint8_t s[32])
+{
+	for(int8_t i = 31; i >= 0; i--)
+	{
+		if(s[i] < ed25519L[i]) return true;
+		if(s[i] > ed25519L[i]) return false;
+	}
+	return false; //s == L
+}
+
+/**************************************************************************//**
+* @fn		static void ScalarReduce(uint8_t r[32], const uint8_t in[64])
+* @brief	r = in mod L, for the 512-bit challenge hash
+* @details	Folds the top bytes down with 2^252 = -(L - 2^252) mod L, one byte at a time from the top, in signed
+*			64-bit limbs (TweetNaCl's modL). Runs once per verification.
+*****************************************************************************/
+static void ScalarReduce(uint8_t r[32], const uint8_t in[64])
+{
+	int64_t x[64];
+	int64_t carry;
+	uint8_t i, j;
+
+	for(i = 0; i < 64; i++)
+	{
+		x[i] = in[i];
+	}
+
+	for(i = 63; i >= 32; i--)
+	{
+		carry = 0;
+		for(j = i - 32; j < i - 12; j++)
+		{
+			x[j] += carry - 16 * x[i] * ed25519L[j - (i - 32)];
+			carry = (x[j] + 128) >> 8;
+			x[j] -= carry * 256;
+		}
+		x[j] += carry;
+		x[i] = 0;
+	}
+
+	carry = 0;
+	for(j = 0; j < 32; j++)
+	{
+		x[j] += carry - (x[31] >> 4) * ed25519L[j];
+		carry = x[j] >> 8;
+		x[j] &= 255;
+	}
+	for(j = 0; j < 32; j++)
+	{
+		x[j] -= carry * ed25519L[j];
+	}
+	for(i = 0; i < 32; i++)
+	{
+		x[i + 1] += x[i] >> 8;
+		r[i] = (uint8_t)(x[i] & 255);
+	}
+}
+
+/******************************************************************************
+* Local Functions - SHA-512
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void Sha512Compress(uint64_t state[8], const uint8_t *block)
+* @brief	Compresses one block of SHA512_BLOCK_SIZE bytes into state. The schedule is a ring of 16 words.
+*****************************************************************************/
+static void Sha512Compress(uint64_t state[8], const uint8_t *block)
+{
+	uint64_t w[16];
+	uint64_t v[8];
+
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		w[i] = 0;
+		for(uint8_t j = 0; j < 8; j++)
+		{
+			w[i] = (w[i] << 8) | block[8 * i + j];
+		}
+	}
+	memcpy(v, state, sizeof(v));
+
+	for(uint8_t i = 0; i < 80; i++)
+	{
+		uint64_t t1, t2;
+
+		if(i >= 16)
+		{
+			uint64_t w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+			w[i & 15] += (ROTR64(w2, 19) ^ ROTR64(w2, 61) ^ (w2 >> 6)) + w[(i - 7) & 15]
+						+ (ROTR64(w15, 1) ^ ROTR64(w15, 8) ^ (w15 >> 7));
+		}
+		t1 = v[7] + (ROTR64(v[4], 14) ^ ROTR64(v[4], 18) ^ ROTR64(v[4], 41)) + (v[6] ^ (v[4] & (v[5] ^ v[6])))
+			+ sha512K[i] + w[i & 15];
+		t2 = (ROTR64(v[0], 28) ^ ROTR64(v[0], 34) ^ ROTR64(v[0], 39)) + ((v[0] & v[1]) | (v[2] & (v[0] | v[1])));
+		memmove(&v[1], &v[0], 7 * sizeof(uint64_t));
+		v[4] += t1;
+		v[0] = t1 + t2;
+	}
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		state[i] += v[i];
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void Sha512Init(Sha512Context *ctx)
+* @brief	Starts a new hash
+*****************************************************************************/
+static void Sha512Init(Sha512Context *ctx)
+{
+	ctx->state[0] = 0x6a09e667f3bcc908ULL;
+	ctx->state[1] = 0xbb67ae8584caa73bULL;
+	ctx->state[2] = 0x3c6ef372fe94f82bULL;
+	ctx->state[3] = 0xa54ff53a5f1d36f1ULL;
+	ctx->state[4] = 0x510e527fade682d1ULL;
+	ctx->state[5] = 0x9b05688c2b3e6c1fULL;
+	ctx->state[6] = 0x1f83d9abfb41bd6bULL;
+	ctx->state[7] = 0x5be0cd19137e2179ULL;
+	ctx->length = 0;
+	ctx->blockLen = 0;
+}
+
+/**************************************************************************//**
+* @fn		static void Sha512Update(Sha512Context *ctx, const uint8_t *data, size_t len)
+* @brief	Adds bytes to the hash
+*****************************************************************************/
+static void Sha512Update(Sha512Context *ctx, const uint8_t *data, size_t len)
+{
+	ctx->length += len;
+	while(len > 0)
+	{
+		size_t take = SHA512_BLOCK_SIZE - ctx->blockLen;
+		if(take > len) take = len;
+		memcpy(&ctx->block[ctx->blockLen], data, take);
+		ctx->blockLen += take;
+		data += take;
+		len -= take;
+		if(ctx->blockLen == SHA512_BLOCK_SIZE)
+		{
+			Sha512Compress(ctx->state, ctx->block);
+			ctx->blockLen = 0;
+		}
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void Sha512Final(Sha512Context *ctx, uint8_t digest[SHA512_DIGEST_SIZE])
+* @brief	Pads the message and writes the digest
+*****************************************************************************/
+static void Sha512Final(Sha512Context *ctx, uint8_t digest[SHA512_DIGEST_SIZE])
+{
+	uint32_t bits = ctx->length << 3;
+
+	ctx->block[ctx->blockLen++] = 0x80;
+	if(ctx->blockLen > SHA512_BLOCK_SIZE - 16)
+	{
+		memset(&ctx->block[ctx->blockLen], 0, SHA512_BLOCK_SIZE - ctx->blockLen);
+		Sha512Compress(ctx->state, ctx->block);
+		ctx->blockLen = 0;
+	}
+	memset(&ctx->block[ctx->blockLen], 0, SHA512_BLOCK_SIZE - ctx->blockLen);
+
+	//Length in bits, big endian in the last 16 bytes
+	ctx->block[SHA512_BLOCK_SIZE - 5] = (uint8_t)(ctx->length >> 29);
+	ctx->block[SHA512_BLOCK_SIZE - 4] = (uint8_t)(bits >> 24);
+	ctx->block[SHA512_BLOCK_SIZE - 3] = (uint8_t)(bits >> 16);
+	ctx->block[SHA512_BLOCK_SIZE - 2] = (uint8_t)(bits >> 8);
+	ctx->block[SHA512_BLOCK_SIZE - 1] = (uint8_t) bits;
+	Sha512Compress(ctx->state, ctx->block);
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		for(uint8_t j = 0; j < 8; j++)
+		{
+			digest[8 * i + j] = (uint8_t)(ctx->state[i] >> (56 - 8 * j));
+		}
+	}
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		bool Ed25519Verify(const uint8_t signature[ED25519_SIGNATURE_SIZE], const uint8_t *message, size_t len, const uint8_t publicKey[ED25519_PUBLIC_KEY_SIZE])
+* @brief	Checks an Ed25519 signature of message under publicKey
+* @details	Accepts the signature if [S]B - [k]A encodes to R, with k = SHA-512(R || A || message) mod L. About
+*			253 doublings and 190 additions on average, so the cost does not depend on the message length: the
+*			image is hashed by the caller and only its digest is signed.
+* @return	true if the signature is valid
+*****************************************************************************/
+bool Ed25519Verify(const uint8_t signature[ED25519_SIGNATURE_SIZE], const uint8_t *message, size_t len,
+				   const uint8_t publicKey[ED25519_PUBLIC_KEY_SIZE])
+{
+	Ed25519Point negA, r;
+	Sha512Context sha;
+	uint8_t hash[SHA512_DIGEST_SIZE];
+	uint8_t k[32];
+	uint8_t encoded[32];
+
+	if(!ScalarIsReduced(&signature[32])) return false;
+	if(!PointDecodeNegate(&negA, publicKey)) return false;
+
+	Sha512Init(&sha);
+	Sha512Update(&sha, signature, 32);
+	Sha512Update(&sha, publicKey, ED25519_PUBLIC_KEY_SIZE);
+	Sha512Update(&sha, message, len);
+	Sha512Final(&sha, hash);
+	ScalarReduce(k, hash);
+
+	PointDoubleScalarMult(&r, &signature[32], k, &negA);
+	PointEncode(encoded, &r);
+	return memcmp(encoded, signature, 32) == 0;
+}
@@ -0,0 +1,33 @@
+/**************************************************************************//**
+* @file      Ed25519.h
+* @brief     Ed25519 signature verification (RFC 8032). Verification only: the bootloader never holds a private key.
+
+******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define ED25519_PUBLIC_KEY_SIZE	32	///<Bytes of an encoded public key
+#define ED25519_SIGNATURE_SIZE	64	///<Bytes of a signature: R, then S
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+bool Ed25519Verify(const uint8_t signature[ED25519_SIGNATURE_SIZE], const uint8_t *message, size_t len,
+				   const uint8_t publicKey[ED25519_PUBLIC_KEY_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
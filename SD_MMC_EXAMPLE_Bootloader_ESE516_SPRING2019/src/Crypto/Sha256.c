@@ -0,0 +1,193 @@
+/**************************************************************************//**
+* @file      Sha256.c
+* @brief     SHA-256 (FIPS 180-4), computed incrementally so an image can be hashed row by row while it is written.
+* @details   Written for the Cortex-M0+: the message schedule is kept in a ring of 16 words instead of 64, and the
+*			rounds are unrolled by 8 so the working variables rotate by renaming instead of 8 moves per round.
+*			Full blocks are compressed straight from the caller's buffer.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "Crypto/Sha256.h"
+#include <string.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define ROTR(x, n)		(((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)		((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define SIGMA0(x)		(ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define SIGMA1(x)		(ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define GAMMA0(x)		(ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define GAMMA1(x)		(ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+///Word i of the message schedule, computed in place in the ring w for i >= 16
+#define SCHEDULE(i)		(w[(i) & 15] += GAMMA1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] + GAMMA0(w[((i) - 15) & 15]))
+
+///One round. The caller rotates the names of the working variables instead of moving them
+#define ROUND(a, b, c, d, e, f, g, h, i, wi)								\
+	do {																	\
+		uint32_t t1 = (h) + SIGMA1(e) + CH(e, f, g) + sha256K[i] + (wi);	\
+		(d) += t1;															\
+		(h) = t1 + SIGMA0(a) + MAJ(a, b, c);								\
+	} while(0)
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static const uint32_t sha256K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static void Sha256Compress(uint32_t state[8], const uint8_t *block);
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void Sha256Compress(uint32_t state[8], const uint8_t *block)
+* @brief	Compresses one block of SHA256_BLOCK_SIZE bytes into state
+*****************************************************************************/
+static void Sha256Compress(uint32_t state[8], const uint8_t *block)
+{
+	uint32_t w[16];
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		w[i] = ((uint32_t) block[4 * i] << 24) | ((uint32_t) block[4 * i + 1] << 16) | ((uint32_t) block[4 * i + 2] << 8) | block[4 * i + 3];
+	}
+
+	for(uint8_t i = 0; i < 16; i += 8)
+	{
+		ROUND(a, b, c, d, e, f, g, h, i + 0, w[i + 0]);
+		ROUND(h, a, b, c, d, e, f, g, i + 1, w[i + 1]);
+		ROUND(g, h, a, b, c, d, e, f, i + 2, w[i + 2]);
+		ROUND(f, g, h, a, b, c, d, e, i + 3, w[i + 3]);
+		ROUND(e, f, g, h, a, b, c, d, i + 4, w[i + 4]);
+		ROUND(d, e, f, g, h, a, b, c, i + 5, w[i + 5]);
+		ROUND(c, d, e, f, g, h, a, b, i + 6, w[i + 6]);
+		ROUND(b, c, d, e, f, g, h, a, i + 7, w[i + 7]);
+	}
+	for(uint8_t i = 16; i < 64; i += 8)
+	{
+		ROUND(a, b, c, d, e, f, g, h, i + 0, SCHEDULE(i + 0));
+		ROUND(h, a, b, c, d, e, f, g, i + 1, SCHEDULE(i + 1));
+		ROUND(g, h, a, b, c, d, e, f, i + 2, SCHEDULE(i + 2));
+		ROUND(f, g, h, a, b, c, d, e, i + 3, SCHEDULE(i + 3));
+		ROUND(e, f, g, h, a, b, c, d, i + 4, SCHEDULE(i + 4));
+		ROUND(d, e, f, g, h, a, b, c, i + 5, SCHEDULE(i + 5));
+		ROUND(c, d, e, f, g, h, a, b, i + 6, SCHEDULE(i + 6));
+		ROUND(b, c, d, e, f, g, h, a, i + 7, SCHEDULE(i + 7));
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void Sha256Init(Sha256Context *ctx)
+* @brief	Starts a new hash
+*****************************************************************************/
+void Sha256Init(Sha256Context *ctx)
+{
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+	ctx->length = 0;
+	ctx->blockLen = 0;
+}
+
+/**************************************************************************//**
+* @fn		void Sha256Update(Sha256Context *ctx, const uint8_t *data, size_t len)
+* @brief	Adds bytes to the hash
+*****************************************************************************/
+void Sha256Update(Sha256Context *ctx, const uint8_t *data, size_t len)
+{
+	ctx->length += len;
+
+	if(ctx->blockLen > 0)
+	{
+		size_t take = SHA256_BLOCK_SIZE - ctx->blockLen;
+		if(take > len) take = len;
+		memcpy(&ctx->block[ctx->blockLen], data, take);
+		ctx->blockLen += take;
+		data += take;
+		len -= take;
+		if(ctx->blockLen < SHA256_BLOCK_SIZE) return;
+		Sha256Compress(ctx->state, ctx->block);
+		ctx->blockLen = 0;
+	}
+
+	while(len >= SHA256_BLOCK_SIZE)
+	{
+		Sha256Compress(ctx->state, data);
+		data += SHA256_BLOCK_SIZE;
+		len -= SHA256_BLOCK_SIZE;
+	}
+
+	memcpy(ctx->block, data, len);
+	ctx->blockLen = len;
+}
+
+/**************************************************************************//**
+* @fn		void Sha256Final(Sha256Context *ctx, uint8_t digest[SHA256_DIGEST_SIZE])
+* @brief	Pads the message and writes the digest. The context must be initialized again before reuse.
+*****************************************************************************/
+void Sha256Final(Sha256Context *ctx, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	uint32_t bits = ctx->length << 3;
+
+	ctx->block[ctx->blockLen++] = 0x80;
+	if(ctx->blockLen > SHA256_BLOCK_SIZE - 8)
+	{
+		memset(&ctx->block[ctx->blockLen], 0, SHA256_BLOCK_SIZE - ctx->blockLen);
+		Sha256Compress(ctx->state, ctx->block);
+		ctx->blockLen = 0;
+	}
+	memset(&ctx->block[ctx->blockLen], 0, SHA256_BLOCK_SIZE - 4 - ctx->blockLen);
+
+	//Length in bits, big endian. The upper word is (length >> 29), always 0 or small for images
+	ctx->block[SHA256_BLOCK_SIZE - 8] = 0;
+	ctx->block[SHA256_BLOCK_SIZE - 7] = 0;
+	ctx->block[SHA256_BLOCK_SIZE - 6] = 0;
+	ctx->block[SHA256_BLOCK_SIZE - 5] = (uint8_t)(ctx->length >> 29);
+	ctx->block[SHA256_BLOCK_SIZE - 4] = (uint8_t)(bits >> 24);
+	ctx->block[SHA256_BLOCK_SIZE - 3] = (uint8_t)(bits >> 16);
+	ctx->block[SHA256_BLOCK_SIZE - 2] = (uint8_t)(bits >> 8);
+	ctx->block[SHA256_BLOCK_SIZE - 1] = (uint8_t) bits;
+	Sha256Compress(ctx->state, ctx->block);
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+		digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+		digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+		digest[4 * i + 3] = (uint8_t) ctx->state[i];
+	}
+}
@@ -0,0 +1,46 @@
+/**************************************************************************//**
+* @file      Sha256.h
+* @brief     SHA-256 (FIPS 180-4), computed incrementally so an image can be hashed row by row while it is written.
+
+******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define SHA256_BLOCK_SIZE	64	///<Bytes compressed at a time
+#define SHA256_DIGEST_SIZE	32	///<Bytes of a digest
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//State of a hash in progress
+typedef struct Sha256Context
+{
+	uint32_t state[8];					///<Chaining value
+	uint32_t length;					///<Bytes hashed so far. Images are far below 512 MB
+	uint8_t block[SHA256_BLOCK_SIZE];	///<Bytes waiting for a full block
+	uint8_t blockLen;					///<Bytes in block
+} Sha256Context;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+void Sha256Init(Sha256Context *ctx);
+void Sha256Update(Sha256Context *ctx, const uint8_t *data, size_t len);
+void Sha256Final(Sha256Context *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,466 @@
+/**************************************************************************//**
+* @file      ImageInstall.c
+* @brief     Writes a signed application image into NVM row by row, and only makes it bootable once its signature
+*			checks out.
+* @details   Rows may arrive in any order and more than once (the serial upload sends missed rows again). The hash
+*			advances over the rows written so far in row order; a row that was written is never written again, so
+*			the flash always holds what was hashed.
+*			The boot record is one row after the application region. It is erased when an install starts, and its
+*			magic word is programmed last, so a reset at any point leaves either a whole record or none. A software
+*			CRC-32 covers it as well.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "ImageInstall/ImageInstall.h"
+#include "ImageInstall/ImageKey.h"
+#include "Crypto/Sha256.h"
+#include "ASF/sam0/drivers/dsu/crc32/crc32.h"
+#include <stddef.h>
+#include <string.h>
+#ifdef IMAGE_INSTALL_BENCHMARK
+#include <stdio.h>
+#include "SerialConsole/SerialConsole.h"
+#include "Systick/Systick.h"
+#endif
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define IMAGE_INSTALL_MAX_ROWS		(FLASH_SIZE / IMAGE_INSTALL_ROW_SIZE)	///<Rows of the whole flash
+
+#ifdef IMAGE_INSTALL_BENCHMARK
+#define IMAGE_INSTALL_BENCH_BYTES	16384	///<Bytes of flash hashed to measure SHA-256
+#endif
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Boot record, at the start of the row after the application region. The rest of the row is left erased
+typedef struct ImageBootRecord
+{
+	uint32_t magic;								///<IMAGE_INSTALL_RECORD_MAGIC
+	uint32_t version;							///<Images installed since the first record, this one included
+	uint32_t size;								///<Bytes of the image
+	uint32_t crc;								///<DSU CRC-32 of the image, checked at boot
+	uint8_t digest[SHA256_DIGEST_SIZE];			///<SHA-256 of the image, verified at install
+	uint8_t signature[ED25519_SIGNATURE_SIZE];	///<Signature of digest, for the full check
+	uint32_t recordCrc;							///<CRC-32 of the fields above
+} ImageBootRecord;
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static uint32_t appStart;								///<First address of the application
+static uint32_t appEnd;									///<Address after the application region, of the boot record
+static bool imageStarted = false;						///<ImageInstallStart accepted an image
+static uint16_t imageRows;								///<Rows of the image
+static uint16_t rowsHashed;								///<Rows 0 to rowsHashed - 1 are in the hash
+static uint32_t previousVersion;						///<Version of the record erased by ImageInstallStart, 0 if there was none
+static uint8_t rowsWritten[IMAGE_INSTALL_MAX_ROWS / 8];	///<One bit per row of the image, set once written and read back
+static uint8_t firstRow[IMAGE_INSTALL_ROW_SIZE];		///<Row 0, programmed once the signature is valid
+static Sha256Context imageHash;							///<SHA-256 of rows 0 to rowsHashed - 1
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static bool ImageInstallIsWritten(uint16_t row);
+static bool ImageInstallWritePage(uint32_t address, const uint8_t *data);
+static bool ImageInstallProgramRow(uint16_t row, const uint8_t *data);
+static void ImageInstallEraseRow(uint32_t address);
+static uint32_t ImageInstallRecordCrc(const ImageBootRecord *record);
+static bool ImageInstallRecordValid(const ImageBootRecord *record);
+static bool ImageInstallWriteRecord(uint32_t size, uint32_t version, const uint8_t *digest, const uint8_t *signature);
+#ifdef IMAGE_INSTALL_BENCHMARK
+static void ImageInstallReport(const char *name, bool passed);
+#endif
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static bool ImageInstallIsWritten(uint16_t row)
+* @brief	Returns true if the row of the image was written and read back
+*****************************************************************************/
+static bool ImageInstallIsWritten(uint16_t row)
+{
+	return (rowsWritten[row / 8] & (1 << (row % 8))) != 0;
+}
+
+/**************************************************************************//**
+* @fn		static bool ImageInstallWritePage(uint32_t address, const uint8_t *data)
+* @brief	Writes a page of flash and waits for the write to complete
+* @details	Only clears bits: bytes left at 0xFF in data keep what the page holds
+* @return	true if the NVM driver accepted the write
+*****************************************************************************/
+static bool ImageInstallWritePage(uint32_t address, const uint8_t *data)
+{
+	enum status_code nvmError;
+
+	do
+	{
+		nvmError = nvm_write_buffer(address, data, NVMCTRL_PAGE_SIZE);
+	} while(nvmError == STATUS_BUSY);
+
+	while(!nvm_is_ready())
+	{
+
+	}
+	return nvmError == STATUS_OK;
+}
+
+/**************************************************************************//**
+* @fn		static bool ImageInstallProgramRow(uint16_t row, const uint8_t *data)
+* @brief	Erases a row of the application, writes it page by page and reads it back
+* @return	true if the row holds data
+* @note		The CPU stalls while the flash is erased or written
+*****************************************************************************/
+static bool ImageInstallProgramRow(uint16_t row, const uint8_t *data)
+{
+	uint32_t address = appStart + (uint32_t) row * IMAGE_INSTALL_ROW_SIZE;
+	bool written = true;
+
+	ImageInstallEraseRow(address);
+	for(uint8_t page = 0; page < NVMCTRL_ROW_PAGES && written; page++)
+	{
+		written = ImageInstallWritePage(address + page * NVMCTRL_PAGE_SIZE, &data[page * NVMCTRL_PAGE_SIZE]);
+	}
+	return written && memcmp((const void *) address, data, IMAGE_INSTALL_ROW_SIZE) == 0;
+}
+
+/**************************************************************************//**
+* @fn		static void ImageInstallEraseRow(uint32_t address)
+* @brief	Erases a row of flash
+*****************************************************************************/
+static void ImageInstallEraseRow(uint32_t address)
+{
+	enum status_code nvmError;
+
+	do
+	{
+		nvmError = nvm_erase_row(address);
+	} while(nvmError == STATUS_BUSY);
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t ImageInstallRecordCrc(const ImageBootRecord *record)
+* @brief	CRC-32 (zlib) of a boot record up to its recordCrc field. In software: the record may be in RAM.
+*****************************************************************************/
+static uint32_t ImageInstallRecordCrc(const ImageBootRecord *record)
+{
+	const uint8_t *data = (const uint8_t *) record;
+	uint32_t crc = 0xFFFFFFFF;
+
+	for(size_t i = 0; i < offsetof(ImageBootRecord, recordCrc); i++)
+	{
+		crc ^= data[i];
+		for(uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+/**************************************************************************//**
+* @fn		static bool ImageInstallRecordValid(const ImageBootRecord *record)
+* @brief	Returns true if the boot record was completely written
+*****************************************************************************/
+static bool ImageInstallRecordValid(const ImageBootRecord *record)
+{
+	return record->magic == IMAGE_INSTALL_RECORD_MAGIC && ImageInstallRecordCrc(record) == record->recordCrc;
+}
+
+/**************************************************************************//**
+* @fn		static bool ImageInstallWriteRecord(uint32_t size, uint32_t version, const uint8_t *digest, const uint8_t *signature)
+* @brief	Writes the boot record of the installed image, with the DSU CRC-32 of the image
+* @details	The record spans two pages. It is written with its magic word left erased, then the first page is written
+*			again with the magic: a reset before that leaves no record rather than a torn one.
+* @param[in]	signature May point into the old record: it is copied before the row is erased
+* @return	true if the record reads back
+*****************************************************************************/
+static bool ImageInstallWriteRecord(uint32_t size, uint32_t version, const uint8_t *digest, const uint8_t *signature)
+{
+	ImageBootRecord record;
+	uint8_t rowData[IMAGE_INSTALL_ROW_SIZE];
+
+	record.crc = 0xFFFFFFFF;
+	if(dsu_crc32_cal(appStart, size, &record.crc) != STATUS_OK) return false;
+	record.magic = IMAGE_INSTALL_RECORD_MAGIC;
+	record.version = version;
+	record.size = size;
+	memcpy(record.digest, digest, SHA256_DIGEST_SIZE);
+	memcpy(record.signature, signature, ED25519_SIGNATURE_SIZE);
+	record.recordCrc = ImageInstallRecordCrc(&record);
+
+	memset(rowData, 0xFF, sizeof(rowData));
+	memcpy(rowData, &record, sizeof(record));
+	memset(rowData, 0xFF, sizeof(record.magic));
+	if(!ImageInstallProgramRow((appEnd - appStart) / IMAGE_INSTALL_ROW_SIZE, rowData)) return false;
+
+	memcpy(rowData, &record.magic, sizeof(record.magic));
+	return ImageInstallWritePage(appEnd, rowData) && memcmp((const void *) appEnd, &record, sizeof(record)) == 0;
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		bool ImageInstallCheckTrailer(const uint8_t trailer[IMAGE_INSTALL_TRAILER_SIZE], uint32_t fileSize, uint32_t *imageSize)
+* @brief	Checks the trailer at the end of a signed file
+* @param[in]	fileSize Bytes of the whole file, trailer included
+* @param[out]	imageSize Bytes of the image in front of the trailer
+* @return	true if the trailer is well formed. The signature itself is only checked by ImageInstallFinish.
+*****************************************************************************/
+bool ImageInstallCheckTrailer(const uint8_t trailer[IMAGE_INSTALL_TRAILER_SIZE], uint32_t fileSize, uint32_t *imageSize)
+{
+	uint32_t magic = trailer[0] | ((uint32_t) trailer[1] << 8) | ((uint32_t) trailer[2] << 16) | ((uint32_t) trailer[3] << 24);
+	uint32_t size = trailer[4] | ((uint32_t) trailer[5] << 8) | ((uint32_t) trailer[6] << 16) | ((uint32_t) trailer[7] << 24);
+
+	if(magic != IMAGE_INSTALL_MAGIC || size == 0 || size % IMAGE_INSTALL_ROW_SIZE != 0) return false;
+	if(fileSize < IMAGE_INSTALL_TRAILER_SIZE || size != fileSize - IMAGE_INSTALL_TRAILER_SIZE) return false;
+
+	*imageSize = size;
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		enum eImageInstallStatus ImageInstallStart(uint32_t appStartAddress, uint32_t appEndAddress, uint32_t size)
+* @brief	Starts writing a new image: erases the boot record, then the first row of the application
+* @param[in]	appStartAddress First address of the application, row aligned
+* @param[in]	appEndAddress Address after the last row the application may use. The row there holds the boot record.
+* @param[in]	size Bytes of the image, a whole number of rows
+* @return	IMAGE_INSTALL_BAD_ARG if the size does not fit. The application is left alone then.
+* @note		Needs the NVM driver and the DSU CRC configured
+*****************************************************************************/
+enum eImageInstallStatus ImageInstallStart(uint32_t appStartAddress, uint32_t appEndAddress, uint32_t size)
+{
+	const ImageBootRecord *previous = (const ImageBootRecord *) appEndAddress;
+
+	if(size == 0 || size % IMAGE_INSTALL_ROW_SIZE != 0 || size > appEndAddress - appStartAddress)
+	{
+		return IMAGE_INSTALL_BAD_ARG;
+	}
+
+	appStart = appStartAddress;
+	appEnd = appEndAddress;
+	imageRows = size / IMAGE_INSTALL_ROW_SIZE;
+	rowsHashed = 0;
+	memset(rowsWritten, 0, sizeof(rowsWritten));
+	Sha256Init(&imageHash);
+	imageStarted = true;
+
+	//The old record goes before anything is written, so it is never checked against part of the new image
+	previousVersion = ImageInstallRecordValid(previous) ? previous->version : 0;
+	ImageInstallEraseRow(appEnd);
+
+	//The stack pointer and reset vector are in the first row. Erased, the bootloader will not jump to a partial image
+	ImageInstallEraseRow(appStart);
+	return IMAGE_INSTALL_OK;
+}
+
+/**************************************************************************//**
+* @fn		enum eImageInstallStatus ImageInstallWriteRow(uint16_t row, const uint8_t *data)
+* @brief	Writes a row of the image and adds the rows now written in sequence to the hash
+* @details	Row 0 is kept in RAM until ImageInstallFinish. A row already written is not written again: the call only
+*			reports it written.
+* @param[in]	data IMAGE_INSTALL_ROW_SIZE bytes
+* @return	IMAGE_INSTALL_OK once the row holds data
+*****************************************************************************/
+enum eImageInstallStatus ImageInstallWriteRow(uint16_t row, const uint8_t *data)
+{
+	if(!imageStarted) return IMAGE_INSTALL_NOT_STARTED;
+	if(row >= imageRows) return IMAGE_INSTALL_BAD_ARG;
+	if(ImageInstallIsWritten(row)) return IMAGE_INSTALL_OK;
+
+	if(row == 0)
+	{
+		memcpy(firstRow, data, IMAGE_INSTALL_ROW_SIZE);
+	}
+	else if(!ImageInstallProgramRow(row, data))
+	{
+		return IMAGE_INSTALL_WRITE_FAILED;
+	}
+	rowsWritten[row / 8] |= (uint8_t)(1 << (row % 8));
+
+	//Hash from the flash, not from data: the signature then covers what the application will run
+	while(rowsHashed < imageRows && ImageInstallIsWritten(rowsHashed))
+	{
+		const uint8_t *rowData = (rowsHashed == 0) ? firstRow : (const uint8_t *)(appStart + (uint32_t) rowsHashed * IMAGE_INSTALL_ROW_SIZE);
+		Sha256Update(&imageHash, rowData, IMAGE_INSTALL_ROW_SIZE);
+		rowsHashed++;
+	}
+	return IMAGE_INSTALL_OK;
+}
+
+/**************************************************************************//**
+* @fn		enum eImageInstallStatus ImageInstallFinish(const uint8_t signature[ED25519_SIGNATURE_SIZE])
+* @brief	Checks the signature of the image and, if valid, programs row 0 so the image can boot and writes its
+*			boot record
+* @return	IMAGE_INSTALL_OK if the image is installed. On any other result row 0 stays erased.
+*****************************************************************************/
+enum eImageInstallStatus ImageInstallFinish(const uint8_t signature[ED25519_SIGNATURE_SIZE])
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+
+	if(!imageStarted) return IMAGE_INSTALL_NOT_STARTED;
+	if(rowsHashed != imageRows) return IMAGE_INSTALL_MISSING;
+
+	imageStarted = false;
+	Sha256Final(&imageHash, digest);
+	if(!Ed25519Verify(signature, digest, sizeof(digest), imageVerifyPublicKey))
+	{
+		return IMAGE_INSTALL_BAD_SIGNATURE;
+	}
+
+	if(!ImageInstallProgramRow(0, firstRow))
+	{
+		ImageInstallEraseRow(appStart);
+		return IMAGE_INSTALL_WRITE_FAILED;
+	}
+
+	//The image is in place either way. Without a record the boot check reports it and still starts it
+	ImageInstallWriteRecord((uint32_t) imageRows * IMAGE_INSTALL_ROW_SIZE, previousVersion + 1, digest, signature);
+	return IMAGE_INSTALL_OK;
+}
+
+/**************************************************************************//**
+* @fn		enum eImageCheckResult ImageInstallCheckApplication(uint32_t appStartAddress, uint32_t appEndAddress, bool useCache, uint32_t *version)
+* @brief	Checks the installed application against its boot record before it is started
+* @details	With useCache, a valid record and a DSU CRC-32 of the image equal to the cached one are enough. Otherwise
+*			the image is hashed and its signature checked, as at install; if only the record was damaged it is
+*			written again, so the next boot takes the fast path.
+* @param[in]	appStartAddress First address of the application
+* @param[in]	appEndAddress Address after the application region, of the boot record
+* @param[in]	useCache false to always do the full check
+* @param[out]	version Install counter of the record, if there is one
+* @note		Needs the NVM driver and the DSU CRC configured
+*****************************************************************************/
+enum eImageCheckResult ImageInstallCheckApplication(uint32_t appStartAddress, uint32_t appEndAddress, bool useCache, uint32_t *version)
+{
+	const ImageBootRecord *record = (const ImageBootRecord *) appEndAddress;
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	uint32_t crc = 0xFFFFFFFF;
+	bool recordValid;
+
+	if(record->magic != IMAGE_INSTALL_RECORD_MAGIC) return IMAGE_CHECK_NO_RECORD;
+	*version = record->version;
+	if(record->size == 0 || record->size % IMAGE_INSTALL_ROW_SIZE != 0 || record->size > appEndAddress - appStartAddress)
+	{
+		return IMAGE_CHECK_FAILED;
+	}
+	recordValid = ImageInstallRecordValid(record);
+
+	if(useCache && recordValid)
+	{
+		if(dsu_crc32_cal(appStartAddress, record->size, &crc) == STATUS_OK && crc == record->crc) return IMAGE_CHECK_CACHED;
+	}
+
+	Sha256Init(&imageHash);
+	Sha256Update(&imageHash, (const uint8_t *) appStartAddress, record->size);
+	Sha256Final(&imageHash, digest);
+	if(recordValid && memcmp(digest, record->digest, sizeof(digest)) != 0) return IMAGE_CHECK_FAILED;
+	if(!Ed25519Verify(record->signature, digest, sizeof(digest), imageVerifyPublicKey)) return IMAGE_CHECK_FAILED;
+
+	if(!recordValid)
+	{
+		appStart = appStartAddress;
+		appEnd = appEndAddress;
+		ImageInstallWriteRecord(record->size, record->version, digest, record->signature);
+	}
+	return IMAGE_CHECK_VERIFIED;
+}
+
+#ifdef IMAGE_INSTALL_BENCHMARK
+
+/**************************************************************************//**
+* @fn		static void ImageInstallReport(const char *name, bool passed)
+* @brief	Prints the result of a self-test
+*****************************************************************************/
+static void ImageInstallReport(const char *name, bool passed)
+{
+	SerialConsoleWriteString((char *) name);
+	SerialConsoleWriteString(passed ? ": ok\r\n" : ": FAILED\r\n");
+}
+
+/**************************************************************************//**
+* @fn		void ImageInstallBenchmark(void)
+* @brief	Checks SHA-256 and Ed25519 against known answers and prints how many cycles they take
+* @details	The known answers are the ones "tools/image_sign.py vectors" prints. SHA-256 is timed over the first
+*			IMAGE_INSTALL_BENCH_BYTES of the flash, as the install hashes the image from the flash.
+* @note		Needs the serial console. Uses SysTick, so it calls delay_init again before returning.
+*****************************************************************************/
+void ImageInstallBenchmark(void)
+{
+	//FIPS 180-4 example: SHA-256("abc")
+	static const uint8_t abcDigest[SHA256_DIGEST_SIZE] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+	};
+	//RFC 8032 section 7.1, test 2: one byte message 0x72. Its public key is not the development key
+	static const uint8_t rfcPublicKey[ED25519_PUBLIC_KEY_SIZE] = {
+		0x3d, 0x40, 0x17, 0xc3, 0xe8, 0x43, 0x89, 0x5a, 0x92, 0xb7, 0x0a, 0xa7, 0x4d, 0x1b, 0x7e, 0xbc,
+		0x9c, 0x98, 0x2c, 0xcf, 0x2e, 0xc4, 0x96, 0x8c, 0xc0, 0xcd, 0x55, 0xf1, 0x2a, 0xf4, 0x66, 0x0c
+	};
+	static const uint8_t rfcSignature[ED25519_SIGNATURE_SIZE] = {
+		0x92, 0xa0, 0x09, 0xa9, 0xf0, 0xd4, 0xca, 0xb8, 0x72, 0x0e, 0x82, 0x0b, 0x5f, 0x64, 0x25, 0x40,
+		0xa2, 0xb2, 0x7b, 0x54, 0x16, 0x50, 0x3f, 0x8f, 0xb3, 0x76, 0x22, 0x23, 0xeb, 0xdb, 0x69, 0xda,
+		0x08, 0x5a, 0xc1, 0xe4, 0x3e, 0x15, 0x99, 0x6e, 0x45, 0x8f, 0x36, 0x13, 0xd0, 0xf1, 0x1d, 0x8c,
+		0x38, 0x7b, 0x2e, 0xae, 0xb4, 0x30, 0x2a, 0xee, 0xb0, 0x0d, 0x29, 0x16, 0x12, 0xbb, 0x0c, 0x00
+	};
+	//RFC 8032 section 7.1, test 1: empty message, signed with the development key
+	static const uint8_t devSignature[ED25519_SIGNATURE_SIZE] = {
+		0xe5, 0x56, 0x43, 0x00, 0xc3, 0x60, 0xac, 0x72, 0x90, 0x86, 0xe2, 0xcc, 0x80, 0x6e, 0x82, 0x8a,
+		0x84, 0x87, 0x7f, 0x1e, 0xb8, 0xe5, 0xd9, 0x74, 0xd8, 0x73, 0xe0, 0x65, 0x22, 0x49, 0x01, 0x55,
+		0x5f, 0xb8, 0x82, 0x15, 0x90, 0xa3, 0x3b, 0xac, 0xc6, 0x1e, 0x39, 0x70, 0x1c, 0xf9, 0xb4, 0x6b,
+		0xd2, 0x5b, 0xf5, 0xf0, 0x59, 0x5b, 0xbe, 0x24, 0x65, 0x51, 0x41, 0x43, 0x8e, 0x7a, 0x10, 0x0b
+	};
+	const uint8_t message = 0x72;
+	uint8_t tampered[ED25519_SIGNATURE_SIZE];
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	char helpStr[64];
+	uint32_t hashCycles, verifyCycles, start;
+	uint32_t cpuHz = system_gclk_gen_get_hz(GCLK_GENERATOR_0);
+
+	SerialConsoleWriteString("\r\nImage signature self-test\r\n");
+	Sha256Init(&imageHash);
+	Sha256Update(&imageHash, (const uint8_t *) "abc", 3);
+	Sha256Final(&imageHash, digest);
+	ImageInstallReport("SHA-256 abc", memcmp(digest, abcDigest, sizeof(digest)) == 0);
+	ImageInstallReport("Ed25519 RFC 8032 test 1", Ed25519Verify(devSignature, &message, 0, imageVerifyPublicKey));
+	ImageInstallReport("Ed25519 RFC 8032 test 2", Ed25519Verify(rfcSignature, &message, 1, rfcPublicKey));
+	memcpy(tampered, rfcSignature, sizeof(tampered));
+	tampered[40] ^= 0x01;
+	ImageInstallReport("Ed25519 rejects a changed signature", !Ed25519Verify(tampered, &message, 1, rfcPublicKey));
+
+	InitSystickCycleCounter();
+
+	//Hashes the bootloader's own code, past its first IMAGE_INSTALL_BENCH_BYTES
+	start = GetSystickCycles();
+	Sha256Init(&imageHash);
+	Sha256Update(&imageHash, (const uint8_t *)(FLASH_ADDR + IMAGE_INSTALL_BENCH_BYTES), IMAGE_INSTALL_BENCH_BYTES);
+	Sha256Final(&imageHash, digest);
+	hashCycles = GetSystickCycles() - start;
+
+	start = GetSystickCycles();
+	Ed25519Verify(rfcSignature, &message, 1, rfcPublicKey);
+	verifyCycles = GetSystickCycles() - start;
+
+	DeinitSystick();
+	delay_init();
+
+	snprintf(helpStr, sizeof(helpStr), "SHA-256: %lu.%lu cycles/byte, %lu us per row\r\n",
+			 hashCycles / IMAGE_INSTALL_BENCH_BYTES, (hashCycles % IMAGE_INSTALL_BENCH_BYTES) * 10 / IMAGE_INSTALL_BENCH_BYTES,
+			 (uint32_t)((uint64_t) hashCycles * IMAGE_INSTALL_ROW_SIZE * 1000000 / IMAGE_INSTALL_BENCH_BYTES / cpuHz));
+	SerialConsoleWriteString(helpStr);
+	snprintf(helpStr, sizeof(helpStr), "Ed25519 verify: %lu cycles, %lu ms\r\n", verifyCycles, verifyCycles / (cpuHz / 1000));
+	SerialConsoleWriteString(helpStr);
+}
+
+#endif /*IMAGE_INSTALL_BENCHMARK*/
@@ -0,0 +1,85 @@
+/**************************************************************************//**
+* @file      ImageInstall.h
+* @brief     Writes a signed application image into NVM row by row, and only makes it bootable once its signature
+*			checks out.
+* @details   A signed image is the application padded with 0xFF to whole rows, followed by a trailer:
+*			"SIG1" (4), image size (4, little endian), Ed25519 signature (64) of the SHA-256 digest of the padded
+*			image. tools/image_sign.py makes it; the public key is in ImageKey.h.
+*
+*			The SHA-256 is computed while the rows are written, from the flash itself, so the signature check at the
+*			end only costs one Ed25519 verification and not a second pass over the image. Row 0 holds the stack
+*			pointer and the reset vector: ImageInstallStart erases it and it is only programmed once the signature
+*			is valid. Until then the bootloader has no application to jump to.
+*
+*			Once an image is installed, the row at the end of the application region holds a boot record: the
+*			verified digest and signature, an install counter and the DSU CRC-32 of the image. At boot
+*			ImageInstallCheckApplication compares the CRC, a hardware pass over the flash, instead of hashing the
+*			image and checking the signature again; it only does the full check when the record does not hold. The
+*			CRC catches corruption, not tampering: that relies on the bootloader being the only code that writes
+*			the flash, and on the signature check at install. ImageInstallStart erases the record before it writes
+*			anything, and the magic word of a new record is written last, so a reset never leaves a record that
+*			describes another image or only part of one.
+*
+*			Used by the SD card update and by the serial upload (SerialUpload.h).
+
+******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <asf.h>
+#include "Crypto/Ed25519.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+//#define IMAGE_INSTALL_BENCHMARK		///<Uncomment to run the crypto self-test and benchmark at boot
+
+#define IMAGE_INSTALL_ROW_SIZE			256	///<Bytes of an NVM row, the unit images are written in
+#define IMAGE_INSTALL_MAGIC				0x31474953UL	///<"SIG1" read as a little endian word
+#define IMAGE_INSTALL_TRAILER_SIZE		(4 + 4 + ED25519_SIGNATURE_SIZE)	///<Bytes after the image in a signed file
+#define IMAGE_INSTALL_SIGNATURE_OFFSET	8	///<Position of the signature in the trailer
+#define IMAGE_INSTALL_RECORD_MAGIC		0x31525642UL	///<"BVR1", marks a written boot record
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Outcome of the ImageInstall functions
+enum eImageInstallStatus {
+	IMAGE_INSTALL_OK = 0,				///<Done
+	IMAGE_INSTALL_BAD_ARG = 1,			///<Size or row out of range
+	IMAGE_INSTALL_NOT_STARTED = 2,		///<No image started
+	IMAGE_INSTALL_WRITE_FAILED = 3,		///<A row did not read back as written
+	IMAGE_INSTALL_MISSING = 4,			///<Rows of the image were not written
+	IMAGE_INSTALL_BAD_SIGNATURE = 5		///<The image is not signed with the key of ImageKey.h
+};
+
+//Outcome of ImageInstallCheckApplication
+enum eImageCheckResult {
+	IMAGE_CHECK_CACHED = 0,		///<The CRC-32 of the application matches the boot record
+	IMAGE_CHECK_VERIFIED = 1,	///<The application was hashed and its signature checked
+	IMAGE_CHECK_NO_RECORD = 2,	///<No boot record: the application was not installed by the bootloader, e.g. by a debugger
+	IMAGE_CHECK_FAILED = 3		///<The application does not match its boot record and signature
+};
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+bool ImageInstallCheckTrailer(const uint8_t trailer[IMAGE_INSTALL_TRAILER_SIZE], uint32_t fileSize, uint32_t *imageSize);
+enum eImageInstallStatus ImageInstallStart(uint32_t appStartAddress, uint32_t appEndAddress, uint32_t size);
+enum eImageInstallStatus ImageInstallWriteRow(uint16_t row, const uint8_t *data);
+enum eImageInstallStatus ImageInstallFinish(const uint8_t signature[ED25519_SIGNATURE_SIZE]);
+enum eImageCheckResult ImageInstallCheckApplication(uint32_t appStartAddress, uint32_t appEndAddress, bool useCache, uint32_t *version);
+#ifdef IMAGE_INSTALL_BENCHMARK
+void ImageInstallBenchmark(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
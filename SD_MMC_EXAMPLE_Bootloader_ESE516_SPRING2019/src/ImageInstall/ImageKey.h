@@ -0,0 +1,33 @@
+/**************************************************************************//**
+* @file      ImageKey.h
+* @brief     Ed25519 public key that application images must be signed with. See ImageInstall.h.
+* @details   This is the DEVELOPMENT key: the public key of RFC 8032 section 7.1, test 1. Its private half is
+*			printed in the RFC, so anyone can sign images for a bootloader built with it. Before shipping, run
+*			"tools/image_sign.py keygen release.key --header key.h", paste the array from key.h here and keep
+*			release.key private.
+
+******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "Crypto/Ed25519.h"
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static const uint8_t imageVerifyPublicKey[ED25519_PUBLIC_KEY_SIZE] = {
+	0xd7, 0x5a, 0x98, 0x01, 0x82, 0xb1, 0x0a, 0xb7,
+	0xd5, 0x4b, 0xfe, 0xd3, 0xc9, 0x64, 0x07, 0x3a,
+	0x0e, 0xe1, 0x72, 0xf3, 0xda, 0xa6, 0x23, 0x25,
+	0xaf, 0x02, 0x1a, 0x68, 0xf7, 0x07, 0x51, 0x1a
+};
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,542 @@
+/**************************************************************************//**
+* @file      SerialUpload.c
+* @brief     Writes the main application into NVM from a host on the console UART, without an SD card.
+* @details   Owns the console SERCOM while it runs: the console must not be initialized, or be deinitialized. Received
+*			bytes go through a small interrupt handler into a ring buffer; at 921600 baud the ASF read jobs of one
+*			character each cost too much per byte. Answers are sent with blocking writes.
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "SerialUpload/SerialUpload.h"
+#include <string.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define SERIAL_UPLOAD_XON			0x11	///<Escaped, as in HostLink, so one host encoder serves both
+#define SERIAL_UPLOAD_XOFF			0x13
+#define SERIAL_UPLOAD_CRC_INIT		0xFFFF	///<Initial value of the CRC-16
+#define SERIAL_UPLOAD_RX_SIZE		1024	///<Size of the receive ring. Must be a power of two
+#define SERIAL_UPLOAD_POLL_US		50		///<Wait between two looks at an empty receive ring
+#define SERIAL_UPLOAD_MAX_ANSWER	(1 + 2 * SERIAL_UPLOAD_WINDOW)	///<Status and the rows of a COMMIT
+#define SERIAL_UPLOAD_MAX_FRAME		(2 * (SERIAL_UPLOAD_HEADER_SIZE + SERIAL_UPLOAD_MAX_ANSWER + SERIAL_UPLOAD_CRC_SIZE) + 2)
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static struct usart_module uploadUsart;						///<Console SERCOM, configured for the upload
+static bool uploadUsartConfigured = false;					///<uploadUsart was initialized and must be reset before reuse
+static uint32_t uploadBaudrate = SERIAL_UPLOAD_BAUDRATE;	///<Current baud rate
+
+static volatile uint8_t rxRing[SERIAL_UPLOAD_RX_SIZE];	///<Bytes received by the interrupt handler
+static volatile uint16_t rxHead = 0;					///<Next byte written by the interrupt handler
+static volatile uint16_t rxTail = 0;					///<Next byte read by SerialUploadRun
+
+static uint8_t rxPacket[SERIAL_UPLOAD_MAX_PACKET];		///<Packet being received, unescaped
+static uint16_t rxLen = 0;								///<Bytes in rxPacket
+static bool rxInFrame = false;							///<An END opened a frame
+static bool rxEscape = false;							///<The last byte was ESC
+
+static uint8_t answerData[SERIAL_UPLOAD_MAX_ANSWER];	///<Data of the answer being built. Byte 0 is the status
+static uint8_t answerFrame[SERIAL_UPLOAD_MAX_FRAME];	///<Answers are encoded here
+
+static uint8_t windowData[SERIAL_UPLOAD_WINDOW][SERIAL_UPLOAD_ROW_SIZE];	///<Rows received since the last COMMIT
+static uint16_t windowRows[SERIAL_UPLOAD_WINDOW];		///<Row index of each entry of windowData
+static uint8_t windowCount = 0;							///<Entries used in windowData
+
+static uint32_t appStart;								///<First address of the application
+static uint32_t appEnd;									///<Address after the application region
+static bool imageStarted = false;						///<START was accepted
+static uint16_t imageRows;								///<Rows of the image
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static void SerialUploadConfigureUsart(uint32_t baudrate);
+static void SerialUploadInterruptHandler(uint8_t instance);
+static bool SerialUploadGetByte(uint8_t *rxChar);
+static bool SerialUploadDecode(uint8_t rxChar);
+static uint16_t SerialUploadCrc(uint16_t crc, const uint8_t *data, uint16_t len);
+static uint16_t SerialUploadEscape(uint8_t *frame, uint16_t pos, uint8_t value);
+static void SerialUploadReply(uint8_t type, uint8_t sequence, uint8_t status, uint16_t len);
+static bool SerialUploadHandlePacket(void);
+static void SerialUploadStart(uint8_t sequence, const uint8_t *data, uint16_t len);
+static void SerialUploadData(const uint8_t *data, uint16_t len);
+static void SerialUploadCommit(uint8_t sequence);
+static bool SerialUploadEnd(uint8_t sequence, const uint8_t *data, uint16_t len);
+static void SerialUploadPut16(uint8_t *buffer, uint16_t value);
+static void SerialUploadPut32(uint8_t *buffer, uint32_t value);
+static uint16_t SerialUploadGet16(const uint8_t *buffer);
+static uint32_t SerialUploadGet32(const uint8_t *buffer);
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void SerialUploadConfigureUsart(uint32_t baudrate)
+* @brief	Configures the console SERCOM as an 8N1 UART at the given baud rate, with SerialUploadInterruptHandler
+*			receiving. Anything still in the receive ring is dropped.
+* @note		Blocking writes wait for the end of the transmission, so the previous answer is out when this runs
+*****************************************************************************/
+static void SerialUploadConfigureUsart(uint32_t baudrate)
+{
+	struct usart_config config_usart;
+	uint8_t instance = _sercom_get_sercom_inst_index(EDBG_CDC_MODULE);
+
+	if(uploadUsartConfigured)
+	{
+		usart_reset(&uploadUsart);
+	}
+
+	usart_get_config_defaults(&config_usart);
+	config_usart.baudrate    = baudrate;
+	config_usart.mux_setting = EDBG_CDC_SERCOM_MUX_SETTING;
+	config_usart.pinmux_pad0 = EDBG_CDC_SERCOM_PINMUX_PAD0;
+	config_usart.pinmux_pad1 = EDBG_CDC_SERCOM_PINMUX_PAD1;
+	config_usart.pinmux_pad2 = EDBG_CDC_SERCOM_PINMUX_PAD2;
+	config_usart.pinmux_pad3 = EDBG_CDC_SERCOM_PINMUX_PAD3;
+	while (usart_init(&uploadUsart, EDBG_CDC_MODULE, &config_usart) != STATUS_OK)
+	{
+
+	}
+	uploadUsartConfigured = true;
+	uploadBaudrate = baudrate;
+
+	rxHead = 0;
+	rxTail = 0;
+	rxInFrame = false;
+	rxLen = 0;
+	rxEscape = false;
+
+	//Replace the ASF job handler set by usart_init with the ring buffer one
+	_sercom_set_handler(instance, SerialUploadInterruptHandler);
+	EDBG_CDC_MODULE->USART.INTENSET.reg = SERCOM_USART_INTFLAG_RXC;
+	usart_enable(&uploadUsart);
+}
+
+/**************************************************************************//**
+* @fn		static void SerialUploadInterruptHandler(uint8_t instance)
+* @brief	Moves received bytes into rxRing. Bytes that find the ring full are dropped, the packet CRC catches it.
+*****************************************************************************/
+static void SerialUploadInterruptHandler(uint8_t instance)
+{
+	enum status_code status;
+	uint16_t rxChar;
+
+	//An overflow or framing error comes back as a status, with its flag cleared; the byte is read on the next call.
+	//Such errors only corrupt the packet being received, the CRC drops it
+	while((status = usart_read_wait(&uploadUsart, &rxChar)) != STATUS_BUSY && status != STATUS_ERR_DENIED)
+	{
+		if(status != STATUS_OK) continue;
+
+		uint16_t next = (rxHead + 1) & (SERIAL_UPLOAD_RX_SIZE - 1);
+		if(next != rxTail)
+		{
+			rxRing[rxHead] = (uint8_t) rxChar;
+			rxHead = next;
+		}
+	}
+}
+
+/**************************************************************************//**
+* @fn		static bool SerialUploadGetByte(uint8_t *rxChar)
+* @brief	Takes the oldest byte from rxRing
+* @return	false if the ring is empty
+*****************************************************************************/
+static bool SerialUploadGetByte(uint8_t *rxChar)
+{
+	if(rxTail == rxHead) return false;
+
+	*rxChar = rxRing[rxTail];
+	rxTail = (rxTail + 1) & (SERIAL_UPLOAD_RX_SIZE - 1);
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		static bool SerialUploadDecode(uint8_t rxChar)
+* @brief	Feeds a received byte to the frame decoder
+* @return	true when rxPacket holds a complete packet with a good CRC. rxLen then excludes the CRC.
+*****************************************************************************/
+static bool SerialUploadDecode(uint8_t rxChar)
+{
+	if(rxChar == SERIAL_UPLOAD_END)
+	{
+		bool complete = rxInFrame && rxLen >= SERIAL_UPLOAD_HEADER_SIZE + SERIAL_UPLOAD_CRC_SIZE;
+		if(complete)
+		{
+			rxLen -= SERIAL_UPLOAD_CRC_SIZE;
+			complete = SerialUploadCrc(SERIAL_UPLOAD_CRC_INIT, rxPacket, rxLen) == SerialUploadGet16(&rxPacket[rxLen]);
+		}
+		//After a bad or short frame the decoder stays in a frame, so that END also opens the next one
+		rxInFrame = !complete;
+		if(!complete) rxLen = 0;
+		rxEscape = false;
+		return complete;
+	}
+
+	if(!rxInFrame) return false;
+	if(rxChar == SERIAL_UPLOAD_ESC)
+	{
+		rxEscape = true;
+		return false;
+	}
+	if(rxEscape)
+	{
+		rxEscape = false;
+		switch(rxChar)
+		{
+			case SERIAL_UPLOAD_ESC_END:		rxChar = SERIAL_UPLOAD_END; break;
+			case SERIAL_UPLOAD_ESC_ESC:		rxChar = SERIAL_UPLOAD_ESC; break;
+			case SERIAL_UPLOAD_ESC_XON:		rxChar = SERIAL_UPLOAD_XON; break;
+			case SERIAL_UPLOAD_ESC_XOFF:	rxChar = SERIAL_UPLOAD_XOFF; break;
+			default:						break; //Invalid escape, the CRC will reject the packet
+		}
+	}
+
+	if(rxLen >= SERIAL_UPLOAD_MAX_PACKET)
+	{
+		rxInFrame = false; //Too long. Wait for the next END
+		rxLen = 0;
+		return false;
+	}
+	rxPacket[rxLen++] = rxChar;
+	return false;
+}
+
+/**************************************************************************//**
+* @fn		static uint16_t SerialUploadCrc(uint16_t crc, const uint8_t *data, uint16_t len)
+* @brief	CRC-16/CCITT-FALSE: polynomial 0x1021, initial value SERIAL_UPLOAD_CRC_INIT, no reflection
+* @param[in]	crc SERIAL_UPLOAD_CRC_INIT, or the CRC of the preceding bytes
+*****************************************************************************/
+static uint16_t SerialUploadCrc(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+	while(len--)
+	{
+		crc ^= (uint16_t)(*data++) << 8;
+		for(uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+/**************************************************************************//**
+* @fn		static uint16_t SerialUploadEscape(uint8_t *frame, uint16_t pos, uint8_t value)
+* @brief	Writes one packet byte into a frame, escaped if needed
+* @return	Position after the written bytes
+*****************************************************************************/
+static uint16_t SerialUploadEscape(uint8_t *frame, uint16_t pos, uint8_t value)
+{
+	switch(value)
+	{
+		case SERIAL_UPLOAD_END:		frame[pos++] = SERIAL_UPLOAD_ESC; frame[pos++] = SERIAL_UPLOAD_ESC_END; break;
+		case SERIAL_UPLOAD_ESC:		frame[pos++] = SERIAL_UPLOAD_ESC; frame[pos++] = SERIAL_UPLOAD_ESC_ESC; break;
+		case SERIAL_UPLOAD_XON:		frame[pos++] = SERIAL_UPLOAD_ESC; frame[pos++] = SERIAL_UPLOAD_ESC_XON; break;
+		case SERIAL_UPLOAD_XOFF:	frame[pos++] = SERIAL_UPLOAD_ESC; frame[pos++] = SERIAL_UPLOAD_ESC_XOFF; break;
+		default:					frame[pos++] = value; break;
+	}
+	return pos;
+}
+
+/**************************************************************************//**
+* @fn		static void SerialUploadReply(uint8_t type, uint8_t sequence, uint8_t status, uint16_t len)
+* @brief	Sends answerData as the answer to a request, and waits until it is on the wire
+* @param[in]	status Written to answerData[0]
+* @param[in]	len Bytes of answerData after the status
+*****************************************************************************/
+static void SerialUploadReply(uint8_t type, uint8_t sequence, uint8_t status, uint16_t len)
+{
+	uint8_t header[SERIAL_UPLOAD_HEADER_SIZE] = {type | SERIAL_UPLOAD_RESPONSE, sequence};
+	uint16_t crc;
+	uint16_t pos = 0;
+
+	answerData[0] = status;
+	len++;
+	crc = SerialUploadCrc(SerialUploadCrc(SERIAL_UPLOAD_CRC_INIT, header, SERIAL_UPLOAD_HEADER_SIZE), answerData, len);
+
+	answerFrame[pos++] = SERIAL_UPLOAD_END;
+	pos = SerialUploadEscape(answerFrame, pos, header[0]);
+	pos = SerialUploadEscape(answerFrame, pos, header[1]);
+	for(uint16_t i = 0; i < len; i++)
+	{
+		pos = SerialUploadEscape(answerFrame, pos, answerData[i]);
+	}
+	pos = SerialUploadEscape(answerFrame, pos, (uint8_t)(crc & 0xFF));
+	pos = SerialUploadEscape(answerFrame, pos, (uint8_t)(crc >> 8));
+	answerFrame[pos++] = SERIAL_UPLOAD_END;
+
+	usart_write_buffer_wait(&uploadUsart, answerFrame, pos);
+}
+
+/**************************************************************************//**
+* @fn		static bool SerialUploadHandlePacket(void)
+* @brief	Runs the request in rxPacket
+* @return	true once END accepted the image
+*****************************************************************************/
+static bool SerialUploadHandlePacket(void)
+{
+	uint8_t type = rxPacket[0];
+	uint8_t sequence = rxPacket[1];
+	const uint8_t *data = &rxPacket[SERIAL_UPLOAD_HEADER_SIZE];
+	uint16_t len = rxLen - SERIAL_UPLOAD_HEADER_SIZE;
+
+	switch(type)
+	{
+		case SERIAL_UPLOAD_CMD_HELLO:
+		{
+			uint32_t baudrate = (len >= 4) ? SerialUploadGet32(data) : 0;
+			if(baudrate < SERIAL_UPLOAD_BAUDRATE || baudrate > SERIAL_UPLOAD_MAX_BAUDRATE)
+			{
+				SerialUploadReply(type, sequence, SERIAL_UPLOAD_STATUS_BAD_ARG, 0);
+				break;
+			}
+			SerialUploadPut16(&answerData[1], SERIAL_UPLOAD_ROW_SIZE);
+			answerData[3] = SERIAL_UPLOAD_WINDOW;
+			SerialUploadPut32(&answerData[4], appEnd - appStart);
+			SerialUploadReply(type, sequence, SERIAL_UPLOAD_STATUS_OK, 7);
+			if(baudrate != uploadBaudrate)
+			{
+				SerialUploadConfigureUsart(baudrate);
+			}
+			break;
+		}
+
+		case SERIAL_UPLOAD_CMD_START:
+			SerialUploadStart(sequence, data, len);
+			break;
+
+		case SERIAL_UPLOAD_CMD_DATA:
+			SerialUploadData(data, len);
+			break;
+
+		case SERIAL_UPLOAD_CMD_COMMIT:
+			SerialUploadCommit(sequence);
+			break;
+
+		case SERIAL_UPLOAD_CMD_END:
+			return SerialUploadEnd(sequence, data, len);
+
+		default:
+			SerialUploadReply(type, sequence, SERIAL_UPLOAD_STATUS_UNKNOWN, 0);
+			break;
+	}
+	return false;
+}
+
+/**************************************************************************//**
+* @fn		static void SerialUploadStart(uint8_t sequence, const uint8_t *data, uint16_t len)
+* @brief	Accepts a new image. ImageInstallStart erases the first row of the application.
+*****************************************************************************/
+static void SerialUploadStart(uint8_t sequence, const uint8_t *data, uint16_t len)
+{
+	uint32_t size = (len >= 4) ? SerialUploadGet32(data) : 0;
+
+	if(ImageInstallStart(appStart, appEnd, size) != IMAGE_INSTALL_OK)
+	{
+		imageStarted = false;
+		SerialUploadReply(SERIAL_UPLOAD_CMD_START, sequence, SERIAL_UPLOAD_STATUS_BAD_ARG, 0);
+		return;
+	}
+
+	imageRows = size / SERIAL_UPLOAD_ROW_SIZE;
+	windowCount = 0;
+	imageStarted = true;
+
+	SerialUploadReply(SERIAL_UPLOAD_CMD_START, sequence, SERIAL_UPLOAD_STATUS_OK, 0);
+}
+
+/**************************************************************************//**
+* @fn		static void SerialUploadData(const uint8_t *data, uint16_t len)
+* @brief	Keeps a row of the image for the next COMMIT. A row sent twice in a window replaces the first copy.
+*****************************************************************************/
+static void SerialUploadData(const uint8_t *data, uint16_t len)
+{
+	uint16_t row;
+	uint8_t entry;
+
+	if(!imageStarted || len != 2 + SERIAL_UPLOAD_ROW_SIZE) return;
+	row = SerialUploadGet16(data);
+	if(row >= imageRows) return;
+
+	for(entry = 0; entry < windowCount; entry++)
+	{
+		if(windowRows[entry] == row) break;
+	}
+	if(entry == SERIAL_UPLOAD_WINDOW) return; //Window full. The host will send the row again
+	if(entry == windowCount) windowCount++;
+
+	windowRows[entry] = row;
+	memcpy(windowData[entry], &data[2], SERIAL_UPLOAD_ROW_SIZE);
+}
+
+/**************************************************************************//**
+* @fn		static void SerialUploadCommit(uint8_t sequence)
+* @brief	Programs the rows of the window and answers the ones that read back correctly, or were already written
+* @note		Nothing is received while this runs: the CPU stalls on the flash during every erase and write
+*****************************************************************************/
+static void SerialUploadCommit(uint8_t sequence)
+{
+	uint16_t len = 0;
+
+	if(!imageStarted)
+	{
+		SerialUploadReply(SERIAL_UPLOAD_CMD_COMMIT, sequence, SERIAL_UPLOAD_STATUS_NO_START, 0);
+		return;
+	}
+
+	for(uint8_t entry = 0; entry < windowCount; entry++)
+	{
+		uint16_t row = windowRows[entry];
+		if(ImageInstallWriteRow(row, windowData[entry]) == IMAGE_INSTALL_OK)
+		{
+			SerialUploadPut16(&answerData[1 + len], row);
+			len += 2;
+		}
+	}
+	windowCount = 0;
+
+	SerialUploadReply(SERIAL_UPLOAD_CMD_COMMIT, sequence, SERIAL_UPLOAD_STATUS_OK, len);
+}
+
+/**************************************************************************//**
+* @fn		static bool SerialUploadEnd(uint8_t sequence, const uint8_t *data, uint16_t len)
+* @brief	Checks that every row was written and the signature of the image, then makes it bootable
+* @return	true if the image is installed
+*****************************************************************************/
+static bool SerialUploadEnd(uint8_t sequence, const uint8_t *data, uint16_t len)
+{
+	uint8_t status;
+
+	if(!imageStarted)
+	{
+		SerialUploadReply(SERIAL_UPLOAD_CMD_END, sequence, SERIAL_UPLOAD_STATUS_NO_START, 0);
+		return false;
+	}
+	if(len < ED25519_SIGNATURE_SIZE)
+	{
+		SerialUploadReply(SERIAL_UPLOAD_CMD_END, sequence, SERIAL_UPLOAD_STATUS_BAD_ARG, 0);
+		return false;
+	}
+
+	switch(ImageInstallFinish(data))
+	{
+		case IMAGE_INSTALL_OK:				status = SERIAL_UPLOAD_STATUS_OK; break;
+		case IMAGE_INSTALL_MISSING:			status = SERIAL_UPLOAD_STATUS_MISSING; break;
+		case IMAGE_INSTALL_BAD_SIGNATURE:	status = SERIAL_UPLOAD_STATUS_BAD_SIGNATURE; break;
+		default:							status = SERIAL_UPLOAD_STATUS_WRITE_FAILED; break;
+	}
+	//Rows missing can still be sent. After a signature check the image has to be started again
+	if(status != SERIAL_UPLOAD_STATUS_MISSING) imageStarted = false;
+
+	SerialUploadReply(SERIAL_UPLOAD_CMD_END, sequence, status, 0);
+	return status == SERIAL_UPLOAD_STATUS_OK;
+}
+
+/**************************************************************************//**
+* @fn		static void SerialUploadPut16(uint8_t *buffer, uint16_t value)
+* @brief	Writes a 16-bit value, little endian
+*****************************************************************************/
+static void SerialUploadPut16(uint8_t *buffer, uint16_t value)
+{
+	buffer[0] = (uint8_t) value;
+	buffer[1] = (uint8_t)(value >> 8);
+}
+
+/**************************************************************************//**
+* @fn		static void SerialUploadPut32(uint8_t *buffer, uint32_t value)
+* @brief	Writes a 32-bit value, little endian
+*****************************************************************************/
+static void SerialUploadPut32(uint8_t *buffer, uint32_t value)
+{
+	SerialUploadPut16(buffer, (uint16_t) value);
+	SerialUploadPut16(buffer + 2, (uint16_t)(value >> 16));
+}
+
+/**************************************************************************//**
+* @fn		static uint16_t SerialUploadGet16(const uint8_t *buffer)
+* @brief	Reads a 16-bit value, little endian
+*****************************************************************************/
+static uint16_t SerialUploadGet16(const uint8_t *buffer)
+{
+	return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t SerialUploadGet32(const uint8_t *buffer)
+* @brief	Reads a 32-bit value, little endian
+*****************************************************************************/
+static uint32_t SerialUploadGet32(const uint8_t *buffer)
+{
+	return SerialUploadGet16(buffer) | ((uint32_t) SerialUploadGet16(buffer + 2) << 16);
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		enum eSerialUploadResult SerialUploadRun(uint32_t appStartAddress, uint32_t appEndAddress, uint32_t waitMs)
+* @brief	Listens for a host on the console UART and runs the upload session it starts
+* @details	Timeouts count the time the line is quiet: while bytes arrive the loop does not wait. If the host does not
+*			follow to the baud rate set by HELLO, the device goes back to SERIAL_UPLOAD_BAUDRATE after
+*			SERIAL_UPLOAD_SWITCH_MS. A session ends after SERIAL_UPLOAD_SESSION_MS without a valid packet.
+* @param[in]	appStartAddress First address of the application, row aligned
+* @param[in]	appEndAddress Address after the last row the application may use
+* @param[in]	waitMs How long to listen for HELLO. With SERIAL_UPLOAD_WAIT_FOREVER the function only returns once an
+*				image is written.
+* @return	The outcome of the session
+* @note		Needs the NVM driver configured and interrupts on. The console SERCOM is left reset.
+*****************************************************************************/
+enum eSerialUploadResult SerialUploadRun(uint32_t appStartAddress, uint32_t appEndAddress, uint32_t waitMs)
+{
+	enum eSerialUploadResult result = SERIAL_UPLOAD_NONE;
+	uint32_t quietUs = 0;
+	uint8_t rxChar;
+
+	appStart = appStartAddress;
+	appEnd = appEndAddress;
+	imageStarted = false;
+	windowCount = 0;
+	SerialUploadConfigureUsart(SERIAL_UPLOAD_BAUDRATE);
+
+	while(true)
+	{
+		if(SerialUploadGetByte(&rxChar))
+		{
+			if(SerialUploadDecode(rxChar))
+			{
+				quietUs = 0;
+				result = SERIAL_UPLOAD_FAILED; //A session started. It fails unless END accepts the image
+				if(SerialUploadHandlePacket())
+				{
+					result = SERIAL_UPLOAD_DONE;
+					break;
+				}
+			}
+			continue;
+		}
+
+		delay_cycles_us(SERIAL_UPLOAD_POLL_US);
+		if(quietUs < UINT32_MAX - SERIAL_UPLOAD_POLL_US) quietUs += SERIAL_UPLOAD_POLL_US;
+
+		if(uploadBaudrate != SERIAL_UPLOAD_BAUDRATE && quietUs >= SERIAL_UPLOAD_SWITCH_MS * 1000UL)
+		{
+			SerialUploadConfigureUsart(SERIAL_UPLOAD_BAUDRATE);
+		}
+		if(waitMs != SERIAL_UPLOAD_WAIT_FOREVER)
+		{
+			if(result == SERIAL_UPLOAD_NONE && quietUs >= waitMs * 1000UL) break;
+			if(result == SERIAL_UPLOAD_FAILED && quietUs >= SERIAL_UPLOAD_SESSION_MS * 1000UL) break;
+		}
+	}
+
+	usart_reset(&uploadUsart);
+	system_interrupt_disable(_sercom_get_interrupt_vector(EDBG_CDC_MODULE));
+	uploadUsartConfigured = false;
+	return result;
+}
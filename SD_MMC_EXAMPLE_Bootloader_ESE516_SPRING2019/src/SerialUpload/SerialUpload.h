@@ -0,0 +1,98 @@
+/**************************************************************************//**
+* @file      SerialUpload.h
+* @brief     Writes the main application into NVM from a host on the console UART, without an SD card.
+* @details   At boot the bootloader listens on the console UART (115200 8N1) for a HELLO packet. HELLO names the baud rate
+*			for the rest of the session; both sides switch to it once the answer is sent. The host then sends START,
+*			streams the image as DATA packets of one NVM row each, and after a window of rows sends COMMIT. The
+*			device only programs on COMMIT: the CPU stalls while the flash is erased or written, so bytes arriving
+*			then would be lost. COMMIT answers the rows that were written and read back correctly; the host sends the
+*			others again in a later window. END carries the signature of the image; the rows go through ImageInstall,
+*			which hashes them as they are written and only programs row 0 once the signature is valid.
+*
+*			Packets use the same framing as the application's HostLink: SLIP with END 0xC0 and ESC 0xDB (XON and XOFF
+*			escaped too), then type (1), sequence (1), data, CRC-16/CCITT-FALSE of all previous bytes (2, LSB first).
+*			Answers have type | SERIAL_UPLOAD_RESPONSE, the request sequence and a status byte first.
+*			Requests:
+*			- HELLO: baud rate (4). Answers row size (2), window (1), largest image (4).
+*			- START: image size (4), a whole number of rows: the signed image without its trailer (ImageInstall.h).
+*			  Erases the first row, so an interrupted upload leaves no application to jump to.
+*			- DATA: row index (2), SERIAL_UPLOAD_ROW_SIZE bytes. Not answered. Rows in order hash fastest.
+*			- COMMIT: programs the rows received since the last COMMIT. Answers their indexes (2 each).
+*			- END: Ed25519 signature (64) from the trailer. Checks every row was written and the signature.
+*			All multi-byte values are little endian. tools/boot_upload.py is the host side.
+******************************************************************************/
+
+#ifndef SERIAL_UPLOAD_H
+#define SERIAL_UPLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <asf.h>
+#include "ImageInstall/ImageInstall.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define SERIAL_UPLOAD_END			0xC0	///<Frame delimiter
+#define SERIAL_UPLOAD_ESC			0xDB	///<Escape
+#define SERIAL_UPLOAD_ESC_END		0xDC	///<ESC ESC_END stands for END
+#define SERIAL_UPLOAD_ESC_ESC		0xDD	///<ESC ESC_ESC stands for ESC
+#define SERIAL_UPLOAD_ESC_XON		0xDE	///<ESC ESC_XON stands for XON (0x11)
+#define SERIAL_UPLOAD_ESC_XOFF		0xDF	///<ESC ESC_XOFF stands for XOFF (0x13)
+
+#define SERIAL_UPLOAD_ROW_SIZE		IMAGE_INSTALL_ROW_SIZE	///<Bytes of a DATA packet. One NVM row
+#define SERIAL_UPLOAD_WINDOW		16		///<Most DATA packets between two COMMITs
+#define SERIAL_UPLOAD_MAX_DATA		(2 + SERIAL_UPLOAD_ROW_SIZE)	///<Largest data of a packet: a DATA packet
+#define SERIAL_UPLOAD_HEADER_SIZE	2		///<Type and sequence
+#define SERIAL_UPLOAD_CRC_SIZE		2		///<CRC-16 after the data
+#define SERIAL_UPLOAD_MAX_PACKET	(SERIAL_UPLOAD_HEADER_SIZE + SERIAL_UPLOAD_MAX_DATA + SERIAL_UPLOAD_CRC_SIZE)
+
+#define SERIAL_UPLOAD_BAUDRATE		115200	///<Baud rate until HELLO is answered
+#define SERIAL_UPLOAD_MAX_BAUDRATE	3000000	///<GCLK0 (48 MHz) / 16
+#define SERIAL_UPLOAD_WAIT_MS		100		///<How long a normal boot listens for HELLO
+#define SERIAL_UPLOAD_WAIT_FOREVER	0xFFFFFFFF	///<Listen until an image is written
+#define SERIAL_UPLOAD_SWITCH_MS		1000	///<Quiet time at the new baud rate before going back to SERIAL_UPLOAD_BAUDRATE
+#define SERIAL_UPLOAD_SESSION_MS	10000	///<Quiet time that ends a session
+
+#define SERIAL_UPLOAD_RESPONSE		0x80	///<Set in the type of an answer
+
+#define SERIAL_UPLOAD_CMD_HELLO		0x01	///<Start a session, set the baud rate
+#define SERIAL_UPLOAD_CMD_START		0x02	///<Announce the image
+#define SERIAL_UPLOAD_CMD_DATA		0x03	///<One row of the image
+#define SERIAL_UPLOAD_CMD_COMMIT	0x04	///<Program the rows received
+#define SERIAL_UPLOAD_CMD_END		0x05	///<Check the image and leave
+
+#define SERIAL_UPLOAD_STATUS_OK				0x00	///<Done
+#define SERIAL_UPLOAD_STATUS_UNKNOWN		0x10	///<Unknown request type
+#define SERIAL_UPLOAD_STATUS_BAD_ARG		0x11	///<Data too short or out of range
+#define SERIAL_UPLOAD_STATUS_NO_START		0x12	///<No image announced
+#define SERIAL_UPLOAD_STATUS_MISSING		0x13	///<Rows of the image were not written
+#define SERIAL_UPLOAD_STATUS_BAD_SIGNATURE	0x14	///<The image is not signed with the bootloader's key
+#define SERIAL_UPLOAD_STATUS_WRITE_FAILED	0x15	///<Row 0 did not read back after the signature check
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Outcome of SerialUploadRun
+enum eSerialUploadResult {
+	SERIAL_UPLOAD_NONE = 0,		///<No host answered in time
+	SERIAL_UPLOAD_DONE = 1,		///<A new image was written and checked
+	SERIAL_UPLOAD_FAILED = 2	///<A session started but the image was not completed
+};
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+enum eSerialUploadResult SerialUploadRun(uint32_t appStartAddress, uint32_t appEndAddress, uint32_t waitMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*SERIAL_UPLOAD_H*/
@@ -21,7 +21,7 @@
 /******************************************************************************
 * Variables
 ******************************************************************************/
-static uint32_t ul_tickcount=0 ;	///< Global state variable for tick count
+static volatile uint32_t ul_tickcount=0 ;	///< Global state variable for tick count
 
 /******************************************************************************
 * Forward Declarations
@@ -69,6 +69,54 @@ uint32_t GetSystick(void)
 }
 
 
+/**************************************************************************//**
+* @fn		void InitSystickCycleCounter(void)
+* @brief	Starts SysTick as a free running CPU cycle counter. The interrupt counts the wraps of the 24-bit counter.
+* @note		The delay driver (SYSTICK_MODE) reprograms SysTick on every delay: do not call delay functions between
+*			two reads, and call DeinitSystick then delay_init when done.
+*****************************************************************************/
+void InitSystickCycleCounter(void)
+{
+	SysTick->CTRL = 0;							// Disable SysTick
+	ul_tickcount = 0;
+	SysTick->LOAD = SYSTICK_COUNTER_MAX;		// Wrap every 2^24 cycles
+	NVIC_SetPriority(SysTick_IRQn, 3);			// Set interrupt priority to least urgency
+	SysTick->VAL = 0;							// Reset the SysTick counter value
+	SysTick->CTRL = 0x00000007;					// Enable SysTick, Enable SysTick Exceptions, Use CPU Clock
+	NVIC_EnableIRQ(SysTick_IRQn);				// Enable SysTick Interrupt
+}
+
+
+/**************************************************************************//**
+* @fn		uint32_t GetSystickCycles(void)
+* @brief	Returns the CPU cycles since InitSystickCycleCounter. Wraps after 2^32 cycles, so subtract two reads.
+*****************************************************************************/
+uint32_t GetSystickCycles(void)
+{
+	uint32_t wraps, value;
+
+	//Read again if the counter wrapped between the two reads
+	do
+	{
+		wraps = ul_tickcount;
+		value = SysTick->VAL;
+	} while(wraps != ul_tickcount);
+
+	return (wraps << 24) + (SYSTICK_COUNTER_MAX - value);
+}
+
+
+/**************************************************************************//**
+* @fn		void DeinitSystick(void)
+* @brief	Stops SysTick and its interrupt
+*****************************************************************************/
+void DeinitSystick(void)
+{
+	SysTick->CTRL = 0;
+	NVIC_DisableIRQ(SysTick_IRQn);
+}
+
+
 /******************************************************************************
 * Callback Functions
 ******************************************************************************/
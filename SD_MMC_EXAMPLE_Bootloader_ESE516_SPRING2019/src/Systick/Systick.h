@@ -18,6 +18,7 @@ extern "C" {
 /******************************************************************************
 * Defines
 ******************************************************************************/
+#define SYSTICK_COUNTER_MAX		0xFFFFFFUL	///<SysTick is a 24-bit down counter
 
 /******************************************************************************
 * Structures and Enumerations
@@ -30,6 +31,9 @@ extern "C" {
 ******************************************************************************/
 void InitSystick(void);
 uint32_t GetSystick(void);
+void InitSystickCycleCounter(void);
+uint32_t GetSystickCycles(void);
+void DeinitSystick(void);
 
 #ifdef __cplusplus
 }
@@ -81,7 +81,17 @@ extern "C" {
  * See trcHardwarePort.h for available ports and information on how to
  * define your own port, if not already present.
  ******************************************************************************/
-#define TRC_CFG_HARDWARE_PORT TRC_HARDWARE_PORT_ARM_Cortex_M
+#define TRC_CFG_HARDWARE_PORT TRC_HARDWARE_PORT_APPLICATION_DEFINED
+
+/* The Cortex-M0+ port would timestamp with SysTick, which stops during tickless
+ * idle. Timestamps come from the free-running 32 kHz TC4 run time counter
+ * instead (RuntimeStats.c), which keeps counting while the core sleeps. */
+#define TRC_HWTC_TYPE TRC_FREE_RUNNING_32BIT_INCR
+#define TRC_HWTC_COUNT (RuntimeStatsGetCounter())
+#define TRC_HWTC_PERIOD 0
+#define TRC_HWTC_DIVISOR 1
+#define TRC_HWTC_FREQ_HZ 32768
+#define TRC_IRQ_PRIORITY_ORDER 0
 
 /*******************************************************************************
  * Configuration Macro: TRC_CFG_RECORDER_MODE
@@ -97,7 +107,7 @@ extern "C" {
  * TRC_RECORDER_MODE_SNAPSHOT
  * TRC_RECORDER_MODE_STREAMING
  ******************************************************************************/
-#define TRC_CFG_RECORDER_MODE TRC_RECORDER_MODE_SNAPSHOT
+#define TRC_CFG_RECORDER_MODE TRC_RECORDER_MODE_STREAMING
 
 /******************************************************************************
  * TRC_CFG_FREERTOS_VERSION
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Trace Recorder Library for Tracealyzer v4.3.7
+ * Percepio AB, www.percepio.com
+ *
+ * trcStreamingPort.h
+ *
+ * The interface definitions for trace streaming ("stream ports").
+ * This "stream port" sets up the recorder to stream over a SAM D21 SERCOM UART,
+ * using the internal paged event buffer of the recorder core.
+ *
+ * Terms of Use
+ * This file is part of the trace recorder library (RECORDER), which is the 
+ * intellectual property of Percepio AB (PERCEPIO) and provided under a
+ * license as follows.
+ * The RECORDER may be used free of charge for the purpose of recording data
+ * intended for analysis in PERCEPIO products. It may not be used or modified
+ * for other purposes without explicit permission from PERCEPIO.
+ * You may distribute the RECORDER in its original source code form, assuming
+ * this text (terms of use, disclaimer, copyright notice) is unchanged. You are
+ * allowed to distribute the RECORDER with minor modifications intended for
+ * configuration or porting of the RECORDER, e.g., to allow using it on a 
+ * specific processor, processor family or with a specific communication
+ * interface. Any such modifications should be documented directly below
+ * this comment block.  
+ *
+ * Disclaimer
+ * The RECORDER is being delivered to you AS IS and PERCEPIO makes no warranty
+ * as to its use or performance. PERCEPIO does not and cannot warrant the 
+ * performance or results you may obtain by using the RECORDER or documentation.
+ * PERCEPIO make no warranties, express or implied, as to noninfringement of
+ * third party rights, merchantability, or fitness for any particular purpose.
+ * In no event will PERCEPIO, its technology partners, or distributors be liable
+ * to you for any consequential, incidental or special damages, including any
+ * lost profits or lost savings, even if a representative of PERCEPIO has been
+ * advised of the possibility of such damages, or for any claim by any third
+ * party. Some jurisdictions do not allow the exclusion or limitation of
+ * incidental, consequential or special damages, or the exclusion of implied
+ * warranties or limitations on how long an implied warranty may last, so the
+ * above limitations may not apply to you.
+ *
+ * Tabs are used for indent in this file (1 tab = 4 spaces)
+ *
+ * Copyright Percepio AB, 2018.
+ * www.percepio.com
+ ******************************************************************************/
+
+#ifndef TRC_STREAMING_PORT_H
+#define TRC_STREAMING_PORT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+ * Configuration Macro: TRC_CFG_UART_SERCOM and the pin settings
+ *
+ * SERCOM and pins of the trace UART. The defaults use SERCOM3 with TX on EXT3
+ * pin 7 (PA22) and RX on EXT1 pin 10 (PA21) of the SAM W25 Xplained Pro.
+ * Connect a 3.3 V USB serial adapter there and capture with
+ * tools/trace_capture.py.
+ *
+ * SERCOM3 is the only SERCOM the firmware leaves free: SERCOM0 is the sensor
+ * I2C bus, SERCOM1 the SD card, SERCOM2 the WINC1500, SERCOM4 the console and
+ * SERCOM5 the US-100. Its PA20 pad is not usable, since PA20 is the EXT1 IRQ
+ * pin that carries the Seesaw INT line (SEESAW_INT_PIN), and PA23 is LED0 and
+ * PA24/PA25 are USB. That leaves PA22 (PAD0) for TX and PA21 (PAD3) for RX.
+ ******************************************************************************/
+#define TRC_CFG_UART_SERCOM				SERCOM3
+#define TRC_CFG_UART_MUX_SETTING		USART_RX_3_TX_0_XCK_1
+#define TRC_CFG_UART_PINMUX_PAD0		PINMUX_PA22C_SERCOM3_PAD0
+#define TRC_CFG_UART_PINMUX_PAD1		PINMUX_UNUSED
+#define TRC_CFG_UART_PINMUX_PAD2		PINMUX_UNUSED
+#define TRC_CFG_UART_PINMUX_PAD3		PINMUX_PA21D_SERCOM3_PAD3
+
+/*******************************************************************************
+ * Configuration Macro: TRC_CFG_UART_BAUDRATE
+ *
+ * Baud rate of the trace UART. At 921600 baud a 256 byte buffer page is sent
+ * in about 3 ms.
+ ******************************************************************************/
+#define TRC_CFG_UART_BAUDRATE			921600
+
+/*******************************************************************************
+ * Configuration Macro: TRC_CFG_UART_RX_BUFFER_SIZE
+ *
+ * Size of the buffer that holds the Tracealyzer commands (start/stop) received
+ * from the host. A command is 8 bytes.
+ ******************************************************************************/
+#define TRC_CFG_UART_RX_BUFFER_SIZE		32
+
+/*******************************************************************************
+ * Configuration Macro: TRC_CFG_UART_WRITE_TIMEOUT_MS
+ *
+ * Longest time a buffer page may take to go out. The recorder is stopped if
+ * a page does not make it in time.
+ ******************************************************************************/
+#define TRC_CFG_UART_WRITE_TIMEOUT_MS	100
+
+void prvTraceUartInit(void);
+
+int32_t prvTraceUartWrite(void* data, uint32_t size, int32_t *ptrBytesWritten);
+
+int32_t prvTraceUartRead(void* data, uint32_t size, int32_t *ptrBytesRead);
+
+/* The UART is driven from the TzCtrl task, which blocks while a page is sent.
+The internal paged event buffer is therefore required. */
+#define TRC_STREAM_PORT_USE_INTERNAL_BUFFER 1
+
+#define TRC_STREAM_PORT_READ_DATA(_ptrData, _size, _ptrBytesRead) prvTraceUartRead(_ptrData, _size, _ptrBytesRead)
+
+#define TRC_STREAM_PORT_WRITE_DATA(_ptrData, _size, _ptrBytesSent) prvTraceUartWrite(_ptrData, _size, _ptrBytesSent)
+
+#define TRC_STREAM_PORT_INIT() \
+		TRC_STREAM_PORT_MALLOC(); /* Empty if static allocation mode */ \
+		prvPagedEventBufferInit(_TzTraceData); \
+		prvTraceUartInit()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRC_STREAMING_PORT_H */
@@ -0,0 +1,200 @@
+/*******************************************************************************
+ * Trace Recorder Library for Tracealyzer v4.3.7
+ * Percepio AB, www.percepio.com
+ *
+ * trcStreamingPort.c
+ *
+ * Supporting functions for trace streaming over a SAM D21 SERCOM UART.
+ * Buffer pages are sent with an interrupt driven ASF USART job while the
+ * TzCtrl task waits on its task notification. Received bytes are collected
+ * in a ring buffer and handed to the recorder as Tracealyzer commands.
+ *
+ * Terms of Use
+ * This file is part of the trace recorder library (RECORDER), which is the 
+ * intellectual property of Percepio AB (PERCEPIO) and provided under a
+ * license as follows.
+ * The RECORDER may be used free of charge for the purpose of recording data
+ * intended for analysis in PERCEPIO products. It may not be used or modified
+ * for other purposes without explicit permission from PERCEPIO.
+ * You may distribute the RECORDER in its original source code form, assuming
+ * this text (terms of use, disclaimer, copyright notice) is unchanged. You are
+ * allowed to distribute the RECORDER with minor modifications intended for
+ * configuration or porting of the RECORDER, e.g., to allow using it on a 
+ * specific processor, processor family or with a specific communication
+ * interface. Any such modifications should be documented directly below
+ * this comment block.  
+ *
+ * Disclaimer
+ * The RECORDER is being delivered to you AS IS and PERCEPIO makes no warranty
+ * as to its use or performance. PERCEPIO does not and cannot warrant the 
+ * performance or results you may obtain by using the RECORDER or documentation.
+ * PERCEPIO make no warranties, express or implied, as to noninfringement of
+ * third party rights, merchantability, or fitness for any particular purpose.
+ * In no event will PERCEPIO, its technology partners, or distributors be liable
+ * to you for any consequential, incidental or special damages, including any
+ * lost profits or lost savings, even if a representative of PERCEPIO has been
+ * advised of the possibility of such damages, or for any claim by any third
+ * party. Some jurisdictions do not allow the exclusion or limitation of
+ * incidental, consequential or special damages, or the exclusion of implied
+ * warranties or limitations on how long an implied warranty may last, so the
+ * above limitations may not apply to you.
+ *
+ * Tabs are used for indent in this file (1 tab = 4 spaces)
+ *
+ * Copyright Percepio AB, 2018.
+ * www.percepio.com
+ ******************************************************************************/
+
+#include "trcRecorder.h"
+
+#if (TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING)  
+#if (TRC_USE_TRACEALYZER_RECORDER == 1)
+
+#include <string.h>
+#include "asf.h"
+#include "SerialConsole/circular_buffer.h"
+
+static struct usart_module trcUart;
+static uint8_t trcUartReady = 0;
+static volatile TaskHandle_t trcUartWriter = NULL;
+
+static cbuf_handle_t trcRxBuffer = NULL;
+static uint8_t trcRxStorage[TRC_CFG_UART_RX_BUFFER_SIZE];
+static uint8_t trcRxByte;
+static uint8_t trcCommand[sizeof(TracealyzerCommandType)];
+static uint32_t trcCommandLength = 0;
+
+static void prvTraceUartWriteDone(struct usart_module *const module)
+{
+	BaseType_t woken = pdFALSE;
+
+	(void)module;
+	if (trcUartWriter != NULL)
+	{
+		vTaskNotifyGiveFromISR(trcUartWriter, &woken);
+	}
+	portYIELD_FROM_ISR(woken);
+}
+
+static void prvTraceUartReadDone(struct usart_module *const module)
+{
+	(void)module;
+	circular_buf_put(trcRxBuffer, trcRxByte);
+	usart_read_buffer_job(&trcUart, &trcRxByte, 1);
+}
+
+void prvTraceUartInit(void)
+{
+	struct usart_config config;
+
+	if (trcUartReady)
+	{
+		return;
+	}
+
+	trcRxBuffer = circular_buf_init(trcRxStorage, sizeof(trcRxStorage));
+	if (trcRxBuffer == NULL)
+	{
+		return;
+	}
+
+	usart_get_config_defaults(&config);
+	config.baudrate = TRC_CFG_UART_BAUDRATE;
+	config.mux_setting = TRC_CFG_UART_MUX_SETTING;
+	config.pinmux_pad0 = TRC_CFG_UART_PINMUX_PAD0;
+	config.pinmux_pad1 = TRC_CFG_UART_PINMUX_PAD1;
+	config.pinmux_pad2 = TRC_CFG_UART_PINMUX_PAD2;
+	config.pinmux_pad3 = TRC_CFG_UART_PINMUX_PAD3;
+
+	if (usart_init(&trcUart, TRC_CFG_UART_SERCOM, &config) != STATUS_OK)
+	{
+		return;
+	}
+
+	usart_register_callback(&trcUart, prvTraceUartWriteDone, USART_CALLBACK_BUFFER_TRANSMITTED);
+	usart_register_callback(&trcUart, prvTraceUartReadDone, USART_CALLBACK_BUFFER_RECEIVED);
+	usart_enable_callback(&trcUart, USART_CALLBACK_BUFFER_TRANSMITTED);
+	usart_enable_callback(&trcUart, USART_CALLBACK_BUFFER_RECEIVED);
+	usart_enable(&trcUart);
+	usart_read_buffer_job(&trcUart, &trcRxByte, 1);
+
+	trcUartReady = 1;
+}
+
+int32_t prvTraceUartWrite(void* data, uint32_t size, int32_t *ptrBytesWritten)
+{
+	if (ptrBytesWritten != NULL)
+	{
+		*ptrBytesWritten = 0;
+	}
+
+	if (!trcUartReady || size > 0xFFFF)
+	{
+		return -1;
+	}
+
+	/* Called from TzCtrl only. The page stays valid until this returns. */
+	trcUartWriter = xTaskGetCurrentTaskHandle();
+	(void)ulTaskNotifyTake(pdTRUE, 0);
+	if (usart_write_buffer_job(&trcUart, (uint8_t*)data, (uint16_t)size) != STATUS_OK)
+	{
+		return -1;
+	}
+
+	if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TRC_CFG_UART_WRITE_TIMEOUT_MS)) == 0)
+	{
+		usart_abort_job(&trcUart, USART_TRANSCEIVER_TX);
+		return -1;
+	}
+
+	if (ptrBytesWritten != NULL)
+	{
+		*ptrBytesWritten = (int32_t)size;
+	}
+	return 0;
+}
+
+int32_t prvTraceUartRead(void* data, uint32_t size, int32_t *ptrBytesRead)
+{
+	uint16_t checksum;
+	uint32_t i;
+
+	*ptrBytesRead = 0;
+
+	/* A failed read would stop the recorder, so a missing UART just reads nothing. */
+	if (!trcUartReady || size != sizeof(trcCommand))
+	{
+		return 0;
+	}
+
+	while (trcCommandLength < size && circular_buf_get(trcRxBuffer, &trcCommand[trcCommandLength]) == 0)
+	{
+		trcCommandLength++;
+
+		if (trcCommandLength == size)
+		{
+			/* Same checksum as prvIsValidCommand. On a mismatch, drop one byte to find the start of the next command. */
+			checksum = 0xFFFF;
+			for (i = 0; i < 6; i++)
+			{
+				checksum -= trcCommand[i];
+			}
+			if (trcCommand[6] != (uint8_t)(checksum & 0xFF) || trcCommand[7] != (uint8_t)(checksum >> 8))
+			{
+				memmove(&trcCommand[0], &trcCommand[1], size - 1);
+				trcCommandLength--;
+			}
+		}
+	}
+
+	if (trcCommandLength == size)
+	{
+		memcpy(data, trcCommand, size);
+		*ptrBytesRead = (int32_t)size;
+		trcCommandLength = 0;
+	}
+	return 0;
+}
+
+#endif /*(TRC_USE_TRACEALYZER_RECORDER == 1)*/
+#endif /*(TRC_CFG_RECORDER_MODE == TRC_RECORDER_MODE_STREAMING)*/
@@ -2026,6 +2026,8 @@ void prvPagedEventBufferInit(char* buffer)
 		PageInfo[i].WritePointer = &EventBuffer[i * (TRC_CFG_PAGED_EVENT_BUFFER_PAGE_SIZE)];
 		PageInfo[i].Status = PAGE_STATUS_FREE;
 	}
+	/* All pages are free again, also those left partly written when the previous session stopped */
+	TotalBytesRemaining = (TRC_CFG_PAGED_EVENT_BUFFER_PAGE_COUNT) * (TRC_CFG_PAGED_EVENT_BUFFER_PAGE_SIZE);
 	TRACE_EXIT_CRITICAL_SECTION();
 
 }
@@ -13,8 +13,10 @@
  * Contributors:
  *    Allan Stockdill-Mander/Ian Craggs - initial API and implementation and/or initial documentation
  *    Microchip Technologies            - Fixed crash issues in subscribe function
+ *    Exact topic filters are dispatched through a hash table built at subscribe time
  *******************************************************************************/
 #include "MQTTClient.h"
+#include <string.h>
 
 /*Function prototypes to remove build warnings*/
 int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message);
@@ -30,6 +32,49 @@ static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage*
 }
 
 
+/* FNV-1a hash of a topic name or filter */
+static unsigned int topicHash(const char* data, int len)
+{
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < len; ++i)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/* Rebuilds the exact-match topic table from the message handlers. Only called when subscriptions change. */
+static void buildTopicTable(MQTTClient* c)
+{
+    int i;
+
+    c->wildcardHandlers = 0;
+    for (i = 0; i < MQTT_TOPIC_TABLE_SIZE; ++i)
+        c->topicTable[i] = -1;
+
+    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+    {
+        unsigned int slot;
+
+        if (c->messageHandlers[i].topicFilter == 0)
+            continue;
+        if (c->messageHandlers[i].wildcard)
+        {
+            c->wildcardHandlers++;
+            continue;
+        }
+        slot = c->messageHandlers[i].hash & (MQTT_TOPIC_TABLE_SIZE - 1);
+        while (c->topicTable[slot] != -1)
+            slot = (slot + 1) & (MQTT_TOPIC_TABLE_SIZE - 1);
+        c->topicTable[slot] = (int16_t)i;
+    }
+}
+
+
 static int getNextPacketId(MQTTClient *c) {
     return c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
 }
@@ -66,6 +111,7 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
     
     for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
         c->messageHandlers[i].topicFilter = 0;
+    buildTopicTable(c);
     c->command_timeout_ms = command_timeout_ms;
     c->buf = sendbuf;
     c->buf_size = sendbuf_size;
@@ -110,6 +156,7 @@ exit:
 }
 
 
+/* Returns the packet type, 0 if nothing arrived in time, or a negative value if the network failed */
 static int readPacket(MQTTClient* c, Timer* timer)
 {
     int rc = FAILURE;
@@ -118,7 +165,8 @@ static int readPacket(MQTTClient* c, Timer* timer)
     int rem_len = 0;
 
     /* 1. read the header byte.  This has the packet type in it */
-    if (c->ipstack->mqttread(c->ipstack, c->readbuf, 1, TimerLeftMS(timer)) != 1)
+    rc = c->ipstack->mqttread(c->ipstack, c->readbuf, 1, TimerLeftMS(timer));
+    if (rc != 1)
         goto exit;
 
     len = 1;
@@ -128,7 +176,10 @@ static int readPacket(MQTTClient* c, Timer* timer)
 
     /* 3. read the rest of the buffer using a callback to supply the rest of the data */
     if (rem_len > 0 && (c->ipstack->mqttread(c->ipstack, c->readbuf + len, rem_len, TimerLeftMS(timer)) != rem_len))
+    {
+        rc = FAILURE; /* a packet cut short leaves the stream out of step */
         goto exit;
+    }
 
     header.byte = c->readbuf[0];
     rc = header.bits.type;
@@ -172,12 +223,31 @@ int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 {
     int i;
     int rc = FAILURE;
+    unsigned int hash = topicHash(topicName->lenstring.data, topicName->lenstring.len);
+    unsigned int slot = hash & (MQTT_TOPIC_TABLE_SIZE - 1);
 
-    // we have to find the right message handler - indexed by topic
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+    // exact topic filters are looked up in the topic table
+    while ((i = c->topicTable[slot]) != -1)
+    {
+        if (c->messageHandlers[i].hash == hash && MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter))
+        {
+            if (c->messageHandlers[i].fp != NULL)
+            {
+                MessageData md;
+                NewMessageData(&md, topicName, message);
+                c->messageHandlers[i].fp(&md);
+                rc = SUCCESS;
+            }
+            break;
+        }
+        slot = (slot + 1) & (MQTT_TOPIC_TABLE_SIZE - 1);
+    }
+
+    // wildcard filters still have to be matched one by one
+    for (i = 0; i < MAX_MESSAGE_HANDLERS && c->wildcardHandlers > 0; ++i)
     {
-        if (c->messageHandlers[i].topicFilter != 0 && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
-                isTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName)))
+        if (c->messageHandlers[i].topicFilter != 0 && c->messageHandlers[i].wildcard &&
+                isTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName))
         {
             if (c->messageHandlers[i].fp != NULL)
             {
@@ -203,17 +273,16 @@ int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 
 int keepalive(MQTTClient* c)
 {
-    int rc = FAILURE;
+    int rc = SUCCESS;
 
     if (c->keepAliveInterval == 0)
-    {
-        rc = SUCCESS;
         goto exit;
-    }
 
     if (TimerIsExpired(&c->ping_timer))
     {
-        if (!c->ping_outstanding)
+        if (c->ping_outstanding)
+            rc = FAILURE; /* no PINGRESP within a keep alive interval: the connection is half open */
+        else
         {
             Timer timer;
             TimerInit(&timer);
@@ -221,6 +290,8 @@ int keepalive(MQTTClient* c)
             int len = MQTTSerialize_pingreq(c->buf, c->buf_size);
             if (len > 0 && (rc = sendPacket(c, len, &timer)) == SUCCESS) // send the ping packet
                 c->ping_outstanding = 1;
+            else
+                rc = FAILURE;
         }
     }
 
@@ -232,11 +303,17 @@ exit:
 int cycle(MQTTClient* c, Timer* timer)
 {
     // read the socket, see what work is due
-    unsigned short packet_type = readPacket(c, timer);
+    int packet_type = readPacket(c, timer);
     
     int len = 0,
         rc = SUCCESS;
 
+    if (packet_type < 0)
+    {
+        rc = FAILURE; // the connection is gone
+        goto exit;
+    }
+
     switch (packet_type)
     {
         case CONNACK:
@@ -288,7 +365,8 @@ int cycle(MQTTClient* c, Timer* timer)
             c->ping_outstanding = 0;
             break;
     }
-    keepalive(c);
+    if (keepalive(c) != SUCCESS)
+        rc = FAILURE;
 exit:
     if (rc == SUCCESS)
         rc = packet_type;
@@ -355,7 +433,7 @@ int waitfor(MQTTClient* c, int packet_type, Timer* timer)
         if (TimerIsExpired(timer))
             break; // we timed out
     }
-    while ((rc = cycle(c, timer)) != packet_type);  
+    while ((rc = cycle(c, timer)) != packet_type && rc >= 0);  
     
     return rc;
 }
@@ -380,6 +458,7 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
     if (options == 0)
         options = &default_options; /* set default options if none were supplied */
     
+    c->sessionPresent = 0;
     c->keepAliveInterval = options->keepAliveInterval;
     TimerCountdown(&c->ping_timer, c->keepAliveInterval);
     if ((len = MQTTSerialize_connect(c->buf, c->buf_size, options)) <= 0)
@@ -393,7 +472,10 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
         unsigned char connack_rc = 255;
         unsigned char sessionPresent = 0;
         if (MQTTDeserialize_connack(&sessionPresent, &connack_rc, c->readbuf, c->readbuf_size) == 1)
+        {
             rc = connack_rc;
+            c->sessionPresent = sessionPresent;
+        }
         else
             rc = FAILURE;
     }
@@ -445,17 +527,28 @@ int MQTTSubscribe(MQTTClient* c, const char* topicFilter, enum QoS qos, messageH
             rc = grantedQoS; // 0, 1, 2 or 0x80 
         if (rc != 0x80)
         {
-            int i;
+            int i, handler = -1;
             for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
             {
-                if (c->messageHandlers[i].topicFilter == 0)
+                if (c->messageHandlers[i].topicFilter != 0 && strcmp(c->messageHandlers[i].topicFilter, topicFilter) == 0)
                 {
-                    c->messageHandlers[i].topicFilter = topicFilter;
-                    c->messageHandlers[i].fp = msgHandler;
-                    rc = 0;
+                    handler = i; // subscribing again to the same filter replaces its handler
                     break;
                 }
+                if (c->messageHandlers[i].topicFilter == 0 && handler == -1)
+                    handler = i;
             }
+            if (handler != -1)
+            {
+                c->messageHandlers[handler].topicFilter = topicFilter;
+                c->messageHandlers[handler].fp = msgHandler;
+                c->messageHandlers[handler].hash = topicHash(topicFilter, strlen(topicFilter));
+                c->messageHandlers[handler].wildcard = (strpbrk(topicFilter, "+#") != NULL);
+                buildTopicTable(c);
+                rc = 0;
+            }
+            else
+                rc = FAILURE; // no free handler slot, the messages would only reach the default handler
         }
     }
     else 
@@ -495,7 +588,16 @@ int MQTTUnsubscribe(MQTTClient* c, const char* topicFilter)
     {
         unsigned short mypacketid;  // should be the same as the packetid above
         if (MQTTDeserialize_unsuback(&mypacketid, c->readbuf, c->readbuf_size) == 1)
-            rc = 0; 
+        {
+            int i;
+            for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+            {
+                if (c->messageHandlers[i].topicFilter != 0 && strcmp(c->messageHandlers[i].topicFilter, topicFilter) == 0)
+                    c->messageHandlers[i].topicFilter = 0;
+            }
+            buildTopicTable(c);
+            rc = 0;
+        }
     }
     else
         rc = FAILURE;
@@ -35,6 +35,7 @@
 
 #include "MQTTPacket/MQTTPacket.h"
 #include "stdio.h"
+#include "stdint.h"
 //Microchip ATxx Wireless platform specific port
 #include "MQTTClient/Platforms/mqtt_platform.h"
 
@@ -54,6 +55,18 @@
 #define MAX_MESSAGE_HANDLERS 5 /* redefinable - how many subscriptions do you want? */
 #endif
 
+#if !defined(MQTT_TOPIC_TABLE_SIZE)
+#define MQTT_TOPIC_TABLE_SIZE 8 /* redefinable - power of two larger than MAX_MESSAGE_HANDLERS, slots of the exact-match topic table */
+#endif
+
+#if (MQTT_TOPIC_TABLE_SIZE & (MQTT_TOPIC_TABLE_SIZE - 1)) || (MQTT_TOPIC_TABLE_SIZE <= MAX_MESSAGE_HANDLERS)
+#error "MQTT_TOPIC_TABLE_SIZE must be a power of two larger than MAX_MESSAGE_HANDLERS"
+#endif
+
+#if MAX_MESSAGE_HANDLERS > INT16_MAX
+#error "MAX_MESSAGE_HANDLERS must fit the int16_t entries of the topic table"
+#endif
+
 enum QoS { QOS0, QOS1, QOS2 };
 
 /* all failure return codes must be negative */
@@ -105,13 +118,19 @@ typedef struct MQTTClient
     unsigned int keepAliveInterval;
     char ping_outstanding;
     int isconnected;
+    unsigned char sessionPresent;                 /* broker still held our session on the last CONNACK (clean session = 0) */
 
     struct MessageHandlers
     {
         const char* topicFilter;
         void (*fp) (MessageData*);
+        unsigned int hash;                        /* hash of topicFilter, used by the exact-match topic table */
+        char wildcard;                            /* topicFilter contains + or # and has to be matched one by one */
     } messageHandlers[MAX_MESSAGE_HANDLERS];      /* Message handlers are indexed by subscription topic */
 
+    int16_t topicTable[MQTT_TOPIC_TABLE_SIZE];    /* open addressed hash of exact topic filters, holds the messageHandlers index or -1 */
+    int wildcardHandlers;                          /* number of message handlers with a wildcard filter */
+
     void (*defaultMessageHandler) (MessageData*);
 
     Network* ipstack;
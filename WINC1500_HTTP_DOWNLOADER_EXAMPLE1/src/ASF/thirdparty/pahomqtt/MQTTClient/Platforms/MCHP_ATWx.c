@@ -18,6 +18,8 @@
  */
 
 #include "MCHP_ATWx.h"
+#include "FreeRTOS.h"
+#include "task.h"
 #include "MQTTClient/Wrapper/mqtt.h"
 #include "driver/include/m2m_wifi.h"
 #include "socket/include/socket.h"
@@ -31,14 +33,16 @@ static int32_t gi32MQTTBrokerIp=0;
 static int32_t gi32MQTTBrokerRxLen=0;
 static bool gbMQTTBrokerIpresolved=false;
 static bool gbMQTTBrokerConnected=false;
+static int8_t gi8MQTTBrokerConnectError=SOCK_ERR_NO_ERROR;
 static bool gbMQTTBrokerSendDone=false;
+static int16_t gi16MQTTBrokerSendResult=0;
 static bool gbMQTTBrokerRecvDone=false;
 static unsigned char gcMQTTRxFIFO[MQTT_RX_POOL_SIZE];
 static uint32_t gu32MQTTRxFIFOPtr=0;
 static uint32_t gu32MQTTRxFIFOLen=0;
 static char *gpcHostAddr;
 
-static bool isMQTTSocket(SOCKET sock)
+bool isMQTTSocket(SOCKET sock)
 {
 	unsigned int cIdx;
 	struct mqtt_module *mqttInstance;
@@ -55,6 +59,11 @@ static bool isMQTTSocket(SOCKET sock)
 	return false;
 }
 
+bool isMQTTHostResolving(const uint8_t *hostName)
+{
+	return (gbMQTTBrokerIpresolved == false) && (gpcHostAddr != NULL) && (!strcmp((const char *)gpcHostAddr, (const char *)hostName));
+}
+
 void dnsResolveCallback(uint8_t *hostName, uint32_t hostIp)
 {
 	if((gbMQTTBrokerIpresolved == false) && (!strcmp((const char *)gpcHostAddr, (const char *)hostName)))
@@ -74,6 +83,8 @@ void tcpClientSocketEventHandler(SOCKET sock, uint8_t u8Msg, void *pvMsg)
 		switch (u8Msg) {
 			case SOCKET_MSG_CONNECT:
 			{
+				tstrSocketConnectMsg* pstrConnect = (tstrSocketConnectMsg*)pvMsg;
+				gi8MQTTBrokerConnectError = (pstrConnect != NULL) ? pstrConnect->s8Error : SOCK_ERR_INVALID;
 				gbMQTTBrokerConnected=true;
 				#ifdef MQTT_PLATFORM_DBG
 				printf("INFO >> Successfully connected Broker Socket.\r\n");
@@ -82,6 +93,7 @@ void tcpClientSocketEventHandler(SOCKET sock, uint8_t u8Msg, void *pvMsg)
 			break;
 			case SOCKET_MSG_SEND:
 			{
+				gi16MQTTBrokerSendResult = (pvMsg != NULL) ? *(int16_t*)pvMsg : SOCK_ERR_INVALID;
 				gbMQTTBrokerSendDone=true;
 				#ifdef MQTT_PLATFORM_DBG
 				printf("INFO >> Successfully sent message via Broker Socket.\r\n");
@@ -124,7 +136,7 @@ void TimerCountdownMS(Timer* timer, unsigned int timeout) {
 
 
 void TimerCountdown(Timer* timer, unsigned int timeout) {
-	timer->end_time = xTaskGetTickCount(); + (timeout * 1000);
+	timer->end_time = xTaskGetTickCount() + (timeout * 1000);
 }
 
 
@@ -184,7 +196,8 @@ static int WINC1500_read(Network* n, unsigned char* buffer, int len, int timeout
 		  #ifdef MQTT_PLATFORM_DBG
 		  printf("DEBUG >> no data to send. returning error code (%d)\r\n",gi32MQTTBrokerRxLen);
 		  #endif
-		  return gi32MQTTBrokerRxLen; //this corresponds to the error code.
+		  //Nothing read in time is not an error. Any other result means the broker or the network closed the socket.
+		  return (gi32MQTTBrokerRxLen == SOCK_ERR_TIMEOUT) ? 0 : -1;
 	  }
   }
   //return data to client from data present in the FIFO from previous recv()
@@ -215,6 +228,10 @@ static int WINC1500_write(Network* n, unsigned char* buffer, int len, int timeou
   while (false==gbMQTTBrokerSendDone){
 	  m2m_wifi_handle_events(NULL);
   }
+  //A negative count is the error of a socket the broker or the network closed
+  if (gi16MQTTBrokerSendResult < 0){
+	  return -1;
+  }
   
   #ifdef MQTT_PLATFORM_DBG
   printf("DEBUG >> sent data through socket: \r\n");
@@ -235,6 +252,9 @@ static void WINC1500_disconnect(Network* n) {
 	close(n->socket);
 	n->socket=-1;
 	gbMQTTBrokerConnected=false;
+	//bytes left from the old connection must not be read as the start of a new one
+	gu32MQTTRxFIFOLen=0;
+	gu32MQTTRxFIFOPtr=0;
 }
 
 
@@ -292,6 +312,15 @@ int ConnectNetwork(Network* n, char* addr, int port, int TLSFlag){
   while(false==gbMQTTBrokerConnected){
     m2m_wifi_handle_events(NULL);
   }
+
+  /* Refused or unreachable: close the socket so that the next attempt starts from a new one */
+  if (gi8MQTTBrokerConnectError < 0) {
+   #ifdef MQTT_PLATFORM_DBG
+   printf("ERROR >> connect failed (%d).\r\n", gi8MQTTBrokerConnectError);
+   #endif
+   WINC1500_disconnect(n);
+   return gi8MQTTBrokerConnectError;
+  }
   
   /* Success */
   #ifdef MQTT_PLATFORM_DBG
@@ -52,6 +52,8 @@ int ConnectNetwork(Network*, char*, int, int);
 
 void tcpClientSocketEventHandler(SOCKET, uint8_t, void*);
 void dnsResolveCallback(uint8_t*, uint32_t);
+bool isMQTTSocket(SOCKET);
+bool isMQTTHostResolving(const uint8_t*);
 
 void SysTick_Handler_MQTT(void);
 
@@ -24,6 +24,7 @@ struct mqtt_client_pool mqttClientPool[MQTT_MAX_CLIENTS] = {0,};
 
 static void allocateClient(struct mqtt_module *module);
 static void deAllocateClient(struct mqtt_module *module);
+static void connectionLost(struct mqtt_module *const module, int reason);
 
 static void allocateClient(struct mqtt_module *module)
 {
@@ -61,6 +62,21 @@ static void deAllocateClient(struct mqtt_module *module)
 	}
 }
 
+/* The broker or the network dropped the connection: close the socket and report it as a disconnect */
+static void connectionLost(struct mqtt_module *const module, int reason)
+{
+	union mqtt_data disconnectResult;
+
+	module->network.disconnect(&(module->network));
+	module->client->isconnected = 0;
+	module->client->ping_outstanding = 0;
+	module->isConnected = false;
+
+	disconnectResult.disconnected.reason = reason;
+	if(module->callback)
+		module->callback(module, MQTT_CALLBACK_DISCONNECTED, &disconnectResult);
+}
+
 int mqtt_init(struct mqtt_module *module, struct mqtt_config *config)
 {
 	unsigned int timeout_ms;
@@ -138,6 +154,16 @@ void mqtt_socket_resolve_handler(uint8_t *domain_name, uint32_t server_ip)
 	dnsResolveCallback(domain_name, server_ip);
 }
 
+bool mqtt_is_socket(SOCKET sock)
+{
+	return isMQTTSocket(sock);
+}
+
+bool mqtt_is_resolving(const uint8_t *domain_name)
+{
+	return isMQTTHostResolving(domain_name);
+}
+
 int mqtt_connect(struct mqtt_module *module, const char *host)
 {
 	union mqtt_data connResult;
@@ -159,6 +185,7 @@ int mqtt_connect_broker(struct mqtt_module *const module, uint8_t clean_session,
 	connectData.username.cstring = (char *)id;
 	connectData.password.cstring = (char *)password;
 	connectData.cleansession = clean_session;
+	connectData.keepAliveInterval = module->config.keep_alive;
 	connectData.will.topicName.cstring = (char *)will_topic;
 	connectData.will.message.cstring = (char *)will_msg;
 	connectData.will.retained = will_retain;
@@ -169,11 +196,14 @@ int mqtt_connect_broker(struct mqtt_module *const module, uint8_t clean_session,
 		
 	rc = MQTTConnect(module->client, &connectData);
 	
+	module->isConnected = (rc == SUCCESS);
+	if(!module->isConnected)
+		module->network.disconnect(&(module->network)); /* The next attempt starts from a new socket */
 	connBrokerResult.connected.result = rc;
+	connBrokerResult.connected.session_present = module->client->sessionPresent;
 	if(module->callback)
 		module->callback(module, MQTT_CALLBACK_CONNECTED, &connBrokerResult);
 	
-	module->isConnected = true;
 	return rc;
 }
 
@@ -205,6 +235,8 @@ int mqtt_publish(struct mqtt_module *const module, const char *topic, const char
 	mqttMsg.retained = retain;
 	
 	rc = MQTTPublish(module->client, topic, &mqttMsg);
+	if(rc != SUCCESS && module->isConnected)
+		connectionLost(module, rc);
 	
 	if(module->callback)
 		module->callback(module, MQTT_CALLBACK_PUBLISHED, NULL);
@@ -238,5 +270,8 @@ int mqtt_unsubscribe(struct mqtt_module *module, const char *topic)
 
 int mqtt_yield(struct mqtt_module *module, int timeout_ms)
 {
-	return MQTTYield(module->client, timeout_ms);
+	int rc = MQTTYield(module->client, timeout_ms);
+	if(rc != SUCCESS && module->isConnected)
+		connectionLost(module, rc);
+	return rc;
 }
\ No newline at end of file
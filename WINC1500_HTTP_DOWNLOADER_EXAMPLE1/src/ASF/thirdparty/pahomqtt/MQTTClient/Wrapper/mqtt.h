@@ -173,6 +173,8 @@ struct mqtt_data_sock_connected {
 struct mqtt_data_connected {
 	/** Result of operation. */
 	enum mqtt_conn_result result;
+	/** Broker resumed the previous session, so its subscriptions are still active. Only possible with clean_session = 0. */
+	uint8_t session_present;
 };
 
 /**
@@ -427,6 +429,24 @@ void mqtt_socket_event_handler(SOCKET sock, uint8_t msg_type, void *msg_data);
  */
 void mqtt_socket_resolve_handler(uint8_t *doamin_name, uint32_t server_ip);
 
+/**
+ * \brief Check if a socket is used by an MQTT instance.
+ *
+ * \param[in]  sock            Socket descriptor.
+ *
+ * \return     true if the socket belongs to an MQTT instance.
+ */
+bool mqtt_is_socket(SOCKET sock);
+
+/**
+ * \brief Check if an MQTT instance is waiting for the resolution of a host name.
+ *
+ * \param[in]  domain_name     Domain name.
+ *
+ * \return     true if the MQTT broker being connected to has this host name.
+ */
+bool mqtt_is_resolving(const uint8_t *domain_name);
+
 /**
  * \brief Connect to specific MQTT broker server.
  * This function is responsible only connect the socket.
@@ -515,6 +535,8 @@ int mqtt_disconnect(struct mqtt_module *const module, int force_close);
 /**
  * \brief Send publish message to MQTT broker server.
  * If operation of this function is complete, MQTT_CALLBACK_PUBLISHED event will be sent through MQTT callback.
+ * If it fails on a connected instance, the socket is closed, isConnected is cleared and
+ * MQTT_CALLBACK_DISCONNECTED is sent first.
  *
  * \param[in]  module_inst     Instance of MQTT module.
  * \param[in]  topic           Topic of this MQTT message.
@@ -594,6 +616,8 @@ int mqtt_unsubscribe(struct mqtt_module *const module, const char *topic);
 
 /**
  * \brief Poll for published frames.
+ * If the socket was closed or the connection failed, the socket is closed, isConnected is cleared and
+ * MQTT_CALLBACK_DISCONNECTED is sent.
  *
  * \param[in]  module_inst     Instance of MQTT module.
  * \param[in]  timeout_ms      time limit for polling.
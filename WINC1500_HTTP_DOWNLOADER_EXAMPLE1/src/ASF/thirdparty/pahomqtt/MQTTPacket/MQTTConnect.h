@@ -109,14 +109,14 @@ typedef union
 #if defined(REVERSED)
 	struct
 	{
+		unsigned int : 7;	     			/**< unused */
 		unsigned int sessionpresent : 1;    /**< session present flag */
-		unsigned int : 7;	  	          /**< unused */
 	} bits;
 #else
 	struct
 	{
-		unsigned int : 7;	     			/**< unused */
-		unsigned int sessionpresent : 1;    /**< session present flag */
+		unsigned int sessionpresent : 1;    /**< session present flag, bit 0 of the byte like the other flag unions */
+		unsigned int : 7;	  	          /**< unused */
 	} bits;
 #endif
 } MQTTConnackFlags;	/**< connack flags byte */
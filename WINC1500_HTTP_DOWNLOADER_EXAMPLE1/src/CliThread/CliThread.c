@@ -12,9 +12,19 @@
 ******************************************************************************/
 #include "CliThread.h"
 #include "IMU/lsm6ds_reg.h"
+#include "IMU/ImuAcquisition.h"
+#include "IMU/ImuFixed.h"
+#include "IMU/ImuDsp.h"
 #include "SeesawDriver/Seesaw.h"
 #include "WifiHandlerThread/WifiHandler.h"
 #include "DistanceDriver/DistanceSensor.h"
+#include "I2cDriver/I2cDriver.h"
+#include "UiHandlerThread/UiHandlerThread.h"
+#include "UiHandlerThread/MoveSequencer.h"
+#include "PowerManager/PowerManager.h"
+#include "RuntimeStats/RuntimeStats.h"
+#include "MemPool/MemPool.h"
+#include "HostLink/HostLink.h"
 
 /******************************************************************************
 * Defines
@@ -85,6 +95,94 @@ static const CLI_Command_Definition_t xSendDummyGameData =
  0
 };
 
+static const CLI_Command_Definition_t xI2cStatsCommand =
+{
+	"i2c",
+	"i2c: Prints the error counters of the sensor I2C bus\r\n",
+	CLI_I2cStats,
+	0
+};
+
+static const CLI_Command_Definition_t xImuAcqStatsCommand =
+{
+	"imuacq",
+	"imuacq: Prints the counters of the IMU FIFO acquisition\r\n",
+	CLI_ImuAcqStats,
+	0
+};
+
+static const CLI_Command_Definition_t xImuDspCommand =
+{
+	"imudsp",
+	"imudsp: Prints the last IMU window features and the processing cost\r\n",
+	CLI_ImuDsp,
+	0
+};
+
+static const CLI_Command_Definition_t xPlaybackCommand =
+{
+	"playback",
+	"playback [speed%|stop]: Sets the speed the opponent's moves are shown at (100 is normal), or skips the playback\r\n",
+	CLI_Playback,
+	1
+};
+
+static const CLI_Command_Definition_t xPowerCommand =
+{
+	"power",
+	"power: Prints how long the MCU slept with the tick suppressed\r\n",
+	CLI_PowerStats,
+	0
+};
+
+static const CLI_Command_Definition_t xTopCommand =
+{
+	"top",
+	"top: Prints the CPU share of every task since the previous top\r\n",
+	CLI_Top,
+	0
+};
+
+static const CLI_Command_Definition_t xStacksCommand =
+{
+	"stacks",
+	"stacks: Prints the least stack space every task ever had left\r\n",
+	CLI_Stacks,
+	0
+};
+
+static const CLI_Command_Definition_t xHeapCommand =
+{
+	"heap",
+	"heap: Prints the free RTOS heap and the used C library heap\r\n",
+	CLI_Heap,
+	0
+};
+
+static const CLI_Command_Definition_t xStatsDumpCommand =
+{
+	"statsdump",
+	"statsdump [s]: Dumps the run time statistics every s seconds ($RTS/$RTT lines). 0 stops\r\n",
+	CLI_StatsDump,
+	1
+};
+
+static const CLI_Command_Definition_t xPoolsCommand =
+{
+	"pools",
+	"pools: Prints the use and high water mark of every memory pool\r\n",
+	CLI_Pools,
+	0
+};
+
+static const CLI_Command_Definition_t xConsoleCommand =
+{
+	"console",
+	"console: Prints the counters of the console and of the binary host link\r\n",
+	CLI_ConsoleStats,
+	0
+};
+
 //Clear screen command
 const CLI_Command_Definition_t xClearScreen =
 {
@@ -119,147 +217,169 @@ FreeRTOS_CLIRegisterCommand( &xNeotrellisTurnLEDCommand );
 FreeRTOS_CLIRegisterCommand( &xNeotrellisProcessButtonCommand );
 FreeRTOS_CLIRegisterCommand( &xDistanceSensorGetDistance);
 FreeRTOS_CLIRegisterCommand( &xSendDummyGameData);
-
-uint8_t cRxedChar[2], cInputIndex = 0;
+FreeRTOS_CLIRegisterCommand( &xI2cStatsCommand);
+FreeRTOS_CLIRegisterCommand( &xImuAcqStatsCommand);
+FreeRTOS_CLIRegisterCommand( &xImuDspCommand);
+FreeRTOS_CLIRegisterCommand( &xPlaybackCommand);
+FreeRTOS_CLIRegisterCommand( &xPowerCommand);
+FreeRTOS_CLIRegisterCommand( &xTopCommand);
+FreeRTOS_CLIRegisterCommand( &xStacksCommand);
+FreeRTOS_CLIRegisterCommand( &xHeapCommand);
+FreeRTOS_CLIRegisterCommand( &xStatsDumpCommand);
+FreeRTOS_CLIRegisterCommand( &xPoolsCommand);
+FreeRTOS_CLIRegisterCommand( &xConsoleCommand);
+
+static uint8_t pcRxChunk[ CLI_RX_CHUNK_SIZE ];
+uint8_t cInputIndex = 0, cPrevChar = 0, cEscapeState = CLI_ESC_NONE;
+size_t xRxCount, xEchoLen = 0;
 BaseType_t xMoreDataToFollow;
 /* The input and output buffers are declared static to keep them off the stack. */
 static int8_t pcOutputString[ MAX_OUTPUT_LENGTH_CLI  ], pcInputString[ MAX_INPUT_LENGTH_CLI ];
 static char pcLastCommand[ MAX_INPUT_LENGTH_CLI ];
-static bool isEscapeCode = false;
-static char pcEscapeCodes [4];
-static uint8_t pcEscapeCodePos = 0;
-
-    /* This code assumes the peripheral being used as the console has already
-    been opened and configured, and is passed into the task as the task
-    parameter.  Cast the task parameter to the correct type. */
+static char pcEchoString[ CLI_ECHO_BUFFER_SIZE ];
 
     /* Send a welcome message to the user knows they are connected. */
     SerialConsoleWriteString( pcWelcomeMessage);
 
     for( ;; )
     {
-        /* This implementation reads a single character at a time.  Wait in the
-        Blocked state until a character is received. */
-        int recv = SerialConsoleReadCharacter(&cRxedChar);
-		if(recv == -1) //If no characters in the buffer, thread goes to sleep for a while
-		{
-			vTaskDelay( CLI_TASK_DELAY);
-		}else if( cRxedChar[0] == '\n' || cRxedChar[0] == '\r'  )
+        /* Block until characters are received, or until the run time statistics
+        dump is due. Everything that arrived meanwhile is handled in one pass and
+        echoed with a single write. */
+        xRxCount = SerialConsoleRead( pcRxChunk, CLI_RX_CHUNK_SIZE, RuntimeStatsGetDumpWait() );
+
+        for( size_t i = 0; i < xRxCount; i++ )
         {
-            /* A newline character was received, so the input command string is
-            complete and can be processed.  Transmit a line separator, just to
-            make the output easier to read. */
-            SerialConsoleWriteString("\r\n");
-			//Copy for last command
-			isEscapeCode = false; pcEscapeCodePos = 0;
-			strncpy(pcLastCommand, pcInputString, MAX_INPUT_LENGTH_CLI-1);
-			pcLastCommand[MAX_INPUT_LENGTH_CLI-1] = 0;	//Ensure null termination
-
-            /* The command interpreter is called repeatedly until it returns
-            pdFALSE.  See the "Implementing a command" documentation for an
-            explanation of why this is. */
-            do
+            uint8_t cRxedChar = pcRxChunk[ i ];
+
+            /* Binary host frames are multiplexed with the text. */
+            if( HostLinkInput( cRxedChar ) )
             {
-                /* Send the command string to the command interpreter.  Any
-                output generated by the command interpreter will be placed in the
-                pcOutputString buffer. */
-                xMoreDataToFollow = FreeRTOS_CLIProcessCommand
-                              (
-                                  pcInputString,   /* The command string.*/
-                                  pcOutputString,  /* The output buffer. */
-                                  MAX_OUTPUT_LENGTH_CLI/* The size of the output buffer. */
-                              );
-
-                /* Write the output generated by the command interpreter to the
-                console. */
-				//Ensure it is null terminated
-				pcOutputString[MAX_OUTPUT_LENGTH_CLI - 1] = 0;
-                SerialConsoleWriteString(pcOutputString);
-
-            } while( xMoreDataToFollow != pdFALSE );
-
-            /* All the strings generated by the input command have been sent.
-            Processing of the command is complete.  Clear the input string ready
-            to receive the next command. */
-            cInputIndex = 0;
-            memset( pcInputString, 0x00, MAX_INPUT_LENGTH_CLI );
-        }
-        else
-        {
-		            /* The if() clause performs the processing after a newline character
-            is received.  This else clause performs the processing if any other
-            character is received. */
-		
-			if (true == isEscapeCode) {
-
-				if(pcEscapeCodePos < CLI_PC_ESCAPE_CODE_SIZE) {
-					pcEscapeCodes[pcEscapeCodePos++] = cRxedChar[0];
-				}
-				else {
-					isEscapeCode = false; pcEscapeCodePos = 0;
-				}
-			
-				if (pcEscapeCodePos >= CLI_PC_MIN_ESCAPE_CODE_SIZE) {
-				
-					// UP ARROW SHOW LAST COMMAND
-					if(strcasecmp(pcEscapeCodes, "oa"))	{
-                            /// Delete current line and add prompt (">")
-                            sprintf(pcInputString, "%c[2K\r>", 27);
-				            SerialConsoleWriteString(pcInputString);
-                            /// Clear input buffer
-                            cInputIndex = 0;
-                            memset( pcInputString, 0x00, MAX_INPUT_LENGTH_CLI );
-                        /// Send last command
-						strncpy(pcInputString, pcLastCommand, MAX_INPUT_LENGTH_CLI - 1); 	
-                        cInputIndex = (strlen(pcInputString) < MAX_INPUT_LENGTH_CLI - 1) ? strlen(pcLastCommand) : MAX_INPUT_LENGTH_CLI - 1;
-						SerialConsoleWriteString(pcInputString);
-					}
-				
-					isEscapeCode = false; pcEscapeCodePos = 0;
-				}			
-			}
-            /* The if() clause performs the processing after a newline character
-            is received.  This else clause performs the processing if any other
-            character is received. */
+                continue;
+            }
 
-            else if( cRxedChar[0] == '\r' )
+            if( cEscapeState == CLI_ESC_START )
             {
-                /* Ignore carriage returns. */
+                /* ESC [ and ESC O start the sequences sent by the arrow keys. */
+                cEscapeState = ( cRxedChar == '[' || cRxedChar == 'O' ) ? CLI_ESC_SEQUENCE : CLI_ESC_NONE;
+            }
+            else if( cEscapeState == CLI_ESC_SEQUENCE )
+            {
+                /* Parameter bytes are skipped until the final byte. */
+                if( cRxedChar >= '@' && cRxedChar <= '~' )
+                {
+                    cEscapeState = CLI_ESC_NONE;
+                    if( cRxedChar == 'A' )
+                    {
+                        // UP ARROW SHOW LAST COMMAND
+                        pcEchoString[ xEchoLen ] = 0;
+                        SerialConsoleWriteString( pcEchoString );
+                        xEchoLen = 0;
+                        /// Delete current line and add prompt (">"), then send last command
+                        SerialConsoleWriteString( CLI_ERASE_LINE );
+                        strncpy( pcInputString, pcLastCommand, MAX_INPUT_LENGTH_CLI - 1 );
+                        pcInputString[ MAX_INPUT_LENGTH_CLI - 1 ] = 0;
+                        cInputIndex = strlen( pcInputString );
+                        SerialConsoleWriteString( pcInputString );
+                    }
+                }
             }
-            else if( cRxedChar[0] == ASCII_BACKSPACE || cRxedChar[0] == ASCII_DELETE )
+            else if( cRxedChar == '\n' && cPrevChar == '\r' )
+            {
+                /* Second half of a CR LF line ending. */
+            }
+            else if( cRxedChar == '\n' || cRxedChar == '\r' )
+            {
+                /* A newline character was received, so the input command string is
+                complete and can be processed.  Transmit a line separator, just to
+                make the output easier to read. */
+                pcEchoString[ xEchoLen ] = 0;
+                SerialConsoleWriteString( pcEchoString );
+                xEchoLen = 0;
+                SerialConsoleWriteString("\r\n");
+
+                /* Empty lines of a pasted script are skipped. */
+                if( cInputIndex > 0 )
+                {
+                    //Copy for last command
+                    strncpy(pcLastCommand, pcInputString, MAX_INPUT_LENGTH_CLI-1);
+                    pcLastCommand[MAX_INPUT_LENGTH_CLI-1] = 0;	//Ensure null termination
+
+                    /* The command interpreter is called repeatedly until it returns
+                    pdFALSE.  See the "Implementing a command" documentation for an
+                    explanation of why this is. */
+                    do
+                    {
+                        /* Send the command string to the command interpreter.  Any
+                        output generated by the command interpreter will be placed in the
+                        pcOutputString buffer. */
+                        xMoreDataToFollow = FreeRTOS_CLIProcessCommand
+                                      (
+                                          pcInputString,   /* The command string.*/
+                                          pcOutputString,  /* The output buffer. */
+                                          MAX_OUTPUT_LENGTH_CLI/* The size of the output buffer. */
+                                      );
+
+                        /* Write the output generated by the command interpreter to the
+                        console. */
+                        //Ensure it is null terminated
+                        pcOutputString[MAX_OUTPUT_LENGTH_CLI - 1] = 0;
+                        SerialConsoleWriteString(pcOutputString);
+
+                    } while( xMoreDataToFollow != pdFALSE );
+                }
+
+                /* All the strings generated by the input command have been sent.
+                Processing of the command is complete.  Clear the input string ready
+                to receive the next command. */
+                cInputIndex = 0;
+                memset( pcInputString, 0x00, MAX_INPUT_LENGTH_CLI );
+            }
+            else if( cRxedChar == ASCII_BACKSPACE || cRxedChar == ASCII_DELETE )
             {
-				char erase[4] = {0x08, 0x20, 0x08, 0x00};
-				SerialConsoleWriteString(erase);
                 /* Backspace was pressed.  Erase the last character in the input
                 buffer - if there are any. */
                 if( cInputIndex > 0 )
                 {
                     cInputIndex--;
                     pcInputString[ cInputIndex ] = 0;
+                    pcEchoString[ xEchoLen++ ] = ASCII_BACKSPACE;
+                    pcEchoString[ xEchoLen++ ] = ASCII_WHITESPACE;
+                    pcEchoString[ xEchoLen++ ] = ASCII_BACKSPACE;
                 }
             }
-			// ESC
-			else if( cRxedChar[0] == ASCII_ESC) {
-				isEscapeCode = true; //Next characters will be code arguments
-				pcEscapeCodePos = 0;
-			}
-            else
+            // ESC
+            else if( cRxedChar == ASCII_ESC )
+            {
+                cEscapeState = CLI_ESC_START; //Next characters will be code arguments
+            }
+            else if( cRxedChar >= ASCII_WHITESPACE )
             {
                 /* A character was entered.  It was not a new line, backspace
                 or carriage return, so it is accepted as part of the input and
                 placed into the input buffer.  When a n is entered the complete
-                string will be passed to the command interpreter. */
-                if( cInputIndex < MAX_INPUT_LENGTH_CLI )
+                string will be passed to the command interpreter. The last byte
+                of the input buffer is kept for the terminator. */
+                if( cInputIndex < MAX_INPUT_LENGTH_CLI - 1 )
                 {
-                    pcInputString[ cInputIndex ] = cRxedChar[0];
+                    pcInputString[ cInputIndex ] = cRxedChar;
                     cInputIndex++;
+                    pcEchoString[ xEchoLen++ ] = cRxedChar;
                 }
-
-					//Order Echo
-					cRxedChar[1] = 0;
-					SerialConsoleWriteString(&cRxedChar[0]);
             }
+
+            cPrevChar = cRxedChar;
+        }
+
+        //Order Echo
+        if( xEchoLen > 0 )
+        {
+            pcEchoString[ xEchoLen ] = 0;
+            SerialConsoleWriteString( pcEchoString );
+            xEchoLen = 0;
         }
+
+        RuntimeStatsDumpIfDue();
     }
 }
 
@@ -269,24 +389,17 @@ static uint8_t pcEscapeCodePos = 0;
 /******************************************************************************
 * CLI Functions - Define here
 ******************************************************************************/
-//Example CLI Command. Reads from the IMU and returns data.
+//Example CLI Command. Returns the newest sample of the IMU acquisition; the IMU itself is only read by the acquisition task.
 BaseType_t CLI_GetImuData( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
 {
-static axis3bit16_t data_raw_acceleration;
-static axis3bit16_t data_raw_angular_rate;
-static float acceleration_mg[3];
-uint8_t reg;
-
-lsm6ds3_xl_flag_data_ready_get(GetImuStruct(), &reg);
-if(reg){
-	memset(data_raw_acceleration.u8bit, 0x00, 3 * sizeof(int16_t));
-	lsm6ds3_acceleration_raw_get(GetImuStruct(), data_raw_acceleration.u8bit);
-	acceleration_mg[0] =
-	lsm6ds3_from_fs2g_to_mg(data_raw_acceleration.i16bit[0]);
-	acceleration_mg[1] =
-	lsm6ds3_from_fs2g_to_mg(data_raw_acceleration.i16bit[1]);
-	acceleration_mg[2] =
-	lsm6ds3_from_fs2g_to_mg(data_raw_acceleration.i16bit[2]);
+static ImuSample imuSample;
+static int32_t acceleration_mg[3];
+const ImuFixedScale *accelScale = ImuFixedGetAccelScale(IMU_ACQ_XL_FS);
+
+if(ImuAcquisitionGetLatest(&imuSample, NULL)){
+	acceleration_mg[0] = ImuFixedConvert(imuSample.accel[0], accelScale);
+	acceleration_mg[1] = ImuFixedConvert(imuSample.accel[1], accelScale);
+	acceleration_mg[2] = ImuFixedConvert(imuSample.accel[2], accelScale);
 
 snprintf(pcWriteBuffer,xWriteBufferLen, "Acceleration [mg]:X %d\tY %d\t%Z %d\r\n",
 (int)acceleration_mg[0], (int)acceleration_mg[1], (int)acceleration_mg[2]);
@@ -454,10 +567,11 @@ BaseType_t CLI_NeotrellProcessButtonBuffer( int8_t *pcWriteBuffer,size_t xWriteB
 	//If the string is too long to print, print what you can.
 	//The function you write will be useful in the future.
 	uint8_t buffer[64];
-	uint8_t count = SeesawGetKeypadCount();
+	uint8_t count = 0;
+	//Count and read in one go, so the UI task cannot take the event in between. No I2C traffic if the INT line says the FIFO is empty
+	int32_t res = SeesawKeypadHasEvents() ? SeesawKeypadDrain(buffer, 1, &count) : ERROR_NONE;
 	if(count >= 1)
 	{
-	int32_t res = SeesawReadKeypad(buffer,1);
 	if(res==0)
 		{
 			uint8_t pos,press;
@@ -501,17 +615,21 @@ Example 3
 BaseType_t CLI_DistanceSensorGetDistance( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
 {
 
+	DistanceReading reading;
+	DistanceSensorStats stats;
 	uint16_t distance = 0;
-	int error = DistanceSensorGetDistance(&distance, 100);
+	int error = DistanceSensorGetLatest(&reading);
+	DistanceSensorGetStats(&stats);
 	if (0 != error )
 	{
-		snprintf(pcWriteBuffer,xWriteBufferLen, "Sensor Error %d!\r\n", error);
-	}
-	else
-	{
-		snprintf(pcWriteBuffer,xWriteBufferLen, "Distance: %d mm\r\n", distance);
+		snprintf(pcWriteBuffer,xWriteBufferLen, "Sensor Error %d! (timeouts %lu)\r\n", error, stats.timeouts);
+		return pdFALSE;
 	}
 
+	distance = reading.distance;
+	snprintf(pcWriteBuffer,xWriteBufferLen, "Distance: %d mm (%lu ms ago, %lu samples, %lu timeouts)\r\n", distance,
+		(xTaskGetTickCount() - reading.tick) * portTICK_PERIOD_MS, stats.samples, stats.timeouts);
+
 	error = WifiAddDistanceDataToQueue(&distance);
 	if(error == pdTRUE)
 	{
@@ -559,3 +677,306 @@ gamevar.game[10] = 0xFF;
 	}
 	return pdFALSE;
 }
+
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_I2cStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the error counters of the sensor I2C bus
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_I2cStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	I2cBusStats stats;
+
+	I2cGetBusStats(&stats);
+	snprintf(pcWriteBuffer, xWriteBufferLen, "I2C req %lu nack %lu buserr %lu timeout %lu\r\nrecover %lu (failed %lu) speed chg %lu\r\n",
+		stats.requests, stats.nacks, stats.busErrors, stats.timeouts, stats.recoveries, stats.recoveryFailures, stats.speedChanges);
+	return pdFALSE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_ImuAcqStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the counters of the IMU FIFO acquisition
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_ImuAcqStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	ImuAcqStats stats;
+
+	ImuAcquisitionGetStats(&stats);
+	snprintf(pcWriteBuffer, xWriteBufferLen, "IMU blocks %lu samples %lu overrun %lu\r\nrealign %lu buserr %lu polls %lu\r\n",
+		stats.blocks, stats.samples, stats.overruns, stats.realigns, stats.busErrors, stats.polls);
+	return pdFALSE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_ImuDsp( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the features of the last IMU window and the cycles per sample spent computing them
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_ImuDsp( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	ImuFeatures features;
+	ImuDspStats stats;
+
+	ImuDspGetStats(&stats);
+	if(!ImuDspGetFeatures(&features))
+	{
+		snprintf(pcWriteBuffer, xWriteBufferLen, "No IMU window yet!\r\n");
+		return pdFALSE;
+	}
+	snprintf(pcWriteBuffer, xWriteBufferLen, "LPF [mg] %d %d %d\r\nRMS [mg] %d %d %d\r\nPeak [mg] %d %d %d\r\nwin %lu cyc/sample %lu (max %lu)\r\n",
+		features.lowPassMg[0], features.lowPassMg[1], features.lowPassMg[2],
+		features.rmsMg[0], features.rmsMg[1], features.rmsMg[2],
+		features.peakMg[0], features.peakMg[1], features.peakMg[2],
+		stats.windows, stats.cyclesPerSample, stats.maxCyclesPerSample);
+	return pdFALSE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_Playback( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Changes the speed the opponent's moves are shown at, or skips the rest of the playback
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input. Expects a speed in percent or "stop"
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_Playback( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	int8_t *pcParameter1;
+	BaseType_t xParameter1StringLength;
+	int speed;
+
+	pcParameter1 = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameter1StringLength);
+	pcParameter1[ xParameter1StringLength ] = 0x00;
+
+	if(strcmp((char *) pcParameter1, "stop") == 0)
+	{
+		UiCancelShowMoves();
+		snprintf(pcWriteBuffer, xWriteBufferLen, "Playback skipped\r\n");
+		return pdFALSE;
+	}
+
+	speed = atoi((char *) pcParameter1);
+	if(speed < MOVE_SEQUENCER_SPEED_MIN || speed > MOVE_SEQUENCER_SPEED_MAX || !UiSetPlaybackSpeed((uint16_t) speed))
+	{
+		snprintf(pcWriteBuffer, xWriteBufferLen, "Error - Speed must be between %d and %d percent!\r\n", MOVE_SEQUENCER_SPEED_MIN, MOVE_SEQUENCER_SPEED_MAX);
+		return pdFALSE;
+	}
+	snprintf(pcWriteBuffer, xWriteBufferLen, "Playback speed %d%%\r\n", speed);
+	return pdFALSE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_PowerStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the tickless idle statistics and the share of the time spent asleep
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_PowerStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	PowerManagerStats stats;
+	uint32_t permille;
+
+	PowerManagerGetStats(&stats);
+	permille = (stats.ticks == 0) ? 0 : (uint32_t)(((uint64_t)stats.sleptTicks * 1000) / stats.ticks);
+	snprintf(pcWriteBuffer, xWriteBufferLen, "Asleep %lu of %lu ticks (%lu.%lu%%)\r\nsleeps %lu early %lu aborts %lu\r\n",
+		stats.sleptTicks, stats.ticks, permille / 10, permille % 10, stats.sleeps, stats.early, stats.aborts);
+	return pdFALSE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_Top( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the CPU share of every task since the previous "top", busiest first. One task per call.
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdTRUE while there are tasks left to print, pdFALSE once the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_Top( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	static RuntimeStatsView topView;	//CPU shares are since the previous "top"
+	static uint8_t topLine = 0;
+	RuntimeTaskInfo task;
+
+	if(topLine == 0)
+	{
+		RuntimeStatsSnapshot(&topView);
+		snprintf(pcWriteBuffer, xWriteBufferLen, "Task       CPU  Pri St\r\n");
+		topLine = 1;
+		return pdTRUE;
+	}
+
+	if(!RuntimeStatsGetTask(topLine - 1, &task))
+	{
+		topLine = 0;
+		*pcWriteBuffer = 0;
+		return pdFALSE;
+	}
+	snprintf(pcWriteBuffer, xWriteBufferLen, "%-8s %3u.%u%% %3u  %c\r\n", task.name, task.cpuPermille / 10, task.cpuPermille % 10, task.priority, task.state);
+	topLine++;
+	return pdTRUE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_Stacks( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the least stack space every task ever had left. One task per call.
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdTRUE while there are tasks left to print, pdFALSE once the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_Stacks( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	static uint8_t stacksLine = 0;
+	RuntimeTaskInfo task;
+
+	if(stacksLine == 0)
+	{
+		RuntimeStatsSnapshot(NULL);
+		snprintf(pcWriteBuffer, xWriteBufferLen, "Task     Min free [words]\r\n");
+		stacksLine = 1;
+		return pdTRUE;
+	}
+
+	if(!RuntimeStatsGetTask(stacksLine - 1, &task))
+	{
+		stacksLine = 0;
+		*pcWriteBuffer = 0;
+		return pdFALSE;
+	}
+	snprintf(pcWriteBuffer, xWriteBufferLen, "%-8s %u\r\n", task.name, task.stackFreeWords);
+	stacksLine++;
+	return pdTRUE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_Heap( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the use of the FreeRTOS and C library heaps
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_Heap( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	RuntimeHeapInfo heap;
+
+	RuntimeStatsGetHeap(&heap);
+	snprintf(pcWriteBuffer, xWriteBufferLen, "RTOS heap free %lu of %lu (min ever %lu)\r\nlibc heap used %lu\r\n",
+		heap.rtosFree, heap.rtosTotal, heap.rtosFree, heap.libcUsed);
+	return pdFALSE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_StatsDump( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Starts or stops the periodic machine readable dump of the run time statistics
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input. Expects the period in seconds, 0 to stop
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_StatsDump( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	int8_t *pcParameter1;
+	BaseType_t xParameter1StringLength;
+	int seconds;
+
+	pcParameter1 = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameter1StringLength);
+	pcParameter1[ xParameter1StringLength ] = 0x00;
+
+	seconds = atoi((char *) pcParameter1);
+	if(seconds < 0 || seconds > 3600)
+	{
+		snprintf(pcWriteBuffer, xWriteBufferLen, "Error - Period must be between 0 and 3600 s!\r\n");
+		return pdFALSE;
+	}
+	RuntimeStatsSetDumpPeriod((uint32_t) seconds * 1000);
+	snprintf(pcWriteBuffer, xWriteBufferLen, (seconds == 0) ? "Stats dump off\r\n" : "Stats dump every %d s\r\n", seconds);
+	return pdFALSE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_Pools( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the use, high water mark and failed allocations of every memory pool. One pool per call.
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdTRUE while there are pools left to print, pdFALSE once the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_Pools( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	static uint8_t poolsLine = 0;
+	MemPoolStats pool;
+
+	if(poolsLine == 0)
+	{
+		snprintf(pcWriteBuffer, xWriteBufferLen, "Pool   Size  Blocks  Used  Max  Fails\r\n");
+		poolsLine = 1;
+		return pdTRUE;
+	}
+
+	if(!MemPoolGetStats(poolsLine - 1, &pool))
+	{
+		poolsLine = 0;
+		*pcWriteBuffer = 0;
+		return pdFALSE;
+	}
+	snprintf(pcWriteBuffer, xWriteBufferLen, "%-6s %4u  %6u  %4u  %3u  %lu\r\n", pool.name, pool.blockSize, pool.blockCount,
+		pool.inUse, pool.highWater, pool.failures);
+	poolsLine++;
+	return pdTRUE;
+}
+
+
+
+/**************************************************************************//**
+BaseType_t CLI_ConsoleStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+* @brief	Prints the counters of the console RX and TX paths and of the binary host link
+* @param[out] *pcWriteBuffer. Buffer we can use to write the CLI command response to! See other CLI examples on how we use this to write back!
+* @param[in] xWriteBufferLen. How much we can write into the buffer
+* @param[in] *pcCommandString. Buffer that contains the complete input.
+* @return		Returns pdFALSE if the CLI command finished.
+*****************************************************************************/
+BaseType_t CLI_ConsoleStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString )
+{
+	SerialConsoleRxStats stats;
+	HostLinkStats link;
+
+	SerialConsoleGetRxStats(&stats);
+	HostLinkGetStats(&link);
+	snprintf(pcWriteBuffer, xWriteBufferLen, "RX %lu dropped %lu xoff %lu\r\nTX dropped %lu\r\nLink frames %lu crc %lu overflow %lu stream drops %lu\r\n",
+		stats.received, stats.dropped, stats.xoffs, SerialConsoleGetTxDropped(), link.frames, link.crcErrors, link.overflows, link.streamDrops);
+	return pdFALSE;
+}
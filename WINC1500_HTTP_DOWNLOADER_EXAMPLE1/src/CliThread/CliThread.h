@@ -15,14 +15,17 @@
 
 #define CLI_TASK_SIZE	256		///<STUDENT FILL
 #define CLI_PRIORITY (configMAX_PRIORITIES - 1) ///<STUDENT FILL
-#define CLI_TASK_DELAY 150	///STUDENT FILL
+#define CLI_RX_CHUNK_SIZE	32	///<Most characters handled per wake-up of the CLI task
+#define CLI_ECHO_BUFFER_SIZE	(3 * CLI_RX_CHUNK_SIZE + 1)	///<Echo of one chunk. A backspace echoes 3 characters
 
 #define MAX_INPUT_LENGTH_CLI    50	//STUDENT FILL
 #define MAX_OUTPUT_LENGTH_CLI   130	//STUDENT FILL
 
 #define CLI_MSG_LEN						16
-#define CLI_PC_ESCAPE_CODE_SIZE			4
-#define CLI_PC_MIN_ESCAPE_CODE_SIZE		2
+#define CLI_ESC_NONE					0	///<Not in an escape sequence
+#define CLI_ESC_START					1	///<ESC received
+#define CLI_ESC_SEQUENCE				2	///<ESC [ or ESC O received, waiting for the final byte
+#define CLI_ERASE_LINE					"\x1b[2K\r>"	///<Deletes the current line and writes the prompt
 
 
 #define ASCII_BACKSPACE					0x08
@@ -47,4 +50,15 @@ BaseType_t CLI_NeotrellisSetLed( int8_t *pcWriteBuffer,size_t xWriteBufferLen,co
 BaseType_t CLI_NeotrellProcessButtonBuffer( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
 BaseType_t CLI_DistanceSensorGetDistance( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
 BaseType_t CLI_ResetDevice( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
-BaseType_t CLI_SendDummyGameData( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
\ No newline at end of file
+BaseType_t CLI_SendDummyGameData( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_I2cStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_ImuAcqStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_ImuDsp( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_Playback( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_PowerStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_Top( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_Stacks( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_Heap( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_StatsDump( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_Pools( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
+BaseType_t CLI_ConsoleStats( int8_t *pcWriteBuffer,size_t xWriteBufferLen,const int8_t *pcCommandString );
\ No newline at end of file
@@ -19,16 +19,34 @@
 #include "stdio_serial.h"
 #include "SerialConsole.h"
 #include "CliThread/CliThread.h"
+#include "IMU/ImuDsp.h"
 
 /******************************************************************************
 * Defines
 ******************************************************************************/
+#define CONTROL_GAME_QUEUE_LEN			2		///<Number of games from the server that can wait for the control task
+#define CONTROL_TELEMETRY_PERIOD_MS		300		///<Time between two sensor telemetry posts
+
+//Structure that holds a game as stored on the game queue, stamped with the tick it arrived at
+struct ControlGameItem
+{
+	uint32_t tick;
+	struct GameDataPacket game;
+};
 
 /******************************************************************************
 * Variables
 ******************************************************************************/
 QueueHandle_t xQueueGameBufferIn = NULL; ///<Queue to send the next play to the UI
 QueueHandle_t xQueueRgbColorBuffer = NULL; ///<Queue to receive an LED Color packet
+SemaphoreHandle_t xSemaphorePlayDone = NULL; ///<Given by the UI when the player has finished the move
+QueueSetHandle_t xControlQueueSet = NULL; ///<Set of every queue the control task blocks on
+
+static StaticQueue_t xQueueGameBufferInBuffer; ///<Storage of the control queues. The queue set has no static variant and comes from the heap
+static uint8_t xQueueGameBufferInStorage[CONTROL_GAME_QUEUE_LEN * sizeof(struct ControlGameItem)];
+static StaticQueue_t xQueueRgbColorBufferBuffer;
+static uint8_t xQueueRgbColorBufferStorage[2 * sizeof(struct RgbColorPacket)];
+static StaticSemaphore_t xSemaphorePlayDoneBuffer;
 
 controlStateMachine_state controlState; ///<Holds the current state of the control thread
 
@@ -37,6 +55,7 @@ int error1 = 0;
 /******************************************************************************
 * Forward Declarations
 ******************************************************************************/
+static void ControlStartGame(const struct ControlGameItem *item);
 
 /******************************************************************************
 * Callback Functions
@@ -49,10 +68,12 @@ int error1 = 0;
 
 
 /**************************************************************************//**
-* @fn		void vUiHandlerTask( void *pvParameters )
-* @brief	STUDENT TO FILL THIS
-* @details 	student to fill this
-                				
+* @fn		void vControlHandlerTask( void *pvParameters )
+* @brief	Runs the game state machine: hands games from the server to the UI and sends the player's move back
+* @details 	The task blocks on a queue set holding the game queue and the play done semaphore, so it only runs when
+*			a game arrives, when the UI finishes a play, or when the sensor telemetry is due.
+*			Games that arrive while a move is being played are kept in arrival order, up to CONTROL_GAME_QUEUE_LEN,
+*			and started one per finished play. If more arrive, the oldest pending game is dropped.
 * @param[in]	Parameters passed when task is initialized. In this case we can ignore them!
 * @return		Should not return! This is a task defining function.
 * @note         
@@ -62,84 +83,109 @@ void vControlHandlerTask( void *pvParameters )
 SerialConsoleWriteString("ESE516 - Control Init Code\r\n");
 
 //Initialize Queues
-xQueueGameBufferIn = xQueueCreate( 2, sizeof( struct GameDataPacket ) );
-xQueueRgbColorBuffer = xQueueCreate( 2, sizeof( struct RgbColorPacket ) );
+xQueueGameBufferIn = xQueueCreateStatic( CONTROL_GAME_QUEUE_LEN, sizeof( struct ControlGameItem ), xQueueGameBufferInStorage, &xQueueGameBufferInBuffer );
+xQueueRgbColorBuffer = xQueueCreateStatic( 2, sizeof( struct RgbColorPacket ), xQueueRgbColorBufferStorage, &xQueueRgbColorBufferBuffer );
+xSemaphorePlayDone = xSemaphoreCreateBinaryStatic( &xSemaphorePlayDoneBuffer );
+xControlQueueSet = xQueueCreateSet( CONTROL_GAME_QUEUE_LEN + 1 );
 static int8_t pcOutputString[ MAX_OUTPUT_LENGTH_CLI  ], pcInputString[ MAX_INPUT_LENGTH_CLI ];
 
-if(xQueueGameBufferIn == NULL || xQueueRgbColorBuffer == NULL){
+if(xQueueGameBufferIn == NULL || xQueueRgbColorBuffer == NULL || xSemaphorePlayDone == NULL || xControlQueueSet == NULL){
 	SerialConsoleWriteString("ERROR Initializing Control Data queues!\r\n");
 }
+xQueueAddToSet(xQueueGameBufferIn, xControlQueueSet);
+xQueueAddToSet(xSemaphorePlayDone, xControlQueueSet);
 controlState = CONTROL_WAIT_FOR_GAME; //Initial state
 
-TickType_t startTime =  xTaskGetTickCount(); //Get current time
+static struct ControlGameItem pendingGames[CONTROL_GAME_QUEUE_LEN]; //Games received while a move was being played, oldest at pendingHead
+uint8_t pendingHead = 0;
+uint8_t pendingCount = 0;
+TickType_t nextTelemetry = xTaskGetTickCount() + pdMS_TO_TICKS(CONTROL_TELEMETRY_PERIOD_MS);
 
 while(1)
 {
-	switch(controlState)
+	TickType_t now = xTaskGetTickCount();
+	TickType_t timeout = ((int32_t)(nextTelemetry - now) > 0) ? (nextTelemetry - now) : 0;
+	QueueSetMemberHandle_t member = xQueueSelectFromSet(xControlQueueSet, timeout);
+
+	if(member == xQueueGameBufferIn)
 	{
-	case (CONTROL_WAIT_FOR_GAME):
-	{	//Should set the UI to ignore button presses and should wait until there is a message from the server with a new play.
-		struct GameDataPacket gamePacketIn;
-		if(pdPASS == xQueueReceive( xQueueGameBufferIn , &gamePacketIn, 0 ))
+		struct ControlGameItem item;
+		xQueueReceive(xQueueGameBufferIn, &item, 0);
+		LogMessage(LOG_DEBUG_LVL, "Control Thread: Consumed game packet!\r\n");
+
+		if(controlState == CONTROL_WAIT_FOR_GAME)
+		{
+			ControlStartGame(&item);
+		}
+		else
 		{
-			LogMessage(LOG_DEBUG_LVL, "Control Thread: Consumed game packet!\r\n");
-			UiOrderShowMoves(&gamePacketIn);
-			controlState = CONTROL_PLAYING_MOVE;
+			//Should wait until the UI thread has showed the move AND comes back with the play from the user
+			if(pendingCount == CONTROL_GAME_QUEUE_LEN)
+			{
+				LogMessage(LOG_DEBUG_LVL, "Control Thread: Too many games pending, dropped the oldest!\r\n");
+				pendingHead = (pendingHead + 1) % CONTROL_GAME_QUEUE_LEN;
+				pendingCount--;
+			}
+			pendingGames[(pendingHead + pendingCount) % CONTROL_GAME_QUEUE_LEN] = item;
+			pendingCount++;
 		}
-		
-		break;
 	}
-
-	case (CONTROL_PLAYING_MOVE):
-	{	//Should wait until the UI thread has showed the move AND comes back with the play from the user. Should go back to CONTROL_WAIT_FOR_GAME
-		//after posting the game to MQTT
-		if(UiPlayIsDone() == true)
+	else if(member == xSemaphorePlayDone)
+	{
+		xSemaphoreTake(xSemaphorePlayDone, 0);
+		if(controlState == CONTROL_PLAYING_MOVE)
 		{
-			//Send back local game packet
+			//Send back local game packet, then go back to CONTROL_WAIT_FOR_GAME
 			if( pdTRUE != WifiAddGameDataToQueue(UiGetGamePacketOut()))
 			{
 				LogMessage(LOG_DEBUG_LVL, "Control Thread: Could not send game packet!\r\n");
 			}
 			controlState = CONTROL_WAIT_FOR_GAME;
-		}
 
-		break;
-	}
-
-	case (CONTROL_END_GAME):
-	{	
-
-		break;
+			if(pendingCount != 0)
+			{
+				ControlStartGame(&pendingGames[pendingHead]);
+				pendingHead = (pendingHead + 1) % CONTROL_GAME_QUEUE_LEN;
+				pendingCount--;
+			}
+		}
 	}
 
-
-	default:
-		controlState = CONTROL_WAIT_FOR_GAME;
-	break;
-
-
-
-	}
-	
-	if(xTaskGetTickCount() - startTime > 300)
+	if((int32_t)(xTaskGetTickCount() - nextTelemetry) >= 0)
 	{
-		startTime =  xTaskGetTickCount(); //Save ticktime for next round
+		nextTelemetry += pdMS_TO_TICKS(CONTROL_TELEMETRY_PERIOD_MS);
 		//Perform the function you want to happen only every delta T - Like updating the LED values to decay them!
-		CLI_GetImuData(pcOutputString, MAX_OUTPUT_LENGTH_CLI,pcInputString );
+#if !IMU_DSP_ENABLED
+		CLI_GetImuData(pcOutputString, MAX_OUTPUT_LENGTH_CLI,pcInputString ); //With the DSP enabled the filtered IMU data is published by ImuDsp
+#endif
 		CLI_DistanceSensorGetDistance(pcOutputString, MAX_OUTPUT_LENGTH_CLI,pcInputString );
-		
 	}
+}
 
-	
-	
-	
-	
-	
-vTaskDelay(40);
 
 }
 
 
+/**************************************************************************//**
+* @fn		static void ControlStartGame(const struct ControlGameItem *item)
+* @brief	Orders the UI to show a game and waits for the player's move
+* @param[in]	item Game and the tick it arrived at
+*****************************************************************************/
+static void ControlStartGame(const struct ControlGameItem *item)
+{
+	UiOrderShowMoves(&item->game, item->tick);
+	controlState = CONTROL_PLAYING_MOVE;
+}
+
+
+/**************************************************************************//**
+void ControlPlayDone(void)
+* @brief	Tells the control task that the player has finished the move. Called by the UI task.
+* @note		The move is read with UiGetGamePacketOut() and must not change until the UI is ordered to show a new game
+*****************************************************************************/
+void ControlPlayDone(void)
+{
+	xSemaphoreGive(xSemaphorePlayDone);
 }
 
 
@@ -150,12 +196,15 @@ int ControlAddGameData(struct GameDataPacket *gameIn);
 * @param[out] 
                 				
 * @return		Returns pdTrue if data can be added to queue, 0 if queue is full
-* @note         
+* @note         The game is stamped with the current tick, to measure the latency until the UI shows it
 
 *****************************************************************************/
 int ControlAddGameData(struct GameDataPacket *gameIn)
 {
-	int error = xQueueSend(xQueueGameBufferIn , gameIn, ( TickType_t ) 10);
+	struct ControlGameItem item;
+	item.tick = xTaskGetTickCount();
+	item.game = *gameIn;
+	int error = xQueueSend(xQueueGameBufferIn , &item, ( TickType_t ) 10);
 	return error;
 }
 
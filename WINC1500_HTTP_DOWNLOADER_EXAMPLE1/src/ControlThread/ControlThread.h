@@ -42,6 +42,7 @@ typedef enum controlStateMachine_state
 ******************************************************************************/
 void vControlHandlerTask( void *pvParameters );
 int ControlAddGameData(struct GameDataPacket *gameIn);
+void ControlPlayDone(void);
 
 	 #ifdef __cplusplus
  }
@@ -5,6 +5,9 @@ In this mode, it will work with an UART driver. The MCU can send 0x55 and should
 If you send 0x50, it will return the temperature in Degrees C.
 
 This criver will be written compatible to be run from RTOS thread, with non-blocking commands in mind.
+The sensor is sampled in the background: a TC compare triggers a measurement every sample period, the UART RX callback
+stores the reply in a timestamped ring and updates the median of the newest readings. Readers never wait on the UART,
+they get the newest filtered value with DistanceSensorGetLatest().
 See https://www.bananarobotics.com/shop/US-100-Ultrasonic-Distance-Sensor-Module for more information
 * @author    Eduardo Garcia
 * @date      2020-04-08
@@ -20,48 +23,84 @@ See https://www.bananarobotics.com/shop/US-100-Ultrasonic-Distance-Sensor-Module
 #include "SerialConsole/SerialConsole.h"
 
 
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define DISTANCE_RX_FLUSH_MAX			4	///<Reads that empty the SERCOM receive buffer: two bytes, plus the error statuses they may carry
+#define DISTANCE_PERIOD_TO_COUNTS(ms)	(((system_gclk_gen_get_hz(GCLK_GENERATOR_0) / DISTANCE_TIMER_PRESCALER) * (uint32_t)(ms)) / 1000)	///<Converts a sample period to TC counts
+
 /******************************************************************************
 * Variables
 ******************************************************************************/
 
 struct usart_module usart_instance_dist;	///<Distance sensor UART module
-
-SemaphoreHandle_t sensorDistanceMutexHandle;			///<Mutex to handle the sensor I2C bus thread access.
-SemaphoreHandle_t sensorDistanceSemaphoreHandle;		///<Binary semaphore to notify task that we have received an I2C interrupt on the Sensor bus
+struct tc_module distanceTimer;				///<TC that paces the measurements
 
 /******************************************************************************
 * Structures and Enumerations
 ******************************************************************************/
 uint8_t distTx;
 uint8_t latestRxDistance[2];
+static volatile bool distanceRxPending = false;					///<True while a measurement is waiting for the sensor reply
+static DistanceReading distanceRing[DISTANCE_RING_SIZE];			///<Newest raw readings
+static uint8_t distanceRingHead = 0;								///<Index where the next reading is stored
+static uint8_t distanceRingCount = 0;								///<Number of valid readings in the ring
+static DistanceReading distanceLatest;								///<Median of the newest readings, stamped with the newest tick
+static DistanceSensorStats distanceStats;							///<Sampling statistics
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static void configure_usart(void);
+static void configure_usart_callbacks(void);
+static void configure_timer(void);
+static uint16_t DistanceSensorMedian(void);
+
 /******************************************************************************
 *  Callback Declaration
 ******************************************************************************/
-//Callback for when we finish writing characters to UART
-void distUsartWritecallback(struct usart_module *const usart_module)
+//Callback for when the two distance bytes are received. Stores the reading and updates the median.
+void distUsartReadcallback(struct usart_module *const usart_module)
 {
-	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-	
-	xSemaphoreGiveFromISR( sensorDistanceSemaphoreHandle, &xHigherPriorityTaskWoken );
-	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+	DistanceReading *reading = &distanceRing[distanceRingHead];
+
+	reading->tick = xTaskGetTickCountFromISR();
+	reading->distance = (latestRxDistance[0] << 8) + latestRxDistance[1];
+	distanceRingHead = (distanceRingHead + 1) % DISTANCE_RING_SIZE;
+	if(distanceRingCount < DISTANCE_RING_SIZE) distanceRingCount++;
+
+	distanceLatest.tick = reading->tick;
+	distanceLatest.distance = DistanceSensorMedian();
+	distanceStats.samples++;
+	distanceRxPending = false;
 }
-	//Callback for when we finish writing characters to UART
 
-void distUsartReadcallback(struct usart_module *const usart_module)
+//Callback for every sample period. Starts the next measurement: the RX job is armed before the command is sent.
+//Bytes that arrived with no RX job armed, i.e. a reply that came after its timeout, wait in the SERCOM and would be
+//read as the reply to this command, so they are dropped first.
+void distTimerCallback(struct tc_module *const module)
 {
-	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-	
-	xSemaphoreGiveFromISR( sensorDistanceSemaphoreHandle, &xHigherPriorityTaskWoken );
-	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+	uint16_t staleByte;
+
+	if(distanceRxPending)
+	{
+		//The sensor did not answer the previous command
+		usart_abort_job(&usart_instance_dist, USART_TRANSCEIVER_RX);
+		distanceStats.timeouts++;
+	}
+	for(uint8_t i = 0; i < DISTANCE_RX_FLUSH_MAX && usart_read_wait(&usart_instance_dist, &staleByte) != STATUS_BUSY; i++);
+
+	distTx = DISTANCE_US_100_CMD_READ_DISTANCE;
+	distanceRxPending = true;
+	if(STATUS_OK != usart_read_buffer_job(&usart_instance_dist, (uint8_t*) &latestRxDistance, 2) ||
+	   STATUS_OK != usart_write_buffer_job(&usart_instance_dist, (uint8_t*) &distTx, 1))
+	{
+		usart_abort_job(&usart_instance_dist, USART_TRANSCEIVER_RX);
+		distanceRxPending = false;
+		distanceStats.errors++;
+	}
 }
 
-/******************************************************************************
-* Local Function Declaration
-******************************************************************************/
-static void configure_usart(void);
-static void configure_usart_callbacks(void);
-static int32_t DistanceSensorFreeMutex(void);
-static int32_t DistanceSensorGetMutex(TickType_t waitTime);
 /******************************************************************************
 * Global Local Variables
 ******************************************************************************/
@@ -71,11 +110,10 @@ static int32_t DistanceSensorGetMutex(TickType_t waitTime);
 ******************************************************************************/
 
 /**************************************************************************//**
-* @fn			void InitializeSerialConsole(void)
-* @brief		Initializes the UART - sets up the SERCOM to act as UART and registers the callbacks for
-*				asynchronous reads and writes.
-* @details		Initializes the UART - sets up the SERCOM to act as UART and registers the callbacks for
-*				asynchronous reads and writes.
+* @fn			void InitializeDistanceSensor(void)
+* @brief		Initializes the UART and the sampling timer. Sampling starts right away at DISTANCE_SAMPLE_PERIOD_MS.
+* @details		Sets up the SERCOM to act as UART and registers the callbacks for
+*				asynchronous reads and writes, then starts the TC that triggers the measurements.
 * @note			Call from main once to initialize Hardware.
 *****************************************************************************/
 
@@ -85,79 +123,126 @@ void InitializeDistanceSensor(void)
 	//Configure USART and Callbacks
 	configure_usart();
 	configure_usart_callbacks();
-
-	sensorDistanceMutexHandle = xSemaphoreCreateMutex();
-	sensorDistanceSemaphoreHandle = xSemaphoreCreateBinary();
-
-	if(NULL == sensorDistanceMutexHandle || NULL == sensorDistanceSemaphoreHandle){
-		SerialConsoleWriteString("Could not initialize Distance Sensor!");
-	}
+	configure_timer();
 }
 
 
 /**************************************************************************//**
-* @fn			void DeinitializeSerialConsole(void)
-* @brief		Deinitialises the UART
+* @fn			void DeinitializeDistanceSerial(void)
+* @brief		Stops the sampling and deinitialises the UART
 * @note
 *****************************************************************************/
 void DeinitializeDistanceSerial(void)
 {
+	tc_disable(&distanceTimer);
 	usart_disable(&usart_instance_dist);
 }
 
 
 /**************************************************************************//**
-* @fn			int32_t DistanceSensorGetDistance (uint16_t *distance)
-* @brief		Gets the distance from the distance sensor.
-* @note			Returns 0 if successful. -1 if an error occurred
+* @fn			int32_t DistanceSensorGetLatest(DistanceReading *reading)
+* @brief		Returns the median of the newest readings. Never waits on the sensor.
+* @param[out]	reading Filtered distance, stamped with the tick of the newest reading. Check the tick to judge its age.
+* @return		ERROR_NONE if a reading was returned, ERROR_NOT_READY if the sensor has not answered yet
 *****************************************************************************/
-int32_t DistanceSensorGetDistance (uint16_t *distance, const TickType_t xMaxBlockTime)
+int32_t DistanceSensorGetLatest(DistanceReading *reading)
 {
+	int32_t error = ERROR_NONE;
+
+	taskENTER_CRITICAL();
+	if(distanceRingCount == 0)
+	{
+		error = ERROR_NOT_READY;
+	}
+	else
+	{
+		*reading = distanceLatest;
+	}
+	taskEXIT_CRITICAL();
 
-int error = ERROR_NONE;
+	return error;
+}
 
-//1. Get MUTEX. DistanceSensorGetMutex. If we cant get it, goto
-error = DistanceSensorGetMutex(WAIT_I2C_LINE_MS);
-if(ERROR_NONE != error) goto exitf;
 
-//---2. Initiate sending data. First populate TX with the distance command. Use usart_write_buffer_job to transmit 1 character
-distTx = DISTANCE_US_100_CMD_READ_DISTANCE;
-if (STATUS_OK != usart_write_buffer_job(&usart_instance_dist, (uint8_t*) &distTx, 1))
+/**************************************************************************//**
+* @fn			uint8_t DistanceSensorGetHistory(DistanceReading *readings, uint8_t maxReadings)
+* @brief		Copies the newest raw readings, newest first
+* @param[out]	readings Array that receives the readings
+* @param[in]	maxReadings Size of the array
+* @return		Number of readings copied
+*****************************************************************************/
+uint8_t DistanceSensorGetHistory(DistanceReading *readings, uint8_t maxReadings)
 {
-	goto exitf;
+	uint8_t count;
+
+	taskENTER_CRITICAL();
+	count = (maxReadings < distanceRingCount) ? maxReadings : distanceRingCount;
+	for(uint8_t i = 0; i < count; i++)
+	{
+		readings[i] = distanceRing[(distanceRingHead + DISTANCE_RING_SIZE - 1 - i) % DISTANCE_RING_SIZE];
+	}
+	taskEXIT_CRITICAL();
+
+	return count;
 }
 
-//3. )Wait until the TX finished. TX should release the binary semaphore - so wait until semaphore
-if( xSemaphoreTake( sensorDistanceSemaphoreHandle, xMaxBlockTime ) == pdTRUE ){
-	/* The transmission ended as expected. We now delay until the I2C sensor is finished */
 
-	}else{
-	/* The call to ulTaskNotifyTake() timed out. */
-	error = ERR_TIMEOUT;
-	goto exitf;
+/**************************************************************************//**
+* @fn			int32_t DistanceSensorSetSamplePeriod(uint16_t periodMs)
+* @brief		Changes the time between two measurements
+* @param[in]	periodMs Period in ms, between DISTANCE_MIN_SAMPLE_PERIOD_MS and DISTANCE_MAX_SAMPLE_PERIOD_MS
+* @return		ERROR_NONE if changed, ERROR_INVALID_ARG if the period is out of range
+*****************************************************************************/
+int32_t DistanceSensorSetSamplePeriod(uint16_t periodMs)
+{
+	if(periodMs < DISTANCE_MIN_SAMPLE_PERIOD_MS || periodMs > DISTANCE_MAX_SAMPLE_PERIOD_MS)
+	{
+		return ERROR_INVALID_ARG;
+	}
+
+	tc_set_count_value(&distanceTimer, 0);
+	tc_set_compare_value(&distanceTimer, TC_COMPARE_CAPTURE_CHANNEL_0, DISTANCE_PERIOD_TO_COUNTS(periodMs));
+	return ERROR_NONE;
 }
 
-//4. Initiate an rx job - usart_read_buffer_job - to read two characters. Read into variable latestRxDistance
-usart_read_buffer_job(&usart_instance_dist, (uint8_t*) &latestRxDistance, 2);	//Kicks off constant reading of characters
-
-//---7. Wait for notification
-if( xSemaphoreTake( sensorDistanceSemaphoreHandle, xMaxBlockTime ) == pdTRUE ){
-	/* The transmission ended as expected. We now delay until the I2C sensor is finished */
-	*distance = (latestRxDistance[0] << 8) + latestRxDistance[1];
-	}else{
-	/* The call to ulTaskNotifyTake() timed out. */
-	error = ERR_TIMEOUT;
-	goto exitf;
+
+/**************************************************************************//**
+* @fn			void DistanceSensorGetStats(DistanceSensorStats *stats)
+* @brief		Returns a copy of the sampling statistics
+* @param[out]	stats Statistics
+*****************************************************************************/
+void DistanceSensorGetStats(DistanceSensorStats *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = distanceStats;
+	taskEXIT_CRITICAL();
 }
 
 
-exitf:
-//Release mutex and return error
-DistanceSensorFreeMutex();
 
-return error;
-}
+/**************************************************************************//**
+* @fn			static uint16_t DistanceSensorMedian(void)
+* @brief		Median of the newest DISTANCE_MEDIAN_SIZE readings, or of all readings if there are fewer
+* @note			Called from the UART RX interrupt. Insertion sort of at most DISTANCE_MEDIAN_SIZE values.
+*****************************************************************************/
+static uint16_t DistanceSensorMedian(void)
+{
+	uint16_t sorted[DISTANCE_MEDIAN_SIZE];
+	uint8_t count = (distanceRingCount < DISTANCE_MEDIAN_SIZE) ? distanceRingCount : DISTANCE_MEDIAN_SIZE;
 
+	for(uint8_t i = 0; i < count; i++)
+	{
+		uint16_t value = distanceRing[(distanceRingHead + DISTANCE_RING_SIZE - 1 - i) % DISTANCE_RING_SIZE].distance;
+		int8_t j = i - 1;
+		while(j >= 0 && sorted[j] > value)
+		{
+			sorted[j + 1] = sorted[j];
+			j--;
+		}
+		sorted[j + 1] = value;
+	}
+	return sorted[count / 2];
+}
 
 
 /**************************************************************************//**
@@ -193,49 +278,33 @@ static void configure_usart(void)
 *****************************************************************************/
 static void configure_usart_callbacks(void)
 {
-	usart_register_callback(&usart_instance_dist,distUsartWritecallback, USART_CALLBACK_BUFFER_TRANSMITTED);
 	usart_register_callback(&usart_instance_dist,distUsartReadcallback, USART_CALLBACK_BUFFER_RECEIVED);
-	usart_enable_callback(&usart_instance_dist, USART_CALLBACK_BUFFER_TRANSMITTED);
 	usart_enable_callback(&usart_instance_dist, USART_CALLBACK_BUFFER_RECEIVED);
 }
 
 
-
-
 /**************************************************************************//**
- * @fn			int32_t DistanceSensorFreeMutex(eI2cBuses bus)
- * @brief       Frees the mutex of the given UART bus
- * @details     
- * @param[in]   bus Enum that represents the bus in which we are interested to free the mutex of.
- * @return      Returns (0) if the bus is ready, (1) if it is busy.
- * @note        
- *****************************************************************************/
-static int32_t DistanceSensorFreeMutex(void)
+* @fn			static void configure_timer(void)
+* @brief		Starts DISTANCE_TIMER_MODULE in match frequency mode, with a compare callback every DISTANCE_SAMPLE_PERIOD_MS
+* @note
+*****************************************************************************/
+static void configure_timer(void)
 {
-	
-	int32_t error = ERROR_NONE;
-	
-	if( xSemaphoreGive( sensorDistanceMutexHandle ) != pdTRUE ){
-		error = ERROR_NOT_INITIALIZED;	//We could not return the mutex! We must not have it!
-	}
-	return error;
-}
+	struct tc_config config_tc;
+	tc_get_config_defaults(&config_tc);
 
+	config_tc.counter_size = TC_COUNTER_SIZE_16BIT;
+	config_tc.clock_source = GCLK_GENERATOR_0;
+	config_tc.clock_prescaler = TC_CLOCK_PRESCALER_DIV1024;
+	config_tc.wave_generation = TC_WAVE_GENERATION_MATCH_FREQ;
+	config_tc.counter_16_bit.compare_capture_channel[0] = DISTANCE_PERIOD_TO_COUNTS(DISTANCE_SAMPLE_PERIOD_MS);
 
-/**************************************************************************//**
- * @fn			int32_t I2cGetMutex(TickType_t waitTime)
- * @brief       Frees the mutex of the given UART bus
- * @details     
- * @param[in]   waitTime Time to wait for the mutex to be freed.
- * @return      Returns (0) if the bus is ready, (1) if it is busy.
- * @note        
- *****************************************************************************/
-static int32_t DistanceSensorGetMutex(TickType_t waitTime){
-	
-	int32_t error = ERROR_NONE;
-	if(xSemaphoreTake( sensorDistanceMutexHandle, waitTime ) != pdTRUE)
+	while (tc_init(&distanceTimer, DISTANCE_TIMER_MODULE, &config_tc) != STATUS_OK)
 	{
-		error = ERROR_NOT_READY;
+
 	}
-	return error;
-}
\ No newline at end of file
+
+	tc_register_callback(&distanceTimer, distTimerCallback, TC_CALLBACK_CC_CHANNEL0);
+	tc_enable_callback(&distanceTimer, TC_CALLBACK_CC_CHANNEL0);
+	tc_enable(&distanceTimer);
+}
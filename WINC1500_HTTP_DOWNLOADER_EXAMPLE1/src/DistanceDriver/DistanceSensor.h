@@ -5,6 +5,9 @@ In this mode, it will work with an UART driver. The MCU can send 0x55 and should
 If you send 0x50, it will return the temperature in Degrees C.
 
 This criver will be written compatible to be run from RTOS thread, with non-blocking commands in mind.
+The sensor is sampled in the background: a TC compare triggers a measurement every sample period, the UART RX callback
+stores the reply in a timestamped ring and updates the median of the newest readings. Readers never wait on the UART,
+they get the newest filtered value with DistanceSensorGetLatest().
 See https://www.bananarobotics.com/shop/US-100-Ultrasonic-Distance-Sensor-Module for more information
 * @author    Eduardo Garcia
 * @date      2020-04-08
@@ -29,10 +32,33 @@ See https://www.bananarobotics.com/shop/US-100-Ultrasonic-Distance-Sensor-Module
 #define DISTANCE_US_100_CMD_READ_DISTANCE		0x55 ///<Command to send to the US-100 to order a distance command
 #define DISTANCE_US_100_CMD_READ_TEMPERATURE	0x50 ///<Command to send to the US-100 to order a temperature command read
 
+#define DISTANCE_TIMER_MODULE				TC3		///<TC that paces the measurements
+#define DISTANCE_TIMER_PRESCALER			1024	///<Prescaler of the TC clock (GCLK 0)
+#define DISTANCE_SAMPLE_PERIOD_MS			100		///<Default time between two measurements
+#define DISTANCE_MIN_SAMPLE_PERIOD_MS		50		///<Shortest period. The US-100 needs up to ~40 ms to answer at long range
+#define DISTANCE_MAX_SAMPLE_PERIOD_MS		1000	///<Longest period. Keeps the compare value within 16 bits
+#define DISTANCE_RING_SIZE					8		///<Number of raw readings kept
+#define DISTANCE_MEDIAN_SIZE				5		///<Number of newest readings the median is taken over. Odd, at most DISTANCE_RING_SIZE
+
 /******************************************************************************
 * Structures and Enumerations
 ******************************************************************************/
 
+//Structure that holds a distance reading stamped with the tick it was received at
+typedef struct DistanceReading
+{
+	uint32_t tick;		///<Tick at which the reading was received
+	uint16_t distance;	///<Distance, in mm
+} DistanceReading;
+
+//Statistics of the background sampling
+typedef struct DistanceSensorStats
+{
+	uint32_t samples;	///<Readings received
+	uint32_t timeouts;	///<Measurements the sensor did not answer before the next one was due
+	uint32_t errors;	///<Measurements that could not be started
+} DistanceSensorStats;
+
 /******************************************************************************
 * Global Function Declarations
 ******************************************************************************/
@@ -44,7 +70,10 @@ See https://www.bananarobotics.com/shop/US-100-Ultrasonic-Distance-Sensor-Module
 void InitializeDistanceSensor(void);
 void DeinitializeDistanceSerial(void);
 
-int32_t DistanceSensorGetDistance (uint16_t *distance, const TickType_t xMaxBlockTime);
+int32_t DistanceSensorGetLatest(DistanceReading *reading);
+uint8_t DistanceSensorGetHistory(DistanceReading *readings, uint8_t maxReadings);
+int32_t DistanceSensorSetSamplePeriod(uint16_t periodMs);
+void DistanceSensorGetStats(DistanceSensorStats *stats);
 
 
 
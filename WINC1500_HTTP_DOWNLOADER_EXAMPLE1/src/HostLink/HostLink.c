@@ -0,0 +1,525 @@
+/**************************************************************************//**
+* @file      HostLink.c
+* @brief     Binary host protocol, multiplexed with the text CLI on the console UART.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "HostLink/HostLink.h"
+#include "CliThread/CliThread.h"
+#include "IMU/ImuAcquisition.h"
+#include "I2cDriver/I2cDriver.h"
+#include "WifiHandlerThread/WifiHandler.h"
+#include "SerialConsole.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define HOST_LINK_XON				0x11	///<Escaped so the console flow control never sees it inside a frame
+#define HOST_LINK_XOFF				0x13
+#define HOST_LINK_CRC_INIT			0xFFFF	///<Initial value of the CRC
+#define HOST_LINK_PATH_LEN			12		///<Longest 8.3 file name
+#define HOST_LINK_IMU_HEADER_SIZE	12		///<Bytes before the samples of an IMU event
+#define HOST_LINK_STORAGE_WAIT_MS	100		///<Longest wait for the SD card while the Wi-Fi task writes to it
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static uint8_t rxPacket[HOST_LINK_MAX_PACKET];		///<Packet being received, unescaped
+static uint16_t rxLen = 0;							///<Bytes in rxPacket
+static bool rxInFrame = false;						///<An END opened a frame
+static bool rxEscape = false;						///<The last byte was ESC
+
+static uint8_t answerData[HOST_LINK_MAX_DATA];		///<Data of the answer being built. Byte 0 is the status
+static uint8_t answerFrame[HOST_LINK_MAX_FRAME];	///<Answers are encoded here, by the CLI task
+static uint8_t streamData[HOST_LINK_MAX_DATA];		///<Data of the IMU event being built
+static uint8_t streamFrame[HOST_LINK_MAX_FRAME];	///<IMU events are encoded here, by the acquisition task
+static volatile bool streamOn = false;				///<IMU blocks are sent to the host
+static uint8_t streamSequence = 0;					///<Sequence of the next IMU event
+
+static FIL hostLinkFile;							///<File opened by the host
+static bool hostLinkFileOpen = false;				///<hostLinkFile is open
+
+static HostLinkStats hostLinkStats;					///<Link statistics
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static uint16_t HostLinkCrc(uint16_t crc, const uint8_t *data, uint16_t len);
+static uint16_t HostLinkEscape(uint8_t *frame, uint16_t pos, uint8_t value);
+static bool HostLinkSend(uint8_t *frame, uint8_t type, uint8_t sequence, const uint8_t *data, uint16_t len, TickType_t timeout);
+static void HostLinkReply(uint8_t type, uint8_t sequence, uint8_t status, uint16_t len);
+static void HostLinkHandlePacket(void);
+static void HostLinkRunCli(uint8_t sequence, const uint8_t *data, uint16_t len);
+static void HostLinkBulk(uint8_t sequence, const uint8_t *data, uint16_t len);
+static void HostLinkFileCommand(uint8_t type, uint8_t sequence, const uint8_t *data, uint16_t len);
+static FRESULT HostLinkFileRun(uint8_t type, const uint8_t *data, uint16_t len, uint16_t *answerLen);
+static void HostLinkConsumeBlock(const ImuBlock *block);
+static void HostLinkPut16(uint8_t *buffer, uint16_t value);
+static void HostLinkPut32(uint8_t *buffer, uint32_t value);
+static uint32_t HostLinkGet32(const uint8_t *buffer);
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static uint16_t HostLinkCrc(uint16_t crc, const uint8_t *data, uint16_t len)
+* @brief	CRC-16/CCITT-FALSE: polynomial 0x1021, initial value HOST_LINK_CRC_INIT, no reflection
+* @param[in]	crc HOST_LINK_CRC_INIT, or the CRC of the preceding bytes
+*****************************************************************************/
+static uint16_t HostLinkCrc(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+	while(len--)
+	{
+		crc ^= (uint16_t)(*data++) << 8;
+		for(uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+/**************************************************************************//**
+* @fn		static uint16_t HostLinkEscape(uint8_t *frame, uint16_t pos, uint8_t value)
+* @brief	Writes one packet byte into a frame, escaped if needed
+* @return	Position after the written bytes
+*****************************************************************************/
+static uint16_t HostLinkEscape(uint8_t *frame, uint16_t pos, uint8_t value)
+{
+	switch(value)
+	{
+		case HOST_LINK_END:		frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_END; break;
+		case HOST_LINK_ESC:		frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_ESC; break;
+		case HOST_LINK_XON:		frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_XON; break;
+		case HOST_LINK_XOFF:	frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_XOFF; break;
+		default:				frame[pos++] = value; break;
+	}
+	return pos;
+}
+
+/**************************************************************************//**
+* @fn		static bool HostLinkSend(uint8_t *frame, uint8_t type, uint8_t sequence, const uint8_t *data, uint16_t len, TickType_t timeout)
+* @brief	Encodes a packet into frame and queues it on the console
+* @param[in]	frame Buffer of HOST_LINK_MAX_FRAME bytes owned by the calling task
+* @param[in]	timeout Longest wait for room in the console TX buffer, in ticks
+* @return	true if queued, false if the console had no room in time
+*****************************************************************************/
+static bool HostLinkSend(uint8_t *frame, uint8_t type, uint8_t sequence, const uint8_t *data, uint16_t len, TickType_t timeout)
+{
+	uint8_t header[HOST_LINK_HEADER_SIZE] = {type, sequence};
+	uint16_t crc = HostLinkCrc(HostLinkCrc(HOST_LINK_CRC_INIT, header, HOST_LINK_HEADER_SIZE), data, len);
+	uint16_t pos = 0;
+
+	frame[pos++] = HOST_LINK_END;
+	pos = HostLinkEscape(frame, pos, type);
+	pos = HostLinkEscape(frame, pos, sequence);
+	for(uint16_t i = 0; i < len; i++)
+	{
+		pos = HostLinkEscape(frame, pos, data[i]);
+	}
+	pos = HostLinkEscape(frame, pos, (uint8_t)(crc & 0xFF));
+	pos = HostLinkEscape(frame, pos, (uint8_t)(crc >> 8));
+	frame[pos++] = HOST_LINK_END;
+
+	return SerialConsoleWriteBuffer(frame, pos, timeout);
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkReply(uint8_t type, uint8_t sequence, uint8_t status, uint16_t len)
+* @brief	Sends answerData as the answer to a request
+* @param[in]	status Written to answerData[0]
+* @param[in]	len Bytes of answerData after the status
+*****************************************************************************/
+static void HostLinkReply(uint8_t type, uint8_t sequence, uint8_t status, uint16_t len)
+{
+	answerData[0] = status;
+	HostLinkSend(answerFrame, type | HOST_LINK_RESPONSE, sequence, answerData, len + 1, pdMS_TO_TICKS(HOST_LINK_TX_TIMEOUT_MS));
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkHandlePacket(void)
+* @brief	Checks the packet in rxPacket and runs the request
+*****************************************************************************/
+static void HostLinkHandlePacket(void)
+{
+	uint16_t len;
+	uint8_t type, sequence;
+	const uint8_t *data;
+
+	if(rxLen < HOST_LINK_HEADER_SIZE + HOST_LINK_CRC_SIZE)
+	{
+		hostLinkStats.crcErrors++;
+		return;
+	}
+	len = rxLen - HOST_LINK_CRC_SIZE;
+	if(HostLinkCrc(HOST_LINK_CRC_INIT, rxPacket, len) != (uint16_t)(rxPacket[len] | (rxPacket[len + 1] << 8)))
+	{
+		hostLinkStats.crcErrors++;
+		return;
+	}
+	hostLinkStats.frames++;
+
+	type = rxPacket[0];
+	sequence = rxPacket[1];
+	data = &rxPacket[HOST_LINK_HEADER_SIZE];
+	len -= HOST_LINK_HEADER_SIZE;
+
+	switch(type)
+	{
+		case HOST_LINK_CMD_PING:
+			memcpy(&answerData[1], data, (len < HOST_LINK_MAX_DATA - 1) ? len : HOST_LINK_MAX_DATA - 1);
+			HostLinkReply(type, sequence, HOST_LINK_STATUS_OK, (len < HOST_LINK_MAX_DATA - 1) ? len : HOST_LINK_MAX_DATA - 1);
+			break;
+
+		case HOST_LINK_CMD_CLI:
+			HostLinkRunCli(sequence, data, len);
+			break;
+
+		case HOST_LINK_CMD_BULK:
+			HostLinkBulk(sequence, data, len);
+			break;
+
+		case HOST_LINK_CMD_STREAM:
+			if(len < 1)
+			{
+				HostLinkReply(type, sequence, HOST_LINK_STATUS_BAD_ARG, 0);
+				break;
+			}
+			streamOn = (data[0] != 0);
+			HostLinkReply(type, sequence, HOST_LINK_STATUS_OK, 0);
+			break;
+
+		case HOST_LINK_CMD_FILE_OPEN:
+		case HOST_LINK_CMD_FILE_READ:
+		case HOST_LINK_CMD_FILE_WRITE:
+		case HOST_LINK_CMD_FILE_CLOSE:
+			HostLinkFileCommand(type, sequence, data, len);
+			break;
+
+		default:
+			HostLinkReply(type, sequence, HOST_LINK_STATUS_UNKNOWN, 0);
+			break;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkRunCli(uint8_t sequence, const uint8_t *data, uint16_t len)
+* @brief	Runs a CLI command line and sends its output, one answer per chunk
+*****************************************************************************/
+static void HostLinkRunCli(uint8_t sequence, const uint8_t *data, uint16_t len)
+{
+	static char command[MAX_INPUT_LENGTH_CLI];
+	BaseType_t more;
+
+	if(len == 0 || len >= MAX_INPUT_LENGTH_CLI)
+	{
+		HostLinkReply(HOST_LINK_CMD_CLI, sequence, HOST_LINK_STATUS_BAD_ARG, 0);
+		return;
+	}
+	memcpy(command, data, len);
+	command[len] = 0;
+
+	do
+	{
+		answerData[1] = 0;
+		more = FreeRTOS_CLIProcessCommand(command, (char *) &answerData[1], HOST_LINK_MAX_DATA - 1);
+		answerData[HOST_LINK_MAX_DATA - 1] = 0;	//Ensure null termination
+		HostLinkReply(HOST_LINK_CMD_CLI, sequence, (more != pdFALSE) ? HOST_LINK_STATUS_MORE : HOST_LINK_STATUS_OK,
+			strlen((char *) &answerData[1]));
+	} while(more != pdFALSE);
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkBulk(uint8_t sequence, const uint8_t *data, uint16_t len)
+* @brief	Sends the requested number of full answers as fast as the UART takes them
+* @details	The filler of answer n is (n + i) & 0xFF, so the host can check it
+*****************************************************************************/
+static void HostLinkBulk(uint8_t sequence, const uint8_t *data, uint16_t len)
+{
+	uint16_t count;
+
+	if(len < 2)
+	{
+		HostLinkReply(HOST_LINK_CMD_BULK, sequence, HOST_LINK_STATUS_BAD_ARG, 0);
+		return;
+	}
+	count = data[0] | (data[1] << 8);
+
+	for(uint16_t n = 0; n < count; n++)
+	{
+		for(uint16_t i = 1; i < HOST_LINK_MAX_DATA; i++)
+		{
+			answerData[i] = (uint8_t)(n + i);
+		}
+		HostLinkReply(HOST_LINK_CMD_BULK, sequence, (n + 1 < count) ? HOST_LINK_STATUS_MORE : HOST_LINK_STATUS_OK,
+			HOST_LINK_MAX_DATA - 1);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkFileCommand(uint8_t type, uint8_t sequence, const uint8_t *data, uint16_t len)
+* @brief	Runs the SD card file requests
+* @details	Reads and writes carry their offset, so a request can be repeated after a lost answer. The file system is
+*			only held while the request runs, and never while the answer is sent.
+*****************************************************************************/
+static void HostLinkFileCommand(uint8_t type, uint8_t sequence, const uint8_t *data, uint16_t len)
+{
+	uint16_t answerLen = 0;
+	FRESULT res;
+
+	switch(type)
+	{
+		case HOST_LINK_CMD_FILE_OPEN:
+			if(len < 2 || len - 1 > HOST_LINK_PATH_LEN || data[0] > HOST_LINK_FILE_WRITE)
+			{
+				HostLinkReply(type, sequence, HOST_LINK_STATUS_BAD_ARG, 0);
+				return;
+			}
+			break;
+
+		case HOST_LINK_CMD_FILE_READ:
+			if(len < 5 || data[4] > HOST_LINK_MAX_DATA - 1)
+			{
+				HostLinkReply(type, sequence, HOST_LINK_STATUS_BAD_ARG, 0);
+				return;
+			}
+			break;
+
+		case HOST_LINK_CMD_FILE_WRITE:
+			if(len < 4)
+			{
+				HostLinkReply(type, sequence, HOST_LINK_STATUS_BAD_ARG, 0);
+				return;
+			}
+			break;
+
+		default: //HOST_LINK_CMD_FILE_CLOSE
+			break;
+	}
+	if(type != HOST_LINK_CMD_FILE_OPEN && !hostLinkFileOpen)
+	{
+		HostLinkReply(type, sequence, HOST_LINK_STATUS_NO_FILE, 0);
+		return;
+	}
+
+	if(!WifiStorageLock(pdMS_TO_TICKS(HOST_LINK_STORAGE_WAIT_MS)))
+	{
+		HostLinkReply(type, sequence, HOST_LINK_STATUS_BUSY, 0);
+		return;
+	}
+	res = HostLinkFileRun(type, data, len, &answerLen);
+	WifiStorageUnlock();
+
+	if(res != FR_OK)
+	{
+		answerData[1] = (uint8_t) res;
+		HostLinkReply(type, sequence, HOST_LINK_STATUS_FS_ERROR, 1);
+		return;
+	}
+	HostLinkReply(type, sequence, HOST_LINK_STATUS_OK, answerLen);
+}
+
+/**************************************************************************//**
+* @fn		static FRESULT HostLinkFileRun(uint8_t type, const uint8_t *data, uint16_t len, uint16_t *answerLen)
+* @brief	Makes the FatFs calls of a checked file request
+* @param[out]	answerLen Bytes written to answerData after the status
+* @note		Call with the storage lock held
+*****************************************************************************/
+static FRESULT HostLinkFileRun(uint8_t type, const uint8_t *data, uint16_t len, uint16_t *answerLen)
+{
+	static char path[HOST_LINK_PATH_LEN + 3];
+	FRESULT res;
+	UINT done = 0;
+
+	switch(type)
+	{
+		case HOST_LINK_CMD_FILE_OPEN:
+			if(hostLinkFileOpen)
+			{
+				f_close(&hostLinkFile);
+				hostLinkFileOpen = false;
+			}
+			path[0] = LUN_ID_SD_MMC_0_MEM + '0';
+			path[1] = ':';
+			memcpy(&path[2], &data[1], len - 1);
+			path[len + 1] = 0;
+			res = f_open(&hostLinkFile, path, (data[0] == HOST_LINK_FILE_WRITE) ? (FA_CREATE_ALWAYS | FA_WRITE) : (FA_OPEN_EXISTING | FA_READ));
+			if(res != FR_OK) return res;
+			hostLinkFileOpen = true;
+			HostLinkPut32(&answerData[1], f_size(&hostLinkFile));
+			*answerLen = 4;
+			return FR_OK;
+
+		case HOST_LINK_CMD_FILE_READ:
+			res = f_lseek(&hostLinkFile, HostLinkGet32(data));
+			if(res == FR_OK) res = f_read(&hostLinkFile, &answerData[1], data[4], &done);
+			*answerLen = (uint16_t) done;
+			return res;
+
+		case HOST_LINK_CMD_FILE_WRITE:
+			res = f_lseek(&hostLinkFile, HostLinkGet32(data));
+			if(res == FR_OK) res = f_write(&hostLinkFile, &data[4], len - 4, &done);
+			if(res == FR_OK && done != len - 4u) res = FR_DENIED; //Card full
+			return res;
+
+		default: //HOST_LINK_CMD_FILE_CLOSE
+			hostLinkFileOpen = false;
+			return f_close(&hostLinkFile);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkConsumeBlock(const ImuBlock *block)
+* @brief	Sends an IMU block to the host while the stream is on
+* @details	Called by the acquisition task. A block that does not fit in the console TX buffer right away is dropped
+*			rather than holding up the acquisition; the host sees the gap in the block sequence.
+*****************************************************************************/
+static void HostLinkConsumeBlock(const ImuBlock *block)
+{
+	uint16_t pos = HOST_LINK_IMU_HEADER_SIZE;
+
+	if(!streamOn) return;
+
+	HostLinkPut32(&streamData[0], block->tick);
+	HostLinkPut32(&streamData[4], block->sequence);
+	HostLinkPut16(&streamData[8], (uint16_t) block->periodUs);
+	streamData[10] = block->count;
+	streamData[11] = block->flags;
+	for(uint8_t i = 0; i < block->count; i++)
+	{
+		for(uint8_t axis = 0; axis < 3; axis++)
+		{
+			HostLinkPut16(&streamData[pos], (uint16_t) block->sample[i].gyro[axis]);
+			pos += 2;
+		}
+		for(uint8_t axis = 0; axis < 3; axis++)
+		{
+			HostLinkPut16(&streamData[pos], (uint16_t) block->sample[i].accel[axis]);
+			pos += 2;
+		}
+	}
+
+	if(!HostLinkSend(streamFrame, HOST_LINK_EVENT_IMU, streamSequence++, streamData, pos, 0))
+	{
+		hostLinkStats.streamDrops++;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkPut16(uint8_t *buffer, uint16_t value)
+* @brief	Writes a 16-bit value, little endian
+*****************************************************************************/
+static void HostLinkPut16(uint8_t *buffer, uint16_t value)
+{
+	buffer[0] = (uint8_t) value;
+	buffer[1] = (uint8_t)(value >> 8);
+}
+
+/**************************************************************************//**
+* @fn		static void HostLinkPut32(uint8_t *buffer, uint32_t value)
+* @brief	Writes a 32-bit value, little endian
+*****************************************************************************/
+static void HostLinkPut32(uint8_t *buffer, uint32_t value)
+{
+	HostLinkPut16(buffer, (uint16_t) value);
+	HostLinkPut16(buffer + 2, (uint16_t)(value >> 16));
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t HostLinkGet32(const uint8_t *buffer)
+* @brief	Reads a 32-bit value, little endian
+*****************************************************************************/
+static uint32_t HostLinkGet32(const uint8_t *buffer)
+{
+	return buffer[0] | (buffer[1] << 8) | ((uint32_t) buffer[2] << 16) | ((uint32_t) buffer[3] << 24);
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		int32_t HostLinkInit(void)
+* @brief	Registers the IMU stream with the acquisition
+* @return	ERROR_NONE, or an error from ImuAcquisitionRegisterConsumer
+* @note		Call before the scheduler starts
+*****************************************************************************/
+int32_t HostLinkInit(void)
+{
+	return ImuAcquisitionRegisterConsumer(HostLinkConsumeBlock);
+}
+
+/**************************************************************************//**
+* @fn		bool HostLinkInput(uint8_t rxChar)
+* @brief	Feeds a received character to the frame decoder, and runs the request once a frame is complete
+* @details	Called by the CLI task for every character, before the text CLI sees it. Characters outside a frame are left
+*			to the CLI. A frame longer than a packet is dropped and the decoder goes back to text, so a lost END
+*			cannot take over the console.
+* @param[in]	rxChar Received character
+* @return	true if the character belonged to a frame, false if it is CLI text
+*****************************************************************************/
+bool HostLinkInput(uint8_t rxChar)
+{
+	if(rxChar == HOST_LINK_END)
+	{
+		if(rxInFrame && rxLen > 0)
+		{
+			HostLinkHandlePacket();
+			rxInFrame = false;
+		}
+		else
+		{
+			rxInFrame = true; //Opening END, or back-to-back ENDs
+		}
+		rxLen = 0;
+		rxEscape = false;
+		return true;
+	}
+
+	if(!rxInFrame) return false;
+
+	if(rxChar == HOST_LINK_ESC)
+	{
+		rxEscape = true;
+		return true;
+	}
+	if(rxEscape)
+	{
+		rxEscape = false;
+		switch(rxChar)
+		{
+			case HOST_LINK_ESC_END:		rxChar = HOST_LINK_END; break;
+			case HOST_LINK_ESC_ESC:		rxChar = HOST_LINK_ESC; break;
+			case HOST_LINK_ESC_XON:		rxChar = HOST_LINK_XON; break;
+			case HOST_LINK_ESC_XOFF:	rxChar = HOST_LINK_XOFF; break;
+			default:					break; //Invalid escape, the CRC will reject the packet
+		}
+	}
+
+	if(rxLen >= HOST_LINK_MAX_PACKET)
+	{
+		hostLinkStats.overflows++;
+		rxInFrame = false;
+		rxLen = 0;
+		return true;
+	}
+	rxPacket[rxLen++] = rxChar;
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		void HostLinkGetStats(HostLinkStats *stats)
+* @brief	Copies the link statistics
+* @param[out]	stats Statistics
+*****************************************************************************/
+void HostLinkGetStats(HostLinkStats *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = hostLinkStats;
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,103 @@
+/**************************************************************************//**
+* @file      HostLink.h
+* @brief     Binary host protocol, multiplexed with the text CLI on the console UART.
+Packets are SLIP framed: each packet is sent between two HOST_LINK_END bytes, and END, ESC, XON and XOFF inside it
+are replaced by two byte escapes. Text typed on a terminal never holds END, and the escaped XON and XOFF let the
+console keep its software flow control while frames go through.
+A packet is: type (1), sequence (1), data (0 to HOST_LINK_MAX_DATA), CRC-16/CCITT of all previous bytes (2, LSB
+first). The device answers each request with the type | HOST_LINK_RESPONSE and the same sequence; the first data
+byte of an answer is a HOST_LINK_STATUS_* value. Packets with a bad CRC are dropped, the host retries.
+Requests:
+- PING: answers with the same data.
+- CLI: runs the command line in data. Answers one frame per output chunk, status MORE on all but the last.
+- STREAM: data[0] 1 starts, 0 stops sending every IMU block as an IMU event (type HOST_LINK_EVENT_IMU).
+  An event holds tick (4), sequence (4), period in us (2), count (1), flags (1), then count samples of 6 int16.
+- FILE_OPEN: data[0] HOST_LINK_FILE_READ or HOST_LINK_FILE_WRITE, then the 8.3 path. Answers the size (4).
+- FILE_READ: offset (4), length (1). Answers the bytes read, none at the end of the file.
+- FILE_WRITE: offset (4), then the bytes to write.
+- FILE_CLOSE: closes the file.
+- BULK: count (2). Answers with count frames of HOST_LINK_MAX_DATA - 1 filler bytes, to measure throughput.
+All multi-byte values are little endian. tools/host_link.py is the host side.
+
+******************************************************************************/
+
+
+#ifndef HOST_LINK_H
+#define HOST_LINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "asf.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define HOST_LINK_END				0xC0	///<Frame delimiter
+#define HOST_LINK_ESC				0xDB	///<Escape
+#define HOST_LINK_ESC_END			0xDC	///<ESC ESC_END stands for END
+#define HOST_LINK_ESC_ESC			0xDD	///<ESC ESC_ESC stands for ESC
+#define HOST_LINK_ESC_XON			0xDE	///<ESC ESC_XON stands for XON (0x11)
+#define HOST_LINK_ESC_XOFF			0xDF	///<ESC ESC_XOFF stands for XOFF (0x13)
+
+#define HOST_LINK_MAX_DATA			208		///<Largest data of a packet. Fits one IMU block
+#define HOST_LINK_HEADER_SIZE		2		///<Type and sequence
+#define HOST_LINK_CRC_SIZE			2		///<CRC-16 after the data
+#define HOST_LINK_MAX_PACKET		(HOST_LINK_HEADER_SIZE + HOST_LINK_MAX_DATA + HOST_LINK_CRC_SIZE)
+#define HOST_LINK_MAX_FRAME			(2 * HOST_LINK_MAX_PACKET + 2)	///<Every byte escaped, and both ENDs
+#define HOST_LINK_TX_TIMEOUT_MS		100		///<Longest wait for room in the console TX buffer for an answer
+
+#define HOST_LINK_RESPONSE			0x80	///<Set in the type of an answer
+
+#define HOST_LINK_CMD_PING			0x01	///<Echo
+#define HOST_LINK_CMD_CLI			0x02	///<Run a CLI command
+#define HOST_LINK_CMD_BULK			0x03	///<Send filler frames
+#define HOST_LINK_CMD_STREAM		0x10	///<Start or stop the IMU stream
+#define HOST_LINK_CMD_FILE_OPEN		0x20	///<Open a file on the SD card
+#define HOST_LINK_CMD_FILE_READ		0x21	///<Read from the open file
+#define HOST_LINK_CMD_FILE_WRITE	0x22	///<Write to the open file
+#define HOST_LINK_CMD_FILE_CLOSE	0x23	///<Close the open file
+#define HOST_LINK_EVENT_IMU			0x90	///<IMU block, sent while the stream is on
+
+#define HOST_LINK_FILE_READ			0		///<FILE_OPEN mode: read an existing file
+#define HOST_LINK_FILE_WRITE		1		///<FILE_OPEN mode: create or truncate the file
+
+#define HOST_LINK_STATUS_OK			0x00	///<Done
+#define HOST_LINK_STATUS_MORE		0x01	///<More answers follow
+#define HOST_LINK_STATUS_UNKNOWN	0x10	///<Unknown request type
+#define HOST_LINK_STATUS_BAD_ARG	0x11	///<Data too short or out of range
+#define HOST_LINK_STATUS_BUSY		0x12	///<The SD card is used by the Wi-Fi task or not mounted
+#define HOST_LINK_STATUS_NO_FILE	0x13	///<No file open
+#define HOST_LINK_STATUS_FS_ERROR	0x14	///<FatFs error, its FRESULT follows
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Statistics of the link
+typedef struct HostLinkStats
+{
+	uint32_t frames;		///<Valid packets received
+	uint32_t crcErrors;		///<Frames dropped for a bad CRC or a short packet
+	uint32_t overflows;		///<Frames dropped for being longer than HOST_LINK_MAX_PACKET
+	uint32_t streamDrops;	///<IMU blocks not sent because the console TX buffer was full
+} HostLinkStats;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+int32_t HostLinkInit(void);
+bool HostLinkInput(uint8_t rxChar);
+void HostLinkGetStats(HostLinkStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*HOST_LINK_H*/
@@ -1,6 +1,9 @@
 /**************************************************************************//**
 * @file      I2cDriver.c
 * @brief     FreeRTOS compatible driver for I2C communications
+* @details   Transfers are described by I2cRequest structures that are queued per priority class. The SERCOM interrupt
+			 completes the active request and starts the next one straight away, so back to back transfers do not need
+			 any task to run in between. Sensor requests are always started before LED/UI requests that are waiting.
 * @author    Eduardo Garcia
 * @date      2020-04-05
 
@@ -15,22 +18,47 @@
 /******************************************************************************
 * Defines
 ******************************************************************************/
+#define I2C_PHASE_FIRST		0	///<Active request is on its first (or only) transfer
+#define I2C_PHASE_READ		1	///<Active request is on the read transfer of a write + read request
+#define I2C_SPEED_NONE		0xFF	///<Bus speed not programmed yet
 
 /******************************************************************************
 * Variables
 ******************************************************************************/
-SemaphoreHandle_t sensorI2cMutexHandle;						 ///<Mutex to handle the sensor I2C bus thread access.
-SemaphoreHandle_t sensorI2cSemaphoreHandle;		///<Binary semaphore to notify task that we have received an I2C interrupt on the Sensor bus
-static volatile TaskHandle_t xTaskToNotifySensorDone = NULL; ///< Stores the handle of the task that will be notified when the SENSOR transmission is complete. */
-static uint8_t sensorTransmitError = false;					 ///<Flag used to indicate that there was an I2C transmission error on the SENSOR bus.
+SemaphoreHandle_t sensorI2cMutexHandle;						 ///<Mutex that lets a task own the sensor I2C bus for a group of requests.
+static StaticSemaphore_t sensorI2cMutexBuffer;					 ///<Storage of sensorI2cMutexHandle
 
 struct i2c_master_module i2cSensorBusInstance;
 static I2C_Bus_State I2cSensorBusState;   ///<Structure that defines the I2C Bus used for the sensors.
 
-struct i2c_master_packet sensorPacketWrite;
+static struct i2c_master_packet sensorPacketWrite;				///<Packet of the write transfer of the active request
+static struct i2c_master_packet sensorPacketRead;				///<Packet of the read transfer of the active request
+static I2cRequest *i2cQueueHead[I2C_PRIORITY_MAX];				///<First queued request of each priority class
+static I2cRequest *i2cQueueTail[I2C_PRIORITY_MAX];				///<Last queued request of each priority class
+static I2cRequest *volatile i2cActive = NULL;					///<Request currently on the bus
+static uint8_t i2cActivePhase = I2C_PHASE_FIRST;				///<Transfer of the active request that is on the bus
+static volatile bool i2cRecoveryPending = false;				///<Set when the bus may be held by a slave. No request is started until it is recovered.
+static I2cBusStats i2cStats;									///<Error counters of the sensor bus
+static uint32_t i2cBaudReg[I2C_SPEED_MAX];						///<BAUD register value of each bus speed
+static uint32_t i2cSpeedCtrla[I2C_SPEED_MAX];					///<CTRLA.SPEED field of each bus speed
+static uint8_t i2cCurrentSpeed = I2C_SPEED_NONE;				///<Speed the bus is programmed for
+static const uint16_t i2cSpeedKhz[I2C_SPEED_MAX] = {100, 400, 1000};	///<SCL frequency of each bus speed, in kHz
+
 /******************************************************************************
 * Forward Declarations
 ******************************************************************************/
+static int32_t I2cDriverConfigureSensorBus(void);
+static void I2cDriverComputeBusSpeeds(uint16_t riseTimeNs);
+static void I2cBusSetSpeed(uint8_t speed);
+static void I2cRecoveryLineSet(uint8_t pin, bool high);
+static void I2cBusRecover(void);
+static enum status_code I2cEngineStartTransfer(I2cRequest *request);
+static void I2cEngineStartNext(BaseType_t *pxHigherPriorityTaskWoken);
+static void I2cEngineComplete(int32_t status, BaseType_t *pxHigherPriorityTaskWoken);
+static bool I2cQueueRemove(I2cRequest *request);
+static void I2cCancelRequest(I2cRequest *request);
+static int32_t I2cTransferWait(I2C_Data *data, eI2cRequestType type, const TickType_t xMaxBlockTime);
+
 static int32_t I2cDriverConfigureSensorBus(void)
 {
 	int32_t error = STATUS_OK;
@@ -38,13 +66,15 @@ static int32_t I2cDriverConfigureSensorBus(void)
 	/* Initialize config structure and software module */
 	struct i2c_master_config config_i2c_master;
 	i2c_master_get_config_defaults(&config_i2c_master);
-	
-	config_i2c_master.pinmux_pad0 = PINMUX_PA08C_SERCOM0_PAD0;
-	config_i2c_master.pinmux_pad1 = PINMUX_PA09C_SERCOM0_PAD1;
+
+	config_i2c_master.pinmux_pad0 = I2C_SENSOR_SDA_PINMUX;
+	config_i2c_master.pinmux_pad1 = I2C_SENSOR_SCL_PINMUX;
 	/* Change buffer timeout to something longer */
 	config_i2c_master.buffer_timeout = 1000;
+	/* Let the hardware flag a slave that holds SCL low, so the transfer fails instead of hanging */
+	config_i2c_master.scl_low_timeout = true;
 	/* Initialize and enable device with config. Try three times to initialize */
-	
+
 	for(uint8_t i = I2C_INIT_ATTEMPTS; i != 0; i--){
 		errCodeAsf = i2c_master_init(&i2cSensorBusInstance, SERCOM0, &config_i2c_master);
 		if(STATUS_OK == errCodeAsf){
@@ -54,56 +84,368 @@ static int32_t I2cDriverConfigureSensorBus(void)
 			i2c_master_reset(&i2cSensorBusInstance);
 		}
 	}
-	
+
 	if(STATUS_OK != error) goto exit;
-	
+
+	I2cDriverComputeBusSpeeds(config_i2c_master.sda_scl_rise_time_ns);
+	i2cCurrentSpeed = I2C_SPEED_STANDARD;
+
 	i2c_master_enable(&i2cSensorBusInstance);
-	
+
 	exit:
 	return error;
 }
+
+/**************************************************************************//**
+ * @fn			static void I2cDriverComputeBusSpeeds(uint16_t riseTimeNs)
+ * @brief       Computes the BAUD register of each bus speed, the same way ASF does in i2c_master_init
+ * @details     Speeds that the SERCOM clock cannot reach fall back to the next slower speed.
+ * @param[in]   riseTimeNs SDA/SCL rise time of the bus, in ns
+ *****************************************************************************/
+static void I2cDriverComputeBusSpeeds(uint16_t riseTimeNs)
+{
+	const uint32_t fgclk = system_gclk_chan_get_hz(SERCOM0_GCLK_ID_CORE);
+	const uint32_t riseCycles = ((fgclk / 1000) * riseTimeNs) / 1000000;
+
+	for(uint8_t speed = 0; speed < I2C_SPEED_MAX; speed++){
+		uint32_t fscl = 1000UL * i2cSpeedKhz[speed];
+		int32_t baud = (int32_t)fgclk - (int32_t)(fscl * (10 + riseCycles));
+		baud = (baud + (int32_t)(2 * fscl) - 1) / (int32_t)(2 * fscl);
+
+		if((baud < 0 || baud > 255) && speed > 0){
+			i2cBaudReg[speed] = i2cBaudReg[speed - 1];
+			i2cSpeedCtrla[speed] = i2cSpeedCtrla[speed - 1];
+			continue;
+		}
+		i2cBaudReg[speed] = SERCOM_I2CM_BAUD_BAUD(baud);
+		i2cSpeedCtrla[speed] = (speed == I2C_SPEED_FAST_PLUS) ? I2C_MASTER_SPEED_FAST_MODE_PLUS : I2C_MASTER_SPEED_STANDARD_AND_FAST;
+	}
+}
+
+/**************************************************************************//**
+ * @fn			static void I2cBusSetSpeed(uint8_t speed)
+ * @brief       Reprograms the SCL frequency of the bus for the next transfer
+ * @details     BAUD and CTRLA.SPEED can only be written with the SERCOM disabled. The STOP of the previous transfer is let out
+				first, and the bus state is forced back to idle once the SERCOM is enabled again.
+ * @param[in]   speed eI2cSpeed to program
+ * @note        Called with interrupts masked, or from the SERCOM interrupt, between transfers
+ *****************************************************************************/
+static void I2cBusSetSpeed(uint8_t speed)
+{
+	SercomI2cm *const i2cHw = &(i2cSensorBusInstance.hw->I2CM);
+	uint32_t timeout = 0;
+
+	if(speed >= I2C_SPEED_MAX || speed == i2cCurrentSpeed) return;
+
+	while((i2cHw->STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) == SERCOM_I2CM_STATUS_BUSSTATE(2) &&
+	      timeout++ < i2cSensorBusInstance.unknown_bus_state_timeout);
+
+	_i2c_master_wait_for_sync(&i2cSensorBusInstance);
+	i2cHw->CTRLA.reg &= ~SERCOM_I2CM_CTRLA_ENABLE;
+	_i2c_master_wait_for_sync(&i2cSensorBusInstance);
+
+	i2cHw->CTRLA.reg = (i2cHw->CTRLA.reg & ~SERCOM_I2CM_CTRLA_SPEED_Msk) | i2cSpeedCtrla[speed];
+	i2cHw->BAUD.reg = i2cBaudReg[speed];
+
+	i2cHw->CTRLA.reg |= SERCOM_I2CM_CTRLA_ENABLE;
+	_i2c_master_wait_for_sync(&i2cSensorBusInstance);
+	i2cHw->STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(1);
+	_i2c_master_wait_for_sync(&i2cSensorBusInstance);
+
+	i2cCurrentSpeed = speed;
+	i2cStats.speedChanges++;
+}
+
+/**************************************************************************//**
+ * @fn			static void I2cRecoveryLineSet(uint8_t pin, bool high)
+ * @brief       Drives a bus line as open drain during bus recovery
+ * @param[in]   pin GPIO pin of the line
+ * @param[in]   high true to release the line (pulled up), false to drive it low
+ *****************************************************************************/
+static void I2cRecoveryLineSet(uint8_t pin, bool high)
+{
+	struct port_config pinConfig;
+
+	port_get_config_defaults(&pinConfig);
+	if(high){
+		pinConfig.direction = PORT_PIN_DIR_INPUT;
+		pinConfig.input_pull = PORT_PIN_PULL_UP;
+		port_pin_set_config(pin, &pinConfig);
+	}else{
+		port_pin_set_output_level(pin, false);
+		pinConfig.direction = PORT_PIN_DIR_OUTPUT_WTH_READBACK;
+		port_pin_set_config(pin, &pinConfig);
+	}
+	delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+}
+
+/**************************************************************************//**
+ * @fn			static void I2cBusRecover(void)
+ * @brief       Frees a bus held by a slave and restarts the queued requests
+ * @details     A slave that lost track of a transfer (e.g., reset of the MCU in the middle of a read) keeps SDA low until it gets the
+				clocks it expects. The SERCOM is disabled, SCL is toggled as a GPIO until the slave releases SDA (at most
+				I2C_RECOVERY_CLOCKS clocks) and a STOP is generated. Then the pins are given back to the SERCOM.
+ * @note        Called from a task. The SCL toggling takes around 100us, so it runs with the scheduler suspended and
+				interrupts enabled: no task can queue a request meanwhile, and the SERCOM does not interrupt since no request is active.
+				Interrupts are only masked to hand the pins over between the SERCOM and the GPIOs.
+ *****************************************************************************/
+static void I2cBusRecover(void)
+{
+	struct system_pinmux_config muxConfig;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	bool released;
+
+	vTaskSuspendAll();
+	taskENTER_CRITICAL();
+	if(!i2cRecoveryPending || i2cActive != NULL){
+		taskEXIT_CRITICAL();
+		xTaskResumeAll();
+		return;
+	}
+	i2c_master_disable(&i2cSensorBusInstance);
+	taskEXIT_CRITICAL();
+
+	I2cRecoveryLineSet(I2C_SENSOR_SDA_PIN, true);
+	I2cRecoveryLineSet(I2C_SENSOR_SCL_PIN, true);
+	for(uint8_t i = 0; i < I2C_RECOVERY_CLOCKS && !port_pin_get_input_level(I2C_SENSOR_SDA_PIN); i++){
+		I2cRecoveryLineSet(I2C_SENSOR_SCL_PIN, false);
+		I2cRecoveryLineSet(I2C_SENSOR_SCL_PIN, true);
+	}
+
+	//STOP: SDA rises while SCL is high
+	I2cRecoveryLineSet(I2C_SENSOR_SCL_PIN, false);
+	I2cRecoveryLineSet(I2C_SENSOR_SDA_PIN, false);
+	I2cRecoveryLineSet(I2C_SENSOR_SCL_PIN, true);
+	I2cRecoveryLineSet(I2C_SENSOR_SDA_PIN, true);
+	released = port_pin_get_input_level(I2C_SENSOR_SDA_PIN);
+
+	taskENTER_CRITICAL();
+	if(!released){
+		i2cStats.recoveryFailures++;
+	}
+
+	//Give the pins back to the SERCOM
+	system_pinmux_get_config_defaults(&muxConfig);
+	muxConfig.direction = SYSTEM_PINMUX_PIN_DIR_OUTPUT_WITH_READBACK;
+	muxConfig.mux_position = I2C_SENSOR_SDA_PINMUX & 0xFFFF;
+	system_pinmux_pin_set_config(I2C_SENSOR_SDA_PINMUX >> 16, &muxConfig);
+	muxConfig.mux_position = I2C_SENSOR_SCL_PINMUX & 0xFFFF;
+	system_pinmux_pin_set_config(I2C_SENSOR_SCL_PINMUX >> 16, &muxConfig);
+
+	i2c_master_enable(&i2cSensorBusInstance);
+	i2cSensorBusInstance.buffer_length = 0;
+	i2cSensorBusInstance.buffer_remaining = 0;
+	i2cSensorBusInstance.status = STATUS_OK;
+
+	i2cStats.recoveries++;
+	i2cRecoveryPending = false;
+	I2cEngineStartNext(&xHigherPriorityTaskWoken);
+	taskEXIT_CRITICAL();
+	xTaskResumeAll();
+
+	if(xHigherPriorityTaskWoken) taskYIELD();
+}
+
+/******************************************************************************
+* Transaction Engine
+******************************************************************************/
+
+/**************************************************************************//**
+ * @fn			static enum status_code I2cEngineStartTransfer(I2cRequest *request)
+ * @brief       Starts the ASF job for the current phase of a request
+ * @param[in]   request Request to start. Must be the active request.
+ * @return      Status returned by the ASF job function
+ * @note        Called with interrupts masked, or from the SERCOM interrupt
+ *****************************************************************************/
+static enum status_code I2cEngineStartTransfer(I2cRequest *request)
+{
+	I2C_Data *data = request->data;
+
+	if(i2cActivePhase == I2C_PHASE_READ || request->type == I2C_REQUEST_READ){
+		sensorPacketRead.address = data->address;
+		sensorPacketRead.data = data->msgIn;
+		sensorPacketRead.data_length = data->lenIn;
+		return i2c_master_read_packet_job(&i2cSensorBusInstance, &sensorPacketRead);
+	}
+
+	sensorPacketWrite.address = data->address;
+	sensorPacketWrite.data = (uint8_t*) data->msgOut;
+	sensorPacketWrite.data_length = data->lenOut;
+
+	if(request->type == I2C_REQUEST_WRITE_READ){
+		//Keep the bus so the read goes out with a repeated START
+		return i2c_master_write_packet_job_no_stop(&i2cSensorBusInstance, &sensorPacketWrite);
+	}
+	return i2c_master_write_packet_job(&i2cSensorBusInstance, &sensorPacketWrite);
+}
+
+/**************************************************************************//**
+ * @fn			static void I2cEngineStartNext(BaseType_t *pxHigherPriorityTaskWoken)
+ * @brief       Starts the highest priority queued request if the bus is idle
+ * @param[out]  pxHigherPriorityTaskWoken Set to pdTRUE if a request that failed to start woke up a higher priority task
+ * @note        Called with interrupts masked, or from the SERCOM interrupt. Does nothing while a bus recovery is pending.
+ *****************************************************************************/
+static void I2cEngineStartNext(BaseType_t *pxHigherPriorityTaskWoken)
+{
+	while(i2cActive == NULL){
+		if(i2cRecoveryPending){
+			//Requests wait in the queue until the bus is recovered
+			return;
+		}
+
+		I2cRequest *next = NULL;
+
+		for(uint8_t prio = 0; prio < I2C_PRIORITY_MAX; prio++){
+			if(i2cQueueHead[prio] != NULL){
+				next = i2cQueueHead[prio];
+				i2cQueueHead[prio] = next->next;
+				if(i2cQueueHead[prio] == NULL) i2cQueueTail[prio] = NULL;
+				next->next = NULL;
+				break;
+			}
+		}
+
+		if(next == NULL){
+			I2cSensorBusState.i2cState = I2C_BUS_READY;
+			return;
+		}
+
+		i2cActive = next;
+		i2cActivePhase = I2C_PHASE_FIRST;
+		I2cSensorBusState.i2cState = I2C_BUS_BUSY;
+		I2cSensorBusState.currentAddress = next->data->address;
+		I2cBusSetSpeed(next->data->speed);
+
+		if(STATUS_OK != I2cEngineStartTransfer(next)){
+			I2cEngineComplete(ERROR_IO, pxHigherPriorityTaskWoken);
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @fn			static void I2cEngineComplete(int32_t status, BaseType_t *pxHigherPriorityTaskWoken)
+ * @brief       Finishes the active request, notifies its owner and frees the bus for the next request
+ * @param[in]   status Result of the request
+ * @param[out]  pxHigherPriorityTaskWoken Set to pdTRUE if the notified task has a higher priority than the running one
+ * @note        Called with interrupts masked, or from the SERCOM interrupt. The caller starts the next request.
+ *****************************************************************************/
+static void I2cEngineComplete(int32_t status, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	I2cRequest *done = i2cActive;
+
+	i2cActive = NULL;
+	if(done == NULL) return;
+
+	done->status = status;
+	if(done->callback != NULL){
+		done->callback(done);
+	}
+	if(done->notifyTask != NULL){
+		xTaskNotifyFromISR(done->notifyTask, I2C_NOTIFY_BIT, eSetBits, pxHigherPriorityTaskWoken);
+	}
+}
+
+/**************************************************************************//**
+ * @fn			static bool I2cQueueRemove(I2cRequest *request)
+ * @brief       Removes a request that has not been started from its queue
+ * @param[in]   request Request to remove
+ * @return      true if the request was queued and has been removed
+ * @note        Called with interrupts masked
+ *****************************************************************************/
+static bool I2cQueueRemove(I2cRequest *request)
+{
+	I2cRequest *prev = NULL;
+	I2cRequest *it = i2cQueueHead[request->priority];
+
+	while(it != NULL && it != request){
+		prev = it;
+		it = it->next;
+	}
+	if(it == NULL) return false;
+
+	if(prev == NULL) i2cQueueHead[request->priority] = it->next;
+	else prev->next = it->next;
+	if(i2cQueueTail[request->priority] == it) i2cQueueTail[request->priority] = prev;
+	it->next = NULL;
+	return true;
+}
+
+/**************************************************************************//**
+ * @fn			static void I2cCancelRequest(I2cRequest *request)
+ * @brief       Cancels a request that timed out, whether it is queued or on the bus
+ * @details     If the request is on the bus the job is aborted and a STOP is sent, so the buffers of the request are no longer
+				used once this function returns, and a bus recovery is requested. The owner of the request is not notified.
+ * @param[in]   request Request to cancel
+ *****************************************************************************/
+static void I2cCancelRequest(I2cRequest *request)
+{
+	taskENTER_CRITICAL();
+	if(request == i2cActive){
+		i2c_master_cancel_job(&i2cSensorBusInstance);
+		i2cSensorBusInstance.hw->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MB | SERCOM_I2CM_INTENCLR_SB;
+		i2cSensorBusInstance.buffer_length = 0;
+		i2c_master_send_stop(&i2cSensorBusInstance);
+		i2cActive = NULL;
+		request->status = ERROR_TIMEOUT;
+		i2cStats.timeouts++;
+		//The transfer never finished, a slave may be holding the bus
+		i2cRecoveryPending = true;
+	}else if(I2cQueueRemove(request)){
+		request->status = ERROR_TIMEOUT;
+	}
+	taskEXIT_CRITICAL();
+}
+
 /******************************************************************************
 * Callback Functions
 ******************************************************************************/
 /**************************************************************************//**
  * @fn			void I2cSensorsTxComplete(struct i2c_m_async_desc *const i2c)
  * @brief       Callback function for when the SENSORS I2C bus ends transmissions
- * @details     This callback sets a flag that tells us that the bus is not busy, and the last transmission is done. With USE_FREERTOS flag, this
-				callback notifies the registered thread that the I2C transfer has finished. The registered thread is the thread that initiated the I2C transaction,
-				and is currently waiting for a notification that it has finished.
+ * @details     Write + read requests continue with their read transfer. Any other request is completed, its owner notified, and the
+				next queued request is started from this interrupt.
  * @param[in]   i2c Pointer to I2C structure used inside the Atmel ASFv3  framework
  * @return      This function is a callback, and it is registered as such when we send an I2C transmission on this I2C bus.
- * @note        
+ * @note
  *****************************************************************************/
 void I2cSensorsTxComplete(struct i2c_master_module *const module){
-	
-	I2cSensorBusState.i2cState = I2C_BUS_READY;
-	I2cSensorBusState.rxDoneFlag = true;			
+
 	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-	
-	xSemaphoreGiveFromISR( sensorI2cSemaphoreHandle, &xHigherPriorityTaskWoken );
-	sensorTransmitError = false;
+	I2cRequest *active = i2cActive;
+
+	I2cSensorBusState.txDoneFlag = true;
+
+	if(active != NULL && i2cActivePhase == I2C_PHASE_FIRST &&
+	  (active->type == I2C_REQUEST_WRITE_READ || active->type == I2C_REQUEST_WRITE_THEN_READ)){
+		i2cActivePhase = I2C_PHASE_READ;
+		if(STATUS_OK == I2cEngineStartTransfer(active)){
+			return;
+		}
+		if(!module->send_stop) i2c_master_send_stop(module);
+		I2cEngineComplete(ERROR_IO, &xHigherPriorityTaskWoken);
+	}else{
+		I2cEngineComplete(ERROR_NONE, &xHigherPriorityTaskWoken);
+	}
+
+	I2cEngineStartNext(&xHigherPriorityTaskWoken);
 	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
 /**************************************************************************//**
  * @fn				void I2cSensorRxComplete(struct i2c_m_async_desc *const i2c)
  * @brief			Callback function for when the SENSOR I2C bus ends data reception
- * @details			This callback sets a flag that tells us that the bus is not busy, and the last reception is done. With USE_FREERTOS flag, this
-					callback notifies the registered thread that the I2C transfer has finished. The registered thread is the thread that initiated the I2C transaction,
-					and is currently waiting for a notification that it has finished.
+ * @details			Completes the active request, notifies its owner and starts the next queued request from this interrupt.
  * @param[in]		i2c Pointer to I2C structure used inside the Atmel ASFv3  framework
  * @return			This function is a callback, and it is registered as such when we send an I2C reception on this I2C bus.
- * @note        
+ * @note
  *****************************************************************************/
 void I2cSensorsRxComplete(struct i2c_master_module *const module){
-	
-	I2cSensorBusState.i2cState = I2C_BUS_READY;
-	I2cSensorBusState.rxDoneFlag = true;
+
 	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-	
-	xSemaphoreGiveFromISR( sensorI2cSemaphoreHandle, &xHigherPriorityTaskWoken );
-	sensorTransmitError = false;
+
+	I2cSensorBusState.rxDoneFlag = true;
+	I2cEngineComplete(ERROR_NONE, &xHigherPriorityTaskWoken);
+	I2cEngineStartNext(&xHigherPriorityTaskWoken);
 	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
@@ -111,22 +453,30 @@ void I2cSensorsRxComplete(struct i2c_master_module *const module){
 
 /**************************************************************************//**
  * @fn				void I2cSensorError(struct i2c_m_async_desc *const i2c)
- * @brief			Callback function for when the LED I2C bus encounters an error while transmitting/receiving
- * @details			This callback sets a flag that tells us that the bus is not busy, and the last reception is done. With USE_FREERTOS flag, this
-					callback notifies the registered thread that the I2C transfer has finished. The registered thread is the thread that initiated the I2C transaction,
-					and is currently waiting for a notification that it has finished.
+ * @brief			Callback function for when the SENSOR I2C bus encounters an error while transmitting/receiving
+ * @details			Fails the active request with ERROR_ABORTED and starts the next queued request. If the failed transfer was
+					holding the bus for a repeated START, the bus is released first. Lost arbitration, bus errors and SCL low
+					timeouts mean the bus may be held by a slave, so a bus recovery is requested instead of starting the next request.
  * @param[in]		i2c Pointer to I2C structure used inside the Atmel ASFv3  framework
  * @return			This function is a callback, and it is registered as such when we send an I2C reception on this I2C bus.
- * @note        
+ * @note
  *****************************************************************************/
 void I2cSensorsError(struct i2c_master_module *const module){
-	
-	I2cSensorBusState.i2cState = I2C_BUS_READY;
-	I2cSensorBusState.txDoneFlag = true;
+
 	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-	
-	xSemaphoreGiveFromISR( sensorI2cSemaphoreHandle, &xHigherPriorityTaskWoken );
-	sensorTransmitError = false;
+
+	if(module->status == STATUS_ERR_BAD_ADDRESS || module->status == STATUS_ERR_OVERFLOW){
+		i2cStats.nacks++;
+	}else{
+		i2cStats.busErrors++;
+		i2cRecoveryPending = true;
+	}
+
+	if(!module->send_stop && module->status != STATUS_ERR_PACKET_COLLISION){
+		i2c_master_send_stop(module);
+	}
+	I2cEngineComplete(ERROR_ABORTED, &xHigherPriorityTaskWoken);
+	I2cEngineStartNext(&xHigherPriorityTaskWoken);
 	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
@@ -137,10 +487,10 @@ void I2cDriverRegisterSensorBusCallbacks(void)
 	/* Register callback function. */
 	i2c_master_register_callback(&i2cSensorBusInstance, I2cSensorsTxComplete,I2C_MASTER_CALLBACK_WRITE_COMPLETE);
 	i2c_master_enable_callback(&i2cSensorBusInstance,I2C_MASTER_CALLBACK_WRITE_COMPLETE);
-	
+
 	i2c_master_register_callback(&i2cSensorBusInstance, I2cSensorsRxComplete, I2C_MASTER_CALLBACK_READ_COMPLETE);
 	i2c_master_enable_callback(&i2cSensorBusInstance,I2C_MASTER_CALLBACK_READ_COMPLETE);
-	
+
 	i2c_master_register_callback(&i2cSensorBusInstance, I2cSensorsError,I2C_MASTER_CALLBACK_ERROR);
 	i2c_master_enable_callback(&i2cSensorBusInstance,I2C_MASTER_CALLBACK_ERROR);
 }
@@ -150,125 +500,156 @@ void I2cDriverRegisterSensorBusCallbacks(void)
  * @fn			int32_t I2cInitializeDriver(void)
  * @brief       Function call to initialize the I2C driver\
  * @details     This function must be called from an RTOS thread if using RTOS, and must be called before any I2C call
- * @note        
+ * @note
  *****************************************************************************/
  int32_t I2cInitializeDriver(void){
-	
+
 	int32_t error = STATUS_OK;
 
 
 	error = I2cDriverConfigureSensorBus();
 	if(STATUS_OK != error) goto exit;
-	
+
 	I2cDriverRegisterSensorBusCallbacks();
-	
-		
-	sensorI2cMutexHandle = xSemaphoreCreateMutex();
-	
-	sensorI2cSemaphoreHandle = xSemaphoreCreateBinary();
-	//xSemaphoreGive(sensorI2cSemaphoreHandle);
-
-	
-	if(NULL == sensorI2cMutexHandle || NULL == sensorI2cSemaphoreHandle){
+
+
+	sensorI2cMutexHandle = xSemaphoreCreateMutexStatic(&sensorI2cMutexBuffer);
+
+
+	if(NULL == sensorI2cMutexHandle){
 		error = STATUS_SUSPEND;	//Could not initialize mutex!
 		goto exit;
 	}
 
 	exit:
-	return error;		
+	return error;
 }
 
 
 
-
-
-
-
 /**************************************************************************//**
- * @fn    int32_t I2cWriteData(I2C_Data *data)
- * @brief       Function call to write an specified number of bytes on the given I2C bus
- * @details     
- * @param[in]   data Pointer to I2C data structure which has all the information needed to send an I2C message
- * @return      Returns an error message in case of error. See ErrCodes.h
- * @note        
+ * @fn			int32_t I2cSubmitRequest(I2cRequest *request)
+ * @brief       Queues an I2C request. The request is started right away if the bus is idle.
+ * @details     When the request finishes its status is set, its callback (if any) is called from the SERCOM interrupt and its task (if any)
+				is notified with I2C_NOTIFY_BIT. Requests of a higher priority class are started before any waiting request of a lower one;
+				requests of the same class are served in order.
+ * @param[in]   request Request to queue. The request and its I2C_Data must stay valid until the request is done.
+ * @return      ERROR_NONE if the request was queued, ERROR_INVALID_ARG if the request is malformed
+ * @note        Must be called from a task
  *****************************************************************************/
+int32_t I2cSubmitRequest(I2cRequest *request)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	I2C_Data *data;
 
-int32_t I2cWriteData(I2C_Data *data){
-	
-	int32_t error = ERROR_NONE;
-	enum status_code hwError;
-	struct i2c_master_module *I2CBusHw = NULL;
-	I2C_Bus_State * busI2cState;
-	struct i2c_master_packet *writePacket = NULL;
-	struct i2c_master_packet *readPacket = NULL;
-	
 	//Check parameters
-	if(data == NULL || data->msgOut == NULL){
-		error = ERR_INVALID_ARG;
-		goto exit;
+	if(request == NULL || request->data == NULL || request->priority >= I2C_PRIORITY_MAX || request->type >= I2C_REQUEST_MAX_TYPES){
+		return ERROR_INVALID_ARG;
+	}
+	data = request->data;
+	if(request->type != I2C_REQUEST_READ && (data->msgOut == NULL || data->lenOut == 0)){
+		return ERROR_INVALID_ARG;
+	}
+	if(request->type != I2C_REQUEST_WRITE && (data->msgIn == NULL || data->lenIn == 0)){
+		return ERROR_INVALID_ARG;
 	}
 
-	//Prepare to write
-	sensorPacketWrite.address = data->address;
-	sensorPacketWrite.data = (uint8_t*) data->msgOut;
-	sensorPacketWrite.data_length = data->lenOut;
-	
-	//Write
+	if(request->data->speed >= I2C_SPEED_MAX){
+		return ERROR_INVALID_ARG;
+	}
 
-	 hwError = i2c_master_write_packet_job(&i2cSensorBusInstance, &sensorPacketWrite);
-	
-	if(STATUS_OK != hwError)
-	{
-		error = ERROR_IO;
-		goto exit;
+	request->status = ERROR_BUSY;
+	request->next = NULL;
+
+	if(i2cRecoveryPending){
+		I2cBusRecover();
 	}
-	
-	exit:
-	return error;
+
+	taskENTER_CRITICAL();
+	i2cStats.requests++;
+	if(i2cQueueTail[request->priority] == NULL){
+		i2cQueueHead[request->priority] = request;
+	}else{
+		i2cQueueTail[request->priority]->next = request;
+	}
+	i2cQueueTail[request->priority] = request;
+
+	if(i2cActive == NULL){
+		I2cEngineStartNext(&xHigherPriorityTaskWoken);
+	}
+	taskEXIT_CRITICAL();
+
+	if(xHigherPriorityTaskWoken) taskYIELD();
+	return ERROR_NONE;
 }
 
 
 /**************************************************************************//**
- * @fn    int32_t I2cReadData(I2C_Data *data)
- * @brief       Function call to read an specified number of bytes on the given I2C bus
- * @details     
+ * @fn			static int32_t I2cTransferWait(I2C_Data *data, eI2cRequestType type, const TickType_t xMaxBlockTime)
+ * @brief       Queues a request for the calling task and sleeps until it is done
+ * @details     The task is woken up once, by the interrupt that completes the request. Notification bits other than
+				I2C_NOTIFY_BIT that arrive while waiting are given back to the task before returning.
  * @param[in]   data Pointer to I2C data structure which has all the information needed to send an I2C message
- * @return      Returns an error message in case of error. See ErrCodes.h
- * @note        
+ * @param[in]   type Type of transfer
+ * @param[in]   xMaxBlockTime Maximum time to wait for the request to be done, including the time it waits in the queue.
+ * @return      Returns an error message in case of error.
  *****************************************************************************/
-int32_t I2cReadData(I2C_Data *data){
-	
-	int32_t error = ERROR_NONE;
-	enum status_code hwError;
-	struct i2c_master_module *I2CBusHw = NULL;
-	I2C_Bus_State * busI2cState;
-	struct i2c_master_packet *writePacket = NULL;
-	struct i2c_master_packet *readPacket = NULL;
-	
-	
-	//Check parameters
-	if(data == NULL || data->msgOut == NULL){
-		error = ERR_INVALID_ARG;
-		goto exit;
+static int32_t I2cTransferWait(I2C_Data *data, eI2cRequestType type, const TickType_t xMaxBlockTime)
+{
+	I2cRequest request;
+	int32_t error;
+	uint32_t notifiedValue = 0;
+	uint32_t otherBits = 0;
+	const TickType_t start = xTaskGetTickCount();
+
+	if(data == NULL){
+		return ERROR_INVALID_ARG;
 	}
 
-	//Prepare to read
-	sensorPacketWrite.address = data->address;
-	sensorPacketWrite.data = data->msgIn;
-	sensorPacketWrite.data_length = data->lenIn;
-	
-	//Read
-
-	hwError = i2c_master_read_packet_job(&i2cSensorBusInstance, &sensorPacketWrite);
-	
-	if(STATUS_OK != hwError)
-	{
-		error = ERROR_IO;
-		goto exit;
+	request.data = data;
+	request.type = type;
+	request.priority = (eI2cPriority) data->priority;
+	request.callback = NULL;
+	request.context = NULL;
+	request.notifyTask = xTaskGetCurrentTaskHandle();
+
+	error = I2cSubmitRequest(&request);
+	if(ERROR_NONE != error) return error;
+
+	while(request.status == ERROR_BUSY){
+		TickType_t elapsed = xTaskGetTickCount() - start;
+		if(elapsed >= xMaxBlockTime){
+			I2cCancelRequest(&request);
+			break;
+		}
+		if(xTaskNotifyWait(0, I2C_NOTIFY_BIT, &notifiedValue, xMaxBlockTime - elapsed) == pdTRUE){
+			otherBits |= (notifiedValue & ~I2C_NOTIFY_BIT);
+		}
 	}
-	
-	exit:
-	return error;
+
+	if(otherBits != 0){
+		xTaskNotify(request.notifyTask, otherBits, eSetBits);
+	}
+	if(request.status != ERROR_NONE && i2cRecoveryPending){
+		I2cBusRecover();
+	}
+	return request.status;
+}
+
+
+
+/**************************************************************************//**
+ * @fn			void I2cGetBusStats(I2cBusStats *stats)
+ * @brief       Returns a snapshot of the error counters of the sensor bus
+ * @param[out]  stats Counters
+ *****************************************************************************/
+void I2cGetBusStats(I2cBusStats *stats)
+{
+	if(stats == NULL) return;
+
+	taskENTER_CRITICAL();
+	*stats = i2cStats;
+	taskEXIT_CRITICAL();
 }
 
 
@@ -276,15 +657,15 @@ int32_t I2cReadData(I2C_Data *data){
 /**************************************************************************//**
  * @fn			int32_t I2cFreeMutex(eI2cBuses bus)
  * @brief       Frees the mutex of the given I2C bus
- * @details     
+ * @details
  * @param[in]   bus Enum that represents the bus in which we are interested to free the mutex of.
  * @return      Returns (0) if the bus is ready, (1) if it is busy.
- * @note        
+ * @note
  *****************************************************************************/
 int32_t I2cFreeMutex(void){
-	
+
 	int32_t error = ERROR_NONE;
-	
+
 	if( xSemaphoreGive( sensorI2cMutexHandle ) != pdTRUE ){
 		error = ERROR_NOT_INITIALIZED;	//We could not return the mutex! We must not have it!
 	}
@@ -294,14 +675,16 @@ int32_t I2cFreeMutex(void){
 
 /**************************************************************************//**
  * @fn			int32_t I2cGetMutex(TickType_t waitTime)
- * @brief       Frees the mutex of the given I2C bus
- * @details     
+ * @brief       Takes the mutex of the sensor I2C bus
+ * @details     The driver does not need the mutex to serialise requests. A task only takes it to make sure a group of
+				requests to a device is not interleaved with the requests of another task to the same device. The Seesaw driver
+				holds it for each of its operations, since the CLI and the UI task both use the Seesaw.
  * @param[in]   waitTime Time to wait for the mutex to be freed.
  * @return      Returns (0) if the bus is ready, (1) if it is busy.
- * @note        
+ * @note
  *****************************************************************************/
 int32_t I2cGetMutex(TickType_t waitTime){
-	
+
 	int32_t error = ERROR_NONE;
 	if(xSemaphoreTake( sensorI2cMutexHandle, waitTime ) != pdTRUE)
 	{
@@ -310,102 +693,21 @@ int32_t I2cGetMutex(TickType_t waitTime){
 	return error;
 }
 
-static int32_t I2cGetSemaphoreHandle(SemaphoreHandle_t *handle){
-	int32_t error = ERROR_NONE;
-	*handle = sensorI2cSemaphoreHandle;
-	return error;
-}
-
-
-/**************************************************************************//**
- * @fn			static uint8_t I2cGetTaskErrorStatus(I2C_Data *data)
- * @brief       Sets the error state of the latest I2C bus transaction for a given I2C data, which holds which physical I2C bus we are using.
- * @details     This error flag is set to indicate when a I2C transaction has failed on a given I2C bus (encapsulated in the I2C data structure).
- * @return      Returns an error message in case of error. See ErrCodes.h
- * @note        
- *****************************************************************************/
- static uint8_t I2cGetTaskErrorStatus(void){
-	 return sensorTransmitError;
- }
-
-/**************************************************************************//**
- * @fn			static uint8_t I2cSetTaskErrorStatus(I2C_Data *data, uint8_t value)
- * @brief       Sets the error state of the latest I2C bus transaction for a given I2C data, which holds which physical I2C bus we are using.
- * @details     This error flag is set to indicate when a I2C transaction has failed on a given I2C bus (encapsulated in the I2C data structure).
- * @param[in]   value Value to which to set the error flag to.
- * @return      Returns an error message in case of error. See ErrCodes.h
- * @note        
- *****************************************************************************/
- static void I2cSetTaskErrorStatus(uint8_t value){
-	sensorTransmitError = value;
- }
-
 
 
 /**************************************************************************//**
  * @fn			int32_t I2cWriteDataWait(I2C_Data *data, const TickType_t delay, const TickType_t xMaxBlockTime)
  * @brief       This is the main function to use to write data from an I2C device on a given I2C Bus. This function is blocking.
- * @details     This function writes data from an I2C device, by writing the requested bytes.This function is blocking (bare-metal) or it
-				makes the current thread sleep until the I2C bus has finished the transaction (FREERTOS version).
-				On FreeRtos, this function gets the mutex for the respective I2C bus.
+ * @details     This function writes data from an I2C device, by writing the requested bytes. It makes the current thread sleep until the
+				I2C bus has finished the transaction. The request is queued with the priority of the device (data->priority).
  * @param[in]   data Pointer to I2C data structure which has all the information needed to send an I2C message
- * @param[in]   delay Delay that the I2C device needs to return the response. Can be 0 if the response is ready instantly. It can be 
-				the delay an I2C device needs to make a measurement.
- * @param[in]   xMaxBlockTime Maximum time for the thread to wait until the I2C mutex is free.
+ * @param[in]   xMaxBlockTime Maximum time for the thread to wait until the I2C transaction is done.
  * @return      Returns an error message in case of error.
- * @note        
+ * @note
  *****************************************************************************/
 int32_t I2cWriteDataWait(I2C_Data *data, const TickType_t xMaxBlockTime){
 
-int32_t error = ERROR_NONE;
-SemaphoreHandle_t semHandle = NULL;
-
-
-//---0. Get Mutex
-error = I2cGetMutex(WAIT_I2C_LINE_MS);
-if(ERROR_NONE != error) goto exit;
-
-
-//---1. Get Semaphore Handle
-error = I2cGetSemaphoreHandle(&semHandle);
-if(ERROR_NONE != error) goto exit;
-
-//---2. Initiate sending data
-
-error = I2cWriteData(data);
-if (ERROR_NONE != error){
-	goto exitError0;
-}
-
-//---2. Wait for binary semaphore to tell us that we are done!
-if( xSemaphoreTake( semHandle, xMaxBlockTime ) == pdTRUE ){
-	/* The transmission ended as expected. We now delay until the I2C sensor is finished */
-	if(I2cGetTaskErrorStatus()){
-		I2cSetTaskErrorStatus(false);
-		if(error != ERROR_NONE){
-    		error = ERROR_I2C_HANG_RESET;
-    	}else{
-    		error = ERROR_ABORTED;
-		}
-		goto exitError0;
-	}
-}else{
-	/* The call to ulTaskNotifyTake() timed out. */
-	error = ERR_TIMEOUT;
-	goto exitError0;
-}
-
-//---8. Release Mutex
-error |= I2cFreeMutex();
-//xSemaphoreGive(semHandle);
-exit:
-return error;
-
-exitError0:
-error = I2cFreeMutex();
-//xSemaphoreGive(semHandle);
-return error;
-
+	return I2cTransferWait(data, I2C_REQUEST_WRITE, xMaxBlockTime);
 }
 
 
@@ -413,81 +715,45 @@ return error;
 /**************************************************************************//**
  * @fn			int32_t I2cReadDataWait(I2C_Data *data, const TickType_t delay, const TickType_t xMaxBlockTime)
  * @brief       This is the main function to use to read data from an I2C device on a given I2C Bus. This function is blocking.
- * @details     This function reads data from an I2C device, by first writing to the address (I2C device address + register) and then reading the requested bytes. This
-				function is blocking (bare-metal) or it makes the current thread sleep until the I2C bus has finished the transaction (FREERTOS version).
-				On FreeRtos, this function gets the mutex for the respective I2C bus.
+ * @details     This function reads data from an I2C device, by first writing to the address (I2C device address + register) and then reading the requested bytes.
+				The write and the read are separate transfers (STOP in between). Without a delay both are chained by the interrupt as a single request,
+				so the read starts a few us after the STOP: only use it with devices that answer at once. With a delay the thread sleeps between
+				them so the device can prepare its answer or make its measurement (e.g., the Seesaw), and requests of other tasks can
+				run in between: take I2cGetMutex if another task also talks to the device.
  * @param[in]   data Pointer to I2C data structure which has all the information needed to send an I2C message
- * @param[in]   delay Delay that the I2C device needs to return the response. Can be 0 if the response is ready instantly. It can be the delay an I2C device needs to make a measurement.
- * @param[in]   xMaxBlockTime Maximum time for the thread to wait until the I2C mutex is free.
+ * @param[in]   delay Delay that the I2C device needs to return the response, in ticks. 0 only if the response is ready as soon as the write ends. vTaskDelay(delay) may end at the next tick, so pass one tick more than the time needed.
+ * @param[in]   xMaxBlockTime Maximum time for the thread to wait until each I2C transaction is done.
  * @return      Returns an error message in case of error. See ErrCodes.h
- * @note        THIS IS THE FREERTOS VERSION! DO NOT Declare #define USE_FREERTOS if you wish to use the baremetal version!      
+ * @note
  *****************************************************************************/
 int32_t I2cReadDataWait(I2C_Data *data, const TickType_t delay, const TickType_t xMaxBlockTime){
 	int32_t error = ERROR_NONE;
-	SemaphoreHandle_t semHandle = NULL;
-	
 
-	//---0. Get Mutex
-	error = I2cGetMutex( WAIT_I2C_LINE_MS);
-	if(ERROR_NONE != error) goto exit;
+	if(delay == 0){
+		return I2cTransferWait(data, I2C_REQUEST_WRITE_THEN_READ, xMaxBlockTime);
+	}
 
+	error = I2cTransferWait(data, I2C_REQUEST_WRITE, xMaxBlockTime);
+	if(ERROR_NONE != error) return error;
 
-	//---1. Get Semaphore Handle
-	error = I2cGetSemaphoreHandle( &semHandle);
-	if(ERROR_NONE != error) goto exit;
+	vTaskDelay( delay );
 
-	//---2. Initiate sending data
+	return I2cTransferWait(data, I2C_REQUEST_READ, xMaxBlockTime);
+}
 
-	error = I2cWriteData(data);
-	if (ERROR_NONE != error){
-		goto exitError0;
-	}
 
-	//---2. Wait for binary semaphore to tell us that we are done!
-	if( xSemaphoreTake( semHandle, xMaxBlockTime ) == pdTRUE ){
-		/* The transmission ended as expected. We now delay until the I2C sensor is finished */
-		if(I2cGetTaskErrorStatus()){
-			I2cSetTaskErrorStatus(false);
-			error = ERROR_ABORTED;
-			goto exitError0;
-		}
-		vTaskDelay( delay );
-	}else{
-		/* The call to ulTaskNotifyTake() timed out. */
-		error = ERR_TIMEOUT;
-		goto exitError0;
-	}
-	
-	//---6. Initiate Read data
-	error = I2cReadData(data);
-	if (ERROR_NONE != error){
-		goto exitError0;
-	}
-	//---7. Wait for notification
-	if( xSemaphoreTake( semHandle, xMaxBlockTime ) == pdTRUE ){
-		/* The transmission ended as expected. We now delay until the I2C sensor is finished */
-		if(I2cGetTaskErrorStatus()){
-			I2cSetTaskErrorStatus(false);
-			error = ERROR_ABORTED;
-			goto exitError0;
-		}
-		}else{
-		/* The call to ulTaskNotifyTake() timed out. */
-		error = ERR_TIMEOUT;
-		goto exitError0;
-	}
-	
-	//---8. Release Mutex
-	error = I2cFreeMutex();
-	//xSemaphoreGive(semHandle);
-	exit:
-	return error;
 
-	exitError0:
-	error = I2cFreeMutex();
-	//xSemaphoreGive(semHandle);
-	return error;
+/**************************************************************************//**
+ * @fn			int32_t I2cReadRegisterWait(I2C_Data *data, const TickType_t xMaxBlockTime)
+ * @brief       Reads registers of an I2C device with a single repeated-start transaction. This function is blocking.
+ * @details     Use this instead of I2cReadDataWait for register based devices that answer immediately (e.g., LSM6DS3). msgOut holds the register
+				address and msgIn receives the register contents. The calling thread sleeps until the read completes and is only woken up once.
+ * @param[in]   data Pointer to I2C data structure which has all the information needed to send an I2C message
+ * @param[in]   xMaxBlockTime Maximum time for the thread to wait until the transaction is done.
+ * @return      Returns an error message in case of error. See ErrCodes.h
+ * @note
+ *****************************************************************************/
+int32_t I2cReadRegisterWait(I2C_Data *data, const TickType_t xMaxBlockTime){
 
-	
+	return I2cTransferWait(data, I2C_REQUEST_WRITE_READ, xMaxBlockTime);
 }
-
@@ -27,6 +27,14 @@ extern "C" {
 
 #define I2C_INIT_ATTEMPTS 3
 #define WAIT_I2C_LINE_MS 300
+#define I2C_NOTIFY_BIT	(1UL << 31)	///<Task notification bit used to wake up a task whose I2C request is done. Do not use it for other notifications.
+
+#define I2C_SENSOR_SDA_PIN				PIN_PA08					///<SDA of the sensor bus
+#define I2C_SENSOR_SCL_PIN				PIN_PA09					///<SCL of the sensor bus
+#define I2C_SENSOR_SDA_PINMUX			PINMUX_PA08C_SERCOM0_PAD0	///<SERCOM function of the SDA pin
+#define I2C_SENSOR_SCL_PINMUX			PINMUX_PA09C_SERCOM0_PAD1	///<SERCOM function of the SCL pin
+#define I2C_RECOVERY_CLOCKS				9	///<Maximum SCL clocks sent to make a slave release SDA
+#define I2C_RECOVERY_HALF_PERIOD_US		5	///<Half period of the recovery clock (100 kHz)
 
 
 #define ERROR_NONE                                 0
@@ -75,6 +83,33 @@ typedef enum eI2cBusState
 	I2C_BUS_MAX_STATES,	///<Maximum number of allowable states of a bus
 }eI2cBusState;
 
+///Priority classes of I2C requests. Lower values are started first.
+typedef enum eI2cPriority
+{
+	I2C_PRIORITY_SENSOR = 0,	///<Sensor sampling (IMU)
+	I2C_PRIORITY_UI,			///<LED and keypad updates (Seesaw)
+	I2C_PRIORITY_MAX,			///<Number of priority classes
+}eI2cPriority;
+
+///SCL frequencies a device can be accessed at. The bus is reprogrammed between requests to different devices.
+typedef enum eI2cSpeed
+{
+	I2C_SPEED_STANDARD = 0,		///<100 kHz
+	I2C_SPEED_FAST,				///<400 kHz
+	I2C_SPEED_FAST_PLUS,		///<1 MHz. Falls back to 400 kHz if the SERCOM clock is too slow.
+	I2C_SPEED_MAX,				///<Number of bus speeds
+}eI2cSpeed;
+
+///Types of I2C requests
+typedef enum eI2cRequestType
+{
+	I2C_REQUEST_WRITE = 0,			///<Write msgOut
+	I2C_REQUEST_READ,				///<Read into msgIn
+	I2C_REQUEST_WRITE_READ,			///<Write msgOut, repeated START, read into msgIn. For register reads.
+	I2C_REQUEST_WRITE_THEN_READ,	///<Write msgOut, STOP, read into msgIn. For devices that answer as soon as the STOP is sent.
+	I2C_REQUEST_MAX_TYPES,			///<Number of request types
+}eI2cRequestType;
+
 ///Structure that describes an I2C data, determining address to use, data buffer to send, etc.
 typedef struct I2C_Data
 {
@@ -83,9 +118,39 @@ typedef struct I2C_Data
 	uint8_t	*msgIn;		///<Pointer to array buffer that we will get message to
 	uint16_t lenIn;			///<Length of message to read/write;
 	uint16_t lenOut;			///<Length of message to read/write;
+	uint8_t priority;		///<eI2cPriority of the requests to this device. Defaults to I2C_PRIORITY_SENSOR.
+	uint8_t speed;			///<eI2cSpeed of the device. Defaults to I2C_SPEED_STANDARD.
 	
 }I2C_Data;
 
+///Error counters of the sensor bus
+typedef struct I2cBusStats
+{
+	uint32_t requests;			///<Requests submitted
+	uint32_t nacks;				///<Requests NACKed by the device
+	uint32_t busErrors;			///<Lost arbitration, bus errors and SCL low timeouts
+	uint32_t timeouts;			///<Requests that did not finish in time
+	uint32_t recoveries;		///<Bus recoveries performed
+	uint32_t recoveryFailures;	///<Bus recoveries after which SDA was still held low
+	uint32_t speedChanges;		///<Times the bus speed was reprogrammed
+}I2cBusStats;
+
+struct I2cRequest;
+typedef void (*I2cRequestCallback)(struct I2cRequest *request);	///<Completion callback. Called from the SERCOM interrupt.
+
+///Structure that describes a queued I2C request. It is owned by the caller and must stay valid until the request is done.
+typedef struct I2cRequest
+{
+	I2C_Data *data;					///<Device address and buffers
+	eI2cRequestType type;			///<Type of transfer
+	eI2cPriority priority;			///<Priority class of the request
+	I2cRequestCallback callback;	///<Called from the interrupt when the request is done. Can be NULL.
+	void *context;					///<Free for the owner of the request, e.g., for the callback
+	TaskHandle_t notifyTask;		///<Task notified with I2C_NOTIFY_BIT when the request is done. Can be NULL.
+	volatile int32_t status;		///<ERROR_BUSY while queued or on the bus, then the result of the request
+	struct I2cRequest *next;		///<Next request in the queue. Used by the driver.
+}I2cRequest;
+
 
 ///Structure that describes an I2C bus data, determining the bus and the flags
 typedef struct I2C_Bus_State
@@ -101,10 +166,11 @@ typedef struct I2C_Bus_State
 
 int32_t I2cReadDataWait(I2C_Data *data, const TickType_t delay, const TickType_t xMaxBlockTime);
 int32_t I2cWriteDataWait(I2C_Data *data, const TickType_t xMaxBlockTime);
+int32_t I2cReadRegisterWait(I2C_Data *data, const TickType_t xMaxBlockTime);
 int32_t I2cGetMutex(TickType_t waitTime);
 int32_t I2cFreeMutex(void);
-int32_t I2cReadData(I2C_Data *data);
-int32_t I2cWriteData(I2C_Data *data);
+int32_t I2cSubmitRequest(I2cRequest *request);
+void I2cGetBusStats(I2cBusStats *stats);
 int32_t I2cInitializeDriver(void);
 void I2cDriverRegisterSensorBusCallbacks(void);
 void I2cSensorsError(struct i2c_master_module *const module);
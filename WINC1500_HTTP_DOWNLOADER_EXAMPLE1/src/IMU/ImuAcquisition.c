@@ -0,0 +1,317 @@
+/**************************************************************************//**
+* @file      ImuAcquisition.c
+* @brief     High-rate LSM6DS3 acquisition using the hardware FIFO.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "IMU/ImuAcquisition.h"
+#include "I2cDriver/I2cDriver.h"
+#include "SerialConsole/SerialConsole.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define IMU_ACQ_FIFO_BUFFER_SIZE	(IMU_ACQ_BYTES_PER_SAMPLE * (IMU_ACQ_BLOCK_SAMPLES + 1))	///<One block plus the words skipped to realign on a sample
+#define IMU_ACQ_FIFO_STATUS_SIZE	4	///<FIFO_STATUS1 to FIFO_STATUS4
+
+#if IMU_ACQ_FIFO_BUFFER_SIZE > 255
+#error "IMU_ACQ_BLOCK_SAMPLES is too large for a single FIFO read"
+#endif
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static TaskHandle_t imuAcqTask = NULL;									///<Task woken up by INT1
+static volatile uint32_t imuAcqIntTick = 0;								///<Tick at which INT1 last fired
+static ImuBlockConsumer imuAcqConsumers[IMU_ACQ_MAX_CONSUMERS];			///<Registered block consumers
+static uint8_t imuAcqConsumerCount = 0;									///<Number of registered consumers
+static ImuBlock imuAcqBlock;											///<Block being published
+static uint8_t imuAcqFifoBuffer[IMU_ACQ_FIFO_BUFFER_SIZE];				///<Raw FIFO words of one burst read
+static uint32_t imuAcqSequence = 0;										///<Samples acquired since start
+static ImuSample imuAcqLatest;											///<Newest sample acquired
+static uint32_t imuAcqLatestTick = 0;									///<Tick of the newest sample
+static bool imuAcqHasLatest = false;									///<True once a sample has been acquired
+static ImuAcqStats imuAcqStats;											///<Acquisition statistics
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static int32_t ImuAcquisitionConfigureFifo(void);
+static void ImuAcquisitionConfigureInterrupt(void);
+static void ImuAcquisitionIntCallback(void);
+static void ImuAcquisitionDrain(uint32_t tick);
+static void ImuAcquisitionPublish(const ImuBlock *block);
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static int32_t ImuAcquisitionConfigureFifo(void)
+* @brief	Sets the IMU full scales and output data rates, and starts the FIFO in stream mode with a watermark on INT1
+* @details	The FIFO is passed through bypass mode first, which empties it so the first word read is gyroscope X.
+* @return	0 if every register was written, non-zero otherwise
+*****************************************************************************/
+static int32_t ImuAcquisitionConfigureFifo(void)
+{
+	stmdev_ctx_t *ctx = GetImuStruct();
+	lsm6ds3_int1_route_t int1Route;
+	int32_t error;
+
+	error = lsm6ds3_fifo_mode_set(ctx, LSM6DS3_BYPASS_MODE);
+	error |= lsm6ds3_xl_full_scale_set(ctx, IMU_ACQ_XL_FS);
+	error |= lsm6ds3_gy_full_scale_set(ctx, IMU_ACQ_GY_FS);
+	error |= lsm6ds3_xl_data_rate_set(ctx, LSM6DS3_XL_ODR_416Hz);
+	error |= lsm6ds3_gy_data_rate_set(ctx, LSM6DS3_GY_ODR_416Hz);
+	error |= lsm6ds3_fifo_watermark_set(ctx, IMU_ACQ_BLOCK_SAMPLES * IMU_ACQ_WORDS_PER_SAMPLE);
+	error |= lsm6ds3_fifo_xl_batch_set(ctx, LSM6DS3_FIFO_XL_NO_DEC);
+	error |= lsm6ds3_fifo_gy_batch_set(ctx, LSM6DS3_FIFO_GY_NO_DEC);
+	error |= lsm6ds3_fifo_data_rate_set(ctx, IMU_ACQ_ODR);
+
+	error |= lsm6ds3_pin_int1_route_get(ctx, &int1Route);
+	int1Route.int1_fth = PROPERTY_ENABLE;
+	error |= lsm6ds3_pin_int1_route_set(ctx, &int1Route);
+
+	error |= lsm6ds3_fifo_mode_set(ctx, LSM6DS3_STREAM_MODE);
+	return error;
+}
+
+/**************************************************************************//**
+* @fn		static void ImuAcquisitionConfigureInterrupt(void)
+* @brief	Routes the LSM6DS3 INT1 line to an EXTINT channel
+* @details	INT1 is push-pull, active high, and stays high while the FIFO holds at least the watermark. It is
+*			detected on its level, not on an edge: if the FIFO refills past the watermark before a drain brings it
+*			below, there is no new edge. The callback masks the channel and the task unmasks it once the FIFO is
+*			drained, so a line still high fires again at once.
+*****************************************************************************/
+static void ImuAcquisitionConfigureInterrupt(void)
+{
+	struct extint_chan_conf configExtintChan;
+	extint_chan_get_config_defaults(&configExtintChan);
+	configExtintChan.gpio_pin           = IMU_ACQ_INT_PIN;
+	configExtintChan.gpio_pin_mux       = IMU_ACQ_INT_MUX;
+	configExtintChan.gpio_pin_pull      = EXTINT_PULL_DOWN;
+	configExtintChan.detection_criteria = EXTINT_DETECT_HIGH;
+	extint_chan_set_config(IMU_ACQ_INT_EIC_LINE, &configExtintChan);
+
+	extint_register_callback(ImuAcquisitionIntCallback, IMU_ACQ_INT_EIC_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+	extint_chan_enable_callback(IMU_ACQ_INT_EIC_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+}
+
+/**************************************************************************//**
+* @fn		static void ImuAcquisitionIntCallback(void)
+* @brief	EXTINT callback of INT1. Stamps the watermark, masks INT1 and wakes up the acquisition task.
+*****************************************************************************/
+static void ImuAcquisitionIntCallback(void)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	extint_chan_disable_callback(IMU_ACQ_INT_EIC_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+	imuAcqIntTick = xTaskGetTickCountFromISR();
+	if(imuAcqTask != NULL)
+	{
+		xTaskNotifyFromISR(imuAcqTask, IMU_ACQ_NOTIFY_BIT, eSetBits, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void ImuAcquisitionDrain(uint32_t tick)
+* @brief	Reads every complete block waiting in the FIFO and publishes it
+* @details	Each block costs two transactions: the four FIFO status registers, then the FIFO words in one burst
+*			(the LSM6DS3 rolls the address back to FIFO_DATA_OUT_L, so a long read keeps popping words).
+*			If the read pointer is not on gyroscope X, the burst also pops the words up to the next sample.
+*			A partial block is only read when the drain was started by the poll timeout.
+* @param[in]	tick Tick at which the FIFO was known to hold the newest sample
+*****************************************************************************/
+static void ImuAcquisitionDrain(uint32_t tick)
+{
+	stmdev_ctx_t *ctx = GetImuStruct();
+	uint8_t status[IMU_ACQ_FIFO_STATUS_SIZE];
+	bool first = true;
+
+	while(1)
+	{
+		lsm6ds3_fifo_status2_t *status2 = (lsm6ds3_fifo_status2_t *)&status[1];
+		uint16_t level, pattern, skip, samples, remaining;
+
+		if(lsm6ds3_read_reg(ctx, LSM6DS3_FIFO_STATUS1, status, sizeof(status)) != 0)
+		{
+			imuAcqStats.busErrors++;
+			return;
+		}
+		if(!first) tick = xTaskGetTickCount();
+
+		level = ((uint16_t)status2->diff_fifo << 8) | status[0];
+		pattern = ((uint16_t)(status[3] & 0x03) << 8) | status[2];
+		skip = (pattern == 0) ? 0 : (IMU_ACQ_WORDS_PER_SAMPLE - pattern);
+		if(level < skip + IMU_ACQ_WORDS_PER_SAMPLE) return;
+
+		samples = (level - skip) / IMU_ACQ_WORDS_PER_SAMPLE;
+		if(samples > IMU_ACQ_BLOCK_SAMPLES) samples = IMU_ACQ_BLOCK_SAMPLES;
+		if(!first && samples < IMU_ACQ_BLOCK_SAMPLES) return;
+		remaining = (level - skip) / IMU_ACQ_WORDS_PER_SAMPLE - samples;
+
+		imuAcqBlock.flags = 0;
+		if(status2->fifo_over_run)
+		{
+			imuAcqBlock.flags |= IMU_BLOCK_FLAG_OVERRUN;
+			imuAcqStats.overruns++;
+		}
+		if(skip != 0) imuAcqStats.realigns++;
+
+		if(lsm6ds3_fifo_raw_data_get(ctx, imuAcqFifoBuffer, (skip * 2) + (samples * IMU_ACQ_BYTES_PER_SAMPLE)) != 0)
+		{
+			imuAcqStats.busErrors++;
+			return;
+		}
+
+		uint8_t *word = &imuAcqFifoBuffer[skip * 2];
+		for(uint16_t i = 0; i < samples; i++)
+		{
+			for(uint8_t axis = 0; axis < 3; axis++, word += 2)
+			{
+				imuAcqBlock.sample[i].gyro[axis] = (int16_t)(word[0] | ((uint16_t)word[1] << 8));
+			}
+			for(uint8_t axis = 0; axis < 3; axis++, word += 2)
+			{
+				imuAcqBlock.sample[i].accel[axis] = (int16_t)(word[0] | ((uint16_t)word[1] << 8));
+			}
+		}
+
+		imuAcqBlock.count = samples;
+		imuAcqBlock.periodUs = IMU_ACQ_SAMPLE_PERIOD_US;
+		imuAcqBlock.tick = tick - ((uint32_t)remaining * IMU_ACQ_SAMPLE_PERIOD_US) / 1000;
+		imuAcqBlock.sequence = imuAcqSequence;
+		imuAcqSequence += samples;
+		ImuAcquisitionPublish(&imuAcqBlock);
+
+		first = false;
+		if(remaining < IMU_ACQ_BLOCK_SAMPLES) return;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void ImuAcquisitionPublish(const ImuBlock *block)
+* @brief	Updates the newest sample and hands the block to every consumer
+* @param[in]	block Block to publish
+*****************************************************************************/
+static void ImuAcquisitionPublish(const ImuBlock *block)
+{
+	taskENTER_CRITICAL();
+	imuAcqLatest = block->sample[block->count - 1];
+	imuAcqLatestTick = block->tick;
+	imuAcqHasLatest = true;
+	taskEXIT_CRITICAL();
+
+	imuAcqStats.blocks++;
+	imuAcqStats.samples += block->count;
+
+	for(uint8_t i = 0; i < imuAcqConsumerCount; i++)
+	{
+		imuAcqConsumers[i](block);
+	}
+}
+
+/******************************************************************************
+* Task Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void vImuAcquisitionTask(void *pvParameters)
+* @brief	Configures the FIFO and drains it every time INT1 signals the watermark
+* @details	INT1 is unmasked again after each drain.
+*			If INT1 does not fire within IMU_ACQ_POLL_MS the FIFO is drained anyway, so a missed interrupt or an
+*			unwired INT1 only adds latency.
+* @param[in]	pvParameters Parameters passed when task is initialized. Not used.
+* @return	Should not return! This is a task defining function.
+*****************************************************************************/
+void vImuAcquisitionTask(void *pvParameters)
+{
+	uint32_t notifiedValue = 0;
+
+	imuAcqTask = xTaskGetCurrentTaskHandle();
+	if(ImuAcquisitionConfigureFifo() != 0)
+	{
+		SerialConsoleWriteString("Could not configure IMU FIFO!\r\n");
+	}
+	ImuAcquisitionConfigureInterrupt();
+
+	while(1)
+	{
+		notifiedValue = 0;
+		xTaskNotifyWait(0, IMU_ACQ_NOTIFY_BIT, &notifiedValue, pdMS_TO_TICKS(IMU_ACQ_POLL_MS));
+		if(notifiedValue & IMU_ACQ_NOTIFY_BIT)
+		{
+			ImuAcquisitionDrain(imuAcqIntTick);
+			extint_chan_enable_callback(IMU_ACQ_INT_EIC_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+		}
+		else
+		{
+			imuAcqStats.polls++;
+			ImuAcquisitionDrain(xTaskGetTickCount());
+		}
+	}
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		int32_t ImuAcquisitionRegisterConsumer(ImuBlockConsumer consumer)
+* @brief	Registers a function that receives every block of samples
+* @param[in]	consumer Function to call. It runs on the acquisition task and must not block.
+* @return	ERROR_NONE if registered, ERROR_INVALID_ARG if consumer is NULL, ERROR_NO_RESOURCE if the table is full
+* @note		Register consumers before the scheduler starts
+*****************************************************************************/
+int32_t ImuAcquisitionRegisterConsumer(ImuBlockConsumer consumer)
+{
+	if(consumer == NULL)
+	{
+		return ERROR_INVALID_ARG;
+	}
+	if(imuAcqConsumerCount >= IMU_ACQ_MAX_CONSUMERS)
+	{
+		return ERROR_NO_RESOURCE;
+	}
+
+	imuAcqConsumers[imuAcqConsumerCount++] = consumer;
+	return ERROR_NONE;
+}
+
+/**************************************************************************//**
+* @fn		bool ImuAcquisitionGetLatest(ImuSample *sample, uint32_t *tick)
+* @brief	Returns the newest sample acquired, without touching the bus
+* @param[out]	sample Newest sample
+* @param[out]	tick Tick at which it was taken. Can be NULL.
+* @return	true if a sample was returned, false if nothing has been acquired yet
+*****************************************************************************/
+bool ImuAcquisitionGetLatest(ImuSample *sample, uint32_t *tick)
+{
+	bool hasLatest;
+
+	taskENTER_CRITICAL();
+	hasLatest = imuAcqHasLatest;
+	*sample = imuAcqLatest;
+	if(tick != NULL) *tick = imuAcqLatestTick;
+	taskEXIT_CRITICAL();
+
+	return hasLatest;
+}
+
+/**************************************************************************//**
+* @fn		void ImuAcquisitionGetStats(ImuAcqStats *stats)
+* @brief	Returns a copy of the acquisition statistics
+* @param[out]	stats Statistics
+*****************************************************************************/
+void ImuAcquisitionGetStats(ImuAcqStats *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = imuAcqStats;
+	taskEXIT_CRITICAL();
+}
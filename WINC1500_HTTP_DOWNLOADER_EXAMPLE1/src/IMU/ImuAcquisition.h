@@ -0,0 +1,100 @@
+/**************************************************************************//**
+* @file      ImuAcquisition.h
+* @brief     High-rate LSM6DS3 acquisition using the hardware FIFO.
+The LSM6DS3 batches gyroscope and accelerometer samples into its FIFO at IMU_ACQ_ODR and raises INT1 once
+IMU_ACQ_BLOCK_SAMPLES samples are waiting. The acquisition task then reads the FIFO status and the whole block
+in two I2C transactions, and hands a timestamped block of samples to every registered consumer.
+If INT1 is not wired, the task still drains the FIFO every IMU_ACQ_POLL_MS.
+Once started, this module is the only user of the IMU on the bus. Other tasks read ImuAcquisitionGetLatest().
+
+******************************************************************************/
+
+
+#ifndef IMU_ACQUISITION_H
+#define IMU_ACQUISITION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "asf.h"
+#include "IMU/lsm6ds_reg.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define IMU_ACQ_TASK_SIZE			256							///<Size of stack to assign to the acquisition task. In words
+#define IMU_ACQ_TASK_PRIORITY		(configMAX_PRIORITIES - 2)	///<Above the UI so the FIFO is drained before it overruns
+
+#define IMU_ACQ_INT_PIN				EXT3_IRQ_PIN				///<LSM6DS3 INT1 line, on the EXT3 IRQ pin (PA06). EXT3 shares the sensor I2C bus with EXT1
+#define IMU_ACQ_INT_MUX				EXT3_IRQ_MUX				///<EIC function of the INT1 pin
+#define IMU_ACQ_INT_EIC_LINE		EXT3_IRQ_INPUT				///<EXTINT channel of the INT1 pin
+#define IMU_ACQ_NOTIFY_BIT			(1UL << 1)					///<Task notification bit set when the FIFO reaches the watermark
+
+#define IMU_ACQ_ODR					LSM6DS3_FIFO_416Hz			///<FIFO, accelerometer and gyroscope output data rate
+#define IMU_ACQ_ODR_HZ				416							///<IMU_ACQ_ODR in Hz
+#define IMU_ACQ_XL_FS				LSM6DS3_2g					///<Accelerometer full scale
+#define IMU_ACQ_GY_FS				LSM6DS3_2000dps				///<Gyroscope full scale
+#define IMU_ACQ_SAMPLE_PERIOD_US	(1000000UL / IMU_ACQ_ODR_HZ)	///<Time between two samples, in us
+#define IMU_ACQ_WORDS_PER_SAMPLE	6							///<FIFO words per sample: gyro X Y Z then accel X Y Z
+#define IMU_ACQ_BYTES_PER_SAMPLE	(IMU_ACQ_WORDS_PER_SAMPLE * 2)	///<FIFO bytes per sample
+#define IMU_ACQ_BLOCK_SAMPLES		16							///<Samples per block, and FIFO watermark. A block must fit in one 255 byte FIFO read
+#define IMU_ACQ_POLL_MS				100							///<Longest wait for the watermark INT before the FIFO is checked anyway
+#define IMU_ACQ_MAX_CONSUMERS		4							///<Maximum number of block consumers
+
+#define IMU_BLOCK_FLAG_OVERRUN		0x01						///<The FIFO overran before this block. Samples were lost before it
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Structure that holds one raw sample read from the FIFO
+typedef struct ImuSample
+{
+	int16_t gyro[3];	///<Angular rate X, Y, Z in LSB of the gyroscope full scale
+	int16_t accel[3];	///<Acceleration X, Y, Z in LSB of the accelerometer full scale
+} ImuSample;
+
+//Structure that holds a block of consecutive samples drained from the FIFO
+typedef struct ImuBlock
+{
+	uint32_t tick;			///<Tick at which the FIFO was found at the watermark. Taken as the time of the last sample
+	uint32_t sequence;		///<Number of samples acquired before the first sample of this block
+	uint32_t periodUs;		///<Time between two samples, in us. Sample i was taken at tick - (count - 1 - i) * periodUs / 1000
+	uint8_t count;			///<Number of samples in the block
+	uint8_t flags;			///<IMU_BLOCK_FLAG_* values
+	ImuSample sample[IMU_ACQ_BLOCK_SAMPLES];	///<Samples, oldest first
+} ImuBlock;
+
+//Statistics of the acquisition
+typedef struct ImuAcqStats
+{
+	uint32_t blocks;		///<Blocks published
+	uint32_t samples;		///<Samples published
+	uint32_t overruns;		///<Times the FIFO was found overrun
+	uint32_t realigns;		///<Times the FIFO read pointer was not at the start of a sample
+	uint32_t busErrors;		///<Failed FIFO reads
+	uint32_t polls;			///<Drains started by the poll timeout instead of INT1
+} ImuAcqStats;
+
+///Consumer of sample blocks. Called from the acquisition task; copy what it needs and only block briefly, the FIFO holds about 1.6 s of samples.
+typedef void (*ImuBlockConsumer)(const ImuBlock *block);
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+void vImuAcquisitionTask(void *pvParameters);
+int32_t ImuAcquisitionRegisterConsumer(ImuBlockConsumer consumer);
+bool ImuAcquisitionGetLatest(ImuSample *sample, uint32_t *tick);
+void ImuAcquisitionGetStats(ImuAcqStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IMU_ACQUISITION_H*/
@@ -0,0 +1,243 @@
+/**************************************************************************//**
+* @file      ImuDsp.c
+* @brief     Streaming fixed-point processing of the IMU acquisition blocks.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "IMU/ImuDsp.h"
+#include "IMU/ImuFixed.h"
+#include "I2cDriver/I2cDriver.h"
+#include "WifiHandlerThread/WifiHandler.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define IMU_DSP_AXES		3	///<Accelerometer axes processed
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Filter and window state of one axis
+typedef struct ImuDspAxis
+{
+	int32_t lowPass;		///<Low-pass output, in LSB with IMU_DSP_STATE_BITS fractional bits
+	uint64_t sumSquares;	///<Sum of the squared high-pass outputs over the window
+	uint16_t peak;			///<Largest absolute high-pass output over the window, in LSB
+} ImuDspAxis;
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static ImuDspAxis imuDspAxis[IMU_DSP_AXES];		///<State of each axis
+static uint16_t imuDspWindowCount = 0;			///<Samples in the current window
+static bool imuDspPrimed = false;				///<True once the low-pass state has been seeded with a sample
+static ImuFeatures imuDspFeatures;				///<Features of the last complete window
+static bool imuDspHasFeatures = false;			///<True once a window has completed
+static ImuDspStats imuDspStats;					///<Processing statistics
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static void ImuDspConsumeBlock(const ImuBlock *block);
+static void ImuDspEndWindow(uint32_t tick);
+static uint32_t ImuDspSqrt(uint32_t value);
+static int16_t ImuDspToMg(int32_t raw);
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void ImuDspConsumeBlock(const ImuBlock *block)
+* @brief	Runs the filters over the accelerometer samples of a block
+* @details	Called by the acquisition task. The time spent is measured against SysTick, which counts CPU cycles
+*			down from its reload value once per RTOS tick.
+* @param[in]	block Block published by the acquisition
+*****************************************************************************/
+static void ImuDspConsumeBlock(const ImuBlock *block)
+{
+	uint32_t startValue = SysTick->VAL;
+	TickType_t startTick = xTaskGetTickCount();
+
+	if(block->flags & IMU_BLOCK_FLAG_OVERRUN)
+	{
+		//Samples were lost; restart the window instead of mixing both sides of the gap
+		imuDspPrimed = false;
+	}
+
+	for(uint8_t i = 0; i < block->count; i++)
+	{
+		const int16_t *accel = block->sample[i].accel;
+
+		if(!imuDspPrimed)
+		{
+			for(uint8_t axis = 0; axis < IMU_DSP_AXES; axis++)
+			{
+				imuDspAxis[axis].lowPass = (int32_t)accel[axis] * (1L << IMU_DSP_STATE_BITS);
+				imuDspAxis[axis].sumSquares = 0;
+				imuDspAxis[axis].peak = 0;
+			}
+			imuDspWindowCount = 0;
+			imuDspPrimed = true;
+		}
+
+		for(uint8_t axis = 0; axis < IMU_DSP_AXES; axis++)
+		{
+			ImuDspAxis *state = &imuDspAxis[axis];
+			int32_t highPass;
+			uint32_t magnitude;
+
+			state->lowPass += (((int32_t)accel[axis] * (1L << IMU_DSP_STATE_BITS)) - state->lowPass) >> IMU_DSP_LPF_SHIFT;
+			highPass = accel[axis] - (state->lowPass >> IMU_DSP_STATE_BITS);
+			magnitude = (highPass < 0) ? -highPass : highPass;
+			if(magnitude > INT16_MAX) magnitude = INT16_MAX;
+
+			state->sumSquares += magnitude * magnitude;
+			if(magnitude > state->peak) state->peak = magnitude;
+		}
+
+		if(++imuDspWindowCount >= IMU_DSP_WINDOW_SAMPLES)
+		{
+			ImuDspEndWindow(block->tick - ((uint32_t)(block->count - 1 - i) * block->periodUs) / 1000);
+		}
+	}
+
+	uint32_t cycles = (xTaskGetTickCount() - startTick) * (SysTick->LOAD + 1) + startValue - SysTick->VAL;
+	if(block->count != 0)
+	{
+		imuDspStats.cyclesPerSample = cycles / block->count;
+		if(imuDspStats.cyclesPerSample > imuDspStats.maxCyclesPerSample) imuDspStats.maxCyclesPerSample = imuDspStats.cyclesPerSample;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void ImuDspEndWindow(uint32_t tick)
+* @brief	Converts the window results to mg, publishes the low-pass output and starts a new window
+* @details	The Wifi queue is sent to with a short timeout; the IMU FIFO holds well over a second of samples,
+*			so a full queue only delays the acquisition.
+* @param[in]	tick Tick of the last sample of the window
+*****************************************************************************/
+static void ImuDspEndWindow(uint32_t tick)
+{
+	ImuFeatures features;
+	struct ImuDataPacket packet;
+
+	features.tick = tick;
+	for(uint8_t axis = 0; axis < IMU_DSP_AXES; axis++)
+	{
+		ImuDspAxis *state = &imuDspAxis[axis];
+		uint32_t meanSquare = (uint32_t)(state->sumSquares / imuDspWindowCount);
+
+		features.lowPassMg[axis] = ImuDspToMg(state->lowPass >> IMU_DSP_STATE_BITS);
+		features.rmsMg[axis] = ImuDspToMg(ImuDspSqrt(meanSquare));
+		features.peakMg[axis] = ImuDspToMg(state->peak);
+
+		state->sumSquares = 0;
+		state->peak = 0;
+	}
+	imuDspWindowCount = 0;
+
+	taskENTER_CRITICAL();
+	imuDspFeatures = features;
+	imuDspHasFeatures = true;
+	imuDspStats.windows++;
+	taskEXIT_CRITICAL();
+
+	packet.xmg = features.lowPassMg[0];
+	packet.ymg = features.lowPassMg[1];
+	packet.zmg = features.lowPassMg[2];
+	WifiAddImuDataToQueue(&packet);
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t ImuDspSqrt(uint32_t value)
+* @brief	Integer square root, rounded down. Uses shifts and adds only.
+* @param[in]	value Value
+* @return	floor(sqrt(value))
+*****************************************************************************/
+static uint32_t ImuDspSqrt(uint32_t value)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while(bit > value) bit >>= 2;
+	while(bit != 0)
+	{
+		if(value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+/**************************************************************************//**
+* @fn		static int16_t ImuDspToMg(int32_t raw)
+* @brief	Converts an accelerometer value in LSB to mg at the acquisition full scale
+* @param[in]	raw Value in LSB
+* @return	Value in mg
+*****************************************************************************/
+static int16_t ImuDspToMg(int32_t raw)
+{
+	return (int16_t)ImuFixedConvert(raw, ImuFixedGetAccelScale(IMU_ACQ_XL_FS));
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		int32_t ImuDspInit(void)
+* @brief	Registers the processing with the IMU acquisition
+* @return	ERROR_NONE if registered or if IMU_DSP_ENABLED is 0, an error from ImuAcquisitionRegisterConsumer otherwise
+* @note		Call before the scheduler starts
+*****************************************************************************/
+int32_t ImuDspInit(void)
+{
+#if IMU_DSP_ENABLED
+	return ImuAcquisitionRegisterConsumer(ImuDspConsumeBlock);
+#else
+	return ERROR_NONE;
+#endif
+}
+
+/**************************************************************************//**
+* @fn		bool ImuDspGetFeatures(ImuFeatures *features)
+* @brief	Returns the features of the last complete window
+* @param[out]	features Features
+* @return	true if features were returned, false if no window has completed yet
+*****************************************************************************/
+bool ImuDspGetFeatures(ImuFeatures *features)
+{
+	bool hasFeatures;
+
+	taskENTER_CRITICAL();
+	hasFeatures = imuDspHasFeatures;
+	*features = imuDspFeatures;
+	taskEXIT_CRITICAL();
+
+	return hasFeatures;
+}
+
+/**************************************************************************//**
+* @fn		void ImuDspGetStats(ImuDspStats *stats)
+* @brief	Returns a copy of the processing statistics
+* @param[out]	stats Statistics
+*****************************************************************************/
+void ImuDspGetStats(ImuDspStats *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = imuDspStats;
+	taskEXIT_CRITICAL();
+}
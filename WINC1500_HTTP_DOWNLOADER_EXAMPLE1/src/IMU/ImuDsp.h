@@ -0,0 +1,70 @@
+/**************************************************************************//**
+* @file      ImuDsp.h
+* @brief     Streaming fixed-point processing of the IMU acquisition blocks.
+Consumes the accelerometer samples of every ImuBlock and, for each window of IMU_DSP_WINDOW_SAMPLES samples:
+- low-pass filters each axis with a first order IIR, y += (x - y) / 2^IMU_DSP_LPF_SHIFT, and keeps the last
+  output (decimation by IMU_DSP_WINDOW_SAMPLES);
+- high-pass filters each axis as x - y, and measures its RMS and peak over the window.
+All arithmetic is on raw samples (Q15 of the full scale) with 32-bit state; results are converted to mg at the
+end of the window with ImuFixed. Only the decimated low-pass output is published over MQTT.
+
+******************************************************************************/
+
+
+#ifndef IMU_DSP_H
+#define IMU_DSP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include "IMU/ImuAcquisition.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#ifndef IMU_DSP_ENABLED
+#define IMU_DSP_ENABLED			1	///<Set to 0 to publish raw samples from the control task instead of the processed ones
+#endif
+
+#define IMU_DSP_LPF_SHIFT		6	///<Low-pass coefficient 2^-6. Cutoff ~ fs / (2 * pi * 64) = 1 Hz at 416 Hz
+#define IMU_DSP_STATE_BITS		8	///<Fractional bits kept in the low-pass state below 1 LSB
+#define IMU_DSP_WINDOW_SAMPLES	104	///<Samples per window, and decimation factor. 250 ms at 416 Hz
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Values derived from one window of accelerometer samples
+typedef struct ImuFeatures
+{
+	uint32_t tick;			///<Tick of the last sample of the window
+	int16_t lowPassMg[3];	///<Low-pass filtered acceleration X, Y, Z at the end of the window, in mg
+	int16_t rmsMg[3];		///<RMS of the high-pass filtered acceleration over the window, in mg
+	int16_t peakMg[3];		///<Largest absolute high-pass filtered acceleration over the window, in mg
+} ImuFeatures;
+
+//Cost of the processing, measured with SysTick
+typedef struct ImuDspStats
+{
+	uint32_t windows;				///<Windows completed
+	uint32_t cyclesPerSample;		///<CPU cycles per sample spent on the last block
+	uint32_t maxCyclesPerSample;	///<Worst CPU cycles per sample seen
+} ImuDspStats;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+int32_t ImuDspInit(void);
+bool ImuDspGetFeatures(ImuFeatures *features);
+void ImuDspGetStats(ImuDspStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IMU_DSP_H*/
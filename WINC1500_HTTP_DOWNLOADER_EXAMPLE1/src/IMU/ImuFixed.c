@@ -0,0 +1,75 @@
+/**************************************************************************//**
+* @file      ImuFixed.c
+* @brief     Fixed-point conversion of LSM6DS3 raw samples to physical units.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "IMU/ImuFixed.h"
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static const ImuFixedScale imuFixedXl2g = {1999, IMU_FIXED_XL_SHIFT};		///<0.061 mg/LSB
+static const ImuFixedScale imuFixedXl4g = {3998, IMU_FIXED_XL_SHIFT};		///<0.122 mg/LSB
+static const ImuFixedScale imuFixedXl8g = {7995, IMU_FIXED_XL_SHIFT};		///<0.244 mg/LSB
+static const ImuFixedScale imuFixedXl16g = {15991, IMU_FIXED_XL_SHIFT};		///<0.488 mg/LSB
+
+static const ImuFixedScale imuFixedGy125dps = {35, IMU_FIXED_GY_SHIFT};		///<4.375 mdps/LSB
+static const ImuFixedScale imuFixedGy250dps = {70, IMU_FIXED_GY_SHIFT};		///<8.75 mdps/LSB
+static const ImuFixedScale imuFixedGy500dps = {140, IMU_FIXED_GY_SHIFT};	///<17.5 mdps/LSB
+static const ImuFixedScale imuFixedGy1000dps = {280, IMU_FIXED_GY_SHIFT};	///<35 mdps/LSB
+static const ImuFixedScale imuFixedGy2000dps = {560, IMU_FIXED_GY_SHIFT};	///<70 mdps/LSB
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		const ImuFixedScale *ImuFixedGetAccelScale(lsm6ds3_xl_fs_t fullScale)
+* @brief	Returns the scale that converts accelerometer samples to mg
+* @param[in]	fullScale Accelerometer full scale the samples were taken with
+* @return	Scale for ImuFixedConvert()
+*****************************************************************************/
+const ImuFixedScale *ImuFixedGetAccelScale(lsm6ds3_xl_fs_t fullScale)
+{
+	switch(fullScale)
+	{
+		case LSM6DS3_4g:
+			return &imuFixedXl4g;
+		case LSM6DS3_8g:
+			return &imuFixedXl8g;
+		case LSM6DS3_16g:
+			return &imuFixedXl16g;
+		case LSM6DS3_2g:
+		default:
+			return &imuFixedXl2g;
+	}
+}
+
+/**************************************************************************//**
+* @fn		const ImuFixedScale *ImuFixedGetGyroScale(lsm6ds3_fs_g_t fullScale)
+* @brief	Returns the scale that converts gyroscope samples to mdps
+* @param[in]	fullScale Gyroscope full scale the samples were taken with
+* @return	Scale for ImuFixedConvert()
+*****************************************************************************/
+const ImuFixedScale *ImuFixedGetGyroScale(lsm6ds3_fs_g_t fullScale)
+{
+	switch(fullScale)
+	{
+		case LSM6DS3_125dps:
+			return &imuFixedGy125dps;
+		case LSM6DS3_500dps:
+			return &imuFixedGy500dps;
+		case LSM6DS3_1000dps:
+			return &imuFixedGy1000dps;
+		case LSM6DS3_2000dps:
+			return &imuFixedGy2000dps;
+		case LSM6DS3_250dps:
+		default:
+			return &imuFixedGy250dps;
+	}
+}
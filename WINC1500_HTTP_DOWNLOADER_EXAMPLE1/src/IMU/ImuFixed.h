@@ -0,0 +1,66 @@
+/**************************************************************************//**
+* @file      ImuFixed.h
+* @brief     Fixed-point conversion of LSM6DS3 raw samples to physical units.
+The LSM6DS3 float converters (lsm6ds3_from_fs2g_to_mg() and friends) pull in the soft-float library on the
+Cortex-M0+. Here every full scale is reduced to a multiplier and a right shift, so a conversion costs one 32-bit
+multiply, an add and a shift:
+Accelerometer: mg = raw * sensitivity in Q15 (0.061, 0.122, 0.244, 0.488 mg/LSB). Within 1 mg of the float result.
+Gyroscope:     mdps = raw * sensitivity in Q3 (4.375, 8.75, 17.5, 35, 70 mdps/LSB). Exact before rounding to 1 mdps.
+A raw sample is itself the Q15 fraction of the full scale, so filters can run on raw samples and convert at the end.
+
+******************************************************************************/
+
+
+#ifndef IMU_FIXED_H
+#define IMU_FIXED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include "IMU/lsm6ds_reg.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define IMU_FIXED_XL_SHIFT		15	///<Fractional bits of the accelerometer multipliers
+#define IMU_FIXED_GY_SHIFT		3	///<Fractional bits of the gyroscope multipliers
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Scale that converts a raw sample to physical units: (raw * multiplier) >> shift, rounded to nearest
+typedef struct ImuFixedScale
+{
+	int32_t multiplier;		///<Sensitivity, with shift fractional bits
+	uint8_t shift;			///<Fractional bits of the multiplier
+} ImuFixedScale;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+const ImuFixedScale *ImuFixedGetAccelScale(lsm6ds3_xl_fs_t fullScale);
+const ImuFixedScale *ImuFixedGetGyroScale(lsm6ds3_fs_g_t fullScale);
+
+/**************************************************************************//**
+* @fn		static inline int32_t ImuFixedConvert(int32_t raw, const ImuFixedScale *scale)
+* @brief	Converts a raw value, or any value in raw LSB, to mg or mdps
+* @param[in]	raw Value in LSB. Can be wider than 16 bits as long as raw * multiplier fits in 32 bits.
+* @param[in]	scale Scale of the full scale the value was taken with
+* @return	Value in mg (accelerometer) or mdps (gyroscope)
+*****************************************************************************/
+static inline int32_t ImuFixedConvert(int32_t raw, const ImuFixedScale *scale)
+{
+	return ((raw * scale->multiplier) + (1L << (scale->shift - 1))) >> scale->shift;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IMU_FIXED_H*/
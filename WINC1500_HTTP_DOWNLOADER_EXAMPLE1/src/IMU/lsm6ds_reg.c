@@ -16,8 +16,9 @@
  *
  ******************************************************************************
  */
-#include "IMU\lsm6ds_reg.h"
-#include "I2cDriver\I2cDriver.h"
+#include <string.h>
+#include "IMU/lsm6ds_reg.h"
+#include "I2cDriver/I2cDriver.h"
 
 /**
   * @defgroup    LSM6DS3
@@ -5915,7 +5916,8 @@ static int32_t platform_write(void *handle, uint8_t reg, uint8_t *bufp,uint16_t
 memcpy(&msgOutImu[1],bufp,len);
 msgOutImu[0] = reg;
 imuData.address = (LSM6DS3_I2C_ADD_L>>1);
-imuData.msgOut = &msgOutImu;
+imuData.speed = I2C_SPEED_FAST;
+imuData.msgOut = msgOutImu;
 imuData.lenOut = len+1; //+1 because we are adding the REG address.
 imuData.lenIn = 0;
 return I2cWriteDataWait(&imuData, 100);
@@ -5926,11 +5928,12 @@ static  int32_t platform_read(void *handle, uint8_t reg, uint8_t *bufp, uint16_t
 {
 
 imuData.address = (LSM6DS3_I2C_ADD_L>>1);
+imuData.speed = I2C_SPEED_FAST;
 imuData.msgOut = &reg;
 imuData.msgIn = bufp;
 imuData.lenOut = 1;
 imuData.lenIn = len;
-return I2cReadDataWait(&imuData,0, 100);
+return I2cReadRegisterWait(&imuData, 100);
 
 
 }
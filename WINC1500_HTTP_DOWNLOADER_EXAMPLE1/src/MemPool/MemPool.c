@@ -0,0 +1,160 @@
+/**************************************************************************//**
+* @file      MemPool.c
+* @brief     Fixed block memory pools.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "MemPool/MemPool.h"
+#include "I2cDriver/I2cDriver.h"
+#include "asf.h"
+#include <string.h>
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static MemPool *memPools[MEM_POOL_MAX_POOLS];	///<Pools listed in the statistics
+static uint8_t memPoolCount = 0;				///<Number of registered pools
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		int32_t MemPoolRegister(MemPool *pool)
+* @brief	Lists a pool in the statistics. The pool itself works without being registered.
+* @param[in]	pool Pool defined with MEM_POOL_DEFINE()
+* @return	ERROR_NONE if registered, ERROR_NO_RESOURCE if MEM_POOL_MAX_POOLS pools are already registered
+*****************************************************************************/
+int32_t MemPoolRegister(MemPool *pool)
+{
+	int32_t error = ERROR_NO_RESOURCE;
+	irqflags_t flags = cpu_irq_save();
+
+	for(uint8_t i = 0; i < memPoolCount; i++)
+	{
+		if(memPools[i] == pool)
+		{
+			error = ERROR_NONE;
+			goto exit;
+		}
+	}
+	if(memPoolCount < MEM_POOL_MAX_POOLS)
+	{
+		memPools[memPoolCount++] = pool;
+		error = ERROR_NONE;
+	}
+
+exit:
+	cpu_irq_restore(flags);
+	return error;
+}
+
+/**************************************************************************//**
+* @fn		void *MemPoolAlloc(MemPool *pool)
+* @brief	Takes a block from a pool. Can be called from interrupts.
+* @param[in]	pool Pool
+* @return	Block of pool->blockSize bytes, word aligned. NULL if the pool is empty
+*****************************************************************************/
+void *MemPoolAlloc(MemPool *pool)
+{
+	void *block = NULL;
+	irqflags_t flags = cpu_irq_save();
+
+	if(pool->freeList != NULL)
+	{
+		block = pool->freeList;
+		memcpy(&pool->freeList, block, sizeof(void *));	//Blocks are only word aligned
+	}
+	else if(pool->untouched < pool->blockCount)
+	{
+		block = (uint8_t *) pool->storage + (uint32_t) pool->untouched * pool->blockSize;
+		pool->untouched++;
+	}
+
+	if(block != NULL)
+	{
+		uint32_t index = (uint32_t)((uint8_t *) block - (uint8_t *) pool->storage) / pool->blockSize;
+		pool->used[index / 32] |= 1UL << (index % 32);
+		pool->inUse++;
+		if(pool->inUse > pool->highWater) pool->highWater = pool->inUse;
+	}
+	else
+	{
+		pool->failures++;
+	}
+
+	cpu_irq_restore(flags);
+	return block;
+}
+
+/**************************************************************************//**
+* @fn		int32_t MemPoolFree(MemPool *pool, void *block)
+* @brief	Gives a block back to its pool. Can be called from interrupts.
+* @param[in]	pool Pool the block was taken from
+* @param[in]	block Block returned by MemPoolAlloc(). NULL is ignored
+* @return	ERROR_NONE if freed, ERROR_INVALID_ARG if the block does not belong to the pool,
+*			ERROR_NO_CHANGE if the block is already free
+*****************************************************************************/
+int32_t MemPoolFree(MemPool *pool, void *block)
+{
+	uint32_t offset, index, mask;
+	irqflags_t flags;
+	int32_t error = ERROR_NONE;
+
+	if(block == NULL) return ERROR_NONE;
+
+	offset = (uint32_t)((uint8_t *) block - (uint8_t *) pool->storage);
+	if((uint8_t *) block < (uint8_t *) pool->storage || offset >= (uint32_t) pool->untouched * pool->blockSize || (offset % pool->blockSize) != 0)
+	{
+		return ERROR_INVALID_ARG;
+	}
+
+	index = offset / pool->blockSize;
+	mask = 1UL << (index % 32);
+
+	flags = cpu_irq_save();
+	if((pool->used[index / 32] & mask) == 0)
+	{
+		//Already free: linking it again would hand it out twice
+		error = ERROR_NO_CHANGE;
+	}
+	else
+	{
+		pool->used[index / 32] &= ~mask;
+		memcpy(block, &pool->freeList, sizeof(void *));
+		pool->freeList = block;
+		pool->inUse--;
+	}
+	cpu_irq_restore(flags);
+	return error;
+}
+
+/**************************************************************************//**
+* @fn		bool MemPoolGetStats(uint8_t index, MemPoolStats *stats)
+* @brief	Copies the statistics of a registered pool
+* @param[in]	index Pool, in registration order
+* @param[out]	stats Where to copy the statistics
+* @return	false if index is past the last registered pool
+*****************************************************************************/
+bool MemPoolGetStats(uint8_t index, MemPoolStats *stats)
+{
+	const MemPool *pool;
+	irqflags_t flags;
+
+	if(index >= memPoolCount) return false;
+
+	pool = memPools[index];
+	flags = cpu_irq_save();
+	stats->name = pool->name;
+	stats->blockSize = pool->blockSize;
+	stats->blockCount = pool->blockCount;
+	stats->inUse = pool->inUse;
+	stats->highWater = pool->highWater;
+	stats->failures = pool->failures;
+	cpu_irq_restore(flags);
+	return true;
+}
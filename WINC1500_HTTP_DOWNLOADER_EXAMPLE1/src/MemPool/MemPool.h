@@ -0,0 +1,87 @@
+/**************************************************************************//**
+* @file      MemPool.h
+* @brief     Fixed block memory pools.
+A pool is a static array of equally sized blocks. Allocating and freeing take constant time and a few instructions
+with interrupts disabled, so they can also be used from interrupts. Free blocks are kept in a list threaded through
+the blocks themselves; blocks that were never handed out are taken from the end of the array, so a pool defined with
+MEM_POOL_DEFINE() works without any initialization. Each pool keeps its high water mark and the number of failed
+allocations, which tells how many blocks it really needs. A bit per block records which blocks are handed out, so
+freeing a block twice is refused instead of linking it into the free list twice.
+
+******************************************************************************/
+
+
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define MEM_POOL_MAX_POOLS		6	///<Maximum number of pools listed by MemPoolGetStats()
+
+///Size of a block once rounded up to hold the free list link and keep every block word aligned
+#define MEM_POOL_BLOCK_WORDS(blockSize)		(((blockSize) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+
+///Number of words of the bitmap that tracks which of blockCount blocks are handed out
+#define MEM_POOL_USED_WORDS(blockCount)		(((blockCount) + 31) / 32)
+
+///Defines a pool called var, private to the file, of blockCount blocks of blockSize bytes. Usable before MemPoolRegister()
+#define MEM_POOL_DEFINE(var, poolName, blockSize, blockCount)											\
+	static uint32_t var##Storage[MEM_POOL_BLOCK_WORDS(blockSize) * (blockCount)];						\
+	static uint32_t var##Used[MEM_POOL_USED_WORDS(blockCount)];											\
+	static MemPool var = {poolName, var##Storage, var##Used, MEM_POOL_BLOCK_WORDS(blockSize) * sizeof(uint32_t), (blockCount), 0, NULL, 0, 0, 0}
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+///Pool of fixed size blocks. Define it with MEM_POOL_DEFINE() and do not touch its fields
+typedef struct MemPool
+{
+	const char *name;		///<Name of the pool, for the statistics
+	uint32_t *storage;		///<Blocks
+	uint32_t *used;			///<One bit per block, set while the block is handed out
+	uint16_t blockSize;		///<Size of a block in bytes, word aligned
+	uint16_t blockCount;	///<Number of blocks
+	uint16_t untouched;		///<Blocks taken from storage at least once. The rest were never handed out
+	void *freeList;			///<Blocks that were freed, linked through their first word
+	uint16_t inUse;			///<Blocks handed out
+	uint16_t highWater;		///<Most blocks ever handed out at the same time
+	uint32_t failures;		///<Allocations that failed because the pool was empty
+} MemPool;
+
+//Statistics of a pool
+typedef struct MemPoolStats
+{
+	const char *name;		///<Name of the pool
+	uint16_t blockSize;		///<Size of a block in bytes
+	uint16_t blockCount;	///<Number of blocks
+	uint16_t inUse;			///<Blocks handed out
+	uint16_t highWater;		///<Most blocks ever handed out at the same time
+	uint32_t failures;		///<Allocations that failed because the pool was empty
+} MemPoolStats;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+int32_t MemPoolRegister(MemPool *pool);
+void *MemPoolAlloc(MemPool *pool);
+int32_t MemPoolFree(MemPool *pool, void *block);
+bool MemPoolGetStats(uint8_t index, MemPoolStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MEM_POOL_H*/
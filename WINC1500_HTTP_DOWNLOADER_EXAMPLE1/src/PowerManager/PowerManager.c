@@ -0,0 +1,172 @@
+/**************************************************************************//**
+* @file      PowerManager.c
+* @brief     Tickless idle for FreeRTOS, built on the ASF sleep manager.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "PowerManager/PowerManager.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define POWER_SYSTICK_TO_TIMER(counts, tickCounts)	((uint32_t)(((uint64_t)(counts) * POWER_TIMER_HZ) / ((uint64_t)(tickCounts) * configTICK_RATE_HZ)))	///<Converts SysTick counts to wake up timer counts, rounded down
+#define POWER_TIMER_TO_SYSTICK(counts, tickCounts)	((uint32_t)(((uint64_t)(counts) * (tickCounts) * configTICK_RATE_HZ) / POWER_TIMER_HZ))	///<Converts wake up timer counts to SysTick counts
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static struct tc_module powerTimer;			///<Wakes the MCU up when the next task has to run
+static bool powerTimerReady = false;		///<True once PowerManagerInit() has configured the wake up timer
+static PowerManagerStats powerStats;		///<Statistics. Only written with interrupts disabled
+static uint32_t powerSleptCounts;			///<SysTick counts asleep not yet added to powerStats.sleptTicks
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static void powerTimerCallback(struct tc_module *const module);
+
+/******************************************************************************
+* Callback Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void powerTimerCallback(struct tc_module *const module)
+* @brief	Wake up timer compare callback
+* @details	Nothing to do: the interrupt only has to wake the MCU up. The idle task reads the match flag and steps the
+*			tick count before interrupts are enabled again.
+*****************************************************************************/
+static void powerTimerCallback(struct tc_module *const module)
+{
+	UNUSED(module);
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void PowerManagerInit(void)
+* @brief	Configures the wake up timer and the sleep manager. Call before the scheduler starts.
+*****************************************************************************/
+void PowerManagerInit(void)
+{
+	struct tc_config config_tc;
+	tc_get_config_defaults(&config_tc);
+
+	config_tc.counter_size = TC_COUNTER_SIZE_16BIT;
+	config_tc.clock_source = POWER_TIMER_CLOCK;
+	config_tc.clock_prescaler = TC_CLOCK_PRESCALER_DIV1;
+	config_tc.wave_generation = TC_WAVE_GENERATION_NORMAL_FREQ;
+	config_tc.run_in_standby = true;
+
+	while (tc_init(&powerTimer, POWER_TIMER_MODULE, &config_tc) != STATUS_OK)
+	{
+
+	}
+
+	tc_register_callback(&powerTimer, powerTimerCallback, TC_CALLBACK_CC_CHANNEL0);
+	tc_enable_callback(&powerTimer, TC_CALLBACK_CC_CHANNEL0);
+	tc_enable(&powerTimer);
+	tc_stop_counter(&powerTimer); //Only counts while the MCU sleeps
+
+	sleepmgr_init();
+	sleepmgr_lock_mode(POWER_SLEEP_MODE_LIMIT);
+	powerTimerReady = true;
+}
+
+/**************************************************************************//**
+* @fn		void PowerManagerSuppressTicksAndSleep(uint32_t expectedIdleTime)
+* @brief	Sleeps with the kernel tick stopped. Called by the idle task through portSUPPRESS_TICKS_AND_SLEEP.
+* @details	The sleep is measured from the last tick, in SysTick counts: the part of the running tick already spent,
+*			then the wake up timer count. Whole ticks are stepped and the SysTick is restarted for the rest of the
+*			running tick, so the tick count keeps to the real time however the sleep ends. The ULP oscillator is only
+*			accurate to a few percent, which only matters for long sleeps.
+* @param[in]	expectedIdleTime Ticks until the next task has to run
+*****************************************************************************/
+void PowerManagerSuppressTicksAndSleep(uint32_t expectedIdleTime)
+{
+	enum sleepmgr_mode sleepMode = sleepmgr_get_sleep_mode();
+	uint32_t tickCounts = SysTick->LOAD + 1;	//SysTick counts per tick, as the port set them
+	uint32_t leftInTick, sleptCounts, elapsedCounts, completeTicks, pendedTicks = 0;
+	bool timerExpired;
+
+	if(!powerTimerReady || sleepMode == SLEEPMGR_ACTIVE) return;
+	if(expectedIdleTime > POWER_MAX_IDLE_TICKS) expectedIdleTime = POWER_MAX_IDLE_TICKS;
+
+	//Stop the kernel tick, then make sure nothing became ready in the meantime
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	__disable_irq();
+	if(eTaskConfirmSleepModeStatus() == eAbortSleep)
+	{
+		powerStats.aborts++;
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk; //Goes on from where it stopped
+		__enable_irq();
+		return;
+	}
+
+	//Arm the wake up timer for the tick the next task waits for: the rest of the running tick and expectedIdleTime - 1
+	//more. Any enabled interrupt wakes the MCU up even with interrupts disabled; it is served once the tick count has
+	//been corrected. A SysTick that reads 0 has just wrapped, and its tick is pending
+	leftInTick = SysTick->VAL;
+	if(leftInTick == 0) leftInTick = tickCounts;
+	tc_set_compare_value(&powerTimer, TC_COMPARE_CAPTURE_CHANNEL_0,
+		POWER_SYSTICK_TO_TIMER(leftInTick + (expectedIdleTime - 1) * tickCounts, tickCounts));
+	tc_clear_status(&powerTimer, TC_STATUS_CHANNEL_0_MATCH);
+	tc_start_counter(&powerTimer);
+
+	system_set_sleepmode((enum system_sleepmode)(sleepMode - 1));
+	__DSB();
+	__WFI();
+
+	timerExpired = (tc_get_status(&powerTimer) & TC_STATUS_CHANNEL_0_MATCH) != 0;
+	sleptCounts = POWER_TIMER_TO_SYSTICK(tc_get_count_value(&powerTimer), tickCounts);
+	tc_stop_counter(&powerTimer);
+	if(!timerExpired) powerStats.early++;
+
+	//The timer wakes up to one of its counts before the tick is due; the SysTick counts what is left. Past the tick
+	//that is due, step to the one before and let the SysTick handler deliver it, so the kernel unblocks the task as
+	//soon as interrupts are enabled
+	elapsedCounts = (tickCounts - leftInTick) + sleptCounts;
+	completeTicks = elapsedCounts / tickCounts;
+	if(completeTicks >= expectedIdleTime)
+	{
+		completeTicks = expectedIdleTime - 1;
+		pendedTicks = 1;
+		SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+	}
+	elapsedCounts -= (completeTicks + pendedTicks) * tickCounts;
+	if(elapsedCounts >= tickCounts - 1) elapsedCounts = tickCounts - 2;
+
+	//Restart the SysTick for the rest of the running tick: writing VAL makes it load the short reload at once, and the
+	//full one written back after it applies from the next wrap
+	SysTick->LOAD = tickCounts - elapsedCounts - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	vTaskStepTick(completeTicks);
+	SysTick->LOAD = tickCounts - 1;
+
+	powerStats.sleeps++;
+	powerSleptCounts += sleptCounts;
+	powerStats.sleptTicks += powerSleptCounts / tickCounts;
+	powerSleptCounts %= tickCounts;
+	__enable_irq();
+}
+
+/**************************************************************************//**
+* @fn		void PowerManagerGetStats(PowerManagerStats *stats)
+* @brief	Copies the tickless idle statistics
+* @param[out]	stats Where to copy the statistics
+*****************************************************************************/
+void PowerManagerGetStats(PowerManagerStats *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = powerStats;
+	stats->ticks = xTaskGetTickCount();
+	taskEXIT_CRITICAL();
+}
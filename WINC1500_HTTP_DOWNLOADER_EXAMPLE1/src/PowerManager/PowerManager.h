@@ -0,0 +1,61 @@
+/**************************************************************************//**
+* @file      PowerManager.h
+* @brief     Tickless idle for FreeRTOS, built on the ASF sleep manager.
+When every task is blocked for at least configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks, the idle task calls
+PowerManagerSuppressTicksAndSleep() instead of taking a SysTick interrupt every ms. The SysTick is stopped, a low
+power TC clocked from the 32 kHz ULP oscillator is armed to fire when the next task has to run, and the MCU enters the
+deepest sleep mode allowed by the sleep manager locks. On wake up the kernel tick count is stepped by the time slept,
+and the SysTick restarted for the rest of the running tick.
+The RTC is not used because FatFs keeps it in calendar mode for the file time stamps.
+
+******************************************************************************/
+
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include "asf.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define POWER_TIMER_MODULE			TC5					///<TC that wakes the MCU up. Shares its GCLK channel with TC4
+#define POWER_TIMER_CLOCK			GCLK_GENERATOR_2	///<ULP 32 kHz generator, runs in standby
+#define POWER_TIMER_HZ				32768UL				///<TC count rate, undivided: a sleep ended early is measured to 31 us
+#define POWER_MAX_IDLE_TICKS		1999				///<Longest sleep, in ticks. Keeps the wake up compare within 16 bits
+#define POWER_SLEEP_MODE_LIMIT		SLEEPMGR_IDLE_0		///<Deepest mode allowed by default. The EIC, the SERCOMs and TC3 run from GCLK 0 and need the APB clocks
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Statistics of the tickless idle
+typedef struct PowerManagerStats
+{
+	uint32_t sleeps;		///<Times the MCU went to sleep with the tick suppressed
+	uint32_t aborts;		///<Times a task became ready before the MCU could go to sleep
+	uint32_t early;			///<Sleeps ended by an interrupt before the wake up timer
+	uint32_t sleptTicks;	///<Ticks spent asleep with the tick suppressed
+	uint32_t ticks;			///<Tick count when the statistics were read. Residency is sleptTicks / ticks
+} PowerManagerStats;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+void PowerManagerInit(void);
+void PowerManagerSuppressTicksAndSleep(uint32_t expectedIdleTime);
+void PowerManagerGetStats(PowerManagerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*POWER_MANAGER_H*/
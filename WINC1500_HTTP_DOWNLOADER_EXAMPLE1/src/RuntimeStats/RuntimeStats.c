@@ -0,0 +1,241 @@
+/**************************************************************************//**
+* @file      RuntimeStats.c
+* @brief     FreeRTOS run time statistics: per task CPU use, stack high water marks and heap use.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdio.h>
+#include <malloc.h>
+#include "RuntimeStats/RuntimeStats.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "SerialConsole.h"
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static struct tc_module runtimeTimer;								///<Low 16 bits of the run time counter
+static volatile uint16_t runtimeOverflows = 0;						///<High 16 bits of the run time counter
+static TaskStatus_t runtimeTasks[RUNTIME_STATS_MAX_TASKS];			///<Last snapshot
+static uint16_t runtimeCpu[RUNTIME_STATS_MAX_TASKS];				///<CPU share of each task of the last snapshot, in 1/1000
+static uint8_t runtimeOrder[RUNTIME_STATS_MAX_TASKS];				///<Tasks of the last snapshot, busiest first
+static uint8_t runtimeTaskCount = 0;								///<Number of tasks in the last snapshot
+static TickType_t runtimeDumpPeriod = 0;							///<Ticks between two dumps. 0 when the dump is off
+static TickType_t runtimeDumpLast = 0;								///<Tick of the last dump
+static RuntimeStatsView runtimeDumpView;							///<CPU shares of the dump are since the previous dump
+static char runtimeDumpLine[RUNTIME_STATS_DUMP_LINE_LEN];			///<Line being written by the dump
+static const char runtimeStateLetter[] = {'X', 'R', 'B', 'S', 'D'};	///<Letter of each eTaskState
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static void runtimeTimerCallback(struct tc_module *const module);
+
+/******************************************************************************
+* Callback Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void runtimeTimerCallback(struct tc_module *const module)
+* @brief	Extends the run time counter to 32 bits. Called every 2 s.
+*****************************************************************************/
+static void runtimeTimerCallback(struct tc_module *const module)
+{
+	UNUSED(module);
+	runtimeOverflows++;
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void RuntimeStatsInit(void)
+* @brief	Starts the run time counter. Called by the kernel through portCONFIGURE_TIMER_FOR_RUN_TIME_STATS.
+*****************************************************************************/
+void RuntimeStatsInit(void)
+{
+	Tc *const hw = RUNTIME_STATS_TIMER_MODULE;
+	struct tc_config config_tc;
+	tc_get_config_defaults(&config_tc);
+
+	config_tc.counter_size = TC_COUNTER_SIZE_16BIT;
+	config_tc.clock_source = RUNTIME_STATS_TIMER_CLOCK;
+	config_tc.clock_prescaler = TC_CLOCK_PRESCALER_DIV1;
+	config_tc.wave_generation = TC_WAVE_GENERATION_NORMAL_FREQ;
+	config_tc.run_in_standby = true;
+
+	while (tc_init(&runtimeTimer, RUNTIME_STATS_TIMER_MODULE, &config_tc) != STATUS_OK)
+	{
+
+	}
+
+	tc_register_callback(&runtimeTimer, runtimeTimerCallback, TC_CALLBACK_OVERFLOW);
+	tc_enable_callback(&runtimeTimer, TC_CALLBACK_OVERFLOW);
+	tc_enable(&runtimeTimer);
+
+	//Keep COUNT synchronized so it can be read at every context switch without waiting for the 32 kHz clock domain
+	hw->COUNT16.READREQ.reg = TC_READREQ_RCONT | TC_READREQ_RREQ | TC_READREQ_ADDR(TC_COUNT16_COUNT_OFFSET);
+}
+
+/**************************************************************************//**
+* @fn		uint32_t RuntimeStatsGetCounter(void)
+* @brief	Returns the run time counter. Called by the kernel through portGET_RUN_TIME_COUNTER_VALUE at every context switch.
+* @return	Run time counter, in 1/RUNTIME_STATS_HZ s
+*****************************************************************************/
+uint32_t RuntimeStatsGetCounter(void)
+{
+	Tc *const hw = RUNTIME_STATS_TIMER_MODULE;
+	uint32_t high, low;
+	irqflags_t flags = cpu_irq_save();
+
+	high = runtimeOverflows;
+	low = hw->COUNT16.COUNT.reg;
+	if(hw->COUNT16.INTFLAG.reg & TC_INTFLAG_OVF)
+	{
+		//Wrapped but the overflow interrupt has not been served yet
+		high++;
+		low = hw->COUNT16.COUNT.reg;
+	}
+
+	cpu_irq_restore(flags);
+	return (high << 16) | low;
+}
+
+/**************************************************************************//**
+* @fn		uint8_t RuntimeStatsSnapshot(RuntimeStatsView *view)
+* @brief	Takes a snapshot of every task. Read it with RuntimeStatsGetTask().
+* @param[in,out]	view CPU shares are computed since the previous snapshot of this view, which is then updated.
+*					Zero it before its first use. NULL for shares since boot.
+* @return	Number of tasks in the snapshot. 0 if there are more than RUNTIME_STATS_MAX_TASKS tasks.
+*****************************************************************************/
+uint8_t RuntimeStatsSnapshot(RuntimeStatsView *view)
+{
+	uint32_t total, elapsed, used;
+	uint8_t i, j;
+
+	runtimeTaskCount = (uint8_t) uxTaskGetSystemState(runtimeTasks, RUNTIME_STATS_MAX_TASKS, &total);
+	elapsed = (view != NULL) ? total - view->total : total;
+
+	for(i = 0; i < runtimeTaskCount; i++)
+	{
+		UBaseType_t number = runtimeTasks[i].xTaskNumber;
+
+		used = runtimeTasks[i].ulRunTimeCounter;
+		if(view != NULL && number <= RUNTIME_STATS_MAX_TASKS)
+		{
+			used -= view->runTime[number];
+			view->runTime[number] = runtimeTasks[i].ulRunTimeCounter;
+		}
+		runtimeCpu[i] = (elapsed == 0) ? 0 : (uint16_t)(((uint64_t) used * 1000) / elapsed);
+
+		//Insert in runtimeOrder, busiest first
+		for(j = i; j > 0 && runtimeCpu[runtimeOrder[j - 1]] < runtimeCpu[i]; j--)
+		{
+			runtimeOrder[j] = runtimeOrder[j - 1];
+		}
+		runtimeOrder[j] = i;
+	}
+
+	if(view != NULL) view->total = total;
+	return runtimeTaskCount;
+}
+
+/**************************************************************************//**
+* @fn		bool RuntimeStatsGetTask(uint8_t index, RuntimeTaskInfo *info)
+* @brief	Returns one task of the last snapshot
+* @param[in]	index Position of the task, busiest first
+* @param[out]	info Statistics of the task
+* @return	false if index is past the last task
+*****************************************************************************/
+bool RuntimeStatsGetTask(uint8_t index, RuntimeTaskInfo *info)
+{
+	const TaskStatus_t *task;
+
+	if(index >= runtimeTaskCount) return false;
+
+	task = &runtimeTasks[runtimeOrder[index]];
+	info->name = task->pcTaskName;
+	info->number = (uint8_t) task->xTaskNumber;
+	info->priority = (uint8_t) task->uxCurrentPriority;
+	info->state = (task->eCurrentState < sizeof(runtimeStateLetter)) ? runtimeStateLetter[task->eCurrentState] : '?';
+	info->cpuPermille = runtimeCpu[runtimeOrder[index]];
+	info->runTime = task->ulRunTimeCounter;
+	info->stackFreeWords = task->usStackHighWaterMark;
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		void RuntimeStatsGetHeap(RuntimeHeapInfo *heap)
+* @brief	Returns the use of the FreeRTOS and of the C library heaps
+* @param[out]	heap Heap use
+*****************************************************************************/
+void RuntimeStatsGetHeap(RuntimeHeapInfo *heap)
+{
+	struct mallinfo libcHeap = mallinfo();
+
+	heap->rtosTotal = configTOTAL_HEAP_SIZE;
+	heap->rtosFree = xPortGetFreeHeapSize();
+	heap->libcUsed = libcHeap.uordblks;
+}
+
+/**************************************************************************//**
+* @fn		void RuntimeStatsSetDumpPeriod(uint32_t periodMs)
+* @brief	Sets how often RuntimeStatsDumpIfDue() writes the statistics to the console
+* @param[in]	periodMs Time between two dumps, in ms. 0 turns the dump off
+*****************************************************************************/
+void RuntimeStatsSetDumpPeriod(uint32_t periodMs)
+{
+	runtimeDumpPeriod = pdMS_TO_TICKS(periodMs);
+	runtimeDumpLast = xTaskGetTickCount();
+	RuntimeStatsSnapshot(&runtimeDumpView); //The first dump covers one full period
+}
+
+/**************************************************************************//**
+* @fn		void RuntimeStatsDumpIfDue(void)
+* @brief	Writes the statistics to the console in a machine readable form, if the dump period has elapsed
+* @details	One line per dump, then one line per task:
+*			$RTS,<tick>,<run time counter>,<counter Hz>,<rtos heap free>,<libc heap used>,<tasks>
+*			$RTT,<number>,<name>,<state>,<priority>,<cpu 1/1000>,<run time>,<stack free words>
+*			CPU shares are since the previous dump. Called from the CLI task loop.
+*****************************************************************************/
+void RuntimeStatsDumpIfDue(void)
+{
+	TickType_t now = xTaskGetTickCount();
+	RuntimeHeapInfo heap;
+	RuntimeTaskInfo task;
+	uint8_t count;
+
+	if(runtimeDumpPeriod == 0 || (now - runtimeDumpLast) < runtimeDumpPeriod) return;
+	runtimeDumpLast = now;
+
+	count = RuntimeStatsSnapshot(&runtimeDumpView);
+	RuntimeStatsGetHeap(&heap);
+	snprintf(runtimeDumpLine, sizeof(runtimeDumpLine), "$RTS,%lu,%lu,%lu,%lu,%lu,%u\r\n", (uint32_t) now, runtimeDumpView.total,
+		RUNTIME_STATS_HZ, heap.rtosFree, heap.libcUsed, count);
+	SerialConsoleWriteString(runtimeDumpLine);
+
+	for(uint8_t i = 0; RuntimeStatsGetTask(i, &task); i++)
+	{
+		snprintf(runtimeDumpLine, sizeof(runtimeDumpLine), "$RTT,%u,%s,%c,%u,%u,%lu,%u\r\n", task.number, task.name, task.state,
+			task.priority, task.cpuPermille, task.runTime, task.stackFreeWords);
+		SerialConsoleWriteString(runtimeDumpLine);
+	}
+}
+
+/**************************************************************************//**
+* @fn		TickType_t RuntimeStatsGetDumpWait(void)
+* @brief	Returns how long the CLI task may block before RuntimeStatsDumpIfDue() has to be called
+* @return	Ticks until the next dump, portMAX_DELAY if the dump is off
+*****************************************************************************/
+TickType_t RuntimeStatsGetDumpWait(void)
+{
+	TickType_t elapsed = xTaskGetTickCount() - runtimeDumpLast;
+
+	if(runtimeDumpPeriod == 0) return portMAX_DELAY;
+	return (elapsed >= runtimeDumpPeriod) ? 0 : runtimeDumpPeriod - elapsed;
+}
@@ -0,0 +1,83 @@
+/**************************************************************************//**
+* @file      RuntimeStats.h
+* @brief     FreeRTOS run time statistics: per task CPU use, stack high water marks and heap use.
+The run time counter is a TC clocked from the 32 kHz ULP generator, extended to 32 bits in its overflow interrupt.
+It keeps counting while the MCU sleeps, so the time spent in tickless idle is charged to the idle task. One count is
+about 30 us, 32 times finer than the tick. The counter wraps after about 36 hours; CPU shares are computed on
+differences, so the wrap does not matter as long as two snapshots are less than that apart.
+The snapshot, the CLI commands and the periodic dump all run in the CLI task.
+
+******************************************************************************/
+
+
+#ifndef RUNTIME_STATS_H
+#define RUNTIME_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "asf.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define RUNTIME_STATS_TIMER_MODULE		TC4					///<TC that counts the run time. Shares its GCLK channel with TC5
+#define RUNTIME_STATS_TIMER_CLOCK		GCLK_GENERATOR_2	///<ULP 32 kHz generator. Must match POWER_TIMER_CLOCK, TC4 and TC5 share a GCLK channel
+#define RUNTIME_STATS_HZ				32768UL				///<Run time counter rate
+#define RUNTIME_STATS_MAX_TASKS			12					///<Maximum number of tasks in a snapshot
+#define RUNTIME_STATS_DUMP_LINE_LEN		96					///<Longest line of the periodic dump
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Statistics of one task in a snapshot
+typedef struct RuntimeTaskInfo
+{
+	const char *name;			///<Task name
+	uint8_t number;				///<Task number, in creation order
+	uint8_t priority;			///<Current priority, inherited priority included
+	char state;					///<X running, R ready, B blocked, S suspended, D deleted
+	uint16_t cpuPermille;		///<Share of the CPU since the previous snapshot of the same view, in 1/1000
+	uint32_t runTime;			///<Run time since boot, in counter ticks
+	uint16_t stackFreeWords;	///<Least stack space the task ever had left, in words
+} RuntimeTaskInfo;
+
+//Run time of every task at the previous snapshot. Each consumer of CPU shares keeps its own
+typedef struct RuntimeStatsView
+{
+	uint32_t total;										///<Run time counter at the previous snapshot
+	uint32_t runTime[RUNTIME_STATS_MAX_TASKS + 1];		///<Run time of each task at the previous snapshot, indexed by task number
+} RuntimeStatsView;
+
+//Heap use
+typedef struct RuntimeHeapInfo
+{
+	uint32_t rtosTotal;			///<Size of the FreeRTOS heap
+	uint32_t rtosFree;			///<FreeRTOS heap left. heap_1 never frees, so this is also the minimum ever
+	uint32_t libcUsed;			///<Bytes allocated from the C library heap
+} RuntimeHeapInfo;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+void RuntimeStatsInit(void);
+uint32_t RuntimeStatsGetCounter(void);
+uint8_t RuntimeStatsSnapshot(RuntimeStatsView *view);
+bool RuntimeStatsGetTask(uint8_t index, RuntimeTaskInfo *info);
+void RuntimeStatsGetHeap(RuntimeHeapInfo *heap);
+void RuntimeStatsSetDumpPeriod(uint32_t periodMs);
+void RuntimeStatsDumpIfDue(void);
+TickType_t RuntimeStatsGetDumpWait(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*RUNTIME_STATS_H*/
@@ -14,6 +14,10 @@
 
 
 #define NEO_TRELLIS_ADDR 0x2E
+#define SEESAW_INT_PIN			EXT1_IRQ_PIN		///<Seesaw INT line, on the EXT1 IRQ pin. Low while the keypad FIFO has events.
+#define SEESAW_INT_MUX			EXT1_IRQ_MUX		///<EIC function of the INT pin
+#define SEESAW_INT_EIC_LINE		EXT1_IRQ_INPUT		///<EXTINT channel of the INT pin
+#define SEESAW_KEYPAD_NOTIFY_BIT	(1UL << 0)		///<Task notification bit set when the keypad has events
 
 #define NEO_TRELLIS_NEOPIX_PIN 3
 
@@ -269,6 +273,12 @@ union keyState {
 int InitializeSeesaw(void);
 uint8_t SeesawGetKeypadCount(void);
 int32_t SeesawReadKeypad(uint8_t *buffer, uint8_t count);
+bool SeesawKeypadHasEvents(void);
+void SeesawKeypadSetNotifyTask(TaskHandle_t task);
+int32_t SeesawKeypadDrain(uint8_t *buffer, uint8_t maxEvents, uint8_t *count);
 int32_t SeesawSetLed(uint8_t key, uint8_t red, uint8_t green, uint8_t blue);
 int32_t SeesawOrderLedUpdate(void);
+void SeesawFrameSetLed(uint8_t key, uint8_t red, uint8_t green, uint8_t blue);
+void SeesawFrameFill(uint8_t red, uint8_t green, uint8_t blue);
+int32_t SeesawFrameFlush(void);
 #endif
\ No newline at end of file
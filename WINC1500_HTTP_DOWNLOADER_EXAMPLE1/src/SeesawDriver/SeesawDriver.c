@@ -8,6 +8,7 @@
 
 ******************************************************************************/
 
+#include <string.h>
 #include "Seesaw.h"
 #include "I2cDriver/I2cDriver.h"
 #include "SerialConsole.h"
@@ -19,11 +20,21 @@
 /******************************************************************************
 * Defines
 ******************************************************************************/
+#define SEESAW_FRAME_SIZE			(NEO_TRELLIS_NUM_KEYS * 3)	///<Bytes in the Neopixel buffer of the Seesaw (GRB per key)
+#define SEESAW_NEOPIXEL_HEADER		4	///<Bytes of a SEESAW_NEOPIXEL_BUF write before the pixel data (base, function, offset)
+#define SEESAW_I2C_MAX_WRITE		32	///<Largest I2C write the Seesaw firmware accepts
+#define SEESAW_NEOPIXEL_MAX_DATA	(SEESAW_I2C_MAX_WRITE - SEESAW_NEOPIXEL_HEADER)	///<Maximum pixel bytes per SEESAW_NEOPIXEL_BUF write
+#define SEESAW_FLUSH_MERGE_GAP		SEESAW_NEOPIXEL_HEADER	///<Clean bytes between two dirty ranges that are cheaper to resend than to open a new write
+#define SEESAW_I2C_TIMEOUT			100		///<Ticks to wait for a Seesaw request to be done
+#define SEESAW_READ_DELAY			2		///<Ticks between the register write and the read, so the Seesaw has its answer ready (it needs up to 1 ms). vTaskDelay(2) sleeps at least one full tick.
+#define SEESAW_LOCK_WAIT			WAIT_I2C_LINE_MS	///<Ticks to wait for the I2C mutex while another task talks to the Seesaw
 
 /******************************************************************************
 * Variables
 ******************************************************************************/
-I2C_Data seesawData; ///<Global variable to use for I2C communications with the Seesaw Device
+static uint8_t seesawFrame[SEESAW_FRAME_SIZE];						///<Local copy of the Seesaw Neopixel buffer, in GRB order
+static uint8_t seesawFrameDirty[(SEESAW_FRAME_SIZE + 7) / 8];		///<One bit per byte of seesawFrame that the Seesaw does not have yet
+static volatile TaskHandle_t seesawKeypadTask = NULL;				///<Task notified with SEESAW_KEYPAD_NOTIFY_BIT when the keypad has events
 /******************************************************************************
 * Forward Declarations
 ******************************************************************************/
@@ -41,6 +52,15 @@ const uint8_t msgKeypadGetCount[2] = {SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_COUNT};
 
 static void SeesawTurnOnLedTest(void);
 static void SeesawInitializeKeypad(void);
+static void SeesawConfigureKeypadInterrupt(void);
+static void SeesawKeypadIntCallback(void);
+static void SeesawFrameWriteByte(uint8_t index, uint8_t value);
+static bool SeesawFrameIsDirty(const uint8_t *dirty, uint8_t index);
+static int32_t SeesawFrameWriteRange(const uint8_t *frame, uint8_t start, uint8_t length);
+static int32_t SeesawWrite(const uint8_t *msg, uint16_t length);
+static int32_t SeesawRead(const uint8_t *cmd, uint16_t cmdLength, uint8_t *buffer, uint16_t length);
+static uint8_t SeesawGetKeypadCountLocked(void);
+static int32_t SeesawReadKeypadLocked(uint8_t *buffer, uint8_t count);
 /******************************************************************************
 * Functions
 ******************************************************************************/
@@ -56,15 +76,12 @@ static void SeesawInitializeKeypad(void);
 int InitializeSeesaw(void)
 {
 	uint8_t readData[2];
-	seesawData.address = NEO_TRELLIS_ADDR;
-	seesawData.msgOut = &msgBaseGetHWID;
-	seesawData.lenOut = sizeof(msgBaseGetHWID);
-	seesawData.msgIn = &readData;
-	seesawData.lenIn = 1;
+
+	if(ERROR_NONE != I2cGetMutex(SEESAW_LOCK_WAIT)) return ERROR_NOT_READY;
 
 	//Check if device is on the line - it should answer with its HW ID
 
-	int error = I2cReadDataWait(&seesawData, 0, 100);
+	int error = SeesawRead(msgBaseGetHWID, sizeof(msgBaseGetHWID), readData, 1);
 
 	if(ERROR_NONE != error)
 	{
@@ -83,34 +100,26 @@ int InitializeSeesaw(void)
 	}
 
 	//Tell the Seesaw which pins to use
-	seesawData.msgOut = &msgNeopixelPin;
-	seesawData.lenOut = sizeof(msgNeopixelPin);
-
-	error = I2cWriteDataWait(&seesawData, 100);
+	error = SeesawWrite(msgNeopixelPin, sizeof(msgNeopixelPin));
 	if(ERROR_NONE != error)
 	{
 		SerialConsoleWriteString("Could not write Seesaw pin!/r/n");
 	}
 
 	//Set seesaw Neopixel speed
-	seesawData.msgOut = &msgNeopixelSpeed;
-	seesawData.lenOut = sizeof(msgNeopixelSpeed);
-
-	error = I2cWriteDataWait(&seesawData, 100);
+	error = SeesawWrite(msgNeopixelSpeed, sizeof(msgNeopixelSpeed));
 	if(ERROR_NONE != error)
 	{
 		SerialConsoleWriteString("Could not set seesaw Neopixel speed!/r/n");
 	}
 
 	//Set seesaw Neopixel number of devices
-	seesawData.msgOut = &msgNeopixelBufLength;
-	seesawData.lenOut = sizeof(msgNeopixelBufLength);
-
-	error = I2cWriteDataWait(&seesawData, 100);
+	error = SeesawWrite(msgNeopixelBufLength, sizeof(msgNeopixelBufLength));
 	if(ERROR_NONE != error)
 	{
 		SerialConsoleWriteString("Could not set seesaw Neopixel number of devices/r/n");
 	}
+	I2cFreeMutex();
 
 	SeesawTurnOnLedTest();
 
@@ -126,25 +135,69 @@ int InitializeSeesaw(void)
 * @details 	Assumes Seesaw is already initialized
                 				
 * @return		Returns the number of events in the buffer. Use SeesawReadKeypad to read these events.
-* @note         
+* @note         Another task can read the events between this call and SeesawReadKeypad. Use SeesawKeypadDrain to do both at once.
 *****************************************************************************/
 uint8_t SeesawGetKeypadCount(void) {
 	uint8_t count = 0;
-	seesawData.address = NEO_TRELLIS_ADDR;
-	seesawData.msgOut = &msgKeypadGetCount;
-	seesawData.lenOut = sizeof(msgKeypadGetCount);
-	seesawData.msgIn = &count;
-	seesawData.lenIn = 1;
 
-	int error = I2cReadDataWait(&seesawData, 0, 100);
-
-	if(ERROR_NONE != error)
+	if(ERROR_NONE == I2cGetMutex(SEESAW_LOCK_WAIT))
 	{
-		SerialConsoleWriteString("Error reading Seesaw counts!/r/n");
+		count = SeesawGetKeypadCountLocked();
+		I2cFreeMutex();
 	}
 	return count;
 }
 
+/**************************************************************************//**
+* @fn		bool SeesawKeypadHasEvents(void)
+* @brief	Returns true if the keypad FIFO of the Seesaw has events
+* @details 	Reads the level of the Seesaw INT line, which stays low while the FIFO is not empty. No I2C traffic.
+* @return		true if there are events to read with SeesawKeypadDrain
+*****************************************************************************/
+bool SeesawKeypadHasEvents(void)
+{
+	return !port_pin_get_input_level(SEESAW_INT_PIN);
+}
+
+/**************************************************************************//**
+* @fn		void SeesawKeypadSetNotifyTask(TaskHandle_t task)
+* @brief	Registers the task that is woken up when a key is pressed or released
+* @param[in]	task Task to notify with SEESAW_KEYPAD_NOTIFY_BIT. NULL to stop notifications.
+*****************************************************************************/
+void SeesawKeypadSetNotifyTask(TaskHandle_t task)
+{
+	seesawKeypadTask = task;
+}
+
+/**************************************************************************//**
+* @fn		int32_t SeesawKeypadDrain(uint8_t *buffer, uint8_t maxEvents, uint8_t *count)
+* @brief	Reads all pending keypad events (up to maxEvents) from the Seesaw FIFO
+* @param[out] buffer Buffer for the events. Must hold maxEvents bytes.
+* @param[in]  maxEvents Maximum number of events to read
+* @param[out] count Number of events read
+* @return		Returns zero if no I2C errors occurred. Other number in case of error
+* @note         Events that did not fit stay in the FIFO and keep the INT line low, see SeesawKeypadHasEvents.
+*****************************************************************************/
+int32_t SeesawKeypadDrain(uint8_t *buffer, uint8_t maxEvents, uint8_t *count)
+{
+	*count = 0;
+
+	//Count and read under the same lock, so another task cannot take the events in between
+	int32_t error = I2cGetMutex(SEESAW_LOCK_WAIT);
+	if(ERROR_NONE != error) return error;
+
+	uint8_t events = SeesawGetKeypadCountLocked();
+	if(events > maxEvents) events = maxEvents;
+
+	error = SeesawReadKeypadLocked(buffer, events);
+	I2cFreeMutex();
+	if(ERROR_NONE == error)
+	{
+		*count = events;
+	}
+	return error;
+}
+
 /**************************************************************************//**
 * @fn		int32_t SeesawReadKeypad(uint8_t *buffer, uint8_t count)
 * @brief	Returns the number of requested events in the Seesaw FIFO buffer into the buffer variable
@@ -157,19 +210,12 @@ uint8_t SeesawGetKeypadCount(void) {
 int32_t SeesawReadKeypad(uint8_t *buffer, uint8_t count)
 	{
 	if (count == 0) return ERROR_NONE;
-	uint8_t cmd[] = {SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_FIFO};
-	seesawData.address = NEO_TRELLIS_ADDR;
-	seesawData.msgOut = &cmd;
-	seesawData.lenOut = sizeof(cmd);
-	seesawData.msgIn = buffer;
-	seesawData.lenIn = count;
 
-	int error = I2cReadDataWait(&seesawData, 0, 100);
+	int32_t error = I2cGetMutex(SEESAW_LOCK_WAIT);
+	if(ERROR_NONE != error) return error;
 
-	if(ERROR_NONE != error)
-	{
-		SerialConsoleWriteString("Error reading Seesaw counts!/r/n");
-	}
+	error = SeesawReadKeypadLocked(buffer, count);
+	I2cFreeMutex();
 	return error;
 }
 
@@ -191,41 +237,32 @@ int32_t SeesawActivateKey(uint8_t key, uint8_t edge, bool enable)
 	ks.bit.ACTIVE = (1 << edge);
 	uint8_t cmd[] = {SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_EVENT, key, ks.reg};
 
-	seesawData.address = NEO_TRELLIS_ADDR;
-	seesawData.msgOut = &cmd;
-	seesawData.lenOut = sizeof(cmd);
-	seesawData.lenIn = 0;
-	int32_t error = I2cWriteDataWait(&seesawData, 100);
+	int32_t error = I2cGetMutex(SEESAW_LOCK_WAIT);
+	if(ERROR_NONE != error) return error;
+
+	error = SeesawWrite(cmd, sizeof(cmd));
+	I2cFreeMutex();
 	return error;
 }
 
 
 /**************************************************************************//**
 int32_t SeesawSetLed(uint8_t key, uint8_t red, uint8_t green, uint8_t blue)
-* @brief	Turns on a given LED with the given RGB colors.
+* @brief	Sets a given LED to the given RGB colors.
 * @param[in] key  Key number (0 to 15)
 * @param[in] red Red color. 0 to 255.
 * @param[in] green Red color. 0 to 255.
 * @param[in] blue Red color. 0 to 255.
                 				
-* @return		Returns zero if no I2C errors occurred. Other number in case of error
-* @note         Note that the LEDs wont turn on until you send a "SeesawOrderLedUpdate" command.
+* @return		Returns zero. Kept for compatibility, the I2C traffic happens in SeesawOrderLedUpdate.
+* @note         Note that the LEDs wont turn on until you send a "SeesawOrderLedUpdate" command. The color is only stored in the
+				local frame buffer (see SeesawFrameSetLed), so setting many LEDs before an update costs no extra I2C writes.
 	FOR ESE516 Board, please do not turn ALL the LEDs to maximum brightness (255,255,255)!
 *****************************************************************************/
 int32_t SeesawSetLed(uint8_t key, uint8_t red, uint8_t green, uint8_t blue)
 {
-	uint8_t write_buffer1[7] = {SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_BUF, 0, 0, green,red, blue};
-	uint8_t orderBuffer[2] = {SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_SHOW};
-
-	uint16_t offset = 3 * key; //RGB LED
-	write_buffer1[2] = (offset >> 8);
-	write_buffer1[3] = (offset);
-
-	seesawData.msgOut = &write_buffer1;
-	seesawData.lenOut = sizeof(write_buffer1);
-	int error = I2cWriteDataWait(&seesawData, 100);
-	return error;
-
+	SeesawFrameSetLed(key, red, green, blue);
+	return ERROR_NONE;
 }
 
 
@@ -239,11 +276,247 @@ int32_t SeesawOrderLedUpdate(void)
 *****************************************************************************/
 int32_t SeesawOrderLedUpdate(void)
 {
+	return SeesawFrameFlush();
+}
+
+
+/**************************************************************************//**
+void SeesawFrameSetLed(uint8_t key, uint8_t red, uint8_t green, uint8_t blue)
+* @brief	Sets the color of a key in the local frame buffer
+* @param[in] key  Key number (0 to 15)
+* @param[in] red Red color. 0 to 255.
+* @param[in] green Green color. 0 to 255.
+* @param[in] blue Blue color. 0 to 255.
+* @note         Only the bytes that change are marked dirty. Call SeesawFrameFlush to send them to the Seesaw.
+*****************************************************************************/
+void SeesawFrameSetLed(uint8_t key, uint8_t red, uint8_t green, uint8_t blue)
+{
+	if(key >= NEO_TRELLIS_NUM_KEYS) return;
+
+	uint8_t offset = 3 * key; //GRB LED
+	taskENTER_CRITICAL();
+	SeesawFrameWriteByte(offset, green);
+	SeesawFrameWriteByte(offset + 1, red);
+	SeesawFrameWriteByte(offset + 2, blue);
+	taskEXIT_CRITICAL();
+}
+
+
+/**************************************************************************//**
+void SeesawFrameFill(uint8_t red, uint8_t green, uint8_t blue)
+* @brief	Sets the color of every key in the local frame buffer
+* @param[in] red Red color. 0 to 255.
+* @param[in] green Green color. 0 to 255.
+* @param[in] blue Blue color. 0 to 255.
+* @note         FOR ESE516 Board, please do not turn ALL the LEDs to maximum brightness (255,255,255)!
+*****************************************************************************/
+void SeesawFrameFill(uint8_t red, uint8_t green, uint8_t blue)
+{
+	for(uint8_t key = 0; key < NEO_TRELLIS_NUM_KEYS; key++){
+		SeesawFrameSetLed(key, red, green, blue);
+	}
+}
+
+
+/**************************************************************************//**
+int32_t SeesawFrameFlush(void)
+* @brief	Sends the dirty part of the frame buffer to the Seesaw and shows it
+* @details	Dirty bytes are grouped in contiguous ranges. Ranges separated by less than SEESAW_FLUSH_MERGE_GAP clean bytes are
+			merged, since resending a few bytes is cheaper than the header of a new write. Each range is written in as few
+			SEESAW_NEOPIXEL_BUF writes as the Seesaw write limit allows, followed by a single SHOW.
+			A full 16 key frame costs 3 writes (58 bytes) instead of 16 + 16 writes (144 bytes).
+			The writes and the SHOW are done under the I2C mutex, so flushes of different tasks do not interleave.
+* @return		Returns zero if no I2C errors occurred. Other number in case of error. Bytes that could not be written stay dirty.
+*****************************************************************************/
+int32_t SeesawFrameFlush(void)
+{
+	uint8_t frame[SEESAW_FRAME_SIZE];
+	uint8_t dirty[sizeof(seesawFrameDirty)];
 	uint8_t orderBuffer[2] = {SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_SHOW};
+	int32_t error = ERROR_NONE;
+	bool written = false;
+
+	error = I2cGetMutex(SEESAW_LOCK_WAIT);
+	if(ERROR_NONE != error) return error;
+
+	//Snapshot the frame so other tasks can keep drawing while it is sent
+	taskENTER_CRITICAL();
+	memcpy(frame, seesawFrame, sizeof(frame));
+	memcpy(dirty, seesawFrameDirty, sizeof(dirty));
+	memset(seesawFrameDirty, 0, sizeof(seesawFrameDirty));
+	taskEXIT_CRITICAL();
+
+	uint8_t index = 0;
+	while(index < SEESAW_FRAME_SIZE){
+		if(!SeesawFrameIsDirty(dirty, index)){
+			index++;
+			continue;
+		}
+
+		//Grow the range while the next dirty byte is close enough to be worth resending the gap
+		uint8_t start = index;
+		uint8_t end = index + 1;
+		for(uint8_t next = end; next < SEESAW_FRAME_SIZE && (next - end) <= SEESAW_FLUSH_MERGE_GAP; next++){
+			if(SeesawFrameIsDirty(dirty, next)) end = next + 1;
+		}
+
+		for(uint8_t chunk = start; chunk < end; chunk += SEESAW_NEOPIXEL_MAX_DATA){
+			uint8_t length = end - chunk;
+			if(length > SEESAW_NEOPIXEL_MAX_DATA) length = SEESAW_NEOPIXEL_MAX_DATA;
+
+			int32_t chunkError = SeesawFrameWriteRange(frame, chunk, length);
+			if(ERROR_NONE != chunkError){
+				error = chunkError;
+				//Resend it on the next flush
+				taskENTER_CRITICAL();
+				for(uint8_t i = chunk; i < chunk + length; i++){
+					seesawFrameDirty[i / 8] |= (1 << (i % 8));
+				}
+				taskEXIT_CRITICAL();
+			}else{
+				written = true;
+			}
+		}
+		index = end;
+	}
+
+	if(!written && ERROR_NONE == error){
+		I2cFreeMutex();
+		return ERROR_NONE;
+	}
+
+	int32_t showError = SeesawWrite(orderBuffer, sizeof(orderBuffer));
+	I2cFreeMutex();
+	return (ERROR_NONE != error) ? error : showError;
+}
+
+
+/**************************************************************************//**
+* @fn		static void SeesawFrameWriteByte(uint8_t index, uint8_t value)
+* @brief	Writes a byte of the frame buffer and marks it dirty if it changed
+* @note		Called with interrupts masked
+*****************************************************************************/
+static void SeesawFrameWriteByte(uint8_t index, uint8_t value)
+{
+	if(seesawFrame[index] != value){
+		seesawFrame[index] = value;
+		seesawFrameDirty[index / 8] |= (1 << (index % 8));
+	}
+}
+
+
+/**************************************************************************//**
+* @fn		static bool SeesawFrameIsDirty(const uint8_t *dirty, uint8_t index)
+* @brief	Returns true if the byte of the frame buffer is marked in the dirty bitmap
+*****************************************************************************/
+static bool SeesawFrameIsDirty(const uint8_t *dirty, uint8_t index)
+{
+	return (dirty[index / 8] & (1 << (index % 8))) != 0;
+}
+
+
+/**************************************************************************//**
+* @fn		static int32_t SeesawFrameWriteRange(const uint8_t *frame, uint8_t start, uint8_t length)
+* @brief	Writes a range of the frame buffer into the Seesaw Neopixel buffer with a single I2C write
+* @param[in] frame Frame buffer
+* @param[in] start First byte to write
+* @param[in] length Number of bytes to write. At most SEESAW_NEOPIXEL_MAX_DATA.
+* @return		Returns zero if no I2C errors occurred. Other number in case of error
+*****************************************************************************/
+static int32_t SeesawFrameWriteRange(const uint8_t *frame, uint8_t start, uint8_t length)
+{
+	uint8_t writeBuffer[SEESAW_I2C_MAX_WRITE] = {SEESAW_NEOPIXEL_BASE, SEESAW_NEOPIXEL_BUF, 0, 0};
+
+	writeBuffer[2] = 0; //Offset high byte, the frame is shorter than 256 bytes
+	writeBuffer[3] = start;
+	memcpy(&writeBuffer[SEESAW_NEOPIXEL_HEADER], &frame[start], length);
+
+	return SeesawWrite(writeBuffer, SEESAW_NEOPIXEL_HEADER + length);
+}
+
+
+/**************************************************************************//**
+* @fn		static int32_t SeesawWrite(const uint8_t *msg, uint16_t length)
+* @brief	Writes a command to the Seesaw
+* @details	The request is described on the stack of the caller, so calls from different tasks never share an I2C_Data that
+			the interrupt may still be using.
+* @param[in] msg Command and data
+* @param[in] length Number of bytes of msg
+* @return		Returns zero if no I2C errors occurred. Other number in case of error
+* @note		Call with the I2C mutex held (I2cGetMutex)
+*****************************************************************************/
+static int32_t SeesawWrite(const uint8_t *msg, uint16_t length)
+{
+	I2C_Data data = {0};
+
+	data.address = NEO_TRELLIS_ADDR;
+	data.priority = I2C_PRIORITY_UI;
+	data.speed = I2C_SPEED_STANDARD;
+	data.msgOut = msg;
+	data.lenOut = length;
+	return I2cWriteDataWait(&data, SEESAW_I2C_TIMEOUT);
+}
 
-	seesawData.msgOut = &orderBuffer;
-	seesawData.lenOut = sizeof(orderBuffer);
-	int error = I2cWriteDataWait(&seesawData, 100);
+
+/**************************************************************************//**
+* @fn		static int32_t SeesawRead(const uint8_t *cmd, uint16_t cmdLength, uint8_t *buffer, uint16_t length)
+* @brief	Writes a register address to the Seesaw, then reads its answer after a STOP
+* @details	The Seesaw firmware prepares the answer after the STOP of the write, and does not stretch the clock while it
+			does. The read is therefore sent SEESAW_READ_DELAY ticks later, never chained straight after the write.
+* @param[in] cmd Module base and function of the register
+* @param[in] cmdLength Number of bytes of cmd
+* @param[out] buffer Answer of the Seesaw
+* @param[in] length Number of bytes to read
+* @return		Returns zero if no I2C errors occurred. Other number in case of error
+* @note		Call with the I2C mutex held (I2cGetMutex)
+*****************************************************************************/
+static int32_t SeesawRead(const uint8_t *cmd, uint16_t cmdLength, uint8_t *buffer, uint16_t length)
+{
+	I2C_Data data = {0};
+
+	data.address = NEO_TRELLIS_ADDR;
+	data.priority = I2C_PRIORITY_UI;
+	data.speed = I2C_SPEED_STANDARD;
+	data.msgOut = cmd;
+	data.lenOut = cmdLength;
+	data.msgIn = buffer;
+	data.lenIn = length;
+	return I2cReadDataWait(&data, SEESAW_READ_DELAY, SEESAW_I2C_TIMEOUT);
+}
+
+
+/**************************************************************************//**
+* @fn		static uint8_t SeesawGetKeypadCountLocked(void)
+* @brief	SeesawGetKeypadCount, for callers that already hold the I2C mutex
+*****************************************************************************/
+static uint8_t SeesawGetKeypadCountLocked(void)
+{
+	uint8_t count = 0;
+
+	if(ERROR_NONE != SeesawRead(msgKeypadGetCount, sizeof(msgKeypadGetCount), &count, 1))
+	{
+		SerialConsoleWriteString("Error reading Seesaw counts!/r/n");
+		count = 0;
+	}
+	return count;
+}
+
+
+/**************************************************************************//**
+* @fn		static int32_t SeesawReadKeypadLocked(uint8_t *buffer, uint8_t count)
+* @brief	SeesawReadKeypad, for callers that already hold the I2C mutex
+*****************************************************************************/
+static int32_t SeesawReadKeypadLocked(uint8_t *buffer, uint8_t count)
+{
+	const uint8_t cmd[] = {SEESAW_KEYPAD_BASE, SEESAW_KEYPAD_FIFO};
+
+	if(count == 0) return ERROR_NONE;
+
+	int32_t error = SeesawRead(cmd, sizeof(cmd), buffer, count);
+	if(ERROR_NONE != error)
+	{
+		SerialConsoleWriteString("Error reading Seesaw counts!/r/n");
+	}
 	return error;
 }
 
@@ -257,12 +530,12 @@ int32_t SeesawOrderLedUpdate(void)
 ****************************************************************************************/
 static void SeesawInitializeKeypad(void)
 {
-	seesawData.address = NEO_TRELLIS_ADDR;
-	seesawData.msgOut = &msgKeypadEnableInt;
-	seesawData.lenOut = sizeof(msgKeypadEnableInt);
-	seesawData.lenIn = 0;
-
-	int32_t error = I2cWriteDataWait(&seesawData, 100);
+	int32_t error = I2cGetMutex(SEESAW_LOCK_WAIT);
+	if(ERROR_NONE == error)
+	{
+		error = SeesawWrite(msgKeypadEnableInt, sizeof(msgKeypadEnableInt));
+		I2cFreeMutex();
+	}
 	if(ERROR_NONE != error)
 	{
 		SerialConsoleWriteString("Could not initialize Keypad!/r/n");
@@ -277,6 +550,43 @@ static void SeesawInitializeKeypad(void)
 			SerialConsoleWriteString("Could not initialize Keypad!/r/n");
 		}
 	}
+
+	SeesawConfigureKeypadInterrupt();
+}
+
+
+/*****************************************************************************************
+*  @brief     Routes the Seesaw INT line to an EXTINT channel
+*  @details   The Seesaw pulls INT low when a key event enters its FIFO, and releases it once the FIFO is read empty.
+****************************************************************************************/
+static void SeesawConfigureKeypadInterrupt(void)
+{
+	struct extint_chan_conf configExtintChan;
+	extint_chan_get_config_defaults(&configExtintChan);
+	configExtintChan.gpio_pin           = SEESAW_INT_PIN;
+	configExtintChan.gpio_pin_mux       = SEESAW_INT_MUX;
+	configExtintChan.gpio_pin_pull      = EXTINT_PULL_UP;
+	configExtintChan.detection_criteria = EXTINT_DETECT_FALLING;
+	extint_chan_set_config(SEESAW_INT_EIC_LINE, &configExtintChan);
+
+	extint_register_callback(SeesawKeypadIntCallback, SEESAW_INT_EIC_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+	extint_chan_enable_callback(SEESAW_INT_EIC_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+}
+
+
+/*****************************************************************************************
+*  @brief     EXTINT callback of the Seesaw INT line. Wakes up the registered task.
+****************************************************************************************/
+static void SeesawKeypadIntCallback(void)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	TaskHandle_t task = seesawKeypadTask;
+
+	if(task != NULL)
+	{
+		xTaskNotifyFromISR(task, SEESAW_KEYPAD_NOTIFY_BIT, eSetBits, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
 }
 
 
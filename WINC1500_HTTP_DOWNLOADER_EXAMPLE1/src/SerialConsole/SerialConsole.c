@@ -25,19 +25,28 @@
 * Includes
 ******************************************************************************/
 #include "SerialConsole.h"
+#include "MemPool/MemPool.h"
+#include "stream_buffer.h"
 
 /******************************************************************************
 * Defines
 ******************************************************************************/
-#define RX_BUFFER_SIZE 256	///<Size of character buffer for RX, in bytes
+#define RX_BUFFER_SIZE 512	///<Size of the RX stream buffer, in bytes
+#define RX_XOFF_SPACE 128	///<XOFF is sent when less than this many bytes are free in the RX stream buffer
+#define RX_XON_LEVEL 64		///<XON is sent once the reader has brought the RX stream buffer below this many bytes
+#define ASCII_XON 0x11		///<Resume sending (DC1)
+#define ASCII_XOFF 0x13		///<Stop sending (DC3)
 #define TX_BUFFER_SIZE 512	///<Size of character buffers for TX, in bytes
+#define TX_WRITE_TIMEOUT_MS 50	///<Longest wait of SerialConsoleWriteString() for room in the TX ring buffer. A full buffer drains in 45 ms
+#define LOG_RECORD_SIZE 128	///<Longest log message, terminator included
+#define LOG_RECORD_COUNT 4	///<Log messages that can be formatted at the same time, by different tasks
 
-char debugBuffer[128];
+MEM_POOL_DEFINE(logRecordPool, "log", LOG_RECORD_SIZE, LOG_RECORD_COUNT); ///<Each LogMessage() call formats into its own record
 
 /******************************************************************************
 * Structures and Enumerations
 ******************************************************************************/
-cbuf_handle_t cbufRx;	///<Circular buffer handler for receiving characters from the Serial Interface
+StreamBufferHandle_t xStreamRx;	///<Stream buffer for receiving characters from the Serial Interface. Written by the RX callback, read by the CLI task
 cbuf_handle_t cbufTx;	///<Circular buffer handler for transmitting characters from the Serial Interface
 
 char latestRx;	///< Holds the latest character that was received
@@ -54,12 +63,20 @@ void usart_read_callback(struct usart_module *const usart_module);	//Callback fo
 ******************************************************************************/
 static void configure_usart(void);
 static void configure_usart_callbacks(void);
+static void SerialConsoleSendFlowControl(uint8_t flowChar);
+static void SerialConsoleStartTx(void);
+static bool SerialConsoleQueue(const uint8_t *data, size_t len, TickType_t timeout);
 
 /******************************************************************************
 * Global Local Variables
 ******************************************************************************/
 struct usart_module usart_instance;
-char rxCharacterBuffer[RX_BUFFER_SIZE]; ///<Buffer to store received characters
+static uint8_t rxStreamStorage[RX_BUFFER_SIZE + 1]; ///<Storage of the RX stream buffer. A stream buffer keeps one byte unused
+static StaticStreamBuffer_t rxStreamBuffer;
+static volatile uint8_t txFlowChar = 0; ///<XON or XOFF waiting to be sent ahead of the TX ring buffer, 0 if none
+static volatile bool rxStopped = false; ///<XOFF was sent and XON was not sent yet
+static SerialConsoleRxStats rxStats; ///<Counters of the RX path
+static uint32_t txDropped = 0; ///<Strings SerialConsoleWriteString() dropped because the TX ring buffer stayed full
 char txCharacterBuffer[TX_BUFFER_SIZE]; ///<Buffer to store characters to be sent
 enum eDebugLogLevels currentDebugLevel = LOG_INFO_LVL; ///<Variable that holds the level of debug log messages to show. Defaults to showing all debug values
 
@@ -81,9 +98,11 @@ enum eDebugLogLevels currentDebugLevel = LOG_INFO_LVL; ///<Variable that holds t
 void InitializeSerialConsole(void)
 {
 
-	//Initialize circular buffers for RX and TX
-	cbufRx = circular_buf_init((uint8_t*)rxCharacterBuffer, RX_BUFFER_SIZE);
-	cbufTx = circular_buf_init((uint8_t*)txCharacterBuffer, RX_BUFFER_SIZE);
+	MemPoolRegister(&logRecordPool);
+
+	//Initialize the RX stream buffer and the TX circular buffer. The CLI task wakes on every received character
+	xStreamRx = xStreamBufferCreateStatic(RX_BUFFER_SIZE, 1, rxStreamStorage, &rxStreamBuffer);
+	cbufTx = circular_buf_init((uint8_t*)txCharacterBuffer, TX_BUFFER_SIZE);
 
 	//Configure USART and Callbacks
 	configure_usart();
@@ -109,44 +128,108 @@ void DeinitializeSerialConsole(void)
 * @fn			void SerialConsoleWriteString(char * string)
 * @brief		Writes a string to be written to the uart. Copies the string to a ring buffer that is used to hold the text send to the uart
 * @details		Uses the ringbuffer 'cbufTx', which in turn uses the array 'txCharacterBuffer'. Modified to be thread safe.
+*				Waits up to TX_WRITE_TIMEOUT_MS for room, then drops the string rather than overwrite text or frames that
+*				are already queued. Before the scheduler runs it does not wait. Dropped strings are counted.
 * @note			Use to send a string of characters to the user via UART
 *****************************************************************************/
 void SerialConsoleWriteString(char * string)
 {
-vTaskSuspendAll();
-	if(string != NULL)
-	{
-		for (size_t iter = 0; iter < strlen(string); iter++)
-		{
-			circular_buf_put(cbufTx, string[iter]);
-		}
+	if(string == NULL) return;
+
+	TickType_t timeout = (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) ? pdMS_TO_TICKS(TX_WRITE_TIMEOUT_MS) : 0;
+	size_t len = strlen(string);
 
-		if(usart_get_job_status(&usart_instance, USART_TRANSCEIVER_TX) == STATUS_OK)
+	while(len > 0)
+	{
+		size_t part = (len < TX_BUFFER_SIZE) ? len : TX_BUFFER_SIZE;
+		if(!SerialConsoleQueue((const uint8_t *) string, part, timeout))
 		{
-			circular_buf_get(cbufTx, (uint8_t*) &latestTx); //Perform only if the SERCOM TX is free (not busy)
-			usart_write_buffer_job(&usart_instance, (uint8_t*) &latestTx, 1);
+			taskENTER_CRITICAL();
+			txDropped++;
+			taskEXIT_CRITICAL();
+			return;
 		}
+		string += part;
+		len -= part;
 	}
-xTaskResumeAll();
+}
+
+/**************************************************************************//**
+* @fn			bool SerialConsoleWriteBuffer(const uint8_t *data, size_t len, TickType_t timeout)
+* @brief		Writes binary data to the uart, all at once
+* @details		Unlike SerialConsoleWriteString(), the data may hold zeros. It is queued whole or not at all, so a
+*				frame is never cut by text written by other tasks.
+* @param[in]	data Bytes to send
+* @param[in]	len Number of bytes, at most the size of the TX ring buffer
+* @param[in]	timeout Longest time to wait for room, in ticks
+* @return		true if the data was queued, false on timeout
+*****************************************************************************/
+bool SerialConsoleWriteBuffer(const uint8_t *data, size_t len, TickType_t timeout)
+{
+	if(len > TX_BUFFER_SIZE) return false;
+	return SerialConsoleQueue(data, len, timeout);
 }
 
 /**************************************************************************//**
 * @fn			int SerialConsoleReadCharacter(uint8_t *rxChar)
-* @brief		Reads a character from the RX ring buffer and stores it on the pointer given as an argument.
+* @brief		Reads a character from the RX stream buffer and stores it on the pointer given as an argument.
 *				Also, returns -1 if there is no characters on the buffer
 *				This buffer has values added to it when the UART receives ASCII characters from the terminal
-* @details		Uses the ringbuffer 'cbufTx', which in turn uses the array 'txCharacterBuffer'
+* @details		Does not block. Only one task may read the console, see SerialConsoleRead().
 * @param[in]	Pointer to a character. This function will return the character from the RX buffer into this pointer
 * @return		Returns -1 if there are no characters in the buffer
 * @note			Use to receive characters from the RX buffer (FIFO)
 *****************************************************************************/
 int SerialConsoleReadCharacter(uint8_t *rxChar)
 {
-	vTaskSuspendAll();
-	int a = circular_buf_get(cbufRx, (uint8_t*) rxChar);
-	xTaskResumeAll();
-	return a;
+	return (SerialConsoleRead(rxChar, 1, 0) == 1) ? 0 : -1;
+}
 
+/**************************************************************************//**
+* @fn			size_t SerialConsoleRead(uint8_t *buffer, size_t len, TickType_t timeout)
+* @brief		Blocks until characters are received, then reads as many as are waiting, up to len
+* @details		The RX callback writes every character into a stream buffer, which wakes the reader. When the stream buffer
+*				is almost full the console sends XOFF to the terminal, and XON once this function has drained it again,
+*				so pasted scripts are not lost while a slow command runs.
+* @param[out]	buffer Characters read
+* @param[in]	len Size of buffer
+* @param[in]	timeout Longest time to wait for the first character, in ticks
+* @return		Number of characters read, 0 on timeout
+* @note			A stream buffer has a single reader: only the CLI task may read the console
+*****************************************************************************/
+size_t SerialConsoleRead(uint8_t *buffer, size_t len, TickType_t timeout)
+{
+	size_t read = xStreamBufferReceive(xStreamRx, buffer, len, timeout);
+
+	if(rxStopped && xStreamBufferBytesAvailable(xStreamRx) < RX_XON_LEVEL)
+	{
+		irqflags_t flags = cpu_irq_save();
+		rxStopped = false;
+		SerialConsoleSendFlowControl(ASCII_XON);
+		cpu_irq_restore(flags);
+	}
+	return read;
+}
+
+/**************************************************************************//**
+* @fn			void SerialConsoleGetRxStats(SerialConsoleRxStats *stats)
+* @brief		Copies the counters of the RX path
+* @param[out]	stats Counters
+*****************************************************************************/
+void SerialConsoleGetRxStats(SerialConsoleRxStats *stats)
+{
+	irqflags_t flags = cpu_irq_save();
+	*stats = rxStats;
+	cpu_irq_restore(flags);
+}
+
+/**************************************************************************//**
+* @fn			uint32_t SerialConsoleGetTxDropped(void)
+* @brief		Number of strings SerialConsoleWriteString() dropped because the TX ring buffer stayed full
+*****************************************************************************/
+uint32_t SerialConsoleGetTxDropped(void)
+{
+	return txDropped;
 }
 
 
@@ -182,18 +265,23 @@ currentDebugLevel = debugLevel;
 
 /**************************************************************************//**
 * @fn			LogMessage (Students to fill out this)
-* @brief
-* @note
+* @brief		Formats a message and writes it to the console if its level is shown
+* @note			The message is formatted in a record of logRecordPool, so tasks can log at the same time.
+*				If every record is in use the message is dropped and counted as a failure of the pool.
 *****************************************************************************/
 void LogMessage(enum eDebugLogLevels level, const char *format, ...)
 {
 
 if(getLogLevel() <= level){
+	char *record = MemPoolAlloc(&logRecordPool);
+	if(record == NULL) return;
+
 	va_list ap;
 	va_start(ap, format);
-	vsnprintf(debugBuffer, 127, format, ap);
-	SerialConsoleWriteString(debugBuffer);
+	vsnprintf(record, LOG_RECORD_SIZE, format, ap);
+	SerialConsoleWriteString(record);
 	va_end(ap);
+	MemPoolFree(&logRecordPool, record);
 }
 };
 
@@ -264,6 +352,80 @@ static void configure_usart_callbacks(void)
 	usart_enable_callback(&usart_instance, USART_CALLBACK_BUFFER_RECEIVED);
 }
 
+/**************************************************************************//**
+* @fn			static void SerialConsoleStartTx(void)
+* @brief		Starts sending the TX ring buffer if the SERCOM TX is idle. The write callback sends the rest
+*****************************************************************************/
+static void SerialConsoleStartTx(void)
+{
+	irqflags_t flags = cpu_irq_save(); //The RX callback may start a job to send XOFF. Also called before the scheduler runs
+	if(usart_get_job_status(&usart_instance, USART_TRANSCEIVER_TX) == STATUS_OK //Perform only if the SERCOM TX is free (not busy)
+		&& circular_buf_get(cbufTx, (uint8_t*) &latestTx) != -1)
+	{
+		usart_write_buffer_job(&usart_instance, (uint8_t*) &latestTx, 1);
+	}
+	cpu_irq_restore(flags);
+}
+
+/**************************************************************************//**
+* @fn			static bool SerialConsoleQueue(const uint8_t *data, size_t len, TickType_t timeout)
+* @brief		Copies data into the TX ring buffer once it has room for all of it, and starts sending
+* @details		Nothing already queued is overwritten, and other tasks cannot write in the middle: the copy runs with
+*				the scheduler suspended. The write callback takes bytes out of the ring from the interrupt, so each
+*				byte goes in with interrupts masked.
+* @param[in]	len Number of bytes, at most TX_BUFFER_SIZE
+* @param[in]	timeout Longest time to wait for room, in ticks
+* @return		true if the data was queued, false on timeout
+*****************************************************************************/
+static bool SerialConsoleQueue(const uint8_t *data, size_t len, TickType_t timeout)
+{
+	TickType_t start = xTaskGetTickCount();
+
+	for(;;)
+	{
+		vTaskSuspendAll();
+		irqflags_t flags = cpu_irq_save();
+		size_t space = TX_BUFFER_SIZE - circular_buf_size(cbufTx);
+		cpu_irq_restore(flags);
+
+		if(space >= len)
+		{
+			for(size_t iter = 0; iter < len; iter++)
+			{
+				flags = cpu_irq_save();
+				circular_buf_put2(cbufTx, data[iter]); //Cannot fail: the room was checked and the callback only frees more
+				cpu_irq_restore(flags);
+			}
+			SerialConsoleStartTx();
+			xTaskResumeAll();
+			return true;
+		}
+		xTaskResumeAll();
+
+		if((xTaskGetTickCount() - start) >= timeout) return false;
+		vTaskDelay(1);
+	}
+}
+
+/**************************************************************************//**
+* @fn			static void SerialConsoleSendFlowControl(uint8_t flowChar)
+* @brief		Sends XON or XOFF ahead of any text waiting in the TX ring buffer
+* @param[in]	flowChar ASCII_XON or ASCII_XOFF
+* @note			Call from the SERCOM interrupt or with interrupts masked
+*****************************************************************************/
+static void SerialConsoleSendFlowControl(uint8_t flowChar)
+{
+	if(usart_get_job_status(&usart_instance, USART_TRANSCEIVER_TX) == STATUS_OK)
+	{
+		latestTx = flowChar;
+		usart_write_buffer_job(&usart_instance, (uint8_t*) &latestTx, 1);
+	}
+	else
+	{
+		txFlowChar = flowChar; //Sent by the write callback when the current character is out
+	}
+}
+
 
 
 
@@ -280,10 +442,22 @@ static void configure_usart_callbacks(void)
 *****************************************************************************/
 void usart_read_callback(struct usart_module *const usart_module)
 {
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
-	circular_buf_put(cbufRx, (uint8_t) latestRx); //Add the latest read character into the RX circular Buffer
+	rxStats.received++;
+	if(xStreamBufferSendFromISR(xStreamRx, (const void *) &latestRx, 1, &xHigherPriorityTaskWoken) != 1) //Add the latest read character into the RX stream buffer
+	{
+		rxStats.dropped++;
+	}
 	usart_read_buffer_job(&usart_instance, (uint8_t*) &latestRx, 1);	//Order the MCU to keep reading
-	
+
+	if(!rxStopped && xStreamBufferSpacesAvailable(xStreamRx) < RX_XOFF_SPACE)
+	{
+		rxStopped = true;
+		rxStats.xoffs++;
+		SerialConsoleSendFlowControl(ASCII_XOFF);
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
 
@@ -294,7 +468,13 @@ void usart_read_callback(struct usart_module *const usart_module)
 *****************************************************************************/
 void usart_write_callback(struct usart_module *const usart_module)
 {
-	if(circular_buf_get(cbufTx, (uint8_t*) &latestTx) != -1) //Only continue if there are more characters to send
+	if(txFlowChar != 0) //XON and XOFF go ahead of the text
+	{
+		latestTx = txFlowChar;
+		txFlowChar = 0;
+		usart_write_buffer_job(&usart_instance, (uint8_t*) &latestTx, 1);
+	}
+	else if(circular_buf_get(cbufTx, (uint8_t*) &latestTx) != -1) //Only continue if there are more characters to send
 	{
 		usart_write_buffer_job(&usart_instance, (uint8_t*) &latestTx, 1);
 	}
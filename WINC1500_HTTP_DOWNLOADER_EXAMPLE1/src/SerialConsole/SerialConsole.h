@@ -51,6 +51,14 @@ enum eDebugLogLevels {
 	N_DEBUG_LEVELS = 6	//Max number of log levels
 };
 
+//Counters of the console RX path
+typedef struct SerialConsoleRxStats
+{
+	uint32_t received;	///<Characters received
+	uint32_t dropped;	///<Characters lost because the RX stream buffer was full
+	uint32_t xoffs;		///<Times XOFF was sent to pause the terminal
+} SerialConsoleRxStats;
+
 
 
 /******************************************************************************
@@ -59,7 +67,11 @@ enum eDebugLogLevels {
 void InitializeSerialConsole(void);
 void DeinitializeSerialConsole(void);
 void SerialConsoleWriteString(char * string);
+bool SerialConsoleWriteBuffer(const uint8_t *data, size_t len, TickType_t timeout);
 int SerialConsoleReadCharacter(uint8_t *rxChar);
+size_t SerialConsoleRead(uint8_t *buffer, size_t len, TickType_t timeout);
+void SerialConsoleGetRxStats(SerialConsoleRxStats *stats);
+uint32_t SerialConsoleGetTxDropped(void);
 void LogMessage(enum eDebugLogLevels level, const char *format, ...);
 void setLogLevel(enum eDebugLogLevels debugLevel);
 enum eDebugLogLevels getLogLevel(void);
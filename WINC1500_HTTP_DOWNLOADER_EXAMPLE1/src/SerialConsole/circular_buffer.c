@@ -22,6 +22,7 @@
  #include <assert.h>
 
  #include "circular_buffer.h"
+ #include "MemPool/MemPool.h"
 
 
  // The definition of our circular buffer structure is hidden from the user
@@ -33,6 +34,9 @@
 	 bool full;
  };
 
+ // Buffer handles come from a static pool instead of the heap
+ MEM_POOL_DEFINE(cbufPool, "cbuf", sizeof(circular_buf_t), CIRCULAR_BUF_MAX_INSTANCES);
+
  #pragma mark - Private Functions -
 
  static void advance_pointer(cbuf_handle_t cbuf)
@@ -64,8 +68,11 @@
  {
 	// assert(buffer && size);
 
-	 cbuf_handle_t cbuf = malloc(sizeof(circular_buf_t));
-	 //assert(cbuf);
+	 cbuf_handle_t cbuf = MemPoolAlloc(&cbufPool);
+	 if(cbuf == NULL)
+	 {
+		 return NULL;
+	 }
 
 	 cbuf->buffer = buffer;
 	 cbuf->max = size;
@@ -79,7 +86,7 @@
  void circular_buf_free(cbuf_handle_t cbuf)
  {
 	// assert(cbuf);
-	 free(cbuf);
+	 MemPoolFree(&cbufPool, cbuf);
  }
 
  void circular_buf_reset(cbuf_handle_t cbuf)
@@ -17,6 +17,9 @@
 #ifndef CIRCULAR_BUFFER_H_
 #define CIRCULAR_BUFFER_H_
 
+/// Maximum number of circular buffers alive at the same time: console TX and the trace UART RX. Handles come from a static pool
+#define CIRCULAR_BUF_MAX_INSTANCES	2
+
 /// Opaque circular buffer structure
 typedef struct circular_buf_t circular_buf_t;
 
@@ -25,7 +28,7 @@ typedef circular_buf_t* cbuf_handle_t;
 
 /// Pass in a storage buffer and size, returns a circular buffer handle
 /// Requires: buffer is not NULL, size > 0
-/// Ensures: cbuf has been created and is returned in an empty state
+/// Ensures: cbuf has been created and is returned in an empty state, or NULL if CIRCULAR_BUF_MAX_INSTANCES are in use
 cbuf_handle_t circular_buf_init(uint8_t* buffer, size_t size);
 
 /// Free a circular buffer structure
@@ -0,0 +1,167 @@
+/**************************************************************************//**
+* @file      MoveSequencer.c
+* @brief     Tick-based timeline that plays back the moves of a game on the keypad LEDs.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "UiHandlerThread/MoveSequencer.h"
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static uint32_t MoveSequencerScale(const MoveSequencer *sequencer, uint32_t timeMs);
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static uint32_t MoveSequencerScale(const MoveSequencer *sequencer, uint32_t timeMs)
+* @brief	Scales a time at normal speed to the current playback speed
+* @param[in]	sequencer Sequencer
+* @param[in]	timeMs Time at normal speed, in ms
+* @return	Time at the current speed, in ms. At least 1 ms.
+*****************************************************************************/
+static uint32_t MoveSequencerScale(const MoveSequencer *sequencer, uint32_t timeMs)
+{
+	uint32_t scaled = (timeMs * MOVE_SEQUENCER_SPEED_NORMAL) / sequencer->speed;
+	return (scaled == 0) ? 1 : scaled;
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void MoveSequencerInit(MoveSequencer *sequencer)
+* @brief	Initializes an idle sequencer at normal speed
+* @param[in]	sequencer Sequencer
+*****************************************************************************/
+void MoveSequencerInit(MoveSequencer *sequencer)
+{
+	sequencer->moves = 0;
+	sequencer->count = 0;
+	sequencer->index = 0;
+	sequencer->ledOn = false;
+	sequencer->active = false;
+	sequencer->speed = MOVE_SEQUENCER_SPEED_NORMAL;
+	sequencer->nextEvent = 0;
+}
+
+/**************************************************************************//**
+* @fn		void MoveSequencerStart(MoveSequencer *sequencer, const uint8_t *moves, uint8_t count, uint32_t now)
+* @brief	Starts playing a list of moves. The first move is due right away.
+* @param[in]	sequencer Sequencer
+* @param[in]	moves Keys to light, in order. Must stay valid while playing
+* @param[in]	count Number of moves. With 0 moves the playback is done on the first poll
+* @param[in]	now Current time, in ms
+*****************************************************************************/
+void MoveSequencerStart(MoveSequencer *sequencer, const uint8_t *moves, uint8_t count, uint32_t now)
+{
+	sequencer->moves = moves;
+	sequencer->count = count;
+	sequencer->index = 0;
+	sequencer->ledOn = false;
+	sequencer->active = true;
+	sequencer->nextEvent = now;
+}
+
+/**************************************************************************//**
+* @fn		eMoveSequencerEvent MoveSequencerPoll(MoveSequencer *sequencer, uint32_t now, uint8_t *key)
+* @brief	Returns the next event if it is due. Call until it returns MOVE_SEQUENCER_NONE.
+* @param[in]	sequencer Sequencer
+* @param[in]	now Current time, in ms
+* @param[out]	key Key the event applies to
+* @return	Event due, MOVE_SEQUENCER_NONE if nothing is due or nothing is playing
+*****************************************************************************/
+eMoveSequencerEvent MoveSequencerPoll(MoveSequencer *sequencer, uint32_t now, uint8_t *key)
+{
+	if(!sequencer->active || (int32_t)(now - sequencer->nextEvent) < 0)
+	{
+		return MOVE_SEQUENCER_NONE;
+	}
+
+	if(sequencer->index >= sequencer->count)
+	{
+		sequencer->active = false;
+		return MOVE_SEQUENCER_DONE;
+	}
+
+	*key = sequencer->moves[sequencer->index];
+	if(!sequencer->ledOn)
+	{
+		sequencer->ledOn = true;
+		sequencer->nextEvent += MoveSequencerScale(sequencer, MOVE_SEQUENCER_ON_MS);
+		return MOVE_SEQUENCER_LED_ON;
+	}
+
+	sequencer->ledOn = false;
+	sequencer->index++;
+	sequencer->nextEvent += MoveSequencerScale(sequencer, MOVE_SEQUENCER_OFF_MS);
+	return MOVE_SEQUENCER_LED_OFF;
+}
+
+/**************************************************************************//**
+* @fn		uint32_t MoveSequencerTimeToNext(const MoveSequencer *sequencer, uint32_t now)
+* @brief	Returns how long the caller can sleep before the next event
+* @param[in]	sequencer Sequencer
+* @param[in]	now Current time, in ms
+* @return	Time until the next event in ms, 0 if it is due, MOVE_SEQUENCER_IDLE if nothing is playing
+*****************************************************************************/
+uint32_t MoveSequencerTimeToNext(const MoveSequencer *sequencer, uint32_t now)
+{
+	int32_t remaining;
+
+	if(!sequencer->active) return MOVE_SEQUENCER_IDLE;
+
+	remaining = (int32_t)(sequencer->nextEvent - now);
+	return (remaining > 0) ? (uint32_t)remaining : 0;
+}
+
+/**************************************************************************//**
+* @fn		bool MoveSequencerSetSpeed(MoveSequencer *sequencer, uint16_t speed)
+* @brief	Changes the playback speed. Applies from the next event on.
+* @param[in]	sequencer Sequencer
+* @param[in]	speed Speed in percent, MOVE_SEQUENCER_SPEED_MIN to MOVE_SEQUENCER_SPEED_MAX
+* @return	true if changed, false if the speed is out of range
+*****************************************************************************/
+bool MoveSequencerSetSpeed(MoveSequencer *sequencer, uint16_t speed)
+{
+	if(speed < MOVE_SEQUENCER_SPEED_MIN || speed > MOVE_SEQUENCER_SPEED_MAX)
+	{
+		return false;
+	}
+	sequencer->speed = speed;
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		bool MoveSequencerCancel(MoveSequencer *sequencer, uint8_t *key)
+* @brief	Stops the playback
+* @param[in]	sequencer Sequencer
+* @param[out]	key Key that was left lit, if any
+* @return	true if a key was left lit and must be turned off by the caller
+*****************************************************************************/
+bool MoveSequencerCancel(MoveSequencer *sequencer, uint8_t *key)
+{
+	bool ledOn = sequencer->active && sequencer->ledOn;
+
+	if(ledOn) *key = sequencer->moves[sequencer->index];
+	sequencer->active = false;
+	sequencer->ledOn = false;
+	return ledOn;
+}
+
+/**************************************************************************//**
+* @fn		bool MoveSequencerIsActive(const MoveSequencer *sequencer)
+* @brief	Returns true while a game is being played back
+* @param[in]	sequencer Sequencer
+*****************************************************************************/
+bool MoveSequencerIsActive(const MoveSequencer *sequencer)
+{
+	return sequencer->active;
+}
@@ -0,0 +1,76 @@
+/**************************************************************************//**
+* @file      MoveSequencer.h
+* @brief     Tick-based timeline that plays back the moves of a game on the keypad LEDs.
+Each move lights its key for the on time, then leaves the keypad dark for the off time before the next move.
+The sequencer does not wait: the UI task polls it with the current time, applies the LED events that are due and
+sleeps until MoveSequencerTimeToNext(), so it keeps handling keys, colors and cancellation while a game plays.
+Deadlines are absolute, so LED writes that take longer than expected do not make the playback drift.
+This module only depends on the C standard library so it can also be built for a host.
+
+******************************************************************************/
+
+
+#ifndef MOVE_SEQUENCER_H
+#define MOVE_SEQUENCER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define MOVE_SEQUENCER_ON_MS			1000	///<Time a move stays lit at normal speed
+#define MOVE_SEQUENCER_OFF_MS			1000	///<Dark time after a move at normal speed
+#define MOVE_SEQUENCER_SPEED_NORMAL		100		///<Normal playback speed, in percent
+#define MOVE_SEQUENCER_SPEED_MIN		25		///<Slowest playback speed, in percent
+#define MOVE_SEQUENCER_SPEED_MAX		800		///<Fastest playback speed, in percent
+#define MOVE_SEQUENCER_IDLE				UINT32_MAX	///<MoveSequencerTimeToNext() value when nothing is playing
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Events returned by the sequencer
+typedef enum eMoveSequencerEvent
+{
+	MOVE_SEQUENCER_NONE = 0,	///<Nothing due yet
+	MOVE_SEQUENCER_LED_ON,		///<Light the key of the current move
+	MOVE_SEQUENCER_LED_OFF,		///<Turn off the key of the current move
+	MOVE_SEQUENCER_DONE,		///<Every move has been played
+} eMoveSequencerEvent;
+
+//Playback state
+typedef struct MoveSequencer
+{
+	const uint8_t *moves;		///<Keys to play. Must stay valid while playing
+	uint8_t count;				///<Number of moves
+	uint8_t index;				///<Move being played
+	bool ledOn;					///<True while the key of the current move is lit
+	bool active;				///<True while playing
+	uint16_t speed;				///<Playback speed, in percent
+	uint32_t nextEvent;			///<Time of the next event, in ms
+} MoveSequencer;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+void MoveSequencerInit(MoveSequencer *sequencer);
+void MoveSequencerStart(MoveSequencer *sequencer, const uint8_t *moves, uint8_t count, uint32_t now);
+eMoveSequencerEvent MoveSequencerPoll(MoveSequencer *sequencer, uint32_t now, uint8_t *key);
+uint32_t MoveSequencerTimeToNext(const MoveSequencer *sequencer, uint32_t now);
+bool MoveSequencerSetSpeed(MoveSequencer *sequencer, uint16_t speed);
+bool MoveSequencerCancel(MoveSequencer *sequencer, uint8_t *key);
+bool MoveSequencerIsActive(const MoveSequencer *sequencer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MOVE_SEQUENCER_H*/
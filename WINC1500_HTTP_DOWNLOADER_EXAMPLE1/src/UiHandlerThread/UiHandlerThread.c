@@ -20,11 +20,14 @@
 #include "SerialConsole.h"
 #include "main.h"
 #include "SeesawDriver/Seesaw.h"
+#include "ControlThread/ControlThread.h"
+#include "UiHandlerThread/MoveSequencer.h"
 
 /******************************************************************************
 * Defines
 ******************************************************************************/
 #define		BUTTON_PRESSES_MAX	16	///<Number of maximum button presses to analize in one go
+#define		UI_KEYPAD_POLL_MS	250	///<Longest time the UI waits for the keypad INT while handling buttons, in case an edge was missed
 
 /******************************************************************************
 * Variables
@@ -32,13 +35,22 @@
 uiStateMachine_state uiState; ///<Holds the current state of the UI
 struct GameDataPacket gamePacketIn; ///<Holds the game packet to show
 struct GameDataPacket gamePacketOut;///<Holds the game packet to send back
-volatile uint8_t red = 0; ///<Holds the color of the red LEDs. Can be set by MQTT
-volatile uint8_t green = 100; ///<Holds the color of the green LEDs. Can be set by MQTT
-volatile uint8_t blue = 50; ///<Holds the color of the blue LEDs. Can be set by MQTT
+static struct RgbColorPacket uiColorRequested = {0, 100, 50}; ///<Color of the LEDs requested over MQTT. Written by the Wifi task
+static struct GameDataPacket uiGamePending; ///<Game ordered by the control task, not yet picked up by the UI task
+static uint32_t uiGamePendingTick = 0; ///<Tick at which the pending game arrived from the server
+static bool uiGameIsPending = false; ///<True while uiGamePending holds a game the UI task has not picked up
+static uint16_t uiSpeedRequested = MOVE_SEQUENCER_SPEED_NORMAL; ///<Playback speed requested from the CLI, in percent
+static bool uiCancelRequested = false; ///<True when the playback of the current game should be skipped
+static TaskHandle_t uiTaskHandle = NULL; ///<UI task, woken up with task notifications
+static MoveSequencer uiSequencer; ///<Plays back the moves of gamePacketIn. Only used by the UI task
+static bool uiPlaybackStart = false; ///<True when a new game was picked up and its playback has not started yet
+uint8_t red = 0; ///<Holds the color of the red LEDs. Only used by the UI task
+uint8_t green = 100; ///<Holds the color of the green LEDs. Only used by the UI task
+uint8_t blue = 50; ///<Holds the color of the blue LEDs. Only used by the UI task
+uint32_t gameTick = 0; ///<Tick at which the game being shown arrived from the server
 
 uint8_t pressedKeys = 0; ///<Variable to count how many presses the player has done
 uint8_t keysToPress = 0; ///<Variable that holds the number of new keypresses the user should do
-bool playIsDone = false; ///<Boolean flag to indicate if the player has finished moving. Useful for COntrol to determine when to send back a play.
 uint8_t buttons[BUTTON_PRESSES_MAX]; ///<Array to hold button presses
 /******************************************************************************
 * Forward Declarations
@@ -55,9 +67,11 @@ uint8_t buttons[BUTTON_PRESSES_MAX]; ///<Array to hold button presses
 
 /**************************************************************************//**
 * @fn		void vUiHandlerTask( void *pvParameters )
-* @brief	STUDENT TO FILL THIS
-* @details 	student to fill this
-                				
+* @brief	Runs the UI state machine: shows the opponent's moves and collects the player's move from the keypad
+* @details 	The task sleeps on its task notification until a game is ordered (UI_NOTIFY_SHOW_MOVES_BIT), a key event
+*			comes in (SEESAW_KEYPAD_NOTIFY_BIT) or the LED color changes (UI_NOTIFY_COLOR_BIT). While ignoring presses
+*			it does not wake up at all. The moves are played back by uiSequencer: while showing them the task only wakes
+*			up when the next LED change is due, so keys, colors and new orders are still handled during the playback.
 * @param[in]	Parameters passed when task is initialized. In this case we can ignore them!
 * @return		Should not return! This is a task defining function.
 * @note         
@@ -67,10 +81,16 @@ void vUiHandlerTask( void *pvParameters )
 //Do initialization code here
 SerialConsoleWriteString("UI Task Started!");
 uiState = UI_STATE_IGNORE_PRESSES; //Initial state
+uint32_t notifiedValue = 0; //Notification bits received while sleeping
+TickType_t waitTime; //Longest time to sleep in the current state
+uiTaskHandle = xTaskGetCurrentTaskHandle();
+MoveSequencerInit(&uiSequencer);
+SeesawKeypadSetNotifyTask(uiTaskHandle); //Key events wake us up through the Seesaw INT line
 
 //Here we start the loop for the UI State Machine
 while(1)
 {
+	waitTime = portMAX_DELAY;
 	switch(uiState)
 	{
 		case(UI_STATE_IGNORE_PRESSES):
@@ -83,48 +103,63 @@ while(1)
 
 		case(UI_STATE_SHOW_MOVES):
 		{
-			//Set initial state variable that will be used on the UI_STATE_Handle_Buttons and need to be initialized once
-			pressedKeys = 0; //Set number of keys pressed by player to 0.
-			keysToPress = 0;
-			while (keysToPress<sizeof(gamePacketIn.game)&&gamePacketIn.game[keysToPress]<255) {
-				keysToPress++; 
+			uint8_t presses = 0;
+			uint8_t key;
+			bool ledsChanged = false;
+			eMoveSequencerEvent event;
+			uint32_t now;
+
+			if(uiPlaybackStart)
+			{
+				//Set initial state variable that will be used on the UI_STATE_Handle_Buttons and need to be initialized once
+				uiPlaybackStart = false;
+				if(MoveSequencerCancel(&uiSequencer, &key)) SeesawSetLed(key, 0, 0, 0); //A new game replaces the one being shown
+				pressedKeys = 0; //Set number of keys pressed by player to 0.
+				keysToPress = 0;
+				while (keysToPress<sizeof(gamePacketIn.game)&&gamePacketIn.game[keysToPress]<255) {
+					keysToPress++; 
+				}
+				MoveSequencerStart(&uiSequencer, gamePacketIn.game, keysToPress, xTaskGetTickCount() * portTICK_PERIOD_MS);
+				keysToPress++; //need to press one more button then the received packet
+				memset(gamePacketOut.game,0xff, sizeof(gamePacketOut.game)); //Erase gamePacketOut to an initial state
 			}
-			keysToPress++; //need to press one more button then the received packet
-			memset(gamePacketOut.game,0xff, sizeof(gamePacketOut.game)); //Erase gamePacketOut to an initial state
-			playIsDone = false; //Set play to false
-			uint8_t presses = SeesawGetKeypadCount();
-			if(presses >= BUTTON_PRESSES_MAX) presses = BUTTON_PRESSES_MAX;
-			if(presses != 0) SeesawReadKeypad(buttons,presses); //Empty Seesaw buffer just in case it has latent presses on it!
+
+			//Presses done while the moves are shown do not count. The keypad is emptied so the Seesaw FIFO does not fill up
+			if((notifiedValue & SEESAW_KEYPAD_NOTIFY_BIT) || SeesawKeypadHasEvents()) SeesawKeypadDrain(buttons, BUTTON_PRESSES_MAX, &presses);
 			memset(buttons, 0, BUTTON_PRESSES_MAX);
-			//STUDENTS: Make this function show the moves of the gamePacketIn.
-			//You can use a static delay to show each move but a quicker delay as the message gets longer might be more fun!
-			//After you finish showing the move should go to state UI_STATE_HANDLE_BUTTONS
-			uint8_t nthmove = 0;
-			while (gamePacketIn.game[nthmove]<255) {
-				SerialConsoleWriteString("Showing Move!\r\n");
-				SeesawSetLed(gamePacketIn.game[nthmove], red, green, blue); //Turn button 1 on
-				SeesawOrderLedUpdate();
-				vTaskDelay(1000);
-				SeesawSetLed(gamePacketIn.game[nthmove], 0, 0, 0); //Turn button 1 on
-				SeesawOrderLedUpdate();
-				vTaskDelay(1000);
-
-				nthmove++;
+
+			//Apply every LED change that is due, then send them to the keypad in one update
+			now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+			while(MOVE_SEQUENCER_NONE != (event = MoveSequencerPoll(&uiSequencer, now, &key)))
+			{
+				if(event == MOVE_SEQUENCER_LED_ON)
+				{
+					SerialConsoleWriteString("Showing Move!\r\n");
+					if(uiSequencer.index == 0)
+					{
+						LogMessage(LOG_DEBUG_LVL, "UI: first LED %lu ms after the game arrived\r\n", (xTaskGetTickCount() - gameTick) * portTICK_PERIOD_MS);
+					}
+					SeesawSetLed(key, red, green, blue);
+					ledsChanged = true;
+				}
+				else if(event == MOVE_SEQUENCER_LED_OFF)
+				{
+					SeesawSetLed(key, 0, 0, 0);
+					ledsChanged = true;
+				}
 			}
-			
-			//In the beginner example we turn LED0 and LED15 will turn on for 500 ms then we go to UI_STATE_HANDLE_BUTTONS
-			//SeesawSetLed(0, red, green, blue); //Turn button 1 on
-			//SeesawOrderLedUpdate();
-			//vTaskDelay(1000);
-			//SeesawSetLed(0, 0, 0, 0); //Turn button 1 off
-			//SeesawSetLed(15, red, green, blue); // Turn button 15 on
-			//SeesawOrderLedUpdate();
-			//vTaskDelay(1000);
-			//SeesawSetLed(15,0,0,0); //Turn button 15 off
-			//SeesawOrderLedUpdate();
-			//vTaskDelay(1000);
-			uiState = UI_STATE_HANDLE_BUTTONS;
+			if(ledsChanged) SeesawOrderLedUpdate();
 
+			if(MoveSequencerIsActive(&uiSequencer))
+			{
+				//Sleep until the next LED change. Keys, colors and new orders still wake the task up
+				waitTime = pdMS_TO_TICKS(MoveSequencerTimeToNext(&uiSequencer, xTaskGetTickCount() * portTICK_PERIOD_MS));
+			}
+			else
+			{
+				uiState = UI_STATE_HANDLE_BUTTONS;
+				waitTime = 0;
+			}
 			break;
 		}
 
@@ -135,15 +170,12 @@ while(1)
 		//This state should accept (gamePacketIn length + 1) moves from the player (capped to maximum 19 + new move)
 		//The moves by the player should be stored on "gamePacketOut". The keypresses that should count are when the player RELEASES the button.
 		
-		//In this example, we return after only one button press!
-		uint8_t numPresses = SeesawGetKeypadCount();
+		//The keypad is only read when the Seesaw INT line says there are events
+		uint8_t numPresses = 0;
 		memset(buttons, 0, BUTTON_PRESSES_MAX);
 
-		if(numPresses >= BUTTON_PRESSES_MAX )
-		{
-			numPresses = BUTTON_PRESSES_MAX;
-		}
-		if(numPresses != 0 && ERROR_NONE == SeesawReadKeypad(buttons, numPresses))
+		if(((notifiedValue & SEESAW_KEYPAD_NOTIFY_BIT) || SeesawKeypadHasEvents()) &&
+			ERROR_NONE == SeesawKeypadDrain(buttons, BUTTON_PRESSES_MAX, &numPresses) && numPresses != 0)
 		{
 			//Process Buttons
 			for (int iter = 0; iter < numPresses; iter++)
@@ -170,8 +202,12 @@ while(1)
 		{
 			//Tell control gamePacketOut is ready to be send out AND go back to UI_STATE_IGNORE_PRESSES
 			SerialConsoleWriteString("Play is Done!\r\n");
-			playIsDone = true;
 			uiState = UI_STATE_IGNORE_PRESSES;
+			ControlPlayDone();
+		}
+		else
+		{
+			waitTime = pdMS_TO_TICKS(UI_KEYPAD_POLL_MS);
 		}
 
 
@@ -185,8 +221,39 @@ while(1)
 		break;
 	}
 
-	//After execution, you can put a thread to sleep for some time.
-	vTaskDelay(50);
+	//After execution, sleep until a game, a key event or a color change comes in
+	notifiedValue = 0;
+	xTaskNotifyWait(0, SEESAW_KEYPAD_NOTIFY_BIT | UI_NOTIFY_SHOW_MOVES_BIT | UI_NOTIFY_COLOR_BIT | UI_NOTIFY_PLAYBACK_BIT, &notifiedValue, waitTime);
+
+	bool cancel;
+	taskENTER_CRITICAL();
+	red = uiColorRequested.red;
+	green = uiColorRequested.green;
+	blue = uiColorRequested.blue;
+	MoveSequencerSetSpeed(&uiSequencer, uiSpeedRequested);
+	cancel = uiCancelRequested;
+	uiCancelRequested = false;
+	if(uiGameIsPending)
+	{
+		memcpy(&gamePacketIn, &uiGamePending, sizeof(gamePacketIn));
+		gameTick = uiGamePendingTick;
+		uiGameIsPending = false;
+		uiPlaybackStart = true;
+		uiState = UI_STATE_SHOW_MOVES;
+	}
+	taskEXIT_CRITICAL();
+
+	if(cancel && !uiPlaybackStart && uiState == UI_STATE_SHOW_MOVES)
+	{
+		//Skip the rest of the playback and let the player answer right away
+		uint8_t key;
+		if(MoveSequencerCancel(&uiSequencer, &key))
+		{
+			SeesawSetLed(key, 0, 0, 0);
+			SeesawOrderLedUpdate();
+		}
+		SerialConsoleWriteString("Playback skipped!\r\n");
+	}
 }
 
 
@@ -199,16 +266,22 @@ while(1)
 /******************************************************************************
 * Functions
 ******************************************************************************/
-void UiOrderShowMoves(struct GameDataPacket *packetIn){
-	memcpy(&gamePacketIn, packetIn, sizeof(gamePacketIn));
-	uiState = UI_STATE_SHOW_MOVES;
-	playIsDone = false; //Set play to false
-}
-
 
-bool UiPlayIsDone(void)
-{
-	return playIsDone;
+/**************************************************************************//**
+void UiOrderShowMoves(const struct GameDataPacket *packetIn, uint32_t arrivalTick)
+* @brief	Orders the UI task to show a game and collect the player's move. Called by the control task.
+* @param[in]	packetIn Game to show
+* @param[in]	arrivalTick Tick at which the game arrived from the server, to log the latency until the first LED
+* @note		ControlPlayDone() is called once the player has finished the move
+*****************************************************************************/
+void UiOrderShowMoves(const struct GameDataPacket *packetIn, uint32_t arrivalTick){
+	taskENTER_CRITICAL();
+	memcpy(&uiGamePending, packetIn, sizeof(uiGamePending));
+	uiGamePendingTick = arrivalTick;
+	uiGameIsPending = true;
+	taskEXIT_CRITICAL();
+
+	if(uiTaskHandle != NULL) xTaskNotify(uiTaskHandle, UI_NOTIFY_SHOW_MOVES_BIT, eSetBits);
 }
 
 struct GameDataPacket *UiGetGamePacketOut(void)
@@ -223,12 +296,53 @@ int UIChangeColors(uint8_t r, uint8_t g, uint8_t b);
 * @param[out] 
                 				
 * @return		
-* @note         
+* @note         The UI task picks the three values up together the next time it wakes up
 
 *****************************************************************************/
 void UIChangeColors(uint8_t r, uint8_t g, uint8_t b)
 {
-	red = r;
-	green = g;
-	blue = b;
-}
\ No newline at end of file
+	taskENTER_CRITICAL();
+	uiColorRequested.red = r;
+	uiColorRequested.green = g;
+	uiColorRequested.blue = b;
+	taskEXIT_CRITICAL();
+
+	if(uiTaskHandle != NULL) xTaskNotify(uiTaskHandle, UI_NOTIFY_COLOR_BIT, eSetBits);
+}
+
+
+/**************************************************************************//**
+* @fn		bool UiSetPlaybackSpeed(uint16_t speed)
+* @brief	Changes the speed at which the opponent's moves are shown
+* @param[in]	speed Speed in percent of the normal speed, MOVE_SEQUENCER_SPEED_MIN to MOVE_SEQUENCER_SPEED_MAX
+* @return	true if accepted, false if the speed is out of range
+* @note		Applies from the next LED change on, also to a game that is being shown
+*****************************************************************************/
+bool UiSetPlaybackSpeed(uint16_t speed)
+{
+	if(speed < MOVE_SEQUENCER_SPEED_MIN || speed > MOVE_SEQUENCER_SPEED_MAX)
+	{
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	uiSpeedRequested = speed;
+	taskEXIT_CRITICAL();
+
+	if(uiTaskHandle != NULL) xTaskNotify(uiTaskHandle, UI_NOTIFY_PLAYBACK_BIT, eSetBits);
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		void UiCancelShowMoves(void)
+* @brief	Stops showing the opponent's moves. The player can enter the move right away.
+* @note		Does nothing if no game is being shown
+*****************************************************************************/
+void UiCancelShowMoves(void)
+{
+	taskENTER_CRITICAL();
+	uiCancelRequested = true;
+	taskEXIT_CRITICAL();
+
+	if(uiTaskHandle != NULL) xTaskNotify(uiTaskHandle, UI_NOTIFY_PLAYBACK_BIT, eSetBits);
+}
@@ -20,6 +20,9 @@ extern "C" {
 ******************************************************************************/
 #define UI_TASK_SIZE			400//<Size of stack to assign to the UI thread. In words
 #define UI_TASK_PRIORITY		(configMAX_PRIORITIES - 3)
+#define UI_NOTIFY_SHOW_MOVES_BIT	(1UL << 2)	///<Task notification bit set when the control task orders a game to be shown
+#define UI_NOTIFY_COLOR_BIT			(1UL << 3)	///<Task notification bit set when the LED color changes
+#define UI_NOTIFY_PLAYBACK_BIT		(1UL << 4)	///<Task notification bit set when the playback speed changes or the playback is cancelled
 typedef enum uiStateMachine_state
 {
 	UI_STATE_HANDLE_BUTTONS = 0, ///<State used to handle buttons
@@ -38,10 +41,11 @@ typedef enum uiStateMachine_state
 * Global Function Declaration
 ******************************************************************************/
 void vUiHandlerTask( void *pvParameters );
-void UiOrderShowMoves(struct GameDataPacket *packetIn);
-bool UiPlayIsDone(void);
+void UiOrderShowMoves(const struct GameDataPacket *packetIn, uint32_t arrivalTick);
 struct GameDataPacket *UiGetGamePacketOut(void);
 void UIChangeColors(uint8_t r, uint8_t g, uint8_t b);
+bool UiSetPlaybackSpeed(uint16_t speed);
+void UiCancelShowMoves(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,125 @@
+/**************************************************************************//**
+* @file      MqttLink.c
+* @brief     Keeps the MQTT broker connection up and accounts for what is lost while it is down.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <string.h>
+#include "WifiHandlerThread/MqttLink.h"
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void MqttLinkInit(struct MqttLink *link, struct mqtt_module *module, const char *broker, uint32_t now)
+* @brief	Initializes the link of an MQTT instance. The link starts down, and its first outage starts now.
+* @param[in]	link Link to initialize
+* @param[in]	module MQTT instance, already initialized with mqtt_init
+* @param[in]	broker Host name of the broker
+* @param[in]	now Current time, in ms
+*****************************************************************************/
+void MqttLinkInit(struct MqttLink *link, struct mqtt_module *module, const char *broker, uint32_t now)
+{
+	memset(link, 0, sizeof(*link));
+	link->module = module;
+	link->broker = broker;
+	link->downSince = now;
+}
+
+/**************************************************************************//**
+* @fn		bool MqttLinkConnect(struct MqttLink *link, uint32_t now)
+* @brief	Starts a connection to the broker if the link is down and the last attempt is at least MQTT_LINK_RETRY_MS old
+* @param[in]	link Link to connect
+* @param[in]	now Current time, in ms
+* @return	true if an attempt was made
+* @note		The MQTT callback sends the CONNECT once the socket is up, and calls MqttLinkConnected on the CONNACK.
+*****************************************************************************/
+bool MqttLinkConnect(struct MqttLink *link, uint32_t now)
+{
+	if(MqttLinkIsUp(link)) return false;
+	if(link->attempted && (now - link->lastAttempt) < MQTT_LINK_RETRY_MS) return false;
+
+	link->attempted = true;
+	link->lastAttempt = now;
+	link->stats.attempts++;
+	mqtt_connect(link->module, link->broker);
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		void MqttLinkConnected(struct MqttLink *link, bool sessionPresent, uint32_t now)
+* @brief	Records that the broker accepted the connection, which ends the current outage
+* @param[in]	link Link that connected
+* @param[in]	sessionPresent true if the broker resumed the previous session
+* @param[in]	now Current time, in ms
+*****************************************************************************/
+void MqttLinkConnected(struct MqttLink *link, bool sessionPresent, uint32_t now)
+{
+	if(link->up) return;
+
+	link->up = true;
+	link->stats.lastOutageMs = now - link->downSince;
+	if(link->stats.lastOutageMs > link->stats.maxOutageMs) link->stats.maxOutageMs = link->stats.lastOutageMs;
+	if(link->stats.disconnects > 0)
+	{
+		link->stats.reconnects++;
+		if(sessionPresent) link->stats.resumed++;
+	}
+}
+
+/**************************************************************************//**
+* @fn		void MqttLinkDisconnected(struct MqttLink *link, uint32_t now)
+* @brief	Records the loss of the connection, which starts an outage
+* @param[in]	link Link that was lost
+* @param[in]	now Current time, in ms
+* @note		Called from the MQTT_CALLBACK_DISCONNECTED event. Does nothing if the link was already down.
+*****************************************************************************/
+void MqttLinkDisconnected(struct MqttLink *link, uint32_t now)
+{
+	if(!link->up) return;
+
+	link->up = false;
+	link->downSince = now;
+	link->stats.disconnects++;
+	//A lost broker is retried at once, the spacing only applies to attempts that fail
+	link->attempted = false;
+}
+
+/**************************************************************************//**
+* @fn		bool MqttLinkIsUp(const struct MqttLink *link)
+* @brief	Checks if messages can be published
+* @param[in]	link Link to check
+* @return	true if the broker accepted the connection and it was not lost since
+*****************************************************************************/
+bool MqttLinkIsUp(const struct MqttLink *link)
+{
+	return link->up && link->module->isConnected;
+}
+
+/**************************************************************************//**
+* @fn		int MqttLinkPublish(struct MqttLink *link, const char *topic, const uint8_t *msg, size_t len, uint32_t samples)
+* @brief	Publishes a telemetry message with QoS 1, or counts its samples as lost if the link is down
+* @param[in]	link Link to publish on
+* @param[in]	topic Topic of the message
+* @param[in]	msg Payload
+* @param[in]	len Length of the payload
+* @param[in]	samples Number of telemetry samples in the message
+* @return	SUCCESS if the broker acknowledged the message, FAILURE otherwise
+* @note		A publish that fails makes the MQTT wrapper drop the connection, so the next pass of the Wifi task reconnects.
+*****************************************************************************/
+int MqttLinkPublish(struct MqttLink *link, const char *topic, const uint8_t *msg, size_t len, uint32_t samples)
+{
+	int rc = FAILURE;
+
+	if(MqttLinkIsUp(link))
+	{
+		rc = mqtt_publish(link->module, topic, (const char *)msg, len, 1, 0);
+	}
+	if(rc != SUCCESS) link->stats.samplesLost += samples;
+	return rc;
+}
@@ -0,0 +1,75 @@
+/**************************************************************************//**
+* @file      MqttLink.h
+* @brief     Keeps the MQTT broker connection up and accounts for what is lost while it is down.
+A failed publish or yield, or a socket the broker closed, is reported by the MQTT wrapper as a disconnect. The Wifi
+task then calls MqttLinkConnect on every pass; the attempts are spaced by MQTT_LINK_RETRY_MS so that an unreachable
+broker does not take all of the radio time. Telemetry published while the link is down is not sent, and its samples
+are counted as lost. The statistics give the time each outage lasted, from the loss to the CONNACK that ended it.
+Times are passed in by the caller, in ms.
+
+******************************************************************************/
+
+
+#ifndef MQTT_LINK_H
+#define MQTT_LINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "MQTTClient/Wrapper/mqtt.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define MQTT_LINK_RETRY_MS		2000	///<Minimum time between two connection attempts to the broker
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Counters of the broker connection, since MqttLinkInit
+struct MqttLinkStats
+{
+	uint32_t disconnects;		///<Number of times an established connection was lost
+	uint32_t attempts;			///<Number of connection attempts
+	uint32_t reconnects;		///<Number of connections established after a loss
+	uint32_t resumed;			///<Number of those where the broker still had the session, so nothing was subscribed again
+	uint32_t samplesLost;		///<Telemetry samples not delivered: skipped while the link was down, or in a failed publish
+	uint32_t lastOutageMs;		///<Duration of the last outage in ms, from the loss (or MqttLinkInit) to the CONNACK
+	uint32_t maxOutageMs;		///<Longest outage, in ms
+};
+
+//State of the broker connection
+struct MqttLink
+{
+	struct mqtt_module *module;	///<MQTT instance that carries the connection
+	const char *broker;			///<Host name of the broker
+	bool up;					///<true between the CONNACK and the loss of the connection
+	bool attempted;				///<true once a connection attempt was made, so lastAttempt is valid
+	uint32_t downSince;			///<Time at which the current outage began, in ms
+	uint32_t lastAttempt;		///<Time of the last connection attempt, in ms
+	struct MqttLinkStats stats;	///<Counters
+};
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+void MqttLinkInit(struct MqttLink *link, struct mqtt_module *module, const char *broker, uint32_t now);
+bool MqttLinkConnect(struct MqttLink *link, uint32_t now);
+void MqttLinkConnected(struct MqttLink *link, bool sessionPresent, uint32_t now);
+void MqttLinkDisconnected(struct MqttLink *link, uint32_t now);
+bool MqttLinkIsUp(const struct MqttLink *link);
+int MqttLinkPublish(struct MqttLink *link, const char *topic, const uint8_t *msg, size_t len, uint32_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MQTT_LINK_H*/
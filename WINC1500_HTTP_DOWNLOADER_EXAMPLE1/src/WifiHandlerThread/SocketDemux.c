@@ -0,0 +1,139 @@
+/**************************************************************************//**
+* @file      SocketDemux.c
+* @brief     Socket event demultiplexer for the WINC1500.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <string.h>
+#include "WifiHandlerThread/SocketDemux.h"
+#include "SerialConsole/SerialConsole.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define SOCKET_DEMUX_NO_OWNER		0xFF	///<Socket owner not known yet
+
+/******************************************************************************
+* Variables
+******************************************************************************/
+static const SocketDemuxService *demuxServices[SOCKET_DEMUX_MAX_SERVICES];	///<Registered services
+static uint8_t demuxServiceCount = 0;										///<Number of registered services
+static uint8_t demuxSocketOwner[MAX_SOCKET];								///<Index of the service that owns each socket
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static uint8_t SocketDemuxFindOwner(SOCKET sock);
+
+/******************************************************************************
+* Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static uint8_t SocketDemuxFindOwner(SOCKET sock)
+* @brief	Returns the service that owns a socket
+* @details	The cached owner is checked first. Sockets are reused by the WINC once closed, so the cache is only
+*			trusted if the service still claims the socket; otherwise every service is asked once and the cache updated.
+* @param[in]	sock Socket descriptor
+* @return	Index of the owner service, or SOCKET_DEMUX_NO_OWNER if no service uses the socket
+*****************************************************************************/
+static uint8_t SocketDemuxFindOwner(SOCKET sock)
+{
+	uint8_t owner = demuxSocketOwner[sock];
+
+	if(owner < demuxServiceCount && demuxServices[owner]->ownsSocket(sock))
+	{
+		return owner;
+	}
+
+	owner = SOCKET_DEMUX_NO_OWNER;
+	for(uint8_t i = 0; i < demuxServiceCount; i++)
+	{
+		if(demuxServices[i]->ownsSocket(sock))
+		{
+			owner = i;
+			break;
+		}
+	}
+	demuxSocketOwner[sock] = owner;
+	return owner;
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		enum status_code SocketDemuxRegister(const SocketDemuxService *service)
+* @brief	Registers a protocol service with the demultiplexer
+* @param[in]	service Service description. Must stay valid for the lifetime of the application.
+* @return	STATUS_OK if registered, STATUS_ERR_INVALID_ARG if the service is incomplete, STATUS_ERR_NO_MEMORY if the table is full
+* @note		Register all services before calling registerSocketCallback(SocketDemuxEventHandler, SocketDemuxResolveHandler)
+*****************************************************************************/
+enum status_code SocketDemuxRegister(const SocketDemuxService *service)
+{
+	if(service == NULL || service->ownsSocket == NULL || service->ownsHost == NULL || service->eventHandler == NULL || service->resolveHandler == NULL)
+	{
+		return STATUS_ERR_INVALID_ARG;
+	}
+	if(demuxServiceCount >= SOCKET_DEMUX_MAX_SERVICES)
+	{
+		return STATUS_ERR_NO_MEMORY;
+	}
+
+	if(demuxServiceCount == 0)
+	{
+		memset(demuxSocketOwner, SOCKET_DEMUX_NO_OWNER, sizeof(demuxSocketOwner));
+	}
+	demuxServices[demuxServiceCount++] = service;
+	return STATUS_OK;
+}
+
+/**************************************************************************//**
+* @fn		void SocketDemuxEventHandler(SOCKET sock, uint8_t u8Msg, void *pvMsg)
+* @brief	Socket callback registered with the WINC. Routes the event to the service that owns the socket.
+* @param[in]	sock Socket descriptor
+* @param[in]	u8Msg Socket event type
+* @param[in]	pvMsg Event data
+*****************************************************************************/
+void SocketDemuxEventHandler(SOCKET sock, uint8_t u8Msg, void *pvMsg)
+{
+	uint8_t owner;
+
+	if(sock < 0 || sock >= MAX_SOCKET) return;
+
+	owner = SocketDemuxFindOwner(sock);
+	if(owner != SOCKET_DEMUX_NO_OWNER)
+	{
+		demuxServices[owner]->eventHandler(sock, u8Msg, pvMsg);
+	}
+}
+
+/**************************************************************************//**
+* @fn		void SocketDemuxResolveHandler(uint8_t *pu8DomainName, uint32_t u32ServerIP)
+* @brief	DNS callback registered with the WINC. Routes the reply to every service waiting for that host name.
+* @param[in]	pu8DomainName Host name that was resolved
+* @param[in]	u32ServerIP IP of the host, in network byte order. Zero if the resolution failed.
+*****************************************************************************/
+void SocketDemuxResolveHandler(uint8_t *pu8DomainName, uint32_t u32ServerIP)
+{
+	bool delivered = false;
+
+	for(uint8_t i = 0; i < demuxServiceCount; i++)
+	{
+		if(demuxServices[i]->ownsHost(pu8DomainName))
+		{
+			demuxServices[i]->resolveHandler(pu8DomainName, u32ServerIP);
+			delivered = true;
+		}
+	}
+
+	if(!delivered)
+	{
+		LogMessage(LOG_DEBUG_LVL, "SocketDemux: nobody waiting for %s\r\n", pu8DomainName);
+	}
+}
@@ -0,0 +1,55 @@
+/**************************************************************************//**
+* @file      SocketDemux.h
+* @brief     Socket event demultiplexer for the WINC1500.
+The WINC socket API only accepts one socket callback and one DNS callback. This module is registered as both, and
+routes every socket event to the protocol service that owns the SOCKET, and every DNS reply to the service that
+asked for that host name. This lets HTTP downloads, MQTT and future services share the radio at the same time.
+The owner of each SOCKET is cached, so dispatching an event does not scan the services.
+
+******************************************************************************/
+
+
+#ifndef SOCKET_DEMUX_H
+#define SOCKET_DEMUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <status_codes.h>
+#include "socket/include/socket.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define SOCKET_DEMUX_MAX_SERVICES		4	///<Maximum number of protocol services that can share the sockets
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+///Describes a protocol service that owns sockets and resolves host names
+typedef struct SocketDemuxService
+{
+	const char *name;										///<Name of the service, for logs
+	bool (*ownsSocket)(SOCKET sock);						///<Returns true if the service uses the socket
+	bool (*ownsHost)(const uint8_t *domainName);			///<Returns true if the service is waiting for the resolution of this host
+	tpfAppSocketCb eventHandler;							///<Handler for the socket events of the sockets it owns
+	tpfAppResolveCb resolveHandler;							///<Handler for the DNS replies of the hosts it owns
+} SocketDemuxService;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+enum status_code SocketDemuxRegister(const SocketDemuxService *service);
+void SocketDemuxEventHandler(SOCKET sock, uint8_t u8Msg, void *pvMsg);
+void SocketDemuxResolveHandler(uint8_t *pu8DomainName, uint32_t u32ServerIP);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*SOCKET_DEMUX_H*/
@@ -0,0 +1,101 @@
+/**************************************************************************//**
+* @file      TelemetryBatch.c
+* @brief     Batching of IMU and distance telemetry so that a whole window of samples is published as a single MQTT message.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include "WifiHandlerThread/TelemetryBatch.h"
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void TelemetryBatchImuReset(struct ImuBatch *batch)
+* @brief	Empties an IMU batch
+* @param[in]	batch Batch to empty
+*****************************************************************************/
+void TelemetryBatchImuReset(struct ImuBatch *batch)
+{
+	batch->count = 0;
+}
+
+/**************************************************************************//**
+* @fn		bool TelemetryBatchImuAdd(struct ImuBatch *batch, uint32_t tick, const struct ImuDataPacket *sample)
+* @brief	Adds an IMU sample to the batch
+* @param[in]	batch Batch to add the sample to
+* @param[in]	tick Tick at which the sample was taken
+* @param[in]	sample IMU sample
+* @return	true if the batch is full after adding the sample and must be published. The sample is dropped if the batch was already full.
+*****************************************************************************/
+bool TelemetryBatchImuAdd(struct ImuBatch *batch, uint32_t tick, const struct ImuDataPacket *sample)
+{
+	if(batch->count < TELEMETRY_BATCH_MAX_SAMPLES)
+	{
+		batch->tick[batch->count] = tick;
+		batch->sample[batch->count] = *sample;
+		batch->count++;
+	}
+	return (batch->count >= TELEMETRY_BATCH_MAX_SAMPLES);
+}
+
+/**************************************************************************//**
+* @fn		bool TelemetryBatchImuReady(const struct ImuBatch *batch, uint32_t now, uint32_t windowTicks)
+* @brief	Checks if the batch must be published, either because it is full or because its oldest sample is older than the window
+* @param[in]	batch Batch to check
+* @param[in]	now Current tick
+* @param[in]	windowTicks Batch window, in ticks
+* @return	true if the batch must be published
+*****************************************************************************/
+bool TelemetryBatchImuReady(const struct ImuBatch *batch, uint32_t now, uint32_t windowTicks)
+{
+	if(batch->count == 0) return false;
+	return (batch->count >= TELEMETRY_BATCH_MAX_SAMPLES) || ((now - batch->tick[0]) >= windowTicks);
+}
+
+/**************************************************************************//**
+* @fn		void TelemetryBatchDistanceReset(struct DistanceBatch *batch)
+* @brief	Empties a distance batch
+* @param[in]	batch Batch to empty
+*****************************************************************************/
+void TelemetryBatchDistanceReset(struct DistanceBatch *batch)
+{
+	batch->count = 0;
+}
+
+/**************************************************************************//**
+* @fn		bool TelemetryBatchDistanceAdd(struct DistanceBatch *batch, uint32_t tick, uint16_t distance)
+* @brief	Adds a distance sample to the batch
+* @param[in]	batch Batch to add the sample to
+* @param[in]	tick Tick at which the sample was taken
+* @param[in]	distance Distance, in mm
+* @return	true if the batch is full after adding the sample and must be published. The sample is dropped if the batch was already full.
+*****************************************************************************/
+bool TelemetryBatchDistanceAdd(struct DistanceBatch *batch, uint32_t tick, uint16_t distance)
+{
+	if(batch->count < TELEMETRY_BATCH_MAX_SAMPLES)
+	{
+		batch->tick[batch->count] = tick;
+		batch->distance[batch->count] = distance;
+		batch->count++;
+	}
+	return (batch->count >= TELEMETRY_BATCH_MAX_SAMPLES);
+}
+
+/**************************************************************************//**
+* @fn		bool TelemetryBatchDistanceReady(const struct DistanceBatch *batch, uint32_t now, uint32_t windowTicks)
+* @brief	Checks if the batch must be published, either because it is full or because its oldest sample is older than the window
+* @param[in]	batch Batch to check
+* @param[in]	now Current tick
+* @param[in]	windowTicks Batch window, in ticks
+* @return	true if the batch must be published
+*****************************************************************************/
+bool TelemetryBatchDistanceReady(const struct DistanceBatch *batch, uint32_t now, uint32_t windowTicks)
+{
+	if(batch->count == 0) return false;
+	return (batch->count >= TELEMETRY_BATCH_MAX_SAMPLES) || ((now - batch->tick[0]) >= windowTicks);
+}
@@ -0,0 +1,66 @@
+/**************************************************************************//**
+* @file      TelemetryBatch.h
+* @brief     Batching of IMU and distance telemetry so that a whole window of samples is published as a single MQTT message.
+Samples are accumulated until either the time window expires or the batch is full. The batch is then encoded
+by the selected telemetry codec (see TelemetryCodec.h).
+
+******************************************************************************/
+
+
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "WifiHandlerThread/TelemetryPackets.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define TELEMETRY_BATCH_WINDOW_MS		1000	///<Maximum time a sample is held before its batch gets published
+#define TELEMETRY_BATCH_MAX_SAMPLES		12		///<Maximum number of samples per batch. Sized so a worst-case JSON IMU batch fits in TELEMETRY_BATCH_MSG_SIZE
+#define TELEMETRY_BATCH_MSG_SIZE		448		///<Size of the buffer used to encode a batch. Must stay below MAIN_MQTT_BUFFER_SIZE minus the MQTT header and topic
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Structure that holds a window of IMU samples waiting to be published
+struct ImuBatch
+{
+	uint8_t count;											///<Number of samples currently in the batch
+	uint32_t tick[TELEMETRY_BATCH_MAX_SAMPLES];				///<Tick at which each sample was taken
+	struct ImuDataPacket sample[TELEMETRY_BATCH_MAX_SAMPLES];	///<IMU samples
+};
+
+//Structure that holds a window of distance samples waiting to be published
+struct DistanceBatch
+{
+	uint8_t count;											///<Number of samples currently in the batch
+	uint32_t tick[TELEMETRY_BATCH_MAX_SAMPLES];				///<Tick at which each sample was taken
+	uint16_t distance[TELEMETRY_BATCH_MAX_SAMPLES];			///<Distance samples, in mm
+};
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+void TelemetryBatchImuReset(struct ImuBatch *batch);
+bool TelemetryBatchImuAdd(struct ImuBatch *batch, uint32_t tick, const struct ImuDataPacket *sample);
+bool TelemetryBatchImuReady(const struct ImuBatch *batch, uint32_t now, uint32_t windowTicks);
+
+void TelemetryBatchDistanceReset(struct DistanceBatch *batch);
+bool TelemetryBatchDistanceAdd(struct DistanceBatch *batch, uint32_t tick, uint16_t distance);
+bool TelemetryBatchDistanceReady(const struct DistanceBatch *batch, uint32_t now, uint32_t windowTicks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*TELEMETRY_BATCH_H*/
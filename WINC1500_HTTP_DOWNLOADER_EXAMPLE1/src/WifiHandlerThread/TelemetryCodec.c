@@ -0,0 +1,369 @@
+/**************************************************************************//**
+* @file      TelemetryCodec.c
+* @brief     Pluggable encoders for the telemetry published over MQTT, and the decoder for inbound game packets.
+
+******************************************************************************/
+
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "WifiHandlerThread/TelemetryCodec.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define TELEMETRY_BINARY_HEADER_SIZE		6	///<Type, count and first tick of a binary batch
+#define TELEMETRY_BINARY_IMU_SAMPLE_SIZE	8	///<dt, x, y, z
+#define TELEMETRY_BINARY_DIST_SAMPLE_SIZE	4	///<dt, d
+
+/******************************************************************************
+* Local Function Declaration
+******************************************************************************/
+static size_t JsonAppend(char *buffer, size_t length, size_t pos, const char *format, ...);
+static size_t JsonAppendDeltaArray(char *buffer, size_t length, size_t pos, const char *key, const int32_t *values, uint8_t count);
+static size_t JsonAppendTicks(char *buffer, size_t length, size_t pos, const uint32_t *tick, uint8_t count);
+static size_t JsonEncodeImu(const struct ImuBatch *batch, uint8_t *buffer, size_t length);
+static size_t JsonEncodeDistance(const struct DistanceBatch *batch, uint8_t *buffer, size_t length);
+static size_t JsonEncodeGame(const struct GameDataPacket *game, uint8_t *buffer, size_t length);
+static bool JsonDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game);
+
+static uint8_t *BinaryPut16(uint8_t *p, uint16_t value);
+static uint8_t *BinaryPut32(uint8_t *p, uint32_t value);
+static uint16_t BinaryDeltaTick(const uint32_t *tick, uint8_t index);
+static size_t BinaryEncodeImu(const struct ImuBatch *batch, uint8_t *buffer, size_t length);
+static size_t BinaryEncodeDistance(const struct DistanceBatch *batch, uint8_t *buffer, size_t length);
+static size_t BinaryEncodeGame(const struct GameDataPacket *game, uint8_t *buffer, size_t length);
+static bool BinaryDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game);
+
+/******************************************************************************
+* Global Variables
+******************************************************************************/
+const TelemetryCodec telemetryCodecJson = {"json", JsonEncodeImu, JsonEncodeDistance, JsonEncodeGame};		///<Timestamped, delta-encoded JSON codec
+const TelemetryCodec telemetryCodecBinary = {"binary", BinaryEncodeImu, BinaryEncodeDistance, BinaryEncodeGame};	///<Fixed packed binary codec
+
+/******************************************************************************
+* JSON Codec
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static size_t JsonAppend(char *buffer, size_t length, size_t pos, const char *format, ...)
+* @brief	Appends a formatted string at position pos of the buffer
+* @param[in]	buffer Buffer being encoded
+* @param[in]	length Total size of the buffer
+* @param[in]	pos Current write position. Zero means a previous append did not fit, since every payload starts with '{'.
+* @return	New write position, or 0 if the string did not fit in the buffer
+*****************************************************************************/
+static size_t JsonAppend(char *buffer, size_t length, size_t pos, const char *format, ...)
+{
+	va_list args;
+	int written;
+
+	if(pos == 0) return 0; //A previous append did not fit
+
+	va_start(args, format);
+	written = vsnprintf(&buffer[pos], length - pos, format, args);
+	va_end(args);
+
+	if(written < 0 || (size_t)written >= length - pos) return 0;
+	return pos + (size_t)written;
+}
+
+/**************************************************************************//**
+* @fn		static size_t JsonAppendDeltaArray(char *buffer, size_t length, size_t pos, const char *key, const int32_t *values, uint8_t count)
+* @brief	Appends ,"key":[v0,v1-v0,v2-v1,...] to the buffer
+* @return	New write position, or 0 if the array did not fit in the buffer
+*****************************************************************************/
+static size_t JsonAppendDeltaArray(char *buffer, size_t length, size_t pos, const char *key, const int32_t *values, uint8_t count)
+{
+	pos = JsonAppend(buffer, length, pos, ",\"%s\":[", key);
+	for(uint8_t i = 0; i < count && pos != 0; i++)
+	{
+		int32_t value = (i == 0) ? values[0] : values[i] - values[i - 1];
+		pos = JsonAppend(buffer, length, pos, (i == 0) ? "%ld" : ",%ld", (long)value);
+	}
+	return JsonAppend(buffer, length, pos, "]");
+}
+
+/**************************************************************************//**
+* @fn		static size_t JsonAppendTicks(char *buffer, size_t length, size_t pos, const uint32_t *tick, uint8_t count)
+* @brief	Appends "t":<first tick>,"dt":[0,t1-t0,...] to the buffer
+* @return	New write position, or 0 if the timestamps did not fit in the buffer
+*****************************************************************************/
+static size_t JsonAppendTicks(char *buffer, size_t length, size_t pos, const uint32_t *tick, uint8_t count)
+{
+	pos = JsonAppend(buffer, length, pos, "\"t\":%lu,\"dt\":[0", (unsigned long)tick[0]);
+	for(uint8_t i = 1; i < count && pos != 0; i++)
+	{
+		pos = JsonAppend(buffer, length, pos, ",%lu", (unsigned long)(tick[i] - tick[i - 1]));
+	}
+	return JsonAppend(buffer, length, pos, "]");
+}
+
+/**************************************************************************//**
+* @fn		static size_t JsonEncodeImu(const struct ImuBatch *batch, uint8_t *buffer, size_t length)
+* @brief	Encodes the IMU batch as a timestamped, delta-encoded JSON payload
+* @param[in]	batch Batch to encode. Must not be empty.
+* @param[out]	buffer Buffer where the NULL terminated payload is written
+* @param[in]	length Size of buffer
+* @return	Length of the payload, or 0 if the batch is empty or does not fit in the buffer
+*****************************************************************************/
+static size_t JsonEncodeImu(const struct ImuBatch *batch, uint8_t *buffer, size_t length)
+{
+	char *json = (char *)buffer;
+	int32_t axis[TELEMETRY_BATCH_MAX_SAMPLES];
+	size_t pos;
+
+	if(batch->count == 0 || length < 2) return 0;
+	json[0] = '{';
+	json[1] = '\0';
+
+	pos = JsonAppendTicks(json, length, 1, batch->tick, batch->count);
+
+	for(uint8_t i = 0; i < batch->count; i++) axis[i] = batch->sample[i].xmg;
+	pos = JsonAppendDeltaArray(json, length, pos, "x", axis, batch->count);
+	for(uint8_t i = 0; i < batch->count; i++) axis[i] = batch->sample[i].ymg;
+	pos = JsonAppendDeltaArray(json, length, pos, "y", axis, batch->count);
+	for(uint8_t i = 0; i < batch->count; i++) axis[i] = batch->sample[i].zmg;
+	pos = JsonAppendDeltaArray(json, length, pos, "z", axis, batch->count);
+
+	return JsonAppend(json, length, pos, "}");
+}
+
+/**************************************************************************//**
+* @fn		static size_t JsonEncodeDistance(const struct DistanceBatch *batch, uint8_t *buffer, size_t length)
+* @brief	Encodes the distance batch as a timestamped, delta-encoded JSON payload
+* @param[in]	batch Batch to encode. Must not be empty.
+* @param[out]	buffer Buffer where the NULL terminated payload is written
+* @param[in]	length Size of buffer
+* @return	Length of the payload, or 0 if the batch is empty or does not fit in the buffer
+*****************************************************************************/
+static size_t JsonEncodeDistance(const struct DistanceBatch *batch, uint8_t *buffer, size_t length)
+{
+	char *json = (char *)buffer;
+	int32_t distance[TELEMETRY_BATCH_MAX_SAMPLES];
+	size_t pos;
+
+	if(batch->count == 0 || length < 2) return 0;
+	json[0] = '{';
+	json[1] = '\0';
+
+	pos = JsonAppendTicks(json, length, 1, batch->tick, batch->count);
+
+	for(uint8_t i = 0; i < batch->count; i++) distance[i] = batch->distance[i];
+	pos = JsonAppendDeltaArray(json, length, pos, "d", distance, batch->count);
+
+	return JsonAppend(json, length, pos, "}");
+}
+
+/**************************************************************************//**
+* @fn		static size_t JsonEncodeGame(const struct GameDataPacket *game, uint8_t *buffer, size_t length)
+* @brief	Encodes a game as {"game":[m0,m1,...]}
+* @param[in]	game Game to encode. Moves equal to 0xFF end the game.
+* @param[out]	buffer Buffer where the NULL terminated payload is written
+* @param[in]	length Size of buffer
+* @return	Length of the payload, or 0 if it does not fit in the buffer
+*****************************************************************************/
+static size_t JsonEncodeGame(const struct GameDataPacket *game, uint8_t *buffer, size_t length)
+{
+	char *json = (char *)buffer;
+	size_t pos;
+
+	if(length < 2) return 0;
+	json[0] = '{';
+	json[1] = '\0';
+
+	pos = JsonAppend(json, length, 1, "\"game\":[");
+	for(uint8_t i = 0; i < GAME_SIZE && game->game[i] != 0xFF && pos != 0; i++)
+	{
+		pos = JsonAppend(json, length, pos, (i == 0) ? "%u" : ",%u", game->game[i]);
+	}
+	return JsonAppend(json, length, pos, "]}");
+}
+
+/**************************************************************************//**
+* @fn		static bool JsonDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game)
+* @brief	Decodes {"game":[m0,m1,...]}. Parsing is bounded by length, so the payload does not need to be NULL terminated.
+* @param[in]	payload Payload received
+* @param[in]	length Length of the payload
+* @param[out]	game Decoded game. Unused moves are set to 0xFF.
+* @return	true if the payload is a JSON game
+*****************************************************************************/
+static bool JsonDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game)
+{
+	static const char prefix[] = "{\"game\":[";
+	size_t pos = sizeof(prefix) - 1;
+	uint8_t nb = 0;
+
+	if(length < pos || memcmp(payload, prefix, pos) != 0) return false;
+
+	while(nb < GAME_SIZE && pos < length && payload[pos] >= '0' && payload[pos] <= '9')
+	{
+		uint16_t move = 0;
+		while(pos < length && payload[pos] >= '0' && payload[pos] <= '9')
+		{
+			move = (uint16_t)(move * 10 + (payload[pos++] - '0'));
+			if(move > 0xFF) return false;
+		}
+		game->game[nb++] = (uint8_t)move;
+		if(pos >= length || payload[pos] != ',') break;
+		pos++; /* skip, */
+	}
+	return true;
+}
+
+/******************************************************************************
+* Binary Codec
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static uint8_t *BinaryPut16(uint8_t *p, uint16_t value)
+* @brief	Writes a little-endian 16 bit value
+* @return	Pointer to the byte after the value
+*****************************************************************************/
+static uint8_t *BinaryPut16(uint8_t *p, uint16_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+	return p + 2;
+}
+
+/**************************************************************************//**
+* @fn		static uint8_t *BinaryPut32(uint8_t *p, uint32_t value)
+* @brief	Writes a little-endian 32 bit value
+* @return	Pointer to the byte after the value
+*****************************************************************************/
+static uint8_t *BinaryPut32(uint8_t *p, uint32_t value)
+{
+	p = BinaryPut16(p, (uint16_t)value);
+	return BinaryPut16(p, (uint16_t)(value >> 16));
+}
+
+/**************************************************************************//**
+* @fn		static uint16_t BinaryDeltaTick(const uint32_t *tick, uint8_t index)
+* @brief	Returns the tick delta between sample index and the previous one, saturated to 16 bits
+*****************************************************************************/
+static uint16_t BinaryDeltaTick(const uint32_t *tick, uint8_t index)
+{
+	uint32_t delta = (index == 0) ? 0 : tick[index] - tick[index - 1];
+	return (delta > 0xFFFF) ? 0xFFFF : (uint16_t)delta;
+}
+
+/**************************************************************************//**
+* @fn		static size_t BinaryEncodeImu(const struct ImuBatch *batch, uint8_t *buffer, size_t length)
+* @brief	Encodes the IMU batch with the packed binary schema
+* @return	Length of the payload, or 0 if the batch is empty or does not fit in the buffer
+*****************************************************************************/
+static size_t BinaryEncodeImu(const struct ImuBatch *batch, uint8_t *buffer, size_t length)
+{
+	size_t size = TELEMETRY_BINARY_HEADER_SIZE + (size_t)batch->count * TELEMETRY_BINARY_IMU_SAMPLE_SIZE;
+	uint8_t *p = buffer;
+
+	if(batch->count == 0 || size > length) return 0;
+
+	*p++ = TELEMETRY_BINARY_TYPE_IMU;
+	*p++ = batch->count;
+	p = BinaryPut32(p, batch->tick[0]);
+	for(uint8_t i = 0; i < batch->count; i++)
+	{
+		p = BinaryPut16(p, BinaryDeltaTick(batch->tick, i));
+		p = BinaryPut16(p, (uint16_t)batch->sample[i].xmg);
+		p = BinaryPut16(p, (uint16_t)batch->sample[i].ymg);
+		p = BinaryPut16(p, (uint16_t)batch->sample[i].zmg);
+	}
+	return size;
+}
+
+/**************************************************************************//**
+* @fn		static size_t BinaryEncodeDistance(const struct DistanceBatch *batch, uint8_t *buffer, size_t length)
+* @brief	Encodes the distance batch with the packed binary schema
+* @return	Length of the payload, or 0 if the batch is empty or does not fit in the buffer
+*****************************************************************************/
+static size_t BinaryEncodeDistance(const struct DistanceBatch *batch, uint8_t *buffer, size_t length)
+{
+	size_t size = TELEMETRY_BINARY_HEADER_SIZE + (size_t)batch->count * TELEMETRY_BINARY_DIST_SAMPLE_SIZE;
+	uint8_t *p = buffer;
+
+	if(batch->count == 0 || size > length) return 0;
+
+	*p++ = TELEMETRY_BINARY_TYPE_DISTANCE;
+	*p++ = batch->count;
+	p = BinaryPut32(p, batch->tick[0]);
+	for(uint8_t i = 0; i < batch->count; i++)
+	{
+		p = BinaryPut16(p, BinaryDeltaTick(batch->tick, i));
+		p = BinaryPut16(p, batch->distance[i]);
+	}
+	return size;
+}
+
+/**************************************************************************//**
+* @fn		static size_t BinaryEncodeGame(const struct GameDataPacket *game, uint8_t *buffer, size_t length)
+* @brief	Encodes a game with the packed binary schema
+* @return	Length of the payload, or 0 if it does not fit in the buffer
+*****************************************************************************/
+static size_t BinaryEncodeGame(const struct GameDataPacket *game, uint8_t *buffer, size_t length)
+{
+	uint8_t count = 0;
+
+	while(count < GAME_SIZE && game->game[count] != 0xFF) count++;
+	if((size_t)count + 2 > length) return 0;
+
+	buffer[0] = TELEMETRY_BINARY_TYPE_GAME;
+	buffer[1] = count;
+	memcpy(&buffer[2], game->game, count);
+	return (size_t)count + 2;
+}
+
+/**************************************************************************//**
+* @fn		static bool BinaryDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game)
+* @brief	Decodes a game encoded with the packed binary schema
+* @param[out]	game Decoded game. Unused moves are set to 0xFF.
+* @return	true if the payload is a well formed binary game
+*****************************************************************************/
+static bool BinaryDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game)
+{
+	if(length < 2 || payload[0] != TELEMETRY_BINARY_TYPE_GAME) return false;
+	if(payload[1] > GAME_SIZE || (size_t)payload[1] + 2 > length) return false;
+
+	memcpy(game->game, &payload[2], payload[1]);
+	return true;
+}
+
+/******************************************************************************
+* Global Functions
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		const TelemetryCodec *TelemetryCodecGet(void)
+* @brief	Returns the codec selected with TELEMETRY_CODEC
+*****************************************************************************/
+const TelemetryCodec *TelemetryCodecGet(void)
+{
+#if (TELEMETRY_CODEC == TELEMETRY_CODEC_BINARY)
+	return &telemetryCodecBinary;
+#else
+	return &telemetryCodecJson;
+#endif
+}
+
+/**************************************************************************//**
+* @fn		bool TelemetryCodecDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game)
+* @brief	Decodes an inbound game packet, either JSON or binary
+* @param[in]	payload Payload received
+* @param[in]	length Length of the payload
+* @param[out]	game Decoded game. Unused moves are set to 0xFF.
+* @return	true if the payload was understood
+*****************************************************************************/
+bool TelemetryCodecDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game)
+{
+	memset(game->game, 0xFF, sizeof(game->game));
+	if(length > 0 && payload[0] == '{')
+	{
+		return JsonDecodeGame(payload, length, game);
+	}
+	return BinaryDecodeGame(payload, length, game);
+}
@@ -0,0 +1,82 @@
+/**************************************************************************//**
+* @file      TelemetryCodec.h
+* @brief     Pluggable encoders for the telemetry published over MQTT, and the decoder for inbound game packets.
+Two codecs are provided and selected at compile time with TELEMETRY_CODEC:
+
+TELEMETRY_CODEC_JSON - timestamped, delta-encoded JSON. Compatible with the cloud dashboards.
+{"t":<tick of first sample>,"dt":[0,<tick deltas>...],"x":[<first value>,<deltas>...],"y":[...],"z":[...]}
+{"t":<tick of first sample>,"dt":[0,<tick deltas>...],"d":[<first value>,<deltas>...]}
+{"game":[<move>,<move>...]}
+
+TELEMETRY_CODEC_BINARY - fixed packed schema, all multi-byte fields little-endian.
+IMU:      'I' | count (u8) | t0 (u32) | count x { dt (u16) | x (i16) | y (i16) | z (i16) }
+Distance: 'D' | count (u8) | t0 (u32) | count x { dt (u16) | d (u16) }
+Game:     'G' | count (u8) | count x move (u8)
+dt is the tick delta to the previous sample (0 for the first one) and saturates at 0xFFFF.
+
+The game decoder accepts both formats regardless of the selected codec, so devices built with different codecs
+can still play against each other. This module only depends on the C standard library so it can also be built for a host.
+
+******************************************************************************/
+
+
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "WifiHandlerThread/TelemetryPackets.h"
+#include "WifiHandlerThread/TelemetryBatch.h"
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define TELEMETRY_CODEC_JSON		0	///<Timestamped, delta-encoded JSON
+#define TELEMETRY_CODEC_BINARY		1	///<Fixed packed binary schema
+
+#ifndef TELEMETRY_CODEC
+#define TELEMETRY_CODEC		TELEMETRY_CODEC_JSON	///<Codec used to publish telemetry. Change to TELEMETRY_CODEC_BINARY for the compact schema
+#endif
+
+#define TELEMETRY_BINARY_TYPE_IMU		'I'	///<Binary packet type for an IMU batch
+#define TELEMETRY_BINARY_TYPE_DISTANCE	'D'	///<Binary packet type for a distance batch
+#define TELEMETRY_BINARY_TYPE_GAME		'G'	///<Binary packet type for a game
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+///Set of encoders that make up a telemetry codec. Every encoder returns the payload length, or 0 if it does not fit in the buffer.
+typedef struct TelemetryCodec
+{
+	const char *name;	///<Name of the codec, for logs
+	size_t (*encodeImu)(const struct ImuBatch *batch, uint8_t *buffer, size_t length);				///<Encodes an IMU batch
+	size_t (*encodeDistance)(const struct DistanceBatch *batch, uint8_t *buffer, size_t length);	///<Encodes a distance batch
+	size_t (*encodeGame)(const struct GameDataPacket *game, uint8_t *buffer, size_t length);		///<Encodes a game. Moves equal to 0xFF end the game
+} TelemetryCodec;
+
+/******************************************************************************
+* Global Variables
+******************************************************************************/
+extern const TelemetryCodec telemetryCodecJson;
+extern const TelemetryCodec telemetryCodecBinary;
+
+/******************************************************************************
+* Global Function Declaration
+******************************************************************************/
+const TelemetryCodec *TelemetryCodecGet(void);
+bool TelemetryCodecDecodeGame(const uint8_t *payload, size_t length, struct GameDataPacket *game);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*TELEMETRY_CODEC_H*/
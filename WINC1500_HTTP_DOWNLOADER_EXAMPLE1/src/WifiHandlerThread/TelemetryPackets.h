@@ -0,0 +1,56 @@
+/**************************************************************************//**
+* @file      TelemetryPackets.h
+* @brief     Telemetry and game packet definitions shared by the Wifi handler and the telemetry codecs.
+This header only depends on the C standard library so the codecs can also be built for a host.
+
+******************************************************************************/
+
+
+#ifndef TELEMETRY_PACKETS_H
+#define TELEMETRY_PACKETS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+* Defines
+******************************************************************************/
+#define GAME_SIZE		20 ///<Number of plays in game
+
+/******************************************************************************
+* Structures and Enumerations
+******************************************************************************/
+
+//Structure definition that holds IMU data
+struct ImuDataPacket
+{
+	int16_t xmg;
+	int16_t ymg;
+	int16_t zmg;
+};
+
+//Structure to hold a game packet
+struct GameDataPacket
+{
+	uint8_t game[GAME_SIZE];
+};
+
+//Structure to hold an RGB LED Color packet
+struct RgbColorPacket
+{
+	uint8_t red;
+	uint8_t green;
+	uint8_t blue;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*TELEMETRY_PACKETS_H*/
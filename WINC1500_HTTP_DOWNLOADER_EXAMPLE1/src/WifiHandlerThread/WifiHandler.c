@@ -21,12 +21,38 @@
 #include "MQTTClient/Wrapper/mqtt.h"
 #include "SerialConsole.h"
 #include "WifiHandlerThread/WifiHandler.h"
+#include "WifiHandlerThread/TelemetryBatch.h"
+#include "WifiHandlerThread/TelemetryCodec.h"
+#include "WifiHandlerThread/SocketDemux.h"
+#include "WifiHandlerThread/MqttLink.h"
 #include "ControlThread/ControlThread.h"
 #include "UiHandlerThread/UiHandlerThread.h"
+#include "MemPool/MemPool.h"
 /******************************************************************************
 * Defines
 ******************************************************************************/
 
+//Structure that holds an IMU sample as stored on the IMU queue, stamped with the tick it was taken at
+struct ImuQueueItem
+{
+	uint32_t tick;
+	struct ImuDataPacket imu;
+};
+
+//Structure that holds a distance sample as stored on the distance queue, stamped with the tick it was taken at
+struct DistanceQueueItem
+{
+	uint32_t tick;
+	uint16_t distance;
+};
+
+//Structure that holds a message received on the game topic until the Wifi task parses it
+struct MqttInMessage
+{
+	uint16_t len;
+	uint8_t payload[WIFI_MQTT_IN_MSG_SIZE];
+};
+
 /******************************************************************************
 * Variables
 ******************************************************************************/
@@ -38,8 +64,20 @@ QueueHandle_t xQueueGameBuffer = NULL; ///<Queue to send the next play to the cl
 QueueHandle_t xQueueImuBuffer = NULL; ///<Queue to send IMU data to the cloud
 QueueHandle_t xQueueDistanceBuffer = NULL; ///<Queue to send the distance to the cloud
 
-volatile char mqtt_recv_msg [80]= "";
-bool flagParseGameIn = false; ///<Flag to parse a game input
+QueueHandle_t xQueueMqttIn = NULL; ///<Queue of game messages received from the broker, waiting to be parsed
+
+MEM_POOL_DEFINE(mqttMessagePool, "mqtt", sizeof(struct MqttInMessage), WIFI_MQTT_IN_QUEUE_LEN); ///<Messages of the game topic. A message is owned by whoever holds the pointer
+
+static StaticQueue_t xQueueWifiStateBuffer; ///<Storage of the queues created by the Wifi task
+static uint8_t xQueueWifiStateStorage[5 * sizeof(uint8_t)];
+static StaticQueue_t xQueueImuBufferBuffer;
+static uint8_t xQueueImuBufferStorage[WIFI_IMU_QUEUE_LEN * sizeof(struct ImuQueueItem)];
+static StaticQueue_t xQueueGameBufferBuffer;
+static uint8_t xQueueGameBufferStorage[2 * sizeof(struct GameDataPacket)];
+static StaticQueue_t xQueueDistanceBufferBuffer;
+static uint8_t xQueueDistanceBufferStorage[WIFI_DISTANCE_QUEUE_LEN * sizeof(struct DistanceQueueItem)];
+static StaticQueue_t xQueueMqttInBuffer;
+static uint8_t xQueueMqttInStorage[WIFI_MQTT_IN_QUEUE_LEN * sizeof(struct MqttInMessage *)];
 /*HTTP DOWNLOAD RELATED DEFINES AND VARIABLES*/
 
 uint8_t do_download_flag = false; //Flag that when true initializes a download. False to connect to MQTT broker
@@ -47,6 +85,9 @@ uint8_t do_download_flag = false; //Flag that when true initializes a download.
 static download_state down_state = NOT_READY;
 /** SD/MMC mount. */
 static FATFS fatfs;
+/** Serializes every FatFs call. FatFs is built without re-entrancy (_FS_REENTRANT 0). */
+static SemaphoreHandle_t storageMutex = NULL;
+static StaticSemaphore_t storageMutexBuffer;
 /** File pointer for file download. */
 static FIL file_object;
 /** Http content length. */
@@ -80,11 +121,24 @@ static struct mqtt_module mqtt_inst;
 static unsigned char mqtt_read_buffer[MAIN_MQTT_BUFFER_SIZE];
 static unsigned char mqtt_send_buffer[MAIN_MQTT_BUFFER_SIZE];
 
+/* Telemetry waiting to be published as a single message per window. */
+static struct ImuBatch imuBatch;
+static struct DistanceBatch distanceBatch;
+static uint8_t mqtt_batch_msg[TELEMETRY_BATCH_MSG_SIZE];
+static const TelemetryCodec *telemetryCodec = NULL; ///<Codec used to encode the telemetry and game packets that are published
+static struct MqttLink mqttLink; ///<Connection to the broker: reconnects, outage times and telemetry lost while it was down
+static volatile uint32_t wifiTelemetryDropped = 0; ///<Number of telemetry samples dropped because their queue was full
+
 
 
 /******************************************************************************
 * Forward Declarations
 ******************************************************************************/
+static void WifiPublishTelemetry(void);
+static void WifiHandleMqtt(void);
+static void WifiPublishImuBatch(void);
+static void WifiPublishDistanceBatch(void);
+static uint32_t WifiNowMs(void);
 
 /******************************************************************************
 * Callback Functions
@@ -134,8 +188,19 @@ static inline bool is_state_set(download_state mask)
 	return ((down_state & mask) != 0);
 }
 
+/**
+ * \brief Close the file being downloaded.
+ */
+static void close_download_file(void)
+{
+	xSemaphoreTake(storageMutex, portMAX_DELAY);
+	f_close(&file_object);
+	xSemaphoreGive(storageMutex);
+}
+
 /**
  * \brief File existing check.
+ * \note Call with storageMutex held.
  * \param[in] fp The file pointer to check.
  * \param[in] file_path_name The file name to check.
  * \return true if this file name is exist, false otherwise.
@@ -286,9 +351,11 @@ static void store_file_packet(char *data, uint32_t length)
 			return;
 		}
 
+		xSemaphoreTake(storageMutex, portMAX_DELAY);
 		rename_to_unique(&file_object, save_file_name, MAIN_MAX_FILE_NAME_LENGTH);
-		LogMessage(LOG_DEBUG_LVL,"store_file_packet: creating file [%s]\r\n", save_file_name);
 		ret = f_open(&file_object, (char const *)save_file_name, FA_CREATE_ALWAYS | FA_WRITE);
+		xSemaphoreGive(storageMutex);
+		LogMessage(LOG_DEBUG_LVL,"store_file_packet: creating file [%s]\r\n", save_file_name);
 		if (ret != FR_OK) {
 			LogMessage(LOG_DEBUG_LVL,"store_file_packet: file creation error! ret:%d\r\n", ret);
 			return;
@@ -300,9 +367,11 @@ static void store_file_packet(char *data, uint32_t length)
 
 	if (data != NULL) {
 		UINT wsize = 0;
+		xSemaphoreTake(storageMutex, portMAX_DELAY);
 		ret = f_write(&file_object, (const void *)data, length, &wsize);
+		xSemaphoreGive(storageMutex);
 		if (ret != FR_OK) {
-			f_close(&file_object);
+			close_download_file();
 			add_state(CANCELED);
 			LogMessage(LOG_DEBUG_LVL,"store_file_packet: file write error, download canceled.\r\n");
 			return;
@@ -311,7 +380,7 @@ static void store_file_packet(char *data, uint32_t length)
 		received_file_size += wsize;
 		LogMessage(LOG_DEBUG_LVL,"store_file_packet: received[%lu], file size[%lu]\r\n", (unsigned long)received_file_size, (unsigned long)http_file_size);
 		if (received_file_size >= http_file_size) {
-			f_close(&file_object);
+			close_download_file();
 			LogMessage(LOG_DEBUG_LVL,"store_file_packet: file downloaded successfully.\r\n");
 			port_pin_set_output_level(LED_0_PIN, false);
 			add_state(COMPLETED);
@@ -375,7 +444,7 @@ static void http_client_callback(struct http_client_module *module_inst, int typ
 		if (data->disconnected.reason == -EAGAIN) {
 			/* Server has not responded. Retry immediately. */
 			if (is_state_set(DOWNLOADING)) {
-				f_close(&file_object);
+				close_download_file();
 				clear_state(DOWNLOADING);
 			}
 
@@ -390,44 +459,6 @@ static void http_client_callback(struct http_client_module *module_inst, int typ
 	}
 }
 
-/**
- * \brief Callback to get the data from socket.
- *
- * \param[in] sock socket handler.
- * \param[in] u8Msg socket event type. Possible values are:
- *  - SOCKET_MSG_BIND
- *  - SOCKET_MSG_LISTEN
- *  - SOCKET_MSG_ACCEPT
- *  - SOCKET_MSG_CONNECT
- *  - SOCKET_MSG_RECV
- *  - SOCKET_MSG_SEND
- *  - SOCKET_MSG_SENDTO
- *  - SOCKET_MSG_RECVFROM
- * \param[in] pvMsg is a pointer to message structure. Existing types are:
- *  - tstrSocketBindMsg
- *  - tstrSocketListenMsg
- *  - tstrSocketAcceptMsg
- *  - tstrSocketConnectMsg
- *  - tstrSocketRecvMsg
- */
-static void socket_cb(SOCKET sock, uint8_t u8Msg, void *pvMsg)
-{
-	http_client_socket_event_handler(sock, u8Msg, pvMsg);
-}
-
-/**
- * \brief Callback for the gethostbyname function (DNS Resolution callback).
- * \param[in] pu8DomainName Domain name of the host.
- * \param[in] u32ServerIP Server IPv4 address encoded in NW byte order format. If it is Zero, then the DNS resolution failed.
- */
-static void resolve_cb(uint8_t *pu8DomainName, uint32_t u32ServerIP)
-{
-	LogMessage(LOG_DEBUG_LVL,"resolve_cb: %s IP address is %d.%d.%d.%d\r\n\r\n", pu8DomainName,
-			(int)IPV4_BYTE(u32ServerIP, 0), (int)IPV4_BYTE(u32ServerIP, 1),
-			(int)IPV4_BYTE(u32ServerIP, 2), (int)IPV4_BYTE(u32ServerIP, 3));
-	http_client_socket_resolve_handler(pu8DomainName, u32ServerIP);
-}
-
 /**
  * \brief Callback to get the Wi-Fi status update.
  *
@@ -466,7 +497,7 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
 			LogMessage(LOG_DEBUG_LVL,"wifi_cb: M2M_WIFI_DISCONNECTED\r\n");
 			clear_state(WIFI_CONNECTED);
 			if (is_state_set(DOWNLOADING)) {
-				f_close(&file_object);
+				close_download_file();
 				clear_state(DOWNLOADING);
 			}
 
@@ -493,19 +524,18 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
 				pu8IPAddress[0], pu8IPAddress[1], pu8IPAddress[2], pu8IPAddress[3]);
 		add_state(WIFI_CONNECTED);
 
+		/* Let the WINC sleep between beacons. The driver wakes it up before every access from the host. */
+		tstrM2mLsnInt listenInterval = {.u16LsnInt = WIFI_POWER_SAVE_LISTEN_INT};
+		m2m_wifi_set_lsn_int(&listenInterval);
+		m2m_wifi_set_sleep_mode(WIFI_POWER_SAVE_MODE, 1);
+
 		if(do_download_flag == 1)
 		{
 			start_download();
-		
-		}
-		else
-		{
-				/* Try to connect to MQTT broker when Wi-Fi was connected. */
-		if (mqtt_connect(&mqtt_inst, main_mqtt_broker))
-		{
-			LogMessage(LOG_DEBUG_LVL,"Error connecting to MQTT Broker!\r\n");
-		}
 		}
+
+		/* Try to connect to MQTT broker when Wi-Fi was connected. */
+		MqttLinkConnect(&mqttLink, WifiNowMs());
 	}
 		break;
 	
@@ -523,6 +553,10 @@ void init_storage(void)
 	FRESULT res;
 	Ctrl_status status;
 
+	if (storageMutex == NULL) {
+		storageMutex = xSemaphoreCreateMutexStatic(&storageMutexBuffer);
+	}
+
 	/* Initialize SD/MMC stack. */
 	sd_mmc_init();
 	while (true) {
@@ -618,43 +652,12 @@ static void configure_http_client(void)
 
 /*MQTT RELATED STATIC FUNCTIONS*/
 
-/** Prototype for MQTT subscribe Callback */
-void SubscribeHandler(MessageData *msgData);
-
-
-
 
-/**
- * \brief Callback to get the Socket event.
- *
- * \param[in] Socket descriptor.
- * \param[in] msg_type type of Socket notification. Possible types are:
- *  - [SOCKET_MSG_CONNECT](@ref SOCKET_MSG_CONNECT)
- *  - [SOCKET_MSG_BIND](@ref SOCKET_MSG_BIND)
- *  - [SOCKET_MSG_LISTEN](@ref SOCKET_MSG_LISTEN)
- *  - [SOCKET_MSG_ACCEPT](@ref SOCKET_MSG_ACCEPT)
- *  - [SOCKET_MSG_RECV](@ref SOCKET_MSG_RECV)
- *  - [SOCKET_MSG_SEND](@ref SOCKET_MSG_SEND)
- *  - [SOCKET_MSG_SENDTO](@ref SOCKET_MSG_SENDTO)
- *  - [SOCKET_MSG_RECVFROM](@ref SOCKET_MSG_RECVFROM)
- * \param[in] msg_data A structure contains notification informations.
- */
-static void socket_event_handler(SOCKET sock, uint8_t msg_type, void *msg_data)
-{
-	mqtt_socket_event_handler(sock, msg_type, msg_data);
-}
 
 
-/**
- * \brief Callback of gethostbyname function.
- *
- * \param[in] doamin_name Domain name.
- * \param[in] server_ip IP of server.
- */
-static void socket_resolve_handler(uint8_t *doamin_name, uint32_t server_ip)
-{
-	mqtt_socket_resolve_handler(doamin_name, server_ip);
-}
+/* Protocol services that share the WINC sockets through the socket demultiplexer. */
+static const SocketDemuxService httpSocketService = {"http", http_client_is_socket, http_client_is_resolving, http_client_socket_event_handler, http_client_socket_resolve_handler};
+static const SocketDemuxService mqttSocketService = {"mqtt", mqtt_is_socket, mqtt_is_resolving, mqtt_socket_event_handler, mqtt_socket_resolve_handler};
 
 
 /**
@@ -682,14 +685,34 @@ void SubscribeHandlerLedTopic(MessageData *msgData)
 	LogMessage(LOG_DEBUG_LVL,"\r\nRGB %d %d %d\r\n", rgb[0], rgb[1], rgb[2]);
 	UIChangeColors(rgb[0],rgb[1], rgb[2]);
 	}
+	else if (msgData->message->payloadlen == strlen(LED_TOPIC_LED_OFF) && strncmp((char *)msgData->message->payload, LED_TOPIC_LED_OFF, msgData->message->payloadlen) == 0)
+	{
+		port_pin_set_output_level(LED_0_PIN, LED_0_INACTIVE);
+	}
+	else if (msgData->message->payloadlen == strlen(LED_TOPIC_LED_ON) && strncmp((char *)msgData->message->payload, LED_TOPIC_LED_ON, msgData->message->payloadlen) == 0)
+	{
+		port_pin_set_output_level(LED_0_PIN, LED_0_ACTIVE);
+	}
 }
 
 void SubscribeHandlerGameTopic(MessageData *msgData)
 {
 
-	flagParseGameIn = true;
-	memcpy(mqtt_recv_msg,msgData->message->payload , msgData->message->payloadlen);
-	LogMessage(LOG_DEBUG_LVL,"%.*s",msgData->message->payloadlen,(char *)msgData->message->payload);
+	//Runs inside mqtt_yield() on the Wifi task. Keep the message until the task parses it after the yield
+	struct MqttInMessage *msg = MemPoolAlloc(&mqttMessagePool);
+	if(msg == NULL)
+	{
+		LogMessage(LOG_DEBUG_LVL,"\r\nGame message dropped: no free message!\r\n");
+		return;
+	}
+
+	msg->len = (msgData->message->payloadlen < sizeof(msg->payload)) ? msgData->message->payloadlen : sizeof(msg->payload);
+	memcpy(msg->payload, msgData->message->payload, msg->len);
+	if(pdPASS != xQueueSend(xQueueMqttIn, &msg, 0))
+	{
+		MemPoolFree(&mqttMessagePool, msg);
+		LogMessage(LOG_DEBUG_LVL,"\r\nGame message dropped: queue full!\r\n");
+	}
 	return;
 }
 
@@ -704,29 +727,6 @@ void SubscribeHandlerDistanceTopic(MessageData *msgData)
 }
 
 
-void SubscribeHandler(MessageData *msgData)
-{
-	/* You received publish message which you had subscribed. */
-	/* Print Topic and message */
-	LogMessage(LOG_DEBUG_LVL,"\r\n %.*s",msgData->topicName->lenstring.len,msgData->topicName->lenstring.data);
-	LogMessage(LOG_DEBUG_LVL," >> ");
-	LogMessage(LOG_DEBUG_LVL,"%.*s",msgData->message->payloadlen,(char *)msgData->message->payload);	
-
-	//Handle LedData message
-	if(strncmp((char *) msgData->topicName->lenstring.data, LED_TOPIC, msgData->message->payloadlen) == 0)
-	{
-		if(strncmp((char *)msgData->message->payload, LED_TOPIC_LED_OFF, msgData->message->payloadlen) == 0)
-		{
-			port_pin_set_output_level(LED_0_PIN, LED_0_INACTIVE);
-		} 
-		else if (strncmp((char *)msgData->message->payload, LED_TOPIC_LED_ON, msgData->message->payloadlen) == 0)
-		{
-			port_pin_set_output_level(LED_0_PIN, LED_0_ACTIVE);
-		}
-	}
-}
-
-
 /**
  * \brief Callback to get the MQTT status update.
  *
@@ -752,7 +752,7 @@ static void mqtt_callback(struct mqtt_module *module_inst, int type, union mqtt_
 		 */
 		if (data->sock_connected.result >= 0) {
 			LogMessage(LOG_DEBUG_LVL,"\r\nConnecting to Broker...");
-			if(0 != mqtt_connect_broker(module_inst, 1, CLOUDMQTT_USER_ID, CLOUDMQTT_USER_PASSWORD, CLOUDMQTT_USER_ID, NULL, NULL, 0, 1, 0))
+			if(0 != mqtt_connect_broker(module_inst, MQTT_CLEAN_SESSION, CLOUDMQTT_USER_ID, CLOUDMQTT_USER_PASSWORD, CLOUDMQTT_CLIENT_ID, NULL, NULL, 0, 1, 0))
 			{
 				LogMessage(LOG_DEBUG_LVL,"MQTT  Error - NOT Connected to broker\r\n");
 			}
@@ -761,22 +761,30 @@ static void mqtt_callback(struct mqtt_module *module_inst, int type, union mqtt_
 				LogMessage(LOG_DEBUG_LVL,"MQTT Connected to broker\r\n");
 			}
 		} else {
-			LogMessage(LOG_DEBUG_LVL,"Connect fail to server(%s)! retry it automatically.\r\n", main_mqtt_broker);
-			mqtt_connect(module_inst, main_mqtt_broker); /* Retry that. */
+			/* The Wifi task retries from WIFI_MQTT_INIT, MQTT_LINK_RETRY_MS later. */
+			LogMessage(LOG_DEBUG_LVL,"Connect fail to server(%s)! Retrying in %d ms.\r\n", main_mqtt_broker, MQTT_LINK_RETRY_MS);
 		}
 	}
 	break;
 
 	case MQTT_CALLBACK_CONNECTED:
 		if (data->connected.result == MQTT_CONN_RESULT_ACCEPT) {
-			/* Subscribe chat topic. */
-			mqtt_subscribe(module_inst, GAME_TOPIC_IN, 2, SubscribeHandlerGameTopic);
-			mqtt_subscribe(module_inst, LED_TOPIC, 2, SubscribeHandlerLedTopic);
-			//mqtt_subscribe(module_inst, IMU_TOPIC, 2, SubscribeHandlerImuTopic);
-			//mqtt_subscribe(module_inst, DISTANCE_TOPIC, 2, SubscribeHandlerDistanceTopic);
-			/* Enable USART receiving callback. */
-			
-			LogMessage(LOG_DEBUG_LVL,"MQTT Connected\r\n");
+			/* The broker keeps the subscriptions of a persistent session, and the handlers stay registered in the client. */
+			if(!data->connected.session_present)
+			{
+				/* Subscribe chat topic. */
+				mqtt_subscribe(module_inst, GAME_TOPIC_IN, 2, SubscribeHandlerGameTopic);
+				mqtt_subscribe(module_inst, LED_TOPIC, 2, SubscribeHandlerLedTopic);
+				//mqtt_subscribe(module_inst, IMU_TOPIC, 2, SubscribeHandlerImuTopic);
+				//mqtt_subscribe(module_inst, DISTANCE_TOPIC, 2, SubscribeHandlerDistanceTopic);
+			}
+
+			MqttLinkConnected(&mqttLink, data->connected.session_present, WifiNowMs());
+			LogMessage(LOG_DEBUG_LVL,"MQTT Connected (session %s) after %lu ms down. Telemetry samples lost so far: %lu published while down, %lu dropped from full queues\r\n",
+				data->connected.session_present ? "resumed" : "new",
+				(unsigned long)mqttLink.stats.lastOutageMs,
+				(unsigned long)mqttLink.stats.samplesLost,
+				(unsigned long)wifiTelemetryDropped);
 		} else {
 			/* Cannot connect for some reason. */
 			LogMessage(LOG_DEBUG_LVL,"MQTT broker decline your access! error code %d\r\n", data->connected.result);
@@ -785,8 +793,9 @@ static void mqtt_callback(struct mqtt_module *module_inst, int type, union mqtt_
 		break;
 
 	case MQTT_CALLBACK_DISCONNECTED:
-		/* Stop timer and USART callback. */
-		LogMessage(LOG_DEBUG_LVL,"MQTT disconnected\r\n");
+		/* The Wifi task moves to WIFI_MQTT_INIT and reconnects. */
+		MqttLinkDisconnected(&mqttLink, WifiNowMs());
+		LogMessage(LOG_DEBUG_LVL,"MQTT disconnected (%d)\r\n", data->disconnected.reason);
 		//usart_disable_callback(&cdc_uart_module, USART_CALLBACK_BUFFER_RECEIVED);
 		break;
 	}
@@ -809,7 +818,7 @@ static void configure_mqtt(void)
 	mqtt_conf.send_buffer = mqtt_send_buffer;
 	mqtt_conf.send_buffer_size = MAIN_MQTT_BUFFER_SIZE;
 	mqtt_conf.port = CLOUDMQTT_PORT;
-	mqtt_conf.keep_alive = 6000;
+	mqtt_conf.keep_alive = MQTT_KEEP_ALIVE_S;
 	
 	result = mqtt_init(&mqtt_inst, &mqtt_conf);
 	if (result < 0) {
@@ -824,6 +833,8 @@ static void configure_mqtt(void)
 		while (1) {
 		}
 	}
+
+	MqttLinkInit(&mqttLink, &mqtt_inst, main_mqtt_broker, WifiNowMs());
 }
 
 //SETUP FOR EXTERNAL BUTTON INTERRUPT -- Used to send an MQTT Message
@@ -879,12 +890,18 @@ void vWifiTask( void *pvParameters )
 	vTaskDelay(100);
 	init_state();
 	//Create buffers to send data
-	xQueueWifiState = xQueueCreate( 5, sizeof( uint32_t ) );
-	xQueueImuBuffer  = xQueueCreate( 5, sizeof( struct ImuDataPacket ) );
-	xQueueGameBuffer = xQueueCreate( 2, sizeof( struct GameDataPacket ) );
-	xQueueDistanceBuffer = xQueueCreate ( 5, sizeof( uint16_t ) );
-
-	if(xQueueWifiState == NULL || xQueueImuBuffer == NULL || xQueueGameBuffer == NULL || xQueueDistanceBuffer == NULL)
+	xQueueWifiState = xQueueCreateStatic( 5, sizeof( uint8_t ), xQueueWifiStateStorage, &xQueueWifiStateBuffer );
+	xQueueImuBuffer  = xQueueCreateStatic( WIFI_IMU_QUEUE_LEN, sizeof( struct ImuQueueItem ), xQueueImuBufferStorage, &xQueueImuBufferBuffer );
+	xQueueGameBuffer = xQueueCreateStatic( 2, sizeof( struct GameDataPacket ), xQueueGameBufferStorage, &xQueueGameBufferBuffer );
+	xQueueDistanceBuffer = xQueueCreateStatic ( WIFI_DISTANCE_QUEUE_LEN, sizeof( struct DistanceQueueItem ), xQueueDistanceBufferStorage, &xQueueDistanceBufferBuffer );
+	xQueueMqttIn = xQueueCreateStatic( WIFI_MQTT_IN_QUEUE_LEN, sizeof( struct MqttInMessage * ), xQueueMqttInStorage, &xQueueMqttInBuffer );
+	MemPoolRegister(&mqttMessagePool);
+	TelemetryBatchImuReset(&imuBatch);
+	TelemetryBatchDistanceReset(&distanceBatch);
+	telemetryCodec = TelemetryCodecGet();
+	LogMessage(LOG_DEBUG_LVL,"Telemetry codec: %s\r\n", telemetryCodec->name);
+
+	if(xQueueWifiState == NULL || xQueueImuBuffer == NULL || xQueueGameBuffer == NULL || xQueueDistanceBuffer == NULL || xQueueMqttIn == NULL)
 	{
 		SerialConsoleWriteString("ERROR Initializing Wifi Data queues!\r\n");
 	}
@@ -923,9 +940,11 @@ void vWifiTask( void *pvParameters )
 
 	LogMessage(LOG_DEBUG_LVL,"main: connecting to WiFi AP %s...\r\n", (char *)MAIN_WLAN_SSID);
 	
-	//Re-enable socket for MQTT Transfer
+	//Sockets are initialized once. HTTP and MQTT share them through the socket demultiplexer.
+	SocketDemuxRegister(&httpSocketService);
+	SocketDemuxRegister(&mqttSocketService);
 	socketInit();
-	registerSocketCallback(socket_event_handler, socket_resolve_handler);
+	registerSocketCallback(SocketDemuxEventHandler, SocketDemuxResolveHandler);
 
 	m2m_wifi_connect((char *)MAIN_WLAN_SSID, sizeof(MAIN_WLAN_SSID), MAIN_WLAN_AUTH, (char *)MAIN_WLAN_PSK, M2M_WIFI_CH_ALL);
 
@@ -947,22 +966,14 @@ void vWifiTask( void *pvParameters )
 
 			case(WIFI_MQTT_INIT):
 			{
-			
-				socketDeinit();
-				configure_mqtt();
-				//Re-enable socket for MQTT Transfer
-				registerSocketCallback(socket_event_handler, socket_resolve_handler);
-				socketInit();
-				/* Connect to router. */
-				if(!(mqtt_inst.isConnected))
-				{		
-				if (mqtt_connect(&mqtt_inst, main_mqtt_broker))
-					{
-						LogMessage(LOG_DEBUG_LVL,"Error connecting to MQTT Broker!\r\n");
-					}
+				//The MQTT client, its subscriptions and the sockets are kept. Only the broker connection is restored.
+				//Attempts are spaced by MQTT_LINK_RETRY_MS, and telemetry keeps being drained (and counted as lost) in between.
+				if(is_state_set(WIFI_CONNECTED))
+				{
+					MqttLinkConnect(&mqttLink, WifiNowMs());
 				}
 
-				if(mqtt_inst.isConnected)
+				if(MqttLinkIsUp(&mqttLink))
 				{
 					LogMessage(LOG_DEBUG_LVL,"Connected to MQTT Broker!\r\n");
 				}
@@ -979,82 +990,20 @@ void vWifiTask( void *pvParameters )
 			m2m_wifi_handle_events(NULL);
 			sw_timer_task(&swt_module_inst);
 
-
-			//Check if data has to be sent!
-			struct ImuDataPacket imuDataVar;
-			uint16_t distBuffer;
-			struct GameDataPacket gamePacket;
-			if (pdPASS == xQueueReceive( xQueueImuBuffer , &imuDataVar, 0 ))
-			{
-				snprintf(mqtt_msg, 63, "{\"imux\":%d, \"imuy\": %d, \"imuz\": %d}", imuDataVar.xmg, imuDataVar.ymg, imuDataVar.zmg);
-				mqtt_publish(&mqtt_inst, IMU_TOPIC, mqtt_msg, strlen(mqtt_msg), 1, 0);
-			} if (pdPASS == xQueueReceive( xQueueDistanceBuffer , &distBuffer, 0 ))
-			{
-				snprintf(mqtt_msg, 63, "{\"distance\":%u}", distBuffer);
-				mqtt_publish(&mqtt_inst, DISTANCE_TOPIC, mqtt_msg, strlen(mqtt_msg), 1, 0);
-			} if  (pdPASS == xQueueReceive( xQueueGameBuffer , &gamePacket, 0 ))
+			WifiHandleMqtt();
+			//A failed publish or yield, or a socket closed by the broker, drops the connection
+			if(!MqttLinkIsUp(&mqttLink))
 			{
-				snprintf(mqtt_msg, 63, "{\"game\":[");
-				for(int iter = 0; iter < GAME_SIZE; iter++)
-				{
-					char numGame[5];
-					if(gamePacket.game[iter] != 0xFF)
-					{
-						snprintf(numGame, 3, "%d", gamePacket.game[iter]);
-						strcat(mqtt_msg, numGame);
-						if(gamePacket.game[iter+1] != 0xFF && iter+1 <GAME_SIZE)
-						{
-							snprintf(numGame, 5, ",");
-							strcat(mqtt_msg, numGame);
-						}
-					}else
-					{
-						break;
-					}
-				}
-				strcat(mqtt_msg, "]}");
-				LogMessage(LOG_DEBUG_LVL,mqtt_msg);LogMessage(LOG_DEBUG_LVL,"\r\n");
-				vTaskSuspendAll( );
-				int rc = mqtt_publish(&mqtt_inst, GAME_TOPIC_OUT, mqtt_msg, strlen(mqtt_msg), 1, 0);
-				xTaskResumeAll();
-				LogMessage(LOG_DEBUG_LVL,"rc = %d\r\n", rc);
-			}	
-
-			//Handle MQTT messages
-			if(mqtt_inst.isConnected)
-				mqtt_yield(&mqtt_inst, 100);
-
-
-
-			//Parse MQTT Game in
-			if(	flagParseGameIn == true)
-			{
-					flagParseGameIn = false;
-					WifiGameParse();
+				wifiStateMachine = WIFI_MQTT_INIT;
 			}
-
 			break;
 			}
 
 			case(WIFI_DOWNLOAD_INIT):
 			{
-
-				if(mqtt_disconnect(&mqtt_inst, main_mqtt_broker))
-				{
-					LogMessage(LOG_DEBUG_LVL,"Error connecting to MQTT Broker!\r\n");
-				}
-				while((mqtt_inst.isConnected))
-				{
-				m2m_wifi_handle_events(NULL);
-				}
-				socketDeinit();
-				//DOWNLOAD A FILE
+				//DOWNLOAD A FILE. The MQTT connection stays up, both share the socket callbacks.
 				do_download_flag = true;
-				/* Register socket callback function. */
-				registerSocketCallback(socket_cb, resolve_cb);
-				/* Initialize socket module. */
-				socketInit();
-
+				clear_state(COMPLETED | CANCELED);
 				start_download();
 				wifiStateMachine = WIFI_DOWNLOAD_HANDLE;
 				break;
@@ -1062,28 +1011,41 @@ void vWifiTask( void *pvParameters )
 
 			case(WIFI_DOWNLOAD_HANDLE):
 			{
-
-			/* Connect to router. */
-			while (!(is_state_set(COMPLETED) || is_state_set(CANCELED))) {
+			/* Give the download most of the radio time, then keep the MQTT session serviced. */
+			TickType_t sliceStart = xTaskGetTickCount();
+			while (!(is_state_set(COMPLETED) || is_state_set(CANCELED)) && (xTaskGetTickCount() - sliceStart) < pdMS_TO_TICKS(WIFI_DOWNLOAD_SLICE_MS)) {
 				/* Handle pending events from network controller. */
 				m2m_wifi_handle_events(NULL);
 				/* Checks the timer timeout. */
 				sw_timer_task(&swt_module_inst);
 			}
+			WifiHandleMqtt();
+			if (!(is_state_set(COMPLETED) || is_state_set(CANCELED)))
+			{
+				//Do not wait for the end of the download to restore the broker connection
+				if(!MqttLinkIsUp(&mqttLink) && is_state_set(WIFI_CONNECTED))
+				{
+					MqttLinkConnect(&mqttLink, WifiNowMs());
+				}
+				break;
+			}
+
 			LogMessage(LOG_DEBUG_LVL,"main: please unplug the SD/MMC card.\r\n");
 			LogMessage(LOG_DEBUG_LVL,"main: done.\r\n");
-			//Disable socket for HTTP Transfer
-			socketDeinit();
-			vTaskDelay(1000);
-			//CONNECT TO MQTT BROKER
 			do_download_flag = false;
 
 			//Write Flag
 			char test_file_name[] = "0:FlagA.txt";
 			test_file_name[0] = LUN_ID_SD_MMC_0_MEM + '0';
+			xSemaphoreTake(storageMutex, portMAX_DELAY);
 			FRESULT res = f_open(&file_object,
 			(char const *)test_file_name,
 			FA_CREATE_ALWAYS | FA_WRITE);
+			if (res == FR_OK)
+			{
+				f_close(&file_object);
+			}
+			xSemaphoreGive(storageMutex);
 
 			if (res != FR_OK)
 			{
@@ -1093,7 +1055,7 @@ void vWifiTask( void *pvParameters )
 			{
 				SerialConsoleWriteString("FlagB.txt added!\r\n");
 			}
-			wifiStateMachine = WIFI_MQTT_INIT;
+			wifiStateMachine = MqttLinkIsUp(&mqttLink) ? WIFI_MQTT_HANDLE : WIFI_MQTT_INIT;
 			break;
 			}
 
@@ -1109,32 +1071,127 @@ void vWifiTask( void *pvParameters )
 		wifiStateMachine = DataToReceive; // Update new state
 	}
 	
-	vTaskDelay(100);	
+	//Sleep until the next pass, or earlier if an HTTP timer expires before it
+	uint32_t timerTicks = sw_timer_get_next_expiry(&swt_module_inst);
+	vTaskDelay((timerTicks < pdMS_TO_TICKS(WIFI_TASK_PERIOD_MS)) ? timerTicks : pdMS_TO_TICKS(WIFI_TASK_PERIOD_MS));
 	}
 	return 0;
 }
 
 
 
-void WifiGameParse(void)
+/**************************************************************************//**
+* @fn		static void WifiHandleMqtt(void)
+* @brief	Publishes pending telemetry and game packets, services the MQTT connection and parses inbound games
+* @note		Called from the WIFI_MQTT_HANDLE state, and between download slices so that a download does not stop telemetry.
+*****************************************************************************/
+static void WifiHandleMqtt(void)
+{
+	//Check if data has to be sent!
+	struct GameDataPacket gamePacket;
+	WifiPublishTelemetry();
+	//Game packets wait in their queue while the broker is down, and are sent once it is back
+	if  (MqttLinkIsUp(&mqttLink) && pdPASS == xQueueReceive( xQueueGameBuffer , &gamePacket, 0 ))
+	{
+		size_t len = telemetryCodec->encodeGame(&gamePacket, mqtt_batch_msg, sizeof(mqtt_batch_msg));
+		if(len > 0)
+		{
+			vTaskSuspendAll( );
+			int rc = mqtt_publish(&mqtt_inst, GAME_TOPIC_OUT, (char *)mqtt_batch_msg, len, 1, 0);
+			xTaskResumeAll();
+			LogMessage(LOG_DEBUG_LVL,"rc = %d\r\n", rc);
+		}else
+		{
+			LogMessage(LOG_DEBUG_LVL,"Game packet could not be encoded!\r\n");
+		}
+	}	
+
+	//Handle MQTT messages
+	if(MqttLinkIsUp(&mqttLink))
+		mqtt_yield(&mqtt_inst, 100);
+
+	//Parse MQTT Game in
+	struct MqttInMessage *msg;
+	while(pdPASS == xQueueReceive(xQueueMqttIn, &msg, 0))
+	{
+		WifiGameParse(msg->payload, msg->len);
+		MemPoolFree(&mqttMessagePool, msg);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void WifiPublishImuBatch(void)
+* @brief	Publishes the IMU batch as a single MQTT message and empties it
+*****************************************************************************/
+static void WifiPublishImuBatch(void)
+{
+	size_t len = telemetryCodec->encodeImu(&imuBatch, mqtt_batch_msg, sizeof(mqtt_batch_msg));
+	if(len > 0)
+	{
+		MqttLinkPublish(&mqttLink, IMU_TOPIC, mqtt_batch_msg, len, imuBatch.count);
+	}else
+	{
+		LogMessage(LOG_DEBUG_LVL,"IMU batch does not fit in message buffer!\r\n");
+	}
+	TelemetryBatchImuReset(&imuBatch);
+}
+
+/**************************************************************************//**
+* @fn		static void WifiPublishDistanceBatch(void)
+* @brief	Publishes the distance batch as a single MQTT message and empties it
+*****************************************************************************/
+static void WifiPublishDistanceBatch(void)
+{
+	size_t len = telemetryCodec->encodeDistance(&distanceBatch, mqtt_batch_msg, sizeof(mqtt_batch_msg));
+	if(len > 0)
+	{
+		MqttLinkPublish(&mqttLink, DISTANCE_TOPIC, mqtt_batch_msg, len, distanceBatch.count);
+	}else
+	{
+		LogMessage(LOG_DEBUG_LVL,"Distance batch does not fit in message buffer!\r\n");
+	}
+	TelemetryBatchDistanceReset(&distanceBatch);
+}
+
+/**************************************************************************//**
+* @fn		static void WifiPublishTelemetry(void)
+* @brief	Drains the IMU and distance queues into their batches and publishes each batch as a single
+*			MQTT message once it is full or its window has expired.
+* @note		Called from the WIFI_MQTT_HANDLE state.
+*****************************************************************************/
+static void WifiPublishTelemetry(void)
+{
+	struct ImuQueueItem imuItem;
+	struct DistanceQueueItem distanceItem;
+
+	while (pdPASS == xQueueReceive( xQueueImuBuffer , &imuItem, 0 ))
+	{
+		if(TelemetryBatchImuAdd(&imuBatch, imuItem.tick, &imuItem.imu)) WifiPublishImuBatch();
+	}
+	if(TelemetryBatchImuReady(&imuBatch, xTaskGetTickCount(), pdMS_TO_TICKS(TELEMETRY_BATCH_WINDOW_MS)))
+	{
+		WifiPublishImuBatch();
+	}
+
+	while (pdPASS == xQueueReceive( xQueueDistanceBuffer , &distanceItem, 0 ))
+	{
+		if(TelemetryBatchDistanceAdd(&distanceBatch, distanceItem.tick, distanceItem.distance)) WifiPublishDistanceBatch();
+	}
+	if(TelemetryBatchDistanceReady(&distanceBatch, xTaskGetTickCount(), pdMS_TO_TICKS(TELEMETRY_BATCH_WINDOW_MS)))
+	{
+		WifiPublishDistanceBatch();
+	}
+}
+
+
+void WifiGameParse(const uint8_t *payload, uint16_t len)
 {
 struct GameDataPacket game;
-memset(game.game, 0xff, sizeof(game.game));
 
-//Parse input. The start string must be '{"game":['
-if (strncmp(mqtt_recv_msg, "{\"game\":[", 9) == 0)
+//Parse input. The decoder accepts both JSON '{"game":[...]}' and binary games
+if (TelemetryCodecDecodeGame(payload, len, &game))
 	{
 		LogMessage(LOG_DEBUG_LVL,"\r\nGame message received!\r\n");
-		LogMessage(LOG_DEBUG_LVL,"%s",mqtt_recv_msg);
-
-		int nb = 0;
-		char *p = &mqtt_recv_msg[9];
-		while (nb < GAME_SIZE && *p) {
-			game.game[nb++] = strtol(p, &p, 10);
-			if (*p != ',')
-			break;
-			p++; /* skip, */
-		}
 		LogMessage(LOG_DEBUG_LVL,"\r\nParsed Command: ");
 		for(int i = 0; i < GAME_SIZE; i++)
 		{
@@ -1149,12 +1206,7 @@ if (strncmp(mqtt_recv_msg, "{\"game\":[", 9) == 0)
 	}else
 	{
 		LogMessage(LOG_DEBUG_LVL,"\r\nGame message received but not understood!\r\n");
-		LogMessage(LOG_DEBUG_LVL,"\r\n %s",mqtt_recv_msg);
 	}
-
-
-
-
 }
 
 
@@ -1169,6 +1221,32 @@ if( state <= WIFI_DOWNLOAD_HANDLE){
 }
 
 
+/**************************************************************************//**
+bool WifiStorageLock(TickType_t timeout)
+* @brief	Takes the SD card file system for FatFs calls from another task
+* @param[in]	timeout Longest wait while the Wi-Fi task uses the card, in ticks
+* @return	true if the card is mounted and was taken; release it with WifiStorageUnlock()
+* @note		FatFs is built without re-entrancy: every f_* call, from any task, must hold this lock. The download only
+*			holds it for each write, so files can be used while it runs; do not hold it across a wait.
+*****************************************************************************/
+bool WifiStorageLock(TickType_t timeout)
+{
+	if (storageMutex == NULL || !is_state_set(STORAGE_READY)) {
+		return false;
+	}
+	return xSemaphoreTake(storageMutex, timeout) == pdTRUE;
+}
+
+/**************************************************************************//**
+void WifiStorageUnlock(void)
+* @brief	Releases the SD card file system taken with WifiStorageLock()
+*****************************************************************************/
+void WifiStorageUnlock(void)
+{
+	xSemaphoreGive(storageMutex);
+}
+
+
 
 /**************************************************************************//**
 void WifiAddImuDataToQueue(struct ImuDataPacket* imuPacket)
@@ -1176,12 +1254,16 @@ void WifiAddImuDataToQueue(struct ImuDataPacket* imuPacket)
 * @param[out] 
                 				
 * @return		Returns pdTrue if data can be added to queue, pdFalse if queue is full
-* @note         
+* @note         The sample is stamped with the current tick and published as part of a batch
 
 *****************************************************************************/
 int WifiAddImuDataToQueue(struct ImuDataPacket* imuPacket)
 {
-	int error = xQueueSend(xQueueImuBuffer , imuPacket, ( TickType_t ) 10);
+	struct ImuQueueItem item;
+	item.tick = xTaskGetTickCount();
+	item.imu = *imuPacket;
+	int error = xQueueSend(xQueueImuBuffer , &item, ( TickType_t ) 10);
+	if(error != pdTRUE) wifiTelemetryDropped++;
 	return error;
 }
 
@@ -1196,7 +1278,11 @@ void WifiAddImuDataToQueue(struct ImuDataPacket* imuPacket)
 *****************************************************************************/
 int WifiAddDistanceDataToQueue(uint16_t *distance)
 {
-	int error = xQueueSend(xQueueDistanceBuffer  , distance, ( TickType_t ) 10);
+	struct DistanceQueueItem item;
+	item.tick = xTaskGetTickCount();
+	item.distance = *distance;
+	int error = xQueueSend(xQueueDistanceBuffer  , &item, ( TickType_t ) 10);
+	if(error != pdTRUE) wifiTelemetryDropped++;
 	return error;
 }
 
@@ -1214,4 +1300,14 @@ int WifiAddGameDataToQueue(struct GameDataPacket *game)
 {
 	int error = xQueueSend(xQueueGameBuffer , game, ( TickType_t ) 10);
 	return error;
-}
\ No newline at end of file
+}
+
+
+/**************************************************************************//**
+* @fn		static uint32_t WifiNowMs(void)
+* @brief	Returns the RTOS tick count in ms, the time base of the MQTT link statistics
+*****************************************************************************/
+static uint32_t WifiNowMs(void)
+{
+	return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
@@ -18,6 +18,7 @@
 	 * Includes
 	 ******************************************************************************/
 	 #include "asf.h"
+	 #include "WifiHandlerThread/TelemetryPackets.h"
 	 /******************************************************************************
 	 * Defines
 	 ******************************************************************************/
@@ -29,6 +30,15 @@
 
 	 #define WIFI_TASK_SIZE	1000
 	 #define WIFI_PRIORITY (configMAX_PRIORITIES - 2) 
+
+	 #define WIFI_IMU_QUEUE_LEN			20	///<Depth of the IMU queue. Must hold the samples taken between two passes of the Wifi task
+	 #define WIFI_DISTANCE_QUEUE_LEN	10	///<Depth of the distance queue
+	 #define WIFI_MQTT_IN_QUEUE_LEN		4	///<Game messages from the broker that can wait to be parsed. Also the size of their pool
+	 #define WIFI_MQTT_IN_MSG_SIZE		80	///<Longest game message kept. Longer messages are truncated
+	 #define WIFI_TASK_PERIOD_MS		100	///<Longest sleep of the Wifi task between two passes
+	 #define WIFI_DOWNLOAD_SLICE_MS		50	///<Time the download gets on each pass of the Wifi task before the MQTT connection is serviced
+	 #define WIFI_POWER_SAVE_MODE		M2M_PS_DEEP_AUTOMATIC	///<WINC power save mode once connected. The WINC wakes up for the AP beacons and for our traffic
+	 #define WIFI_POWER_SAVE_LISTEN_INT	3	///<Beacon periods the WINC may sleep through. Delays traffic from the broker by up to this many beacons
 	 
 /** Wi-Fi AP Settings. */
 #define MAIN_WLAN_SSID                       "EvoPhilly" /**< Destination SSID. Change to your WIFI SSID */
@@ -49,7 +59,6 @@
 #define MAIN_MAX_FILE_EXT_LENGTH             (8)
 /** Output format with '0'. */
 #define MAIN_ZERO_FMT(SZ)                    (SZ == 4) ? "%04d" : (SZ == 3) ? "%03d" : (SZ == 2) ? "%02d" : "%d"
-#define GAME_SIZE		20 ///<Number of plays in game
 
 typedef enum {
 	NOT_READY = 0, /*!< Not ready. */
@@ -62,29 +71,6 @@ typedef enum {
 } download_state;
 
 
-//Structure definition that holds IMU data
-struct ImuDataPacket
-{
-	int16_t xmg;
-	int16_t ymg;
-	int16_t zmg;
-};
-
-//Structure to hold a game packet
-struct GameDataPacket
-{
-	uint8_t game[GAME_SIZE];
-};
-
-//Structure to hold an RGB LED Color packet
-struct RgbColorPacket
-{
-	uint8_t red;
-	uint8_t green;
-	uint8_t blue;
-};
-
-
 /* Max size of UART buffer. */
 #define MAIN_CHAT_BUFFER_SIZE 64
 
@@ -126,6 +112,19 @@ struct RgbColorPacket
 
 #define CLOUDMQTT_PORT		1883
 
+//Persistent session. The broker keeps our subscriptions and queued QoS 1/2 messages while we are away.
+#define MQTT_CLEAN_SESSION	0
+
+//Keep alive interval. A connection that stays silent for longer (no PINGRESP) is treated as lost.
+#define MQTT_KEEP_ALIVE_S	30
+
+//Client ID. Must be unique per device so the broker can find our persistent session.
+#ifdef PLAYER1
+#define CLOUDMQTT_CLIENT_ID	"ESE516_T3_P1"
+#else
+#define CLOUDMQTT_CLIENT_ID	"ESE516_T3_P2"
+#endif
+
 /*
  * A MQTT broker server which was connected.
  * m2m.eclipse.org is public MQTT broker.
@@ -152,7 +151,9 @@ static const char main_mqtt_broker[] = "broker.hivemq.com";
 void vWifiTask( void *pvParameters );
 void init_storage(void);
 void WifiHandlerSetState(uint8_t state);
-void WifiGameParse(void);
+bool WifiStorageLock(TickType_t timeout);
+void WifiStorageUnlock(void);
+void WifiGameParse(const uint8_t *payload, uint16_t len);
 int WifiAddDistanceDataToQueue(uint16_t *distance);
 int WifiAddImuDataToQueue(struct ImuDataPacket* imuPacket);
 int WifiAddGameDataToQueue(struct GameDataPacket *game);
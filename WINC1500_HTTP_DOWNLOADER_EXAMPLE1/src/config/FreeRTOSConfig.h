@@ -42,6 +42,9 @@
 #  include <gclk.h>
 #  include <stdint.h>
 void assert_triggered( const char * file, uint32_t line );
+void PowerManagerSuppressTicksAndSleep( uint32_t expectedIdleTime );
+void RuntimeStatsInit( void );
+uint32_t RuntimeStatsGetCounter( void );
 #endif
 
 
@@ -54,8 +57,11 @@ void assert_triggered( const char * file, uint32_t line );
 #define configTICK_RATE_HZ                      ( ( portTickType ) 1000 )
 #define configMAX_PRIORITIES                    ( 5 )
 #define configMINIMAL_STACK_SIZE                ( ( unsigned short ) 100)
-/* configTOTAL_HEAP_SIZE is not used when heap_3.c is used. */
-#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( 12000 ) )
+/* Tasks and queues are allocated statically, buffers come from the pools in MemPool.c.
+heap_1 only serves the CLI command list and the control queue set, which have no static variant. */
+#define configSUPPORT_STATIC_ALLOCATION         1
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
+#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( 1024 ) )
 #define configMAX_TASK_NAME_LEN                 ( 8 )
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_16_BIT_TICKS                  0
@@ -67,10 +73,17 @@ void assert_triggered( const char * file, uint32_t line );
 #define configUSE_MALLOC_FAILED_HOOK            1
 #define configUSE_COUNTING_SEMAPHORES           1
 #define configUSE_QUEUE_SETS                    1
-#define configGENERATE_RUN_TIME_STATS           0
+#define configGENERATE_RUN_TIME_STATS           1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	RuntimeStatsInit()		// 32 kHz TC4, see RuntimeStats.c
+#define portGET_RUN_TIME_COUNTER_VALUE()			RuntimeStatsGetCounter()
 #define configENABLE_BACKWARD_COMPATIBILITY     1
 #define configUSE_DAEMON_TASK_STARTUP_HOOK		1	// Ported from FreeRToS 9.0.0
 
+/* Tickless idle. The CM0 port has no tick suppression of its own, see PowerManager.c. */
+#define configUSE_TICKLESS_IDLE                 1
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP   5	// Arming the 32 kHz wake up timer costs a few hundred us
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime )	PowerManagerSuppressTicksAndSleep( xExpectedIdleTime )
+
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES                   0
 #define configMAX_CO_ROUTINE_PRIORITIES         ( 2 )
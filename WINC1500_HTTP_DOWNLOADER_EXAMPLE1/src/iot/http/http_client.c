@@ -37,6 +37,15 @@
 #include "iot/stream_writer.h"
 #include <stdio.h>
 #include <errno.h>
+#include "MemPool/MemPool.h"
+
+/** Size of a network buffer block. Holds the receive buffer or the extra request header. */
+#define HTTP_CLIENT_POOL_BLOCK_SIZE    512
+/** Network buffer blocks: one receive buffer and one extra header. */
+#define HTTP_CLIENT_POOL_BLOCKS        2
+
+/** Network buffers of the HTTP clients. Replaces malloc() and strdup(). */
+MEM_POOL_DEFINE(httpBufferPool, "net", HTTP_CLIENT_POOL_BLOCK_SIZE, HTTP_CLIENT_POOL_BLOCKS);
 
 #define DEFAULT_USER_AGENT "atmel/1.0.2"
 
@@ -172,9 +181,13 @@ int http_client_init(struct http_client_module *const module, struct http_client
 	memset(module, 0, sizeof(struct http_client_module));
 	memcpy(&module->config, config, sizeof(struct http_client_config));
 
-	/* Allocate the buffer in the heap. */
+	/* Take the buffer from the network buffer pool. */
+	MemPoolRegister(&httpBufferPool);
 	if (module->config.recv_buffer == NULL) {
-		module->config.recv_buffer = malloc(config->recv_buffer_size);
+		if (config->recv_buffer_size > HTTP_CLIENT_POOL_BLOCK_SIZE) {
+			return -ENOMEM;
+		}
+		module->config.recv_buffer = MemPoolAlloc(&httpBufferPool);
 		if (module->config.recv_buffer == NULL) {
 			return -ENOMEM;
 		}
@@ -204,11 +217,11 @@ int http_client_deinit(struct http_client_module *const module)
 	}
 
 	if (module->alloc_buffer != 0) {
-		free(module->config.recv_buffer);
+		MemPoolFree(&httpBufferPool, module->config.recv_buffer);
 	}
 
 	if (module->req.ext_header != NULL) {
-		free(module->req.ext_header);
+		MemPoolFree(&httpBufferPool, module->req.ext_header);
 	}
 
 	memset(module, 0, sizeof(struct http_client_module));
@@ -367,6 +380,24 @@ void http_client_socket_resolve_handler(uint8_t *doamin_name, uint32_t server_ip
 	}
 }
 
+bool http_client_is_socket(SOCKET sock)
+{
+	return (sock >= 0 && sock < TCP_SOCK_MAX && module_ref_inst[sock] != NULL);
+}
+
+bool http_client_is_resolving(const uint8_t *domain_name)
+{
+	int i;
+
+	for (i = 0; i < TCP_SOCK_MAX; i++) {
+		if (module_ref_inst[i] != NULL && module_ref_inst[i]->req.state == STATE_TRY_SOCK_CONNECT &&
+			!strcmp((const char*)domain_name, module_ref_inst[i]->host)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void http_client_timer_callback(struct sw_timer_module *const module, int timer_id, void *context, int period)
 {
 	struct http_client_module *module_inst = (struct http_client_module *)context;
@@ -439,13 +470,15 @@ int http_client_send_request(struct http_client_module *const module, const char
 	}
 
 	if (module->req.ext_header != NULL) {
-		free(module->req.ext_header);
+		MemPoolFree(&httpBufferPool, module->req.ext_header);
+		module->req.ext_header = NULL;
 	}
 	if (ext_header != NULL) {
-		module->req.ext_header = strdup(ext_header);
+		module->req.ext_header = (strlen(ext_header) < HTTP_CLIENT_POOL_BLOCK_SIZE) ? MemPoolAlloc(&httpBufferPool) : NULL;
 		if (module->req.ext_header == NULL) {
 			return -ENOMEM;
 		}
+		strcpy(module->req.ext_header, ext_header);
 	} else {
 		module->req.ext_header = NULL;
 	}
@@ -1041,7 +1074,7 @@ int _http_client_handle_entity(struct http_client_module *const module)
 void _http_client_move_buffer(struct http_client_module *const module, char *base)
 {
 	char *buffer = module->config.recv_buffer;
-	int remain = (int)module->recved_size - (int)base + (int)buffer;
+	int remain = (int)module->recved_size - (int)(base - buffer);
 
 	if (remain > 0) {
 		memmove(buffer, base, remain);
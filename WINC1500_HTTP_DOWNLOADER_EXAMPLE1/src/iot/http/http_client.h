@@ -469,6 +469,24 @@ void http_client_socket_event_handler(SOCKET sock, uint8_t msg_type, void *msg_d
  */
 void http_client_socket_resolve_handler(uint8_t *doamin_name, uint32_t server_ip);
 
+/**
+ * \brief Check if a socket belongs to an HTTP client instance.
+ *
+ * \param[in]  sock            Socket descriptor.
+ *
+ * \return     true if the socket is used by an HTTP client.
+ */
+bool http_client_is_socket(SOCKET sock);
+
+/**
+ * \brief Check if an HTTP client instance is waiting for the resolution of a host name.
+ *
+ * \param[in]  domain_name     Domain name.
+ *
+ * \return     true if an HTTP client requested the resolution of this host.
+ */
+bool http_client_is_resolving(const uint8_t *domain_name);
+
 /**
  * \brief Event handler of gethostbyname.
  *
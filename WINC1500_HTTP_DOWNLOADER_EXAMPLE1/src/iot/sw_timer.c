@@ -31,39 +31,151 @@
  *
  */
 
+
+#include <string.h>
 #include "sw_timer.h"
 
-/** Tick count of timer. */
-static uint32_t sw_timer_tick = 0;
+/** Mask of a slot index. */
+#define SW_TIMER_WHEEL_MASK        (SW_TIMER_WHEEL_SLOTS - 1)
 
 /**
- * \brief TCC callback of SW timer.
- *
- * This function performs to the increasing the tick count.
+ * \brief Rotates a slot bitmap so that bit 0 is the given slot.
+ */
+static inline uint32_t sw_timer_rotate(uint32_t bits, uint32_t slot)
+{
+	return (slot == 0) ? bits : ((bits >> slot) | (bits << (SW_TIMER_WHEEL_SLOTS - slot)));
+}
+
+/**
+ * \brief Removes a timer from its wheel list.
+ */
+static void sw_timer_unlink(struct sw_timer_module *const module_inst, uint8_t timer_id)
+{
+	struct sw_timer_handle *handler = &module_inst->handler[timer_id];
+	uint8_t level = handler->list >> SW_TIMER_WHEEL_BITS;
+	uint8_t slot = handler->list & SW_TIMER_WHEEL_MASK;
+
+	if (handler->prev != SW_TIMER_NONE) {
+		module_inst->handler[handler->prev].next = handler->next;
+	} else {
+		module_inst->wheel[level][slot] = handler->next;
+		if (handler->next == SW_TIMER_NONE) {
+			module_inst->occupied[level] &= ~(1UL << slot);
+		}
+	}
+	if (handler->next != SW_TIMER_NONE) {
+		module_inst->handler[handler->next].prev = handler->prev;
+	}
+	handler->list = SW_TIMER_NONE;
+}
+
+/**
+ * \brief Puts a timer on the wheel list that matches its expire time.
  *
- * \param[in] module Instance of the TCC.
+ * A timer goes on the lowest level whose slots reach its expire time. Timers
+ * beyond the top level are parked on its farthest slot and placed again when
+ * that slot is cascaded.
  */
-#if (SAMD21)
-static void sw_timer_tcc_callback(struct tcc_module *const module)
+static void sw_timer_link(struct sw_timer_module *const module_inst, uint8_t timer_id)
 {
-	sw_timer_tick++;
+	struct sw_timer_handle *handler = &module_inst->handler[timer_id];
+	uint32_t expire = handler->expire_time;
+	uint32_t now = module_inst->now;
+	uint8_t level = SW_TIMER_WHEEL_LEVELS - 1;
+	uint8_t slot;
+	uint8_t shift;
+
+	if ((int32_t)(expire - now) <= 0) {
+		/* Due. Only happens while cascading, the slot of now is expired next. */
+		level = 0;
+		slot = now & SW_TIMER_WHEEL_MASK;
+	} else {
+		slot = ((now >> (level * SW_TIMER_WHEEL_BITS)) + SW_TIMER_WHEEL_MASK) & SW_TIMER_WHEEL_MASK;
+		for (uint8_t i = 0; i < SW_TIMER_WHEEL_LEVELS; i++) {
+			shift = i * SW_TIMER_WHEEL_BITS;
+			if ((((expire >> shift) - (now >> shift)) & (0xFFFFFFFFUL >> shift)) < SW_TIMER_WHEEL_SLOTS) {
+				level = i;
+				slot = (expire >> shift) & SW_TIMER_WHEEL_MASK;
+				break;
+			}
+		}
+	}
+
+	handler->list = (level << SW_TIMER_WHEEL_BITS) | slot;
+	handler->prev = SW_TIMER_NONE;
+	handler->next = module_inst->wheel[level][slot];
+	if (handler->next != SW_TIMER_NONE) {
+		module_inst->handler[handler->next].prev = timer_id;
+	}
+	module_inst->wheel[level][slot] = timer_id;
+	module_inst->occupied[level] |= (1UL << slot);
 }
 
-#elif (SAM4S) || (SAMG53) || (SAMG55)
-void RTT_Handler(void)
+/**
+ * \brief Checks that no timer is on the wheel.
+ */
+static bool sw_timer_wheel_empty(struct sw_timer_module *const module_inst)
 {
-	uint32_t ul_status;
+	for (uint8_t level = 0; level < SW_TIMER_WHEEL_LEVELS; level++) {
+		if (module_inst->occupied[level] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
 
-	/* Get RTT status */
-	ul_status = rtt_get_status(RTT);
+/**
+ * \brief Unit of accuracy of the current tick, including the units sw_timer_task has not processed yet.
+ */
+static uint32_t sw_timer_current_unit(struct sw_timer_module *const module_inst)
+{
+	int32_t late = (int32_t)(xTaskGetTickCount() - module_inst->next_tick);
 
-	/* Time has changed, refresh display */
-	if ((ul_status & RTT_SR_RTTINC) == RTT_SR_RTTINC) {
-		sw_timer_tick++;
+	if (!module_inst->enabled || late < 0) {
+		return module_inst->now;
 	}
+	return module_inst->now + 1 + (uint32_t)late / module_inst->unit_ticks;
 }
 
-#endif
+/**
+ * \brief Processes the next unit of accuracy: cascades the upper levels that reach it and expires its level 0 slot.
+ */
+static void sw_timer_advance(struct sw_timer_module *const module_inst)
+{
+	uint32_t now = ++module_inst->now;
+	uint8_t slot;
+	uint8_t timer_id;
+	struct sw_timer_handle *handler;
+
+	for (uint8_t level = SW_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+		uint8_t shift = level * SW_TIMER_WHEEL_BITS;
+		if ((now & ((1UL << shift) - 1)) != 0) {
+			continue;
+		}
+		slot = (now >> shift) & SW_TIMER_WHEEL_MASK;
+		while ((timer_id = module_inst->wheel[level][slot]) != SW_TIMER_NONE) {
+			sw_timer_unlink(module_inst, timer_id);
+			sw_timer_link(module_inst, timer_id);
+		}
+	}
+
+	/* Callbacks may enable or disable any timer. They never link to this slot, so the loop ends. */
+	slot = now & SW_TIMER_WHEEL_MASK;
+	while ((timer_id = module_inst->wheel[0][slot]) != SW_TIMER_NONE) {
+		handler = &module_inst->handler[timer_id];
+		sw_timer_unlink(module_inst, timer_id);
+		if (handler->period > 0) {
+			handler->expire_time = now + handler->period;
+			sw_timer_link(module_inst, timer_id);
+		} else {
+			/* One shot. */
+			handler->callback_enable = 0;
+		}
+		module_inst->busy = 1;
+		handler->callback(module_inst, timer_id, handler->context, handler->period);
+		module_inst->busy = 0;
+	}
+}
 
 void sw_timer_get_config_defaults(struct sw_timer_config *const config)
 {
@@ -76,80 +188,36 @@ void sw_timer_get_config_defaults(struct sw_timer_config *const config)
 
 void sw_timer_init(struct sw_timer_module *const module_inst, struct sw_timer_config *const config)
 {
-#if (SAMD21)
-	struct tcc_config tcc_conf;
-	struct tcc_module *tcc_module;
-	Tcc *hw[] = TCC_INSTS;
-#endif
-
 	Assert(module_inst);
 	Assert(config);
-	Assert(config->tcc_dev < TCC_INST_NUM);
-	Assert(config->tcc_callback_channel < TCC_NUM_CHANNELS);
-
-	module_inst->accuracy = config->accuracy;
-#if (SAMD21)
-	/* Start the TCC module. */
-	tcc_module = &module_inst->tcc_inst;
-	tcc_get_config_defaults(&tcc_conf, hw[config->tcc_dev]);
-	tcc_conf.counter.period = system_cpu_clock_get_hz() / (64 * 1000 / config->accuracy);
-	tcc_conf.counter.clock_prescaler = TCC_CLOCK_PRESCALER_DIV64;
-	tcc_init(tcc_module, hw[config->tcc_dev], &tcc_conf);
-	tcc_register_callback(tcc_module, sw_timer_tcc_callback, config->tcc_callback_channel + TCC_CALLBACK_CHANNEL_0);
-	tcc_enable_callback(tcc_module, config->tcc_callback_channel + TCC_CALLBACK_CHANNEL_0);
-#elif (SAM4S) || (SAMG53) || (SAMG55)
-	uint32_t ul_previous_time;
+	Assert(config->accuracy > 0);
 
-	/* Configure RTT for a 1 second tick interrupt */
-	rtt_sel_source(RTT, false);
-	rtt_init(RTT, OSC_SLCK_32K_XTAL_HZ / (1000 / config->accuracy));
+	memset(module_inst, 0, sizeof(*module_inst));
+	memset(module_inst->wheel, SW_TIMER_NONE, sizeof(module_inst->wheel));
+	for (int index = 0; index < CONF_SW_TIMER_COUNT; index++) {
+		module_inst->handler[index].list = SW_TIMER_NONE;
+	}
 
-	ul_previous_time = rtt_read_timer_value(RTT);
-	while (ul_previous_time == rtt_read_timer_value(RTT)) {
+	module_inst->accuracy = config->accuracy;
+	module_inst->unit_ticks = pdMS_TO_TICKS(config->accuracy);
+	if (module_inst->unit_ticks == 0) {
+		module_inst->unit_ticks = 1;
 	}
-#endif
 }
 
 void sw_timer_enable(struct sw_timer_module *const module_inst)
 {
-#if (SAMD21)
-	struct tcc_module *tcc_module;
-#endif
-
 	Assert(module_inst);
-#if (SAMD21)
-	tcc_module = &module_inst->tcc_inst;
 
-	tcc_enable(tcc_module);
-#elif (SAM4S) || (SAMG53) || (SAMG55)
-	/* Enable RTT interrupt */
-	NVIC_DisableIRQ(RTT_IRQn);
-	NVIC_ClearPendingIRQ(RTT_IRQn);
-	NVIC_SetPriority(RTT_IRQn, 0);
-	NVIC_EnableIRQ(RTT_IRQn);
-	rtt_enable_interrupt(RTT, RTT_MR_RTTINCIEN);
-#endif
+	module_inst->next_tick = xTaskGetTickCount() + module_inst->unit_ticks;
+	module_inst->enabled = 1;
 }
 
 void sw_timer_disable(struct sw_timer_module *const module_inst)
 {
-#if (SAMD21)
-	struct tcc_module *tcc_module;
-#endif
-
 	Assert(module_inst);
 
-#if (SAMD21)
-	tcc_module = &module_inst->tcc_inst;
-	tcc_disable(tcc_module);
-#elif (SAM4S) || (SAMG53) || (SAMG55)
-	/* Enable RTT interrupt */
-	NVIC_DisableIRQ(RTT_IRQn);
-	NVIC_ClearPendingIRQ(RTT_IRQn);
-	NVIC_SetPriority(RTT_IRQn, 0);
-	NVIC_EnableIRQ(RTT_IRQn);
-	rtt_disable_interrupt(RTT, RTT_MR_RTTINCIEN);
-#endif
+	module_inst->enabled = 0;
 }
 
 int sw_timer_register_callback(struct sw_timer_module *const module_inst,
@@ -167,6 +235,7 @@ int sw_timer_register_callback(struct sw_timer_module *const module_inst,
 			handler->callback_enable = 0;
 			handler->context = context;
 			handler->period = period / module_inst->accuracy;
+			handler->list = SW_TIMER_NONE;
 			handler->used = 1;
 			return index;
 		}
@@ -183,6 +252,10 @@ void sw_timer_unregister_callback(struct sw_timer_module *const module_inst, int
 
 	handler = &module_inst->handler[timer_id];
 
+	if (handler->list != SW_TIMER_NONE) {
+		sw_timer_unlink(module_inst, timer_id);
+	}
+	handler->callback_enable = 0;
 	handler->used = 0;
 }
 
@@ -195,8 +268,13 @@ void sw_timer_enable_callback(struct sw_timer_module *const module_inst, int tim
 
 	handler = &module_inst->handler[timer_id];
 
+	if (handler->list != SW_TIMER_NONE) {
+		sw_timer_unlink(module_inst, timer_id);
+	}
 	handler->callback_enable = 1;
-	handler->expire_time = sw_timer_tick + (delay / module_inst->accuracy);
+	/* Expires after the tick count passed delay, as when the tick was counted by the TCC. */
+	handler->expire_time = sw_timer_current_unit(module_inst) + (delay / module_inst->accuracy) + 1;
+	sw_timer_link(module_inst, timer_id);
 }
 
 void sw_timer_disable_callback(struct sw_timer_module *const module_inst, int timer_id)
@@ -208,34 +286,69 @@ void sw_timer_disable_callback(struct sw_timer_module *const module_inst, int ti
 
 	handler = &module_inst->handler[timer_id];
 
+	if (handler->list != SW_TIMER_NONE) {
+		sw_timer_unlink(module_inst, timer_id);
+	}
 	handler->callback_enable = 0;
 }
 
 void sw_timer_task(struct sw_timer_module *const module_inst)
 {
-	int index;
-	struct sw_timer_handle *handler;
+	uint32_t tick;
+	uint32_t units;
 
 	Assert(module_inst);
 
-	for (index = 0; index < CONF_SW_TIMER_COUNT; index++) {
-		if (module_inst->handler[index].used && module_inst->handler[index].callback_enable) {
-			handler = &module_inst->handler[index];
-			if ((int)(handler->expire_time - sw_timer_tick) < 0 && handler->busy == 0) {
-				/* Enter critical section. */
-				handler->busy = 1;
-				/* Timer was expired. */
-				if (handler->period > 0) {
-					handler->expire_time = sw_timer_tick + handler->period;
-				} else {
-					/* One shot. */
-					handler->callback_enable = 0;
-				}
-				/* Call callback function. */
-				handler->callback(module_inst, index, handler->context, handler->period);
-				/* Leave critical section. */
-				handler->busy = 0;
-			}
+	if (!module_inst->enabled || module_inst->busy) {
+		return;
+	}
+
+	tick = xTaskGetTickCount();
+	while ((int32_t)(tick - module_inst->next_tick) >= 0) {
+		if (sw_timer_wheel_empty(module_inst)) {
+			/* Nothing on the wheel. Skip the elapsed units at once. */
+			units = (tick - module_inst->next_tick) / module_inst->unit_ticks + 1;
+			module_inst->now += units;
+			module_inst->next_tick += units * module_inst->unit_ticks;
+			break;
+		}
+		module_inst->next_tick += module_inst->unit_ticks;
+		sw_timer_advance(module_inst);
+	}
+}
+
+uint32_t sw_timer_get_next_expiry(struct sw_timer_module *const module_inst)
+{
+	uint32_t next = SW_TIMER_NO_EXPIRY;
+	uint32_t units;
+	uint32_t bits;
+	uint8_t shift;
+	int32_t ticks;
+
+	Assert(module_inst);
+
+	if (!module_inst->enabled) {
+		return SW_TIMER_NO_EXPIRY;
+	}
+
+	for (uint8_t level = 0; level < SW_TIMER_WHEEL_LEVELS; level++) {
+		bits = module_inst->occupied[level];
+		if (bits == 0) {
+			continue;
+		}
+		/* First used slot after the one being processed. On upper levels the slot is due when it is cascaded. */
+		shift = level * SW_TIMER_WHEEL_BITS;
+		bits = sw_timer_rotate(bits, ((module_inst->now >> shift) + 1) & SW_TIMER_WHEEL_MASK);
+		units = (((module_inst->now >> shift) + 1 + __builtin_ctz(bits)) << shift) - module_inst->now;
+		if (units < next) {
+			next = units;
 		}
 	}
+	if (next == SW_TIMER_NO_EXPIRY) {
+		return SW_TIMER_NO_EXPIRY;
+	}
+
+	/* Unit now + 1 starts at next_tick. */
+	ticks = (int32_t)(module_inst->next_tick - xTaskGetTickCount()) + (int32_t)((next - 1) * module_inst->unit_ticks);
+	return (ticks > 0) ? (uint32_t)ticks : 0;
 }
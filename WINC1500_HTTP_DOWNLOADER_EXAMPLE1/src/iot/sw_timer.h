@@ -38,6 +38,20 @@
 #include <stdint.h>
 #include "conf_sw_timer.h"
 
+/** Number of levels of the timer wheel. */
+#define SW_TIMER_WHEEL_LEVELS      3
+/** Slots of each level, as a power of two. Each level spans 32 slots of the level below. */
+#define SW_TIMER_WHEEL_BITS        5
+#define SW_TIMER_WHEEL_SLOTS       (1UL << SW_TIMER_WHEEL_BITS)
+/** Index that marks the end of a list or a timer that is not on the wheel. */
+#define SW_TIMER_NONE              0xFF
+/** Returned by \ref sw_timer_get_next_expiry when no timer is enabled. */
+#define SW_TIMER_NO_EXPIRY         0xFFFFFFFFUL
+
+#if (CONF_SW_TIMER_COUNT >= SW_TIMER_NONE)
+#  error "CONF_SW_TIMER_COUNT must be below 255"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -59,11 +73,14 @@ typedef void (*sw_timer_callback_t)(struct sw_timer_module *const module, int ti
  * Configuration struct for a SW timer instance. This structure should be
  * initialized by the \ref sw_timer_get_config_defaults function before being
  * modified by the user application.
+ *
+ * The timer counts the FreeRTOS tick, so no TCC is used. tcc_dev and
+ * tcc_callback_channel are kept for compatibility and ignored.
  */
 struct sw_timer_config {
-	/** HW interface of TCC. */
+	/** Unused. */
 	uint8_t tcc_dev;
-	/** Callback channel of TCC. */
+	/** Unused. */
 	uint8_t tcc_callback_channel;
 	/** Accuracy of timer. If this value is increased, Timer can checks a long time. Unit is milliseconds*/
 	uint16_t accuracy;
@@ -77,30 +94,50 @@ struct sw_timer_handle {
 	uint8_t used                       : 1;
 	/** A flag that timer callback is enabled. */
 	uint8_t callback_enable            : 1;
-	/** A flag that timer is calling the handler function or not. */
-	uint8_t busy                       : 1;
+	/** Wheel list the timer is on, as level * SW_TIMER_WHEEL_SLOTS + slot. SW_TIMER_NONE if it is not on the wheel. */
+	uint8_t list;
+	/** Next timer on the same list. */
+	uint8_t next;
+	/** Previous timer on the same list. */
+	uint8_t prev;
 	/** Callback of timer. */
 	sw_timer_callback_t callback;
 	/** Private data of timer. */
 	void *context;
 	/** Period of timer. If this value is set to zero, it means this timer operated once. */
 	uint32_t period;
-	/** Expired time of timer. */
+	/** Expired time of timer, in units of accuracy. */
 	uint32_t expire_time;
 };
 
 /**
  * \brief SW timer module structure
+ *
+ * Enabled timers sit on a hierarchical timer wheel. Level 0 holds the timers
+ * that expire within the next 32 units of accuracy, one slot per unit. Each
+ * upper level holds timers 32 times further away, and its slots are moved down
+ * (cascaded) when the time reaches them. Enabling, disabling and expiring a
+ * timer are O(1), and a bitmap of the used slots gives the next expiry.
  */
 struct sw_timer_module {
 	/** Timer handler instances. */
 	struct sw_timer_handle handler[CONF_SW_TIMER_COUNT];
-#if (SAMD21)
-	/** Instance of TCC. */
-	struct tcc_module tcc_inst;
-#endif
+	/** First timer of each wheel slot, SW_TIMER_NONE if the slot is empty. */
+	uint8_t wheel[SW_TIMER_WHEEL_LEVELS][SW_TIMER_WHEEL_SLOTS];
+	/** Used slots of each level, one bit per slot. */
+	uint32_t occupied[SW_TIMER_WHEEL_LEVELS];
 	/** Accuracy of timer. */
 	uint32_t accuracy;
+	/** FreeRTOS ticks in one unit of accuracy. */
+	uint32_t unit_ticks;
+	/** Last unit of accuracy processed by \ref sw_timer_task. */
+	uint32_t now;
+	/** Tick at which the unit after now starts. */
+	uint32_t next_tick;
+	/** A flag that the timer is enabled. */
+	uint8_t enabled;
+	/** A flag that \ref sw_timer_task is calling a handler function. */
+	uint8_t busy;
 };
 
 /**
@@ -178,11 +215,25 @@ void sw_timer_disable_callback(struct sw_timer_module *const module_inst, int ti
  * \brief Checks the time out of each timer handlers.
  *
  * This function must be called continuously for the checking the expiration of the timer handle.
+ * When no unit of accuracy has elapsed since the last call it returns at once.
+ * Nested calls from a timer callback return without doing anything.
  *
  * \param[in]  module_inst     Pointer to USART software instance struct
  */
 void sw_timer_task(struct sw_timer_module *const module_inst);
 
+/**
+ * \brief Time until the next call to \ref sw_timer_task may have work to do.
+ *
+ * Callers can sleep this long instead of polling. The value may be shorter than
+ * the next expiry when a timer is far away and has to be cascaded first.
+ *
+ * \param[in]  module_inst     Pointer of timer.
+ *
+ * \return FreeRTOS ticks until the next expiry, 0 if it is due, or SW_TIMER_NO_EXPIRY if no timer is enabled.
+ */
+uint32_t sw_timer_get_next_expiry(struct sw_timer_module *const module_inst);
+
 #ifdef __cplusplus
 }
 #endif
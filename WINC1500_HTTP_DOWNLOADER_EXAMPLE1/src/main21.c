@@ -25,9 +25,13 @@
 #include "WifiHandlerThread/WifiHandler.h"
 #include "SeesawDriver/Seesaw.h"
 #include "IMU\lsm6ds_reg.h"
+#include "IMU/ImuAcquisition.h"
+#include "IMU/ImuDsp.h"
+#include "HostLink/HostLink.h"
 #include "DistanceDriver\DistanceSensor.h"
 #include "UiHandlerThread\UiHandlerThread.h"
 #include "ControlThread\ControlThread.h"
+#include "PowerManager/PowerManager.h"
 
 
 /******************************************************************************
@@ -54,6 +58,22 @@ static TaskHandle_t daemonTaskHandle    = NULL; //!< Daemon task handle
 static TaskHandle_t wifiTaskHandle    = NULL; //!< Wifi task handle
 static TaskHandle_t uiTaskHandle    = NULL; //!< UI task handle
 static TaskHandle_t controlTaskHandle    = NULL; //!< Control task handle
+static TaskHandle_t imuTaskHandle    = NULL; //!< IMU acquisition task handle
+
+static StackType_t cliTaskStack[CLI_TASK_SIZE]; //!< Stacks and control blocks of the application tasks
+static StaticTask_t cliTaskBuffer;
+static StackType_t wifiTaskStack[WIFI_TASK_SIZE];
+static StaticTask_t wifiTaskBuffer;
+static StackType_t uiTaskStack[UI_TASK_SIZE];
+static StaticTask_t uiTaskBuffer;
+static StackType_t controlTaskStack[CONTROL_TASK_SIZE];
+static StaticTask_t controlTaskBuffer;
+static StackType_t imuTaskStack[IMU_ACQ_TASK_SIZE];
+static StaticTask_t imuTaskBuffer;
+static StackType_t idleTaskStack[configMINIMAL_STACK_SIZE]; //!< Stack and control block of the FreeRTOS idle task
+static StaticTask_t idleTaskBuffer;
+static StackType_t daemonTaskStack[configTIMER_TASK_STACK_DEPTH]; //!< Stack and control block of the FreeRTOS timer task
+static StaticTask_t daemonTaskBuffer;
 
 char bufferPrint[64]; //Buffer for daemon task
 
@@ -72,8 +92,11 @@ int main(void)
 	/* Initialize the UART console. */
 	InitializeSerialConsole();
 
-	//Initialize trace capabilities
-	 vTraceEnable(TRC_START);
+	//Initialize the tickless idle wake up timer and the sleep manager
+	PowerManagerInit();
+
+	//Initialize trace capabilities. Streaming starts when tools/trace_capture.py sends the start command
+	 vTraceEnable(TRC_INIT);
     // Start FreeRTOS scheduler
     vTaskStartScheduler();
 
@@ -136,6 +159,16 @@ SerialConsoleWriteString("\r\n\r\nInitialize HW...\r\n");
 		SerialConsoleWriteString("Could not initialize IMU\r\n");
 	}
 
+	if(ImuDspInit() != ERROR_NONE)
+	{
+		SerialConsoleWriteString("Could not start IMU processing\r\n");
+	}
+
+	if(HostLinkInit() != ERROR_NONE)
+	{
+		SerialConsoleWriteString("Could not start the host link IMU stream\r\n");
+	}
+
 	InitializeDistanceSensor();
 	
 
@@ -154,37 +187,34 @@ SerialConsoleWriteString("\r\n\r\nInitialize HW...\r\n");
 static void StartTasks(void)
 {
 
-snprintf(bufferPrint, 64, "Heap before starting tasks: %d\r\n", xPortGetFreeHeapSize());
-SerialConsoleWriteString(bufferPrint);
+//Initialize Tasks here. Stacks and control blocks are static, so only a NULL handle (bad parameters) can fail
 
-//Initialize Tasks here
-
-if (xTaskCreate(vCommandConsoleTask, "CLI_TASK", CLI_TASK_SIZE, NULL, CLI_PRIORITY, &cliTaskHandle) != pdPASS) {
+cliTaskHandle = xTaskCreateStatic(vCommandConsoleTask, "CLI_TASK", CLI_TASK_SIZE, NULL, CLI_PRIORITY, cliTaskStack, &cliTaskBuffer);
+if (cliTaskHandle == NULL) {
 	SerialConsoleWriteString("ERR: CLI task could not be initialized!\r\n");
 }
 
-snprintf(bufferPrint, 64, "Heap after starting CLI: %d\r\n", xPortGetFreeHeapSize());
-SerialConsoleWriteString(bufferPrint);
-
-
-if (xTaskCreate(vWifiTask, "WIFI_TASK", WIFI_TASK_SIZE, NULL, WIFI_PRIORITY, &wifiTaskHandle) != pdPASS) {
+wifiTaskHandle = xTaskCreateStatic(vWifiTask, "WIFI_TASK", WIFI_TASK_SIZE, NULL, WIFI_PRIORITY, wifiTaskStack, &wifiTaskBuffer);
+if (wifiTaskHandle == NULL) {
 	SerialConsoleWriteString("ERR: WIFI task could not be initialized!\r\n");
 }
-snprintf(bufferPrint, 64, "Heap after starting WIFI: %d\r\n", xPortGetFreeHeapSize());
-SerialConsoleWriteString(bufferPrint);
-
 
-if(xTaskCreate(vUiHandlerTask, "UI Task", UI_TASK_SIZE, NULL, UI_TASK_PRIORITY, &uiTaskHandle) != pdPASS) {
+uiTaskHandle = xTaskCreateStatic(vUiHandlerTask, "UI Task", UI_TASK_SIZE, NULL, UI_TASK_PRIORITY, uiTaskStack, &uiTaskBuffer);
+if (uiTaskHandle == NULL) {
 	SerialConsoleWriteString("ERR: UI task could not be initialized!\r\n");
 }
 
-snprintf(bufferPrint, 64, "Heap after starting UI Task: %d\r\n", xPortGetFreeHeapSize());
-SerialConsoleWriteString(bufferPrint);
-
-if(xTaskCreate(vControlHandlerTask, "Control Task", CONTROL_TASK_SIZE, NULL, CONTROL_TASK_PRIORITY, &controlTaskHandle) != pdPASS) {
+controlTaskHandle = xTaskCreateStatic(vControlHandlerTask, "Control Task", CONTROL_TASK_SIZE, NULL, CONTROL_TASK_PRIORITY, controlTaskStack, &controlTaskBuffer);
+if (controlTaskHandle == NULL) {
 	SerialConsoleWriteString("ERR: Control task could not be initialized!\r\n");
 }
-snprintf(bufferPrint, 64, "Heap after starting Control Task: %d\r\n", xPortGetFreeHeapSize());
+
+imuTaskHandle = xTaskCreateStatic(vImuAcquisitionTask, "IMU Task", IMU_ACQ_TASK_SIZE, NULL, IMU_ACQ_TASK_PRIORITY, imuTaskStack, &imuTaskBuffer);
+if (imuTaskHandle == NULL) {
+	SerialConsoleWriteString("ERR: IMU task could not be initialized!\r\n");
+}
+
+snprintf(bufferPrint, 64, "Heap after starting tasks: %d\r\n", xPortGetFreeHeapSize());
 SerialConsoleWriteString(bufferPrint);
 }
 
@@ -320,6 +350,28 @@ SerialConsoleWriteString("Error on stack overflow on FREERTOS!\r\n");
 while(1);
 }
 
+/**************************************************************************//**
+* function          vApplicationGetIdleTaskMemory
+* @brief            Hands the static stack and control block of the idle task to FreeRTOS
+*****************************************************************************/
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize)
+{
+*ppxIdleTaskTCBBuffer = &idleTaskBuffer;
+*ppxIdleTaskStackBuffer = idleTaskStack;
+*pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+/**************************************************************************//**
+* function          vApplicationGetTimerTaskMemory
+* @brief            Hands the static stack and control block of the timer (daemon) task to FreeRTOS
+*****************************************************************************/
+void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize)
+{
+*ppxTimerTaskTCBBuffer = &daemonTaskBuffer;
+*ppxTimerTaskStackBuffer = daemonTaskStack;
+*pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+
 #include "MCHP_ATWx.h"
 void vApplicationTickHook (void)
 {
@@ -0,0 +1,113 @@
+/**************************************************************************//**
+* @file      boot_upload_sim.c
+* @brief     The bootloader's serial upload on the host: SerialUpload.c and ImageInstall.c run against the stand-ins of
+stubs/boot, with the console UART on stdin and stdout. tools/boot_upload.py --simulate starts it on the master side of
+a pseudo terminal and uploads through the slave side, so the host tool talks to the bootloader code itself.
+
+    boot_upload_sim [--error-rate R] [--seed N] FLASH_DUMP
+
+Listens as a board without an application does, until END installs an image or the host closes the line. The flash is
+then written to FLASH_DUMP. Exit status:
+    0  the image was installed and the boot checks accept it
+    2  the host left without an image: row 0 is erased and there is no boot record, so the board would not boot
+    1  anything else, e.g. the bootloader region was written
+
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "SerialUpload/SerialUpload.h"
+
+#define APP_START_ADDRESS	(FLASH_ADDR + 0x12000UL)	///<As in BootMain.c
+#define APP_END_ADDRESS		(FLASH_ADDR + FLASH_SIZE - IMAGE_INSTALL_ROW_SIZE)	///<getApplicationEndAddress() without EEPROM
+
+static const char *dumpPath;
+
+static const char *CheckName(enum eImageCheckResult result)
+{
+	switch(result)
+	{
+		case IMAGE_CHECK_CACHED:	return "cached";
+		case IMAGE_CHECK_VERIFIED:	return "verified";
+		case IMAGE_CHECK_NO_RECORD:	return "no boot record";
+		default:					return "FAILED";
+	}
+}
+
+/**************************************************************************//**
+* @fn		static bool BootRegionErased(void)
+* @brief	The bootloader must never write below the application
+*****************************************************************************/
+static bool BootRegionErased(void)
+{
+	const uint8_t *flash = (const uint8_t *) FLASH_ADDR;
+
+	for(uint32_t i = 0; i < APP_START_ADDRESS - FLASH_ADDR; i++)
+	{
+		if(flash[i] != 0xFF) return false;
+	}
+	return true;
+}
+
+static void Dump(void)
+{
+	FILE *file = fopen(dumpPath, "wb");
+
+	if(file == NULL || fwrite((const void *) FLASH_ADDR, 1, FLASH_SIZE, file) != FLASH_SIZE)
+	{
+		perror(dumpPath);
+		exit(1);
+	}
+	fclose(file);
+}
+
+/**************************************************************************//**
+* @fn		static void Hangup(void)
+* @brief	The host closed the line before an image was installed: what is left must not boot
+*****************************************************************************/
+static void Hangup(void)
+{
+	uint32_t version = 0;
+	bool rowErased = *(const uint32_t *) APP_START_ADDRESS == 0xFFFFFFFF;
+	enum eImageCheckResult check = ImageInstallCheckApplication(APP_START_ADDRESS, APP_END_ADDRESS, false, &version);
+
+	Dump();
+	fprintf(stderr, "boot_upload_sim: host left, row 0 %s, boot check: %s, %lu frames corrupted\n",
+		rowErased ? "erased" : "WRITTEN", CheckName(check), (unsigned long) HostBootCorrupted());
+	exit((rowErased && check == IMAGE_CHECK_NO_RECORD && BootRegionErased()) ? 2 : 1);
+}
+
+int main(int argc, char **argv)
+{
+	double errorRate = 0;
+	uint32_t seed = 516;
+	uint32_t version = 0;
+	int arg;
+
+	for(arg = 1; arg < argc - 1; arg += 2)
+	{
+		if(strcmp(argv[arg], "--error-rate") == 0) errorRate = atof(argv[arg + 1]);
+		else if(strcmp(argv[arg], "--seed") == 0) seed = (uint32_t) strtoul(argv[arg + 1], NULL, 0);
+		else break;
+	}
+	if(arg != argc - 1)
+	{
+		fprintf(stderr, "usage: %s [--error-rate R] [--seed N] FLASH_DUMP\n", argv[0]);
+		return 1;
+	}
+	dumpPath = argv[arg];
+
+	HostBootOpen(STDIN_FILENO, STDOUT_FILENO, errorRate, seed, Hangup);
+	SerialUploadRun(APP_START_ADDRESS, APP_END_ADDRESS, SERIAL_UPLOAD_WAIT_FOREVER);
+
+	//The bootloader now jumps to the application, after BootMain's check
+	enum eImageCheckResult cached = ImageInstallCheckApplication(APP_START_ADDRESS, APP_END_ADDRESS, true, &version);
+	enum eImageCheckResult full = ImageInstallCheckApplication(APP_START_ADDRESS, APP_END_ADDRESS, false, &version);
+	Dump();
+	fprintf(stderr, "boot_upload_sim: image installed at %lu baud, version %lu, boot check: %s, full check: %s, "
+		"%lu frames corrupted\n", (unsigned long) HostBootBaudrate(), (unsigned long) version, CheckName(cached),
+		CheckName(full), (unsigned long) HostBootCorrupted());
+	return (cached == IMAGE_CHECK_CACHED && full == IMAGE_CHECK_VERIFIED && BootRegionErased()) ? 0 : 1;
+}
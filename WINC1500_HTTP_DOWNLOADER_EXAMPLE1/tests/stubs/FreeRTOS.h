@@ -0,0 +1,7 @@
+/**************************************************************************//**
+* @file      FreeRTOS.h
+* @brief     Host stand-in for the FreeRTOS header: the task API is declared in the host asf.h.
+
+******************************************************************************/
+
+#include "asf.h"
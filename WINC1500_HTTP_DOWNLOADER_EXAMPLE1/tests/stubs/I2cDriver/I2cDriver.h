@@ -0,0 +1,51 @@
+/**************************************************************************//**
+* @file      I2cDriver.h
+* @brief     Host stand-in for I2cDriver.h: the ERROR_* codes the modules under test return. Values match the driver.
+Tests that build I2cDriver.c on the simulated bus define HOST_I2C_DRIVER and get the real header.
+
+******************************************************************************/
+
+#ifndef HOST_I2C_DRIVER_H
+#define HOST_I2C_DRIVER_H
+
+#ifdef HOST_I2C_DRIVER
+#include "../../../src/I2cDriver/I2cDriver.h"
+#else
+
+#define ERROR_NONE                                 0
+#define ERROR_INVALID_DATA                        -1
+#define ERROR_NO_CHANGE                           -2
+#define ERROR_ABORTED                             -3
+#define ERROR_BUSY                                -4
+#define ERROR_SUSPEND                             -5
+#define ERROR_IO                                  -6
+#define ERROR_REQ_FLUSHED                         -7
+#define ERROR_TIMEOUT                             -8
+#define ERROR_BAD_DATA                            -9
+#define ERROR_NOT_FOUND                           -10
+#define ERROR_UNSUPPORTED_DEV                     -11
+#define ERROR_NO_MEMORY                           -12
+#define ERROR_INVALID_ARG                         -13
+#define ERROR_BAD_ADDRESS                         -14
+#define ERROR_BAD_FORMAT                          -15
+#define ERROR_BAD_FRQ                             -16
+#define ERROR_DENIED                              -17
+#define ERROR_ALREADY_INITIALIZED                 -18
+#define ERROR_OVERFLOW                            -19
+#define ERROR_NOT_INITIALIZED                     -20
+#define ERROR_SAMPLERATE_UNAVAILABLE              -21
+#define ERROR_RESOLUTION_UNAVAILABLE              -22
+#define ERROR_BAUDRATE_UNAVAILABLE                -23
+#define ERROR_PACKET_COLLISION                    -24
+#define ERROR_PROTOCOL                            -25
+#define ERROR_PIN_MUX_INVALID                     -26
+#define ERROR_UNSUPPORTED_OP                      -27
+#define ERROR_NO_RESOURCE                         -28
+#define ERROR_NOT_READY							  -29
+#define ERROR_FAILURE                             -30
+#define ERROR_WRONG_LENGTH                        -31
+#define ERROR_RINGBUFFER_NO_SPACE_LEFT            -32
+#define ERROR_I2C_HANG_RESET                      -33
+#endif
+
+#endif /*HOST_I2C_DRIVER_H*/
@@ -0,0 +1,24 @@
+/**************************************************************************//**
+* @file      SerialConsole.h
+* @brief     Host stand-in for SerialConsole.h. The modules under test only write strings and log messages; the tests
+that build them define the functions.
+
+******************************************************************************/
+
+#ifndef HOST_SERIAL_CONSOLE_H
+#define HOST_SERIAL_CONSOLE_H
+
+enum eDebugLogLevels {
+	LOG_INFO_LVL = 0,
+	LOG_DEBUG_LVL = 1,
+	LOG_WARNING_LVL = 2,
+	LOG_ERROR_LVL = 3,
+	LOG_FATAL_LVL = 4,
+	LOG_OFF_LVL = 5,
+	N_DEBUG_LEVELS = 6
+};
+
+void SerialConsoleWriteString(char *string);
+void LogMessage(enum eDebugLogLevels level, const char *format, ...);
+
+#endif /*HOST_SERIAL_CONSOLE_H*/
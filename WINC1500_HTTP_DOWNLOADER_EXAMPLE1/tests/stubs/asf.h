@@ -0,0 +1,360 @@
+/**************************************************************************//**
+* @file      asf.h
+* @brief     Host stand-in for asf.h: the FreeRTOS, CMSIS and ASF driver names used by the modules under test.
+Critical sections do nothing, since the tests run on one thread. The tick count and SysTick are plain variables that
+the tests set; see host_rtos.c. The USART and TC calls run against the simulated peripherals of host_peripherals.c, the EXTINT calls against the
+LSM6DS3 model of host_lsm6ds3.c. The interrupt masking, sleep, sleep manager and tick suppression calls, and the TC that
+wakes the MCU up, run against the MCU model of host_tickless.c.
+A task that blocks on a notification or a delay runs the interrupts of the simulated hardware while it waits (see
+HostRtosSetWait); the rest of the task API is there so drivers build and run from a single task.
+
+******************************************************************************/
+
+#ifndef HOST_ASF_H
+#define HOST_ASF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+#include <stdio.h>
+#include "ff.h"
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdFALSE					0
+#define pdTRUE					1
+#define pdPASS					pdTRUE
+#define pdFAIL					pdFALSE
+#define portMAX_DELAY			((TickType_t)0xFFFFFFFFUL)
+#define configMAX_PRIORITIES	5
+#define configTICK_RATE_HZ		1000
+#define pdMS_TO_TICKS(ms)		((TickType_t)(((TickType_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define Assert(expr)			assert(expr)
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+typedef uint32_t irqflags_t;
+static inline irqflags_t cpu_irq_save(void)
+{
+	return 0;
+}
+
+static inline void cpu_irq_restore(irqflags_t flags)
+{
+	(void)flags;
+}
+
+//SysTick registers, as in the CMSIS core header
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+//System control block, for the pending SysTick bit
+typedef struct
+{
+	volatile uint32_t ICSR;
+} SCB_Type;
+
+#define SysTick_CTRL_ENABLE_Msk		(1UL << 0)
+#define SCB_ICSR_PENDSTSET_Msk		(1UL << 26)
+
+extern TickType_t hostTickCount;		///<Value returned by xTaskGetTickCount()
+extern SysTick_Type hostSysTick;		///<Registers behind SysTick
+extern SCB_Type hostScb;				///<Registers behind SCB
+#define SysTick					(&hostSysTick)
+#define SCB						(&hostScb)
+
+#define UNUSED(v)				(void)(v)
+
+//Interrupt masking and sleep. Defined by host_tickless.c, which runs the interrupts of the simulated MCU around them
+void __disable_irq(void);
+void __enable_irq(void);
+void __DSB(void);
+void __WFI(void);
+
+//Run time counter, as FreeRTOSConfig.h declares it for the trace recorder. Defined by host_trace.c
+uint32_t RuntimeStatsGetCounter(void);
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+	return hostTickCount;
+}
+
+static inline TickType_t xTaskGetTickCountFromISR(void)
+{
+	return hostTickCount;
+}
+
+/******************************************************************************
+* Tasks
+******************************************************************************/
+//Task of the host, with its notification value
+struct HostTask
+{
+	uint32_t notifiedValue;		///<Notification value
+	bool notified;				///<true if a notification is pending
+};
+typedef struct HostTask *TaskHandle_t;
+
+typedef enum
+{
+	eNoAction,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+/**
+* Runs the next interrupt of the simulated hardware, if it comes at or before the deadline tick, while a task blocks.
+* Returns false if there is none; the blocked task then wakes up at its deadline.
+*/
+typedef bool (*HostRtosWait)(TickType_t deadline);
+
+extern TaskHandle_t hostCurrentTask;	///<Task the test code runs as
+extern uint32_t hostSuspendAllCount;	///<Number of vTaskSuspendAll calls
+extern uint32_t hostNotifyFromIsrCount;	///<Number of xTaskNotifyFromISR calls: task wake-ups by an interrupt
+
+void HostRtosSetWait(HostRtosWait wait);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *pxHigherPriorityTaskWoken);
+BaseType_t xTaskNotifyWait(uint32_t bitsToClearOnEntry, uint32_t bitsToClearOnExit, uint32_t *notificationValue, TickType_t ticksToWait);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *pxHigherPriorityTaskWoken);
+void vTaskDelay(const TickType_t ticksToDelay);
+void vTaskSuspendAll(void);
+BaseType_t xTaskResumeAll(void);
+
+//Tick suppression, for portSUPPRESS_TICKS_AND_SLEEP. Defined by host_tickless.c
+typedef enum
+{
+	eAbortSleep = 0,
+	eStandardSleep,
+	eNoTasksWaitingTimeout
+} eSleepModeStatus;
+
+eSleepModeStatus eTaskConfirmSleepModeStatus(void);
+void vTaskStepTick(const TickType_t ticksToJump);
+
+#define taskSCHEDULER_SUSPENDED		0
+#define taskSCHEDULER_NOT_STARTED	1
+#define taskSCHEDULER_RUNNING		2
+extern BaseType_t hostSchedulerState;	///<Value returned by xTaskGetSchedulerState(). taskSCHEDULER_RUNNING unless a test sets it
+
+static inline BaseType_t xTaskGetSchedulerState(void)
+{
+	return hostSchedulerState;
+}
+
+#define taskYIELD()				do { } while(0)
+#define portYIELD_FROM_ISR(x)	((void)(x))
+
+//Mutexes. A single task never waits on one: a mutex that is taken is reported as not available at once.
+typedef struct
+{
+	bool taken;		///<true while the mutex is held
+} StaticSemaphore_t;
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+/******************************************************************************
+* ASF drivers
+******************************************************************************/
+enum status_code
+{
+	STATUS_OK = 0x00,
+	STATUS_ABORTED = 0x04,
+	STATUS_BUSY = 0x05,
+	STATUS_SUSPEND = 0x06,
+	STATUS_ERR_TIMEOUT = 0x12,
+	STATUS_ERR_DENIED = 0x1C,
+	STATUS_ERR_INVALID_ARG = 0x08,
+	STATUS_ERR_NO_MEMORY = 0x16,
+	STATUS_ERR_BAD_ADDRESS = 0x18,
+	STATUS_ERR_OVERFLOW = 0x1E,
+	STATUS_ERR_PACKET_COLLISION = 0x26,
+};
+typedef enum status_code status_code_genare_t;
+
+//I2C master registers of a SERCOM, as in the CMSIS device header
+typedef struct
+{
+	struct { volatile uint32_t reg; } CTRLA;
+	struct { volatile uint32_t reg; } BAUD;
+	struct { volatile uint8_t reg; } INTENCLR;
+	struct { volatile uint16_t reg; } STATUS;
+} SercomI2cm;
+
+typedef struct Sercom { int id; SercomI2cm I2CM; } Sercom;
+typedef struct Tc { int id; } Tc;
+extern Sercom hostSercom[6];
+extern Tc hostTc[6];
+#define SERCOM3							(&hostSercom[3])
+#define SERCOM4							(&hostSercom[4])
+#define SERCOM5							(&hostSercom[5])
+#define TC3								(&hostTc[3])
+#define TC5								(&hostTc[5])
+
+enum gclk_generator { GCLK_GENERATOR_0, GCLK_GENERATOR_1, GCLK_GENERATOR_2 };
+uint32_t system_gclk_gen_get_hz(const uint8_t generator);
+
+//USART
+#define USART_RX_1_TX_0_XCK_1			0
+#define PINMUX_PB02D_SERCOM5_PAD0		0x00220003UL
+#define PINMUX_PB03D_SERCOM5_PAD1		0x00230003UL
+#define PINMUX_UNUSED					0xFFFFFFFFUL
+
+//Trace UART of the Tracealyzer stream port
+#define USART_RX_3_TX_0_XCK_1			2
+#define PINMUX_PA22C_SERCOM3_PAD0		0x00160002UL
+#define PINMUX_PA21D_SERCOM3_PAD3		0x00150003UL
+
+//Console UART of the SAM W25 Xplained Pro
+#define USART_RX_3_TX_2_XCK_3			1
+#define EDBG_CDC_MODULE					SERCOM4
+#define EDBG_CDC_SERCOM_MUX_SETTING		USART_RX_3_TX_2_XCK_3
+#define EDBG_CDC_SERCOM_PINMUX_PAD0		PINMUX_UNUSED
+#define EDBG_CDC_SERCOM_PINMUX_PAD1		PINMUX_UNUSED
+#define EDBG_CDC_SERCOM_PINMUX_PAD2		0x002A0003UL
+#define EDBG_CDC_SERCOM_PINMUX_PAD3		0x002B0003UL
+
+enum usart_callback { USART_CALLBACK_BUFFER_TRANSMITTED, USART_CALLBACK_BUFFER_RECEIVED, USART_CALLBACK_N };
+enum usart_transceiver_type { USART_TRANSCEIVER_RX, USART_TRANSCEIVER_TX };
+
+struct usart_module;
+typedef void (*usart_callback_t)(struct usart_module *const module);
+
+struct usart_config
+{
+	uint32_t baudrate;
+	uint32_t mux_setting;
+	uint32_t pinmux_pad0;
+	uint32_t pinmux_pad1;
+	uint32_t pinmux_pad2;
+	uint32_t pinmux_pad3;
+};
+
+struct usart_module
+{
+	Sercom *hw;
+	bool enabled;
+	usart_callback_t callback[USART_CALLBACK_N];
+	bool callbackEnabled[USART_CALLBACK_N];
+	uint8_t *rxBuffer;						///<Buffer of the armed read job
+	uint16_t remaining_rx_buffer_length;	///<Bytes the read job still waits for. 0 when no job is armed
+	uint16_t remaining_tx_buffer_length;	///<Bytes the write job still sends
+};
+
+void usart_get_config_defaults(struct usart_config *const config);
+enum status_code usart_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config);
+void usart_enable(struct usart_module *const module);
+void usart_disable(struct usart_module *const module);
+void usart_register_callback(struct usart_module *const module, usart_callback_t callback_func, enum usart_callback callback_type);
+void usart_enable_callback(struct usart_module *const module, enum usart_callback callback_type);
+enum status_code usart_get_job_status(struct usart_module *const module, enum usart_transceiver_type transceiver_type);
+enum status_code usart_read_buffer_job(struct usart_module *const module, uint8_t *rx_data, uint16_t length);
+enum status_code usart_write_buffer_job(struct usart_module *const module, uint8_t *tx_data, uint16_t length);
+void usart_abort_job(struct usart_module *const module, enum usart_transceiver_type transceiver_type);
+enum status_code usart_read_wait(struct usart_module *const module, uint16_t *const rx_data);
+
+//TC
+enum tc_counter_size { TC_COUNTER_SIZE_16BIT };
+enum tc_clock_prescaler { TC_CLOCK_PRESCALER_DIV1024, TC_CLOCK_PRESCALER_DIV1 };
+enum tc_wave_generation { TC_WAVE_GENERATION_MATCH_FREQ, TC_WAVE_GENERATION_NORMAL_FREQ };
+enum tc_compare_capture_channel { TC_COMPARE_CAPTURE_CHANNEL_0 };
+enum tc_callback { TC_CALLBACK_CC_CHANNEL0, TC_CALLBACK_N };
+
+struct tc_module;
+typedef void (*tc_callback_t)(struct tc_module *const module);
+
+struct tc_config
+{
+	enum tc_counter_size counter_size;
+	enum gclk_generator clock_source;
+	enum tc_clock_prescaler clock_prescaler;
+	enum tc_wave_generation wave_generation;
+	bool run_in_standby;
+	struct { uint16_t compare_capture_channel[2]; } counter_16_bit;
+};
+
+struct tc_module
+{
+	Tc *hw;
+	bool enabled;
+	tc_callback_t callback;
+	bool callbackEnabled;
+	uint32_t compare;		///<Compare value of channel 0. The callback fires every compare + 1 counts
+	uint32_t countMilli;	///<Counts since the last compare, in thousandths
+};
+
+void tc_get_config_defaults(struct tc_config *const config);
+enum status_code tc_init(struct tc_module *const module, Tc *const hw, const struct tc_config *const config);
+enum status_code tc_register_callback(struct tc_module *const module, tc_callback_t callback_func, const enum tc_callback callback_type);
+void tc_enable_callback(struct tc_module *const module, const enum tc_callback callback_type);
+void tc_enable(const struct tc_module *const module);
+void tc_disable(const struct tc_module *const module);
+enum status_code tc_set_count_value(const struct tc_module *const module, const uint32_t count);
+enum status_code tc_set_compare_value(const struct tc_module *const module, const enum tc_compare_capture_channel channel_index, const uint32_t compare_value);
+
+//TC calls of the tickless idle wake up timer, defined by host_tickless.c only
+#define TC_STATUS_CHANNEL_0_MATCH		(1UL << 0)
+
+void tc_start_counter(const struct tc_module *const module);
+void tc_stop_counter(const struct tc_module *const module);
+uint32_t tc_get_status(struct tc_module *const module);
+void tc_clear_status(struct tc_module *const module, const uint32_t status_flags);
+uint32_t tc_get_count_value(const struct tc_module *const module);
+
+//Sleep manager and power manager, as in sleepmgr.h and power.h. Defined by host_tickless.c
+enum sleepmgr_mode { SLEEPMGR_ACTIVE = 0, SLEEPMGR_IDLE_0, SLEEPMGR_IDLE_1, SLEEPMGR_IDLE_2, SLEEPMGR_STANDBY, SLEEPMGR_NR_OF_MODES };
+enum system_sleepmode { SYSTEM_SLEEPMODE_IDLE_0, SYSTEM_SLEEPMODE_IDLE_1, SYSTEM_SLEEPMODE_IDLE_2, SYSTEM_SLEEPMODE_STANDBY };
+
+void sleepmgr_init(void);
+void sleepmgr_lock_mode(enum sleepmgr_mode mode);
+void sleepmgr_unlock_mode(enum sleepmgr_mode mode);
+enum sleepmgr_mode sleepmgr_get_sleep_mode(void);
+enum status_code system_set_sleepmode(const enum system_sleepmode sleep_mode);
+
+//EXTINT
+#define EXT3_IRQ_PIN					6	///<PIN_PA06A_EIC_EXTINT6
+#define EXT3_IRQ_MUX					0	///<MUX_PA06A_EIC_EXTINT6
+#define EXT3_IRQ_INPUT					6
+#define EIC_NUMBER_OF_INTERRUPTS		16
+
+enum extint_pull { EXTINT_PULL_UP, EXTINT_PULL_DOWN, EXTINT_PULL_NONE };
+enum extint_detect { EXTINT_DETECT_NONE, EXTINT_DETECT_RISING, EXTINT_DETECT_FALLING, EXTINT_DETECT_BOTH, EXTINT_DETECT_HIGH,
+	EXTINT_DETECT_LOW };
+enum extint_callback_type { EXTINT_CALLBACK_TYPE_DETECT };
+
+typedef void (*extint_callback_t)(void);
+
+struct extint_chan_conf
+{
+	uint32_t gpio_pin;
+	uint32_t gpio_pin_mux;
+	enum extint_pull gpio_pin_pull;
+	bool wake_if_sleeping;
+	bool filter_input_signal;
+	enum extint_detect detection_criteria;
+};
+
+void extint_chan_get_config_defaults(struct extint_chan_conf *const config);
+void extint_chan_set_config(const uint8_t channel, const struct extint_chan_conf *const config);
+enum status_code extint_register_callback(const extint_callback_t callback, const uint8_t channel, const enum extint_callback_type type);
+enum status_code extint_chan_enable_callback(const uint8_t channel, const enum extint_callback_type type);
+enum status_code extint_chan_disable_callback(const uint8_t channel, const enum extint_callback_type type);
+
+#endif /*HOST_ASF_H*/
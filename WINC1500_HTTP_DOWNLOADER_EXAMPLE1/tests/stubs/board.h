@@ -0,0 +1,7 @@
+/**************************************************************************//**
+* @file      board.h
+* @brief     Host stand-in for the ASF board header, which trcConfig.h includes: the board names are in the host asf.h.
+
+******************************************************************************/
+
+#include "asf.h"
@@ -0,0 +1,16 @@
+/**************************************************************************//**
+* @file      crc32.h
+* @brief     Host stand-in for the ASF DSU CRC-32 driver, implemented in host_boot.c.
+Like the DSU, it runs the reflected CRC-32 (polynomial 0xEDB88320) from the value in *pcrc32 and does not complement
+the result.
+
+******************************************************************************/
+
+#ifndef HOST_BOOT_CRC32_H
+#define HOST_BOOT_CRC32_H
+
+#include <asf.h>
+
+enum status_code dsu_crc32_cal(const uint32_t addr, const uint32_t len, uint32_t *pcrc32);
+
+#endif /*HOST_BOOT_CRC32_H*/
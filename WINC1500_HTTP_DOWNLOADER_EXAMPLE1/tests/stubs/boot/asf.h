@@ -0,0 +1,108 @@
+/**************************************************************************//**
+* @file      asf.h
+* @brief     Host stand-in for the bootloader's asf.h: the ASF USART, NVM and SERCOM names used by SerialUpload.c and
+ImageInstall.c, implemented in host_boot.c.
+The flash is a block of host memory mapped at FLASH_ADDR, low enough that the bootloader's 32-bit addresses reach it.
+The console USART is the file descriptors given to HostBootOpen, the master side of a pseudo terminal. Received bytes
+reach the interrupt handler set with _sercom_set_handler while the bootloader waits in delay_cycles_us. Whole frames
+(up to each END) can be corrupted on the way in, at a given rate, as a noisy line would.
+
+******************************************************************************/
+
+#ifndef HOST_BOOT_ASF_H
+#define HOST_BOOT_ASF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum status_code
+{
+	STATUS_OK = 0x00,
+	STATUS_BUSY = 0x05,
+	STATUS_ERR_INVALID_ARG = 0x08,
+	STATUS_ERR_BAD_ADDRESS = 0x18,
+	STATUS_ERR_DENIED = 0x1C,
+	STATUS_ERR_OVERFLOW = 0x1E,
+	STATUS_ERR_BAD_FORMAT = 0x1A,
+};
+
+/******************************************************************************
+* NVM
+******************************************************************************/
+#define FLASH_ADDR				0x20000000UL	///<Host address of the simulated flash
+#define FLASH_SIZE				0x40000UL		///<256 KB, as on the SAMD21G18
+#define NVMCTRL_PAGE_SIZE		64
+#define NVMCTRL_ROW_PAGES		4
+
+enum status_code nvm_erase_row(const uint32_t row_address);
+enum status_code nvm_write_buffer(const uint32_t destination_address, const uint8_t *buffer, uint16_t length);
+bool nvm_is_ready(void);
+
+/******************************************************************************
+* SERCOM and USART
+******************************************************************************/
+#define SERCOM_USART_INTFLAG_RXC		0x04
+
+//USART registers of a SERCOM, as far as SerialUpload.c touches them
+typedef struct
+{
+	struct { volatile uint8_t reg; } INTENSET;
+} SercomUsart;
+
+typedef struct Sercom { SercomUsart USART; } Sercom;
+extern Sercom hostSercom;
+
+#define PINMUX_UNUSED					0xFFFFFFFFUL
+#define EDBG_CDC_MODULE					(&hostSercom)
+#define EDBG_CDC_SERCOM_MUX_SETTING		1
+#define EDBG_CDC_SERCOM_PINMUX_PAD0		PINMUX_UNUSED
+#define EDBG_CDC_SERCOM_PINMUX_PAD1		PINMUX_UNUSED
+#define EDBG_CDC_SERCOM_PINMUX_PAD2		0x002A0003UL
+#define EDBG_CDC_SERCOM_PINMUX_PAD3		0x002B0003UL
+
+typedef void (*sercom_handler_t)(uint8_t instance);
+
+struct usart_config
+{
+	uint32_t baudrate;
+	uint32_t mux_setting;
+	uint32_t pinmux_pad0;
+	uint32_t pinmux_pad1;
+	uint32_t pinmux_pad2;
+	uint32_t pinmux_pad3;
+};
+
+struct usart_module
+{
+	Sercom *hw;
+	bool enabled;
+	bool receiver_enabled;
+	uint32_t baudrate;
+};
+
+uint8_t _sercom_get_sercom_inst_index(Sercom *const sercom_instance);
+uint8_t _sercom_get_interrupt_vector(Sercom *const sercom_instance);
+void _sercom_set_handler(const uint8_t instance, const sercom_handler_t interrupt_handler);
+void system_interrupt_disable(const uint8_t vector);
+
+void usart_get_config_defaults(struct usart_config *const config);
+enum status_code usart_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config);
+void usart_enable(struct usart_module *const module);
+void usart_reset(struct usart_module *const module);
+enum status_code usart_read_wait(struct usart_module *const module, uint16_t *const rx_data);
+enum status_code usart_write_buffer_wait(struct usart_module *const module, const uint8_t *tx_data, uint16_t length);
+
+void delay_cycles_us(uint32_t us);
+
+/******************************************************************************
+* Simulation
+******************************************************************************/
+typedef void (*HostBootHangup)(void);	///<Called when the host closes the line. Must not return
+
+void HostBootOpen(int rxFd, int txFd, double errorRate, uint32_t seed, HostBootHangup hangup);
+void HostBootEraseFlash(void);
+uint32_t HostBootCorrupted(void);
+uint32_t HostBootBaudrate(void);
+
+#endif /*HOST_BOOT_ASF_H*/
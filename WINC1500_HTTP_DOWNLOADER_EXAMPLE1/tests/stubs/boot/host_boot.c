@@ -0,0 +1,284 @@
+/**************************************************************************//**
+* @file      host_boot.c
+* @brief     Simulated flash, DSU and console USART behind the host asf.h of the bootloader. See stubs/boot/asf.h.
+The flash behaves like NOR flash: an erase sets a row to 0xFF, a write only clears bits. The USART has no FIFO
+limit: the pseudo terminal already holds back a host that writes faster than the bootloader reads.
+
+******************************************************************************/
+
+#define _GNU_SOURCE
+#include <asf.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "ASF/sam0/drivers/dsu/crc32/crc32.h"
+
+#define HOST_BOOT_ROW_SIZE		(NVMCTRL_PAGE_SIZE * NVMCTRL_ROW_PAGES)
+#define HOST_BOOT_READ_SIZE		256			///<Bytes taken from the line per wait
+#define HOST_BOOT_RX_SIZE		4096		///<Received bytes not read yet by the interrupt handler. A power of two
+#define HOST_BOOT_FRAME_MAX		1024		///<Longest frame held back to be corrupted whole
+#define HOST_BOOT_END			0xC0		///<Frame delimiter of SerialUpload
+
+Sercom hostSercom;
+
+static uint8_t *flash;							///<FLASH_SIZE bytes at FLASH_ADDR
+static int lineRx = -1;							///<Console RX: the master side of the pseudo terminal
+static int lineTx = -1;							///<Console TX
+static HostBootHangup lineHangup;
+static struct usart_module *usart;				///<Last USART initialized
+static sercom_handler_t handler;				///<Set by _sercom_set_handler, reset by usart_reset
+
+static uint8_t rxData[HOST_BOOT_RX_SIZE];
+static uint32_t rxHead;							///<Next byte written
+static uint32_t rxTail;							///<Next byte read by usart_read_wait
+
+static uint8_t frame[HOST_BOOT_FRAME_MAX];		///<Bytes received since the last END
+static uint16_t frameLength;
+static double frameErrorRate;					///<Share of frames corrupted
+static uint32_t randomState;
+static uint32_t corrupted;						///<Frames corrupted
+
+/**************************************************************************//**
+* @fn		static uint32_t Random(void)
+* @brief	xorshift32, so a seed gives the same corrupted frames on every run
+*****************************************************************************/
+static uint32_t Random(void)
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+static void RxPut(uint8_t byte)
+{
+	if(rxHead - rxTail < HOST_BOOT_RX_SIZE) rxData[rxHead++ & (HOST_BOOT_RX_SIZE - 1)] = byte;
+}
+
+/**************************************************************************//**
+* @fn		static void LineReceive(const uint8_t *data, size_t length)
+* @brief	Bytes arrive from the host. A frame is passed on once its END is in, with one byte changed at frameErrorRate.
+*****************************************************************************/
+static void LineReceive(const uint8_t *data, size_t length)
+{
+	for(size_t i = 0; i < length; i++)
+	{
+		if(data[i] != HOST_BOOT_END)
+		{
+			if(frameLength == sizeof(frame))
+			{
+				//Not a frame of SerialUpload: pass it on as it is
+				for(uint16_t j = 0; j < frameLength; j++) RxPut(frame[j]);
+				frameLength = 0;
+			}
+			frame[frameLength++] = data[i];
+			continue;
+		}
+
+		if(frameLength > 0 && (Random() % 1000000) < (uint32_t)(frameErrorRate * 1000000.0))
+		{
+			frame[Random() % frameLength] ^= 0x5A;
+			corrupted++;
+		}
+		for(uint16_t j = 0; j < frameLength; j++) RxPut(frame[j]);
+		RxPut(HOST_BOOT_END);
+		frameLength = 0;
+	}
+}
+
+/******************************************************************************
+* NVM and DSU
+******************************************************************************/
+enum status_code nvm_erase_row(const uint32_t row_address)
+{
+	if(row_address < FLASH_ADDR || row_address >= FLASH_ADDR + FLASH_SIZE || row_address % HOST_BOOT_ROW_SIZE != 0)
+	{
+		return STATUS_ERR_BAD_ADDRESS;
+	}
+	memset(&flash[row_address - FLASH_ADDR], 0xFF, HOST_BOOT_ROW_SIZE);
+	return STATUS_OK;
+}
+
+enum status_code nvm_write_buffer(const uint32_t destination_address, const uint8_t *buffer, uint16_t length)
+{
+	if(destination_address < FLASH_ADDR || destination_address >= FLASH_ADDR + FLASH_SIZE ||
+	   destination_address % NVMCTRL_PAGE_SIZE != 0)
+	{
+		return STATUS_ERR_BAD_ADDRESS;
+	}
+	if(length > NVMCTRL_PAGE_SIZE) return STATUS_ERR_INVALID_ARG;
+
+	for(uint16_t i = 0; i < length; i++) flash[destination_address - FLASH_ADDR + i] &= buffer[i];
+	return STATUS_OK;
+}
+
+bool nvm_is_ready(void)
+{
+	return true;
+}
+
+enum status_code dsu_crc32_cal(const uint32_t addr, const uint32_t len, uint32_t *pcrc32)
+{
+	const uint8_t *data = (const uint8_t *)(uintptr_t) addr;
+	uint32_t crc = *pcrc32;
+
+	if(addr & 0x00000003) return STATUS_ERR_BAD_ADDRESS;
+	for(uint32_t i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		for(uint8_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+	}
+	*pcrc32 = crc;
+	return STATUS_OK;
+}
+
+/******************************************************************************
+* SERCOM and USART
+******************************************************************************/
+uint8_t _sercom_get_sercom_inst_index(Sercom *const sercom_instance)
+{
+	return 4;
+}
+
+uint8_t _sercom_get_interrupt_vector(Sercom *const sercom_instance)
+{
+	return 13;
+}
+
+void _sercom_set_handler(const uint8_t instance, const sercom_handler_t interrupt_handler)
+{
+	handler = interrupt_handler;
+}
+
+void system_interrupt_disable(const uint8_t vector)
+{
+	hostSercom.USART.INTENSET.reg = 0;
+}
+
+void usart_get_config_defaults(struct usart_config *const config)
+{
+	memset(config, 0, sizeof(*config));
+	config->baudrate = 9600;
+}
+
+enum status_code usart_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config)
+{
+	memset(module, 0, sizeof(*module));
+	module->hw = hw;
+	module->receiver_enabled = true;
+	module->baudrate = config->baudrate;
+	usart = module;
+	handler = NULL;
+	return STATUS_OK;
+}
+
+void usart_enable(struct usart_module *const module)
+{
+	module->enabled = true;
+}
+
+void usart_reset(struct usart_module *const module)
+{
+	module->enabled = false;
+	module->receiver_enabled = false;
+	module->hw->USART.INTENSET.reg = 0;
+	handler = NULL;
+}
+
+enum status_code usart_read_wait(struct usart_module *const module, uint16_t *const rx_data)
+{
+	if(!module->receiver_enabled) return STATUS_ERR_DENIED;
+	if(rxTail == rxHead) return STATUS_BUSY;
+
+	*rx_data = rxData[rxTail++ & (HOST_BOOT_RX_SIZE - 1)];
+	return STATUS_OK;
+}
+
+enum status_code usart_write_buffer_wait(struct usart_module *const module, const uint8_t *tx_data, uint16_t length)
+{
+	while(length > 0)
+	{
+		ssize_t written = write(lineTx, tx_data, length);
+		if(written < 0 && errno == EINTR) continue;
+		if(written <= 0) lineHangup();
+		tx_data += written;
+		length -= (uint16_t) written;
+	}
+	return STATUS_OK;
+}
+
+/**************************************************************************//**
+* @fn		void delay_cycles_us(uint32_t us)
+* @brief	Waits up to us for the host, and runs the interrupt handler on what arrived
+*****************************************************************************/
+void delay_cycles_us(uint32_t us)
+{
+	struct pollfd line = {.fd = lineRx, .events = POLLIN};
+	struct timespec timeout = {.tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000};
+	uint8_t data[HOST_BOOT_READ_SIZE];
+
+	if(ppoll(&line, 1, &timeout, NULL) <= 0) return;
+
+	ssize_t count = read(lineRx, data, sizeof(data));
+	if(count < 0 && (errno == EINTR || errno == EAGAIN)) return;
+	if(count <= 0) lineHangup(); //EIO on a pseudo terminal whose slave side is closed
+
+	LineReceive(data, (size_t) count);
+	if(usart != NULL && usart->enabled && handler != NULL && (hostSercom.USART.INTENSET.reg & SERCOM_USART_INTFLAG_RXC))
+	{
+		handler(_sercom_get_sercom_inst_index(EDBG_CDC_MODULE));
+	}
+}
+
+/******************************************************************************
+* Simulation
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void HostBootOpen(int rxFd, int txFd, double errorRate, uint32_t seed, HostBootHangup hangup)
+* @brief	Connects the console USART to the host and maps the flash, erased
+* @param[in]	errorRate Share of the frames from the host that get one byte changed
+* @param[in]	hangup Called once the host has closed the line
+*****************************************************************************/
+void HostBootOpen(int rxFd, int txFd, double errorRate, uint32_t seed, HostBootHangup hangup)
+{
+	lineRx = rxFd;
+	lineTx = txFd;
+	lineHangup = hangup;
+	frameErrorRate = errorRate;
+	randomState = (seed != 0) ? seed : 1;
+	HostBootEraseFlash();
+}
+
+/**************************************************************************//**
+* @fn		void HostBootEraseFlash(void)
+* @brief	Maps the flash at FLASH_ADDR on the first call, and erases all of it
+*****************************************************************************/
+void HostBootEraseFlash(void)
+{
+	if(flash == NULL)
+	{
+		flash = mmap((void *) FLASH_ADDR, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+		if(flash != (uint8_t *) FLASH_ADDR)
+		{
+			perror("host_boot: cannot map the flash");
+			exit(1);
+		}
+	}
+	memset(flash, 0xFF, FLASH_SIZE);
+}
+
+uint32_t HostBootCorrupted(void)
+{
+	return corrupted;
+}
+
+uint32_t HostBootBaudrate(void)
+{
+	return (usart != NULL) ? usart->baudrate : 0;
+}
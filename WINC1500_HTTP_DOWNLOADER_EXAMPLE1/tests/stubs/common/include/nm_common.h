@@ -0,0 +1,23 @@
+/**************************************************************************//**
+* @file      nm_common.h
+* @brief     Host stand-in for the WINC1500 common definitions: the integer types of the driver API.
+
+******************************************************************************/
+
+#ifndef HOST_NM_COMMON_H
+#define HOST_NM_COMMON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define NMI_API
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t sint8;
+typedef int16_t sint16;
+typedef int32_t sint32;
+
+#endif /*HOST_NM_COMMON_H*/
@@ -0,0 +1,13 @@
+/**************************************************************************//**
+* @file      conf_sw_timer.h
+* @brief     Host stand-in for conf_sw_timer.h: enough timers for test_sw_timer to run hundreds of them at once.
+
+******************************************************************************/
+
+#ifndef HOST_CONF_SW_TIMER_H
+#define HOST_CONF_SW_TIMER_H
+
+#define CONF_SW_TIMER_COUNT					200
+#define CONF_SW_TIMER_CALLBACK_CHANNEL		0
+
+#endif /*HOST_CONF_SW_TIMER_H*/
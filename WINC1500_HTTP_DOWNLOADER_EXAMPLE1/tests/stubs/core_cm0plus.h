@@ -0,0 +1,27 @@
+/**************************************************************************//**
+* @file      core_cm0plus.h
+* @brief     Host stand-in for the CMSIS core header, for the trace recorder's critical sections.
+PRIMASK is a plain variable: the tests run on one thread, so masking interrupts has nothing to hold off.
+
+******************************************************************************/
+
+#ifndef HOST_CORE_CM0PLUS_H
+#define HOST_CORE_CM0PLUS_H
+
+#include <stdint.h>
+
+#define __CORTEX_M				(0x00U)
+
+extern uint32_t hostPrimask;	///<PRIMASK register. Defined by host_trace.c
+
+static inline uint32_t __get_PRIMASK(void)
+{
+	return hostPrimask;
+}
+
+static inline void __set_PRIMASK(uint32_t priMask)
+{
+	hostPrimask = priMask;
+}
+
+#endif /*HOST_CORE_CM0PLUS_H*/
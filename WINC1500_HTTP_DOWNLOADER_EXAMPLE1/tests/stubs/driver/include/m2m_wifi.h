@@ -0,0 +1,14 @@
+/**************************************************************************//**
+* @file      m2m_wifi.h
+* @brief     Host stand-in for the WINC1500 Wi-Fi API: the event pump of the simulated WINC of host_winc.c.
+
+******************************************************************************/
+
+#ifndef HOST_M2M_WIFI_H
+#define HOST_M2M_WIFI_H
+
+#include "common/include/nm_common.h"
+
+sint8 m2m_wifi_handle_events(void *arg);
+
+#endif /*HOST_M2M_WIFI_H*/
@@ -0,0 +1,60 @@
+/**************************************************************************//**
+* @file      ff.h
+* @brief     Host stand-in for the FatFs R0.09 header: the file calls the modules under test make, on the in-memory
+volume of host_fatfs.c. Values match FatFs. The volume counts the calls made without the storage lock, which the
+test sets with HostFatFsSetLocked(); FatFs is built without re-entrancy, so every call must hold it.
+
+******************************************************************************/
+
+#ifndef HOST_FF_H
+#define HOST_FF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LUN_ID_SD_MMC_0_MEM		2		///<From conf_access.h
+
+typedef unsigned int UINT;
+typedef uint32_t DWORD;
+
+typedef enum
+{
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_INT_ERR,
+	FR_NOT_READY,
+	FR_NO_FILE,
+	FR_NO_PATH,
+	FR_INVALID_NAME,
+	FR_DENIED,
+	FR_EXIST,
+	FR_INVALID_OBJECT,
+} FRESULT;
+
+#define FA_READ				0x01
+#define FA_OPEN_EXISTING	0x00
+#define FA_WRITE			0x02
+#define FA_CREATE_ALWAYS	0x08
+
+typedef struct
+{
+	int file;			///<Index of the file on the volume, -1 when closed
+	uint8_t flag;		///<FA_READ and FA_WRITE
+	DWORD fptr;			///<File pointer
+	DWORD fsize;		///<File size
+} FIL;
+
+#define f_size(fp)			((fp)->fsize)
+
+FRESULT f_open(FIL *fp, const char *path, uint8_t mode);
+FRESULT f_close(FIL *fp);
+FRESULT f_lseek(FIL *fp, DWORD ofs);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+
+void HostFatFsReset(void);
+void HostFatFsSetLocked(bool locked);
+uint32_t HostFatFsUnlockedCalls(void);
+const uint8_t *HostFatFsFile(const char *path, uint32_t *size);
+
+#endif /*HOST_FF_H*/
@@ -0,0 +1,394 @@
+/**************************************************************************//**
+* @file      host_console.c
+* @brief     Simulated console UART and terminal behind the ASF USART calls of the host asf.h. See host_console.h.
+Only one USART is simulated: the last one initialized. XON and XOFF are taken by the terminal and are not part of
+its output, unless the terminal is set raw for a binary link.
+
+******************************************************************************/
+
+#include <string.h>
+#include "host_console.h"
+
+#define HOST_CONSOLE_TX_MAX		256		///<Longest write job: a page of the trace recorder's buffer
+#define ASCII_XON				0x11
+#define ASCII_XOFF				0x13
+
+static struct usart_module *usart;			///<Simulated USART
+static uint32_t baudrate;
+static uint64_t nowNs;						///<Simulated time
+static struct HostConsoleStats stats;
+
+static uint8_t txData[HOST_CONSOLE_TX_MAX];	///<Bytes of the write job in progress
+static uint16_t txLength;
+static uint64_t txAtNs;						///<Time at which the write job is out
+
+static const uint8_t *typeText;				///<Text the terminal types
+static size_t typeLength;
+static size_t typePos;
+static bool typeFlowControl;				///<The terminal stops on XOFF
+static bool raw;							///<XON and XOFF are data
+static bool paused;							///<XOFF seen and XON not seen yet
+static uint32_t lagLeft;					///<Bytes the terminal still sends after XOFF
+static uint64_t pausedAtNs;
+static uint64_t rxAtNs;						///<Time at which the next typed byte is in
+static uint8_t rxFifo[HOST_CONSOLE_RX_FIFO];	///<SERCOM receive buffer
+static uint8_t rxFifoCount;
+
+static uint8_t output[HOST_CONSOLE_OUTPUT_MAX];	///<What the terminal printed
+static size_t outputLength;
+
+/**************************************************************************//**
+* @fn		static void Sync(void)
+* @brief	Brings the simulated time up to the RTOS tick, which the tests and the RTOS stand-in may have moved
+*****************************************************************************/
+static void Sync(void)
+{
+	uint64_t tickNs = (uint64_t)hostTickCount * 1000000ULL;
+	if(tickNs > nowNs) nowNs = tickNs;
+}
+
+static void Advance(uint64_t ns)
+{
+	if(ns > nowNs) nowNs = ns;
+	hostTickCount = (TickType_t)(nowNs / 1000000ULL);
+}
+
+static bool Typing(void)
+{
+	return typePos < typeLength && (!paused || lagLeft > 0);
+}
+
+/**************************************************************************//**
+* @fn		static void Terminal(uint8_t byte)
+* @brief	A byte sent by the console reaches the terminal
+*****************************************************************************/
+static void Terminal(uint8_t byte)
+{
+	if(raw)
+	{
+		if(outputLength < sizeof(output)) output[outputLength++] = byte;
+	}
+	else if(byte == ASCII_XOFF)
+	{
+		stats.xoffs++;
+		if(typeFlowControl && !paused)
+		{
+			paused = true;
+			lagLeft = HOST_CONSOLE_XOFF_LAG;
+			pausedAtNs = nowNs;
+		}
+	}
+	else if(byte == ASCII_XON)
+	{
+		stats.xons++;
+		if(paused)
+		{
+			paused = false;
+			stats.pausedNs += nowNs - pausedAtNs;
+			if(rxAtNs < nowNs) rxAtNs = nowNs + HostConsoleByteNs();
+		}
+	}
+	else if(outputLength < sizeof(output))
+	{
+		output[outputLength++] = byte;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void CompleteTx(void)
+* @brief	The write job is out: the terminal gets its bytes, then the write callback runs
+*****************************************************************************/
+static void CompleteTx(void)
+{
+	Advance(txAtNs);
+	usart->remaining_tx_buffer_length = 0;
+	for(uint16_t i = 0; i < txLength; i++) Terminal(txData[i]);
+	if(usart->callbackEnabled[USART_CALLBACK_BUFFER_TRANSMITTED])
+	{
+		usart->callback[USART_CALLBACK_BUFFER_TRANSMITTED](usart);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void ReadFifo(void)
+* @brief	Moves the bytes of the SERCOM buffer into the read job, and runs the read callback once the job is full
+*****************************************************************************/
+static void ReadFifo(void)
+{
+	while(usart->remaining_rx_buffer_length > 0 && rxFifoCount > 0)
+	{
+		*usart->rxBuffer++ = rxFifo[0];
+		memmove(rxFifo, rxFifo + 1, --rxFifoCount);
+		if(--usart->remaining_rx_buffer_length == 0 && usart->callbackEnabled[USART_CALLBACK_BUFFER_RECEIVED])
+		{
+			usart->callback[USART_CALLBACK_BUFFER_RECEIVED](usart);
+		}
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void CompleteRx(void)
+* @brief	A typed byte is in the SERCOM buffer, or lost if it is full. An armed read job takes it.
+*****************************************************************************/
+static void CompleteRx(void)
+{
+	Advance(rxAtNs);
+	uint8_t byte = typeText[typePos++];
+	stats.typed++;
+	if(paused) lagLeft--;
+	rxAtNs += HostConsoleByteNs();
+
+	if(rxFifoCount < HOST_CONSOLE_RX_FIFO)
+	{
+		rxFifo[rxFifoCount++] = byte;
+	}
+	else
+	{
+		stats.overflows++;
+	}
+	if(usart->remaining_rx_buffer_length > 0) ReadFifo();
+}
+
+/**************************************************************************//**
+* @fn		static bool RunNext(uint64_t limitNs)
+* @brief	Runs the next event, transmit or receive, if it comes at or before limitNs
+* @return	true if an event was run
+*****************************************************************************/
+static bool RunNext(uint64_t limitNs)
+{
+	bool tx = (usart != NULL && usart->remaining_tx_buffer_length > 0 && txAtNs <= limitNs);
+	bool rx = (usart != NULL && Typing() && rxAtNs <= limitNs);
+
+	if(usart != NULL && usart->remaining_rx_buffer_length > 0 && rxFifoCount > 0)
+	{
+		ReadFifo(); //A read job armed while the SERCOM held bytes
+		return true;
+	}
+	if(tx && (!rx || txAtNs <= rxAtNs))
+	{
+		CompleteTx();
+		return true;
+	}
+	if(rx)
+	{
+		CompleteRx();
+		return true;
+	}
+	return false;
+}
+
+/******************************************************************************
+* USART
+******************************************************************************/
+uint32_t system_gclk_gen_get_hz(const uint8_t generator)
+{
+	(void)generator;
+	return 48000000UL;
+}
+
+void usart_get_config_defaults(struct usart_config *const config)
+{
+	memset(config, 0, sizeof(*config));
+	config->baudrate = 9600;
+}
+
+enum status_code usart_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config)
+{
+	memset(module, 0, sizeof(*module));
+	module->hw = hw;
+	usart = module;
+	baudrate = config->baudrate;
+	return STATUS_OK;
+}
+
+void usart_enable(struct usart_module *const module)
+{
+	module->enabled = true;
+}
+
+void usart_disable(struct usart_module *const module)
+{
+	module->enabled = false;
+}
+
+void usart_register_callback(struct usart_module *const module, usart_callback_t callback_func, enum usart_callback callback_type)
+{
+	module->callback[callback_type] = callback_func;
+}
+
+void usart_enable_callback(struct usart_module *const module, enum usart_callback callback_type)
+{
+	module->callbackEnabled[callback_type] = true;
+}
+
+enum status_code usart_get_job_status(struct usart_module *const module, enum usart_transceiver_type transceiver_type)
+{
+	if(transceiver_type == USART_TRANSCEIVER_RX)
+	{
+		return (module->remaining_rx_buffer_length > 0) ? STATUS_BUSY : STATUS_OK;
+	}
+	return (module->remaining_tx_buffer_length > 0) ? STATUS_BUSY : STATUS_OK;
+}
+
+enum status_code usart_read_buffer_job(struct usart_module *const module, uint8_t *rx_data, uint16_t length)
+{
+	if(length == 0) return STATUS_ERR_INVALID_ARG;
+	if(!module->enabled) return STATUS_ERR_DENIED;
+	if(module->remaining_rx_buffer_length > 0) return STATUS_BUSY;
+	module->rxBuffer = rx_data;
+	module->remaining_rx_buffer_length = length;
+	return STATUS_OK;
+}
+
+enum status_code usart_write_buffer_job(struct usart_module *const module, uint8_t *tx_data, uint16_t length)
+{
+	if(length == 0 || length > HOST_CONSOLE_TX_MAX) return STATUS_ERR_INVALID_ARG;
+	if(!module->enabled) return STATUS_ERR_DENIED;
+	if(module->remaining_tx_buffer_length > 0) return STATUS_BUSY;
+	Sync();
+	memcpy(txData, tx_data, length);
+	txLength = length;
+	txAtNs = nowNs + length * HostConsoleByteNs();
+	stats.txBusyNs += length * HostConsoleByteNs();
+	module->remaining_tx_buffer_length = length;
+	return STATUS_OK;
+}
+
+void usart_abort_job(struct usart_module *const module, enum usart_transceiver_type transceiver_type)
+{
+	if(transceiver_type == USART_TRANSCEIVER_RX)
+	{
+		module->remaining_rx_buffer_length = 0;
+	}
+	else
+	{
+		module->remaining_tx_buffer_length = 0;
+	}
+}
+
+/******************************************************************************
+* Simulation
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void HostConsoleReset(void)
+* @brief	Forgets the USART, the text being typed, the terminal output and the counters
+*****************************************************************************/
+void HostConsoleReset(void)
+{
+	usart = NULL;
+	baudrate = 0;
+	memset(&stats, 0, sizeof(stats));
+	txLength = 0;
+	typeText = NULL;
+	typeLength = typePos = 0;
+	paused = false;
+	raw = false;
+	rxFifoCount = 0;
+	outputLength = 0;
+	Sync();
+}
+
+uint64_t HostConsoleNowNs(void)
+{
+	Sync();
+	return nowNs;
+}
+
+/**************************************************************************//**
+* @fn		bool HostConsoleWait(TickType_t deadline)
+* @brief	Wait function of the RTOS stand-in: runs the next transmit or receive event if it comes by the deadline tick
+* @return	true if an event was run
+*****************************************************************************/
+bool HostConsoleWait(TickType_t deadline)
+{
+	Sync();
+	return RunNext((uint64_t)hostTickCount * 1000000ULL + (uint64_t)(int64_t)(int32_t)(deadline - hostTickCount) * 1000000ULL);
+}
+
+/**************************************************************************//**
+* @fn		void HostConsoleRunUntil(uint64_t ns)
+* @brief	Runs the events that come at or before ns, then moves the time to ns. Stands for the time a task computes.
+*****************************************************************************/
+void HostConsoleRunUntil(uint64_t ns)
+{
+	Sync();
+	while(RunNext(ns));
+	Advance(ns);
+}
+
+/**************************************************************************//**
+* @fn		uint64_t HostConsoleNextEventNs(void)
+* @brief	Time of the next transmit or receive event, so a model of the rest of the MCU can run up to it
+* @return	UINT64_MAX if there is none
+*****************************************************************************/
+uint64_t HostConsoleNextEventNs(void)
+{
+	uint64_t next = UINT64_MAX;
+
+	Sync();
+	if(usart == NULL) return next;
+	if(usart->remaining_rx_buffer_length > 0 && rxFifoCount > 0) return nowNs;
+	if(usart->remaining_tx_buffer_length > 0) next = txAtNs;
+	if(Typing() && rxAtNs < next) next = rxAtNs;
+	return next;
+}
+
+/**************************************************************************//**
+* @fn		uint64_t HostConsoleByteNs(void)
+* @brief	Time a byte takes on the line: start bit, 8 data bits and stop bit
+*****************************************************************************/
+uint64_t HostConsoleByteNs(void)
+{
+	return (baudrate != 0) ? 10000000000ULL / baudrate : 0;
+}
+
+/**************************************************************************//**
+* @fn		void HostConsoleType(const uint8_t *text, size_t length, bool flowControl)
+* @brief	Makes the terminal send text, starting one byte time from now. The text must stay valid until it is sent.
+* @param[in]	flowControl true if the terminal stops on XOFF
+*****************************************************************************/
+void HostConsoleType(const uint8_t *text, size_t length, bool flowControl)
+{
+	Sync();
+	typeText = text;
+	typeLength = length;
+	typePos = 0;
+	typeFlowControl = flowControl;
+	paused = false;
+	rxAtNs = nowNs + HostConsoleByteNs();
+}
+
+/**************************************************************************//**
+* @fn		bool HostConsoleTyping(void)
+* @brief	Tells whether the terminal has text left to send
+*****************************************************************************/
+bool HostConsoleTyping(void)
+{
+	return typePos < typeLength;
+}
+
+/**************************************************************************//**
+* @fn		void HostConsoleSetRaw(bool on)
+* @brief	Makes the terminal take XON and XOFF as data, as a capture tool on a binary link does
+*****************************************************************************/
+void HostConsoleSetRaw(bool on)
+{
+	raw = on;
+}
+
+const uint8_t *HostConsoleOutput(size_t *length)
+{
+	*length = outputLength;
+	return output;
+}
+
+void HostConsoleClearOutput(void)
+{
+	outputLength = 0;
+}
+
+const struct HostConsoleStats *HostConsoleGetStats(void)
+{
+	return &stats;
+}
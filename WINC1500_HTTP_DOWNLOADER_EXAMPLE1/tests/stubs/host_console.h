@@ -0,0 +1,46 @@
+/**************************************************************************//**
+* @file      host_console.h
+* @brief     Simulated console UART and terminal behind the ASF USART calls of the host asf.h.
+A byte takes ten bit times at the baud rate given to usart_init, on each direction. A write job completes with the
+callback of the module once its bytes are out, like the SERCOM interrupt; the bytes then reach the terminal. The
+terminal types the text it is given back to back at the line rate. With flow control on, it stops once it sees XOFF
+and resumes on XON, but a few bytes already in the USB bridge still arrive after XOFF. Set raw, the terminal takes
+XON and XOFF as data. A received byte goes into the armed read job, or into the two byte SERCOM buffer when none is
+armed; further bytes are lost. Time is kept in ns and drives the RTOS tick.
+
+******************************************************************************/
+
+#ifndef HOST_CONSOLE_H
+#define HOST_CONSOLE_H
+
+#include "asf.h"
+
+#define HOST_CONSOLE_RX_FIFO		2			///<Received bytes the SERCOM holds before it overflows
+#define HOST_CONSOLE_XOFF_LAG		16			///<Bytes the terminal still sends after it has seen XOFF
+#define HOST_CONSOLE_OUTPUT_MAX		65536		///<Bytes of terminal output kept for the test
+
+//What the terminal has seen
+struct HostConsoleStats
+{
+	uint32_t typed;				///<Bytes sent by the terminal
+	uint32_t overflows;			///<Bytes lost because the SERCOM buffer was full
+	uint32_t xoffs;				///<XOFF received
+	uint32_t xons;				///<XON received
+	uint64_t pausedNs;			///<Time the terminal held its text back for XOFF
+	uint64_t txBusyNs;			///<Time the console TX line was sending
+};
+
+void HostConsoleReset(void);
+uint64_t HostConsoleNowNs(void);
+bool HostConsoleWait(TickType_t deadline);
+void HostConsoleRunUntil(uint64_t ns);
+uint64_t HostConsoleNextEventNs(void);
+uint64_t HostConsoleByteNs(void);
+void HostConsoleType(const uint8_t *text, size_t length, bool flowControl);
+bool HostConsoleTyping(void);
+void HostConsoleSetRaw(bool on);
+const uint8_t *HostConsoleOutput(size_t *length);
+void HostConsoleClearOutput(void);
+const struct HostConsoleStats *HostConsoleGetStats(void);
+
+#endif /*HOST_CONSOLE_H*/
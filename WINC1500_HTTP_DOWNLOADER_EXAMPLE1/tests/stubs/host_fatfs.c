@@ -0,0 +1,141 @@
+/**************************************************************************//**
+* @file      host_fatfs.c
+* @brief     In-memory volume behind the host ff.h: a few files of up to HOST_FATFS_FILE_MAX bytes, found by path.
+Writing past HOST_FATFS_FILE_MAX writes less than asked, as on a full card.
+
+******************************************************************************/
+
+#include <string.h>
+#include "ff.h"
+
+#define HOST_FATFS_FILES		4
+#define HOST_FATFS_FILE_MAX		16384
+#define HOST_FATFS_PATH_MAX		16
+
+static struct
+{
+	char path[HOST_FATFS_PATH_MAX];		///<Empty for a free entry
+	uint8_t data[HOST_FATFS_FILE_MAX];
+	uint32_t size;
+} files[HOST_FATFS_FILES];
+static bool locked;				///<The storage lock is held
+static uint32_t unlockedCalls;	///<Calls made without the storage lock
+
+static void Call(void)
+{
+	if(!locked) unlockedCalls++;
+}
+
+static int Find(const char *path)
+{
+	for(int i = 0; i < HOST_FATFS_FILES; i++)
+	{
+		if(files[i].path[0] != 0 && strcmp(files[i].path, path) == 0) return i;
+	}
+	return -1;
+}
+
+FRESULT f_open(FIL *fp, const char *path, uint8_t mode)
+{
+	int file;
+
+	Call();
+	fp->file = -1;
+	if(strlen(path) >= HOST_FATFS_PATH_MAX) return FR_INVALID_NAME;
+	file = Find(path);
+	if(mode & FA_CREATE_ALWAYS)
+	{
+		for(int i = 0; file < 0 && i < HOST_FATFS_FILES; i++)
+		{
+			if(files[i].path[0] == 0) file = i;
+		}
+		if(file < 0) return FR_DENIED;
+		strcpy(files[file].path, path);
+		files[file].size = 0;
+	}
+	else if(file < 0)
+	{
+		return FR_NO_FILE;
+	}
+	fp->file = file;
+	fp->flag = mode & (FA_READ | FA_WRITE);
+	fp->fptr = 0;
+	fp->fsize = files[file].size;
+	return FR_OK;
+}
+
+FRESULT f_close(FIL *fp)
+{
+	Call();
+	if(fp->file < 0) return FR_INVALID_OBJECT;
+	fp->file = -1;
+	return FR_OK;
+}
+
+FRESULT f_lseek(FIL *fp, DWORD ofs)
+{
+	Call();
+	if(fp->file < 0) return FR_INVALID_OBJECT;
+	fp->fptr = (ofs < fp->fsize || (fp->flag & FA_WRITE)) ? ofs : fp->fsize;
+	return FR_OK;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br)
+{
+	Call();
+	*br = 0;
+	if(fp->file < 0) return FR_INVALID_OBJECT;
+	if(!(fp->flag & FA_READ)) return FR_DENIED;
+	if(fp->fptr < fp->fsize) *br = (btr < fp->fsize - fp->fptr) ? btr : fp->fsize - fp->fptr;
+	memcpy(buff, &files[fp->file].data[fp->fptr], *br);
+	fp->fptr += *br;
+	return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+	Call();
+	*bw = 0;
+	if(fp->file < 0) return FR_INVALID_OBJECT;
+	if(!(fp->flag & FA_WRITE)) return FR_DENIED;
+	if(fp->fptr < HOST_FATFS_FILE_MAX) *bw = (btw < HOST_FATFS_FILE_MAX - fp->fptr) ? btw : HOST_FATFS_FILE_MAX - fp->fptr;
+	memcpy(&files[fp->file].data[fp->fptr], buff, *bw);
+	fp->fptr += *bw;
+	if(fp->fptr > fp->fsize) fp->fsize = fp->fptr;
+	files[fp->file].size = fp->fsize;
+	return FR_OK;
+}
+
+/**************************************************************************//**
+* @fn		void HostFatFsReset(void)
+* @brief	Empties the volume and clears the count of unlocked calls
+*****************************************************************************/
+void HostFatFsReset(void)
+{
+	memset(files, 0, sizeof(files));
+	locked = false;
+	unlockedCalls = 0;
+}
+
+void HostFatFsSetLocked(bool isLocked)
+{
+	locked = isLocked;
+}
+
+uint32_t HostFatFsUnlockedCalls(void)
+{
+	return unlockedCalls;
+}
+
+/**************************************************************************//**
+* @fn		const uint8_t *HostFatFsFile(const char *path, uint32_t *size)
+* @brief	Gives the content of a file, NULL if there is none with this path
+*****************************************************************************/
+const uint8_t *HostFatFsFile(const char *path, uint32_t *size)
+{
+	int file = Find(path);
+
+	if(file < 0) return NULL;
+	*size = files[file].size;
+	return files[file].data;
+}
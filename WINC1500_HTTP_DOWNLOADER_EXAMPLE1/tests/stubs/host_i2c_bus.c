@@ -0,0 +1,477 @@
+/**************************************************************************//**
+* @file      host_i2c_bus.c
+* @brief     Simulated I2C bus behind the ASF I2C master calls of the host i2c_master.h. See host_i2c_bus.h.
+Only one job runs at a time, as on the SERCOM: its data moves when it completes.
+
+******************************************************************************/
+
+#include <string.h>
+#include "host_i2c_bus.h"
+
+#define HOST_I2C_SDA_PIN	PIN_PA08
+#define HOST_I2C_SCL_PIN	PIN_PA09
+
+static struct i2c_master_module *master;		///<Module of the SERCOM
+static uint16_t riseTimeNs;						///<SDA/SCL rise time given to i2c_master_init
+static HostI2cDevice *devices[HOST_I2C_MAX_DEVICES];
+static uint8_t deviceCount;
+static struct HostI2cBusStats stats;
+static uint64_t nowNs;							///<Simulated time
+static bool busOwned;							///<true from a START until its STOP
+
+//Job on the bus
+static struct
+{
+	bool pending;					///<true until the job completes
+	uint64_t atNs;					///<Time at which the job completes
+	HostI2cDevice *device;			///<Addressed device, NULL if it NACKs
+	bool read;						///<true for a read job
+	bool stop;						///<true if a STOP ends the job
+	bool early;						///<true for a read that starts before the device has its answer
+	uint8_t *data;
+	uint16_t length;
+	enum status_code status;		///<Status the job completes with
+	enum i2c_master_callback callback;
+} job;
+
+//Bus lines when they are GPIOs
+static struct
+{
+	bool output;		///<true if the pin drives its output level
+	bool level;			///<Output level
+} pins[2];
+static bool sclHigh = true;
+static bool sdaHigh = true;
+
+/**************************************************************************//**
+* @fn		static void Sync(void)
+* @brief	Brings the simulated time up to the RTOS tick, which the tests and the RTOS stand-in may have moved
+*****************************************************************************/
+static void Sync(void)
+{
+	uint64_t tickNs = (uint64_t)hostTickCount * 1000000ULL;
+	if(tickNs > nowNs) nowNs = tickNs;
+}
+
+static void Advance(uint64_t ns)
+{
+	if(ns > nowNs) nowNs = ns;
+	hostTickCount = (TickType_t)(nowNs / 1000000ULL);
+}
+
+static HostI2cDevice *FindDevice(uint16_t address)
+{
+	for(uint8_t i = 0; i < deviceCount; i++)
+	{
+		if(devices[i]->address == address) return devices[i];
+	}
+	return NULL;
+}
+
+static bool SdaHeld(void)
+{
+	for(uint8_t i = 0; i < deviceCount; i++)
+	{
+		if(devices[i]->stuckClocks > 0) return true;
+	}
+	return false;
+}
+
+/**************************************************************************//**
+* @fn		static uint64_t BitNs(void)
+* @brief	Time of one SCL clock at the frequency in the BAUD register, as i2c_master_init computes it
+*****************************************************************************/
+static uint64_t BitNs(void)
+{
+	const uint64_t riseCycles = ((HOST_I2C_GCLK_HZ / 1000) * riseTimeNs) / 1000000;
+	const uint64_t baud = master->hw->I2CM.BAUD.reg & 0xFF;
+
+	return ((2 * baud + 10 + riseCycles) * 1000000000ULL) / HOST_I2C_GCLK_HZ;
+}
+
+/**************************************************************************//**
+* @fn		static enum status_code StartJob(struct i2c_master_module *const module, struct i2c_master_packet *const packet, bool read, bool stop)
+* @brief	Starts a job: sends a START (or a repeated START), the address and the data
+*****************************************************************************/
+static enum status_code StartJob(struct i2c_master_module *const module, struct i2c_master_packet *const packet, bool read, bool stop)
+{
+	const uint64_t bit = BitNs();
+	uint64_t bits;
+
+	if(job.pending || module->buffer_remaining > 0) return STATUS_BUSY;
+	Sync();
+
+	module->send_stop = stop;
+	module->status = STATUS_BUSY;
+	module->buffer_length = packet->data_length;
+	module->buffer_remaining = packet->data_length;
+
+	memset(&job, 0, sizeof(job));
+	job.pending = true;
+	job.read = read;
+	job.stop = stop;
+	job.data = packet->data;
+	job.length = packet->data_length;
+	job.callback = read ? I2C_MASTER_CALLBACK_READ_COMPLETE : I2C_MASTER_CALLBACK_WRITE_COMPLETE;
+	job.status = STATUS_OK;
+	stats.jobs++;
+
+	if(busOwned) stats.repeatedStarts++;
+	else stats.starts++;
+	busOwned = true;
+
+	if(SdaHeld())
+	{
+		//Arbitration is lost on the first bit the SERCOM sends high; it lets the bus go without a STOP
+		bits = 2;
+		job.status = STATUS_ERR_PACKET_COLLISION;
+		job.callback = I2C_MASTER_CALLBACK_ERROR;
+		job.stop = false;
+		busOwned = false;
+		stats.collisions++;
+	}
+	else
+	{
+		job.device = FindDevice(packet->address);
+		if(job.device == NULL)
+		{
+			bits = 1 + 9;
+			job.status = STATUS_ERR_BAD_ADDRESS;
+			job.callback = I2C_MASTER_CALLBACK_ERROR;
+			stats.bytes++;
+		}
+		else
+		{
+			bits = 1 + 9 * (1 + (uint64_t)packet->data_length);
+			stats.bytes += 1 + packet->data_length;
+			job.early = read && nowNs < job.device->readyAtNs;
+			if(job.early) job.device->earlyReads++;
+		}
+		if(job.stop) bits++;
+	}
+
+	stats.busyNs += bits * bit;
+	job.atNs = nowNs + HOST_I2C_SETUP_NS + bits * bit;
+	return STATUS_OK;
+}
+
+/**************************************************************************//**
+* @fn		static void CompleteJob(void)
+* @brief	Moves the data of the job, sends its STOP and calls the callback of the module, as the SERCOM interrupt does
+*****************************************************************************/
+static void CompleteJob(void)
+{
+	HostI2cDevice *device = job.device;
+
+	job.pending = false;
+	Advance(job.atNs);
+
+	if(job.status == STATUS_OK && device != NULL)
+	{
+		if(job.read)
+		{
+			device->reads++;
+			if(job.early)
+			{
+				memset(job.data, 0xFF, job.length);
+			}
+			else if(device->read != NULL)
+			{
+				device->read(device, job.data, job.length);
+			}
+			else
+			{
+				for(uint16_t i = 0; i < job.length; i++) job.data[i] = device->regs[device->pointer++];
+			}
+		}
+		else
+		{
+			device->writes++;
+			if(device->write != NULL)
+			{
+				device->write(device, job.data, job.length);
+			}
+			else if(job.length > 0)
+			{
+				device->pointer = job.data[0];
+				for(uint16_t i = 1; i < job.length; i++) device->regs[device->pointer++] = job.data[i];
+			}
+		}
+	}
+
+	if(job.stop)
+	{
+		stats.stops++;
+		busOwned = false;
+		if(!job.read && device != NULL) device->readyAtNs = nowNs + device->answerNs;
+	}
+
+	master->buffer_remaining = 0;
+	master->status = job.status;
+	if(master->callbacks[job.callback] != NULL && master->callbackEnabled[job.callback])
+	{
+		master->callbacks[job.callback](master);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void LinesChanged(void)
+* @brief	Updates SDA and SCL after a GPIO change: counts the clocks a stuck device gets and the STOP conditions
+*****************************************************************************/
+static void LinesChanged(void)
+{
+	const uint8_t sda = HOST_I2C_SDA_PIN - PIN_PA08;
+	const uint8_t scl = HOST_I2C_SCL_PIN - PIN_PA08;
+	bool sclNow = !(pins[scl].output && !pins[scl].level);
+	bool sdaNow;
+
+	if(sclNow && !sclHigh)
+	{
+		stats.recoveryClocks++;
+		for(uint8_t i = 0; i < deviceCount; i++)
+		{
+			if(devices[i]->stuckClocks > 0) devices[i]->stuckClocks--;
+		}
+	}
+	sclHigh = sclNow;
+
+	sdaNow = !(pins[sda].output && !pins[sda].level) && !SdaHeld();
+	if(sdaNow && !sdaHigh && sclHigh)
+	{
+		stats.stops++;
+		busOwned = false;
+	}
+	sdaHigh = sdaNow;
+}
+
+/******************************************************************************
+* Bus control
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void HostI2cBusReset(void)
+* @brief	Removes the devices, clears the counters and lets the bus go. The time carries on from the RTOS tick.
+*****************************************************************************/
+void HostI2cBusReset(void)
+{
+	deviceCount = 0;
+	memset(&stats, 0, sizeof(stats));
+	memset(&job, 0, sizeof(job));
+	memset(pins, 0, sizeof(pins));
+	busOwned = false;
+	sclHigh = sdaHigh = true;
+	Sync();
+}
+
+void HostI2cBusAttach(HostI2cDevice *device)
+{
+	assert(deviceCount < HOST_I2C_MAX_DEVICES);
+	devices[deviceCount++] = device;
+}
+
+uint64_t HostI2cBusNowNs(void)
+{
+	Sync();
+	return nowNs;
+}
+
+/**************************************************************************//**
+* @fn		bool HostI2cBusWait(TickType_t deadline)
+* @brief	Wait function of the RTOS stand-in: completes the job on the bus if it ends at or before the deadline tick
+* @return	true if a job was completed
+*****************************************************************************/
+bool HostI2cBusWait(TickType_t deadline)
+{
+	uint64_t deadlineNs;
+
+	Sync();
+	deadlineNs = (uint64_t)hostTickCount * 1000000ULL + (uint64_t)(int64_t)(int32_t)(deadline - hostTickCount) * 1000000ULL;
+	if(!job.pending || job.atNs > deadlineNs) return false;
+	CompleteJob();
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		bool HostI2cBusNextNs(uint64_t *ns)
+* @brief	Gives the time at which the job on the bus completes, for wait functions that also run other devices
+* @return	true if a job is running
+*****************************************************************************/
+bool HostI2cBusNextNs(uint64_t *ns)
+{
+	if(job.pending) *ns = job.atNs;
+	return job.pending;
+}
+
+/**************************************************************************//**
+* @fn		void HostI2cBusRunUntil(uint64_t ns)
+* @brief	Completes the jobs that end at or before ns, then moves the time to ns
+*****************************************************************************/
+void HostI2cBusRunUntil(uint64_t ns)
+{
+	Sync();
+	while(job.pending && job.atNs <= ns) CompleteJob();
+	Advance(ns);
+}
+
+/**************************************************************************//**
+* @fn		uint32_t HostI2cBusSclKhz(void)
+* @brief	SCL frequency programmed in the BAUD register, in kHz
+*****************************************************************************/
+uint32_t HostI2cBusSclKhz(void)
+{
+	return (uint32_t)(1000000ULL / BitNs());
+}
+
+const struct HostI2cBusStats *HostI2cBusGetStats(void)
+{
+	return &stats;
+}
+
+/******************************************************************************
+* ASF I2C master
+******************************************************************************/
+void i2c_master_get_config_defaults(struct i2c_master_config *const config)
+{
+	memset(config, 0, sizeof(*config));
+	config->baud_rate = I2C_MASTER_BAUD_RATE_100KHZ;
+	config->buffer_timeout = 65535;
+	config->unknown_bus_state_timeout = 65535;
+	config->sda_scl_rise_time_ns = 215;
+}
+
+enum status_code i2c_master_init(struct i2c_master_module *const module, Sercom *const hw, const struct i2c_master_config *const config)
+{
+	const uint32_t fscl = 1000UL * config->baud_rate;
+	const uint32_t riseCycles = ((HOST_I2C_GCLK_HZ / 1000) * config->sda_scl_rise_time_ns) / 1000000;
+	int32_t baud = (int32_t)HOST_I2C_GCLK_HZ - (int32_t)(fscl * (10 + riseCycles));
+
+	memset(module, 0, sizeof(*module));
+	module->hw = hw;
+	module->unknown_bus_state_timeout = config->unknown_bus_state_timeout;
+	master = module;
+	riseTimeNs = config->sda_scl_rise_time_ns;
+
+	baud = (baud + (int32_t)(2 * fscl) - 1) / (int32_t)(2 * fscl);
+	hw->I2CM.BAUD.reg = SERCOM_I2CM_BAUD_BAUD(baud);
+	hw->I2CM.CTRLA.reg = I2C_MASTER_SPEED_STANDARD_AND_FAST;
+	hw->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(1);
+	return STATUS_OK;
+}
+
+void i2c_master_reset(struct i2c_master_module *const module)
+{
+	(void)module;
+}
+
+void i2c_master_enable(const struct i2c_master_module *const module)
+{
+	module->hw->I2CM.CTRLA.reg |= SERCOM_I2CM_CTRLA_ENABLE;
+}
+
+void i2c_master_disable(const struct i2c_master_module *const module)
+{
+	module->hw->I2CM.CTRLA.reg &= ~SERCOM_I2CM_CTRLA_ENABLE;
+}
+
+void i2c_master_register_callback(struct i2c_master_module *const module, const i2c_master_callback_t callback, enum i2c_master_callback callback_type)
+{
+	module->callbacks[callback_type] = callback;
+}
+
+void i2c_master_enable_callback(struct i2c_master_module *const module, enum i2c_master_callback callback_type)
+{
+	module->callbackEnabled[callback_type] = true;
+}
+
+enum status_code i2c_master_read_packet_job(struct i2c_master_module *const module, struct i2c_master_packet *const packet)
+{
+	return StartJob(module, packet, true, true);
+}
+
+enum status_code i2c_master_write_packet_job(struct i2c_master_module *const module, struct i2c_master_packet *const packet)
+{
+	return StartJob(module, packet, false, true);
+}
+
+enum status_code i2c_master_write_packet_job_no_stop(struct i2c_master_module *const module, struct i2c_master_packet *const packet)
+{
+	return StartJob(module, packet, false, false);
+}
+
+void i2c_master_cancel_job(struct i2c_master_module *const module)
+{
+	Sync();
+	if(job.pending)
+	{
+		//SCL stops where the job is
+		if(job.atNs > nowNs + HOST_I2C_SETUP_NS) stats.busyNs -= job.atNs - nowNs - HOST_I2C_SETUP_NS;
+		job.pending = false;
+	}
+	module->buffer_remaining = 0;
+	module->status = STATUS_ABORTED;
+}
+
+void i2c_master_send_stop(struct i2c_master_module *const module)
+{
+	(void)module;
+	if(busOwned && !SdaHeld())
+	{
+		stats.stops++;
+		busOwned = false;
+	}
+}
+
+uint32_t system_gclk_chan_get_hz(const uint8_t channel)
+{
+	(void)channel;
+	return HOST_I2C_GCLK_HZ;
+}
+
+void delay_us(uint32_t us)
+{
+	Sync();
+	Advance(nowNs + 1000ULL * us);
+}
+
+/******************************************************************************
+* GPIO and pinmux
+******************************************************************************/
+void port_get_config_defaults(struct port_config *const config)
+{
+	config->direction = PORT_PIN_DIR_INPUT;
+	config->input_pull = PORT_PIN_PULL_UP;
+	config->powersave = false;
+}
+
+void port_pin_set_config(const uint8_t gpio_pin, const struct port_config *const config)
+{
+	assert(gpio_pin == HOST_I2C_SDA_PIN || gpio_pin == HOST_I2C_SCL_PIN);
+	pins[gpio_pin - PIN_PA08].output = (config->direction != PORT_PIN_DIR_INPUT);
+	LinesChanged();
+}
+
+void port_pin_set_output_level(const uint8_t gpio_pin, const bool level)
+{
+	assert(gpio_pin == HOST_I2C_SDA_PIN || gpio_pin == HOST_I2C_SCL_PIN);
+	pins[gpio_pin - PIN_PA08].level = level;
+	LinesChanged();
+}
+
+bool port_pin_get_input_level(const uint8_t gpio_pin)
+{
+	LinesChanged();
+	return (gpio_pin == HOST_I2C_SDA_PIN) ? sdaHigh : sclHigh;
+}
+
+void system_pinmux_get_config_defaults(struct system_pinmux_config *const config)
+{
+	memset(config, 0, sizeof(*config));
+}
+
+void system_pinmux_pin_set_config(const uint8_t gpio_pin, const struct system_pinmux_config *const config)
+{
+	(void)config;
+	//The SERCOM takes the pin back
+	pins[gpio_pin - PIN_PA08].output = false;
+	LinesChanged();
+}
@@ -0,0 +1,63 @@
+/**************************************************************************//**
+* @file      host_i2c_bus.h
+* @brief     Simulated I2C bus behind the ASF I2C master calls of the host i2c_master.h.
+A job takes the time its bits need at the SCL frequency programmed in the BAUD register, plus HOST_I2C_SETUP_NS, and
+completes with the callback of the module, like the SERCOM interrupt. Time is kept in ns and drives the RTOS tick.
+The bus counts START, repeated START and STOP conditions and the time SCL runs. Devices are register files with an
+auto-increment pointer, unless they give their own read and write functions. A device can need some time after the
+STOP of a write before a read gets its answer (earlier reads get 0xFF), and it can hold SDA low until it is given a
+number of SCL clocks, as a slave that lost track of a transfer does. SDA and SCL can be driven as GPIOs for bus recovery.
+
+******************************************************************************/
+
+#ifndef HOST_I2C_BUS_H
+#define HOST_I2C_BUS_H
+
+#include "i2c_master.h"
+
+#define HOST_I2C_GCLK_HZ		48000000UL	///<Clock of SERCOM0
+#define HOST_I2C_SETUP_NS		2000		///<Time between the start of a job and its START on the bus: interrupt and driver
+#define HOST_I2C_MAX_DEVICES	4			///<Devices that can be attached to the bus
+
+typedef struct HostI2cDevice HostI2cDevice;
+
+///Model of a device on the bus
+struct HostI2cDevice
+{
+	uint8_t address;				///<7 bit address
+	uint32_t answerNs;				///<Time the device needs after the STOP of a write before a read gets its answer
+	uint8_t stuckClocks;			///<While not 0 the device holds SDA low. Each SCL clock on the GPIOs counts it down.
+	void (*write)(HostI2cDevice *device, const uint8_t *data, uint16_t length);	///<Takes the bytes of a write. NULL for a register file
+	void (*read)(HostI2cDevice *device, uint8_t *data, uint16_t length);		///<Gives the bytes of a read. NULL for a register file
+	void *context;					///<Free for the model of the device
+	uint8_t regs[256];				///<Register file
+	uint8_t pointer;				///<Register pointer: set by the first byte of a write, incremented by every byte
+	uint64_t readyAtNs;				///<Time from which a read gets the answer
+	uint32_t writes;				///<Write transfers to the device
+	uint32_t reads;					///<Read transfers from the device
+	uint32_t earlyReads;			///<Reads that came before the device had its answer ready
+};
+
+//What happened on the bus
+struct HostI2cBusStats
+{
+	uint32_t starts;				///<START conditions sent by the SERCOM
+	uint32_t repeatedStarts;		///<Repeated START conditions
+	uint32_t stops;					///<STOP conditions, from the SERCOM or the GPIOs
+	uint32_t jobs;					///<Jobs started
+	uint32_t bytes;					///<Bytes transferred, address bytes included
+	uint32_t collisions;			///<Jobs that failed because SDA was held low
+	uint32_t recoveryClocks;		///<SCL clocks sent on the GPIOs
+	uint64_t busyNs;				///<Time SCL ran for jobs
+};
+
+void HostI2cBusReset(void);
+void HostI2cBusAttach(HostI2cDevice *device);
+uint64_t HostI2cBusNowNs(void);
+bool HostI2cBusWait(TickType_t deadline);
+bool HostI2cBusNextNs(uint64_t *ns);
+void HostI2cBusRunUntil(uint64_t ns);
+uint32_t HostI2cBusSclKhz(void);
+const struct HostI2cBusStats *HostI2cBusGetStats(void);
+
+#endif /*HOST_I2C_BUS_H*/
@@ -0,0 +1,394 @@
+/**************************************************************************//**
+* @file      host_lsm6ds3.c
+* @brief     Model of the LSM6DS3 FIFO on the simulated I2C bus, and of the EXTINT its INT1 drives. See host_lsm6ds3.h.
+Samples are pushed when the simulated time reaches them: before the model answers the bus, and from the wait function.
+
+******************************************************************************/
+
+#include <string.h>
+#include "host_lsm6ds3.h"
+#include "IMU/lsm6ds_reg.h"
+
+#define HOST_LSM6DS3_WORDS_PER_SAMPLE	6
+#define HOST_LSM6DS3_INT1_FTH			0x08	///<INT1_FTH bit of INT1_CTRL
+#define HOST_LSM6DS3_CTRL3_C_DEFAULT	0x04	///<IF_INC set: the register address increments on every byte
+
+//FIFO output data rate of each ODR_FIFO code of FIFO_CTRL5, in tenths of Hz
+static const uint32_t odrFifoDeciHz[] = {0, 125, 260, 520, 1040, 2080, 4160, 8330, 16600, 33300, 66600};
+
+static HostI2cDevice device;
+static struct HostLsm6ds3Stats stats;
+static bool int1Connected;
+
+//FIFO
+static uint16_t fifo[HOST_LSM6DS3_FIFO_WORDS];
+static uint16_t fifoHead;					///<Index of the oldest word
+static uint16_t fifoCount;					///<Words in the FIFO
+static uint8_t pattern;						///<Position in its sample of the next word read: 0 for gyroscope X
+static bool overRun;						///<FIFO_OVER_RUN
+static bool streaming;						///<true in stream mode at a non-zero FIFO rate
+static uint64_t startNs;					///<Time stream mode started
+static uint64_t periodNs;					///<Time between two samples
+static uint32_t pushed;						///<Samples pushed since stream mode started
+
+//EXTINT channels
+static struct
+{
+	extint_callback_t callback;
+	bool enabled;					///<true while the callback is enabled
+	enum extint_detect detect;
+	bool level;						///<Line level the EIC saw last
+	bool edge;						///<An edge to detect came while the callback was enabled
+} extint[EIC_NUMBER_OF_INTERRUPTS];
+
+static uint16_t Watermark(void)
+{
+	return (uint16_t)(device.regs[LSM6DS3_FIFO_CTRL1] | ((device.regs[LSM6DS3_FIFO_CTRL2] & 0x0F) << 8));
+}
+
+static bool Int1Level(void)
+{
+	uint16_t watermark = Watermark();
+
+	return int1Connected && (device.regs[LSM6DS3_INT1_CTRL] & HOST_LSM6DS3_INT1_FTH) && watermark > 0 && fifoCount >= watermark;
+}
+
+/**************************************************************************//**
+* @fn		static void UpdateLines(void)
+* @brief	Lets the EIC see the line levels after a change, and latches the edges it is set to detect
+*****************************************************************************/
+static void UpdateLines(void)
+{
+	for(uint8_t channel = 0; channel < EIC_NUMBER_OF_INTERRUPTS; channel++)
+	{
+		bool level = (channel == HOST_LSM6DS3_INT1_CHANNEL) && Int1Level();
+		bool rising = level && !extint[channel].level;
+		bool falling = !level && extint[channel].level;
+
+		switch(extint[channel].detect)
+		{
+			case EXTINT_DETECT_RISING:
+				if(rising && extint[channel].enabled) extint[channel].edge = true;
+				break;
+			case EXTINT_DETECT_FALLING:
+				if(falling && extint[channel].enabled) extint[channel].edge = true;
+				break;
+			case EXTINT_DETECT_BOTH:
+				if((rising || falling) && extint[channel].enabled) extint[channel].edge = true;
+				break;
+			default:
+				break;
+		}
+		extint[channel].level = level;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static bool Interrupt(void)
+* @brief	Calls the callback of the first EXTINT channel that detects its line, like the EIC interrupt
+* @return	true if a callback was called
+*****************************************************************************/
+static bool Interrupt(void)
+{
+	for(uint8_t channel = 0; channel < EIC_NUMBER_OF_INTERRUPTS; channel++)
+	{
+		bool detected = extint[channel].edge ||
+			(extint[channel].detect == EXTINT_DETECT_HIGH && extint[channel].level) ||
+			(extint[channel].detect == EXTINT_DETECT_LOW && !extint[channel].level);
+
+		if(extint[channel].enabled && extint[channel].callback != NULL && detected)
+		{
+			extint[channel].edge = false;
+			if(channel == HOST_LSM6DS3_INT1_CHANNEL) stats.interrupts++;
+			extint[channel].callback();
+			return true;
+		}
+	}
+	return false;
+}
+
+static void Pop(void)
+{
+	fifoHead = (uint16_t)((fifoHead + 1) % HOST_LSM6DS3_FIFO_WORDS);
+	fifoCount--;
+	pattern = (uint8_t)((pattern + 1) % HOST_LSM6DS3_WORDS_PER_SAMPLE);
+}
+
+/**************************************************************************//**
+* @fn		static void Push(void)
+* @brief	Pushes the next sample. A full FIFO loses its oldest sample, which leaves the pattern where it was.
+*****************************************************************************/
+static void Push(void)
+{
+	int16_t words[HOST_LSM6DS3_WORDS_PER_SAMPLE];
+
+	if(fifoCount + HOST_LSM6DS3_WORDS_PER_SAMPLE > HOST_LSM6DS3_FIFO_WORDS)
+	{
+		for(uint8_t i = 0; i < HOST_LSM6DS3_WORDS_PER_SAMPLE; i++) Pop();
+		overRun = true;
+		stats.overwritten++;
+	}
+
+	HostLsm6ds3SampleWords(pushed++, words);
+	for(uint8_t i = 0; i < HOST_LSM6DS3_WORDS_PER_SAMPLE; i++)
+	{
+		fifo[(fifoHead + fifoCount++) % HOST_LSM6DS3_FIFO_WORDS] = (uint16_t)words[i];
+	}
+	stats.samples++;
+	if(fifoCount > stats.maxLevel) stats.maxLevel = fifoCount;
+}
+
+/**************************************************************************//**
+* @fn		static void CatchUp(void)
+* @brief	Pushes the samples taken up to now
+*****************************************************************************/
+static void CatchUp(void)
+{
+	uint64_t nowNs = HostI2cBusNowNs();
+
+	if(!streaming) return;
+	while(HostLsm6ds3SampleNs(pushed) <= nowNs) Push();
+	UpdateLines();
+}
+
+static void WriteRegister(uint8_t reg, uint8_t value)
+{
+	device.regs[reg] = value;
+	if(reg == LSM6DS3_FIFO_CTRL5)
+	{
+		uint8_t mode = value & 0x07;
+		uint8_t odr = (value >> 3) & 0x0F;
+
+		if(mode == LSM6DS3_BYPASS_MODE)
+		{
+			fifoHead = fifoCount = 0;
+			pattern = 0;
+			overRun = false;
+			streaming = false;
+		}
+		else if(mode == LSM6DS3_STREAM_MODE && odr > 0 && odr < sizeof(odrFifoDeciHz) / sizeof(odrFifoDeciHz[0]) && !streaming)
+		{
+			streaming = true;
+			startNs = HostI2cBusNowNs();
+			periodNs = 10000000000ULL / odrFifoDeciHz[odr];
+			pushed = 0;
+		}
+	}
+}
+
+static uint8_t ReadRegister(uint8_t reg)
+{
+	uint16_t watermark = Watermark();
+
+	switch(reg)
+	{
+		case LSM6DS3_FIFO_STATUS1:
+			return (uint8_t)fifoCount;
+		case LSM6DS3_FIFO_STATUS2:
+			return (uint8_t)(((fifoCount >> 8) & 0x0F) | ((fifoCount == 0) << 4) |
+				((fifoCount + HOST_LSM6DS3_WORDS_PER_SAMPLE > HOST_LSM6DS3_FIFO_WORDS) << 5) | (overRun << 6) |
+				((watermark > 0 && fifoCount >= watermark) << 7));
+		case LSM6DS3_FIFO_STATUS3:
+			return pattern;
+		case LSM6DS3_FIFO_STATUS4:
+			return 0;
+		default:
+			return device.regs[reg];
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void DeviceWrite(HostI2cDevice *dev, const uint8_t *data, uint16_t length)
+* @brief	The first byte sets the register address, the others are written from there on
+*****************************************************************************/
+static void DeviceWrite(HostI2cDevice *dev, const uint8_t *data, uint16_t length)
+{
+	CatchUp();
+	if(length == 0) return;
+	dev->pointer = data[0];
+	for(uint16_t i = 1; i < length; i++) WriteRegister(dev->pointer++, data[i]);
+	UpdateLines();
+}
+
+/**************************************************************************//**
+* @fn		static void DeviceRead(HostI2cDevice *dev, uint8_t *data, uint16_t length)
+* @brief	Reads from the register address on. FIFO_DATA_OUT_H pops the word and takes the address back to
+*			FIFO_DATA_OUT_L, so a long read keeps popping words. An empty FIFO reads 0.
+*****************************************************************************/
+static void DeviceRead(HostI2cDevice *dev, uint8_t *data, uint16_t length)
+{
+	CatchUp();
+	for(uint16_t i = 0; i < length; i++)
+	{
+		if(dev->pointer == LSM6DS3_FIFO_DATA_OUT_L || dev->pointer == LSM6DS3_FIFO_DATA_OUT_H)
+		{
+			uint16_t word = (fifoCount > 0) ? fifo[fifoHead] : 0;
+
+			if(dev->pointer == LSM6DS3_FIFO_DATA_OUT_L)
+			{
+				data[i] = (uint8_t)word;
+				dev->pointer = LSM6DS3_FIFO_DATA_OUT_H;
+			}
+			else
+			{
+				data[i] = (uint8_t)(word >> 8);
+				dev->pointer = LSM6DS3_FIFO_DATA_OUT_L;
+				if(fifoCount > 0)
+				{
+					Pop();
+					overRun = false;
+					stats.wordsRead++;
+				}
+			}
+		}
+		else
+		{
+			data[i] = ReadRegister(dev->pointer++);
+		}
+	}
+	UpdateLines();
+}
+
+/******************************************************************************
+* Sensor control
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void HostLsm6ds3Attach(void)
+* @brief	Puts the sensor back in its power-on state, INT1 wired, and attaches it to the bus
+*****************************************************************************/
+void HostLsm6ds3Attach(void)
+{
+	memset(&device, 0, sizeof(device));
+	memset(&stats, 0, sizeof(stats));
+	memset(extint, 0, sizeof(extint));
+	device.address = HOST_LSM6DS3_ADDRESS;
+	device.write = DeviceWrite;
+	device.read = DeviceRead;
+	device.regs[LSM6DS3_WHO_AM_I] = LSM6DS3_ID;
+	device.regs[LSM6DS3_CTRL3_C] = HOST_LSM6DS3_CTRL3_C_DEFAULT;
+	fifoHead = fifoCount = 0;
+	pattern = 0;
+	overRun = false;
+	streaming = false;
+	int1Connected = true;
+	HostI2cBusAttach(&device);
+}
+
+/**************************************************************************//**
+* @fn		void HostLsm6ds3ConnectInt1(bool connected)
+* @brief	Wires INT1 to its EXTINT pin, or leaves the pin to its pull-down
+*****************************************************************************/
+void HostLsm6ds3ConnectInt1(bool connected)
+{
+	int1Connected = connected;
+	UpdateLines();
+}
+
+/**************************************************************************//**
+* @fn		void HostLsm6ds3DropWords(uint16_t words)
+* @brief	Pops words from the FIFO, as a read cut short on the bus does
+*****************************************************************************/
+void HostLsm6ds3DropWords(uint16_t words)
+{
+	CatchUp();
+	while(words-- > 0 && fifoCount > 0) Pop();
+	UpdateLines();
+}
+
+/**************************************************************************//**
+* @fn		void HostLsm6ds3SampleWords(uint32_t sample, int16_t words[6])
+* @brief	Gives the FIFO words of a sample: its number in the first two gyroscope words, and values derived from it
+* @param[in]	sample Number of the sample since stream mode started
+* @param[out]	words Gyroscope X Y Z then accelerometer X Y Z
+*****************************************************************************/
+void HostLsm6ds3SampleWords(uint32_t sample, int16_t words[6])
+{
+	words[0] = (int16_t)(uint16_t)sample;
+	words[1] = (int16_t)(uint16_t)(sample >> 16);
+	words[2] = (int16_t)(uint16_t)~sample;
+	for(uint8_t axis = 0; axis < 3; axis++) words[3 + axis] = (int16_t)(uint16_t)(sample * 7 + axis * 1000);
+}
+
+uint64_t HostLsm6ds3SampleNs(uint32_t sample)
+{
+	return startNs + ((uint64_t)sample + 1) * periodNs;
+}
+
+uint32_t HostLsm6ds3Level(void)
+{
+	CatchUp();
+	return fifoCount;
+}
+
+/**************************************************************************//**
+* @fn		bool HostLsm6ds3Wait(TickType_t deadline)
+* @brief	Wait function of the RTOS stand-in: runs INT1, the bus and the samples, whichever comes first, up to the
+*			deadline tick
+* @return	true if something ran
+*****************************************************************************/
+bool HostLsm6ds3Wait(TickType_t deadline)
+{
+	int32_t ticks = (int32_t)(deadline - hostTickCount);
+	uint64_t deadlineNs = (uint64_t)hostTickCount * 1000000ULL + ((ticks > 0) ? (uint64_t)ticks * 1000000ULL : 0);
+	uint64_t sampleNs, jobNs;
+
+	CatchUp();
+	if(Interrupt()) return true;
+
+	sampleNs = streaming ? HostLsm6ds3SampleNs(pushed) : UINT64_MAX;
+	if(HostI2cBusNextNs(&jobNs) && jobNs <= sampleNs) return HostI2cBusWait(deadline);
+	if(sampleNs > deadlineNs) return false;
+
+	HostI2cBusRunUntil(sampleNs);
+	CatchUp();
+	Interrupt();
+	return true;
+}
+
+const struct HostLsm6ds3Stats *HostLsm6ds3GetStats(void)
+{
+	return &stats;
+}
+
+/******************************************************************************
+* ASF EXTINT
+******************************************************************************/
+void extint_chan_get_config_defaults(struct extint_chan_conf *const config)
+{
+	memset(config, 0, sizeof(*config));
+	config->gpio_pin_pull = EXTINT_PULL_UP;
+	config->detection_criteria = EXTINT_DETECT_FALLING;
+}
+
+void extint_chan_set_config(const uint8_t channel, const struct extint_chan_conf *const config)
+{
+	assert(channel < EIC_NUMBER_OF_INTERRUPTS);
+	extint[channel].detect = config->detection_criteria;
+	extint[channel].edge = false;
+	UpdateLines();
+}
+
+enum status_code extint_register_callback(const extint_callback_t callback, const uint8_t channel, const enum extint_callback_type type)
+{
+	(void)type;
+	if(channel >= EIC_NUMBER_OF_INTERRUPTS) return STATUS_ERR_INVALID_ARG;
+	extint[channel].callback = callback;
+	return STATUS_OK;
+}
+
+enum status_code extint_chan_enable_callback(const uint8_t channel, const enum extint_callback_type type)
+{
+	(void)type;
+	if(channel >= EIC_NUMBER_OF_INTERRUPTS) return STATUS_ERR_INVALID_ARG;
+	extint[channel].enabled = true;
+	return STATUS_OK;
+}
+
+enum status_code extint_chan_disable_callback(const uint8_t channel, const enum extint_callback_type type)
+{
+	(void)type;
+	if(channel >= EIC_NUMBER_OF_INTERRUPTS) return STATUS_ERR_INVALID_ARG;
+	extint[channel].enabled = false;
+	return STATUS_OK;
+}
@@ -0,0 +1,44 @@
+/**************************************************************************//**
+* @file      host_lsm6ds3.h
+* @brief     Model of the LSM6DS3 FIFO on the simulated I2C bus of host_i2c_bus.c, and of the EXTINT its INT1 drives.
+The model is a device of the bus with its own read and write functions. Writing FIFO_CTRL5 in stream mode starts the
+sampling at the FIFO output data rate; bypass mode empties the FIFO. Each sample pushes six words, gyroscope X Y Z then
+accelerometer X Y Z, whose values say which sample they are (see HostLsm6ds3SampleWords). The FIFO holds
+HOST_LSM6DS3_FIFO_WORDS words: when it is full a new sample overwrites the oldest one and sets FIFO_OVER_RUN, which
+the next word read clears. Reading FIFO_DATA_OUT_L pops one word per two bytes and rolls back on FIFO_DATA_OUT_L, the
+status registers give the level, the watermark flag and the pattern of the next word.
+INT1 is high while the watermark interrupt is routed to it and the FIFO holds at least the watermark. The EXTINT
+channel it is wired to calls its callback on a level or on an edge, as configured, from HostLsm6ds3Wait: the wait
+function of the RTOS stand-in, which also runs the bus, so a task that blocks sees samples come at their rate.
+
+******************************************************************************/
+
+#ifndef HOST_LSM6DS3_H
+#define HOST_LSM6DS3_H
+
+#include "host_i2c_bus.h"
+
+#define HOST_LSM6DS3_ADDRESS		0x6A		///<7 bit address with SA0 low
+#define HOST_LSM6DS3_FIFO_WORDS		4096		///<8 kbyte FIFO
+#define HOST_LSM6DS3_INT1_CHANNEL	EXT3_IRQ_INPUT	///<EXTINT channel INT1 is wired to
+
+//What the sensor has done
+struct HostLsm6ds3Stats
+{
+	uint32_t samples;			///<Samples pushed into the FIFO
+	uint32_t overwritten;		///<Samples lost because the FIFO was full
+	uint32_t wordsRead;			///<Words popped by FIFO reads
+	uint32_t maxLevel;			///<Most words the FIFO held
+	uint32_t interrupts;		///<EXTINT callbacks called for INT1
+};
+
+void HostLsm6ds3Attach(void);
+void HostLsm6ds3ConnectInt1(bool connected);
+void HostLsm6ds3DropWords(uint16_t words);
+void HostLsm6ds3SampleWords(uint32_t sample, int16_t words[6]);
+uint64_t HostLsm6ds3SampleNs(uint32_t sample);
+uint32_t HostLsm6ds3Level(void);
+bool HostLsm6ds3Wait(TickType_t deadline);
+const struct HostLsm6ds3Stats *HostLsm6ds3GetStats(void);
+
+#endif /*HOST_LSM6DS3_H*/
@@ -0,0 +1,286 @@
+/**************************************************************************//**
+* @file      host_peripherals.c
+* @brief     Simulated USART and TC behind the ASF driver calls of the host asf.h. See host_peripherals.h.
+Only one USART and one TC are simulated: the last ones initialized.
+
+******************************************************************************/
+
+#include <string.h>
+#include "host_peripherals.h"
+
+#define HOST_USART_PENDING_MAX	64	///<Bytes the peer can have in flight
+
+static struct usart_module *usart;			///<Simulated USART
+static struct tc_module *tc;				///<Simulated TC
+static HostUsartPeer usartPeer;				///<Device on the USART
+static uint8_t txData[HOST_USART_PENDING_MAX];	///<Bytes of the write job in progress
+static uint16_t txLength;					///<Number of bytes in txData
+static bool failNextWrite;					///<Makes the next usart_write_buffer_job() fail
+static struct { uint32_t tick; uint8_t data; } pending[HOST_USART_PENDING_MAX];	///<Bytes on their way from the peer
+static uint16_t pendingHead, pendingCount;
+static uint8_t rxFifo[HOST_USART_RX_FIFO];	///<SERCOM receive buffer
+static uint8_t rxFifoCount;
+static uint32_t rxOverflows;				///<Bytes lost because the receive buffer was full
+
+uint32_t system_gclk_gen_get_hz(const uint8_t generator)
+{
+	(void)generator;
+	return HOST_GCLK0_HZ;
+}
+
+/******************************************************************************
+* USART
+******************************************************************************/
+void usart_get_config_defaults(struct usart_config *const config)
+{
+	memset(config, 0, sizeof(*config));
+	config->baudrate = 9600;
+}
+
+enum status_code usart_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config)
+{
+	(void)config;
+	memset(module, 0, sizeof(*module));
+	module->hw = hw;
+	usart = module;
+	return STATUS_OK;
+}
+
+void usart_enable(struct usart_module *const module)
+{
+	module->enabled = true;
+}
+
+void usart_disable(struct usart_module *const module)
+{
+	module->enabled = false;
+}
+
+void usart_register_callback(struct usart_module *const module, usart_callback_t callback_func, enum usart_callback callback_type)
+{
+	module->callback[callback_type] = callback_func;
+}
+
+void usart_enable_callback(struct usart_module *const module, enum usart_callback callback_type)
+{
+	module->callbackEnabled[callback_type] = true;
+}
+
+enum status_code usart_read_buffer_job(struct usart_module *const module, uint8_t *rx_data, uint16_t length)
+{
+	if(length == 0) return STATUS_ERR_INVALID_ARG;
+	if(!module->enabled) return STATUS_ERR_DENIED;
+	if(module->remaining_rx_buffer_length > 0) return STATUS_BUSY;
+	module->rxBuffer = rx_data;
+	module->remaining_rx_buffer_length = length;
+	return STATUS_OK;
+}
+
+enum status_code usart_write_buffer_job(struct usart_module *const module, uint8_t *tx_data, uint16_t length)
+{
+	if(length == 0 || length > HOST_USART_PENDING_MAX) return STATUS_ERR_INVALID_ARG;
+	if(!module->enabled) return STATUS_ERR_DENIED;
+	if(module->remaining_tx_buffer_length > 0) return STATUS_BUSY;
+	if(failNextWrite)
+	{
+		failNextWrite = false;
+		return STATUS_BUSY;
+	}
+	memcpy(txData, tx_data, length);
+	txLength = length;
+	module->remaining_tx_buffer_length = length;
+	return STATUS_OK;
+}
+
+void usart_abort_job(struct usart_module *const module, enum usart_transceiver_type transceiver_type)
+{
+	//As in ASF: the job is dropped, the bytes already in the SERCOM stay there
+	if(transceiver_type == USART_TRANSCEIVER_RX)
+	{
+		module->remaining_rx_buffer_length = 0;
+	}
+	else
+	{
+		module->remaining_tx_buffer_length = 0;
+	}
+}
+
+enum status_code usart_read_wait(struct usart_module *const module, uint16_t *const rx_data)
+{
+	if(!module->enabled) return STATUS_ERR_DENIED;
+	if(module->remaining_rx_buffer_length > 0 || rxFifoCount == 0) return STATUS_BUSY;
+	*rx_data = rxFifo[0];
+	memmove(rxFifo, rxFifo + 1, --rxFifoCount);
+	return STATUS_OK;
+}
+
+/******************************************************************************
+* TC
+******************************************************************************/
+void tc_get_config_defaults(struct tc_config *const config)
+{
+	memset(config, 0, sizeof(*config));
+}
+
+enum status_code tc_init(struct tc_module *const module, Tc *const hw, const struct tc_config *const config)
+{
+	memset(module, 0, sizeof(*module));
+	module->hw = hw;
+	module->compare = config->counter_16_bit.compare_capture_channel[0];
+	tc = module;
+	return STATUS_OK;
+}
+
+enum status_code tc_register_callback(struct tc_module *const module, tc_callback_t callback_func, const enum tc_callback callback_type)
+{
+	(void)callback_type;
+	module->callback = callback_func;
+	return STATUS_OK;
+}
+
+void tc_enable_callback(struct tc_module *const module, const enum tc_callback callback_type)
+{
+	(void)callback_type;
+	module->callbackEnabled = true;
+}
+
+void tc_enable(const struct tc_module *const module)
+{
+	((struct tc_module *)module)->enabled = true;
+}
+
+void tc_disable(const struct tc_module *const module)
+{
+	((struct tc_module *)module)->enabled = false;
+}
+
+enum status_code tc_set_count_value(const struct tc_module *const module, const uint32_t count)
+{
+	((struct tc_module *)module)->countMilli = count * 1000;
+	return STATUS_OK;
+}
+
+enum status_code tc_set_compare_value(const struct tc_module *const module, const enum tc_compare_capture_channel channel_index,
+									  const uint32_t compare_value)
+{
+	(void)channel_index;
+	((struct tc_module *)module)->compare = compare_value;
+	return STATUS_OK;
+}
+
+/******************************************************************************
+* Simulation
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void HostPeripheralsReset(void)
+* @brief	Forgets the simulated peripherals, the peer and every byte in flight
+*****************************************************************************/
+void HostPeripheralsReset(void)
+{
+	usart = NULL;
+	tc = NULL;
+	usartPeer = NULL;
+	txLength = 0;
+	failNextWrite = false;
+	pendingHead = pendingCount = 0;
+	rxFifoCount = 0;
+	rxOverflows = 0;
+}
+
+void HostUsartSetPeer(HostUsartPeer peer)
+{
+	usartPeer = peer;
+}
+
+/**************************************************************************//**
+* @fn		void HostUsartReply(const uint8_t *data, uint16_t length, uint32_t delayMs)
+* @brief	Sends bytes from the peer. The first arrives delayMs from now, the next ones 1 ms apart.
+*			Bytes already in flight go first.
+*****************************************************************************/
+void HostUsartReply(const uint8_t *data, uint16_t length, uint32_t delayMs)
+{
+	uint32_t tick = hostTickCount + delayMs;
+
+	if(pendingCount != 0)
+	{
+		uint32_t last = pending[(pendingHead + pendingCount - 1) % HOST_USART_PENDING_MAX].tick;
+		if((int32_t)(tick - last) <= 0) tick = last + 1;
+	}
+	for(uint16_t i = 0; i < length && pendingCount < HOST_USART_PENDING_MAX; i++, pendingCount++)
+	{
+		uint16_t slot = (pendingHead + pendingCount) % HOST_USART_PENDING_MAX;
+		pending[slot].tick = tick + i;
+		pending[slot].data = data[i];
+	}
+}
+
+void HostUsartFailNextWrite(void)
+{
+	failNextWrite = true;
+}
+
+uint32_t HostUsartOverflows(void)
+{
+	return rxOverflows;
+}
+
+/**************************************************************************//**
+* @fn		static void HostStep(void)
+* @brief	Advances the simulation by 1 ms: TC compare, end of the write job, bytes from the peer, read job
+*****************************************************************************/
+static void HostStep(void)
+{
+	hostTickCount++;
+
+	if(tc != NULL && tc->enabled)
+	{
+		tc->countMilli += HOST_GCLK0_HZ / 1024;
+		if(tc->countMilli >= (tc->compare + 1) * 1000)
+		{
+			tc->countMilli -= (tc->compare + 1) * 1000;
+			if(tc->callbackEnabled && tc->callback != NULL) tc->callback(tc);
+		}
+	}
+
+	if(usart == NULL) return;
+
+	if(usart->remaining_tx_buffer_length > 0)
+	{
+		usart->remaining_tx_buffer_length = 0;
+		if(usartPeer != NULL) usartPeer(txData, txLength);
+	}
+
+	while(pendingCount != 0 && (int32_t)(hostTickCount - pending[pendingHead].tick) >= 0)
+	{
+		if(rxFifoCount < HOST_USART_RX_FIFO)
+		{
+			rxFifo[rxFifoCount++] = pending[pendingHead].data;
+		}
+		else
+		{
+			rxOverflows++;
+		}
+		pendingHead = (pendingHead + 1) % HOST_USART_PENDING_MAX;
+		pendingCount--;
+	}
+
+	while(usart->remaining_rx_buffer_length > 0 && rxFifoCount > 0)
+	{
+		*usart->rxBuffer++ = rxFifo[0];
+		memmove(rxFifo, rxFifo + 1, --rxFifoCount);
+		if(--usart->remaining_rx_buffer_length == 0 && usart->callbackEnabled[USART_CALLBACK_BUFFER_RECEIVED])
+		{
+			usart->callback[USART_CALLBACK_BUFFER_RECEIVED](usart);
+		}
+	}
+}
+
+/**************************************************************************//**
+* @fn		void HostPeripheralsRun(uint32_t ms)
+* @brief	Runs the simulation for ms milliseconds
+*****************************************************************************/
+void HostPeripheralsRun(uint32_t ms)
+{
+	while(ms-- > 0) HostStep();
+}
@@ -0,0 +1,31 @@
+/**************************************************************************//**
+* @file      host_peripherals.h
+* @brief     Simulated USART and TC behind the ASF driver calls of the host asf.h.
+Time advances one millisecond per step of HostPeripheralsRun(), which also advances the RTOS tick. At 9600 baud a
+byte takes about 1 ms, so a write job completes one step after it starts; the written bytes then go to the peer,
+a model of the device on the other end, which answers with HostUsartReply(). Received bytes go through a two byte
+hardware buffer: a byte that arrives with no read job armed stays there until a read job or usart_read_wait()
+takes it, and further bytes are lost, as on the SERCOM. Callbacks run from the step loop, like interrupts between
+two task instructions.
+
+******************************************************************************/
+
+#ifndef HOST_PERIPHERALS_H
+#define HOST_PERIPHERALS_H
+
+#include "asf.h"
+
+#define HOST_GCLK0_HZ		48000000UL	///<Frequency of GCLK generator 0, as configured in conf_clocks.h
+#define HOST_USART_RX_FIFO	2			///<Received bytes the SERCOM holds before it overflows
+
+///Model of the device on the USART. Called with the bytes of each write job once they are sent.
+typedef void (*HostUsartPeer)(const uint8_t *data, uint16_t length);
+
+void HostPeripheralsReset(void);
+void HostPeripheralsRun(uint32_t ms);
+void HostUsartSetPeer(HostUsartPeer peer);
+void HostUsartReply(const uint8_t *data, uint16_t length, uint32_t delayMs);
+void HostUsartFailNextWrite(void);
+uint32_t HostUsartOverflows(void);
+
+#endif /*HOST_PERIPHERALS_H*/
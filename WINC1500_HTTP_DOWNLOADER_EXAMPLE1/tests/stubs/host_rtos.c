@@ -0,0 +1,244 @@
+/**************************************************************************//**
+* @file      host_rtos.c
+* @brief     State behind the host stand-in of asf.h, the task API of a single task and the stream buffer.
+A task that blocks hands the time over to the wait function, which runs the simulated interrupts until the task is
+notified or its deadline is reached. Without a wait function, or once it has nothing left to run, the tick jumps to
+the deadline.
+
+******************************************************************************/
+
+#include <string.h>
+#include "asf.h"
+#include "stream_buffer.h"
+
+TickType_t hostTickCount;
+SysTick_Type hostSysTick;
+SCB_Type hostScb;
+Sercom hostSercom[6];
+Tc hostTc[6];
+uint32_t hostSuspendAllCount;
+uint32_t hostNotifyFromIsrCount;
+BaseType_t hostSchedulerState = taskSCHEDULER_RUNNING;
+
+static struct HostTask mainTask;
+TaskHandle_t hostCurrentTask = &mainTask;
+static HostRtosWait hostWait;
+
+/**************************************************************************//**
+* @fn		static bool HostRtosRunUntil(TickType_t deadline, const struct HostTask *task)
+* @brief	Runs the simulated interrupts until the task is notified or the deadline tick is reached
+* @param[in]	deadline Tick at which the wait ends
+* @param[in]	task Task to wait for, NULL to wait until the deadline whatever happens
+* @return	true if the task was notified
+*****************************************************************************/
+static bool HostRtosRunUntil(TickType_t deadline, const struct HostTask *task)
+{
+	while(task == NULL || !task->notified)
+	{
+		if(hostWait == NULL || !hostWait(deadline))
+		{
+			if((int32_t)(deadline - hostTickCount) > 0) hostTickCount = deadline;
+			break;
+		}
+	}
+	return task != NULL && task->notified;
+}
+
+/**************************************************************************//**
+* @fn		void HostRtosSetWait(HostRtosWait wait)
+* @brief	Sets the function that runs the simulated interrupts while a task blocks. NULL to let the time jump.
+*****************************************************************************/
+void HostRtosSetWait(HostRtosWait wait)
+{
+	hostWait = wait;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return hostCurrentTask;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+	switch(action)
+	{
+		case eSetBits:
+			task->notifiedValue |= value;
+			break;
+		case eIncrement:
+			task->notifiedValue++;
+			break;
+		case eSetValueWithoutOverwrite:
+			if(task->notified) return pdFAIL;
+			task->notifiedValue = value;
+			break;
+		case eSetValueWithOverwrite:
+			task->notifiedValue = value;
+			break;
+		case eNoAction:
+		default:
+			break;
+	}
+	task->notified = true;
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	hostNotifyFromIsrCount++;
+	if(pxHigherPriorityTaskWoken != NULL && task != hostCurrentTask) *pxHigherPriorityTaskWoken = pdTRUE;
+	return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t bitsToClearOnEntry, uint32_t bitsToClearOnExit, uint32_t *notificationValue, TickType_t ticksToWait)
+{
+	struct HostTask *task = hostCurrentTask;
+
+	if(!task->notified)
+	{
+		task->notifiedValue &= ~bitsToClearOnEntry;
+		if(ticksToWait == portMAX_DELAY)
+		{
+			//Only an interrupt can end the wait
+			while(!task->notified && hostWait != NULL && hostWait(hostTickCount + 0x7FFFFFFFUL));
+			assert(task->notified);
+		}
+		else if(ticksToWait > 0)
+		{
+			HostRtosRunUntil(hostTickCount + ticksToWait, task);
+		}
+	}
+
+	if(notificationValue != NULL) *notificationValue = task->notifiedValue;
+	if(!task->notified) return pdFALSE;
+	task->notified = false;
+	task->notifiedValue &= ~bitsToClearOnExit;
+	return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+	struct HostTask *task = hostCurrentTask;
+	uint32_t value;
+
+	if(task->notifiedValue == 0)
+	{
+		if(ticksToWait == portMAX_DELAY)
+		{
+			while(!task->notified && hostWait != NULL && hostWait(hostTickCount + 0x7FFFFFFFUL));
+			assert(task->notified);
+		}
+		else if(ticksToWait > 0)
+		{
+			HostRtosRunUntil(hostTickCount + ticksToWait, task);
+		}
+	}
+
+	value = task->notifiedValue;
+	if(value != 0) task->notifiedValue = clearCountOnExit ? 0 : value - 1;
+	task->notified = false;
+	return value;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	xTaskNotifyFromISR(task, 0, eIncrement, pxHigherPriorityTaskWoken);
+}
+
+void vTaskDelay(const TickType_t ticksToDelay)
+{
+	HostRtosRunUntil(hostTickCount + ticksToDelay, NULL);
+}
+
+void vTaskSuspendAll(void)
+{
+	hostSuspendAllCount++;
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+	return pdFALSE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+	buffer->taken = false;
+	return buffer;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+	(void)ticksToWait;
+	if(semaphore->taken) return pdFALSE;
+	semaphore->taken = true;
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+	if(!semaphore->taken) return pdFALSE;
+	semaphore->taken = false;
+	return pdTRUE;
+}
+
+/******************************************************************************
+* Stream buffer, with a trigger level of 1
+******************************************************************************/
+StreamBufferHandle_t xStreamBufferCreateStatic(size_t xBufferSizeBytes, size_t xTriggerLevelBytes, uint8_t *pucStreamBufferStorageArea,
+											   StaticStreamBuffer_t *pxStaticStreamBuffer)
+{
+	(void)xTriggerLevelBytes;
+	memset(pxStaticStreamBuffer, 0, sizeof(*pxStaticStreamBuffer));
+	pxStaticStreamBuffer->storage = pucStreamBufferStorageArea;
+	pxStaticStreamBuffer->length = xBufferSizeBytes;
+	return pxStaticStreamBuffer;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+	return (xStreamBuffer->head + xStreamBuffer->length - xStreamBuffer->tail) % xStreamBuffer->length;
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer)
+{
+	return xStreamBuffer->length - 1 - xStreamBufferBytesAvailable(xStreamBuffer);
+}
+
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+								BaseType_t *pxHigherPriorityTaskWoken)
+{
+	size_t space = xStreamBufferSpacesAvailable(xStreamBuffer);
+	size_t sent = (xDataLengthBytes < space) ? xDataLengthBytes : space;
+
+	for(size_t i = 0; i < sent; i++)
+	{
+		xStreamBuffer->storage[xStreamBuffer->head] = ((const uint8_t *)pvTxData)[i];
+		xStreamBuffer->head = (xStreamBuffer->head + 1) % xStreamBuffer->length;
+	}
+	if(sent > 0 && xStreamBuffer->reader != NULL)
+	{
+		xTaskNotifyFromISR(xStreamBuffer->reader, 0, eNoAction, pxHigherPriorityTaskWoken);
+		xStreamBuffer->reader = NULL;
+	}
+	return sent;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, TickType_t xTicksToWait)
+{
+	size_t received = xStreamBufferBytesAvailable(xStreamBuffer);
+
+	if(received == 0 && xTicksToWait > 0)
+	{
+		xStreamBuffer->reader = hostCurrentTask;
+		xTaskNotifyWait(0, 0, NULL, xTicksToWait);
+		xStreamBuffer->reader = NULL;
+		received = xStreamBufferBytesAvailable(xStreamBuffer);
+	}
+	if(received > xBufferLengthBytes) received = xBufferLengthBytes;
+	for(size_t i = 0; i < received; i++)
+	{
+		((uint8_t *)pvRxData)[i] = xStreamBuffer->storage[xStreamBuffer->tail];
+		xStreamBuffer->tail = (xStreamBuffer->tail + 1) % xStreamBuffer->length;
+	}
+	return received;
+}
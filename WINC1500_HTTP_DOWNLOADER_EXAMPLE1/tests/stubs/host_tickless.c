@@ -0,0 +1,642 @@
+/**************************************************************************//**
+* @file      host_tickless.c
+* @brief     Model of the MCU and of the FreeRTOS scheduler around the idle task. See host_tickless.h.
+Events (SysTick periods, the wake up timer match, the periodic interrupts and the driver interrupts of the tasks) are
+raised when the time reaches them. With interrupts unmasked their handlers run at once, else they stay pending.
+
+******************************************************************************/
+
+#include <string.h>
+#include "host_tickless.h"
+#include "PowerManager/PowerManager.h"
+
+#define HOST_TICKLESS_ENTRY_US	5	///<Time, in us, from the idle task's decision to the mask in PowerManagerSuppressTicksAndSleep()
+
+static uint64_t now;						///<Time, in CPU cycles
+static struct HostTicklessStats stats;
+static struct HostTicklessTask *tasks;
+static uint8_t taskCount;
+static struct HostTicklessIrq *irqs;
+static uint8_t irqCount;
+static uint32_t entryCycles;
+
+//Interrupts and scheduler
+static bool masked;					///<Interrupts masked by __disable_irq()
+static bool suspended;				///<Scheduler suspended by the idle task
+static uint32_t pendedTicks;		///<Ticks that came while the scheduler was suspended
+static bool yieldPending;			///<A task was made ready while the scheduler was suspended
+
+//SysTick
+static bool sysTickRunning;
+static uint64_t sysTickNext;		///<Time of the next tick while it runs
+static bool sysTickPending;
+
+//Wake up timer
+static struct
+{
+	struct tc_module *module;
+	uint32_t hz;					///<Count rate
+	bool runInStandby;
+	uint32_t compare;
+	bool running;
+	uint64_t startAt;				///<Time the count was 0
+	uint32_t count;					///<Count while stopped
+	bool match;						///<MC0 flag
+	bool pending;					///<MC0 interrupt pending
+} wakeTimer;
+
+//Sleep manager
+static uint8_t sleepLocks[SLEEPMGR_NR_OF_MODES];
+static enum system_sleepmode sleepMode;
+
+static void ServeInterrupts(void);
+static void SyncSysTick(void);
+
+/******************************************************************************
+* Scheduler
+******************************************************************************/
+static void RecordLag(void)
+{
+	int64_t lag = (int64_t)now - (int64_t)hostTickCount * HOST_TICK_CYCLES;
+
+	if(lag < stats.minLagCycles) stats.minLagCycles = lag;
+	if(lag > stats.maxLagCycles) stats.maxLagCycles = lag;
+}
+
+static void Block(struct HostTicklessTask *task, uint32_t ticks)
+{
+	task->ready = false;
+	task->wakeTick = (ticks == 0) ? portMAX_DELAY : hostTickCount + ticks;
+}
+
+static void MakeReady(struct HostTicklessTask *task)
+{
+	task->ready = true;
+	if(suspended) yieldPending = true;
+}
+
+/**************************************************************************//**
+* @fn		static void IncrementTick(void)
+* @brief	Steps the tick count and makes ready the tasks whose wait times out, as xTaskIncrementTick() does
+*****************************************************************************/
+static void IncrementTick(void)
+{
+	hostTickCount++;
+	RecordLag();
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		struct HostTicklessTask *task = &tasks[i];
+
+		if(task->ready || task->wakeTick != hostTickCount) continue;
+		if(task->inIo)
+		{
+			task->inIo = false;
+		}
+		else
+		{
+			uint64_t waited = now - task->blockedAt;
+			uint64_t due = (uint64_t)task->blockTicks * HOST_TICK_CYCLES;
+
+			task->timeouts++;
+			if(waited + HOST_TICK_CYCLES < due) task->early++;
+			if(waited > due && waited - due > task->maxLateCycles) task->maxLateCycles = waited - due;
+		}
+		MakeReady(task);
+	}
+}
+
+static void TickInterrupt(void)
+{
+	if(suspended) pendedTicks++;
+	else IncrementTick();
+}
+
+static TickType_t NextUnblockTick(void)
+{
+	TickType_t next = portMAX_DELAY;
+
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		if(tasks[i].ready || tasks[i].wakeTick == portMAX_DELAY) continue;
+		if(next == portMAX_DELAY || (int32_t)(tasks[i].wakeTick - next) < 0) next = tasks[i].wakeTick;
+	}
+	return next;
+}
+
+eSleepModeStatus eTaskConfirmSleepModeStatus(void)
+{
+	return yieldPending ? eAbortSleep : eStandardSleep;
+}
+
+/**************************************************************************//**
+* @fn		void vTaskStepTick(const TickType_t ticksToJump)
+* @brief	Steps the tick count after a sleep. Counts the steps past the next unblock time that tasks.c asserts against.
+*			The SysTick restarted before is seen from here, with the reload it was restarted with.
+*****************************************************************************/
+void vTaskStepTick(const TickType_t ticksToJump)
+{
+	TickType_t next = NextUnblockTick();
+
+	SyncSysTick();
+	if(next != portMAX_DELAY && ticksToJump > next - hostTickCount) stats.stepOverruns++;
+	hostTickCount += ticksToJump;
+	RecordLag();
+}
+
+/******************************************************************************
+* Events
+******************************************************************************/
+static uint32_t WakeTimerCount(void)
+{
+	if(!wakeTimer.running) return wakeTimer.count;
+	return (uint32_t)(((now - wakeTimer.startAt) * wakeTimer.hz) / HOST_CPU_HZ) & 0xFFFF;
+}
+
+static uint64_t WakeTimerMatchAt(void)
+{
+	return wakeTimer.startAt + ((uint64_t)wakeTimer.compare * HOST_CPU_HZ + wakeTimer.hz - 1) / wakeTimer.hz;
+}
+
+/**************************************************************************//**
+* @fn		static uint64_t NextEventAt(bool withTimer)
+* @brief	Gives the time of the next event
+* @param[in]	withTimer false while the wake up timer is stopped by standby
+* @return	Time of the next event, UINT64_MAX if there is none
+*****************************************************************************/
+static uint64_t NextEventAt(bool withTimer)
+{
+	uint64_t next = UINT64_MAX;
+
+	if(sysTickRunning) next = sysTickNext;
+	if(withTimer && wakeTimer.running && !wakeTimer.match && WakeTimerMatchAt() < next) next = WakeTimerMatchAt();
+	for(uint8_t i = 0; i < irqCount; i++)
+	{
+		if(irqs[i].periodUs != 0 && irqs[i].nextAt < next) next = irqs[i].nextAt;
+	}
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		if(tasks[i].inIo && !tasks[i].ioPending && tasks[i].ioDoneAt < next) next = tasks[i].ioDoneAt;
+	}
+	return next;
+}
+
+/**************************************************************************//**
+* @fn		static void RaiseEvents(void)
+* @brief	Raises the interrupts of the events due by now, and serves them unless interrupts are masked
+*****************************************************************************/
+static void RaiseEvents(void)
+{
+	if(sysTickRunning && sysTickNext <= now)
+	{
+		sysTickNext += hostSysTick.LOAD + 1;
+		sysTickPending = true;
+	}
+	if(wakeTimer.running && !wakeTimer.match && WakeTimerMatchAt() <= now)
+	{
+		wakeTimer.match = true;
+		wakeTimer.pending = wakeTimer.module->callbackEnabled;
+	}
+	for(uint8_t i = 0; i < irqCount; i++)
+	{
+		if(irqs[i].periodUs == 0 || irqs[i].nextAt > now) continue;
+		irqs[i].nextAt += (uint64_t)irqs[i].periodUs * HOST_CYCLES_PER_US;
+		irqs[i].pending = true;
+		irqs[i].count++;
+		if(!sysTickRunning) irqs[i].wakeups++;
+	}
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		if(tasks[i].inIo && tasks[i].ioDoneAt <= now) tasks[i].ioPending = true;
+	}
+	if(!masked) ServeInterrupts();
+}
+
+/**************************************************************************//**
+* @fn		static void ServeInterrupts(void)
+* @brief	Runs the handlers of the pending interrupts
+*****************************************************************************/
+static void ServeInterrupts(void)
+{
+	if(hostScb.ICSR & SCB_ICSR_PENDSTSET_Msk)
+	{
+		hostScb.ICSR &= ~SCB_ICSR_PENDSTSET_Msk;
+		sysTickPending = true;
+	}
+	if(sysTickPending)
+	{
+		sysTickPending = false;
+		TickInterrupt();
+	}
+	if(wakeTimer.pending)
+	{
+		wakeTimer.pending = false;
+		wakeTimer.module->callback(wakeTimer.module);
+	}
+	for(uint8_t i = 0; i < irqCount; i++)
+	{
+		if(!irqs[i].pending) continue;
+		irqs[i].pending = false;
+		if(irqs[i].task != NULL && !irqs[i].task->ready && !irqs[i].task->inIo) MakeReady(irqs[i].task);
+	}
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		if(!tasks[i].ioPending) continue;
+		tasks[i].ioPending = false;
+		if(!tasks[i].inIo) continue;
+		tasks[i].inIo = false;
+		MakeReady(&tasks[i]);
+	}
+}
+
+static bool AnyPending(void)
+{
+	if(sysTickPending || wakeTimer.pending || (hostScb.ICSR & SCB_ICSR_PENDSTSET_Msk)) return true;
+	for(uint8_t i = 0; i < irqCount; i++)
+	{
+		if(irqs[i].pending) return true;
+	}
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		if(tasks[i].ioPending) return true;
+	}
+	return false;
+}
+
+/**************************************************************************//**
+* @fn		static void SyncSysTick(void)
+* @brief	Follows the enable bit of SysTick->CTRL. Stopping keeps the us left in VAL; restarting goes on from VAL, or
+*			from a full period if VAL was written 0.
+*****************************************************************************/
+static void SyncSysTick(void)
+{
+	bool enabled = (hostSysTick.CTRL & SysTick_CTRL_ENABLE_Msk) != 0;
+
+	if(enabled && !sysTickRunning)
+	{
+		sysTickNext = now + ((hostSysTick.VAL != 0) ? hostSysTick.VAL : hostSysTick.LOAD + 1);
+		sysTickRunning = true;
+	}
+	else if(!enabled && sysTickRunning)
+	{
+		hostSysTick.VAL = (uint32_t)(sysTickNext - now);
+		sysTickRunning = false;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void Advance(uint64_t until)
+* @brief	Lets the time run, interrupts unmasked, serving the events up to until
+*****************************************************************************/
+static void Advance(uint64_t until)
+{
+	SyncSysTick();
+	while(true)
+	{
+		uint64_t next = NextEventAt(true);
+
+		if(next > until) break;
+		now = next;
+		RaiseEvents();
+	}
+	now = until;
+}
+
+/******************************************************************************
+* CMSIS core
+******************************************************************************/
+void __disable_irq(void)
+{
+	SyncSysTick();
+	masked = true;
+}
+
+void __enable_irq(void)
+{
+	SyncSysTick();
+	masked = false;
+	ServeInterrupts();
+}
+
+void __DSB(void)
+{
+
+}
+
+/**************************************************************************//**
+* @fn		void __WFI(void)
+* @brief	Sleeps until the next interrupt, which is left pending if interrupts are masked
+*****************************************************************************/
+void __WFI(void)
+{
+	bool timerStops = (sleepMode == SYSTEM_SLEEPMODE_STANDBY) && !wakeTimer.runInStandby;
+	uint64_t startAt = now;
+	uint64_t next;
+
+	SyncSysTick();
+	if(AnyPending()) return;
+	next = NextEventAt(!timerStops);
+	assert(next != UINT64_MAX);
+
+	now = next;
+	if(timerStops && wakeTimer.running) wakeTimer.startAt += now - startAt;
+	if(sysTickRunning)
+	{
+		stats.tickIdleCycles += now - startAt;
+	}
+	else
+	{
+		stats.suppressedCycles += now - startAt;
+		stats.modeCycles[sleepMode] += now - startAt;
+		stats.suppressedSleeps++;
+	}
+	RaiseEvents();
+}
+
+/******************************************************************************
+* TC: the wake up timer
+******************************************************************************/
+void tc_get_config_defaults(struct tc_config *const config)
+{
+	memset(config, 0, sizeof(*config));
+}
+
+enum status_code tc_init(struct tc_module *const module, Tc *const hw, const struct tc_config *const config)
+{
+	uint32_t clockHz = (config->clock_source == GCLK_GENERATOR_2) ? HOST_GCLK2_HZ : HOST_CPU_HZ;
+
+	memset(module, 0, sizeof(*module));
+	memset(&wakeTimer, 0, sizeof(wakeTimer));
+	module->hw = hw;
+	wakeTimer.module = module;
+	wakeTimer.hz = clockHz / ((config->clock_prescaler == TC_CLOCK_PRESCALER_DIV1) ? 1 : 1024);
+	wakeTimer.runInStandby = config->run_in_standby;
+	wakeTimer.compare = config->counter_16_bit.compare_capture_channel[0];
+	return STATUS_OK;
+}
+
+enum status_code tc_register_callback(struct tc_module *const module, tc_callback_t callback_func, const enum tc_callback callback_type)
+{
+	(void)callback_type;
+	module->callback = callback_func;
+	return STATUS_OK;
+}
+
+void tc_enable_callback(struct tc_module *const module, const enum tc_callback callback_type)
+{
+	(void)callback_type;
+	module->callbackEnabled = true;
+}
+
+//Enabling the TC starts the count, as on the SAM D21
+void tc_enable(const struct tc_module *const module)
+{
+	((struct tc_module *)module)->enabled = true;
+	tc_start_counter(module);
+}
+
+void tc_disable(const struct tc_module *const module)
+{
+	((struct tc_module *)module)->enabled = false;
+	tc_stop_counter(module);
+}
+
+enum status_code tc_set_compare_value(const struct tc_module *const module, const enum tc_compare_capture_channel channel_index,
+									  const uint32_t compare_value)
+{
+	(void)module;
+	(void)channel_index;
+	assert(compare_value <= 0xFFFF);
+	wakeTimer.compare = compare_value;
+	return STATUS_OK;
+}
+
+//Retriggers the count from 0
+void tc_start_counter(const struct tc_module *const module)
+{
+	(void)module;
+	wakeTimer.running = true;
+	wakeTimer.startAt = now;
+}
+
+void tc_stop_counter(const struct tc_module *const module)
+{
+	(void)module;
+	wakeTimer.count = WakeTimerCount();
+	wakeTimer.running = false;
+}
+
+uint32_t tc_get_status(struct tc_module *const module)
+{
+	(void)module;
+	return wakeTimer.match ? TC_STATUS_CHANNEL_0_MATCH : 0;
+}
+
+void tc_clear_status(struct tc_module *const module, const uint32_t status_flags)
+{
+	(void)module;
+	if(status_flags & TC_STATUS_CHANNEL_0_MATCH)
+	{
+		wakeTimer.match = false;
+		wakeTimer.pending = false;
+	}
+}
+
+uint32_t tc_get_count_value(const struct tc_module *const module)
+{
+	(void)module;
+	return WakeTimerCount();
+}
+
+/******************************************************************************
+* Sleep manager
+******************************************************************************/
+
+//Only the deepest mode is locked after the initialization, as in sleepmgr.h
+void sleepmgr_init(void)
+{
+	memset(sleepLocks, 0, sizeof(sleepLocks));
+	sleepLocks[SLEEPMGR_NR_OF_MODES - 1] = 1;
+}
+
+void sleepmgr_lock_mode(enum sleepmgr_mode mode)
+{
+	sleepLocks[mode]++;
+}
+
+void sleepmgr_unlock_mode(enum sleepmgr_mode mode)
+{
+	assert(sleepLocks[mode] > 0);
+	sleepLocks[mode]--;
+}
+
+//The shallowest locked mode
+enum sleepmgr_mode sleepmgr_get_sleep_mode(void)
+{
+	uint8_t mode = SLEEPMGR_ACTIVE;
+
+	while(sleepLocks[mode] == 0) mode++;
+	assert(mode < SLEEPMGR_NR_OF_MODES);
+	return (enum sleepmgr_mode)mode;
+}
+
+enum status_code system_set_sleepmode(const enum system_sleepmode sleep_mode)
+{
+	sleepMode = sleep_mode;
+	return STATUS_OK;
+}
+
+/******************************************************************************
+* Simulation
+******************************************************************************/
+static struct HostTicklessTask *NextReadyTask(void)
+{
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		if(tasks[i].ready) return &tasks[i];
+	}
+	return NULL;
+}
+
+/**************************************************************************//**
+* @fn		static void RunTask(struct HostTicklessTask *task)
+* @brief	Runs a pass of the task: waits for its driver's interrupt first if it has one, then takes the CPU and
+*			blocks again
+*****************************************************************************/
+static void RunTask(struct HostTicklessTask *task)
+{
+	uint32_t us;
+
+	if(task->ioUs != 0 && !task->ioServed)
+	{
+		task->inIo = true;
+		task->ioServed = true;
+		task->ioDoneAt = now + (uint64_t)task->ioUs * HOST_CYCLES_PER_US;
+		Block(task, task->ioTimeoutTicks);
+		return;
+	}
+	task->ioServed = false;
+	task->runs++;
+	us = (task->burstEvery != 0 && task->runs % task->burstEvery == 0) ? task->burstUs : task->runUs;
+	stats.busyCycles += (uint64_t)us * HOST_CYCLES_PER_US;
+	Advance(now + (uint64_t)us * HOST_CYCLES_PER_US);
+	task->blockedAt = now;
+	Block(task, task->blockTicks);
+}
+
+/**************************************************************************//**
+* @fn		static void ResumeAll(void)
+* @brief	Resumes the scheduler, serving the pended ticks, as xTaskResumeAll() does
+*****************************************************************************/
+static void ResumeAll(void)
+{
+	suspended = false;
+	yieldPending = false;
+	while(pendedTicks > 0)
+	{
+		pendedTicks--;
+		IncrementTick();
+	}
+}
+
+/**************************************************************************//**
+* @fn		void HostTicklessReset(struct HostTicklessTask *taskTable, uint8_t taskTableCount, struct HostTicklessIrq *irqTable, uint8_t irqTableCount)
+* @brief	Starts the time over, with the SysTick running and every task ready
+* @param[in]	taskTable Tasks, highest priority first
+* @param[in]	irqTable Periodic interrupts
+*****************************************************************************/
+void HostTicklessReset(struct HostTicklessTask *taskTable, uint8_t taskTableCount, struct HostTicklessIrq *irqTable, uint8_t irqTableCount)
+{
+	now = 0;
+	memset(&stats, 0, sizeof(stats));
+	tasks = taskTable;
+	taskCount = taskTableCount;
+	irqs = irqTable;
+	irqCount = irqTableCount;
+	entryCycles = HOST_TICKLESS_ENTRY_US * HOST_CYCLES_PER_US;
+	masked = suspended = yieldPending = false;
+	pendedTicks = 0;
+
+	hostTickCount = 0;
+	hostSysTick.CTRL = SysTick_CTRL_ENABLE_Msk;
+	hostSysTick.LOAD = HOST_TICK_CYCLES - 1;
+	hostSysTick.VAL = 0;
+	hostScb.ICSR = 0;
+	sysTickRunning = true;
+	sysTickNext = HOST_TICK_CYCLES;
+	sysTickPending = false;
+	sleepMode = SYSTEM_SLEEPMODE_IDLE_0;
+
+	for(uint8_t i = 0; i < taskCount; i++)
+	{
+		struct HostTicklessTask *task = &tasks[i];
+
+		task->ready = true;
+		task->inIo = task->ioPending = task->ioServed = false;
+		task->wakeTick = portMAX_DELAY;
+		task->ioDoneAt = task->blockedAt = 0;
+		task->runs = task->timeouts = task->early = 0;
+		task->maxLateCycles = 0;
+	}
+	for(uint8_t i = 0; i < irqCount; i++)
+	{
+		irqs[i].nextAt = (uint64_t)irqs[i].phaseUs * HOST_CYCLES_PER_US;
+		irqs[i].pending = false;
+		irqs[i].count = irqs[i].wakeups = 0;
+	}
+}
+
+//Time from the idle task's decision to sleep to the mask, in which an interrupt aborts the sleep
+void HostTicklessSetEntryUs(uint32_t us)
+{
+	entryCycles = us * HOST_CYCLES_PER_US;
+}
+
+/**************************************************************************//**
+* @fn		void HostTicklessRun(uint32_t ms)
+* @brief	Runs the tasks and the idle task for about ms milliseconds. A sleep that goes past the end is finished.
+*****************************************************************************/
+void HostTicklessRun(uint32_t ms)
+{
+	uint64_t startAt = now;
+	uint64_t end = now + (uint64_t)ms * 1000 * HOST_CYCLES_PER_US;
+
+	while(now < end)
+	{
+		struct HostTicklessTask *task = NextReadyTask();
+		TickType_t next;
+
+		if(task != NULL)
+		{
+			RunTask(task);
+			continue;
+		}
+
+		//Idle task, as prvIdleTask() with configUSE_TICKLESS_IDLE
+		next = NextUnblockTick();
+		if(next == portMAX_DELAY || next - hostTickCount >= HOST_EXPECTED_IDLE_TIME_BEFORE_SLEEP)
+		{
+			uint32_t sleeps = stats.suppressedSleeps;
+
+			suspended = true;
+			Advance(now + entryCycles);
+			stats.idleCalls++;
+			PowerManagerSuppressTicksAndSleep((next == portMAX_DELAY) ? portMAX_DELAY : next - hostTickCount);
+			ResumeAll();
+			if(stats.suppressedSleeps != sleeps || NextReadyTask() != NULL) continue;
+		}
+
+		//Wait for the next interrupt with the tick running
+		{
+			uint64_t eventAt = NextEventAt(true);
+
+			stats.tickIdleCycles += eventAt - now;
+			Advance(eventAt);
+		}
+	}
+	stats.totalCycles += now - startAt;
+}
+
+const struct HostTicklessStats *HostTicklessGetStats(void)
+{
+	return &stats;
+}
@@ -0,0 +1,87 @@
+/**************************************************************************//**
+* @file      host_tickless.h
+* @brief     Model of the MCU and of the FreeRTOS scheduler around the idle task, for portSUPPRESS_TICKS_AND_SLEEP.
+Time is kept in CPU cycles. The SysTick raises the tick every LOAD + 1 cycles while it is enabled; when it is stopped,
+VAL holds the cycles left in the running period. It restarts from VAL, or from LOAD + 1 if VAL was written 0. Interrupts are masked by __disable_irq() and
+kept pending until __enable_irq(), as on the Cortex-M0+; __WFI() waits for the next interrupt, masked or not. The TC
+that wakes the MCU up counts at the rate of its GCLK generator and prescaler, from tc_start_counter() to
+tc_stop_counter(). In standby it only counts with run_in_standby set. The sleep manager keeps its locks as the ASF one.
+The scheduler runs tasks that block with a timeout, as vTaskDelay() or a notification wait do, and the interrupts that
+wake them up. HostTicklessRun() gives the CPU to the first ready task in the table, and otherwise runs the idle task:
+when every task is blocked for at least HOST_EXPECTED_IDLE_TIME_BEFORE_SLEEP ticks it suspends the scheduler and calls
+PowerManagerSuppressTicksAndSleep(), else it waits for the next interrupt with the tick running. Interrupts that come
+while the scheduler is suspended make the task they wake pending, and ticks are pended until it resumes, as in tasks.c.
+
+******************************************************************************/
+
+#ifndef HOST_TICKLESS_H
+#define HOST_TICKLESS_H
+
+#include "asf.h"
+#include "host_peripherals.h"
+
+#define HOST_CPU_HZ								HOST_GCLK0_HZ	///<CPU and SysTick clock
+#define HOST_CYCLES_PER_US						(HOST_CPU_HZ / 1000000UL)
+#define HOST_TICK_CYCLES						(HOST_CPU_HZ / configTICK_RATE_HZ)	///<Tick period, as the port sets SysTick->LOAD
+#define HOST_EXPECTED_IDLE_TIME_BEFORE_SLEEP	5	///<As configEXPECTED_IDLE_TIME_BEFORE_SLEEP in FreeRTOSConfig.h
+#define HOST_GCLK2_HZ							32768UL	///<ULP oscillator behind GCLK generator 2
+
+//A task of the model. The test sets the first fields, the model keeps the others
+struct HostTicklessTask
+{
+	const char *name;
+	uint32_t blockTicks;		///<Timeout of the wait that ends each pass. 0 to wait for the interrupt only
+	uint32_t runUs;				///<CPU time of a pass
+	uint32_t burstEvery;		///<Every burstEvery-th pass takes burstUs instead. 0 for none
+	uint32_t burstUs;			///<CPU time of a burst pass, as a telemetry publish
+	uint32_t ioUs;				///<Time a pass first waits for its driver's interrupt, as an I2C read. 0 for none
+	uint32_t ioTimeoutTicks;	///<Timeout of that wait
+
+	bool ready;					///<Ready to run
+	bool inIo;					///<Blocked on its driver's interrupt
+	bool ioPending;				///<Its driver's interrupt came while interrupts were masked
+	bool ioServed;				///<The pass has had its driver's interrupt, and runs next
+	TickType_t wakeTick;		///<Tick at which the wait times out. portMAX_DELAY for none
+	uint64_t ioDoneAt;			///<Time the driver's interrupt comes while inIo
+	uint64_t blockedAt;			///<Time the last pass blocked
+	uint32_t runs;				///<Passes run
+	uint32_t timeouts;			///<Passes started by the wait timing out
+	uint32_t early;				///<Timeouts ended before blockTicks - 1 ticks of real time, which vTaskDelay() promises
+	uint64_t maxLateCycles;		///<Longest time past blockTicks ticks of real time that a timeout was served
+};
+
+//A periodic interrupt of the model
+struct HostTicklessIrq
+{
+	const char *name;
+	uint32_t periodUs;
+	uint32_t phaseUs;			///<Time of the first one
+	struct HostTicklessTask *task;	///<Task its handler wakes up, NULL for none
+
+	uint64_t nextAt;			///<Time of the next one
+	bool pending;				///<Came while interrupts were masked
+	uint32_t count;				///<Interrupts raised
+	uint32_t wakeups;			///<Sleeps with the tick suppressed that it ended
+};
+
+//What the MCU did
+struct HostTicklessStats
+{
+	uint64_t totalCycles;		///<Time simulated
+	uint64_t busyCycles;		///<Time tasks ran
+	uint64_t suppressedCycles;	///<Time asleep with the SysTick stopped
+	uint64_t tickIdleCycles;	///<Time the idle task waited with the tick running
+	uint64_t modeCycles[SYSTEM_SLEEPMODE_STANDBY + 1];	///<Time asleep with the tick suppressed, per sleep mode
+	uint32_t suppressedSleeps;	///<__WFI() calls with the SysTick stopped
+	uint32_t idleCalls;			///<Calls of PowerManagerSuppressTicksAndSleep()
+	uint32_t stepOverruns;		///<vTaskStepTick() calls past the next task unblock time, which tasks.c asserts against
+	int64_t minLagCycles;		///<Least real time ahead of the tick count: negative when the tick count got ahead
+	int64_t maxLagCycles;		///<Most real time ahead of the tick count
+};
+
+void HostTicklessReset(struct HostTicklessTask *tasks, uint8_t taskCount, struct HostTicklessIrq *irqs, uint8_t irqCount);
+void HostTicklessSetEntryUs(uint32_t us);
+void HostTicklessRun(uint32_t ms);
+const struct HostTicklessStats *HostTicklessGetStats(void);
+
+#endif /*HOST_TICKLESS_H*/
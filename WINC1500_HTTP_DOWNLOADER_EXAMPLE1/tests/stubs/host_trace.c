@@ -0,0 +1,210 @@
+/**************************************************************************//**
+* @file      host_trace.c
+* @brief     Host stand-in for the streaming part of trcKernelPort.c. See host_trace.h.
+vTraceEnable(), the body of TzCtrl, the recorder status checks and the stack monitor are those of trcKernelPort.c.
+
+******************************************************************************/
+
+#include "host_trace.h"
+#include "host_console.h"
+
+uint32_t hostPrimask;
+
+/* Monitored by TzCtrl task, that give warnings as User Events */
+extern volatile uint32_t NoRoomForSymbol;
+extern volatile uint32_t NoRoomForObjectData;
+extern volatile uint32_t LongestSymbolName;
+extern volatile uint32_t MaxBytesTruncated;
+extern void prvTraceWarning(int errCode);
+
+traceString trcWarningChannel;
+
+TRC_STREAM_PORT_ALLOCATE_FIELDS()
+
+static struct HostTraceTask *currentTask;
+static void *pCurrentTCB;
+static bool enabled;		///<vTraceEnable has run: TzCtrl would have been created
+
+/******************************************************************************
+* Stack monitor
+******************************************************************************/
+typedef struct {
+	void* tcb;
+	uint32_t uiPreviousLowMark;
+} TaskStackMonitorEntry_t;
+
+static TaskStackMonitorEntry_t tasksInStackMonitor[TRC_CFG_STACK_MONITOR_MAX_TASKS];
+static int tasksNotIncluded;
+
+void prvAddTaskToStackMonitor(void* task)
+{
+	for (int i = 0; i < TRC_CFG_STACK_MONITOR_MAX_TASKS; i++)
+	{
+		if (tasksInStackMonitor[i].tcb == NULL)
+		{
+			tasksInStackMonitor[i].tcb = task;
+			tasksInStackMonitor[i].uiPreviousLowMark = 0xFFFFFFFF;
+			return;
+		}
+	}
+	tasksNotIncluded++;
+}
+
+static void prvReportStackUsage(void)
+{
+	static int i = 0;	/* Static index used to loop over the monitored tasks */
+	int count = 0;		/* The number of generated reports */
+	int initial = i;	/* Used to make sure we break if we are back at the inital value */
+
+	do
+	{
+		if (tasksInStackMonitor[i].tcb != NULL)
+		{
+			uint32_t unusedStackSpace = ((struct HostTraceTask *)tasksInStackMonitor[i].tcb)->stackHighWaterMark;
+
+			if (tasksInStackMonitor[i].uiPreviousLowMark > unusedStackSpace)
+				tasksInStackMonitor[i].uiPreviousLowMark = unusedStackSpace;
+
+			prvTraceStoreEvent2(PSF_EVENT_UNUSED_STACK, (uint32_t)(uintptr_t)tasksInStackMonitor[i].tcb, tasksInStackMonitor[i].uiPreviousLowMark);
+
+			count++;
+		}
+
+		i = (i + 1) % TRC_CFG_STACK_MONITOR_MAX_TASKS; // Move i beyond this task
+	} while (count < TRC_CFG_STACK_MONITOR_MAX_REPORTS && i != initial);
+}
+
+/******************************************************************************
+* Kernel port
+******************************************************************************/
+void vTraceEnable(int startOption)
+{
+	TracealyzerCommandType msg;
+
+	//TRC_START_AWAIT_HOST would need TzCtrl to read the commands while main() waits
+	assert(startOption != TRC_START_AWAIT_HOST);
+
+	if (!enabled)
+	{
+		TRC_STREAM_PORT_INIT();
+		trcWarningChannel = xTraceRegisterString("#WFR");
+		enabled = true;
+	}
+
+	if (startOption == TRC_START)
+	{
+		msg.cmdCode = CMD_SET_ACTIVE;
+		msg.param1 = 1;
+		prvProcessCommand(&msg);
+	}
+}
+
+void* prvTraceGetCurrentTaskHandle(void)
+{
+	return currentTask;
+}
+
+uint32_t prvIsNewTCB(void* pNewTCB)
+{
+	if (pCurrentTCB != pNewTCB)
+	{
+		pCurrentTCB = pNewTCB;
+		return 1;
+	}
+	return 0;
+}
+
+unsigned char prvTraceIsSchedulerSuspended(void)
+{
+	return xTaskGetSchedulerState() == taskSCHEDULER_SUSPENDED;
+}
+
+static void prvCheckRecorderStatus(void)
+{
+	if (tasksNotIncluded > 0)
+	{
+		prvTraceWarning(PSF_WARNING_STACKMON_NO_SLOTS);
+		tasksNotIncluded = 0;
+	}
+
+	if (NoRoomForSymbol > 0)
+	{
+		prvTraceWarning(PSF_WARNING_SYMBOL_TABLE_SLOTS);
+		NoRoomForSymbol = 0;
+	}
+
+	if (NoRoomForObjectData > 0)
+	{
+		prvTraceWarning(PSF_WARNING_OBJECT_DATA_SLOTS);
+		NoRoomForObjectData = 0;
+	}
+
+	if (LongestSymbolName > (TRC_CFG_SYMBOL_MAX_LENGTH))
+	{
+		prvTraceWarning(PSF_WARNING_SYMBOL_MAX_LENGTH);
+		LongestSymbolName = 0;
+	}
+
+	if (MaxBytesTruncated > 0)
+	{
+		prvTraceWarning(PSF_WARNING_STRING_TOO_LONG);
+		MaxBytesTruncated = 0;
+	}
+}
+
+/**************************************************************************//**
+* @fn		void HostTraceControl(void)
+* @brief	One pass of the TzCtrl loop: takes the commands from the host and sends the full buffer pages, then checks
+*			the recorder and reports the stack use. The caller then delays TRC_CFG_CTRL_TASK_DELAY ticks.
+*****************************************************************************/
+void HostTraceControl(void)
+{
+	TracealyzerCommandType msg;
+	int32_t bytes = 0;
+	int32_t status = 0;
+
+	do
+	{
+		bytes = 0;
+		status = TRC_STREAM_PORT_READ_DATA(&msg, sizeof(TracealyzerCommandType), (int32_t*)&bytes);
+
+		if (status != 0)
+		{
+			vTraceStop();
+		}
+
+		if ((status == 0) && (bytes == sizeof(TracealyzerCommandType)))
+		{
+			if (prvIsValidCommand(&msg))
+			{
+				prvProcessCommand(&msg);
+			}
+		}
+
+		bytes = prvPagedEventBufferTransfer();
+	} while (bytes != 0);
+
+	if (xTraceIsRecordingEnabled())
+	{
+		prvCheckRecorderStatus();
+		prvReportStackUsage();
+	}
+}
+
+/**************************************************************************//**
+* @fn		void HostTraceSetCurrentTask(struct HostTraceTask *task)
+* @brief	Sets the task the recorder sees running: pxCurrentTCB of the scheduler model
+*****************************************************************************/
+void HostTraceSetCurrentTask(struct HostTraceTask *task)
+{
+	currentTask = task;
+}
+
+/**************************************************************************//**
+* @fn		uint32_t RuntimeStatsGetCounter(void)
+* @brief	Run time counter of RuntimeStats.c: 32768 Hz, from the simulated time
+*****************************************************************************/
+uint32_t RuntimeStatsGetCounter(void)
+{
+	return (uint32_t)(HostConsoleNowNs() * 32768ULL / 1000000000ULL);
+}
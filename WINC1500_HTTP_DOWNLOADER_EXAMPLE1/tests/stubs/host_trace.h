@@ -0,0 +1,27 @@
+/**************************************************************************//**
+* @file      host_trace.h
+* @brief     Host stand-in for the streaming part of trcKernelPort.c: what the trace recorder needs from FreeRTOS.
+The TzCtrl task is not created. HostTraceControl() runs one pass of its loop from the task the test runs as, and the
+test delays TRC_CFG_CTRL_TASK_DELAY ticks between passes, as TzCtrl does. The task the recorder sees running is the
+TCB given to HostTraceSetCurrentTask(), and the scheduler is suspended when hostSchedulerState says so. Timestamps come
+from RuntimeStatsGetCounter(), which counts at 32768 Hz in the time of host_console.c.
+
+******************************************************************************/
+
+#ifndef HOST_TRACE_H
+#define HOST_TRACE_H
+
+#include "trcRecorder.h"
+
+//The fields of a FreeRTOS TCB that the trace hooks read
+struct HostTraceTask
+{
+	const char *pcTaskName;
+	UBaseType_t uxPriority;
+	uint32_t stackHighWaterMark;	///<What uxTaskGetStackHighWaterMark() returns, in words
+};
+
+void HostTraceControl(void);
+void HostTraceSetCurrentTask(struct HostTraceTask *task);
+
+#endif /*HOST_TRACE_H*/
@@ -0,0 +1,506 @@
+/**************************************************************************//**
+* @file      host_winc.c
+* @brief     Simulated WINC1500 behind the host socket.h and m2m_wifi.h. See host_winc.h.
+
+******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_winc.h"
+
+//Request waiting for its event
+struct HostWincEvent
+{
+	uint64_t atNs;					///<Time at which the event comes
+	uint8_t type;					///<SOCKET_MSG_CONNECT, SOCKET_MSG_SEND or SOCKET_MSG_DNS_RESOLVE
+	SOCKET sock;
+	uint16_t session;				///<Session of the socket when the request was made
+	sint16 value;					///<Connect error or send result
+	const HostWincServer *server;	///<Server a connection goes to, NULL if refused
+	char host[HOSTNAME_MAX_SIZE];	///<Host name of a DNS query
+	uint32_t ip;					///<Reply to a DNS query, 0 if the host is unknown
+};
+
+//Bytes from the peer, in the order they come
+struct HostWincSegment
+{
+	uint32_t end;					///<Offset in rx after the last byte of the segment
+	uint64_t readyNs;				///<Time at which the segment has come
+};
+
+struct HostWincSocket
+{
+	bool used;
+	uint16_t session;				///<Counts the times the socket was opened
+	const HostWincServer *server;	///<Peer, once connected
+	bool peerClosed;				///<true once the peer closed the connection
+	uint64_t peerClosedNs;			///<Time at which the close reaches the device
+	uint64_t linkFreeNs;			///<Time at which the last segment from the peer has come
+	uint8_t *rx;					///<Bytes from the peer
+	uint32_t rxLength;
+	uint32_t rxRead;				///<Bytes of rx delivered to the device
+	uint32_t rxCapacity;
+	struct HostWincSegment *segments;
+	uint32_t segmentCount;
+	uint32_t segmentFirst;			///<First segment not delivered whole
+	uint32_t segmentCapacity;
+	bool recvPending;				///<true while a recv() waits
+	uint8_t *recvBuffer;
+	uint16_t recvLength;
+	uint64_t recvAtNs;				///<Time at which the recv() was made
+	uint64_t recvDeadlineNs;		///<Time at which the recv() times out, 0 for none
+};
+
+static tpfAppSocketCb socketCallback;
+static tpfAppResolveCb resolveCallback;
+static struct HostWincSocket sockets[MAX_SOCKET];
+static uint8_t nextTcpSocket;
+static struct HostWincEvent events[HOST_WINC_MAX_EVENTS];
+static uint8_t eventCount;
+static struct { const char *name; uint32_t ip; } hosts[HOST_WINC_MAX_HOSTS];
+static uint8_t hostCount;
+static const HostWincServer *servers[HOST_WINC_MAX_SERVERS];
+static uint8_t serverCount;
+static struct HostWincStats stats;
+static uint64_t nowNs;
+static uint32_t idleMs;						///<Time the pump found nothing to do, since the last event
+
+/**************************************************************************//**
+* @fn		static void Sync(void)
+* @brief	Brings the simulated time up to the RTOS tick, which the tests and the stacks may have moved
+*****************************************************************************/
+static void Sync(void)
+{
+	uint64_t tickNs = (uint64_t)hostTickCount * 1000000ULL;
+	if(tickNs > nowNs) nowNs = tickNs;
+}
+
+static void Advance(uint64_t ns)
+{
+	if(ns > nowNs) nowNs = ns;
+	hostTickCount = (TickType_t)(nowNs / 1000000ULL);
+}
+
+static struct HostWincSocket *Open(SOCKET sock)
+{
+	return (sock >= 0 && sock < MAX_SOCKET && sockets[sock].used) ? &sockets[sock] : NULL;
+}
+
+static struct HostWincEvent *Queue(uint8_t type, SOCKET sock, uint64_t delayNs)
+{
+	struct HostWincEvent *event;
+
+	assert(eventCount < HOST_WINC_MAX_EVENTS);
+	event = &events[eventCount++];
+	memset(event, 0, sizeof(*event));
+	event->atNs = nowNs + delayNs;
+	event->type = type;
+	event->sock = sock;
+	event->session = (sock >= 0) ? sockets[sock].session : 0;
+	return event;
+}
+
+/**************************************************************************//**
+* @fn		static bool RecvDue(const struct HostWincSocket *s, uint64_t *atNs)
+* @brief	Tells when the pending recv() of a socket completes
+* @return	false if it waits for something that has not happened yet
+*****************************************************************************/
+static bool RecvDue(const struct HostWincSocket *s, uint64_t *atNs)
+{
+	uint64_t earliest = s->recvAtNs + HOST_WINC_EVENT_NS;
+
+	if(!s->recvPending) return false;
+	if(s->segmentFirst < s->segmentCount)
+	{
+		*atNs = (s->segments[s->segmentFirst].readyNs > earliest) ? s->segments[s->segmentFirst].readyNs : earliest;
+		if(s->recvDeadlineNs == 0 || *atNs <= s->recvDeadlineNs) return true;
+	}
+	else if(s->peerClosed)
+	{
+		*atNs = (s->peerClosedNs > earliest) ? s->peerClosedNs : earliest;
+		if(s->recvDeadlineNs == 0 || *atNs <= s->recvDeadlineNs) return true;
+	}
+	if(s->recvDeadlineNs == 0) return false;
+	*atNs = s->recvDeadlineNs;
+	return true;
+}
+
+/**************************************************************************//**
+* @fn		static void CompleteRecv(SOCKET sock)
+* @brief	Completes the pending recv() of a socket at the current time: with every byte that has come, up to the
+*			buffer size; with 0 if the peer closed; with SOCK_ERR_TIMEOUT otherwise
+*****************************************************************************/
+static void CompleteRecv(SOCKET sock)
+{
+	struct HostWincSocket *s = &sockets[sock];
+	tstrSocketRecvMsg msg;
+	uint32_t available = s->rxRead;
+
+	while(s->segmentFirst < s->segmentCount && s->segments[s->segmentFirst].readyNs <= nowNs)
+	{
+		available = s->segments[s->segmentFirst].end;
+		if(available - s->rxRead >= s->recvLength) break;
+		s->segmentFirst++;
+	}
+	if(available - s->rxRead > s->recvLength) available = s->rxRead + s->recvLength;
+	if(s->segmentFirst < s->segmentCount && s->segments[s->segmentFirst].end == available) s->segmentFirst++;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.pu8Buffer = s->recvBuffer;
+	if(available > s->rxRead)
+	{
+		msg.s16BufferSize = (sint16)(available - s->rxRead);
+		memcpy(s->recvBuffer, &s->rx[s->rxRead], (size_t)msg.s16BufferSize);
+		s->rxRead = available;
+		stats.bytesReceived += (uint32_t)msg.s16BufferSize;
+		if(s->rxRead == s->rxLength) s->rxRead = s->rxLength = s->segmentCount = s->segmentFirst = 0;
+	}
+	else
+	{
+		msg.s16BufferSize = s->peerClosed ? 0 : SOCK_ERR_TIMEOUT;
+	}
+	s->recvPending = false;
+	stats.events++;
+	socketCallback(sock, SOCKET_MSG_RECV, &msg);
+}
+
+static void Deliver(const struct HostWincEvent *event)
+{
+	struct HostWincSocket *s = (event->sock >= 0) ? Open(event->sock) : NULL;
+
+	if(event->type == SOCKET_MSG_DNS_RESOLVE)
+	{
+		stats.resolves++;
+		resolveCallback((uint8 *)event->host, event->ip);
+		return;
+	}
+	if(s == NULL || s->session != event->session)
+	{
+		stats.staleEvents++;
+		return;
+	}
+
+	stats.events++;
+	if(event->type == SOCKET_MSG_CONNECT)
+	{
+		tstrSocketConnectMsg msg = {event->sock, (sint8)event->value};
+
+		if(event->server != NULL)
+		{
+			s->server = event->server;
+			stats.connects++;
+			if(s->server->accepted != NULL) s->server->accepted(event->sock);
+		}
+		socketCallback(event->sock, SOCKET_MSG_CONNECT, &msg);
+	}
+	else
+	{
+		sint16 result = event->value;
+		socketCallback(event->sock, SOCKET_MSG_SEND, &result);
+	}
+}
+
+/******************************************************************************
+* Socket API
+******************************************************************************/
+void socketInit(void)
+{
+}
+
+void registerSocketCallback(tpfAppSocketCb socket_cb, tpfAppResolveCb resolve_cb)
+{
+	socketCallback = socket_cb;
+	resolveCallback = resolve_cb;
+}
+
+/**************************************************************************//**
+* @fn		SOCKET socket(uint16 u16Domain, uint8 u8Type, uint8 u8Flags)
+* @brief	socket(): takes the next free TCP socket in turn, as the driver does
+*****************************************************************************/
+SOCKET socket(uint16 u16Domain, uint8 u8Type, uint8 u8Flags)
+{
+	(void)u8Flags;
+	if(u16Domain != AF_INET || u8Type != SOCK_STREAM) return -1;
+
+	for(uint8_t i = 0; i < TCP_SOCK_MAX; i++)
+	{
+		SOCKET sock = (SOCKET)nextTcpSocket;
+		struct HostWincSocket *s = &sockets[sock];
+
+		nextTcpSocket = (uint8_t)((nextTcpSocket + 1) % TCP_SOCK_MAX);
+		if(!s->used)
+		{
+			uint16_t session = (uint16_t)(s->session + 1);
+			memset(s, 0, sizeof(*s));
+			s->used = true;
+			s->session = session;
+			stats.sockets++;
+			return sock;
+		}
+	}
+	return -1;
+}
+
+sint8 connect(SOCKET sock, struct sockaddr *pstrAddr, uint8 u8AddrLen)
+{
+	struct HostWincSocket *s = Open(sock);
+	const struct sockaddr_in *addr = (const struct sockaddr_in *)pstrAddr;
+	struct HostWincEvent *event;
+
+	if(s == NULL || pstrAddr == NULL || u8AddrLen == 0 || s->server != NULL) return SOCK_ERR_INVALID_ARG;
+
+	Sync();
+	event = Queue(SOCKET_MSG_CONNECT, sock, HOST_WINC_CONNECT_NS);
+	event->value = SOCK_ERR_CONN_ABORTED;
+	for(uint8_t i = 0; i < serverCount; i++)
+	{
+		if(servers[i]->ip == addr->sin_addr.s_addr && servers[i]->port == _ntohs(addr->sin_port))
+		{
+			event->server = servers[i];
+			event->value = SOCK_ERR_NO_ERROR;
+			return SOCK_ERR_NO_ERROR;
+		}
+	}
+	stats.refused++;
+	return SOCK_ERR_NO_ERROR;
+}
+
+/**************************************************************************//**
+* @fn		sint16 send(SOCKET sock, void *pvSendBuffer, uint16 u16SendLength, uint16 u16Flags)
+* @brief	send(): the peer gets the bytes at once; SOCKET_MSG_SEND comes once they are out
+*****************************************************************************/
+sint16 send(SOCKET sock, void *pvSendBuffer, uint16 u16SendLength, uint16 u16Flags)
+{
+	struct HostWincSocket *s = Open(sock);
+	struct HostWincEvent *event;
+
+	(void)u16Flags;
+	if(s == NULL || s->server == NULL || pvSendBuffer == NULL || u16SendLength > SOCKET_BUFFER_MAX_LENGTH)
+	{
+		return SOCK_ERR_INVALID_ARG;
+	}
+
+	Sync();
+	event = Queue(SOCKET_MSG_SEND, sock, HOST_WINC_EVENT_NS + u16SendLength * HOST_WINC_BYTE_NS);
+	if(s->peerClosed)
+	{
+		event->value = SOCK_ERR_CONN_ABORTED;
+		return SOCK_ERR_NO_ERROR;
+	}
+	event->value = (sint16)u16SendLength;
+	stats.bytesSent += u16SendLength;
+	s->server->received(sock, pvSendBuffer, u16SendLength);
+	return SOCK_ERR_NO_ERROR;
+}
+
+sint16 recv(SOCKET sock, void *pvRecvBuf, uint16 u16BufLen, uint32 u32Timeoutmsec)
+{
+	struct HostWincSocket *s = Open(sock);
+
+	if(s == NULL || pvRecvBuf == NULL || u16BufLen == 0) return SOCK_ERR_INVALID_ARG;
+
+	Sync();
+	s->recvPending = true;
+	s->recvBuffer = pvRecvBuf;
+	s->recvLength = u16BufLen;
+	s->recvAtNs = nowNs;
+	s->recvDeadlineNs = (u32Timeoutmsec > 0) ? nowNs + u32Timeoutmsec * 1000000ULL : 0;
+	return SOCK_ERR_NO_ERROR;
+}
+
+sint8 close(SOCKET sock)
+{
+	struct HostWincSocket *s = Open(sock);
+
+	if(s == NULL) return SOCK_ERR_INVALID_ARG;
+
+	if(s->server != NULL && !s->peerClosed && s->server->closed != NULL) s->server->closed(sock);
+	free(s->rx);
+	free(s->segments);
+	s->rx = NULL;
+	s->segments = NULL;
+	s->used = false;
+	s->server = NULL;
+	s->recvPending = false;
+	return SOCK_ERR_NO_ERROR;
+}
+
+uint32 nmi_inet_addr(char *pcIpAddr)
+{
+	uint32_t ip = 0;
+	unsigned int byte = 0;
+
+	for(uint8_t shift = 0; shift < 32; shift += 8)
+	{
+		byte = (unsigned int)strtoul(pcIpAddr, &pcIpAddr, 10);
+		ip |= (uint32_t)(byte & 0xFF) << shift;
+		if(*pcIpAddr == '.') pcIpAddr++;
+	}
+	return ip;
+}
+
+sint8 gethostbyname(uint8 *pcHostName)
+{
+	struct HostWincEvent *event;
+
+	if(pcHostName == NULL || strlen((const char *)pcHostName) >= HOSTNAME_MAX_SIZE) return SOCK_ERR_INVALID_ARG;
+
+	Sync();
+	stats.queries++;
+	event = Queue(SOCKET_MSG_DNS_RESOLVE, -1, HOST_WINC_DNS_NS);
+	strcpy(event->host, (const char *)pcHostName);
+	for(uint8_t i = 0; i < hostCount; i++)
+	{
+		if(strcmp(hosts[i].name, event->host) == 0) event->ip = hosts[i].ip;
+	}
+	return SOCK_ERR_NO_ERROR;
+}
+
+/**************************************************************************//**
+* @fn		sint8 m2m_wifi_handle_events(void *arg)
+* @brief	Delivers the next event, after moving the time up to it. With nothing to deliver, 1 ms goes by.
+*****************************************************************************/
+sint8 m2m_wifi_handle_events(void *arg)
+{
+	uint64_t nextNs = UINT64_MAX;
+	int nextEvent = -1;
+	SOCKET nextRecv = -1;
+
+	(void)arg;
+	Sync();
+	for(uint8_t i = 0; i < eventCount; i++)
+	{
+		if(events[i].atNs < nextNs)
+		{
+			nextNs = events[i].atNs;
+			nextEvent = i;
+		}
+	}
+	for(SOCKET sock = 0; sock < MAX_SOCKET; sock++)
+	{
+		uint64_t atNs;
+		if(sockets[sock].used && RecvDue(&sockets[sock], &atNs) && atNs < nextNs)
+		{
+			nextNs = atNs;
+			nextRecv = sock;
+		}
+	}
+
+	if(nextEvent < 0 && nextRecv < 0)
+	{
+		if(++idleMs > HOST_WINC_MAX_IDLE_MS)
+		{
+			fprintf(stderr, "host_winc: the device waits for an event that cannot come\n");
+			abort();
+		}
+		Advance(nowNs + 1000000ULL);
+		return 0;
+	}
+
+	idleMs = 0;
+	Advance(nextNs);
+	if(nextRecv >= 0)
+	{
+		CompleteRecv(nextRecv);
+	}
+	else
+	{
+		struct HostWincEvent event = events[nextEvent];
+		events[nextEvent] = events[--eventCount];
+		Deliver(&event);
+	}
+	return 0;
+}
+
+/******************************************************************************
+* Network
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		void HostWincAddHost(const char *name, uint32_t ip)
+* @brief	Makes DNS answer ip for name
+*****************************************************************************/
+void HostWincAddHost(const char *name, uint32_t ip)
+{
+	assert(hostCount < HOST_WINC_MAX_HOSTS);
+	hosts[hostCount].name = name;
+	hosts[hostCount].ip = ip;
+	hostCount++;
+}
+
+void HostWincListen(const HostWincServer *server)
+{
+	assert(serverCount < HOST_WINC_MAX_SERVERS);
+	servers[serverCount++] = server;
+}
+
+/**************************************************************************//**
+* @fn		void HostWincPeerSend(SOCKET sock, const void *data, uint32_t length)
+* @brief	The peer of a connection sends bytes to the device. They come in segments, at HOST_WINC_BYTE_NS per byte.
+*****************************************************************************/
+void HostWincPeerSend(SOCKET sock, const void *data, uint32_t length)
+{
+	struct HostWincSocket *s = Open(sock);
+	const uint8_t *bytes = data;
+
+	if(s == NULL || s->server == NULL || s->peerClosed) return;
+
+	Sync();
+	if(s->linkFreeNs < nowNs) s->linkFreeNs = nowNs;
+	if(s->rxLength + length > s->rxCapacity)
+	{
+		s->rxCapacity = (s->rxLength + length) * 2;
+		s->rx = realloc(s->rx, s->rxCapacity);
+		assert(s->rx != NULL);
+	}
+	while(length > 0)
+	{
+		uint32_t segment = (length < SOCKET_BUFFER_MAX_LENGTH) ? length : SOCKET_BUFFER_MAX_LENGTH;
+
+		if(s->segmentCount == s->segmentCapacity)
+		{
+			s->segmentCapacity = (s->segmentCapacity > 0) ? s->segmentCapacity * 2 : 16;
+			s->segments = realloc(s->segments, s->segmentCapacity * sizeof(*s->segments));
+			assert(s->segments != NULL);
+		}
+		memcpy(&s->rx[s->rxLength], bytes, segment);
+		s->rxLength += segment;
+		s->linkFreeNs += segment * HOST_WINC_BYTE_NS;
+		s->segments[s->segmentCount].end = s->rxLength;
+		s->segments[s->segmentCount].readyNs = s->linkFreeNs;
+		s->segmentCount++;
+		bytes += segment;
+		length -= segment;
+	}
+}
+
+/**************************************************************************//**
+* @fn		void HostWincPeerClose(SOCKET sock)
+* @brief	The peer closes the connection. The device sees it after the bytes already sent.
+*****************************************************************************/
+void HostWincPeerClose(SOCKET sock)
+{
+	struct HostWincSocket *s = Open(sock);
+
+	if(s == NULL || s->server == NULL || s->peerClosed) return;
+
+	Sync();
+	s->peerClosed = true;
+	s->peerClosedNs = (s->linkFreeNs > nowNs) ? s->linkFreeNs : nowNs;
+}
+
+bool HostWincIsOpen(SOCKET sock)
+{
+	return Open(sock) != NULL;
+}
+
+uint64_t HostWincNowNs(void)
+{
+	Sync();
+	return nowNs;
+}
+
+const struct HostWincStats *HostWincGetStats(void)
+{
+	return &stats;
+}
@@ -0,0 +1,68 @@
+/**************************************************************************//**
+* @file      host_winc.h
+* @brief     Simulated WINC1500 behind the host socket.h and m2m_wifi.h: TCP client sockets, DNS and the event pump.
+The calls only queue a request, as on the WINC; its event reaches the callbacks given to registerSocketCallback
+when a later m2m_wifi_handle_events() finds it due. The pump delivers one event per call and moves the time, kept in
+ns, to that event, so a stack that waits in a loop on the pump waits as long as the network makes it.
+The network is a set of named hosts and of servers that live in the test. A server gets the bytes the device sends
+as soon as send() is called, and answers with HostWincPeerSend. What a peer sends comes in segments of at most
+SOCKET_BUFFER_MAX_LENGTH bytes at HOST_WINC_BYTE_NS per byte, each connection at that rate of its own, and a recv()
+gets every byte that has come when it completes, up to its buffer size. A recv() with a timeout gets
+SOCK_ERR_TIMEOUT when nothing came by then; without one, it waits for data or for the peer to close.
+Sockets are given out in turn, as the driver does, so a closed socket number comes back for a later connection.
+Events queued for a socket that was closed in the meantime are dropped, as the driver drops them by session.
+
+******************************************************************************/
+
+#ifndef HOST_WINC_H
+#define HOST_WINC_H
+
+#include "asf.h"
+#include "socket/include/socket.h"
+#include "driver/include/m2m_wifi.h"
+
+#define HOST_WINC_EVENT_NS			200000ULL		///<Time the WINC takes to answer a command with its event
+#define HOST_WINC_DNS_NS			4000000ULL		///<Time a DNS query takes
+#define HOST_WINC_CONNECT_NS		15000000ULL		///<Time a TCP connection takes to open
+#define HOST_WINC_BYTE_NS			4000ULL			///<Time a byte takes to come from a peer: 2 Mbit/s
+#define HOST_WINC_MAX_HOSTS			4
+#define HOST_WINC_MAX_SERVERS		4
+#define HOST_WINC_MAX_EVENTS		32				///<Requests that can wait for their event
+#define HOST_WINC_MAX_IDLE_MS		600000			///<Time the pump may find nothing to do before the test is stopped
+
+//IPv4 address in network byte order, as the WINC gives it
+#define HOST_WINC_IP(a, b, c, d)	((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+///Server on a host of the network
+typedef struct HostWincServer
+{
+	uint32_t ip;													///<Address, in network byte order
+	uint16_t port;
+	void (*accepted)(SOCKET sock);									///<A connection from the device opened
+	void (*received)(SOCKET sock, const uint8_t *data, uint16_t length);	///<The device sent bytes
+	void (*closed)(SOCKET sock);									///<The device closed the connection
+} HostWincServer;
+
+//What the WINC has done
+struct HostWincStats
+{
+	uint32_t sockets;			///<Sockets opened
+	uint32_t connects;			///<Connections a server accepted
+	uint32_t refused;			///<Connections to an address no server listens on
+	uint32_t queries;			///<DNS queries
+	uint32_t events;			///<Socket events delivered
+	uint32_t resolves;			///<DNS replies delivered
+	uint32_t staleEvents;		///<Events dropped because their socket was closed first
+	uint32_t bytesSent;			///<Bytes the device sent
+	uint32_t bytesReceived;		///<Bytes the device received
+};
+
+void HostWincAddHost(const char *name, uint32_t ip);
+void HostWincListen(const HostWincServer *server);
+void HostWincPeerSend(SOCKET sock, const void *data, uint32_t length);
+void HostWincPeerClose(SOCKET sock);
+bool HostWincIsOpen(SOCKET sock);
+uint64_t HostWincNowNs(void);
+const struct HostWincStats *HostWincGetStats(void);
+
+#endif /*HOST_WINC_H*/
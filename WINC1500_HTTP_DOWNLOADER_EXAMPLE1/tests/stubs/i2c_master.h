@@ -0,0 +1,131 @@
+/**************************************************************************//**
+* @file      i2c_master.h
+* @brief     Host stand-in for the ASF SERCOM I2C master driver, and the GPIO and pinmux calls the I2C driver uses for
+*			 bus recovery. The calls run against the simulated bus of host_i2c_bus.c.
+
+******************************************************************************/
+
+#ifndef HOST_I2C_MASTER_H
+#define HOST_I2C_MASTER_H
+
+#include "asf.h"
+
+//SERCOM0 and the pins of the sensor bus
+#define SERCOM0								(&hostSercom[0])
+#define SERCOM0_GCLK_ID_CORE				20
+#define PIN_PA08							8
+#define PIN_PA09							9
+#define PINMUX_PA08C_SERCOM0_PAD0			((8UL << 16) | 2)
+#define PINMUX_PA09C_SERCOM0_PAD1			((9UL << 16) | 2)
+
+//I2C master registers
+#define SERCOM_I2CM_CTRLA_ENABLE			(1UL << 1)
+#define SERCOM_I2CM_CTRLA_SPEED_Msk			(3UL << 24)
+#define SERCOM_I2CM_BAUD_BAUD(value)		((uint32_t)(value) & 0xFFUL)
+#define SERCOM_I2CM_STATUS_BUSSTATE_Msk		(3U << 4)
+#define SERCOM_I2CM_STATUS_BUSSTATE(value)	((uint16_t)((value) << 4))
+#define SERCOM_I2CM_INTENCLR_MB				(1U << 0)
+#define SERCOM_I2CM_INTENCLR_SB				(1U << 1)
+
+#define I2C_MASTER_SPEED_STANDARD_AND_FAST	(0UL << 24)
+#define I2C_MASTER_SPEED_FAST_MODE_PLUS		(1UL << 24)
+#define I2C_MASTER_BAUD_RATE_100KHZ			100
+
+enum i2c_master_callback
+{
+	I2C_MASTER_CALLBACK_WRITE_COMPLETE = 0,
+	I2C_MASTER_CALLBACK_READ_COMPLETE,
+	I2C_MASTER_CALLBACK_ERROR,
+	I2C_MASTER_CALLBACK_N,
+};
+
+struct i2c_master_module;
+typedef void (*i2c_master_callback_t)(struct i2c_master_module *const module);
+
+struct i2c_master_config
+{
+	uint32_t baud_rate;					///<SCL frequency, in kHz
+	uint32_t pinmux_pad0;
+	uint32_t pinmux_pad1;
+	uint16_t buffer_timeout;
+	uint16_t unknown_bus_state_timeout;
+	bool scl_low_timeout;
+	uint16_t sda_scl_rise_time_ns;
+};
+
+struct i2c_master_module
+{
+	Sercom *hw;
+	volatile enum status_code status;
+	bool send_stop;						///<false while a write job keeps the bus for a repeated START
+	volatile uint16_t buffer_length;
+	volatile uint16_t buffer_remaining;	///<Bytes the job still has to transfer. 0 when no job is running
+	uint16_t unknown_bus_state_timeout;
+	i2c_master_callback_t callbacks[I2C_MASTER_CALLBACK_N];
+	bool callbackEnabled[I2C_MASTER_CALLBACK_N];
+};
+
+struct i2c_master_packet
+{
+	uint16_t address;
+	uint16_t data_length;
+	uint8_t *data;
+};
+
+void i2c_master_get_config_defaults(struct i2c_master_config *const config);
+enum status_code i2c_master_init(struct i2c_master_module *const module, Sercom *const hw, const struct i2c_master_config *const config);
+void i2c_master_reset(struct i2c_master_module *const module);
+void i2c_master_enable(const struct i2c_master_module *const module);
+void i2c_master_disable(const struct i2c_master_module *const module);
+void i2c_master_register_callback(struct i2c_master_module *const module, const i2c_master_callback_t callback, enum i2c_master_callback callback_type);
+void i2c_master_enable_callback(struct i2c_master_module *const module, enum i2c_master_callback callback_type);
+enum status_code i2c_master_read_packet_job(struct i2c_master_module *const module, struct i2c_master_packet *const packet);
+enum status_code i2c_master_write_packet_job(struct i2c_master_module *const module, struct i2c_master_packet *const packet);
+enum status_code i2c_master_write_packet_job_no_stop(struct i2c_master_module *const module, struct i2c_master_packet *const packet);
+void i2c_master_cancel_job(struct i2c_master_module *const module);
+void i2c_master_send_stop(struct i2c_master_module *const module);
+
+static inline void _i2c_master_wait_for_sync(const struct i2c_master_module *const module)
+{
+	(void)module;
+}
+
+uint32_t system_gclk_chan_get_hz(const uint8_t channel);
+void delay_us(uint32_t us);
+
+//GPIO
+enum port_pin_dir { PORT_PIN_DIR_INPUT, PORT_PIN_DIR_OUTPUT, PORT_PIN_DIR_OUTPUT_WTH_READBACK };
+enum port_pin_pull { PORT_PIN_PULL_NONE, PORT_PIN_PULL_UP, PORT_PIN_PULL_DOWN };
+
+struct port_config
+{
+	enum port_pin_dir direction;
+	enum port_pin_pull input_pull;
+	bool powersave;
+};
+
+void port_get_config_defaults(struct port_config *const config);
+void port_pin_set_config(const uint8_t gpio_pin, const struct port_config *const config);
+void port_pin_set_output_level(const uint8_t gpio_pin, const bool level);
+bool port_pin_get_input_level(const uint8_t gpio_pin);
+
+//Pinmux
+enum system_pinmux_pin_dir
+{
+	SYSTEM_PINMUX_PIN_DIR_INPUT,
+	SYSTEM_PINMUX_PIN_DIR_OUTPUT,
+	SYSTEM_PINMUX_PIN_DIR_OUTPUT_WITH_READBACK,
+};
+
+struct system_pinmux_config
+{
+	uint8_t mux_position;
+	enum system_pinmux_pin_dir direction;
+	enum port_pin_pull input_pull;
+	bool powersave;
+};
+
+void system_pinmux_get_config_defaults(struct system_pinmux_config *const config);
+void system_pinmux_pin_set_config(const uint8_t gpio_pin, const struct system_pinmux_config *const config);
+
+#endif /*HOST_I2C_MASTER_H*/
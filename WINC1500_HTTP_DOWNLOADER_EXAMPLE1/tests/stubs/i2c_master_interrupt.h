@@ -0,0 +1,7 @@
+/**************************************************************************//**
+* @file      i2c_master_interrupt.h
+* @brief     Host stand-in for the ASF header: the job API is declared in the host i2c_master.h.
+
+******************************************************************************/
+
+#include "i2c_master.h"
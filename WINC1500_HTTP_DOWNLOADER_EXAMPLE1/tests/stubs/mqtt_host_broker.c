@@ -0,0 +1,252 @@
+/**************************************************************************//**
+* @file      mqtt_host_broker.c
+* @brief     Host platform for the Paho MQTT client and its wrapper: a simulated broker and timers on hostTickCount.
+
+******************************************************************************/
+
+#include <string.h>
+#include "asf.h"
+#include "MQTTClient/MQTTClient.h"
+
+static struct HostBrokerStats stats;
+static bool brokerDown;					///<true while the broker is unreachable
+static TickType_t brokerDownUntil;		///<Tick at which the broker comes back
+static bool connectionOpen;				///<true while the broker has a connection from the client
+static bool brokerMuted;				///<true while the broker reads but never answers, as over a half open connection
+static bool hasSession;					///<true if the broker keeps a session for the client
+static int connectionCount;				///<Number given to the last connection
+static unsigned char rxQueue[256];		///<Bytes the broker sent that the client did not read yet
+static size_t rxLength;
+static size_t rxPos;
+
+static bool BrokerUp(void)
+{
+	if(brokerDown && (int32_t)(hostTickCount - brokerDownUntil) >= 0) brokerDown = false;
+	return !brokerDown;
+}
+
+static void Send(const unsigned char *packet, size_t length)
+{
+	if(brokerMuted) return;
+	if(rxPos == rxLength) rxLength = rxPos = 0;
+	assert(rxLength + length <= sizeof(rxQueue));
+	memcpy(&rxQueue[rxLength], packet, length);
+	rxLength += length;
+}
+
+static void Receive(const unsigned char *packet, int length)
+{
+	int remaining = 0, multiplier = 1, header = 1;
+
+
+	do
+	{
+		remaining += (packet[header] & 127) * multiplier;
+		multiplier *= 128;
+	} while(packet[header++] & 128);
+	assert(header + remaining == length);
+
+	const unsigned char *body = &packet[header];
+	switch(packet[0] >> 4)
+	{
+		case CONNECT:
+		{
+			bool clean = (body[7] & 0x02) != 0;
+			unsigned char connack[] = {0x20, 0x02, (!clean && hasSession) ? 1 : 0, 0x00};
+			hasSession = !clean;
+			stats.connects++;
+			Send(connack, sizeof(connack));
+			break;
+		}
+		case SUBSCRIBE:
+		{
+			unsigned char suback[] = {0x90, 0x03, body[0], body[1], 0x01};
+			stats.subscribes++;
+			Send(suback, sizeof(suback));
+			break;
+		}
+		case PUBLISH:
+		{
+			int qos = (packet[0] >> 1) & 3;
+			int pos = 2 + ((body[0] << 8) | body[1]);
+			uint32_t value = 0;
+			unsigned char puback[] = {0x40, 0x02, 0, 0};
+
+			if(qos > 0)
+			{
+				puback[2] = body[pos];
+				puback[3] = body[pos + 1];
+				pos += 2;
+			}
+			for(; pos < remaining && body[pos] >= '0' && body[pos] <= '9'; pos++) value = value * 10 + (body[pos] - '0');
+			stats.publishes++;
+			stats.payloadSum += value;
+			if(qos == 1) Send(puback, sizeof(puback));
+			break;
+		}
+		case PINGREQ:
+		{
+			static const unsigned char pingresp[] = {0xD0, 0x00};
+			stats.pings++;
+			Send(pingresp, sizeof(pingresp));
+			break;
+		}
+		case DISCONNECT:
+			connectionOpen = false;
+			break;
+		default:
+			break;
+	}
+}
+
+static int HostRead(Network *n, unsigned char *buffer, int length, int timeout)
+{
+	if(n->socket < 0 || !connectionOpen) return -1;
+	if(rxPos == rxLength)
+	{
+		//Nothing to read: recv() waits for its timeout
+		hostTickCount += (timeout > 0) ? timeout : 1;
+		return 0;
+	}
+	if(rxPos + (size_t)length > rxLength) return -1;
+	memcpy(buffer, &rxQueue[rxPos], (size_t)length);
+	rxPos += (size_t)length;
+	return length;
+}
+
+static int HostWrite(Network *n, unsigned char *buffer, int length, int timeout)
+{
+	(void)timeout;
+	if(n->socket < 0 || !connectionOpen) return -1;
+	Receive(buffer, length);
+	return length;
+}
+
+static void HostDisconnect(Network *n)
+{
+	n->socket = -1;
+	connectionOpen = false;
+	rxLength = rxPos = 0;
+}
+
+void NetworkInit(Network *n)
+{
+	n->socket = -1;
+	n->mqttread = HostRead;
+	n->mqttwrite = HostWrite;
+	n->disconnect = HostDisconnect;
+}
+
+int ConnectNetwork(Network *n, char *addr, int port, int TLSFlag)
+{
+	(void)addr;
+	(void)port;
+	(void)TLSFlag;
+
+	hostTickCount += HOST_BROKER_CONNECT_MS;
+	if(!BrokerUp())
+	{
+		stats.refused++;
+		return -1;
+	}
+	n->socket = ++connectionCount;
+	connectionOpen = true;
+	rxLength = rxPos = 0;
+	return 0;
+}
+
+void tcpClientSocketEventHandler(int8_t sock, uint8_t u8Msg, void *pvMsg)
+{
+	(void)sock;
+	(void)u8Msg;
+	(void)pvMsg;
+}
+
+void dnsResolveCallback(uint8_t *hostName, uint32_t hostIp)
+{
+	(void)hostName;
+	(void)hostIp;
+}
+
+bool isMQTTSocket(int8_t sock)
+{
+	(void)sock;
+	return false;
+}
+
+bool isMQTTHostResolving(const uint8_t *hostName)
+{
+	(void)hostName;
+	return false;
+}
+
+/**************************************************************************//**
+* @fn		void HostBrokerReset(void)
+* @brief	Brings the broker up, with no connection, no session and its counters cleared
+*****************************************************************************/
+void HostBrokerReset(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	brokerDown = false;
+	brokerMuted = false;
+	connectionOpen = false;
+	hasSession = false;
+	rxLength = rxPos = 0;
+}
+
+/**************************************************************************//**
+* @fn		void HostBrokerDown(uint32_t durationMs)
+* @brief	Takes the broker down for durationMs. The open connection fails at once; the session is kept.
+*****************************************************************************/
+void HostBrokerDown(uint32_t durationMs)
+{
+	brokerDown = true;
+	brokerDownUntil = hostTickCount + durationMs;
+	connectionOpen = false;
+}
+
+/**************************************************************************//**
+* @fn		void HostBrokerMute(bool muted)
+* @brief	Makes the broker ignore what it receives while the connection stays open, as when the path to it breaks
+*			without a reset
+*****************************************************************************/
+void HostBrokerMute(bool muted)
+{
+	brokerMuted = muted;
+}
+
+bool HostBrokerIsUp(void)
+{
+	return BrokerUp();
+}
+
+const struct HostBrokerStats *HostBrokerGetStats(void)
+{
+	return &stats;
+}
+
+void TimerInit(Timer *timer)
+{
+	timer->end = 0;
+}
+
+char TimerIsExpired(Timer *timer)
+{
+	return (long)(timer->end - hostTickCount) <= 0;
+}
+
+void TimerCountdownMS(Timer *timer, unsigned int ms)
+{
+	timer->end = hostTickCount + ms;
+}
+
+void TimerCountdown(Timer *timer, unsigned int seconds)
+{
+	timer->end = hostTickCount + seconds * 1000UL;
+}
+
+int TimerLeftMS(Timer *timer)
+{
+	long left = (long)(timer->end - hostTickCount);
+	return (left < 0) ? 0 : (int)left;
+}
@@ -0,0 +1,60 @@
+/**************************************************************************//**
+* @file      mqtt_host_broker.h
+* @brief     Host platform for the Paho MQTT client and its wrapper, selected with MQTTCLIENT_PLATFORM_HEADER.
+The network talks to a simulated broker in the same process. It answers CONNECT, SUBSCRIBE, PUBLISH (QoS 1) and
+PINGREQ at once, and keeps the session of a client that connects without a clean session. The broker can be taken
+down for a while: the open connection then fails like a socket the peer closed, and new connections are refused.
+It can also be muted, so that the connection stays open but nothing is answered.
+Time is hostTickCount of host_rtos.c, in ms. A read that finds nothing waits out its timeout, as recv() does.
+
+******************************************************************************/
+
+#ifndef MQTT_HOST_BROKER_H
+#define MQTT_HOST_BROKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MQTT_MAX_CLIENTS		1	///<Size of the client pool of the wrapper
+#define HOST_BROKER_CONNECT_MS	20	///<Time a connection attempt takes, whether it succeeds or not
+
+typedef struct Timer
+{
+	unsigned long end;	///<Tick at which the timer expires
+} Timer;
+
+typedef struct Network Network;
+struct Network
+{
+	int socket;			///<Connection number, -1 when closed
+	int (*mqttread)(Network *, unsigned char *, int, int);
+	int (*mqttwrite)(Network *, unsigned char *, int, int);
+	void (*disconnect)(Network *);
+};
+
+//What the broker has seen
+struct HostBrokerStats
+{
+	uint32_t connects;			///<CONNECT packets accepted
+	uint32_t refused;			///<Connection attempts refused while the broker was down
+	uint32_t subscribes;		///<SUBSCRIBE packets
+	uint32_t publishes;			///<PUBLISH packets acknowledged
+	uint32_t payloadSum;		///<Sum of the decimal numbers carried by the acknowledged PUBLISH payloads
+	uint32_t pings;				///<PINGREQ packets
+};
+
+void NetworkInit(Network *n);
+int ConnectNetwork(Network *n, char *addr, int port, int TLSFlag);
+void tcpClientSocketEventHandler(int8_t sock, uint8_t u8Msg, void *pvMsg);
+void dnsResolveCallback(uint8_t *hostName, uint32_t hostIp);
+bool isMQTTSocket(int8_t sock);
+bool isMQTTHostResolving(const uint8_t *hostName);
+
+void HostBrokerReset(void);
+void HostBrokerDown(uint32_t durationMs);
+void HostBrokerMute(bool muted);
+bool HostBrokerIsUp(void);
+const struct HostBrokerStats *HostBrokerGetStats(void);
+
+#endif /*MQTT_HOST_BROKER_H*/
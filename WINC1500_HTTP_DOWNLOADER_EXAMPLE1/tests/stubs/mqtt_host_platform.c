@@ -0,0 +1,68 @@
+/**************************************************************************//**
+* @file      mqtt_host_platform.c
+* @brief     Host platform for the Paho MQTT client: scripted network and fake clock timers.
+
+******************************************************************************/
+
+#include <string.h>
+#include "MQTTClient/MQTTClient.h"
+
+static unsigned long fakeClock;	///<Fake time in ms, advanced by every TimerIsExpired
+
+static int HostRead(Network *n, unsigned char *buffer, int length, int timeout)
+{
+	(void)timeout;
+	if(n->rxPos + (size_t)length > n->rxLength) return 0;
+	memcpy(buffer, &n->rx[n->rxPos], (size_t)length);
+	n->rxPos += (size_t)length;
+	return length;
+}
+
+static int HostWrite(Network *n, unsigned char *buffer, int length, int timeout)
+{
+	(void)buffer;
+	(void)timeout;
+	n->txBytes += (size_t)length;
+	return length;
+}
+
+void HostNetworkInit(Network *n)
+{
+	memset(n, 0, sizeof(*n));
+	n->mqttread = HostRead;
+	n->mqttwrite = HostWrite;
+}
+
+void HostNetworkScript(Network *n, const unsigned char *rx, size_t length)
+{
+	n->rx = rx;
+	n->rxLength = length;
+	n->rxPos = 0;
+}
+
+void TimerInit(Timer *timer)
+{
+	timer->end = 0;
+}
+
+char TimerIsExpired(Timer *timer)
+{
+	fakeClock++;
+	return (long)(timer->end - fakeClock) <= 0;
+}
+
+void TimerCountdownMS(Timer *timer, unsigned int ms)
+{
+	timer->end = fakeClock + ms;
+}
+
+void TimerCountdown(Timer *timer, unsigned int seconds)
+{
+	timer->end = fakeClock + seconds * 1000UL;
+}
+
+int TimerLeftMS(Timer *timer)
+{
+	long left = (long)(timer->end - fakeClock);
+	return (left < 0) ? 0 : (int)left;
+}
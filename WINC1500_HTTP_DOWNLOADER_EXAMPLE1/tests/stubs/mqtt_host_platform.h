@@ -0,0 +1,33 @@
+/**************************************************************************//**
+* @file      mqtt_host_platform.h
+* @brief     Host platform for the Paho MQTT client, selected with MQTTCLIENT_PLATFORM_HEADER.
+The network reads from a scripted byte buffer and records what is written. Timers run on a fake clock that advances
+one millisecond every time a timer is checked, so waiting for an acknowledgement that never comes still ends.
+
+******************************************************************************/
+
+#ifndef MQTT_HOST_PLATFORM_H
+#define MQTT_HOST_PLATFORM_H
+
+#include <stddef.h>
+
+typedef struct Timer
+{
+	unsigned long end;	///<Fake clock value at which the timer expires
+} Timer;
+
+typedef struct Network Network;
+struct Network
+{
+	int (*mqttread)(Network *, unsigned char *, int, int);
+	int (*mqttwrite)(Network *, unsigned char *, int, int);
+	const unsigned char *rx;	///<Bytes the broker "sends"
+	size_t rxLength;			///<Number of bytes in rx
+	size_t rxPos;				///<Next byte of rx to read
+	size_t txBytes;				///<Number of bytes written by the client
+};
+
+void HostNetworkInit(Network *n);
+void HostNetworkScript(Network *n, const unsigned char *rx, size_t length);
+
+#endif /*MQTT_HOST_PLATFORM_H*/
@@ -0,0 +1,114 @@
+/**************************************************************************//**
+* @file      socket.h
+* @brief     Host stand-in for the WINC1500 socket API, implemented by the simulated WINC of host_winc.c.
+The names, structures and events are those of the driver. The calls that share their name with the C library
+(socket, connect, send, recv, close) keep it in the source but link as HostWinc* symbols, so they do not replace the
+host's own: a macro would not do, http_client.c calls a member named close as well.
+
+******************************************************************************/
+
+#ifndef HOST_SOCKET_H
+#define HOST_SOCKET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common/include/nm_common.h"
+
+#define HOSTNAME_MAX_SIZE				64
+#define SOCKET_BUFFER_MAX_LENGTH		1400
+
+#define AF_INET							2
+#define SOCK_STREAM						1
+#define SOCK_DGRAM						2
+#define SOCKET_FLAGS_SSL				0x01
+
+#define TCP_SOCK_MAX					(7)
+#define UDP_SOCK_MAX					4
+#define MAX_SOCKET						(TCP_SOCK_MAX + UDP_SOCK_MAX)
+
+#define SOCK_ERR_NO_ERROR				0
+#define SOCK_ERR_INVALID_ADDRESS		-1
+#define SOCK_ERR_ADDR_ALREADY_IN_USE	-2
+#define SOCK_ERR_MAX_TCP_SOCK			-3
+#define SOCK_ERR_MAX_UDP_SOCK			-4
+#define SOCK_ERR_INVALID_ARG			-6
+#define SOCK_ERR_MAX_LISTEN_SOCK		-7
+#define SOCK_ERR_INVALID				-9
+#define SOCK_ERR_ADDR_IS_REQUIRED		-11
+#define SOCK_ERR_CONN_ABORTED			-12
+#define SOCK_ERR_TIMEOUT				-13
+#define SOCK_ERR_BUFFER_FULL			-14
+
+//The SAMD21 is little endian
+#define _htonl(m)		((uint32)((((uint32)(m) << 24) & 0xFF000000) | (((uint32)(m) << 8) & 0x00FF0000) | \
+						(((uint32)(m) >> 8) & 0x0000FF00) | (((uint32)(m) >> 24) & 0x000000FF)))
+#define _htons(A)		(uint16)((((uint16)(A)) << 8) | (((uint16)(A)) >> 8))
+#define _ntohl			_htonl
+#define _ntohs			_htons
+
+typedef sint8 SOCKET;
+
+typedef struct
+{
+	uint32 s_addr;				///<IPv4 address in network byte order
+} in_addr;
+
+struct sockaddr
+{
+	uint16 sa_family;
+	uint8 sa_data[14];
+};
+
+struct sockaddr_in
+{
+	uint16 sin_family;
+	uint16 sin_port;			///<Network byte order
+	in_addr sin_addr;
+	uint8 sin_zero[8];
+};
+
+typedef enum
+{
+	SOCKET_MSG_BIND = 1,
+	SOCKET_MSG_LISTEN,
+	SOCKET_MSG_DNS_RESOLVE,
+	SOCKET_MSG_ACCEPT,
+	SOCKET_MSG_CONNECT,
+	SOCKET_MSG_RECV,
+	SOCKET_MSG_SEND,
+	SOCKET_MSG_SENDTO,
+	SOCKET_MSG_RECVFROM
+} tenuSocketCallbackMsgType;
+
+typedef struct
+{
+	SOCKET sock;
+	sint8 s8Error;				///<0 if connected, a SOCK_ERR_* code otherwise
+} tstrSocketConnectMsg;
+
+typedef struct
+{
+	uint8 *pu8Buffer;			///<Buffer given to recv()
+	sint16 s16BufferSize;		///<Bytes received; 0 if the peer closed the connection, a SOCK_ERR_* code on errors
+	uint16 u16RemainingSize;
+	struct sockaddr_in strRemoteAddr;
+} tstrSocketRecvMsg;
+
+typedef void (*tpfAppSocketCb)(SOCKET sock, uint8 u8Msg, void *pvMsg);
+typedef void (*tpfAppResolveCb)(uint8 *pu8DomainName, uint32 u32ServerIP);
+
+#define HOST_WINC_STRING(x)		#x
+#define HOST_WINC_LABEL(prefix, name)	__asm__(HOST_WINC_STRING(prefix) #name)
+#define HOST_WINC_SYMBOL(name)		HOST_WINC_LABEL(__USER_LABEL_PREFIX__, name)
+
+void socketInit(void);
+void registerSocketCallback(tpfAppSocketCb socket_cb, tpfAppResolveCb resolve_cb);
+SOCKET socket(uint16 u16Domain, uint8 u8Type, uint8 u8Flags) HOST_WINC_SYMBOL(HostWincSocket);
+sint8 connect(SOCKET sock, struct sockaddr *pstrAddr, uint8 u8AddrLen) HOST_WINC_SYMBOL(HostWincConnect);
+sint16 send(SOCKET sock, void *pvSendBuffer, uint16 u16SendLength, uint16 u16Flags) HOST_WINC_SYMBOL(HostWincSend);
+sint16 recv(SOCKET sock, void *pvRecvBuf, uint16 u16BufLen, uint32 u32Timeoutmsec) HOST_WINC_SYMBOL(HostWincRecv);
+sint8 close(SOCKET sock) HOST_WINC_SYMBOL(HostWincClose);
+uint32 nmi_inet_addr(char *pcIpAddr);
+sint8 gethostbyname(uint8 *pcHostName);
+
+#endif /*HOST_SOCKET_H*/
@@ -0,0 +1,7 @@
+/**************************************************************************//**
+* @file      status_codes.h
+* @brief     Host stand-in for the ASF header: the status codes are declared in the host asf.h.
+
+******************************************************************************/
+
+#include "asf.h"
@@ -0,0 +1,32 @@
+/**************************************************************************//**
+* @file      stream_buffer.h
+* @brief     Host stand-in for the FreeRTOS stream buffer: a single reader and a single writer, implemented in host_rtos.c.
+As in FreeRTOS 10.0, a buffer created with xBufferSizeBytes holds one byte less. A reader that finds it empty blocks
+on its task notification, which the next send gives.
+
+******************************************************************************/
+
+#ifndef HOST_STREAM_BUFFER_H
+#define HOST_STREAM_BUFFER_H
+
+#include "asf.h"
+
+typedef struct
+{
+	uint8_t *storage;		///<Storage area given at creation
+	size_t length;			///<xBufferSizeBytes
+	size_t head;			///<Next byte written
+	size_t tail;			///<Next byte read
+	TaskHandle_t reader;	///<Task blocked in xStreamBufferReceive, NULL if none
+} StaticStreamBuffer_t;
+typedef StaticStreamBuffer_t *StreamBufferHandle_t;
+
+StreamBufferHandle_t xStreamBufferCreateStatic(size_t xBufferSizeBytes, size_t xTriggerLevelBytes, uint8_t *pucStreamBufferStorageArea,
+											   StaticStreamBuffer_t *pxStaticStreamBuffer);
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+								BaseType_t *pxHigherPriorityTaskWoken);
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, TickType_t xTicksToWait);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer);
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer);
+
+#endif /*HOST_STREAM_BUFFER_H*/
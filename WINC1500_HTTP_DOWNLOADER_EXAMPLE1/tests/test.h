@@ -0,0 +1,56 @@
+/**************************************************************************//**
+* @file      test.h
+* @brief     Minimal assertion helpers for the host tests.
+Each test program includes this header, calls TEST_CHECK for every expectation and returns TEST_RESULT() from main.
+A failed check prints its location and the test keeps going, so one run reports every failure.
+
+******************************************************************************/
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+static unsigned testChecks;		///<Number of checks run
+static unsigned testFailures;	///<Number of checks that failed
+
+///Checks a condition, prints its location if it does not hold
+#define TEST_CHECK(cond)	do { testChecks++; if(!(cond)) { testFailures++; \
+	printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while(0)
+
+///Checks that two integers are equal, prints both if they are not
+#define TEST_CHECK_EQ(a, b)	do { long long _a = (long long)(a), _b = (long long)(b); testChecks++; if(_a != _b) { \
+	testFailures++; printf("%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, _a, _b); } } while(0)
+
+///Prints the summary of the run and gives the exit code of the test program
+#define TEST_RESULT()	(printf("%u checks, %u failed\n", testChecks, testFailures), testFailures ? 1 : 0)
+
+/**************************************************************************//**
+* @fn		static inline uint32_t TestRandom(void)
+* @brief	xorshift32 generator, so runs are repeatable on every host
+*****************************************************************************/
+static uint32_t testRandomState = 2463534242UL;
+static inline uint32_t TestRandom(void)
+{
+	testRandomState ^= testRandomState << 13;
+	testRandomState ^= testRandomState >> 17;
+	testRandomState ^= testRandomState << 5;
+	return testRandomState;
+}
+
+/**************************************************************************//**
+* @fn		static inline double TestSeconds(void)
+* @brief	Monotonic time in seconds, for the benchmarks
+*****************************************************************************/
+static inline double TestSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+#endif /*TEST_H*/
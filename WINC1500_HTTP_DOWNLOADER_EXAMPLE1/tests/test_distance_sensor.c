@@ -0,0 +1,291 @@
+/**************************************************************************//**
+* @file      test_distance_sensor.c
+* @brief     Host tests for the background sampling of DistanceSensor against a simulated US-100: the median filter,
+*			replies that time out or come late, failed measurements and the sample period.
+The simulated sensor answers every 0x55 command after a configurable latency with a distance that encodes the
+command number in its low byte, so a reading made of the bytes of two different replies is detected.
+
+******************************************************************************/
+
+#include <stdlib.h>
+#include "test.h"
+#include "host_peripherals.h"
+#include "DistanceDriver/DistanceSensor.h"
+#include "I2cDriver/I2cDriver.h"
+
+#define SENSOR_NO_REPLY		0xFFFFFFFFUL	///<Latency of a sensor that does not answer
+#define SENSOR_DISTANCE(n)	((uint16_t)(0x0300 | ((n) & 0xFF)))	///<Distance the sensor answers to command n
+
+/******************************************************************************
+* Simulated US-100
+******************************************************************************/
+static uint32_t sensorCommands;		///<Distance commands received
+static uint32_t sensorLatencyMin;	///<Shortest time to answer, in ms
+static uint32_t sensorLatencyMax;	///<Longest time to answer, in ms. SENSOR_NO_REPLY to stay silent
+static uint16_t sensorFixed;		///<Distance to answer with instead of SENSOR_DISTANCE(), if not 0
+static uint32_t sensorCommandTick;	///<Tick at which the last command was received
+
+static void SensorPeer(const uint8_t *data, uint16_t length)
+{
+	for(uint16_t i = 0; i < length; i++)
+	{
+		if(data[i] != DISTANCE_US_100_CMD_READ_DISTANCE) continue;
+
+		uint16_t distance = sensorFixed ? sensorFixed : SENSOR_DISTANCE(sensorCommands);
+		uint8_t reply[2] = {(uint8_t)(distance >> 8), (uint8_t)distance};
+		sensorCommands++;
+		sensorCommandTick = hostTickCount;
+		if(sensorLatencyMax == SENSOR_NO_REPLY) continue;
+		HostUsartReply(reply, sizeof(reply),
+					   sensorLatencyMin + TestRandom() % (sensorLatencyMax - sensorLatencyMin + 1));
+	}
+}
+
+static void SensorSetLatency(uint32_t minMs, uint32_t maxMs)
+{
+	sensorLatencyMin = minMs;
+	sensorLatencyMax = maxMs;
+}
+
+/******************************************************************************
+* Helpers
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void RunCommands(uint32_t commands)
+* @brief	Runs until the sensor has received that many more commands, then long enough for the last reply to arrive
+*****************************************************************************/
+static void RunCommands(uint32_t commands)
+{
+	uint32_t target = sensorCommands + commands;
+	uint32_t limit = (commands + 1) * DISTANCE_MAX_SAMPLE_PERIOD_MS;
+
+	while(sensorCommands != target && limit-- > 0) HostPeripheralsRun(1);
+	TEST_CHECK_EQ(sensorCommands, target);
+	if(sensorLatencyMax != SENSOR_NO_REPLY) HostPeripheralsRun(sensorLatencyMax + 2);
+}
+
+///True if distance is a whole reply of the simulated sensor
+static bool IsWholeReply(uint16_t distance)
+{
+	return (distance & 0xFF00) == 0x0300;
+}
+
+static int CompareU16(const void *a, const void *b)
+{
+	return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+/**************************************************************************//**
+* @fn		static uint16_t ReferenceMedian(void)
+* @brief	Median of the newest DISTANCE_MEDIAN_SIZE readings of the history, sorted with qsort
+*****************************************************************************/
+static uint16_t ReferenceMedian(void)
+{
+	DistanceReading history[DISTANCE_MEDIAN_SIZE];
+	uint16_t values[DISTANCE_MEDIAN_SIZE];
+	uint8_t count = DistanceSensorGetHistory(history, DISTANCE_MEDIAN_SIZE);
+
+	for(uint8_t i = 0; i < count; i++) values[i] = history[i].distance;
+	qsort(values, count, sizeof(values[0]), CompareU16);
+	return values[count / 2];
+}
+
+/******************************************************************************
+* Tests
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void TestNominal(void)
+* @brief	Sampling every DISTANCE_SAMPLE_PERIOD_MS, readings stamped with the tick their reply was received at
+*****************************************************************************/
+static void TestNominal(void)
+{
+	DistanceReading reading;
+	DistanceSensorStats stats;
+
+	TEST_CHECK_EQ(DistanceSensorGetLatest(&reading), ERROR_NOT_READY);
+	TEST_CHECK_EQ(DistanceSensorGetHistory(&reading, 1), 0);
+
+	SensorSetLatency(10, 10);
+	sensorFixed = 1234;
+	HostPeripheralsRun(1000);
+	TEST_CHECK(abs((int)sensorCommands - 1000 / DISTANCE_SAMPLE_PERIOD_MS) <= 1);
+	RunCommands(1);
+	DistanceSensorGetStats(&stats);
+	TEST_CHECK_EQ(stats.samples, sensorCommands);
+	TEST_CHECK_EQ(stats.timeouts, 0);
+	TEST_CHECK_EQ(stats.errors, 0);
+
+	//The reply starts 10 ms after the command and takes 1 ms per byte
+	TEST_CHECK_EQ(DistanceSensorGetLatest(&reading), ERROR_NONE);
+	TEST_CHECK_EQ(reading.distance, 1234);
+	TEST_CHECK_EQ(reading.tick, sensorCommandTick + 11);
+	sensorFixed = 0;
+}
+
+/**************************************************************************//**
+* @fn		static void TestMedian(void)
+* @brief	The latest reading is the median of the newest readings after every reply, and rejects lone outliers
+*****************************************************************************/
+static void TestMedian(void)
+{
+	static const uint16_t outliers[] = {1000, 1000, 4500, 1000, 1000, 20, 1000, 1000, 4500, 4500};
+	DistanceReading reading;
+
+	SensorSetLatency(5, 40);
+	for(unsigned i = 0; i < 300; i++)
+	{
+		sensorFixed = (uint16_t)(1 + TestRandom() % 4500);
+		RunCommands(1);
+		TEST_CHECK_EQ(DistanceSensorGetLatest(&reading), ERROR_NONE);
+		TEST_CHECK_EQ(reading.distance, ReferenceMedian());
+	}
+
+	for(unsigned i = 0; i < sizeof(outliers) / sizeof(outliers[0]); i++)
+	{
+		sensorFixed = outliers[i];
+		RunCommands(1);
+	}
+	DistanceSensorGetLatest(&reading);
+	TEST_CHECK_EQ(reading.distance, 1000);
+	sensorFixed = 0;
+}
+
+/**************************************************************************//**
+* @fn		static void TestTimeout(void)
+* @brief	A silent sensor counts one timeout per period and keeps the last reading; sampling resumes after
+* @details	Each timeout is counted when the next command is due, so the last silent command times out once the
+*			sensor answers again.
+*****************************************************************************/
+static void TestTimeout(void)
+{
+	DistanceReading before, after;
+	DistanceSensorStats start, stats;
+
+	DistanceSensorGetLatest(&before);
+	DistanceSensorGetStats(&start);
+	SensorSetLatency(0, SENSOR_NO_REPLY);
+	RunCommands(10);
+	HostPeripheralsRun(DISTANCE_SAMPLE_PERIOD_MS / 2);
+	DistanceSensorGetStats(&stats);
+	TEST_CHECK_EQ(stats.samples, start.samples);
+	TEST_CHECK_EQ(stats.timeouts - start.timeouts, 9);
+	TEST_CHECK_EQ(DistanceSensorGetLatest(&after), ERROR_NONE);
+	TEST_CHECK_EQ(after.tick, before.tick);
+
+	SensorSetLatency(10, 10);
+	RunCommands(5);
+	DistanceSensorGetStats(&stats);
+	TEST_CHECK_EQ(stats.timeouts - start.timeouts, 10);
+	TEST_CHECK_EQ(stats.samples - start.samples, 5);
+	TEST_CHECK_EQ(DistanceSensorGetHistory(&after, 1), 1);
+	TEST_CHECK_EQ(after.distance, SENSOR_DISTANCE(sensorCommands - 1));
+}
+
+/**************************************************************************//**
+* @fn		static void TestLateReplies(void)
+* @brief	Replies that miss their period, in whole or in part, are not read as a later reply once the sensor is
+*			back on time
+*****************************************************************************/
+static void TestLateReplies(void)
+{
+	DistanceReading history[DISTANCE_RING_SIZE];
+	DistanceSensorStats start, stats;
+	uint8_t count;
+
+	DistanceSensorGetStats(&start);
+	SensorSetLatency(5, DISTANCE_SAMPLE_PERIOD_MS + 40);
+	HostPeripheralsRun(DISTANCE_SAMPLE_PERIOD_MS * 300);
+	DistanceSensorGetStats(&stats);
+	TEST_CHECK(stats.timeouts - start.timeouts > 10);
+
+	//Replies still in flight are flushed within two periods
+	SensorSetLatency(10, 30);
+	RunCommands(3);
+	DistanceSensorGetStats(&start);
+	RunCommands(DISTANCE_RING_SIZE);
+	DistanceSensorGetStats(&stats);
+	TEST_CHECK_EQ(stats.samples - start.samples, DISTANCE_RING_SIZE);
+	TEST_CHECK_EQ(stats.timeouts, start.timeouts);
+
+	count = DistanceSensorGetHistory(history, DISTANCE_RING_SIZE);
+	TEST_CHECK_EQ(count, DISTANCE_RING_SIZE);
+	for(uint8_t i = 0; i < count; i++)
+	{
+		TEST_CHECK(IsWholeReply(history[i].distance));
+		TEST_CHECK_EQ(history[i].distance, SENSOR_DISTANCE(sensorCommands - 1 - i));
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestFailedStart(void)
+* @brief	A command that cannot be sent counts as an error, not as a timeout, and does not leave a read job armed
+*****************************************************************************/
+static void TestFailedStart(void)
+{
+	DistanceSensorStats start, stats;
+	uint32_t commands = sensorCommands;
+
+	SensorSetLatency(10, 10);
+	DistanceSensorGetStats(&start);
+	HostUsartFailNextWrite();
+	RunCommands(2);
+	DistanceSensorGetStats(&stats);
+	TEST_CHECK_EQ(stats.errors - start.errors, 1);
+	TEST_CHECK_EQ(stats.timeouts, start.timeouts);
+	TEST_CHECK_EQ(stats.samples - start.samples, 2);
+	TEST_CHECK_EQ(sensorCommands - commands, 2);
+}
+
+/**************************************************************************//**
+* @fn		static void TestSamplePeriod(void)
+* @brief	Out of range periods are refused; a shorter period sends more commands
+*****************************************************************************/
+static void TestSamplePeriod(void)
+{
+	uint32_t commands;
+
+	TEST_CHECK_EQ(DistanceSensorSetSamplePeriod(DISTANCE_MIN_SAMPLE_PERIOD_MS - 1), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(DistanceSensorSetSamplePeriod(DISTANCE_MAX_SAMPLE_PERIOD_MS + 1), ERROR_INVALID_ARG);
+
+	SensorSetLatency(10, 30);
+	TEST_CHECK_EQ(DistanceSensorSetSamplePeriod(DISTANCE_MIN_SAMPLE_PERIOD_MS), ERROR_NONE);
+	commands = sensorCommands;
+	HostPeripheralsRun(1000);
+	TEST_CHECK(abs((int)(sensorCommands - commands) - 1000 / DISTANCE_MIN_SAMPLE_PERIOD_MS) <= 1);
+
+	TEST_CHECK_EQ(DistanceSensorSetSamplePeriod(DISTANCE_MAX_SAMPLE_PERIOD_MS), ERROR_NONE);
+	commands = sensorCommands;
+	HostPeripheralsRun(3000);
+	TEST_CHECK(abs((int)(sensorCommands - commands) - 3000 / DISTANCE_MAX_SAMPLE_PERIOD_MS) <= 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestDeinitialize(void)
+* @brief	No command goes out once the sampling is stopped
+*****************************************************************************/
+static void TestDeinitialize(void)
+{
+	uint32_t commands = sensorCommands;
+
+	DeinitializeDistanceSerial();
+	HostPeripheralsRun(DISTANCE_MAX_SAMPLE_PERIOD_MS * 3);
+	TEST_CHECK_EQ(sensorCommands, commands);
+}
+
+int main(void)
+{
+	HostPeripheralsReset();
+	HostUsartSetPeer(SensorPeer);
+	InitializeDistanceSensor();
+
+	TestNominal();
+	TestMedian();
+	TestTimeout();
+	TestLateReplies();
+	TestFailedStart();
+	TestSamplePeriod();
+	TestDeinitialize();
+	return TEST_RESULT();
+}
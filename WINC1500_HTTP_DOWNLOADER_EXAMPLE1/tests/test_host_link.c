@@ -0,0 +1,519 @@
+/**************************************************************************//**
+* @file      test_host_link.c
+* @brief     Host tests for HostLink.c and the TX path of SerialConsole.c, run against the simulated UART and terminal of
+host_console.c and the in-memory volume of host_fatfs.c.
+The test plays the CLI task: it reads the console and hands every character to HostLinkInput(). The terminal side
+encodes the requests and decodes the answers the way tools/host_link.py does. Checks that text written while a frame
+is queued never cuts into it, that file transfers only touch FatFs with the storage lock held, and that a request
+finding the SD card held by the Wi-Fi task answers BUSY. The benchmark compares the bulk frames with a text hex dump.
+
+******************************************************************************/
+
+#include "test.h"
+#include "host_console.h"
+#include "HostLink/HostLink.h"
+#include "CliThread/CliThread.h"
+#include "IMU/ImuAcquisition.h"
+#include "WifiHandlerThread/WifiHandler.h"
+
+#define READ_TIMEOUT		20			///<Ticks to wait for a character while the terminal types
+#define MAX_ANSWERS			128
+#define FILE_SIZE			5000
+#define WRITE_CHUNK			(HOST_LINK_MAX_DATA - 4)
+#define READ_CHUNK			(HOST_LINK_MAX_DATA - 1)
+#define TEXT_LINES			10
+#define TEXT_LINE_LEN		60			///<Characters of a text line, CR LF included
+
+typedef struct
+{
+	uint8_t type;
+	uint8_t sequence;
+	uint8_t status;
+	uint8_t data[HOST_LINK_MAX_DATA];	///<Data after the status
+	uint16_t len;
+} Answer;
+
+static uint8_t request[HOST_LINK_MAX_FRAME];
+static Answer answers[MAX_ANSWERS];
+static char text[HOST_CONSOLE_OUTPUT_MAX];	///<Terminal output outside the frames
+static uint32_t badFrames;					///<Frames with a bad CRC or too short
+static uint8_t sequence;
+static uint8_t content[FILE_SIZE];
+
+/******************************************************************************
+* Stand-ins for the modules HostLink.c calls
+******************************************************************************/
+static bool wifiHoldsStorage;		///<The Wi-Fi task holds the storage lock
+static uint32_t storageLocks;		///<Times the lock was taken
+static uint32_t cliLines;			///<Lines left to print by the fake command
+
+bool WifiStorageLock(TickType_t timeout)
+{
+	if(wifiHoldsStorage)
+	{
+		vTaskDelay(timeout);
+		return false;
+	}
+	storageLocks++;
+	HostFatFsSetLocked(true);
+	return true;
+}
+
+void WifiStorageUnlock(void)
+{
+	HostFatFsSetLocked(false);
+}
+
+int32_t ImuAcquisitionRegisterConsumer(ImuBlockConsumer consumer)
+{
+	(void)consumer;
+	return 0;
+}
+
+/**************************************************************************//**
+* @fn		BaseType_t FreeRTOS_CLIProcessCommand(const char * const pcCommandInput, char * pcWriteBuffer, size_t xWriteBufferLen)
+* @brief	Fake command "lines N": prints N numbered lines, one per call
+*****************************************************************************/
+BaseType_t FreeRTOS_CLIProcessCommand(const char * const pcCommandInput, char * pcWriteBuffer, size_t xWriteBufferLen)
+{
+	static uint32_t line;
+
+	if(cliLines == 0)
+	{
+		if(sscanf(pcCommandInput, "lines %u", &cliLines) != 1 || cliLines == 0)
+		{
+			snprintf(pcWriteBuffer, xWriteBufferLen, "Command not recognised\r\n");
+			return pdFALSE;
+		}
+		line = 0;
+	}
+	snprintf(pcWriteBuffer, xWriteBufferLen, "line %u\r\n", (unsigned)line++);
+	return (--cliLines > 0) ? pdTRUE : pdFALSE;
+}
+
+/******************************************************************************
+* Terminal side of the protocol
+******************************************************************************/
+static uint16_t Crc(uint16_t crc, const uint8_t *data, size_t len)
+{
+	for(size_t i = 0; i < len; i++)
+	{
+		crc ^= (uint16_t)(data[i] << 8);
+		for(int bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+	}
+	return crc;
+}
+
+static size_t Escape(uint8_t *frame, size_t pos, uint8_t value)
+{
+	switch(value)
+	{
+		case HOST_LINK_END:	frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_END; break;
+		case HOST_LINK_ESC:	frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_ESC; break;
+		case 0x11:			frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_XON; break;
+		case 0x13:			frame[pos++] = HOST_LINK_ESC; frame[pos++] = HOST_LINK_ESC_XOFF; break;
+		default:			frame[pos++] = value; break;
+	}
+	return pos;
+}
+
+/**************************************************************************//**
+* @fn		static size_t Encode(uint8_t type, const uint8_t *data, size_t len)
+* @brief	Encodes a request into request with the next sequence number
+* @return	Length of the frame
+*****************************************************************************/
+static size_t Encode(uint8_t type, const uint8_t *data, size_t len)
+{
+	uint8_t header[HOST_LINK_HEADER_SIZE] = {type, ++sequence};
+	uint16_t crc = Crc(Crc(0xFFFF, header, sizeof(header)), data, len);
+	size_t pos = 0;
+
+	request[pos++] = HOST_LINK_END;
+	pos = Escape(request, pos, type);
+	pos = Escape(request, pos, sequence);
+	for(size_t i = 0; i < len; i++) pos = Escape(request, pos, data[i]);
+	pos = Escape(request, pos, (uint8_t)crc);
+	pos = Escape(request, pos, (uint8_t)(crc >> 8));
+	request[pos++] = HOST_LINK_END;
+	return pos;
+}
+
+static void AddAnswer(const uint8_t *packet, size_t len, size_t *count)
+{
+	if(len < HOST_LINK_HEADER_SIZE + 1 + HOST_LINK_CRC_SIZE ||
+		Crc(0xFFFF, packet, len - 2) != (uint16_t)(packet[len - 2] | (packet[len - 1] << 8)))
+	{
+		badFrames++;
+		return;
+	}
+	if(*count >= MAX_ANSWERS) return;
+	answers[*count].type = packet[0];
+	answers[*count].sequence = packet[1];
+	answers[*count].status = packet[2];
+	answers[*count].len = (uint16_t)(len - HOST_LINK_HEADER_SIZE - 1 - HOST_LINK_CRC_SIZE);
+	memcpy(answers[*count].data, &packet[3], answers[*count].len);
+	(*count)++;
+}
+
+/**************************************************************************//**
+* @fn		static size_t Decode(void)
+* @brief	Splits the terminal output into answers and text, then clears it
+* @return	Number of answers with a good CRC, in answers. The text is in text, bad frames are counted in badFrames.
+*****************************************************************************/
+static size_t Decode(void)
+{
+	static uint8_t packet[HOST_LINK_MAX_PACKET + 1];
+	size_t outputLength, textLength = 0, len = 0, count = 0;
+	const uint8_t *output = HostConsoleOutput(&outputLength);
+	bool inFrame = false, escape = false;
+
+	badFrames = 0;
+	for(size_t i = 0; i < outputLength; i++)
+	{
+		uint8_t byte = output[i];
+		if(byte == HOST_LINK_END)
+		{
+			if(inFrame && len > 0)
+			{
+				AddAnswer(packet, len, &count);
+				inFrame = false;
+			}
+			else
+			{
+				inFrame = true;
+			}
+			len = 0;
+			escape = false;
+		}
+		else if(!inFrame)
+		{
+			if(textLength < sizeof(text) - 1) text[textLength++] = (char)byte;
+		}
+		else if(byte == HOST_LINK_ESC)
+		{
+			escape = true;
+		}
+		else if(len < sizeof(packet))
+		{
+			if(escape)
+			{
+				byte = (byte == HOST_LINK_ESC_END) ? HOST_LINK_END : (byte == HOST_LINK_ESC_ESC) ? HOST_LINK_ESC :
+					(byte == HOST_LINK_ESC_XON) ? 0x11 : (byte == HOST_LINK_ESC_XOFF) ? 0x13 : byte;
+				escape = false;
+			}
+			packet[len++] = byte;
+		}
+	}
+	if(inFrame && len > 0) badFrames++; //Cut frame
+	text[textLength] = 0;
+	HostConsoleClearOutput();
+	return count;
+}
+
+/**************************************************************************//**
+* @fn		static void Drain(void)
+* @brief	Runs the console until the TX ring buffer is empty and the last byte is out
+*****************************************************************************/
+static void Drain(void)
+{
+	while(usart_get_job_status(GetUsartModule(), USART_TRANSCEIVER_TX) == STATUS_BUSY)
+	{
+		HostConsoleRunUntil(HostConsoleNowNs() + HostConsoleByteNs());
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void Serve(void)
+* @brief	Reads the console like the CLI task until the terminal is done typing and nothing is left to read, handing
+*			every character to the link
+*****************************************************************************/
+static void Serve(void)
+{
+	uint8_t chunk[CLI_RX_CHUNK_SIZE];
+	size_t count;
+
+	do
+	{
+		count = SerialConsoleRead(chunk, sizeof(chunk), HostConsoleTyping() ? READ_TIMEOUT : 0);
+		for(size_t i = 0; i < count; i++) HostLinkInput(chunk[i]);
+	} while(count > 0 || HostConsoleTyping());
+}
+
+/**************************************************************************//**
+* @fn		static size_t Transact(uint8_t type, const uint8_t *data, size_t len)
+* @brief	Sends a request and collects the answers
+* @return	Number of good answers, in answers
+*****************************************************************************/
+static size_t Transact(uint8_t type, const uint8_t *data, size_t len)
+{
+	HostConsoleClearOutput();
+	HostConsoleType(request, Encode(type, data, len), true);
+	Serve();
+	Drain();
+	return Decode();
+}
+
+static void Put32(uint8_t *buffer, uint32_t value)
+{
+	for(int i = 0; i < 4; i++) buffer[i] = (uint8_t)(value >> (8 * i));
+}
+
+/******************************************************************************
+* Tests
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void TestPing(void)
+* @brief	A ping holding every special byte comes back unchanged, with the sequence of the request
+*****************************************************************************/
+static void TestPing(void)
+{
+	uint8_t data[64];
+
+	for(size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 7);
+	data[0] = HOST_LINK_END;
+	data[1] = HOST_LINK_ESC;
+	data[2] = 0x11;
+	data[3] = 0x13;
+
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_PING, data, sizeof(data)), 1);
+	TEST_CHECK_EQ(badFrames, 0);
+	TEST_CHECK_EQ(answers[0].type, HOST_LINK_CMD_PING | HOST_LINK_RESPONSE);
+	TEST_CHECK_EQ(answers[0].sequence, sequence);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+	TEST_CHECK_EQ(answers[0].len, sizeof(data));
+	TEST_CHECK(memcmp(answers[0].data, data, sizeof(data)) == 0);
+	TEST_CHECK_EQ(text[0], 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestTextAfterFrame(bool schedulerRunning)
+* @brief	Text written while a large answer waits in the TX ring buffer never cuts into it
+* @details	Before the scheduler runs, text that does not fit is dropped whole and counted. Once it runs, the writer
+*			waits for room and nothing is lost.
+*****************************************************************************/
+static void TestTextAfterFrame(bool schedulerRunning)
+{
+	uint8_t data[HOST_LINK_MAX_DATA - 1];
+	char line[TEXT_LINE_LEN + 1];
+	uint32_t dropped = SerialConsoleGetTxDropped();
+	uint32_t lines = 0;
+
+	for(size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)TestRandom();
+
+	//Queue the answer, then write the text while it is still in the ring buffer
+	HostConsoleClearOutput();
+	HostConsoleType(request, Encode(HOST_LINK_CMD_PING, data, sizeof(data)), true);
+	Serve();
+	hostSchedulerState = schedulerRunning ? taskSCHEDULER_RUNNING : taskSCHEDULER_NOT_STARTED;
+	for(unsigned n = 0; n < TEXT_LINES; n++)
+	{
+		snprintf(line, sizeof(line), "text line %02u %0*u\r\n", n, TEXT_LINE_LEN - 15, n);
+		SerialConsoleWriteString(line);
+	}
+	hostSchedulerState = taskSCHEDULER_RUNNING;
+	dropped = SerialConsoleGetTxDropped() - dropped;
+	Drain();
+
+	TEST_CHECK_EQ(Decode(), 1);
+	TEST_CHECK_EQ(badFrames, 0);
+	TEST_CHECK_EQ(answers[0].len, sizeof(data));
+	TEST_CHECK(memcmp(answers[0].data, data, sizeof(data)) == 0);
+
+	//Only whole lines, in order
+	TEST_CHECK_EQ(strlen(text) % TEXT_LINE_LEN, 0);
+	lines = (uint32_t)(strlen(text) / TEXT_LINE_LEN);
+	for(uint32_t i = 0, last = 0; i < lines; i++)
+	{
+		const char *pos = &text[i * TEXT_LINE_LEN];
+		unsigned n, m;
+		TEST_CHECK(sscanf(pos, "text line %u %u", &n, &m) == 2 && n == m && (i == 0 || n > last));
+		TEST_CHECK(pos[TEXT_LINE_LEN - 2] == '\r' && pos[TEXT_LINE_LEN - 1] == '\n');
+		last = n;
+	}
+	TEST_CHECK_EQ(lines + dropped, TEXT_LINES);
+	if(schedulerRunning)
+	{
+		TEST_CHECK_EQ(dropped, 0);
+	}
+	else
+	{
+		TEST_CHECK(dropped > 0);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestCli(void)
+* @brief	A CLI command answers one frame per output chunk, MORE on all but the last
+*****************************************************************************/
+static void TestCli(void)
+{
+	static const char command[] = "lines 5";
+	char expected[16];
+
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_CLI, (const uint8_t *)command, strlen(command)), 5);
+	for(unsigned i = 0; i < 5; i++)
+	{
+		snprintf(expected, sizeof(expected), "line %u\r\n", i);
+		TEST_CHECK_EQ(answers[i].status, (i < 4) ? HOST_LINK_STATUS_MORE : HOST_LINK_STATUS_OK);
+		TEST_CHECK_EQ(answers[i].len, strlen(expected));
+		TEST_CHECK(memcmp(answers[i].data, expected, answers[i].len) == 0);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestFileTransfer(void)
+* @brief	A file written through the link reads back the same, and FatFs is only called with the storage lock held
+*****************************************************************************/
+static void TestFileTransfer(void)
+{
+	static const char name[] = "\x01" "HOST.BIN";
+	uint8_t data[HOST_LINK_MAX_DATA];
+	uint32_t size;
+	const uint8_t *file;
+
+	for(size_t i = 0; i < sizeof(content); i++) content[i] = (uint8_t)TestRandom();
+
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_OPEN, (const uint8_t *)name, sizeof(name) - 1), 1);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+	for(uint32_t offset = 0; offset < FILE_SIZE; offset += WRITE_CHUNK)
+	{
+		uint32_t len = (FILE_SIZE - offset < WRITE_CHUNK) ? FILE_SIZE - offset : WRITE_CHUNK;
+		Put32(data, offset);
+		memcpy(&data[4], &content[offset], len);
+		TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_WRITE, data, len + 4), 1);
+		TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+	}
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_CLOSE, NULL, 0), 1);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+
+	file = HostFatFsFile("2:HOST.BIN", &size);
+	TEST_CHECK(file != NULL);
+	TEST_CHECK_EQ(size, FILE_SIZE);
+	TEST_CHECK(file != NULL && memcmp(file, content, FILE_SIZE) == 0);
+
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_OPEN, (const uint8_t *)"\x00" "HOST.BIN", sizeof(name) - 1), 1);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+	TEST_CHECK_EQ(answers[0].data[0] | (answers[0].data[1] << 8) | (answers[0].data[2] << 16) | (answers[0].data[3] << 24), FILE_SIZE);
+	for(uint32_t offset = 0; offset <= FILE_SIZE; offset += READ_CHUNK)
+	{
+		uint32_t len = (FILE_SIZE - offset < READ_CHUNK) ? FILE_SIZE - offset : READ_CHUNK;
+		Put32(data, offset);
+		data[4] = READ_CHUNK;
+		TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_READ, data, 5), 1);
+		TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+		TEST_CHECK_EQ(answers[0].len, len);
+		TEST_CHECK(memcmp(answers[0].data, &content[offset], len) == 0);
+	}
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_CLOSE, NULL, 0), 1);
+
+	TEST_CHECK_EQ(HostFatFsUnlockedCalls(), 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestStorageBusy(void)
+* @brief	A file request answers BUSY after HOST_LINK_STORAGE_WAIT_MS while the Wi-Fi task holds the SD card, and goes
+*			through once it lets go. A request that needs no file never takes the lock.
+*****************************************************************************/
+static void TestStorageBusy(void)
+{
+	static const char name[] = "\x01" "BUSY.TXT";
+	uint8_t data[8] = {0, 0, 0, 0, 'b', 'u', 's', 'y'};
+	uint32_t locks = storageLocks;
+	uint32_t size;
+
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_WRITE, data, sizeof(data)), 1);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_NO_FILE);
+	TEST_CHECK_EQ(storageLocks, locks);
+
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_OPEN, (const uint8_t *)name, sizeof(name) - 1), 1);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+
+	wifiHoldsStorage = true;
+	uint64_t start = HostConsoleNowNs();
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_WRITE, data, sizeof(data)), 1);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_BUSY);
+	TEST_CHECK(HostConsoleNowNs() - start >= 100000000ULL);
+	wifiHoldsStorage = false;
+
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_WRITE, data, sizeof(data)), 1);
+	TEST_CHECK_EQ(answers[0].status, HOST_LINK_STATUS_OK);
+	TEST_CHECK_EQ(Transact(HOST_LINK_CMD_FILE_CLOSE, NULL, 0), 1);
+	TEST_CHECK(HostFatFsFile("2:BUSY.TXT", &size) != NULL && size == 4);
+	TEST_CHECK_EQ(HostFatFsUnlockedCalls(), 0);
+}
+
+/**************************************************************************//**
+* @fn		static void Bench(uint16_t count)
+* @brief	Payload rate of the bulk frames, against the same bytes printed as a hex dump by a text command
+*****************************************************************************/
+static void Bench(uint16_t count)
+{
+	uint8_t data[2] = {(uint8_t)count, (uint8_t)(count >> 8)};
+	char line[MAX_OUTPUT_LENGTH_CLI];
+	uint64_t payload = (uint64_t)count * (HOST_LINK_MAX_DATA - 1);
+	uint32_t good = 0;
+	size_t answerCount;
+
+	//Bulk frames, timed from the end of the request to the last byte out
+	HostConsoleClearOutput();
+	HostConsoleType(request, Encode(HOST_LINK_CMD_BULK, data, sizeof(data)), true);
+	while(HostConsoleTyping()) HostConsoleRunUntil(HostConsoleNowNs() + HostConsoleByteNs());
+	uint64_t start = HostConsoleNowNs();
+	double t0 = TestSeconds();
+	Serve();
+	Drain();
+	double host = TestSeconds() - t0;
+	uint64_t binaryNs = HostConsoleNowNs() - start;
+	answerCount = Decode();
+
+	TEST_CHECK_EQ(answerCount, (count < MAX_ANSWERS) ? count : MAX_ANSWERS);
+	TEST_CHECK_EQ(badFrames, 0);
+	for(size_t n = 0; n < answerCount; n++)
+	{
+		bool ok = (answers[n].len == HOST_LINK_MAX_DATA - 1);
+		for(uint16_t i = 0; ok && i < answers[n].len; i++) ok = (answers[n].data[i] == (uint8_t)(n + i + 1));
+		good += ok;
+	}
+	TEST_CHECK_EQ(good, answerCount);
+
+	//The same bytes as a hex dump, 32 bytes per line, written the way a CLI command's output is
+	start = HostConsoleNowNs();
+	for(uint64_t pos = 0; pos < payload; pos += 32)
+	{
+		size_t len = 0;
+		for(uint64_t i = pos; i < pos + 32 && i < payload; i++)
+		{
+			len += (size_t)snprintf(&line[len], sizeof(line) - len, "%02x", (unsigned)(i & 0xFF));
+		}
+		snprintf(&line[len], sizeof(line) - len, "\r\n");
+		SerialConsoleWriteString(line);
+	}
+	Drain();
+	uint64_t textNs = HostConsoleNowNs() - start;
+	HostConsoleClearOutput();
+
+	printf("bench: %llu payload bytes: bulk frames %.0f B/s (%.0f%% of the line rate), hex dump %.0f B/s, "
+		"%.0f ns host per frame\n", (unsigned long long)payload, payload * 1e9 / (double)binaryNs,
+		100.0 * payload * HostConsoleByteNs() / (double)binaryNs, payload * 1e9 / (double)textNs,
+		host * 1e9 / count);
+}
+
+int main(void)
+{
+	HostConsoleReset();
+	HostFatFsReset();
+	HostRtosSetWait(HostConsoleWait);
+	InitializeSerialConsole();
+	HostLinkInit();
+
+	TestPing();
+	TestTextAfterFrame(false);
+	TestTextAfterFrame(true);
+	TestCli();
+	TestFileTransfer();
+	TestStorageBusy();
+
+	Bench(100);
+	return TEST_RESULT();
+}
@@ -0,0 +1,567 @@
+/**************************************************************************//**
+* @file      test_i2c_queue.c
+* @brief     Host tests for the request queue of I2cDriver.c, run on the simulated bus of host_i2c_bus.c.
+The blocking calls run as the single host task: while it waits, the bus completes its jobs and calls the driver
+callbacks like the SERCOM interrupt. Register reads are counted in START and STOP conditions, SCL time and task
+wake-ups, with the repeated-start transaction and with a separate write and read. A slave that holds SDA for a given
+number of clocks checks the bus recovery: clocks sent, time taken, and the requests queued meanwhile. The load
+benchmark submits the IMU burst reads and the Seesaw LED and keypad requests on their own periods from completion
+callbacks only, and gives the bus utilisation and the latency of each priority class, from the submit to the
+completion callback, in simulated time.
+
+******************************************************************************/
+
+#include "test.h"
+#include "host_i2c_bus.h"
+#include "I2cDriver.h"
+
+#define IMU_ADDR			0x6B
+#define SEESAW_ADDR			0x2E
+#define SEESAW_ANSWER_NS	250000	///<Time the Seesaw needs after the register write before it answers
+#define SEESAW_READ_DELAY	2		///<Delay SeesawDriver.c passes to I2cReadDataWait
+#define TIMEOUT				100		///<Ticks the blocking calls wait
+
+static HostI2cDevice imu;
+static HostI2cDevice seesaw;
+
+static void Setup(void)
+{
+	HostI2cBusReset();
+	memset(&imu, 0, sizeof(imu));
+	memset(&seesaw, 0, sizeof(seesaw));
+	imu.address = IMU_ADDR;
+	seesaw.address = SEESAW_ADDR;
+	seesaw.answerNs = SEESAW_ANSWER_NS;
+	for(unsigned i = 0; i < sizeof(imu.regs); i++)
+	{
+		imu.regs[i] = (uint8_t)(i ^ 0x5A);
+		seesaw.regs[i] = (uint8_t)(i + 1);
+	}
+	HostI2cBusAttach(&imu);
+	HostI2cBusAttach(&seesaw);
+}
+
+/**************************************************************************//**
+* @fn		static void TestSeesawRead(void)
+* @brief	A read chained straight after the STOP comes before the Seesaw has its answer; the Seesaw delay gives it time
+*****************************************************************************/
+static void TestSeesawRead(void)
+{
+	uint8_t cmd = 0x10;
+	uint8_t answer[4];
+	I2C_Data data = {0};
+
+	Setup();
+	data.address = SEESAW_ADDR;
+	data.priority = I2C_PRIORITY_UI;
+	data.msgOut = &cmd;
+	data.lenOut = 1;
+	data.msgIn = answer;
+	data.lenIn = sizeof(answer);
+
+	//Without a delay the read reaches the Seesaw a few us after the STOP
+	TEST_CHECK_EQ(I2cReadDataWait(&data, 0, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(seesaw.earlyReads, 1);
+	TEST_CHECK_EQ(answer[0], 0xFF);
+
+	TEST_CHECK_EQ(I2cReadDataWait(&data, SEESAW_READ_DELAY, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(seesaw.earlyReads, 1);
+	TEST_CHECK_EQ(seesaw.reads, 2);
+	for(unsigned i = 0; i < sizeof(answer); i++) TEST_CHECK_EQ(answer[i], cmd + i + 1);
+	TEST_CHECK_EQ(HostI2cBusGetStats()->starts, 4);
+	TEST_CHECK_EQ(HostI2cBusGetStats()->stops, 4);
+
+	//A device that answers at once can take the chained read
+	cmd = 0x20;
+	data.address = IMU_ADDR;
+	TEST_CHECK_EQ(I2cReadDataWait(&data, 0, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(imu.earlyReads, 0);
+	for(unsigned i = 0; i < sizeof(answer); i++) TEST_CHECK_EQ(answer[i], (uint8_t)((cmd + i) ^ 0x5A));
+}
+
+//How a register is read
+enum ReadMode
+{
+	READ_REGISTER,		///<I2cReadRegisterWait: one repeated-start transaction
+	READ_CHAINED,		///<I2cReadDataWait without delay: write and read chained by the interrupt
+	READ_DELAYED		///<I2cReadDataWait with a one tick delay, as for the Seesaw
+};
+
+//Cost of a number of register reads
+struct ReadCost
+{
+	uint32_t starts;
+	uint32_t repeatedStarts;
+	uint32_t stops;
+	uint32_t wakeups;			///<Task notifications from the interrupt
+	uint64_t busyNs;			///<Time SCL ran
+	uint64_t elapsedNs;			///<Time from the first call to the return of the last one
+};
+
+/**************************************************************************//**
+* @fn		static void MeasureReads(enum ReadMode mode, unsigned count, struct ReadCost *cost)
+* @brief	Reads the 6 bytes of the LSM6DS3 accelerometer output count times at 400 kHz, and counts what it took
+*****************************************************************************/
+static void MeasureReads(enum ReadMode mode, unsigned count, struct ReadCost *cost)
+{
+	static uint8_t reg = 0x28;
+	uint8_t out[6];
+	I2C_Data data = {.address = IMU_ADDR, .msgOut = &reg, .lenOut = 1, .msgIn = out, .lenIn = sizeof(out),
+					 .priority = I2C_PRIORITY_SENSOR, .speed = I2C_SPEED_FAST};
+	const struct HostI2cBusStats *bus = HostI2cBusGetStats();
+	struct HostI2cBusStats before = *bus;
+	uint32_t wakeups = hostNotifyFromIsrCount;
+	uint64_t start = HostI2cBusNowNs();
+
+	for(unsigned i = 0; i < count; i++)
+	{
+		int32_t error = (mode == READ_REGISTER) ? I2cReadRegisterWait(&data, TIMEOUT)
+							: I2cReadDataWait(&data, (mode == READ_DELAYED) ? 1 : 0, TIMEOUT);
+		TEST_CHECK_EQ(error, ERROR_NONE);
+		for(unsigned j = 0; j < sizeof(out); j++) TEST_CHECK_EQ(out[j], (uint8_t)((reg + j) ^ 0x5A));
+	}
+
+	cost->starts = bus->starts - before.starts;
+	cost->repeatedStarts = bus->repeatedStarts - before.repeatedStarts;
+	cost->stops = bus->stops - before.stops;
+	cost->wakeups = hostNotifyFromIsrCount - wakeups;
+	cost->busyNs = bus->busyNs - before.busyNs;
+	cost->elapsedNs = HostI2cBusNowNs() - start;
+}
+
+/**************************************************************************//**
+* @fn		static void TestRegisterRead(void)
+* @brief	A register read is one transaction with a single wake-up, and it keeps SCL busy for one bit less than a
+*			write and a read
+*****************************************************************************/
+static void TestRegisterRead(void)
+{
+	const unsigned reads = 100;
+	struct ReadCost single, chained, delayed;
+
+	Setup();
+	MeasureReads(READ_REGISTER, reads, &single);
+	MeasureReads(READ_CHAINED, reads, &chained);
+	MeasureReads(READ_DELAYED, reads, &delayed);
+
+	//START, address and register, repeated START, address and 6 bytes, STOP
+	TEST_CHECK_EQ(single.starts, reads);
+	TEST_CHECK_EQ(single.repeatedStarts, reads);
+	TEST_CHECK_EQ(single.stops, reads);
+	TEST_CHECK_EQ(single.wakeups, reads);
+	TEST_CHECK_EQ(imu.writes, 3 * reads);
+	TEST_CHECK_EQ(imu.reads, 3 * reads);
+
+	//The same bytes as two transactions
+	TEST_CHECK_EQ(chained.starts, 2 * reads);
+	TEST_CHECK_EQ(chained.repeatedStarts, 0);
+	TEST_CHECK_EQ(chained.stops, 2 * reads);
+	TEST_CHECK_EQ(chained.wakeups, reads);
+	TEST_CHECK_EQ(delayed.starts, 2 * reads);
+	TEST_CHECK_EQ(delayed.stops, 2 * reads);
+	TEST_CHECK_EQ(delayed.wakeups, 2 * reads);
+
+	//SCL runs 1 + 9 * 2 bits for the register, 1 + 9 * 7 + 1 for the data: 84 bits. The STOP of a write adds one
+	uint64_t bitNs = single.busyNs / (84 * reads);
+	uint32_t sclKhz = HostI2cBusSclKhz();
+	TEST_CHECK_EQ(single.busyNs, 84 * reads * bitNs);
+	TEST_CHECK_EQ(chained.busyNs, 85 * reads * bitNs);
+	TEST_CHECK_EQ(delayed.busyNs, 85 * reads * bitNs);
+	TEST_CHECK(bitNs * sclKhz <= 1000000 && bitNs * (sclKhz + 1) > 1000000);
+	TEST_CHECK(sclKhz > 350 && sclKhz <= 400);
+
+	//The only time a register read takes besides SCL is the driver setup of its two jobs
+	TEST_CHECK_EQ(single.elapsedNs, single.busyNs + 2 * reads * HOST_I2C_SETUP_NS);
+}
+
+/**************************************************************************//**
+* @fn		static void TestRecoveryOnlyWhenPending(void)
+* @brief	Requests only suspend the scheduler for a bus recovery when one is pending
+*****************************************************************************/
+static void TestRecoveryOnlyWhenPending(void)
+{
+	uint8_t reg = 0x0F;
+	uint8_t value = 0;
+	I2C_Data data = {0};
+	I2cBusStats before, after;
+
+	Setup();
+	data.address = IMU_ADDR;
+	data.msgOut = &reg;
+	data.lenOut = 1;
+	data.msgIn = &value;
+	data.lenIn = 1;
+
+	I2cGetBusStats(&before);
+	hostSuspendAllCount = 0;
+	for(int i = 0; i < 100; i++) TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(hostSuspendAllCount, 0);
+	TEST_CHECK_EQ(value, 0x0F ^ 0x5A);
+
+	//A NACK does not leave the bus held
+	data.address = 0x50;
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_ABORTED);
+	TEST_CHECK_EQ(hostSuspendAllCount, 0);
+
+	//A slave that holds SDA fails the request; the bus is recovered once
+	data.address = IMU_ADDR;
+	imu.stuckClocks = 3;
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_ABORTED);
+	TEST_CHECK_EQ(hostSuspendAllCount, 1);
+	TEST_CHECK_EQ(imu.stuckClocks, 0);
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(hostSuspendAllCount, 1);
+
+	I2cGetBusStats(&after);
+	TEST_CHECK_EQ(after.requests - before.requests, 103);
+	TEST_CHECK_EQ(after.nacks - before.nacks, 1);
+	TEST_CHECK_EQ(after.busErrors - before.busErrors, 1);
+	TEST_CHECK_EQ(after.recoveries - before.recoveries, 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestStuckSda(uint8_t stuckClocks)
+* @brief	A slave holding SDA for stuckClocks clocks fails the request; the recovery clocks SCL until SDA is free,
+*			sends a STOP and the next request goes through
+*****************************************************************************/
+static void TestStuckSda(uint8_t stuckClocks)
+{
+	uint8_t reg = 0x0F;
+	uint8_t value = 0;
+	I2C_Data data = {.address = IMU_ADDR, .msgOut = &reg, .lenOut = 1, .msgIn = &value, .lenIn = 1};
+	const struct HostI2cBusStats *bus = HostI2cBusGetStats();
+	I2cBusStats before, after;
+	uint32_t suspends = hostSuspendAllCount;
+
+	Setup();
+	I2cGetBusStats(&before);
+	imu.stuckClocks = stuckClocks;
+	uint64_t start = HostI2cBusNowNs();
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_ABORTED);
+	uint64_t elapsed = HostI2cBusNowNs() - start;
+
+	TEST_CHECK_EQ(bus->collisions, 1);
+	TEST_CHECK_EQ(imu.stuckClocks, 0);
+	//SCL stops once SDA is free; the STOP that follows takes one more clock
+	TEST_CHECK_EQ(bus->recoveryClocks, stuckClocks + 1);
+	TEST_CHECK(bus->stops >= 1);
+	TEST_CHECK_EQ(hostSuspendAllCount - suspends, 1);
+
+	//The failed job: setup, START and the first bit at 100 kHz. Then the recovery: lines released, a half period per
+	//clock edge, and the STOP: 2 + 2 * clocks + 4 half periods
+	uint64_t recoveryNs = (6 + 2ULL * stuckClocks) * I2C_RECOVERY_HALF_PERIOD_US * 1000ULL;
+	TEST_CHECK(elapsed >= recoveryNs + HOST_I2C_SETUP_NS + 2 * 9000 && elapsed <= recoveryNs + HOST_I2C_SETUP_NS + 2 * 10000);
+
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(value, 0x0F ^ 0x5A);
+	I2cGetBusStats(&after);
+	TEST_CHECK_EQ(after.busErrors - before.busErrors, 1);
+	TEST_CHECK_EQ(after.recoveries - before.recoveries, 1);
+	TEST_CHECK_EQ(after.recoveryFailures - before.recoveryFailures, 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestStuckSdaLong(void)
+* @brief	A slave that needs more than I2C_RECOVERY_CLOCKS clocks is freed over several failed requests
+*****************************************************************************/
+static void TestStuckSdaLong(void)
+{
+	uint8_t reg = 0x0F;
+	uint8_t value = 0;
+	I2C_Data data = {.address = IMU_ADDR, .msgOut = &reg, .lenOut = 1, .msgIn = &value, .lenIn = 1};
+	I2cBusStats before, after;
+
+	Setup();
+	I2cGetBusStats(&before);
+	imu.stuckClocks = 2 * I2C_RECOVERY_CLOCKS + 3;
+
+	//Each failed request gets a recovery of I2C_RECOVERY_CLOCKS clocks and the clock of its STOP
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_ABORTED);
+	TEST_CHECK_EQ(imu.stuckClocks, I2C_RECOVERY_CLOCKS + 2);
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_ABORTED);
+	TEST_CHECK_EQ(imu.stuckClocks, 1);
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_ABORTED);
+	TEST_CHECK_EQ(imu.stuckClocks, 0);
+	TEST_CHECK_EQ(I2cReadRegisterWait(&data, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(value, 0x0F ^ 0x5A);
+
+	I2cGetBusStats(&after);
+	TEST_CHECK_EQ(after.busErrors - before.busErrors, 3);
+	TEST_CHECK_EQ(after.recoveries - before.recoveries, 3);
+	TEST_CHECK_EQ(after.recoveryFailures - before.recoveryFailures, 2);
+	TEST_CHECK_EQ(HostI2cBusGetStats()->recoveryClocks, 2 * (I2C_RECOVERY_CLOCKS + 1) + 1 + 1);
+}
+
+static void CountCompletion(I2cRequest *request)
+{
+	(*(int *)request->context)++;
+}
+
+/**************************************************************************//**
+* @fn		static void TestStuckSdaQueued(void)
+* @brief	Requests queued while the bus waits for its recovery stay queued, and go out once the next request submitted
+*			by a task has recovered it
+*****************************************************************************/
+static void TestStuckSdaQueued(void)
+{
+	static uint8_t reg = 0x0F;
+	static uint8_t values[3];
+	static I2C_Data async[2];
+	I2C_Data blocking = {.address = IMU_ADDR, .msgOut = &reg, .lenOut = 1, .msgIn = &values[2], .lenIn = 1,
+						 .priority = I2C_PRIORITY_SENSOR};
+	I2cRequest requests[2];
+	int done = 0;
+
+	Setup();
+	imu.stuckClocks = 4;
+	memset(requests, 0, sizeof(requests));
+	for(int i = 0; i < 2; i++)
+	{
+		async[i] = (I2C_Data){.address = IMU_ADDR, .msgOut = &reg, .lenOut = 1, .msgIn = &values[i], .lenIn = 1};
+		requests[i] = (I2cRequest){.data = &async[i], .type = I2C_REQUEST_WRITE_READ, .priority = I2C_PRIORITY_UI,
+								   .callback = CountCompletion, .context = &done};
+		TEST_CHECK_EQ(I2cSubmitRequest(&requests[i]), ERROR_NONE);
+	}
+
+	//The first fails on the held bus; the second waits for a recovery, which the interrupt does not run
+	HostI2cBusRunUntil(HostI2cBusNowNs() + 5000000ULL);
+	TEST_CHECK_EQ(done, 1);
+	TEST_CHECK_EQ(requests[0].status, ERROR_ABORTED);
+	TEST_CHECK_EQ(requests[1].status, ERROR_BUSY);
+	TEST_CHECK_EQ(HostI2cBusGetStats()->jobs, 1);
+	TEST_CHECK_EQ(imu.stuckClocks, 4);
+
+	//The next request recovers the bus before it is queued: the waiting one goes first, then the new one
+	TEST_CHECK_EQ(I2cReadRegisterWait(&blocking, TIMEOUT), ERROR_NONE);
+	TEST_CHECK_EQ(imu.stuckClocks, 0);
+	TEST_CHECK_EQ(done, 2);
+	TEST_CHECK_EQ(requests[1].status, ERROR_NONE);
+	TEST_CHECK_EQ(values[1], 0x0F ^ 0x5A);
+	TEST_CHECK_EQ(values[2], 0x0F ^ 0x5A);
+	TEST_CHECK_EQ(HostI2cBusGetStats()->jobs, 5);
+}
+
+static int completionOrder[4];
+static int completions;
+
+static void RecordCompletion(I2cRequest *request)
+{
+	completionOrder[completions++] = (int)(intptr_t)request->context;
+}
+
+/**************************************************************************//**
+* @fn		static void TestPriority(void)
+* @brief	A sensor request waiting for the bus goes before the UI requests queued ahead of it
+*****************************************************************************/
+static void TestPriority(void)
+{
+	static uint8_t frame[32];
+	static uint8_t reg = 0x3E;
+	static uint8_t fifo[12];
+	I2C_Data ui = {0}, sensor = {0};
+	I2cRequest requests[3];
+
+	Setup();
+	ui.address = SEESAW_ADDR;
+	ui.priority = I2C_PRIORITY_UI;
+	ui.msgOut = frame;
+	ui.lenOut = sizeof(frame);
+	sensor.address = IMU_ADDR;
+	sensor.speed = I2C_SPEED_FAST;
+	sensor.msgOut = &reg;
+	sensor.lenOut = 1;
+	sensor.msgIn = fifo;
+	sensor.lenIn = sizeof(fifo);
+
+	memset(requests, 0, sizeof(requests));
+	completions = 0;
+	for(int i = 0; i < 3; i++)
+	{
+		requests[i].data = (i == 2) ? &sensor : &ui;
+		requests[i].type = (i == 2) ? I2C_REQUEST_WRITE_READ : I2C_REQUEST_WRITE;
+		requests[i].priority = (i == 2) ? I2C_PRIORITY_SENSOR : I2C_PRIORITY_UI;
+		requests[i].callback = RecordCompletion;
+		requests[i].context = (void *)(intptr_t)i;
+		TEST_CHECK_EQ(I2cSubmitRequest(&requests[i]), ERROR_NONE);
+	}
+	HostI2cBusRunUntil(HostI2cBusNowNs() + 20000000ULL);
+
+	TEST_CHECK_EQ(completions, 3);
+	TEST_CHECK_EQ(completionOrder[0], 0);
+	TEST_CHECK_EQ(completionOrder[1], 2);
+	TEST_CHECK_EQ(completionOrder[2], 1);
+	for(int i = 0; i < 3; i++) TEST_CHECK_EQ(requests[i].status, ERROR_NONE);
+	TEST_CHECK_EQ(HostI2cBusGetStats()->repeatedStarts, 1);
+}
+
+/**************************************************************************//**
+* @fn		static void BenchRegisterRead(void)
+* @brief	Bus conditions, SCL time, wake-ups and time per 6 byte register read, for each way of reading
+*****************************************************************************/
+static void BenchRegisterRead(void)
+{
+	static const char *const names[] = {"repeated start", "write, read", "write, delay, read"};
+	const unsigned reads = 1000;
+
+	Setup();
+	for(enum ReadMode mode = READ_REGISTER; mode <= READ_DELAYED; mode++)
+	{
+		struct ReadCost cost;
+		double t0 = TestSeconds();
+		MeasureReads(mode, reads, &cost);
+		double host = TestSeconds() - t0;
+
+		printf("bench: register read, %s: %.1f START, %.1f repeated START, %.1f STOP, %.1f wake-ups, %.1f us SCL, "
+			   "%.1f us per read, %.0f ns host per read\n", names[mode], (double)cost.starts / reads,
+			   (double)cost.repeatedStarts / reads, (double)cost.stops / reads, (double)cost.wakeups / reads,
+			   cost.busyNs / 1000.0 / reads, cost.elapsedNs / 1000.0 / reads, host * 1e9 / reads);
+	}
+}
+
+//Periodic source of requests of the benchmark
+struct Source
+{
+	const char *name;
+	eI2cPriority priority;
+	uint64_t periodNs;			///<Period of the requests
+	uint64_t nextNs;			///<Time of the next submit
+	uint8_t count;				///<Requests submitted together
+	I2C_Data data[2];
+	I2cRequest requests[2];
+	eI2cRequestType types[2];
+	uint64_t submittedNs;		///<Time of the last submit
+	uint8_t pending;			///<Requests of the last submit not done yet
+	uint32_t done;				///<Groups completed
+	uint32_t overruns;			///<Submits skipped because the previous group was not done
+	uint64_t latencySumNs;		///<Sum of the latency of the groups, from the submit to the last completion
+	uint64_t latencyMaxNs;
+};
+
+static void SourceDone(I2cRequest *request)
+{
+	struct Source *source = request->context;
+	TEST_CHECK_EQ(request->status, ERROR_NONE);
+	if(--source->pending == 0)
+	{
+		uint64_t latency = HostI2cBusNowNs() - source->submittedNs;
+		source->done++;
+		source->latencySumNs += latency;
+		if(latency > source->latencyMaxNs) source->latencyMaxNs = latency;
+	}
+}
+
+static void SourceSubmit(struct Source *source, uint64_t now)
+{
+	source->nextNs += source->periodNs;
+	if(source->pending > 0)
+	{
+		source->overruns++;
+		return;
+	}
+	source->submittedNs = now;
+	source->pending = source->count;
+	for(uint8_t i = 0; i < source->count; i++)
+	{
+		I2cRequest *request = &source->requests[i];
+		memset(request, 0, sizeof(*request));
+		request->data = &source->data[i];
+		request->type = source->types[i];
+		request->priority = source->priority;
+		request->callback = SourceDone;
+		request->context = source;
+		TEST_CHECK_EQ(I2cSubmitRequest(request), ERROR_NONE);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void BenchLoad(uint32_t imuPeriodUs, uint16_t imuBytes)
+* @brief	Runs one second of IMU FIFO reads at 400 kHz with the Seesaw traffic of the UI task at 100 kHz:
+*			a 32 byte LED write and a keypad read every 20 ms
+* @param[in]	imuPeriodUs Period of the IMU FIFO reads
+* @param[in]	imuBytes Bytes per FIFO read
+*****************************************************************************/
+static void BenchLoad(uint32_t imuPeriodUs, uint16_t imuBytes)
+{
+	static uint8_t fifoReg = 0x3E, pixels[32], keypadCmd[2] = {0x10, 0x10}, keypad[4], fifo[1024];
+	struct Source imuSource, ui;
+	const struct HostI2cBusStats *bus = HostI2cBusGetStats();
+	uint64_t start, end, longestUiNs, imuNs;
+
+	Setup();
+	memset(&imuSource, 0, sizeof(imuSource));
+	memset(&ui, 0, sizeof(ui));
+	seesaw.answerNs = 0;
+
+	imuSource.name = "imu";
+	imuSource.priority = I2C_PRIORITY_SENSOR;
+	imuSource.periodNs = 1000ULL * imuPeriodUs;
+	imuSource.count = 1;
+	imuSource.types[0] = I2C_REQUEST_WRITE_READ;
+	imuSource.data[0] = (I2C_Data){.address = IMU_ADDR, .msgOut = &fifoReg, .lenOut = 1, .msgIn = fifo, .lenIn = imuBytes,
+								   .priority = I2C_PRIORITY_SENSOR, .speed = I2C_SPEED_FAST};
+
+	ui.name = "ui";
+	ui.priority = I2C_PRIORITY_UI;
+	ui.periodNs = 20000000ULL;
+	ui.count = 2;
+	ui.types[0] = I2C_REQUEST_WRITE;
+	ui.data[0] = (I2C_Data){.address = SEESAW_ADDR, .msgOut = pixels, .lenOut = sizeof(pixels), .priority = I2C_PRIORITY_UI};
+	ui.types[1] = I2C_REQUEST_WRITE_THEN_READ;
+	ui.data[1] = (I2C_Data){.address = SEESAW_ADDR, .msgOut = keypadCmd, .lenOut = sizeof(keypadCmd), .msgIn = keypad,
+							.lenIn = sizeof(keypad), .priority = I2C_PRIORITY_UI};
+
+	start = HostI2cBusNowNs();
+	end = start + 1000000000ULL;
+	imuSource.nextNs = start;
+	ui.nextNs = start + 3000000ULL;
+	while(true)
+	{
+		uint64_t next = (imuSource.nextNs < ui.nextNs) ? imuSource.nextNs : ui.nextNs;
+		if(next >= end) break;
+		HostI2cBusRunUntil(next);
+		if(imuSource.nextNs == next) SourceSubmit(&imuSource, next);
+		if(ui.nextNs == next) SourceSubmit(&ui, next);
+	}
+	HostI2cBusRunUntil(end + 50000000ULL);
+
+	TEST_CHECK_EQ(imuSource.pending, 0);
+	TEST_CHECK_EQ(ui.pending, 0);
+	TEST_CHECK_EQ(ui.overruns, 0);
+
+	//Without preemption a sensor read waits at most for the UI transfer on the bus (33 bytes at 100 kHz, with the STOP)
+	longestUiNs = (1 + 9 * 33 + 1) * 10000ULL + 2 * HOST_I2C_SETUP_NS;
+	imuNs = (2 + 9 * (2 + (uint64_t)imuBytes) + 1) * 2500ULL + 2 * HOST_I2C_SETUP_NS;
+	TEST_CHECK(imuSource.latencyMaxNs <= longestUiNs + imuNs + imuNs / 10);
+	if(imuSource.periodNs > longestUiNs + imuNs + imuNs / 10)
+	{
+		TEST_CHECK_EQ(imuSource.overruns, 0);
+	}
+
+	printf("bench: imu %u B every %u us: bus %.1f%% busy, imu latency avg %.0f us max %.0f us (%u reads missed), "
+		   "ui latency avg %.0f us max %.0f us\n",
+		   imuBytes, imuPeriodUs, 100.0 * (double)bus->busyNs / (double)(end - start),
+		   imuSource.latencySumNs / 1000.0 / imuSource.done, imuSource.latencyMaxNs / 1000.0, imuSource.overruns,
+		   ui.latencySumNs / 1000.0 / ui.done, ui.latencyMaxNs / 1000.0);
+}
+
+int main(void)
+{
+	TEST_CHECK_EQ(I2cInitializeDriver(), STATUS_OK);
+	HostRtosSetWait(HostI2cBusWait);
+
+	TestSeesawRead();
+	TestRegisterRead();
+	TestRecoveryOnlyWhenPending();
+	for(uint8_t clocks = 1; clocks <= I2C_RECOVERY_CLOCKS; clocks++) TestStuckSda(clocks);
+	TestStuckSdaLong();
+	TestStuckSdaQueued();
+	TestPriority();
+
+	BenchRegisterRead();
+
+	BenchLoad(10000, 60);
+	BenchLoad(10000, 120);
+	BenchLoad(5000, 120);
+	BenchLoad(2500, 60);
+	return TEST_RESULT();
+}
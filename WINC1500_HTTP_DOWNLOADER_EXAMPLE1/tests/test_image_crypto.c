@@ -0,0 +1,375 @@
+/**************************************************************************//**
+* @file      test_image_crypto.c
+* @brief     Host tests for Ed25519.c and Sha256.c of the bootloader, which check the signature of every image it installs.
+Ed25519Verify() must accept the RFC 8032 vectors and the extra vectors of tools/image_sign.py, whose message lengths
+sit around the SHA-512 block boundaries, and reject a change to any byte of the signature, key or message, a signature
+whose S has L added to it, and keys that are not canonical or not on the curve. Sha256 must give the FIPS 180-4
+digests however the message is split between the Sha256Update() calls. The benchmark gives host timings only; the
+bootloader prints its own on the board.
+
+******************************************************************************/
+
+#include "test.h"
+#include "Crypto/Ed25519.h"
+#include "Crypto/Sha256.h"
+
+#define MESSAGE_MAX		1000
+
+typedef struct
+{
+	uint16_t len;				///<Message length, the message is TestMessage()
+	const char *publicKey;		///<Hex
+	const char *signature;		///<Hex
+} Ed25519Vector;
+
+typedef struct
+{
+	uint16_t len;				///<Message length, the message is TestMessage()
+	const char *digest;			///<Hex
+} Sha256Vector;
+
+//RFC 8032 section 7.1 tests 1 to 3: public key, message, signature
+static const struct
+{
+	const char *publicKey;
+	const char *message;
+	const char *signature;
+} rfc8032Vectors[] = {
+	{"d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a", "",
+		"e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e06522490155"
+		"5fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b"},
+	{"3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c", "72",
+		"92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da"
+		"085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00"},
+	{"fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025", "af82",
+		"6291d657deec24024827e69c3abe01a30ce548a284743a445e3680d7db5ac3ac"
+		"18ff9b538d16f290ae67f760984dc6594a7c15e9716ed28dc027beceea1ec40a"},
+};
+
+//Generated by tools/image_sign.py vectors --c: length, public key, signature
+static const Ed25519Vector ed25519Vectors[] = {
+	{0, "36546a7073bc02152743ef9df7e14191dd8d1c49c04b9aded8c41ab3308fad2a",
+		"23e7f5541900bd159cbb9b438257649c735ede6d98adc88edf64a724bf148335"
+		"d8ac636e95826d6c97e813f095dcd15678b5212d108dca142168307b96560309"},
+	{1, "0766b36e452ac3fb8acefe50eee9aa6fa19cc8dba1d84bb67e314e4431647920",
+		"b8ab826c62167816c6a2be230df8d253ecf01e9f1fe146c5ac4c03db26b9e843"
+		"a07a9a3f7c42d6584d55799136eaf14839c72f2a6ed7876d84355e23b90ee400"},
+	{32, "340f84bbdb08c6a206d89d9ee8aa84ccbb45da0db059a579d9180383274c7c74",
+		"6b7b8fa4e84d4795766c0aaf4930b380a3c0a432cf2e1f89ac9a7170b2f2142d"
+		"18ec16e6eef789b00ed057b58f4374609c63feac3607e138ddebcd7fd8d81909"},
+	{47, "4747ec53c780e009fb22d35c5d36304b25932dca69b7b8c05d8dc4824fc6c84c",
+		"e1d9969be30eed76e80c9be1cc473b06b492bdc61a97216e9af78b61fa616c34"
+		"c6122639e8a045ecf7115ae3153f0c084639a6ff41f0c16a06fbac61f3845404"},
+	{48, "374e480635336207ae5210685e98e99de072e55509e3e33eb935f96051e8f6fa",
+		"c96c8222b4d2fcbeccd2a1466f4d4843e60fbef46b389dce93b08e37038e592d"
+		"c66160917f1e20be72c8d7d43f2cf16432a4334be7aa4be90d3ef92d9964230c"},
+	{63, "d74409ad30157efa3db903a2d6151c68cdbf281e1d750d7cb6bfa2ab138c32f8",
+		"97c837ccc2b8c177aa704225ed12aca6f8b4096282383b9961288bde4d9791cf"
+		"cada6e6ce9c67e2c8e19312a887c0151a14032616260f2ca3149ce89c1357306"},
+	{64, "573bf08c4b7750fdd080fc167df940a99ce652d63780e8c6b8262211671b71e5",
+		"2e95511de3eb43eb23a39908e320f5573e96e86f23eb53e3e540fa860059a78c"
+		"18f82238cae0efc5dc4d01c6f3573b471d29a9d0f584bd8d4b6a17cde9a3ff0f"},
+	{111, "d013b54aff7f8c52d645c30b67cc00ad01ec53c1c636f9d42b437a4401a95cec",
+		"d0d9a45188ec4177071074d3aefc05c664924c439a2995f30e342a7466c6a246"
+		"edf0cb41a49d89447830357a9762ea1fb23eb80848a1851e4c544b3be2f09c0d"},
+	{112, "d9e058781bbf5e8d7392ad03b7d81a755a963a4ed813b111916e50f890b6dc7c",
+		"ef08416510bf63c53298c81322fb555e54b32d3656e5600c5e9dddca67772201"
+		"66c22aea82b66a2c8ed1f422f7b2b9e5ad68e8466a2a3158464582650a06f20f"},
+	{127, "a916ad617964cead9bb42cfad40dea2f3fd853fd901c1e72161217117e1e68f1",
+		"38376ca92bd80739c595b3fe2c51495ed59273c2da78cfbc4169a8432e3ee31a"
+		"ac2991bc8c610a2221ccbef1f66bebebc7f8e51a295d6693756c250584c8510d"},
+	{128, "8ac847001fe76755078e172ce939b4540b3845d73544c0e91869b1388a316600",
+		"daa9919503e2b1277afbd4af7bd136348b1e5bedc3564f33a3b734bc3b2dc8fa"
+		"2cc7d362ee5b6c9e5b26898515e1adbfad9795e6604fac5894c1780bbfd9c90b"},
+	{200, "88a4ef43e66fed5f1acaa02e42b6030e38db06b0d336edb5bdb9524b2225776a",
+		"9dcb2488a4cb39c5ee98a3288f5f7da11b6517b5ecad83d355321522cacbb48d"
+		"5dc630a15d483094218d83650316d3eb7c74659bc47174f870e4fb8ef099b30e"},
+	{255, "3130131bee48dd0f4dfef7c9b08213aa5703ab10900aa588ff83025b34881552",
+		"22d5a9413a0e6888827283e99eb11deccdf69d8d1cd3c8521fc9545ac1dd9aca"
+		"901c534750f3aeb99d6481f2400681a8455ea20f362960b6bc652f5df3be2e05"},
+};
+
+//Generated by tools/image_sign.py vectors --c: length, SHA-256
+static const Sha256Vector sha256Vectors[] = {
+	{55, "81afe5b788dc2ce138ff83d9b20164db75a94d75d2b2432eea4a0ef605088c72"},
+	{56, "2aba54f0ac632420a2b502431408866e40e1d5e430df4cd822642c78ab2eb9c1"},
+	{63, "733d3d4ee79ee67145bf73da13588f6f235d37414fc64b14a2f00f1762792f5e"},
+	{64, "79322907b3e9d013d7dc2c2f256674dbf733045cde01df3539271c6f5605feb8"},
+	{65, "d85c007c6eb440f085afa2b84f6f2bce4658b240e9f62cb1364bf0485a57e720"},
+	{119, "6c87eedf096b345de205b702e5223b73b447a3207791ded3ea007ba15ed6736e"},
+	{120, "42500cf6a1e3936d6b9e0bcfe296d654b63255e525487d3634d0b15fde591c4d"},
+	{128, "489d55fea9a73af36b6dd0be7b4117d8e5683386d39544e8a44c99a87f368707"},
+	{1000, "6b0df76627243d095b0c4400cb658b7e804dd03461cc03aee8fc8fe0bcada168"},
+};
+
+//L = 2^252 + 27742317777372353535851937790883648493, little endian
+static const uint8_t orderL[32] = {
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+static uint8_t message[MESSAGE_MAX + 1];
+
+static size_t Hex(uint8_t *out, const char *hex)
+{
+	size_t len = strlen(hex) / 2;
+	for(size_t i = 0; i < len; i++)
+	{
+		unsigned byte;
+		sscanf(&hex[2 * i], "%2x", &byte);
+		out[i] = (uint8_t)byte;
+	}
+	return len;
+}
+
+/**************************************************************************//**
+* @fn		static void TestMessage(uint16_t len)
+* @brief	Fills message with the test message of image_sign.py: byte i of the message of length n is (7 i + n) & 0xFF
+*****************************************************************************/
+static void TestMessage(uint16_t len)
+{
+	for(uint16_t i = 0; i < len; i++) message[i] = (uint8_t)(7 * i + len);
+}
+
+/**************************************************************************//**
+* @fn		static void TestTampered(const uint8_t *signature, size_t len, const uint8_t *publicKey, bool everyByte)
+* @brief	A valid signature is rejected once any bit of the signature, the key or the message changes
+* @param[in]	everyByte true to change every byte in turn, false for a few random bits
+*****************************************************************************/
+static void TestTampered(const uint8_t *signature, size_t len, const uint8_t *publicKey, bool everyByte)
+{
+	uint8_t sig[ED25519_SIGNATURE_SIZE], key[ED25519_PUBLIC_KEY_SIZE];
+	unsigned accepted = 0;
+
+	for(unsigned n = 0; n < (everyByte ? ED25519_SIGNATURE_SIZE : 4u); n++)
+	{
+		unsigned bit = everyByte ? 8 * n + n % 8 : TestRandom() % (ED25519_SIGNATURE_SIZE * 8);
+		memcpy(sig, signature, sizeof(sig));
+		sig[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+		accepted += Ed25519Verify(sig, message, len, publicKey);
+	}
+	for(unsigned n = 0; n < (everyByte ? ED25519_PUBLIC_KEY_SIZE : 4u); n++)
+	{
+		unsigned bit = everyByte ? 8 * n + n % 8 : TestRandom() % (ED25519_PUBLIC_KEY_SIZE * 8);
+		memcpy(key, publicKey, sizeof(key));
+		key[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+		accepted += Ed25519Verify(signature, message, len, key);
+	}
+	for(size_t i = 0; i < len; i++)
+	{
+		if(!everyByte && TestRandom() % 16 != 0) continue;
+		uint8_t mask = (uint8_t)(1 << (TestRandom() % 8));
+		message[i] ^= mask;
+		accepted += Ed25519Verify(signature, message, len, publicKey);
+		message[i] ^= mask;
+	}
+	//One byte more or less
+	accepted += Ed25519Verify(signature, message, len + 1, publicKey);
+	if(len > 0) accepted += Ed25519Verify(signature, message, len - 1, publicKey);
+
+	TEST_CHECK_EQ(accepted, 0);
+	TEST_CHECK(Ed25519Verify(signature, message, len, publicKey));
+}
+
+/**************************************************************************//**
+* @fn		static void TestMalleability(const uint8_t *signature, size_t len, const uint8_t *publicKey)
+* @brief	S + L gives the same point [S]B but must be rejected, and so must S = L
+*****************************************************************************/
+static void TestMalleability(const uint8_t *signature, size_t len, const uint8_t *publicKey)
+{
+	uint8_t sig[ED25519_SIGNATURE_SIZE];
+	unsigned carry = 0;
+
+	memcpy(sig, signature, 32);
+	for(int i = 0; i < 32; i++)
+	{
+		carry += signature[32 + i] + orderL[i];
+		sig[32 + i] = (uint8_t)carry;
+		carry >>= 8;
+	}
+	TEST_CHECK_EQ(carry, 0);
+	TEST_CHECK(!Ed25519Verify(sig, message, len, publicKey));
+
+	memcpy(&sig[32], orderL, 32);
+	TEST_CHECK(!Ed25519Verify(sig, message, len, publicKey));
+}
+
+/**************************************************************************//**
+* @fn		static void TestEd25519(void)
+* @brief	The RFC 8032 and image_sign.py vectors verify, and every change to them is rejected
+*****************************************************************************/
+static void TestEd25519(void)
+{
+	uint8_t publicKey[ED25519_PUBLIC_KEY_SIZE], signature[ED25519_SIGNATURE_SIZE];
+
+	for(size_t v = 0; v < sizeof(rfc8032Vectors) / sizeof(rfc8032Vectors[0]); v++)
+	{
+		size_t len = Hex(message, rfc8032Vectors[v].message);
+		Hex(publicKey, rfc8032Vectors[v].publicKey);
+		Hex(signature, rfc8032Vectors[v].signature);
+		TEST_CHECK(Ed25519Verify(signature, message, len, publicKey));
+		TestTampered(signature, len, publicKey, true);
+		TestMalleability(signature, len, publicKey);
+	}
+
+	for(size_t v = 0; v < sizeof(ed25519Vectors) / sizeof(ed25519Vectors[0]); v++)
+	{
+		TestMessage(ed25519Vectors[v].len);
+		Hex(publicKey, ed25519Vectors[v].publicKey);
+		Hex(signature, ed25519Vectors[v].signature);
+		TEST_CHECK(Ed25519Verify(signature, message, ed25519Vectors[v].len, publicKey));
+		TestTampered(signature, ed25519Vectors[v].len, publicKey, false);
+		TestMalleability(signature, ed25519Vectors[v].len, publicKey);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestBadKeys(void)
+* @brief	Keys that are not the canonical encoding of a curve point are rejected
+* @details	The signature R = B, S = 1 holds for any message under the neutral point as key, since [1]B - [k]0 = B.
+*			It verifies under the canonical encoding y = 1, so only the key decoding can reject the other encodings.
+*****************************************************************************/
+static void TestBadKeys(void)
+{
+	uint8_t signature[ED25519_SIGNATURE_SIZE] = {0x58}, key[ED25519_PUBLIC_KEY_SIZE];
+
+	memset(&signature[1], 0x66, 31);	//y of B = 4/5
+	signature[32] = 1;
+	TestMessage(32);
+
+	//y = 1, the neutral point
+	memset(key, 0, sizeof(key));
+	key[0] = 1;
+	TEST_CHECK(Ed25519Verify(signature, message, 32, key));
+
+	//y = 1 with the sign bit set: x = 0 has no negative
+	key[31] = 0x80;
+	TEST_CHECK(!Ed25519Verify(signature, message, 32, key));
+
+	//y = p + 1, which reduces to y = 1
+	memset(key, 0xFF, sizeof(key));
+	key[0] = 0xEE;
+	key[31] = 0x7F;
+	TEST_CHECK(!Ed25519Verify(signature, message, 32, key));
+
+	//y = 2 is not on the curve
+	memset(key, 0, sizeof(key));
+	key[0] = 2;
+	TEST_CHECK(!Ed25519Verify(signature, message, 32, key));
+}
+
+static void Sha256(const uint8_t *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	Sha256Context ctx;
+	Sha256Init(&ctx);
+	Sha256Update(&ctx, data, len);
+	Sha256Final(&ctx, digest);
+}
+
+static void CheckDigest(const uint8_t *digest, const char *hex)
+{
+	uint8_t expected[SHA256_DIGEST_SIZE];
+	Hex(expected, hex);
+	TEST_CHECK(memcmp(digest, expected, SHA256_DIGEST_SIZE) == 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestSha256(void)
+* @brief	FIPS 180-4 digests, and the same digest whatever the split of the message between updates
+*****************************************************************************/
+static void TestSha256(void)
+{
+	static const char block2[] = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	static const char block4[] = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrs"
+		"mnopqrstnopqrstu";
+	uint8_t digest[SHA256_DIGEST_SIZE], whole[SHA256_DIGEST_SIZE];
+	Sha256Context ctx;
+
+	Sha256((const uint8_t *)"", 0, digest);
+	CheckDigest(digest, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+	Sha256((const uint8_t *)"abc", 3, digest);
+	CheckDigest(digest, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	Sha256((const uint8_t *)block2, strlen(block2), digest);
+	CheckDigest(digest, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+	Sha256((const uint8_t *)block4, strlen(block4), digest);
+	CheckDigest(digest, "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+
+	//One million 'a', fed in uneven pieces
+	memset(message, 'a', MESSAGE_MAX);
+	Sha256Init(&ctx);
+	for(uint32_t left = 1000000; left > 0;)
+	{
+		uint32_t part = TestRandom() % MESSAGE_MAX;
+		if(part > left) part = left;
+		Sha256Update(&ctx, message, part);
+		left -= part;
+	}
+	Sha256Final(&ctx, digest);
+	CheckDigest(digest, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+	//Lengths around the padding boundaries
+	for(size_t v = 0; v < sizeof(sha256Vectors) / sizeof(sha256Vectors[0]); v++)
+	{
+		TestMessage(sha256Vectors[v].len);
+		Sha256(message, sha256Vectors[v].len, digest);
+		CheckDigest(digest, sha256Vectors[v].digest);
+	}
+
+	//Every split point of a message over several blocks, then random splits with empty updates
+	TestMessage(300);
+	Sha256(message, 300, whole);
+	for(size_t split = 0; split <= 300; split++)
+	{
+		Sha256Init(&ctx);
+		Sha256Update(&ctx, message, split);
+		Sha256Update(&ctx, &message[split], 300 - split);
+		Sha256Final(&ctx, digest);
+		TEST_CHECK(memcmp(digest, whole, sizeof(digest)) == 0);
+	}
+	for(int run = 0; run < 200; run++)
+	{
+		Sha256Init(&ctx);
+		for(size_t pos = 0; pos < 300;)
+		{
+			size_t part = TestRandom() % 80;
+			if(part > 300 - pos) part = 300 - pos;
+			Sha256Update(&ctx, &message[pos], part);
+			pos += part;
+		}
+		Sha256Final(&ctx, digest);
+		TEST_CHECK(memcmp(digest, whole, sizeof(digest)) == 0);
+	}
+}
+
+static void Bench(void)
+{
+	static uint8_t image[65536];
+	uint8_t publicKey[ED25519_PUBLIC_KEY_SIZE], signature[ED25519_SIGNATURE_SIZE], digest[SHA256_DIGEST_SIZE];
+	const int verifies = 50, hashes = 64;
+	bool ok = true;
+
+	TestMessage(32);
+	Hex(publicKey, ed25519Vectors[2].publicKey);
+	Hex(signature, ed25519Vectors[2].signature);
+	double t0 = TestSeconds();
+	for(int i = 0; i < verifies; i++) ok &= Ed25519Verify(signature, message, 32, publicKey);
+	double verify = (TestSeconds() - t0) / verifies;
+	TEST_CHECK(ok);
+
+	for(size_t i = 0; i < sizeof(image); i++) image[i] = (uint8_t)TestRandom();
+	t0 = TestSeconds();
+	for(int i = 0; i < hashes; i++) Sha256(image, sizeof(image), digest);
+	double hash = (TestSeconds() - t0) / hashes;
+
+	printf("bench: Ed25519Verify %.0f us, SHA-256 %.1f MB/s (host)\n", verify * 1e6, sizeof(image) / hash / 1e6);
+}
+
+int main(void)
+{
+	TestEd25519();
+	TestBadKeys();
+	TestSha256();
+
+	Bench();
+	return TEST_RESULT();
+}
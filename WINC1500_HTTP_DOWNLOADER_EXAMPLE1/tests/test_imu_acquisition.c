@@ -0,0 +1,302 @@
+/**************************************************************************//**
+* @file      test_imu_acquisition.c
+* @brief     Host tests for ImuAcquisition.c on the LSM6DS3 FIFO model of host_lsm6ds3.c.
+The acquisition task runs as the single host task, through lsm6ds_reg.c and I2cDriver.c on the simulated bus. While it
+waits, the sensor samples at 416 Hz and INT1 calls the EXTINT callback. Every sample must reach the consumer once, in
+order and with its values, in full blocks; the FIFO must never overrun. This is checked with a fast consumer, with a
+slow one that leaves the FIFO above the watermark when the drain ends (INT1 stays high then: an edge would not come
+again and only the poll would drain the FIFO), and with INT1 not wired. A read pointer left inside a sample must be
+realigned, and a stall longer than the FIFO holds must be flagged on the next block.
+A run ends from the consumer once its time is over, while no bus request is in progress. The benchmark gives the bus
+load, the task wake-ups per second and the latency from the last sample of a block to its consumer, with INT1 and polled.
+
+******************************************************************************/
+
+#include "test.h"
+#include <setjmp.h>
+#include "host_lsm6ds3.h"
+#include "I2cDriver/I2cDriver.h"
+#include "IMU/ImuAcquisition.h"
+
+#define SLOW_CONSUMER_MS	25		///<Time the slow consumer takes per block: with the bus, most of a block period
+#define SLOW_BURST_MS		80		///<Time it takes for every SLOW_BURST_EVERY-th block: two block periods
+#define SLOW_BURST_EVERY	10
+#define STALL_MS			2000	///<Longer than the FIFO holds at 416 Hz: 4096 words are 682 samples, 1.64 s
+
+//What the consumer saw during a run
+static struct
+{
+	uint64_t stopNs;			///<Time after which the run ends
+	uint32_t consumerMs;		///<Time the consumer takes per block
+	uint32_t burstMs;			///<Time it takes for every SLOW_BURST_EVERY-th block, 0 for none
+	uint32_t stallAtBlock;		///<Block after which the consumer stalls for STALL_MS, 0 for none
+	uint32_t dropAtBlock;		///<Block after which two FIFO words are popped, 0 for none
+	uint32_t blocks;
+	uint32_t samples;
+	uint32_t fullBlocks;		///<Blocks of IMU_ACQ_BLOCK_SAMPLES samples
+	uint32_t overrunBlocks;		///<Blocks flagged IMU_BLOCK_FLAG_OVERRUN
+	uint32_t next;				///<Sample number the next sample must carry
+	uint32_t skipped;			///<Samples skipped without the overrun flag
+	uint32_t lost;				///<Samples skipped before blocks flagged overrun
+	uint32_t badValues;			///<Samples whose values do not match their number
+	uint32_t badSequences;		///<Blocks whose sequence does not follow the one before
+	uint32_t badTicks;			///<Blocks stamped more than 2 ms from their last sample
+	uint32_t nextSequence;		///<Sequence the next block must carry
+	uint32_t firstStarts;		///<START conditions on the bus when the first block came
+	uint32_t lastStarts;		///<START conditions on the bus when the last block came
+	uint64_t latencyNs;			///<Sum of the times from the last sample of a block to its consumer
+	uint64_t maxLatencyNs;
+} run;
+
+static jmp_buf runEnd;
+
+void SerialConsoleWriteString(char *string)
+{
+	(void)string;
+}
+
+/**************************************************************************//**
+* @fn		static void Consumer(const ImuBlock *block)
+* @brief	Checks each sample against the one the sensor took, and the block stamps
+*****************************************************************************/
+static void Consumer(const ImuBlock *block)
+{
+	uint64_t nowNs = HostI2cBusNowNs();
+
+	for(uint8_t i = 0; i < block->count; i++)
+	{
+		const ImuSample *sample = &block->sample[i];
+		uint32_t number = (uint16_t)sample->gyro[0] | ((uint32_t)(uint16_t)sample->gyro[1] << 16);
+		int16_t words[6];
+
+		HostLsm6ds3SampleWords(number, words);
+		if(memcmp(sample->gyro, &words[0], sizeof(sample->gyro)) != 0 || memcmp(sample->accel, &words[3], sizeof(sample->accel)) != 0)
+		{
+			run.badValues++;
+		}
+		if(number != run.next)
+		{
+			if(i == 0 && (block->flags & IMU_BLOCK_FLAG_OVERRUN) && number > run.next) run.lost += number - run.next;
+			else if(number > run.next) run.skipped += number - run.next;
+			else run.badValues++;
+		}
+		run.next = number + 1;
+	}
+
+	uint64_t lastNs = HostLsm6ds3SampleNs(run.next - 1);
+	uint64_t latencyNs = nowNs - lastNs;
+	int64_t stampErrorNs = (int64_t)block->tick * 1000000LL - (int64_t)lastNs;
+
+	if(run.blocks > 0 && block->sequence != run.nextSequence) run.badSequences++;
+	if(run.blocks == 0) run.firstStarts = HostI2cBusGetStats()->starts;
+	run.lastStarts = HostI2cBusGetStats()->starts;
+	if(stampErrorNs > 2000000 || stampErrorNs < -2000000) run.badTicks++;
+	run.nextSequence = block->sequence + block->count;
+	run.latencyNs += latencyNs;
+	if(latencyNs > run.maxLatencyNs) run.maxLatencyNs = latencyNs;
+	run.blocks++;
+	run.samples += block->count;
+	if(block->count == IMU_ACQ_BLOCK_SAMPLES) run.fullBlocks++;
+	if(block->flags & IMU_BLOCK_FLAG_OVERRUN) run.overrunBlocks++;
+
+	if(run.dropAtBlock != 0 && run.blocks == run.dropAtBlock) HostLsm6ds3DropWords(2);
+	if(run.stallAtBlock != 0 && run.blocks == run.stallAtBlock) vTaskDelay(STALL_MS);
+	if(run.burstMs != 0 && run.blocks % SLOW_BURST_EVERY == 0) vTaskDelay(run.burstMs);
+	else if(run.consumerMs != 0) vTaskDelay(run.consumerMs);
+
+	//The drain that called us has no bus request in progress
+	if(HostI2cBusNowNs() >= run.stopNs) longjmp(runEnd, 1);
+}
+
+/**************************************************************************//**
+* @fn		static void Run(uint32_t ms, ImuAcqStats *stats)
+* @brief	Runs the acquisition task from its start for ms of simulated time
+* @param[out]	stats What the task counted during the run
+*****************************************************************************/
+static void Run(uint32_t ms, ImuAcqStats *stats)
+{
+	ImuAcqStats before, after;
+
+	ImuAcquisitionGetStats(&before);
+	run.stopNs = HostI2cBusNowNs() + ms * 1000000ULL;
+	if(setjmp(runEnd) == 0) vImuAcquisitionTask(NULL);
+	ImuAcquisitionGetStats(&after);
+
+	stats->blocks = after.blocks - before.blocks;
+	stats->samples = after.samples - before.samples;
+	stats->overruns = after.overruns - before.overruns;
+	stats->realigns = after.realigns - before.realigns;
+	stats->busErrors = after.busErrors - before.busErrors;
+	stats->polls = after.polls - before.polls;
+}
+
+static void Setup(void)
+{
+	memset(&run, 0, sizeof(run));
+	HostI2cBusReset();
+	HostLsm6ds3Attach();
+	//No notification left from the run before
+	xTaskNotifyWait(0, 0xFFFFFFFFUL, NULL, 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestWatermark(void)
+* @brief	INT1 at the watermark: one interrupt and two bus transactions per full block, each sample once
+*****************************************************************************/
+static void TestWatermark(void)
+{
+	ImuAcqStats stats;
+	Setup();
+	Run(10000, &stats);
+
+	TEST_CHECK(run.blocks >= 10 * IMU_ACQ_ODR_HZ / IMU_ACQ_BLOCK_SAMPLES - 1);
+	TEST_CHECK_EQ(run.fullBlocks, run.blocks);
+	TEST_CHECK_EQ(run.samples, stats.samples);
+	TEST_CHECK_EQ(run.skipped, 0);
+	TEST_CHECK_EQ(run.lost, 0);
+	TEST_CHECK_EQ(run.badValues, 0);
+	TEST_CHECK_EQ(run.badSequences, 0);
+	TEST_CHECK_EQ(run.badTicks, 0);
+	TEST_CHECK_EQ(stats.polls, 0);
+	TEST_CHECK_EQ(stats.overruns, 0);
+	TEST_CHECK_EQ(stats.realigns, 0);
+	TEST_CHECK_EQ(stats.busErrors, 0);
+	TEST_CHECK_EQ(HostLsm6ds3GetStats()->interrupts, run.blocks);
+	TEST_CHECK_EQ(run.lastStarts - run.firstStarts, 2 * (run.blocks - 1));
+	TEST_CHECK(run.maxLatencyNs < 10000000ULL);
+	TEST_CHECK(HostLsm6ds3GetStats()->maxLevel < 2 * IMU_ACQ_BLOCK_SAMPLES * IMU_ACQ_WORDS_PER_SAMPLE);
+}
+
+/**************************************************************************//**
+* @fn		static void TestSlowConsumer(void)
+* @brief	A consumer that takes most of a block period, and at times two, leaves the FIFO above the watermark when
+*			the drain ends. INT1 stays high: unmasking it must wake the task again at once, not the poll.
+*****************************************************************************/
+static void TestSlowConsumer(void)
+{
+	ImuAcqStats stats;
+
+	Setup();
+	run.consumerMs = SLOW_CONSUMER_MS;
+	run.burstMs = SLOW_BURST_MS;
+	Run(20000, &stats);
+
+	TEST_CHECK(run.blocks > 400);
+	TEST_CHECK_EQ(run.fullBlocks, run.blocks);
+	TEST_CHECK_EQ(run.skipped, 0);
+	TEST_CHECK_EQ(run.lost, 0);
+	TEST_CHECK_EQ(run.badValues, 0);
+	TEST_CHECK_EQ(run.badSequences, 0);
+	TEST_CHECK_EQ(stats.polls, 0);
+	TEST_CHECK_EQ(stats.overruns, 0);
+	//Some drains ended at or above the watermark
+	TEST_CHECK(HostLsm6ds3GetStats()->interrupts < run.blocks);
+	TEST_CHECK(HostLsm6ds3GetStats()->maxLevel < HOST_LSM6DS3_FIFO_WORDS / 4);
+	//The samples that came during a slow block wait for the next one only
+	TEST_CHECK(run.maxLatencyNs < (SLOW_BURST_MS + 2 * SLOW_CONSUMER_MS) * 1000000ULL);
+}
+
+/**************************************************************************//**
+* @fn		static void TestUnwired(void)
+* @brief	Without INT1 the poll drains the FIFO and nothing is lost
+*****************************************************************************/
+static void TestUnwired(void)
+{
+	ImuAcqStats stats;
+
+	Setup();
+	HostLsm6ds3ConnectInt1(false);
+	Run(5000, &stats);
+
+	//A poll period is the timeout plus the drain
+	TEST_CHECK(stats.polls >= 5000 / (IMU_ACQ_POLL_MS + IMU_ACQ_POLL_MS / 4));
+	TEST_CHECK(run.samples >= (5000 - 2 * IMU_ACQ_POLL_MS) * IMU_ACQ_ODR_HZ / 1000);
+	TEST_CHECK_EQ(run.skipped, 0);
+	TEST_CHECK_EQ(run.lost, 0);
+	TEST_CHECK_EQ(run.badValues, 0);
+	TEST_CHECK_EQ(run.badSequences, 0);
+	TEST_CHECK_EQ(stats.overruns, 0);
+	TEST_CHECK_EQ(HostLsm6ds3GetStats()->interrupts, 0);
+	TEST_CHECK(run.maxLatencyNs < (IMU_ACQ_POLL_MS + 10) * 1000000ULL);
+}
+
+/**************************************************************************//**
+* @fn		static void TestRealign(void)
+* @brief	Two words popped behind the task's back: the rest of that sample is skipped, the next ones are whole
+*****************************************************************************/
+static void TestRealign(void)
+{
+	ImuAcqStats stats;
+
+	Setup();
+	run.dropAtBlock = 20;
+	Run(3000, &stats);
+
+	TEST_CHECK_EQ(stats.realigns, 1);
+	TEST_CHECK_EQ(run.skipped, 1);
+	TEST_CHECK_EQ(run.lost, 0);
+	TEST_CHECK_EQ(run.badValues, 0);
+	TEST_CHECK_EQ(stats.overruns, 0);
+	TEST_CHECK_EQ(stats.polls, 0);
+	TEST_CHECK(run.blocks > 60);
+}
+
+/**************************************************************************//**
+* @fn		static void TestOverrun(void)
+* @brief	A stall longer than the FIFO holds: the next block is flagged and counts the loss, the ones after are whole
+*****************************************************************************/
+static void TestOverrun(void)
+{
+	ImuAcqStats stats;
+
+	Setup();
+	run.stallAtBlock = 10;
+	Run(5000, &stats);
+
+	TEST_CHECK_EQ(stats.overruns, 1);
+	TEST_CHECK_EQ(run.overrunBlocks, 1);
+	TEST_CHECK(run.lost > 0);
+	TEST_CHECK_EQ(run.lost, HostLsm6ds3GetStats()->overwritten);
+	TEST_CHECK_EQ(run.skipped, 0);
+	TEST_CHECK_EQ(run.badValues, 0);
+	TEST_CHECK_EQ(stats.polls, 0);
+	//The backlog is drained without waiting for the poll, then acquisition carries on
+	TEST_CHECK_EQ(run.fullBlocks, run.blocks);
+	TEST_CHECK(run.samples + run.lost + 2 * IMU_ACQ_BLOCK_SAMPLES >= 5000 * IMU_ACQ_ODR_HZ / 1000);
+}
+
+static void BenchRun(const char *name, bool int1)
+{
+	ImuAcqStats stats;
+	const uint32_t ms = 20000;
+	uint64_t busyNs;
+	uint32_t wakeups = hostNotifyFromIsrCount, bytes;
+
+	Setup();
+	HostLsm6ds3ConnectInt1(int1);
+	Run(ms, &stats);
+	busyNs = HostI2cBusGetStats()->busyNs;
+	bytes = HostI2cBusGetStats()->bytes;
+	printf("bench: %s: %.1f bus bytes per sample, bus %.1f%% busy at %lu kHz, %.1f task wake-ups per s, latency %.2f ms mean, %.2f ms max\n",
+		name, (double)bytes / run.samples, busyNs * 100.0 / (ms * 1e6), (unsigned long)HostI2cBusSclKhz(),
+		(double)(hostNotifyFromIsrCount - wakeups + stats.polls) * 1000.0 / ms, run.latencyNs / 1e6 / run.blocks,
+		run.maxLatencyNs / 1e6);
+}
+
+int main(void)
+{
+	TEST_CHECK_EQ(I2cInitializeDriver(), STATUS_OK);
+	HostRtosSetWait(HostLsm6ds3Wait);
+	TEST_CHECK_EQ(ImuAcquisitionRegisterConsumer(NULL), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(ImuAcquisitionRegisterConsumer(Consumer), ERROR_NONE);
+
+	TestWatermark();
+	TestSlowConsumer();
+	TestUnwired();
+	TestRealign();
+	TestOverrun();
+
+	BenchRun("416 Hz on INT1", true);
+	BenchRun("416 Hz polled", false);
+	return TEST_RESULT();
+}
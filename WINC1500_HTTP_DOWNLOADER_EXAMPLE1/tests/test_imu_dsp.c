@@ -0,0 +1,369 @@
+/**************************************************************************//**
+* @file      test_imu_dsp.c
+* @brief     Host tests for ImuFixed and ImuDsp against a floating point reference: every raw value at every full
+*			scale, the window features of constant, sine and full-scale noise inputs, the window timestamps and the
+*			restart after an overrun. The benchmark gives the cost per sample of the fixed-point and float versions;
+*			on the host both run on an FPU, whereas the Cortex-M0+ goes through the soft-float library.
+
+******************************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+#include "test.h"
+#include "IMU/ImuFixed.h"
+#include "IMU/ImuDsp.h"
+#include "I2cDriver/I2cDriver.h"
+#include "WifiHandlerThread/WifiHandler.h"
+
+#define MAX_WINDOWS		64		///<Windows recorded per run
+#define BENCH_BLOCKS	20000	///<Blocks processed by the benchmark
+
+/******************************************************************************
+* Stand-ins for the acquisition and the Wifi task
+******************************************************************************/
+static ImuBlockConsumer consumer;				///<Consumer registered by ImuDspInit()
+static ImuFeatures windows[MAX_WINDOWS];		///<Features of every window completed, as read back when published
+static struct ImuDataPacket packets[MAX_WINDOWS];	///<Packets sent to the Wifi task
+static unsigned windowCount;					///<Windows recorded
+
+int32_t ImuAcquisitionRegisterConsumer(ImuBlockConsumer newConsumer)
+{
+	consumer = newConsumer;
+	return ERROR_NONE;
+}
+
+int WifiAddImuDataToQueue(struct ImuDataPacket *imuPacket)
+{
+	if(windowCount < MAX_WINDOWS)
+	{
+		TEST_CHECK(ImuDspGetFeatures(&windows[windowCount]));
+		packets[windowCount++] = *imuPacket;
+	}
+	return pdTRUE;
+}
+
+/******************************************************************************
+* Float reference
+******************************************************************************/
+
+///Sensitivities of the LSM6DS3 float converters (lsm6ds3_from_fs2g_to_mg() and friends)
+static const struct { lsm6ds3_xl_fs_t fs; double mgPerLsb; } accelScales[] = {
+	{LSM6DS3_2g, 0.061}, {LSM6DS3_4g, 0.122}, {LSM6DS3_8g, 0.244}, {LSM6DS3_16g, 0.488}};
+static const struct { lsm6ds3_fs_g_t fs; double mdpsPerLsb; } gyroScales[] = {
+	{LSM6DS3_125dps, 4.375}, {LSM6DS3_250dps, 8.75}, {LSM6DS3_500dps, 17.5}, {LSM6DS3_1000dps, 35.0}, {LSM6DS3_2000dps, 70.0}};
+
+//Float model of the ImuDsp window of one axis
+typedef struct RefAxis
+{
+	double lowPass;
+	double sumSquares;
+	double peak;
+} RefAxis;
+
+typedef struct RefDsp
+{
+	RefAxis axis[3];
+	unsigned count;
+	bool primed;
+	unsigned windows;
+	ImuFeatures features[MAX_WINDOWS];
+} RefDsp;
+
+static double RefMgPerLsb(void)
+{
+	for(unsigned i = 0; i < sizeof(accelScales) / sizeof(accelScales[0]); i++)
+	{
+		if(accelScales[i].fs == IMU_ACQ_XL_FS) return accelScales[i].mgPerLsb;
+	}
+	return 0;
+}
+
+/**************************************************************************//**
+* @fn		static void RefFeed(RefDsp *ref, const int16_t accel[3], bool restart)
+* @brief	Runs one sample through the float model. The high-pass magnitude saturates at full scale like ImuDsp.
+*****************************************************************************/
+static void RefFeed(RefDsp *ref, const int16_t accel[3], bool restart)
+{
+	const double scale = RefMgPerLsb();
+
+	if(restart) ref->primed = false;
+	if(!ref->primed)
+	{
+		for(int a = 0; a < 3; a++)
+		{
+			ref->axis[a].lowPass = accel[a];
+			ref->axis[a].sumSquares = 0;
+			ref->axis[a].peak = 0;
+		}
+		ref->count = 0;
+		ref->primed = true;
+	}
+
+	for(int a = 0; a < 3; a++)
+	{
+		RefAxis *s = &ref->axis[a];
+		double highPass;
+
+		s->lowPass += (accel[a] - s->lowPass) / (1 << IMU_DSP_LPF_SHIFT);
+		highPass = fabs(accel[a] - s->lowPass);
+		if(highPass > INT16_MAX) highPass = INT16_MAX;
+		s->sumSquares += highPass * highPass;
+		if(highPass > s->peak) s->peak = highPass;
+	}
+
+	if(++ref->count >= IMU_DSP_WINDOW_SAMPLES)
+	{
+		ImuFeatures *f = &ref->features[ref->windows++];
+		for(int a = 0; a < 3; a++)
+		{
+			RefAxis *s = &ref->axis[a];
+			f->lowPassMg[a] = (int16_t)lround(s->lowPass * scale);
+			f->rmsMg[a] = (int16_t)lround(sqrt(s->sumSquares / ref->count) * scale);
+			f->peakMg[a] = (int16_t)lround(s->peak * scale);
+			s->sumSquares = 0;
+			s->peak = 0;
+		}
+		ref->count = 0;
+	}
+}
+
+/******************************************************************************
+* Helpers
+******************************************************************************/
+
+typedef int16_t (*SignalFn)(unsigned n, int axis);
+
+/**************************************************************************//**
+* @fn		static void Run(SignalFn signal, unsigned samples, unsigned overrunAt, RefDsp *ref)
+* @brief	Feeds a signal to ImuDsp in acquisition-sized blocks and to the float model sample by sample
+* @details	The first block is flagged as overrun too, which drops the state left by the previous run.
+* @param[in]	overrunAt Index of the block flagged as overrun
+*****************************************************************************/
+static void Run(SignalFn signal, unsigned samples, unsigned overrunAt, RefDsp *ref)
+{
+	ImuBlock block;
+	unsigned n = 0;
+
+	memset(ref, 0, sizeof(*ref));
+	windowCount = 0;
+	for(unsigned b = 0; n < samples; b++)
+	{
+		block.count = (samples - n < IMU_ACQ_BLOCK_SAMPLES) ? (uint8_t)(samples - n) : IMU_ACQ_BLOCK_SAMPLES;
+		block.flags = (b == 0 || b == overrunAt) ? IMU_BLOCK_FLAG_OVERRUN : 0;
+		block.periodUs = IMU_ACQ_SAMPLE_PERIOD_US;
+		block.sequence = n;
+		block.tick = 1000 + ((n + block.count - 1) * IMU_ACQ_SAMPLE_PERIOD_US) / 1000;
+		for(unsigned i = 0; i < block.count; i++, n++)
+		{
+			for(int a = 0; a < 3; a++)
+			{
+				block.sample[i].accel[a] = signal(n, a);
+				block.sample[i].gyro[a] = 0;
+			}
+			RefFeed(ref, block.sample[i].accel, block.flags != 0 && i == 0);
+		}
+		consumer(&block);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void CheckAgainstReference(const RefDsp *ref, int tolerance)
+* @brief	Checks every window against the float model, within tolerance mg
+*****************************************************************************/
+static void CheckAgainstReference(const RefDsp *ref, int tolerance)
+{
+	TEST_CHECK_EQ(windowCount, ref->windows);
+	for(unsigned w = 0; w < windowCount && w < ref->windows; w++)
+	{
+		for(int a = 0; a < 3; a++)
+		{
+			TEST_CHECK(abs(windows[w].lowPassMg[a] - ref->features[w].lowPassMg[a]) <= tolerance);
+			TEST_CHECK(abs(windows[w].rmsMg[a] - ref->features[w].rmsMg[a]) <= tolerance);
+			TEST_CHECK(abs(windows[w].peakMg[a] - ref->features[w].peakMg[a]) <= tolerance);
+		}
+		TEST_CHECK_EQ(packets[w].xmg, windows[w].lowPassMg[0]);
+		TEST_CHECK_EQ(packets[w].ymg, windows[w].lowPassMg[1]);
+		TEST_CHECK_EQ(packets[w].zmg, windows[w].lowPassMg[2]);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t SampleTick(unsigned n)
+* @brief	Tick of sample n of a run: the tick of its full block, less the samples that follow it in the block
+*****************************************************************************/
+static uint32_t SampleTick(unsigned n)
+{
+	unsigned blockLast = (n / IMU_ACQ_BLOCK_SAMPLES) * IMU_ACQ_BLOCK_SAMPLES + IMU_ACQ_BLOCK_SAMPLES - 1;
+	uint32_t blockTick = 1000 + (blockLast * IMU_ACQ_SAMPLE_PERIOD_US) / 1000;
+	return blockTick - ((blockLast - n) * IMU_ACQ_SAMPLE_PERIOD_US) / 1000;
+}
+
+static int16_t SignalConstant(unsigned n, int axis)
+{
+	(void)n;
+	return (int16_t)((axis == 2) ? 16393 : -1200 * (axis + 1));	//1 g on Z at 2 g full scale
+}
+
+static int16_t SignalSine(unsigned n, int axis)
+{
+	double t = (double)n / IMU_ACQ_ODR_HZ;
+	double noise = (double)(TestRandom() % 201) - 100;
+	return (int16_t)lround(3000.0 * axis + 2500.0 * sin(2 * M_PI * (5.0 + axis) * t) + noise);
+}
+
+static int16_t SignalNoise(unsigned n, int axis)
+{
+	(void)n;
+	(void)axis;
+	return (int16_t)TestRandom();
+}
+
+/******************************************************************************
+* Tests
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void TestFixedScales(void)
+* @brief	Every raw value at every full scale: accelerometer within 1 mg of the float converter, gyroscope equal
+*			to the float converter rounded to the nearest mdps
+*****************************************************************************/
+static void TestFixedScales(void)
+{
+	for(unsigned s = 0; s < sizeof(accelScales) / sizeof(accelScales[0]); s++)
+	{
+		const ImuFixedScale *scale = ImuFixedGetAccelScale(accelScales[s].fs);
+		double worst = 0;
+		for(int32_t raw = INT16_MIN; raw <= INT16_MAX; raw++)
+		{
+			double error = fabs(ImuFixedConvert(raw, scale) - raw * accelScales[s].mgPerLsb);
+			if(error > worst) worst = error;
+		}
+		TEST_CHECK(worst < 1.0);
+	}
+
+	for(unsigned s = 0; s < sizeof(gyroScales) / sizeof(gyroScales[0]); s++)
+	{
+		const ImuFixedScale *scale = ImuFixedGetGyroScale(gyroScales[s].fs);
+		unsigned mismatches = 0;
+		for(int32_t raw = INT16_MIN; raw <= INT16_MAX; raw++)
+		{
+			if(ImuFixedConvert(raw, scale) != (int32_t)floor(raw * gyroScales[s].mdpsPerLsb + 0.5)) mismatches++;
+		}
+		TEST_CHECK_EQ(mismatches, 0);
+	}
+
+	//Values wider than a sample, e.g. sums over a window
+	TEST_CHECK_EQ(ImuFixedConvert(1000000, ImuFixedGetAccelScale(LSM6DS3_2g)), 61005);
+}
+
+/**************************************************************************//**
+* @fn		static void TestWindows(void)
+* @brief	Window features within 1 mg of the float model for constant, sine and full-scale noise inputs
+*****************************************************************************/
+static void TestWindows(void)
+{
+	static RefDsp ref;
+
+	Run(SignalConstant, IMU_DSP_WINDOW_SAMPLES * 3, 0, &ref);
+	CheckAgainstReference(&ref, 1);
+	TEST_CHECK_EQ(windows[2].lowPassMg[2], 1000);
+	TEST_CHECK_EQ(windows[2].rmsMg[2], 0);
+	TEST_CHECK_EQ(windows[2].peakMg[0], 0);
+
+	Run(SignalSine, IMU_DSP_WINDOW_SAMPLES * 20, 0, &ref);
+	CheckAgainstReference(&ref, 1);
+
+	Run(SignalNoise, IMU_DSP_WINDOW_SAMPLES * 20, 0, &ref);
+	CheckAgainstReference(&ref, 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestWindowTiming(void)
+* @brief	A window ends in the middle of a block: its tick is the tick of its last sample, not of the block
+*****************************************************************************/
+static void TestWindowTiming(void)
+{
+	static RefDsp ref;
+	ImuDspStats stats;
+	uint32_t before;
+
+	ImuDspGetStats(&stats);
+	before = stats.windows;
+	Run(SignalConstant, IMU_DSP_WINDOW_SAMPLES * 2 + 5, 0, &ref);
+	ImuDspGetStats(&stats);
+	TEST_CHECK_EQ(stats.windows - before, 2);
+	TEST_CHECK_EQ(windowCount, 2);
+	for(unsigned w = 0; w < windowCount; w++)
+	{
+		TEST_CHECK_EQ(windows[w].tick, SampleTick(IMU_DSP_WINDOW_SAMPLES * (w + 1) - 1));
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestOverrunRestart(void)
+* @brief	A block flagged as overrun drops the partial window and reseeds the low-pass filter
+*****************************************************************************/
+static void TestOverrunRestart(void)
+{
+	static RefDsp ref;
+	const unsigned overrunBlock = 3;
+
+	//The first window would end in block 6; the overrun in block 3 pushes it to sample 3 * 16 + 104
+	Run(SignalSine, overrunBlock * IMU_ACQ_BLOCK_SAMPLES + IMU_DSP_WINDOW_SAMPLES * 2, overrunBlock, &ref);
+	TEST_CHECK_EQ(windowCount, 2);
+	CheckAgainstReference(&ref, 1);
+	TEST_CHECK_EQ(windows[0].tick, SampleTick(overrunBlock * IMU_ACQ_BLOCK_SAMPLES + IMU_DSP_WINDOW_SAMPLES - 1));
+}
+
+/**************************************************************************//**
+* @fn		static void Benchmark(void)
+* @brief	Cost per sample of ImuDsp and of the float model on the host
+*****************************************************************************/
+static void Benchmark(void)
+{
+	static RefDsp ref;
+	ImuBlock block;
+	double start;
+
+	block.count = IMU_ACQ_BLOCK_SAMPLES;
+	block.flags = 0;
+	block.periodUs = IMU_ACQ_SAMPLE_PERIOD_US;
+	block.tick = 0;
+	for(unsigned i = 0; i < IMU_ACQ_BLOCK_SAMPLES; i++)
+	{
+		for(int a = 0; a < 3; a++) block.sample[i].accel[a] = SignalSine(i, a);
+	}
+
+	start = TestSeconds();
+	for(unsigned b = 0; b < BENCH_BLOCKS; b++)
+	{
+		windowCount = 0;
+		consumer(&block);
+	}
+	printf("bench: ImuDsp fixed point %.1f ns per sample\n",
+		   (TestSeconds() - start) * 1e9 / (BENCH_BLOCKS * IMU_ACQ_BLOCK_SAMPLES));
+
+	memset(&ref, 0, sizeof(ref));
+	start = TestSeconds();
+	for(unsigned b = 0; b < BENCH_BLOCKS; b++)
+	{
+		ref.windows = 0;
+		for(unsigned i = 0; i < IMU_ACQ_BLOCK_SAMPLES; i++) RefFeed(&ref, block.sample[i].accel, false);
+	}
+	printf("bench: float reference    %.1f ns per sample\n",
+		   (TestSeconds() - start) * 1e9 / (BENCH_BLOCKS * IMU_ACQ_BLOCK_SAMPLES));
+}
+
+int main(void)
+{
+	TEST_CHECK_EQ(ImuDspInit(), ERROR_NONE);
+	TEST_CHECK(consumer != NULL);
+	if(consumer == NULL) return TEST_RESULT();
+
+	TestFixedScales();
+	TestWindows();
+	TestWindowTiming();
+	TestOverrunRestart();
+	Benchmark();
+	return TEST_RESULT();
+}
@@ -0,0 +1,274 @@
+/**************************************************************************//**
+* @file      test_mem_pool.c
+* @brief     Host tests for MemPool: exhaustion, reuse through the free list, high water marks, blocks that are
+*			foreign, misaligned or already free, the registry, and random traffic checked against a model.
+The benchmark compares an allocation and free pair with malloc and free.
+
+******************************************************************************/
+
+#include <stdlib.h>
+#include "test.h"
+#include "MemPool/MemPool.h"
+#include "I2cDriver/I2cDriver.h"
+
+#define SMALL_BLOCKS	5		///<Blocks of the small pool
+#define SMALL_SIZE		10		///<Bytes asked for per small block, rounded up to 12
+#define STRESS_BLOCKS	40		///<Blocks of the stress pool. More than 32, so the bitmap spans two words
+#define STRESS_OPS		200000	///<Random operations of the stress test
+#define BENCH_PAIRS		2000000	///<Allocation and free pairs timed by the benchmark
+
+MEM_POOL_DEFINE(smallPool, "small", SMALL_SIZE, SMALL_BLOCKS);
+MEM_POOL_DEFINE(otherPool, "other", SMALL_SIZE, SMALL_BLOCKS);
+MEM_POOL_DEFINE(stressPool, "stress", 24, STRESS_BLOCKS);
+MEM_POOL_DEFINE(benchPool, "bench", 64, 8);
+
+/**************************************************************************//**
+* @fn		static void TestExhaustion(void)
+* @brief	Every block can be taken once, word aligned and inside the storage; then allocations fail and are counted
+*****************************************************************************/
+static void TestExhaustion(void)
+{
+	void *blocks[SMALL_BLOCKS];
+
+	TEST_CHECK_EQ(smallPool.blockSize, 12);
+	for(int i = 0; i < SMALL_BLOCKS; i++)
+	{
+		blocks[i] = MemPoolAlloc(&smallPool);
+		TEST_CHECK(blocks[i] != NULL);
+		TEST_CHECK(((uintptr_t)blocks[i] % sizeof(uint32_t)) == 0);
+		TEST_CHECK((uint8_t *)blocks[i] >= (uint8_t *)smallPoolStorage);
+		TEST_CHECK((uint8_t *)blocks[i] + smallPool.blockSize <= (uint8_t *)smallPoolStorage + sizeof(smallPoolStorage));
+		for(int j = 0; j < i; j++) TEST_CHECK(blocks[i] != blocks[j]);
+		memset(blocks[i], 0xA5, SMALL_SIZE);
+	}
+
+	TEST_CHECK(MemPoolAlloc(&smallPool) == NULL);
+	TEST_CHECK(MemPoolAlloc(&smallPool) == NULL);
+	TEST_CHECK_EQ(smallPool.failures, 2);
+	TEST_CHECK_EQ(smallPool.inUse, SMALL_BLOCKS);
+	TEST_CHECK_EQ(smallPool.highWater, SMALL_BLOCKS);
+
+	for(int i = 0; i < SMALL_BLOCKS; i++) TEST_CHECK_EQ(MemPoolFree(&smallPool, blocks[i]), ERROR_NONE);
+	TEST_CHECK_EQ(smallPool.inUse, 0);
+	TEST_CHECK_EQ(smallPool.highWater, SMALL_BLOCKS);
+}
+
+/**************************************************************************//**
+* @fn		static void TestFreeListReuse(void)
+* @brief	Freed blocks come back last in, first out, and the pool stops taking never used blocks once it has some
+*****************************************************************************/
+static void TestFreeListReuse(void)
+{
+	void *a = MemPoolAlloc(&otherPool);
+	void *b = MemPoolAlloc(&otherPool);
+	void *c = MemPoolAlloc(&otherPool);
+
+	TEST_CHECK_EQ(otherPool.untouched, 3);
+	TEST_CHECK_EQ(MemPoolFree(&otherPool, b), ERROR_NONE);
+	TEST_CHECK_EQ(MemPoolFree(&otherPool, a), ERROR_NONE);
+	TEST_CHECK(MemPoolAlloc(&otherPool) == a);
+	TEST_CHECK(MemPoolAlloc(&otherPool) == b);
+	TEST_CHECK_EQ(otherPool.untouched, 3);
+	TEST_CHECK((uint8_t *)MemPoolAlloc(&otherPool) == (uint8_t *)c + otherPool.blockSize);
+	TEST_CHECK_EQ(otherPool.untouched, 4);
+
+	TEST_CHECK_EQ(MemPoolFree(&otherPool, a), ERROR_NONE);
+	TEST_CHECK_EQ(MemPoolFree(&otherPool, b), ERROR_NONE);
+	TEST_CHECK_EQ(MemPoolFree(&otherPool, c), ERROR_NONE);
+	TEST_CHECK_EQ(MemPoolFree(&otherPool, (uint8_t *)c + otherPool.blockSize), ERROR_NONE);
+	TEST_CHECK_EQ(otherPool.inUse, 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestHighWater(void)
+* @brief	The high water mark follows the most blocks out at once, not the number of allocations
+*****************************************************************************/
+static void TestHighWater(void)
+{
+	MEM_POOL_DEFINE(pool, "water", 8, 4);
+	void *a, *b, *c;
+
+	for(int i = 0; i < 10; i++)
+	{
+		a = MemPoolAlloc(&pool);
+		TEST_CHECK_EQ(MemPoolFree(&pool, a), ERROR_NONE);
+	}
+	TEST_CHECK_EQ(pool.highWater, 1);
+
+	a = MemPoolAlloc(&pool);
+	b = MemPoolAlloc(&pool);
+	c = MemPoolAlloc(&pool);
+	MemPoolFree(&pool, b);
+	MemPoolFree(&pool, a);
+	b = MemPoolAlloc(&pool);
+	TEST_CHECK_EQ(pool.inUse, 2);
+	TEST_CHECK_EQ(pool.highWater, 3);
+	TEST_CHECK_EQ(pool.failures, 0);
+	MemPoolFree(&pool, b);
+	MemPoolFree(&pool, c);
+}
+
+/**************************************************************************//**
+* @fn		static void TestRejectedFrees(void)
+* @brief	Blocks of another pool, pointers inside or outside a block, blocks never handed out and blocks already
+*			free are refused and leave the pool untouched; NULL is accepted
+*****************************************************************************/
+static void TestRejectedFrees(void)
+{
+	uint32_t local[4];
+	void *mine = MemPoolAlloc(&smallPool);
+	void *foreign = MemPoolAlloc(&otherPool);
+	void *again[SMALL_BLOCKS];
+
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, foreign), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, local), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, (uint8_t *)mine + 1), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, (uint8_t *)mine + sizeof(uint32_t)), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, (uint8_t *)smallPoolStorage - smallPool.blockSize), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, (uint8_t *)smallPoolStorage + sizeof(smallPoolStorage)), ERROR_INVALID_ARG);
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, NULL), ERROR_NONE);
+	TEST_CHECK_EQ(smallPool.inUse, 1);
+
+	//Every block was handed out by TestExhaustion and is free now, except mine
+	for(int i = 0; i < SMALL_BLOCKS; i++)
+	{
+		void *block = (uint8_t *)smallPoolStorage + i * smallPool.blockSize;
+		if(block != mine) TEST_CHECK_EQ(MemPoolFree(&smallPool, block), ERROR_NO_CHANGE);
+	}
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, mine), ERROR_NONE);
+	TEST_CHECK_EQ(MemPoolFree(&smallPool, mine), ERROR_NO_CHANGE);
+	TEST_CHECK_EQ(smallPool.inUse, 0);
+
+	//The free list was not corrupted by the refused frees: every block comes out exactly once
+	for(int i = 0; i < SMALL_BLOCKS; i++)
+	{
+		again[i] = MemPoolAlloc(&smallPool);
+		TEST_CHECK(again[i] != NULL);
+		for(int j = 0; j < i; j++) TEST_CHECK(again[i] != again[j]);
+	}
+	TEST_CHECK(MemPoolAlloc(&smallPool) == NULL);
+	for(int i = 0; i < SMALL_BLOCKS; i++) MemPoolFree(&smallPool, again[i]);
+	MemPoolFree(&otherPool, foreign);
+
+	//A pool whose blocks were never handed out refuses all of them
+	TEST_CHECK_EQ(MemPoolFree(&benchPool, benchPoolStorage), ERROR_INVALID_ARG);
+}
+
+/**************************************************************************//**
+* @fn		static void TestRegistry(void)
+* @brief	Registration is idempotent and limited to MEM_POOL_MAX_POOLS; statistics follow registration order
+*****************************************************************************/
+static void TestRegistry(void)
+{
+	MEM_POOL_DEFINE(extra, "extra", 4, 1);
+	MemPool *pools[] = {&smallPool, &otherPool, &stressPool, &benchPool};
+	MemPoolStats stats;
+	uint8_t count = 0;
+
+	for(unsigned i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) TEST_CHECK_EQ(MemPoolRegister(pools[i]), ERROR_NONE);
+	TEST_CHECK_EQ(MemPoolRegister(&smallPool), ERROR_NONE);
+	while(MemPoolGetStats(count, &stats)) count++;
+	TEST_CHECK_EQ(count, sizeof(pools) / sizeof(pools[0]));
+
+	TEST_CHECK(MemPoolGetStats(0, &stats));
+	TEST_CHECK(strcmp(stats.name, "small") == 0);
+	TEST_CHECK_EQ(stats.blockSize, 12);
+	TEST_CHECK_EQ(stats.blockCount, SMALL_BLOCKS);
+	TEST_CHECK_EQ(stats.highWater, SMALL_BLOCKS);
+	TEST_CHECK_EQ(stats.failures, 3);
+
+	while(count < MEM_POOL_MAX_POOLS)
+	{
+		static MemPool fillers[MEM_POOL_MAX_POOLS];
+		TEST_CHECK_EQ(MemPoolRegister(&fillers[count++]), ERROR_NONE);
+	}
+	TEST_CHECK_EQ(MemPoolRegister(&extra), ERROR_NO_RESOURCE);
+	TEST_CHECK(!MemPoolGetStats(MEM_POOL_MAX_POOLS, &stats));
+}
+
+/**************************************************************************//**
+* @fn		static void TestRandomTraffic(void)
+* @brief	Random allocations, frees and double frees against a model of which blocks are out. Each block out is
+*			filled with a pattern of its own, which must still be there when it is freed.
+*****************************************************************************/
+static void TestRandomTraffic(void)
+{
+	static uint8_t *out[STRESS_BLOCKS];
+	unsigned outCount = 0, maxOut = 0, mismatches = 0;
+	uint32_t failures = 0;
+
+	for(unsigned op = 0; op < STRESS_OPS; op++)
+	{
+		uint32_t r = TestRandom();
+		if((r & 3) != 0 && (outCount < STRESS_BLOCKS || (r & 0x40)))
+		{
+			uint8_t *block = MemPoolAlloc(&stressPool);
+			if(outCount == STRESS_BLOCKS)
+			{
+				TEST_CHECK(block == NULL);
+				failures++;
+				continue;
+			}
+			TEST_CHECK(block != NULL);
+			if(block == NULL) break;
+			memset(block, (uint8_t)outCount, stressPool.blockSize);
+			out[outCount++] = block;
+			if(outCount > maxOut) maxOut = outCount;
+		}
+		else if(outCount != 0)
+		{
+			unsigned i = (r >> 8) % outCount;
+			uint8_t *block = out[i];
+			for(unsigned k = 0; k < stressPool.blockSize; k++) if(block[k] != (uint8_t)i) mismatches++;
+			TEST_CHECK_EQ(MemPoolFree(&stressPool, block), ERROR_NONE);
+			if(r & 0x80) TEST_CHECK_EQ(MemPoolFree(&stressPool, block), ERROR_NO_CHANGE);
+			out[i] = out[--outCount];
+			//Each block out holds its index in out[] as pattern, so an overlap shows up as a mismatch
+			if(i < outCount) memset(out[i], (uint8_t)i, stressPool.blockSize);
+		}
+		TEST_CHECK_EQ(stressPool.inUse, outCount);
+	}
+	TEST_CHECK_EQ(mismatches, 0);
+	TEST_CHECK_EQ(stressPool.highWater, maxOut);
+	TEST_CHECK_EQ(stressPool.failures, failures);
+	TEST_CHECK_EQ(maxOut, STRESS_BLOCKS);
+	while(outCount > 0) MemPoolFree(&stressPool, out[--outCount]);
+}
+
+/**************************************************************************//**
+* @fn		static void Benchmark(void)
+* @brief	Cost of an allocation and free pair, against malloc and free on the host
+*****************************************************************************/
+static void Benchmark(void)
+{
+	static void *volatile sink;
+	double start;
+
+	start = TestSeconds();
+	for(unsigned i = 0; i < BENCH_PAIRS; i++)
+	{
+		sink = MemPoolAlloc(&benchPool);
+		MemPoolFree(&benchPool, sink);
+	}
+	printf("bench: MemPool     %.1f ns per alloc and free\n", (TestSeconds() - start) * 1e9 / BENCH_PAIRS);
+
+	start = TestSeconds();
+	for(unsigned i = 0; i < BENCH_PAIRS; i++)
+	{
+		sink = malloc(64);
+		free(sink);
+	}
+	printf("bench: malloc/free %.1f ns per alloc and free\n", (TestSeconds() - start) * 1e9 / BENCH_PAIRS);
+}
+
+int main(void)
+{
+	TestExhaustion();
+	TestFreeListReuse();
+	TestHighWater();
+	TestRejectedFrees();
+	TestRegistry();
+	TestRandomTraffic();
+	Benchmark();
+	return TEST_RESULT();
+}
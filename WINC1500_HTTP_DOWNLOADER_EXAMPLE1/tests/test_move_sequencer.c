@@ -0,0 +1,283 @@
+/**************************************************************************//**
+* @file      test_move_sequencer.c
+* @brief     Host tests for the MoveSequencer timing, driven the way the UI task drives it, against a mocked Seesaw.
+The UI loop is replayed on a simulated millisecond clock: it applies every event due, sends the LED changes in one
+update, then sleeps until MoveSequencerTimeToNext() or until a key press wakes it up early. The mocked Seesaw stamps
+each LED change with the time its update starts and can take time to complete, like the I2C writes on the board.
+
+******************************************************************************/
+
+#include "test.h"
+#include "UiHandlerThread/MoveSequencer.h"
+
+#define MAX_CHANGES		128		///<LED changes recorded per run
+#define MAX_STAGED		16		///<LED changes staged before an update
+
+/******************************************************************************
+* Mocked Seesaw
+******************************************************************************/
+
+//LED change seen on the keypad
+typedef struct LedChange
+{
+	uint32_t time;	///<Time the update that carried the change started, in ms
+	uint8_t key;	///<Key changed
+	bool on;		///<True if the key was lit, false if turned off
+} LedChange;
+
+static uint32_t clockMs;					///<Simulated time, in ms
+static uint32_t updateMs;					///<Time SeesawOrderLedUpdate() takes, in ms
+static LedChange staged[MAX_STAGED];		///<Changes set since the last update
+static uint8_t stagedCount;
+static LedChange changes[MAX_CHANGES];		///<Changes sent to the keypad
+static unsigned changeCount;
+
+int32_t SeesawSetLed(uint8_t key, uint8_t red, uint8_t green, uint8_t blue)
+{
+	TEST_CHECK(stagedCount < MAX_STAGED);
+	if(stagedCount < MAX_STAGED)
+	{
+		staged[stagedCount].key = key;
+		staged[stagedCount++].on = (red | green | blue) != 0;
+	}
+	return 0;
+}
+
+int32_t SeesawOrderLedUpdate(void)
+{
+	for(uint8_t i = 0; i < stagedCount && changeCount < MAX_CHANGES; i++)
+	{
+		changes[changeCount] = staged[i];
+		changes[changeCount++].time = clockMs;
+	}
+	stagedCount = 0;
+	clockMs += updateMs;
+	return 0;
+}
+
+/******************************************************************************
+* Helpers
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static uint32_t RunUi(MoveSequencer *sequencer, bool earlyWakeups, uint32_t stopAfter)
+* @brief	Replays the UI task loop until the playback is done
+* @param[in]	earlyWakeups Wake up at random times before the next event, as key presses do
+* @param[in]	stopAfter Number of LED changes after which the loop returns with the playback still active. 0 to run to the end.
+* @return	Time at which MOVE_SEQUENCER_DONE was returned, or the time the loop stopped
+*****************************************************************************/
+static uint32_t RunUi(MoveSequencer *sequencer, bool earlyWakeups, uint32_t stopAfter)
+{
+	uint32_t doneTime = 0;
+	unsigned guard = 10000;
+
+	while(MoveSequencerIsActive(sequencer) && guard-- > 0)
+	{
+		eMoveSequencerEvent event;
+		uint8_t key;
+		uint32_t now = clockMs;
+		uint32_t wait;
+
+		while(MOVE_SEQUENCER_NONE != (event = MoveSequencerPoll(sequencer, now, &key)))
+		{
+			if(event == MOVE_SEQUENCER_LED_ON) SeesawSetLed(key, 0, 0, 255);
+			else if(event == MOVE_SEQUENCER_LED_OFF) SeesawSetLed(key, 0, 0, 0);
+			else doneTime = now;
+		}
+		if(stagedCount != 0) SeesawOrderLedUpdate();
+		if(stopAfter != 0 && changeCount >= stopAfter) return clockMs;
+
+		wait = MoveSequencerTimeToNext(sequencer, clockMs);
+		if(wait == MOVE_SEQUENCER_IDLE) break;
+		if(earlyWakeups && wait > 1 && TestRandom() % 3 == 0) wait = TestRandom() % wait;
+		clockMs += wait;
+	}
+	TEST_CHECK(guard > 0);
+	return doneTime;
+}
+
+static void Reset(uint32_t start, uint32_t updateTime)
+{
+	clockMs = start;
+	updateMs = updateTime;
+	stagedCount = 0;
+	changeCount = 0;
+}
+
+/**************************************************************************//**
+* @fn		static void CheckSchedule(const uint8_t *moves, uint8_t count, uint32_t start, uint32_t onMs, uint32_t offMs)
+* @brief	Checks that every move was lit at start + i * (on + off) and turned off on time later, in order
+*****************************************************************************/
+static void CheckSchedule(const uint8_t *moves, uint8_t count, uint32_t start, uint32_t onMs, uint32_t offMs)
+{
+	TEST_CHECK_EQ(changeCount, 2u * count);
+	for(unsigned i = 0; i < count && 2 * i + 1 < changeCount; i++)
+	{
+		uint32_t lit = start + i * (onMs + offMs);
+		TEST_CHECK_EQ(changes[2 * i].key, moves[i]);
+		TEST_CHECK(changes[2 * i].on);
+		TEST_CHECK_EQ(changes[2 * i].time, lit);
+		TEST_CHECK_EQ(changes[2 * i + 1].key, moves[i]);
+		TEST_CHECK(!changes[2 * i + 1].on);
+		TEST_CHECK_EQ(changes[2 * i + 1].time, lit + onMs);
+	}
+}
+
+/******************************************************************************
+* Tests
+******************************************************************************/
+
+static const uint8_t game[] = {3, 0, 15, 7, 7, 12, 1, 9, 4, 10, 2, 14, 5, 11, 6, 13, 8, 0, 15};	///<19 moves
+
+/**************************************************************************//**
+* @fn		static void TestSchedule(void)
+* @brief	Events on the exact deadlines whatever the LED writes cost, as long as they fit in the on and off times,
+*			and whether the task sleeps until the deadline or is woken up early
+*****************************************************************************/
+static void TestSchedule(void)
+{
+	static const uint32_t updateTimes[] = {0, 1, 30, 999};
+	MoveSequencer sequencer;
+	uint8_t count = sizeof(game);
+
+	for(unsigned u = 0; u < sizeof(updateTimes) / sizeof(updateTimes[0]); u++)
+	{
+		for(int early = 0; early < 2; early++)
+		{
+			Reset(5000, updateTimes[u]);
+			MoveSequencerInit(&sequencer);
+			MoveSequencerStart(&sequencer, game, count, clockMs);
+			TEST_CHECK_EQ(MoveSequencerTimeToNext(&sequencer, clockMs), 0);
+			TEST_CHECK_EQ(RunUi(&sequencer, early, 0), 5000 + count * (MOVE_SEQUENCER_ON_MS + MOVE_SEQUENCER_OFF_MS));
+			CheckSchedule(game, count, 5000, MOVE_SEQUENCER_ON_MS, MOVE_SEQUENCER_OFF_MS);
+			TEST_CHECK(!MoveSequencerIsActive(&sequencer));
+			TEST_CHECK_EQ(MoveSequencerTimeToNext(&sequencer, clockMs), MOVE_SEQUENCER_IDLE);
+		}
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestSlowLeds(void)
+* @brief	LED writes longer than the on time delay the events they overrun, without ever making one early,
+*			and the playback catches up with its deadlines instead of drifting
+*****************************************************************************/
+static void TestSlowLeds(void)
+{
+	MoveSequencer sequencer;
+	uint8_t count = sizeof(game);
+	uint32_t done;
+
+	Reset(0, 1500);
+	MoveSequencerInit(&sequencer);
+	MoveSequencerStart(&sequencer, game, count, clockMs);
+	done = RunUi(&sequencer, false, 0);
+
+	TEST_CHECK_EQ(changeCount, 2u * count);
+	for(unsigned i = 0; i < changeCount; i++)
+	{
+		uint32_t due = (i / 2) * (MOVE_SEQUENCER_ON_MS + MOVE_SEQUENCER_OFF_MS) + (i % 2) * MOVE_SEQUENCER_ON_MS;
+		TEST_CHECK_EQ(changes[i].key, game[i / 2]);
+		TEST_CHECK_EQ(changes[i].on, (i % 2) == 0);
+		TEST_CHECK(changes[i].time >= due);
+		TEST_CHECK(changes[i].time < due + 1500);
+	}
+	TEST_CHECK(done < count * (MOVE_SEQUENCER_ON_MS + MOVE_SEQUENCER_OFF_MS) + 1500u);
+}
+
+/**************************************************************************//**
+* @fn		static void TestSpeed(void)
+* @brief	Speeds scale both times, out of range speeds are refused, and a change applies from the next event on
+*****************************************************************************/
+static void TestSpeed(void)
+{
+	MoveSequencer sequencer;
+	uint8_t count = 6;
+
+	MoveSequencerInit(&sequencer);
+	TEST_CHECK(!MoveSequencerSetSpeed(&sequencer, MOVE_SEQUENCER_SPEED_MIN - 1));
+	TEST_CHECK(!MoveSequencerSetSpeed(&sequencer, MOVE_SEQUENCER_SPEED_MAX + 1));
+	TEST_CHECK_EQ(sequencer.speed, MOVE_SEQUENCER_SPEED_NORMAL);
+
+	for(uint16_t speed = MOVE_SEQUENCER_SPEED_MIN; speed <= MOVE_SEQUENCER_SPEED_MAX; speed *= 2)
+	{
+		Reset(100, 0);
+		TEST_CHECK(MoveSequencerSetSpeed(&sequencer, speed));
+		MoveSequencerStart(&sequencer, game, count, clockMs);
+		RunUi(&sequencer, true, 0);
+		CheckSchedule(game, count, 100, (MOVE_SEQUENCER_ON_MS * MOVE_SEQUENCER_SPEED_NORMAL) / speed,
+					  (MOVE_SEQUENCER_OFF_MS * MOVE_SEQUENCER_SPEED_NORMAL) / speed);
+	}
+
+	//Four times faster once the first move is lit: its off time is already set, the following ones are not
+	Reset(0, 0);
+	MoveSequencerSetSpeed(&sequencer, MOVE_SEQUENCER_SPEED_NORMAL);
+	MoveSequencerStart(&sequencer, game, count, clockMs);
+	RunUi(&sequencer, false, 1);
+	TEST_CHECK(MoveSequencerSetSpeed(&sequencer, 4 * MOVE_SEQUENCER_SPEED_NORMAL));
+	RunUi(&sequencer, false, 0);
+	TEST_CHECK_EQ(changeCount, 2u * count);
+	TEST_CHECK_EQ(changes[1].time, MOVE_SEQUENCER_ON_MS);
+	TEST_CHECK_EQ(changes[2].time, MOVE_SEQUENCER_ON_MS + MOVE_SEQUENCER_OFF_MS / 4);
+	TEST_CHECK_EQ(changes[3].time, MOVE_SEQUENCER_ON_MS + MOVE_SEQUENCER_OFF_MS / 4 + MOVE_SEQUENCER_ON_MS / 4);
+}
+
+/**************************************************************************//**
+* @fn		static void TestTickWrap(void)
+* @brief	A playback that crosses the wrap of the millisecond counter keeps its schedule
+*****************************************************************************/
+static void TestTickWrap(void)
+{
+	MoveSequencer sequencer;
+	const uint32_t start = UINT32_MAX - 2500;
+	uint8_t count = 5;
+
+	Reset(start, 20);
+	MoveSequencerInit(&sequencer);
+	MoveSequencerStart(&sequencer, game, count, clockMs);
+	TEST_CHECK_EQ(RunUi(&sequencer, true, 0), start + count * (MOVE_SEQUENCER_ON_MS + MOVE_SEQUENCER_OFF_MS));
+	CheckSchedule(game, count, start, MOVE_SEQUENCER_ON_MS, MOVE_SEQUENCER_OFF_MS);
+}
+
+/**************************************************************************//**
+* @fn		static void TestCancelAndEmpty(void)
+* @brief	Cancel reports the key left lit, only while it is lit; an empty game is done on the first poll
+*****************************************************************************/
+static void TestCancelAndEmpty(void)
+{
+	MoveSequencer sequencer;
+	uint8_t key = 0xFF;
+
+	Reset(0, 0);
+	MoveSequencerInit(&sequencer);
+	MoveSequencerStart(&sequencer, game, sizeof(game), clockMs);
+	RunUi(&sequencer, false, 3);
+	TEST_CHECK(MoveSequencerCancel(&sequencer, &key));
+	TEST_CHECK_EQ(key, game[1]);
+	TEST_CHECK(!MoveSequencerIsActive(&sequencer));
+	TEST_CHECK_EQ(MoveSequencerPoll(&sequencer, clockMs + 100000, &key), MOVE_SEQUENCER_NONE);
+	TEST_CHECK_EQ(MoveSequencerTimeToNext(&sequencer, clockMs), MOVE_SEQUENCER_IDLE);
+
+	Reset(0, 0);
+	MoveSequencerStart(&sequencer, game, sizeof(game), clockMs);
+	RunUi(&sequencer, false, 2);
+	key = 0xFF;
+	TEST_CHECK(!MoveSequencerCancel(&sequencer, &key));
+	TEST_CHECK_EQ(key, 0xFF);
+	TEST_CHECK(!MoveSequencerCancel(&sequencer, &key));
+
+	Reset(42, 0);
+	MoveSequencerStart(&sequencer, game, 0, clockMs);
+	TEST_CHECK_EQ(MoveSequencerPoll(&sequencer, clockMs, &key), MOVE_SEQUENCER_DONE);
+	TEST_CHECK(!MoveSequencerIsActive(&sequencer));
+	TEST_CHECK_EQ(changeCount, 0);
+}
+
+int main(void)
+{
+	TestSchedule();
+	TestSlowLeds();
+	TestSpeed();
+	TestTickWrap();
+	TestCancelAndEmpty();
+	return TEST_RESULT();
+}
@@ -0,0 +1,332 @@
+/**************************************************************************//**
+* @file      test_mqtt_link.c
+* @brief     Host tests for the MQTT reconnect path: the Paho client, the ASF wrapper and MqttLink against a simulated
+*			broker that goes down, in MQTT mode and in the middle of a download.
+The Wifi task loop of WifiHandler.c is replayed on the stub tick: WIFI_MQTT_INIT connects, WIFI_MQTT_HANDLE publishes
+and yields and falls back to WIFI_MQTT_INIT when the link is lost, and WIFI_DOWNLOAD_HANDLE gives the download its
+slice and reconnects in between. IMU samples arrive at 100 Hz and are published in batches, each payload carrying its
+sample count, so every sample is either acknowledged by the broker, counted as lost, or still in the batch. The
+"bench:" lines give the reconnect time and the samples lost for each scenario, in simulated time.
+
+******************************************************************************/
+
+#include "test.h"
+#include "asf.h"
+#include "WifiHandlerThread/MqttLink.h"
+
+#define TASK_PERIOD_MS		100		///<Sleep of the Wifi task between passes, WIFI_TASK_PERIOD_MS
+#define DOWNLOAD_SLICE_MS	50		///<Time the download gets per pass, WIFI_DOWNLOAD_SLICE_MS
+#define YIELD_MS			100		///<Timeout of mqtt_yield in WifiHandleMqtt
+#define SAMPLE_PERIOD_MS	10		///<Period of the IMU samples
+#define BATCH_SAMPLES		12		///<Samples per published batch, TELEMETRY_BATCH_MAX_SAMPLES
+#define KEEP_ALIVE_S		30		///<Keep alive interval, MQTT_KEEP_ALIVE_S
+
+//States of the replayed Wifi task
+enum TaskState
+{
+	TASK_MQTT_INIT,
+	TASK_MQTT_HANDLE,
+	TASK_DOWNLOAD_HANDLE,
+};
+
+static struct mqtt_module mqtt;
+static struct MqttLink link;
+static unsigned char readBuffer[512];
+static unsigned char sendBuffer[512];
+static enum TaskState state;
+static uint32_t samplesProduced;	///<Samples taken since the test started
+static uint32_t samplesInBatch;		///<Samples waiting in the batch
+static TickType_t nextSample;		///<Tick of the next sample
+static bool sampling;				///<false to stop the samples, so that only the keep alive talks to the broker
+
+static void GameHandler(MessageData *md)
+{
+	(void)md;
+}
+
+/**************************************************************************//**
+* @fn		static void Callback(struct mqtt_module *module, int type, union mqtt_data *data)
+* @brief	MQTT callback, as mqtt_callback of WifiHandler.c
+*****************************************************************************/
+static void Callback(struct mqtt_module *module, int type, union mqtt_data *data)
+{
+	switch(type)
+	{
+		case MQTT_CALLBACK_SOCK_CONNECTED:
+			if(data->sock_connected.result >= 0)
+				mqtt_connect_broker(module, 0, "user", "password", "client", NULL, NULL, 0, 1, 0);
+			break;
+		case MQTT_CALLBACK_CONNECTED:
+			if(data->connected.result == MQTT_CONN_RESULT_ACCEPT)
+			{
+				if(!data->connected.session_present) mqtt_subscribe(module, "game/in", 2, GameHandler);
+				MqttLinkConnected(&link, data->connected.session_present, hostTickCount);
+			}
+			break;
+		case MQTT_CALLBACK_DISCONNECTED:
+			MqttLinkDisconnected(&link, hostTickCount);
+			break;
+		default:
+			break;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void Start(void)
+* @brief	Brings up a fresh broker and MQTT instance, with the task in WIFI_MQTT_INIT
+*****************************************************************************/
+static void Start(void)
+{
+	struct mqtt_config config;
+
+	HostBrokerReset();
+	if(mqtt.client) mqtt_deinit(&mqtt);
+	memset(&mqtt, 0, sizeof(mqtt));
+	mqtt_get_config_defaults(&config);
+	config.read_buffer = readBuffer;
+	config.read_buffer_size = sizeof(readBuffer);
+	config.send_buffer = sendBuffer;
+	config.send_buffer_size = sizeof(sendBuffer);
+	config.keep_alive = KEEP_ALIVE_S;
+	TEST_CHECK_EQ(mqtt_init(&mqtt, &config), SUCCESS);
+	mqtt_register_callback(&mqtt, Callback);
+	MqttLinkInit(&link, &mqtt, "broker", hostTickCount);
+	state = TASK_MQTT_INIT;
+	samplesProduced = 0;
+	samplesInBatch = 0;
+	nextSample = hostTickCount + SAMPLE_PERIOD_MS;
+	sampling = true;
+}
+
+/**************************************************************************//**
+* @fn		static void PublishBatch(void)
+* @brief	Publishes the batch, as WifiPublishImuBatch
+*****************************************************************************/
+static void PublishBatch(void)
+{
+	char payload[16];
+	int len = snprintf(payload, sizeof(payload), "%u", (unsigned)samplesInBatch);
+
+	MqttLinkPublish(&link, "imu", (const uint8_t *)payload, (size_t)len, samplesInBatch);
+	samplesInBatch = 0;
+}
+
+/**************************************************************************//**
+* @fn		static void HandleMqtt(void)
+* @brief	Drains the samples taken since the last pass and services the connection, as WifiHandleMqtt
+*****************************************************************************/
+static void HandleMqtt(void)
+{
+	while(sampling && (int32_t)(hostTickCount - nextSample) >= 0)
+	{
+		samplesProduced++;
+		nextSample += SAMPLE_PERIOD_MS;
+		if(++samplesInBatch >= BATCH_SAMPLES) PublishBatch();
+	}
+	if(MqttLinkIsUp(&link)) mqtt_yield(&mqtt, YIELD_MS);
+}
+
+/**************************************************************************//**
+* @fn		static void Pass(void)
+* @brief	One pass of the Wifi task
+*****************************************************************************/
+static void Pass(void)
+{
+	switch(state)
+	{
+		case TASK_MQTT_INIT:
+			MqttLinkConnect(&link, hostTickCount);
+			state = TASK_MQTT_HANDLE;
+			break;
+		case TASK_MQTT_HANDLE:
+			HandleMqtt();
+			if(!MqttLinkIsUp(&link)) state = TASK_MQTT_INIT;
+			break;
+		case TASK_DOWNLOAD_HANDLE:
+			hostTickCount += DOWNLOAD_SLICE_MS;
+			HandleMqtt();
+			if(!MqttLinkIsUp(&link)) MqttLinkConnect(&link, hostTickCount);
+			break;
+	}
+	hostTickCount += TASK_PERIOD_MS;
+}
+
+static void RunFor(uint32_t ms)
+{
+	TickType_t end = hostTickCount + ms;
+	while((int32_t)(hostTickCount - end) < 0) Pass();
+}
+
+static void RunUntilUp(uint32_t maxMs)
+{
+	TickType_t end = hostTickCount + maxMs;
+	while(!MqttLinkIsUp(&link) && (int32_t)(hostTickCount - end) < 0) Pass();
+}
+
+/**************************************************************************//**
+* @fn		static void CheckAccounting(void)
+* @brief	Every sample taken is acknowledged by the broker, counted as lost, or still in the batch
+*****************************************************************************/
+static void CheckAccounting(void)
+{
+	TEST_CHECK_EQ(HostBrokerGetStats()->payloadSum + link.stats.samplesLost + samplesInBatch, samplesProduced);
+}
+
+/**************************************************************************//**
+* @fn		static void TestConnect(void)
+* @brief	First connection: subscribes once and publishes every sample
+*****************************************************************************/
+static void TestConnect(void)
+{
+	Start();
+	RunUntilUp(1000);
+	TEST_CHECK(MqttLinkIsUp(&link));
+	TEST_CHECK_EQ(HostBrokerGetStats()->connects, 1);
+	TEST_CHECK_EQ(HostBrokerGetStats()->subscribes, 1);
+	TEST_CHECK_EQ(link.stats.reconnects, 0);
+
+	RunFor(10000);
+	TEST_CHECK(MqttLinkIsUp(&link));
+	TEST_CHECK_EQ(link.stats.samplesLost, 0);
+	TEST_CHECK(HostBrokerGetStats()->publishes > 0);
+	CheckAccounting();
+}
+
+/**************************************************************************//**
+* @fn		static void TestDeadSocketFailsFast(void)
+* @brief	A publish on a connection the broker dropped fails at once, instead of waiting for the command timeout
+*****************************************************************************/
+static void TestDeadSocketFailsFast(void)
+{
+	Start();
+	RunUntilUp(1000);
+	HostBrokerDown(5000);
+
+	TickType_t start = hostTickCount;
+	TEST_CHECK_EQ(MqttLinkPublish(&link, "imu", (const uint8_t *)"5", 1, 5), FAILURE);
+	TEST_CHECK(hostTickCount - start < 10);
+	TEST_CHECK(!MqttLinkIsUp(&link));
+	TEST_CHECK(!mqtt.isConnected);
+	TEST_CHECK_EQ(link.stats.disconnects, 1);
+	TEST_CHECK_EQ(link.stats.samplesLost, 5);
+
+	//Nothing is sent while down: the samples are counted, not published
+	TEST_CHECK_EQ(MqttLinkPublish(&link, "imu", (const uint8_t *)"7", 1, 7), FAILURE);
+	TEST_CHECK_EQ(link.stats.samplesLost, 12);
+	TEST_CHECK_EQ(HostBrokerGetStats()->publishes, 0);
+
+	//The same goes for a yield
+	Start();
+	RunUntilUp(1000);
+	HostBrokerDown(5000);
+	start = hostTickCount;
+	TEST_CHECK(mqtt_yield(&mqtt, YIELD_MS) != SUCCESS);
+	TEST_CHECK(hostTickCount - start < 10);
+	TEST_CHECK(!MqttLinkIsUp(&link));
+}
+
+/**************************************************************************//**
+* @fn		static void TestHalfOpen(void)
+* @brief	A broker that stops answering is detected by the keep alive: no PINGRESP within an interval drops the link
+*****************************************************************************/
+static void TestHalfOpen(void)
+{
+	Start();
+	RunUntilUp(1000);
+	RunFor(1000);
+	sampling = false;
+	HostBrokerMute(true);
+	TickType_t start = hostTickCount;
+	while(MqttLinkIsUp(&link) && hostTickCount - start < 4 * KEEP_ALIVE_S * 1000) Pass();
+	TEST_CHECK(!MqttLinkIsUp(&link));
+	TEST_CHECK(hostTickCount - start <= 2 * KEEP_ALIVE_S * 1000 + TASK_PERIOD_MS + YIELD_MS);
+	TEST_CHECK_EQ(link.stats.disconnects, 1);
+
+	HostBrokerMute(false);
+	sampling = true;
+	nextSample = hostTickCount;
+	RunUntilUp(MQTT_LINK_RETRY_MS + 1000);
+	TEST_CHECK(MqttLinkIsUp(&link));
+	TEST_CHECK(HostBrokerGetStats()->pings > 0);
+	CheckAccounting();
+}
+
+/**************************************************************************//**
+* @fn		static void TestRetrySpacing(void)
+* @brief	While the broker is unreachable, attempts are MQTT_LINK_RETRY_MS apart
+*****************************************************************************/
+static void TestRetrySpacing(void)
+{
+	Start();
+	HostBrokerDown(10000);
+	RunFor(9000);
+	TEST_CHECK(!MqttLinkIsUp(&link));
+	TEST_CHECK(link.stats.attempts >= 9000 / MQTT_LINK_RETRY_MS);
+	TEST_CHECK(link.stats.attempts <= 9000 / MQTT_LINK_RETRY_MS + 1);
+	TEST_CHECK_EQ(HostBrokerGetStats()->refused, link.stats.attempts);
+
+	RunUntilUp(MQTT_LINK_RETRY_MS + 1000);
+	TEST_CHECK(MqttLinkIsUp(&link));
+	TEST_CHECK(link.stats.lastOutageMs >= 10000);
+	CheckAccounting();
+}
+
+/**************************************************************************//**
+* @fn		static void TestDrop(bool download, uint32_t downMs)
+* @brief	Takes the broker down for downMs in the middle of a run, in MQTT mode or during a download, and checks the
+*			reconnection: session resumed without subscribing again, outage bounded by the retry spacing, no sample
+*			unaccounted for.
+*****************************************************************************/
+static void TestDrop(bool download, uint32_t downMs)
+{
+	Start();
+	RunUntilUp(1000);
+	RunFor(5000);
+	TEST_CHECK_EQ(link.stats.samplesLost, 0);
+
+	//Mode switch, then the drop 1 s into the download
+	if(download)
+	{
+		state = TASK_DOWNLOAD_HANDLE;
+		RunFor(1000);
+	}
+	uint32_t producedBefore = samplesProduced;
+	HostBrokerDown(downMs);
+	RunFor(downMs);
+	RunUntilUp(MQTT_LINK_RETRY_MS + 1000);
+	uint32_t producedDuring = samplesProduced - producedBefore;
+
+	TEST_CHECK(MqttLinkIsUp(&link));
+	if(download) TEST_CHECK_EQ(state, TASK_DOWNLOAD_HANDLE);
+	TEST_CHECK_EQ(link.stats.disconnects, 1);
+	TEST_CHECK_EQ(link.stats.reconnects, 1);
+	TEST_CHECK_EQ(link.stats.resumed, 1);
+	TEST_CHECK_EQ(HostBrokerGetStats()->subscribes, 1);
+	TEST_CHECK(link.stats.lastOutageMs >= downMs);
+	TEST_CHECK(link.stats.lastOutageMs <= downMs + MQTT_LINK_RETRY_MS + TASK_PERIOD_MS + DOWNLOAD_SLICE_MS + YIELD_MS);
+	//Only the samples published while down are lost, with the batch that was being filled when the broker went
+	TEST_CHECK(link.stats.samplesLost <= producedDuring + BATCH_SAMPLES);
+
+	//Back to MQTT mode, publishing goes on
+	state = TASK_MQTT_HANDLE;
+	uint32_t lost = link.stats.samplesLost;
+	RunFor(5000);
+	TEST_CHECK_EQ(link.stats.samplesLost, lost);
+	CheckAccounting();
+
+	printf("bench: broker down %lu ms %s: reconnected after %lu ms, %lu of %lu samples lost\n",
+		(unsigned long)downMs, download ? "during a download" : "in MQTT mode",
+		(unsigned long)link.stats.lastOutageMs, (unsigned long)link.stats.samplesLost, (unsigned long)samplesProduced);
+}
+
+int main(void)
+{
+	TestConnect();
+	TestDeadSocketFailsFast();
+	TestHalfOpen();
+	TestRetrySpacing();
+	TestDrop(false, 3000);
+	TestDrop(true, 1500);
+	TestDrop(true, 6000);
+	return TEST_RESULT();
+}
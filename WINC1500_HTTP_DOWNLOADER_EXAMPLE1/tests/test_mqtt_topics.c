@@ -0,0 +1,375 @@
+/**************************************************************************//**
+* @file      test_mqtt_topics.c
+* @brief     Host tests for the MQTT topic table: subscribe, replace, unsubscribe and wildcard fallback, checked against
+*			a linear reference matcher, and the dispatch cost against the linear scan it replaced.
+The test is built twice: with the MAX_MESSAGE_HANDLERS of the firmware, and as test_mqtt_topics_many with hundreds of
+subscriptions, so that handler indexes above 127 go through the topic table.
+
+******************************************************************************/
+
+#include "test.h"
+#include "MQTTClient/MQTTClient.h"
+
+#define BENCH_MESSAGES	((MAX_MESSAGE_HANDLERS > 16) ? 100000 : 1000000)	///<Messages dispatched by the benchmark
+#define HANDLERS		16							///<Handler functions; subscription i gets handler i % HANDLERS
+#define DEFAULT_HANDLER	HANDLERS					///<Index of the default handler in calls
+
+int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message);
+
+static MQTTClient client;
+static Network network;
+static unsigned char sendBuffer[256];
+static unsigned char readBuffer[256];
+static unsigned calls[HANDLERS + 1];	///<Calls per handler, the last one is the default handler
+
+#define HANDLER(n)	static void Handler##n(MessageData *md) { (void)md; calls[n]++; }
+HANDLER(0) HANDLER(1) HANDLER(2) HANDLER(3) HANDLER(4) HANDLER(5) HANDLER(6) HANDLER(7)
+HANDLER(8) HANDLER(9) HANDLER(10) HANDLER(11) HANDLER(12) HANDLER(13) HANDLER(14) HANDLER(15)
+static void DefaultHandler(MessageData *md) { (void)md; calls[DEFAULT_HANDLER]++; }
+static const messageHandler handlers[HANDLERS] = {Handler0, Handler1, Handler2, Handler3, Handler4, Handler5, Handler6, Handler7,
+												  Handler8, Handler9, Handler10, Handler11, Handler12, Handler13, Handler14, Handler15};
+
+static void ClientInit(void)
+{
+	HostNetworkInit(&network);
+	MQTTClientInit(&client, &network, 100, sendBuffer, sizeof(sendBuffer), readBuffer, sizeof(readBuffer));
+	client.isconnected = 1;
+	client.defaultMessageHandler = DefaultHandler;
+}
+
+static int Subscribe(const char *filter, int handler)
+{
+	static const unsigned char suback[] = {0x90, 0x03, 0x00, 0x01, 0x00};
+	HostNetworkScript(&network, suback, sizeof(suback));
+	return MQTTSubscribe(&client, filter, QOS0, handlers[handler % HANDLERS]);
+}
+
+static int Unsubscribe(const char *filter)
+{
+	static const unsigned char unsuback[] = {0xB0, 0x02, 0x00, 0x01};
+	HostNetworkScript(&network, unsuback, sizeof(unsuback));
+	return MQTTUnsubscribe(&client, filter);
+}
+
+/**************************************************************************//**
+* @fn		static int Deliver(const char *topic)
+* @brief	Dispatches a message on topic
+* @return	Index of the only handler called, DEFAULT_HANDLER for the default handler, -1 for none, -2 for several
+*****************************************************************************/
+static int Deliver(const char *topic)
+{
+	MQTTString name = MQTTString_initializer;
+	MQTTMessage message = {QOS0, 0, 0, 0, (void *)"1", 1};
+	int called = -1;
+
+	name.lenstring.data = (char *)topic;
+	name.lenstring.len = (int)strlen(topic);
+	memset(calls, 0, sizeof(calls));
+	deliverMessage(&client, &name, &message);
+	for(int i = 0; i <= DEFAULT_HANDLER; i++)
+	{
+		if(calls[i] == 0) continue;
+		called = (called == -1 && calls[i] == 1) ? i : -2;
+	}
+	return called;
+}
+
+/**************************************************************************//**
+* @fn		static bool ReferenceMatch(const char *filter, const char *topic)
+* @brief	MQTT 3.1.1 topic filter matching, for topics with as many levels as the filter
+*****************************************************************************/
+static bool ReferenceMatch(const char *filter, const char *topic)
+{
+	while(*filter && *topic)
+	{
+		if(*filter == '#') return true;
+		if(*filter == '+')
+		{
+			while(*topic && *topic != '/') topic++;
+			filter++;
+			continue;
+		}
+		if(*filter != *topic) return false;
+		filter++;
+		topic++;
+	}
+	return (*filter == '\0' && *topic == '\0') || strcmp(filter, "#") == 0;
+}
+
+static void TestExactTopics(void)
+{
+	static char fill[MAX_MESSAGE_HANDLERS][16];	//The client keeps pointers to the filters
+
+	ClientInit();
+	TEST_CHECK_EQ(Deliver("game/in"), DEFAULT_HANDLER);	//Nothing subscribed
+
+	TEST_CHECK_EQ(Subscribe("game/in", 0), 0);
+	TEST_CHECK_EQ(Subscribe("led/in", 1), 0);
+	TEST_CHECK_EQ(Subscribe("rgb/in", 2), 0);
+	TEST_CHECK_EQ(Deliver("game/in"), 0);
+	TEST_CHECK_EQ(Deliver("led/in"), 1);
+	TEST_CHECK_EQ(Deliver("rgb/in"), 2);
+	TEST_CHECK_EQ(Deliver("rgb/i"), DEFAULT_HANDLER);
+	TEST_CHECK_EQ(Deliver("rgb/inn"), DEFAULT_HANDLER);
+	TEST_CHECK_EQ(Deliver(""), DEFAULT_HANDLER);
+
+	//Subscribing again replaces the handler and does not take another slot
+	for(int i = 0; i < 10; i++) TEST_CHECK_EQ(Subscribe("led/in", 3), 0);
+	TEST_CHECK_EQ(Deliver("led/in"), 3);
+	TEST_CHECK_EQ(Subscribe("a", 4), 0);
+	for(int i = 4; i < MAX_MESSAGE_HANDLERS; i++)
+	{
+		snprintf(fill[i], sizeof(fill[i]), "fill/%d", i);
+		TEST_CHECK_EQ(Subscribe(fill[i], 5), 0);
+	}
+	TEST_CHECK(Subscribe("c", 0) != 0);	//All MAX_MESSAGE_HANDLERS slots are taken
+	TEST_CHECK_EQ(Deliver("c"), DEFAULT_HANDLER);
+
+	//Unsubscribing frees the slot and removes the topic from the table
+	TEST_CHECK_EQ(Unsubscribe("game/in"), 0);
+	TEST_CHECK_EQ(Deliver("game/in"), DEFAULT_HANDLER);
+	TEST_CHECK_EQ(Deliver("led/in"), 3);
+	TEST_CHECK_EQ(Subscribe("c", 0), 0);
+	TEST_CHECK_EQ(Deliver("c"), 0);
+	TEST_CHECK_EQ(Unsubscribe("not/subscribed"), 0);
+	TEST_CHECK_EQ(Deliver("c"), 0);
+}
+
+static void TestWildcards(void)
+{
+	ClientInit();
+	TEST_CHECK_EQ(Subscribe("dev/+/led", 0), 0);
+	TEST_CHECK_EQ(Subscribe("dev/7/led", 1), 0);
+	TEST_CHECK_EQ(Deliver("dev/3/led"), 0);
+	TEST_CHECK_EQ(Deliver("dev/7/led"), -2);	//Exact and wildcard handlers are both called
+	TEST_CHECK_EQ(Deliver("dev/3/rgb"), DEFAULT_HANDLER);
+	TEST_CHECK_EQ(Unsubscribe("dev/+/led"), 0);
+	TEST_CHECK_EQ(Deliver("dev/3/led"), DEFAULT_HANDLER);
+	TEST_CHECK_EQ(Deliver("dev/7/led"), 1);
+	TEST_CHECK_EQ(client.wildcardHandlers, 0);
+	TEST_CHECK_EQ(Subscribe("dev/#", 2), 0);
+	TEST_CHECK_EQ(Deliver("dev/3/rgb"), 2);
+	TEST_CHECK_EQ(client.wildcardHandlers, 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestAgainstReference(void)
+* @brief	Random subscriptions and topics, checked against a linear scan with the reference matcher.
+* Exact filters collide in the table, so the probing and the rebuilds on unsubscribe are exercised. At most 14
+* filters are subscribed at once, so slot i always has handler i.
+*****************************************************************************/
+static void TestAgainstReference(void)
+{
+	static const char *filters[] = {"a/a/a", "a/b/a", "b/a/b", "b/b/b", "a/a/b", "c/a/c", "c/c/c", "b/c/a",
+									"a/+/a", "+/b/+", "c/#", "#", "+/+/c", "b/+/b"};
+	static const char *levels[] = {"a", "b", "c"};
+	const char *subscribed[MAX_MESSAGE_HANDLERS];
+	unsigned mismatches = 0;
+
+	ClientInit();
+	memset(subscribed, 0, sizeof(subscribed));
+	for(int round = 0; round < 20000; round++)
+	{
+		const char *filter = filters[TestRandom() % (sizeof(filters) / sizeof(filters[0]))];
+		char topic[8];
+		int expected = -1;
+		int slot = -1;
+
+		//Change one subscription
+		for(int i = 0; i < MAX_MESSAGE_HANDLERS; i++)
+		{
+			if(subscribed[i] != NULL && strcmp(subscribed[i], filter) == 0) slot = i;
+		}
+		if(slot != -1 && (TestRandom() & 1))
+		{
+			TEST_CHECK_EQ(Unsubscribe(filter), 0);
+			subscribed[slot] = NULL;
+		}
+		else
+		{
+			if(slot == -1)
+			{
+				for(int i = MAX_MESSAGE_HANDLERS - 1; i >= 0; i--) if(subscribed[i] == NULL) slot = i;
+			}
+			if(slot != -1)
+			{
+				TEST_CHECK_EQ(Subscribe(filter, slot), 0);
+				subscribed[slot] = filter;
+			}
+		}
+
+		//Then deliver a few topics
+		for(int t = 0; t < 4; t++)
+		{
+			snprintf(topic, sizeof(topic), "%s/%s/%s", levels[TestRandom() % 3], levels[TestRandom() % 3], levels[TestRandom() % 3]);
+			expected = -1;
+			for(int i = 0; i < MAX_MESSAGE_HANDLERS; i++)
+			{
+				if(subscribed[i] == NULL || !ReferenceMatch(subscribed[i], topic)) continue;
+				expected = (expected == -1) ? i % HANDLERS : -2;
+			}
+			if(expected == -1) expected = DEFAULT_HANDLER;
+			if(Deliver(topic) != expected) mismatches++;
+		}
+	}
+	TEST_CHECK_EQ(mismatches, 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestAllSlots(void)
+* @brief	Every slot holds an exact subscription, each one reaches its own handler, also after half of them are removed
+*****************************************************************************/
+static void TestAllSlots(void)
+{
+	static char filters[MAX_MESSAGE_HANDLERS][24];
+	char topic[24];
+	unsigned mismatches = 0;
+
+	ClientInit();
+	for(int i = 0; i < MAX_MESSAGE_HANDLERS; i++)
+	{
+		snprintf(filters[i], sizeof(filters[i]), "devices/%d/in", i);
+		TEST_CHECK_EQ(Subscribe(filters[i], i), 0);
+	}
+	TEST_CHECK(Subscribe("one/more", 0) != 0);
+
+	for(int i = 0; i < MAX_MESSAGE_HANDLERS; i++)
+	{
+		snprintf(topic, sizeof(topic), "devices/%d/in", i);
+		if(Deliver(topic) != i % HANDLERS) mismatches++;
+		TEST_CHECK(client.messageHandlers[i].fp == handlers[i % HANDLERS]);
+	}
+	TEST_CHECK_EQ(mismatches, 0);
+
+	for(int i = 0; i < MAX_MESSAGE_HANDLERS; i += 2)
+	{
+		snprintf(topic, sizeof(topic), "devices/%d/in", i);
+		TEST_CHECK_EQ(Unsubscribe(topic), 0);
+	}
+	for(int i = 0; i < MAX_MESSAGE_HANDLERS; i++)
+	{
+		snprintf(topic, sizeof(topic), "devices/%d/in", i);
+		if(Deliver(topic) != ((i & 1) ? i % HANDLERS : DEFAULT_HANDLER)) mismatches++;
+	}
+	TEST_CHECK_EQ(mismatches, 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestPublishPacket(void)
+* @brief	A PUBLISH read from the network reaches its handler through MQTTYield
+*****************************************************************************/
+static void TestPublishPacket(void)
+{
+	unsigned char packet[64];
+	MQTTString topic = MQTTString_initializer;
+	int length;
+
+	ClientInit();
+	TEST_CHECK_EQ(Subscribe("game/in", 0), 0);
+	topic.cstring = "game/in";
+	length = MQTTSerialize_publish(packet, sizeof(packet), 0, 0, 0, 0, topic, (unsigned char *)"{\"game\":[1]}", 12);
+	TEST_CHECK(length > 0);
+	HostNetworkScript(&network, packet, (size_t)length);
+	memset(calls, 0, sizeof(calls));
+	MQTTYield(&client, 5);
+	TEST_CHECK_EQ(calls[0], 1);
+	TEST_CHECK_EQ(calls[DEFAULT_HANDLER], 0);
+}
+
+/**************************************************************************//**
+* @fn		static char BaselineTopicMatched(char* topicFilter, MQTTString* topicName)
+* @brief	isTopicMatched() of MQTTClient.c, used by the baseline dispatch of the benchmark
+*****************************************************************************/
+static char BaselineTopicMatched(char* topicFilter, MQTTString* topicName)
+{
+	char* curf = topicFilter;
+	char* curn = topicName->lenstring.data;
+	char* curn_end = curn + topicName->lenstring.len;
+
+	while (*curf && curn < curn_end)
+	{
+		if (*curn == '/' && *curf != '/')
+			break;
+		if (*curf != '+' && *curf != '#' && *curf != *curn)
+			break;
+		if (*curf == '+')
+		{
+			char* nextpos = curn + 1;
+			while (nextpos < curn_end && *nextpos != '/')
+				nextpos = ++curn + 1;
+		}
+		else if (*curf == '#')
+			curn = curn_end - 1;
+		curf++;
+		curn++;
+	};
+
+	return (curn == curn_end) && (*curf == '\0');
+}
+
+/**************************************************************************//**
+* @fn		static void BaselineDeliver(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+* @brief	The linear dispatch the topic table replaced: every handler is compared, exactly and as a wildcard
+*****************************************************************************/
+static void BaselineDeliver(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+{
+	for (int i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+	{
+		if (c->messageHandlers[i].topicFilter != 0 && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
+				BaselineTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName)))
+		{
+			MessageData md = {message, topicName};
+			c->messageHandlers[i].fp(&md);
+		}
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void Benchmark(void)
+* @brief	Dispatch time with MAX_MESSAGE_HANDLERS exact subscriptions, against the linear scan it replaced
+*****************************************************************************/
+static void Benchmark(void)
+{
+	static const char *boardTopics[] = {"devices/board1/game_in", "devices/board1/led_in", "devices/board1/rgb_in",
+										"devices/board1/imu_in", "devices/board1/dist_in"};
+	static char topics[MAX_MESSAGE_HANDLERS][32];
+	static MQTTString names[MAX_MESSAGE_HANDLERS];
+	MQTTMessage message = {QOS0, 0, 0, 0, (void *)"1", 1};
+	unsigned total = 0;
+	double start;
+
+	ClientInit();
+	for(int i = 0; i < MAX_MESSAGE_HANDLERS; i++)
+	{
+		if(i < 5) snprintf(topics[i], sizeof(topics[i]), "%s", boardTopics[i]);
+		else snprintf(topics[i], sizeof(topics[i]), "devices/board%d/game_in", i);
+		Subscribe(topics[i], i);
+		names[i].cstring = NULL;
+		names[i].lenstring.data = topics[i];
+		names[i].lenstring.len = (int)strlen(topics[i]);
+	}
+
+	memset(calls, 0, sizeof(calls));
+	start = TestSeconds();
+	for(int n = 0; n < BENCH_MESSAGES; n++) deliverMessage(&client, &names[n % MAX_MESSAGE_HANDLERS], &message);
+	printf("bench: topic table, %d subscriptions, %.1f ns per message\n", MAX_MESSAGE_HANDLERS,
+		   (TestSeconds() - start) * 1e9 / BENCH_MESSAGES);
+
+	start = TestSeconds();
+	for(int n = 0; n < BENCH_MESSAGES; n++) BaselineDeliver(&client, &names[n % MAX_MESSAGE_HANDLERS], &message);
+	printf("bench: linear scan, %d subscriptions, %.1f ns per message\n", MAX_MESSAGE_HANDLERS,
+		   (TestSeconds() - start) * 1e9 / BENCH_MESSAGES);
+	for(int i = 0; i < HANDLERS; i++) total += calls[i];
+	TEST_CHECK_EQ(total, 2 * BENCH_MESSAGES);
+}
+
+int main(void)
+{
+	TestExactTopics();
+	TestWildcards();
+	TestAgainstReference();
+	TestAllSlots();
+	TestPublishPacket();
+	Benchmark();
+	return TEST_RESULT();
+}
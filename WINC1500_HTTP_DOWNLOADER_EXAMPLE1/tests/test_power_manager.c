@@ -0,0 +1,298 @@
+/**************************************************************************//**
+* @file      test_power_manager.c
+* @brief     Host tests for the tickless idle of PowerManager.c, on the MCU and scheduler model of host_tickless.c.
+PowerManagerSuppressTicksAndSleep() is called by the model's idle task whenever every task is blocked for at least
+configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks. Tasks must still wake up on time: no earlier than vTaskDelay() promises
+and at most a tick late, with the tick count never stepped past the next unblock time nor ahead of the real time.
+This is checked with every task blocked for good, with a periodic task, with interrupts that end sleeps early, with
+interrupts in the window before the sleep (which must abort it), with the sleep manager held active, and in standby.
+The statistics of PowerManagerGetStats(), which the "power" command prints, must match what the model saw.
+The benchmark gives the expected sleep residency of the firmware's task mix: the IMU drained at each FIFO watermark,
+the Wi-Fi task's 100 ms passes with a telemetry publish every second, the control task's telemetry every 300 ms and
+the distance sensor's timer. The CPU times are estimates; the periods are the firmware's.
+
+******************************************************************************/
+
+#include "test.h"
+#include "host_tickless.h"
+#include "PowerManager/PowerManager.h"
+#include "IMU/ImuAcquisition.h"
+#include "DistanceDriver/DistanceSensor.h"
+#include "WifiHandlerThread/TelemetryBatch.h"
+
+#define WIFI_TASK_PERIOD_MS			100		///<As in WifiHandler.h
+#define CONTROL_TELEMETRY_PERIOD_MS	300		///<As in ControlThread.c
+#define IMU_I2C_HZ					400000	///<Sensor bus clock
+#define IMU_BLOCK_READ_US			((IMU_ACQ_BLOCK_SAMPLES * IMU_ACQ_BYTES_PER_SAMPLE + 4) * 9 * 1000000UL / IMU_I2C_HZ)	///<Bus time of a block read
+#define RUN_MS						60000
+
+//Tasks of the firmware, highest priority first, and the interrupts that wake them up
+enum { TASK_IMU, TASK_WIFI, TASK_CONTROL, TASK_UI, TASK_CLI, TASK_COUNT };
+enum { IRQ_IMU_INT1, IRQ_DISTANCE_TIMER, IRQ_COUNT };
+
+static struct HostTicklessTask tasks[TASK_COUNT];
+static struct HostTicklessIrq irqs[IRQ_COUNT];
+
+/**************************************************************************//**
+* @fn		static void FirmwareMix(bool imu)
+* @brief	Sets the tasks and interrupts of the firmware
+* @param[in]	imu false to leave the IMU stream out
+*****************************************************************************/
+static void FirmwareMix(bool imu)
+{
+	memset(tasks, 0, sizeof(tasks));
+	memset(irqs, 0, sizeof(irqs));
+	tasks[TASK_IMU] = (struct HostTicklessTask){ .name = "IMU", .blockTicks = IMU_ACQ_POLL_MS, .runUs = 150,
+		.ioUs = IMU_BLOCK_READ_US, .ioTimeoutTicks = 100 };
+	tasks[TASK_WIFI] = (struct HostTicklessTask){ .name = "Wi-Fi", .blockTicks = WIFI_TASK_PERIOD_MS, .runUs = 400,
+		.burstEvery = TELEMETRY_BATCH_WINDOW_MS / WIFI_TASK_PERIOD_MS, .burstUs = 5000 };
+	tasks[TASK_CONTROL] = (struct HostTicklessTask){ .name = "Control", .blockTicks = CONTROL_TELEMETRY_PERIOD_MS, .runUs = 200 };
+	tasks[TASK_UI] = (struct HostTicklessTask){ .name = "UI", .runUs = 50 };
+	tasks[TASK_CLI] = (struct HostTicklessTask){ .name = "CLI", .runUs = 50 };
+	if(imu)
+	{
+		irqs[IRQ_IMU_INT1] = (struct HostTicklessIrq){ .name = "INT1",
+			.periodUs = IMU_ACQ_BLOCK_SAMPLES * IMU_ACQ_SAMPLE_PERIOD_US, .phaseUs = 7000, .task = &tasks[TASK_IMU] };
+	}
+	else
+	{
+		tasks[TASK_IMU].blockTicks = 0;
+	}
+	irqs[IRQ_DISTANCE_TIMER] = (struct HostTicklessIrq){ .name = "TC3", .periodUs = DISTANCE_SAMPLE_PERIOD_MS * 1000,
+		.phaseUs = 53000 };
+}
+
+/**************************************************************************//**
+* @fn		static void Run(uint32_t ms, PowerManagerStats *stats)
+* @brief	Runs the model and gives the statistics of the run
+*****************************************************************************/
+static void Run(uint32_t ms, PowerManagerStats *stats)
+{
+	PowerManagerStats before;
+
+	PowerManagerGetStats(&before);
+	HostTicklessRun(ms);
+	PowerManagerGetStats(stats);
+	stats->sleeps -= before.sleeps;
+	stats->aborts -= before.aborts;
+	stats->early -= before.early;
+	stats->sleptTicks -= before.sleptTicks;
+}
+
+/**************************************************************************//**
+* @fn		static void CheckRun(const PowerManagerStats *stats)
+* @brief	Checks what holds for every run: tasks on time, the tick count consistent, the statistics right
+*****************************************************************************/
+static void CheckRun(const PowerManagerStats *stats)
+{
+	const struct HostTicklessStats *model = HostTicklessGetStats();
+	double residency = (double)model->suppressedCycles / model->totalCycles;
+	double reported = (double)stats->sleptTicks / stats->ticks;
+
+	for(uint8_t i = 0; i < TASK_COUNT; i++)
+	{
+		TEST_CHECK_EQ(tasks[i].early, 0);
+		TEST_CHECK(tasks[i].maxLateCycles <= HOST_TICK_CYCLES);
+	}
+	TEST_CHECK_EQ(model->stepOverruns, 0);
+	TEST_CHECK(model->minLagCycles >= 0);
+	TEST_CHECK_EQ(stats->ticks, hostTickCount);
+	TEST_CHECK_EQ(stats->sleeps, model->suppressedSleeps);
+	//Each call sleeps once or aborts, unless the sleep manager holds the MCU active
+	TEST_CHECK_EQ(stats->sleeps + stats->aborts, (sleepmgr_get_sleep_mode() == SLEEPMGR_ACTIVE) ? 0 : model->idleCalls);
+	//The residency the "power" command prints is the one the MCU had
+	TEST_CHECK(reported <= residency + 0.001);
+	TEST_CHECK(reported >= residency - 0.001);
+}
+
+/**************************************************************************//**
+* @fn		static void TestAllBlocked(void)
+* @brief	Every task waits for good: the MCU sleeps POWER_MAX_IDLE_TICKS at a time, in the mode of the default lock
+*****************************************************************************/
+static void TestAllBlocked(void)
+{
+	const struct HostTicklessStats *model = HostTicklessGetStats();
+	PowerManagerStats stats;
+
+	memset(tasks, 0, sizeof(tasks));
+	HostTicklessReset(tasks, TASK_COUNT, NULL, 0);
+	PowerManagerInit();
+	Run(RUN_MS, &stats);
+	CheckRun(&stats);
+
+	TEST_CHECK(stats.sleeps >= RUN_MS / POWER_MAX_IDLE_TICKS && stats.sleeps <= RUN_MS / POWER_MAX_IDLE_TICKS + 1);
+	TEST_CHECK_EQ(stats.early, 0);
+	TEST_CHECK_EQ(stats.aborts, 0);
+	TEST_CHECK(model->suppressedCycles > model->totalCycles * 999 / 1000);
+	TEST_CHECK_EQ(model->modeCycles[SYSTEM_SLEEPMODE_IDLE_0], model->suppressedCycles);
+	for(uint8_t i = 0; i < TASK_COUNT; i++) TEST_CHECK_EQ(tasks[i].runs, 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestPeriodic(void)
+* @brief	A task that delays 100 ms per pass: one sleep per pass, every pass on time
+*****************************************************************************/
+static void TestPeriodic(void)
+{
+	PowerManagerStats stats;
+
+	memset(tasks, 0, sizeof(tasks));
+	tasks[0] = (struct HostTicklessTask){ .name = "periodic", .blockTicks = 100, .runUs = 300 };
+	HostTicklessReset(tasks, TASK_COUNT, NULL, 0);
+	PowerManagerInit();
+	Run(RUN_MS, &stats);
+	CheckRun(&stats);
+
+	TEST_CHECK_EQ(stats.early, 0);
+	TEST_CHECK_EQ(stats.aborts, 0);
+	TEST_CHECK(tasks[0].runs == tasks[0].timeouts || tasks[0].runs == tasks[0].timeouts + 1);
+	//Each pass takes its 100 ticks, plus its run time while the tick falls behind
+	TEST_CHECK(tasks[0].runs >= RUN_MS / 101 && tasks[0].runs <= RUN_MS / 100 + 1);
+	TEST_CHECK(stats.sleeps >= tasks[0].runs - 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestEarlyWake(void)
+* @brief	An interrupt that no task waits for ends sleeps early: only whole ticks are stepped, tasks stay on time
+*****************************************************************************/
+static void TestEarlyWake(void)
+{
+	PowerManagerStats stats;
+
+	memset(tasks, 0, sizeof(tasks));
+	memset(irqs, 0, sizeof(irqs));
+	tasks[0] = (struct HostTicklessTask){ .name = "periodic", .blockTicks = 100, .runUs = 300 };
+	irqs[0] = (struct HostTicklessIrq){ .name = "timer", .periodUs = 37000, .phaseUs = 11000 };
+	HostTicklessReset(tasks, TASK_COUNT, irqs, 1);
+	PowerManagerInit();
+	Run(RUN_MS, &stats);
+	CheckRun(&stats);
+
+	TEST_CHECK(stats.early > 0);
+	TEST_CHECK_EQ(stats.early, irqs[0].wakeups);
+	TEST_CHECK_EQ(stats.aborts, 0);
+	TEST_CHECK(tasks[0].runs >= RUN_MS / 101);
+}
+
+/**************************************************************************//**
+* @fn		static void TestAbort(void)
+* @brief	Interrupts that make a task ready after the idle task chose to sleep abort the sleep, and no wake-up is lost
+*****************************************************************************/
+static void TestAbort(void)
+{
+	PowerManagerStats stats;
+
+	memset(tasks, 0, sizeof(tasks));
+	memset(irqs, 0, sizeof(irqs));
+	tasks[0] = (struct HostTicklessTask){ .name = "irq", .runUs = 100 };
+	tasks[1] = (struct HostTicklessTask){ .name = "periodic", .blockTicks = 20, .runUs = 300 };
+	irqs[0] = (struct HostTicklessIrq){ .name = "irq", .periodUs = 7100, .phaseUs = 3000, .task = &tasks[0] };
+	HostTicklessReset(tasks, TASK_COUNT, irqs, 1);
+	PowerManagerInit();
+	HostTicklessSetEntryUs(500);	//A slow idle path, so interrupts land in the window
+	Run(RUN_MS, &stats);
+	CheckRun(&stats);
+
+	TEST_CHECK(stats.aborts > 0);
+	TEST_CHECK(tasks[0].runs == irqs[0].count || tasks[0].runs == irqs[0].count + 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestActiveLock(void)
+* @brief	With SLEEPMGR_ACTIVE locked the tick is never suppressed, and tasks run on the tick
+*****************************************************************************/
+static void TestActiveLock(void)
+{
+	const struct HostTicklessStats *model = HostTicklessGetStats();
+	PowerManagerStats stats;
+
+	FirmwareMix(true);
+	HostTicklessReset(tasks, TASK_COUNT, irqs, IRQ_COUNT);
+	PowerManagerInit();
+	sleepmgr_lock_mode(SLEEPMGR_ACTIVE);
+	Run(10000, &stats);
+	CheckRun(&stats);
+
+	TEST_CHECK_EQ(stats.sleeps, 0);
+	TEST_CHECK_EQ(model->suppressedCycles, 0);
+	TEST_CHECK_EQ(model->maxLagCycles, 0);
+	TEST_CHECK_EQ(tasks[TASK_CONTROL].runs, 10000 / CONTROL_TELEMETRY_PERIOD_MS + 1);
+}
+
+/**************************************************************************//**
+* @fn		static void TestStandby(void)
+* @brief	With the IDLE_0 lock released the MCU sleeps in standby, where the wake up timer keeps counting
+*****************************************************************************/
+static void TestStandby(void)
+{
+	const struct HostTicklessStats *model = HostTicklessGetStats();
+	PowerManagerStats stats;
+
+	FirmwareMix(true);
+	HostTicklessReset(tasks, TASK_COUNT, irqs, IRQ_COUNT);
+	PowerManagerInit();
+	sleepmgr_unlock_mode(POWER_SLEEP_MODE_LIMIT);
+	Run(RUN_MS, &stats);
+	CheckRun(&stats);
+
+	TEST_CHECK(stats.sleeps > 0);
+	TEST_CHECK_EQ(model->modeCycles[SYSTEM_SLEEPMODE_STANDBY], model->suppressedCycles);
+	TEST_CHECK(tasks[TASK_CONTROL].runs >= RUN_MS / (CONTROL_TELEMETRY_PERIOD_MS + 1));
+}
+
+/**************************************************************************//**
+* @fn		static void TestFirmwareMix(void)
+* @brief	The firmware's task mix: every task on time, the IMU only woken up by INT1
+*****************************************************************************/
+static void TestFirmwareMix(void)
+{
+	PowerManagerStats stats;
+
+	FirmwareMix(true);
+	HostTicklessReset(tasks, TASK_COUNT, irqs, IRQ_COUNT);
+	PowerManagerInit();
+	Run(RUN_MS, &stats);
+	CheckRun(&stats);
+
+	TEST_CHECK_EQ(tasks[TASK_IMU].timeouts, 0);
+	TEST_CHECK(tasks[TASK_IMU].runs == irqs[IRQ_IMU_INT1].count || tasks[TASK_IMU].runs == irqs[IRQ_IMU_INT1].count + 1);
+	TEST_CHECK(tasks[TASK_WIFI].runs >= RUN_MS / (WIFI_TASK_PERIOD_MS + 6));
+	TEST_CHECK(tasks[TASK_CONTROL].runs >= RUN_MS / (CONTROL_TELEMETRY_PERIOD_MS + 2));
+	TEST_CHECK(stats.early > 0);
+}
+
+static void BenchRun(const char *name, bool imu, bool allBlocked)
+{
+	const struct HostTicklessStats *model = HostTicklessGetStats();
+	PowerManagerStats stats;
+	double seconds;
+
+	FirmwareMix(imu);
+	if(allBlocked) memset(tasks, 0, sizeof(tasks));
+	HostTicklessReset(tasks, TASK_COUNT, allBlocked ? NULL : irqs, allBlocked ? 0 : IRQ_COUNT);
+	PowerManagerInit();
+	Run(600000, &stats);
+	seconds = (double)model->totalCycles / HOST_CPU_HZ;
+	printf("bench: %s: asleep %.1f%% of the time (\"power\" says %.1f%%), CPU busy %.2f%%, awake with the tick %.1f%%, "
+		"%.1f sleeps per s, %.1f ended early, %.2f aborted, tick %.0f ppm behind\n",
+		name, model->suppressedCycles * 100.0 / model->totalCycles, stats.sleptTicks * 100.0 / stats.ticks,
+		model->busyCycles * 100.0 / model->totalCycles, model->tickIdleCycles * 100.0 / model->totalCycles, stats.sleeps / seconds,
+		stats.early / seconds, stats.aborts / seconds,
+		((double)model->totalCycles - (double)hostTickCount * HOST_TICK_CYCLES) * 1e6 / model->totalCycles);
+}
+
+int main(void)
+{
+	TestAllBlocked();
+	TestPeriodic();
+	TestEarlyWake();
+	TestAbort();
+	TestActiveLock();
+	TestStandby();
+	TestFirmwareMix();
+
+	BenchRun("firmware tasks", true, false);
+	BenchRun("firmware tasks without the IMU", false, false);
+	BenchRun("every task blocked", false, true);
+	return TEST_RESULT();
+}
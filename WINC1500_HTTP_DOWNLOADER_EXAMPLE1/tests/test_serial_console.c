@@ -0,0 +1,183 @@
+/**************************************************************************//**
+* @file      test_serial_console.c
+* @brief     Host tests for the RX path of SerialConsole.c, run against the simulated UART and terminal of host_console.c.
+The test reads the console the way the CLI task does: it blocks in SerialConsoleRead() for chunks of up to 32
+characters, echoes them, and spends some time on every complete line as a command would. The terminal pastes a script
+of several KB at 115200 baud, back to back. With XON/XOFF on, every byte must arrive, in order, however slow the
+commands are. The benchmark gives the script throughput in simulated time.
+
+******************************************************************************/
+
+#include "test.h"
+#include "host_console.h"
+#include "SerialConsole.h"
+
+#define CLI_RX_CHUNK_SIZE	32			///<Chunk read by the CLI task
+#define SCRIPT_MAX			16384
+#define READ_TIMEOUT		100			///<Ticks; the script is over when a read times out
+
+static uint8_t script[SCRIPT_MAX];
+static uint8_t received[SCRIPT_MAX];
+
+/**************************************************************************//**
+* @fn		static size_t MakeScript(size_t length)
+* @brief	Fills script with command lines ending in CR LF, about length bytes in all
+*****************************************************************************/
+static size_t MakeScript(size_t length)
+{
+	size_t pos = 0;
+
+	while(pos + 40 < length)
+	{
+		pos += (size_t)snprintf((char *)&script[pos], sizeof(script) - pos, "led %u %u %u %u\r\n", (unsigned)(TestRandom() % 16),
+			(unsigned)(TestRandom() % 256), (unsigned)(TestRandom() % 256), (unsigned)(TestRandom() % 256));
+	}
+	return pos;
+}
+
+/**************************************************************************//**
+* @fn		static size_t ReadLikeCli(uint32_t commandUs)
+* @brief	Reads the console until a read times out, echoing every chunk and spending commandUs on every line
+* @return	Number of characters read into received
+*****************************************************************************/
+static size_t ReadLikeCli(uint32_t commandUs)
+{
+	size_t total = 0;
+	uint8_t chunk[CLI_RX_CHUNK_SIZE + 1];
+	size_t count;
+
+	while((count = SerialConsoleRead(chunk, CLI_RX_CHUNK_SIZE, READ_TIMEOUT)) > 0)
+	{
+		if(total + count > sizeof(received)) break;
+		memcpy(&received[total], chunk, count);
+		total += count;
+
+		chunk[count] = 0;
+		SerialConsoleWriteString((char *)chunk);
+		for(size_t i = 0; i < count; i++)
+		{
+			if(chunk[i] == '\n') HostConsoleRunUntil(HostConsoleNowNs() + commandUs * 1000ULL);
+		}
+	}
+	return total;
+}
+
+/**************************************************************************//**
+* @fn		static void TestScript(size_t length, uint32_t commandUs)
+* @brief	A pasted script arrives whole and in order, with XOFF sent whenever the commands fall behind
+*****************************************************************************/
+static void TestScript(size_t length, uint32_t commandUs)
+{
+	SerialConsoleRxStats before, after;
+	struct HostConsoleStats terminal = *HostConsoleGetStats();
+	size_t scriptLength = MakeScript(length);
+
+	SerialConsoleGetRxStats(&before);
+	HostConsoleClearOutput();
+	HostConsoleType(script, scriptLength, true);
+	size_t total = ReadLikeCli(commandUs);
+	SerialConsoleGetRxStats(&after);
+
+	TEST_CHECK(!HostConsoleTyping());
+	TEST_CHECK_EQ(total, scriptLength);
+	TEST_CHECK(memcmp(received, script, scriptLength) == 0);
+	TEST_CHECK_EQ(after.received - before.received, scriptLength);
+	TEST_CHECK_EQ(after.dropped - before.dropped, 0);
+	TEST_CHECK_EQ(HostConsoleGetStats()->overflows - terminal.overflows, 0);
+	if(commandUs > 0)
+	{
+		//A command takes longer than its line takes to arrive: the terminal must have been held back
+		TEST_CHECK(after.xoffs > before.xoffs);
+	}
+	TEST_CHECK_EQ(HostConsoleGetStats()->xoffs - terminal.xoffs, after.xoffs - before.xoffs);
+	TEST_CHECK_EQ(HostConsoleGetStats()->xons - terminal.xons, after.xoffs - before.xoffs);
+
+	//The echo is the script
+	size_t outputLength;
+	const uint8_t *output = HostConsoleOutput(&outputLength);
+	TEST_CHECK_EQ(outputLength, scriptLength);
+	TEST_CHECK(memcmp(output, script, scriptLength) == 0);
+}
+
+/**************************************************************************//**
+* @fn		static void TestNoFlowControl(void)
+* @brief	A terminal that ignores XOFF outruns slow commands; every byte it sends is either read or counted as dropped
+*****************************************************************************/
+static void TestNoFlowControl(void)
+{
+	SerialConsoleRxStats before, after;
+	size_t scriptLength = MakeScript(4096);
+
+	SerialConsoleGetRxStats(&before);
+	HostConsoleType(script, scriptLength, false);
+	size_t total = ReadLikeCli(5000);
+	SerialConsoleGetRxStats(&after);
+
+	TEST_CHECK_EQ(after.received - before.received, scriptLength);
+	TEST_CHECK(after.dropped > before.dropped);
+	TEST_CHECK_EQ(total + (after.dropped - before.dropped), scriptLength);
+	TEST_CHECK(after.xoffs > before.xoffs);
+
+	//Let the XON that follows the drain reach the terminal
+	HostConsoleRunUntil(HostConsoleNowNs() + 1000000ULL);
+}
+
+/**************************************************************************//**
+* @fn		static void TestKeystroke(void)
+* @brief	A reader blocked with a long timeout gets a keystroke as soon as it is in, not on a polling period
+*****************************************************************************/
+static void TestKeystroke(void)
+{
+	static const uint8_t key[] = "x";
+	uint8_t chunk[CLI_RX_CHUNK_SIZE];
+	uint64_t start = HostConsoleNowNs();
+
+	HostConsoleType(key, 1, true);
+	TEST_CHECK_EQ(SerialConsoleRead(chunk, sizeof(chunk), 1000), 1);
+	TEST_CHECK_EQ(chunk[0], 'x');
+	TEST_CHECK(HostConsoleNowNs() - start <= 2 * HostConsoleByteNs());
+
+	//Nothing typed: the read times out
+	start = HostConsoleNowNs();
+	TEST_CHECK_EQ(SerialConsoleRead(chunk, sizeof(chunk), 50), 0);
+	TEST_CHECK(HostConsoleNowNs() - start >= 49000000ULL);
+}
+
+static void Bench(uint32_t commandUs)
+{
+	SerialConsoleRxStats before, after;
+	size_t scriptLength = MakeScript(SCRIPT_MAX - 64);
+	uint64_t start = HostConsoleNowNs();
+	double t0 = TestSeconds();
+
+	SerialConsoleGetRxStats(&before);
+	HostConsoleType(script, scriptLength, true);
+	size_t total = ReadLikeCli(commandUs);
+	double host = TestSeconds() - t0;
+	uint64_t ns = HostConsoleNowNs() - start - READ_TIMEOUT * 1000000ULL;
+	SerialConsoleGetRxStats(&after);
+
+	printf("bench: %zu byte script, %u us per command: %.0f B/s (%.0f%% of the line rate), %lu XOFF, %lu dropped, "
+		"%.0f ns host per byte\n", total, (unsigned)commandUs, total * 1e9 / (double)ns,
+		100.0 * total * HostConsoleByteNs() / (double)ns, (unsigned long)(after.xoffs - before.xoffs),
+		(unsigned long)(after.dropped - before.dropped), host * 1e9 / (double)total);
+}
+
+int main(void)
+{
+	HostConsoleReset();
+	HostRtosSetWait(HostConsoleWait);
+	InitializeSerialConsole();
+
+	TestKeystroke();
+	TestScript(8192, 0);
+	TestScript(8192, 5000);
+	TestScript(SCRIPT_MAX - 64, 20000);
+	TestNoFlowControl();
+	TestScript(2048, 5000);
+
+	Bench(0);
+	Bench(2000);
+	Bench(10000);
+	return TEST_RESULT();
+}
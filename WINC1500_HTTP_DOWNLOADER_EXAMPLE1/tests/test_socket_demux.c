@@ -0,0 +1,667 @@
+/**************************************************************************//**
+* @file      test_socket_demux.c
+* @brief     Host tests for SocketDemux.c with the real HTTP client and MQTT stack on the simulated WINC of host_winc.c.
+A file server and an MQTT broker live on the simulated network. The test downloads files while it publishes MQTT
+messages that the broker echoes back, the way the Wi-Fi task would: each stack waits on m2m_wifi_handle_events() and
+so runs the events of the other. Every socket event must reach the stack that owns the socket, every DNS reply the
+stacks waiting for that host, and both transfers must arrive whole. The broker drops the MQTT connection once the
+download sockets have gone round, so the MQTT stack reconnects on a socket number the HTTP client had before.
+The benchmark gives the download time with and without MQTT traffic, and the cost of dispatching one event.
+
+******************************************************************************/
+
+#include "test.h"
+#include <stdlib.h>
+#include <errno.h>
+#include "host_winc.h"
+#include "iot/http/http_client.h"
+#include "MQTTClient/Wrapper/mqtt.h"
+#include "WifiHandlerThread/SocketDemux.h"
+#include "SerialConsole/SerialConsole.h"
+
+#define FILE_HOST			"files.example"
+#define FILE_IP				HOST_WINC_IP(10, 0, 0, 2)
+#define BROKER_HOST			"broker.example"
+#define BROKER_IP			HOST_WINC_IP(10, 0, 0, 3)
+#define PROBE_HOST			"probe.example"
+#define PROBE_IP			HOST_WINC_IP(10, 0, 0, 4)
+#define FILE_SIZE			(64 * 1024)
+#define ECHO_TOPIC			"ese516/echo"
+#define MQTT_BUFFER_SIZE	512			///<MAIN_MQTT_BUFFER_SIZE of WifiHandler.h
+#define HTTP_BUFFER_SIZE	512			///<MAIN_BUFFER_MAX_SIZE of WifiHandler.h
+#define REUSE_DOWNLOADS		8			///<Downloads of TestSocketReuse: enough for the socket numbers to go round
+#define DROP_DOWNLOAD		7			///<Download during which the broker drops the MQTT connection
+
+enum { SERVICE_HTTP, SERVICE_MQTT, SERVICE_PROBE_A, SERVICE_PROBE_B, SERVICE_COUNT };
+
+//What the demultiplexer gave a service
+struct ServiceTrace
+{
+	uint32_t ownsCalls;			///<Calls of its ownsSocket
+	uint32_t events;			///<Socket events
+	uint32_t misrouted;			///<Socket events for a socket it does not own
+	uint32_t resolves;			///<DNS replies
+	uint32_t lastIp;			///<Address of the last DNS reply
+	bool waiting;				///<For the probes: true while waiting for PROBE_HOST
+};
+
+static struct ServiceTrace traces[SERVICE_COUNT];
+static int lastService = -1;	///<Service of the last socket event
+static uint32_t switches;		///<Socket events that went to another service than the one before
+static uint32_t nobodyLogs;		///<DNS replies that nobody waited for
+
+static struct sw_timer_module timers;
+static struct http_client_module http;
+static struct mqtt_module mqtt;
+static unsigned char mqttReadBuffer[MQTT_BUFFER_SIZE];
+static unsigned char mqttSendBuffer[MQTT_BUFFER_SIZE];
+static uint32_t httpSockets;	///<Bit of every socket number the HTTP client connected with
+
+//Download in progress
+static struct
+{
+	uint32_t file;
+	uint32_t received;			///<Bytes of the file received
+	uint32_t wrong;				///<Bytes that differ from the file
+	int responseCode;
+	bool complete;
+	bool disconnected;
+	int reason;					///<Reason of the disconnection
+} download;
+
+//MQTT messages echoed by the broker
+static uint32_t messageNext;	///<Number the next message published carries
+static uint32_t echoNext;		///<Number the next echo must carry
+static uint32_t echoes;
+static uint32_t echoesOutOfOrder;
+
+/******************************************************************************
+* Simulated network
+******************************************************************************/
+static struct
+{
+	char request[512];
+	uint16_t length;
+} httpPeers[MAX_SOCKET];
+
+static uint8_t FileByte(uint32_t file, uint32_t offset)
+{
+	return (uint8_t)(offset * 31 + file * 7 + (offset >> 9));
+}
+
+/**************************************************************************//**
+* @fn		static void FileServerReceived(SOCKET sock, const uint8_t *data, uint16_t length)
+* @brief	Answers GET /file<N>.bin with FILE_SIZE bytes of file N, then lets the client close
+*****************************************************************************/
+static void FileServerReceived(SOCKET sock, const uint8_t *data, uint16_t length)
+{
+	static uint8_t body[FILE_SIZE];
+	char header[128];
+	unsigned file = 0;
+
+	TEST_CHECK(httpPeers[sock].length + length < sizeof(httpPeers[sock].request));
+	memcpy(&httpPeers[sock].request[httpPeers[sock].length], data, length);
+	httpPeers[sock].length += length;
+	httpPeers[sock].request[httpPeers[sock].length] = 0;
+	if(strstr(httpPeers[sock].request, "\r\n\r\n") == NULL) return;
+
+	TEST_CHECK_EQ(sscanf(httpPeers[sock].request, "GET /file%u.bin HTTP/1.1", &file), 1);
+	httpPeers[sock].length = 0;
+	for(uint32_t i = 0; i < FILE_SIZE; i++) body[i] = FileByte(file, i);
+	int headerLength = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+		(unsigned)FILE_SIZE);
+	HostWincPeerSend(sock, header, (uint32_t)headerLength);
+	HostWincPeerSend(sock, body, FILE_SIZE);
+}
+
+static void FileServerAccepted(SOCKET sock)
+{
+	httpPeers[sock].length = 0;
+}
+
+static const HostWincServer fileServer = {FILE_IP, 80, FileServerAccepted, FileServerReceived, NULL};
+
+static struct
+{
+	uint8_t in[1024];			///<Bytes received, up to the end of the last whole packet
+	uint16_t length;
+	bool subscribed;			///<true once the client subscribed to ECHO_TOPIC
+	SOCKET sock;				///<Connection of the client, -1 if none
+	uint32_t connects;
+} broker = {.sock = -1};
+
+static void BrokerPacket(const uint8_t *packet, uint16_t header, uint16_t remaining)
+{
+	const uint8_t *body = &packet[header];
+
+	switch(packet[0] >> 4)
+	{
+		case CONNECT:
+		{
+			static const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+			broker.connects++;
+			HostWincPeerSend(broker.sock, connack, sizeof(connack));
+			break;
+		}
+		case SUBSCRIBE:
+		{
+			uint8_t suback[] = {0x90, 0x03, body[0], body[1], 0x01};
+			broker.subscribed = true;
+			HostWincPeerSend(broker.sock, suback, sizeof(suback));
+			break;
+		}
+		case PUBLISH:
+		{
+			uint8_t qos = (packet[0] >> 1) & 3;
+			uint16_t topicLength = (uint16_t)((body[0] << 8) | body[1]);
+			uint16_t payload = (uint16_t)(2 + topicLength + ((qos > 0) ? 2 : 0));
+			uint8_t echo[128];
+
+			if(qos > 0)
+			{
+				uint8_t puback[] = {0x40, 0x02, body[2 + topicLength], body[3 + topicLength]};
+				HostWincPeerSend(broker.sock, puback, sizeof(puback));
+			}
+			if(broker.subscribed)
+			{
+				//Same topic and payload, at QoS 0
+				uint16_t length = (uint16_t)(2 + topicLength + remaining - payload);
+				TEST_CHECK(length < 128);
+				echo[0] = 0x30;
+				echo[1] = (uint8_t)length;
+				memcpy(&echo[2], body, 2 + topicLength);
+				memcpy(&echo[4 + topicLength], &body[payload], remaining - payload);
+				HostWincPeerSend(broker.sock, echo, (uint32_t)(2 + length));
+			}
+			break;
+		}
+		case PINGREQ:
+		{
+			static const uint8_t pingresp[] = {0xD0, 0x00};
+			HostWincPeerSend(broker.sock, pingresp, sizeof(pingresp));
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void BrokerReceived(SOCKET sock, const uint8_t *data, uint16_t length)
+* @brief	Takes the bytes of the client and answers every whole packet
+*****************************************************************************/
+static void BrokerReceived(SOCKET sock, const uint8_t *data, uint16_t length)
+{
+	TEST_CHECK_EQ(sock, broker.sock);
+	TEST_CHECK(broker.length + length <= sizeof(broker.in));
+	memcpy(&broker.in[broker.length], data, length);
+	broker.length += length;
+
+	for(;;)
+	{
+		uint16_t header = 1;
+		uint32_t remaining = 0, multiplier = 1;
+
+		do
+		{
+			if(header >= broker.length) return;
+			remaining += (broker.in[header] & 127u) * multiplier;
+			multiplier *= 128;
+		} while(broker.in[header++] & 128);
+		if(header + remaining > broker.length) return;
+
+		BrokerPacket(broker.in, header, (uint16_t)remaining);
+		broker.length = (uint16_t)(broker.length - header - remaining);
+		memmove(broker.in, &broker.in[header + remaining], broker.length);
+	}
+}
+
+static void BrokerAccepted(SOCKET sock)
+{
+	broker.sock = sock;
+	broker.length = 0;
+	broker.subscribed = false;
+}
+
+static void BrokerClosed(SOCKET sock)
+{
+	if(sock == broker.sock) broker.sock = -1;
+}
+
+static const HostWincServer brokerServer = {BROKER_IP, 1883, BrokerAccepted, BrokerReceived, BrokerClosed};
+
+/******************************************************************************
+* Services
+******************************************************************************/
+void LogMessage(enum eDebugLogLevels level, const char *format, ...)
+{
+	if(level == LOG_DEBUG_LVL && strstr(format, "nobody waiting") != NULL) nobodyLogs++;
+}
+
+static void Trace(int service, bool owned)
+{
+	traces[service].events++;
+	if(!owned) traces[service].misrouted++;
+	if(lastService >= 0 && lastService != service) switches++;
+	lastService = service;
+}
+
+static bool HttpOwnsSocket(SOCKET sock)
+{
+	traces[SERVICE_HTTP].ownsCalls++;
+	return http_client_is_socket(sock);
+}
+
+static void HttpEvent(SOCKET sock, uint8_t msg, void *data)
+{
+	Trace(SERVICE_HTTP, http_client_is_socket(sock));
+	http_client_socket_event_handler(sock, msg, data);
+}
+
+static void HttpResolve(uint8_t *host, uint32_t ip)
+{
+	traces[SERVICE_HTTP].resolves++;
+	traces[SERVICE_HTTP].lastIp = ip;
+	http_client_socket_resolve_handler(host, ip);
+}
+
+static bool MqttOwnsSocket(SOCKET sock)
+{
+	traces[SERVICE_MQTT].ownsCalls++;
+	return mqtt_is_socket(sock);
+}
+
+static void MqttEvent(SOCKET sock, uint8_t msg, void *data)
+{
+	Trace(SERVICE_MQTT, mqtt_is_socket(sock));
+	mqtt_socket_event_handler(sock, msg, data);
+}
+
+static void MqttResolve(uint8_t *host, uint32_t ip)
+{
+	traces[SERVICE_MQTT].resolves++;
+	traces[SERVICE_MQTT].lastIp = ip;
+	mqtt_socket_resolve_handler(host, ip);
+}
+
+//Services that own no socket and wait for PROBE_HOST
+static bool ProbeOwnsSocket(SOCKET sock)
+{
+	(void)sock;
+	return false;
+}
+
+static bool ProbeAOwnsHost(const uint8_t *host)
+{
+	return traces[SERVICE_PROBE_A].waiting && strcmp((const char *)host, PROBE_HOST) == 0;
+}
+
+static bool ProbeBOwnsHost(const uint8_t *host)
+{
+	return traces[SERVICE_PROBE_B].waiting && strcmp((const char *)host, PROBE_HOST) == 0;
+}
+
+static void ProbeEvent(SOCKET sock, uint8_t msg, void *data)
+{
+	(void)sock;
+	(void)msg;
+	(void)data;
+	Trace(SERVICE_PROBE_A, false);
+}
+
+static void ProbeResolve(uint8_t *host, uint32_t ip, int service)
+{
+	(void)host;
+	traces[service].resolves++;
+	traces[service].lastIp = ip;
+	traces[service].waiting = false;
+}
+
+static void ProbeAResolve(uint8_t *host, uint32_t ip)
+{
+	ProbeResolve(host, ip, SERVICE_PROBE_A);
+}
+
+static void ProbeBResolve(uint8_t *host, uint32_t ip)
+{
+	ProbeResolve(host, ip, SERVICE_PROBE_B);
+}
+
+static const SocketDemuxService services[SERVICE_COUNT] = {
+	{"http", HttpOwnsSocket, http_client_is_resolving, HttpEvent, HttpResolve},
+	{"mqtt", MqttOwnsSocket, mqtt_is_resolving, MqttEvent, MqttResolve},
+	{"probeA", ProbeOwnsSocket, ProbeAOwnsHost, ProbeEvent, ProbeAResolve},
+	{"probeB", ProbeOwnsSocket, ProbeBOwnsHost, ProbeEvent, ProbeBResolve},
+};
+
+/******************************************************************************
+* Stacks
+******************************************************************************/
+static void HttpCallback(struct http_client_module *module, int type, union http_client_data *data)
+{
+	switch(type)
+	{
+		case HTTP_CLIENT_CALLBACK_SOCK_CONNECTED:
+			httpSockets |= 1u << module->sock;
+			break;
+		case HTTP_CLIENT_CALLBACK_RECV_RESPONSE:
+			download.responseCode = (int)data->recv_response.response_code;
+			TEST_CHECK(data->recv_response.content == NULL);
+			TEST_CHECK_EQ(data->recv_response.content_length, FILE_SIZE);
+			break;
+		case HTTP_CLIENT_CALLBACK_RECV_CHUNKED_DATA:
+			for(uint32_t i = 0; i < data->recv_chunked_data.length; i++)
+			{
+				if((uint8_t)data->recv_chunked_data.data[i] != FileByte(download.file, download.received + i)) download.wrong++;
+			}
+			download.received += data->recv_chunked_data.length;
+			if(data->recv_chunked_data.is_complete) download.complete = true;
+			break;
+		case HTTP_CLIENT_CALLBACK_DISCONNECTED:
+			download.disconnected = true;
+			download.reason = data->disconnected.reason;
+			break;
+		default:
+			break;
+	}
+}
+
+static void StartDownload(const char *host, uint32_t file)
+{
+	char url[64];
+
+	memset(&download, 0, sizeof(download));
+	download.file = file;
+	snprintf(url, sizeof(url), "http://%s/file%u.bin", host, (unsigned)file);
+	TEST_CHECK_EQ(http_client_send_request(&http, url, HTTP_METHOD_GET, NULL, NULL), 0);
+}
+
+static void EchoHandler(MessageData *data)
+{
+	char text[16] = {0};
+
+	memcpy(text, data->message->payload, (data->message->payloadlen < 15) ? data->message->payloadlen : 15);
+	if((uint32_t)strtoul(text, NULL, 10) != echoNext) echoesOutOfOrder++;
+	echoNext = (uint32_t)strtoul(text, NULL, 10) + 1;
+	echoes++;
+}
+
+static bool MqttConnect(void)
+{
+	return mqtt_connect(&mqtt, BROKER_HOST) == SOCK_ERR_NO_ERROR &&
+		mqtt_connect_broker(&mqtt, 1, NULL, NULL, "ese516", NULL, NULL, 0, 0, 0) == SUCCESS &&
+		mqtt_subscribe(&mqtt, ECHO_TOPIC, 1, EchoHandler) == SUCCESS;
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t PublishUntilDownloaded(uint32_t dropAt)
+* @brief	Publishes numbered messages at QoS 1 and reads their echoes until the download is over, as the Wi-Fi task
+*			would. Reconnects if the broker drops the connection.
+* @param[in]	dropAt Bytes of the file after which the broker drops the connection, 0 for never
+* @return	Messages published
+*****************************************************************************/
+static uint32_t PublishUntilDownloaded(uint32_t dropAt)
+{
+	uint32_t published = 0;
+	char text[16];
+
+	while(!download.disconnected)
+	{
+		if(dropAt > 0 && download.received >= dropAt && broker.sock >= 0)
+		{
+			HostWincPeerClose(broker.sock);
+			dropAt = 0;
+		}
+		if(!mqtt.isConnected)
+		{
+			//Echoes lost with the connection are not coming back
+			TEST_CHECK(MqttConnect());
+			echoNext = messageNext;
+		}
+
+		snprintf(text, sizeof(text), "%lu", (unsigned long)messageNext);
+		if(mqtt_publish(&mqtt, ECHO_TOPIC, text, (uint32_t)strlen(text), 1, 0) == SUCCESS)
+		{
+			messageNext++;
+			published++;
+		}
+		mqtt_yield(&mqtt, 5);
+		sw_timer_task(&timers);
+	}
+
+	//The last echoes
+	for(int i = 0; i < 10 && echoes < published && mqtt.isConnected; i++) mqtt_yield(&mqtt, 10);
+	return published;
+}
+
+static void RunUntilDownloaded(void)
+{
+	while(!download.disconnected)
+	{
+		m2m_wifi_handle_events(NULL);
+		sw_timer_task(&timers);
+	}
+}
+
+/******************************************************************************
+* Tests
+******************************************************************************/
+
+/**************************************************************************//**
+* @fn		static void TestRegister(void)
+* @brief	Incomplete services are refused, and the table holds SOCKET_DEMUX_MAX_SERVICES services
+*****************************************************************************/
+static void TestRegister(void)
+{
+	SocketDemuxService incomplete = services[SERVICE_HTTP];
+
+	incomplete.resolveHandler = NULL;
+	TEST_CHECK_EQ(SocketDemuxRegister(NULL), STATUS_ERR_INVALID_ARG);
+	TEST_CHECK_EQ(SocketDemuxRegister(&incomplete), STATUS_ERR_INVALID_ARG);
+	for(int i = 0; i < SERVICE_COUNT; i++) TEST_CHECK_EQ(SocketDemuxRegister(&services[i]), STATUS_OK);
+	TEST_CHECK_EQ(SocketDemuxRegister(&services[SERVICE_HTTP]), STATUS_ERR_NO_MEMORY);
+	registerSocketCallback(SocketDemuxEventHandler, SocketDemuxResolveHandler);
+}
+
+/**************************************************************************//**
+* @fn		static void CheckRouting(void)
+* @brief	Every socket event the WINC delivered went to the service that owns the socket, and only there
+*****************************************************************************/
+static void CheckRouting(void)
+{
+	const struct HostWincStats *stats = HostWincGetStats();
+
+	TEST_CHECK_EQ(traces[SERVICE_HTTP].misrouted, 0);
+	TEST_CHECK_EQ(traces[SERVICE_MQTT].misrouted, 0);
+	TEST_CHECK_EQ(traces[SERVICE_PROBE_A].events, 0);
+	TEST_CHECK_EQ(stats->events, traces[SERVICE_HTTP].events + traces[SERVICE_MQTT].events);
+}
+
+/**************************************************************************//**
+* @fn		static double TestConcurrent(uint32_t *published)
+* @brief	The MQTT stack connects and echoes messages while a download runs, each on its own socket
+* @param[out]	published Messages published during the download
+* @return	Time the download took, in ms
+*****************************************************************************/
+static double TestConcurrent(uint32_t *published)
+{
+	uint64_t start = HostWincNowNs();
+	uint32_t echoesBefore;
+
+	//Both stacks resolve their host at the same time: each reply must reach its own stack
+	StartDownload(FILE_HOST, 0);
+	TEST_CHECK(MqttConnect());
+	TEST_CHECK_EQ(traces[SERVICE_HTTP].resolves, 1);
+	TEST_CHECK_EQ(traces[SERVICE_HTTP].lastIp, FILE_IP);
+	TEST_CHECK_EQ(traces[SERVICE_MQTT].resolves, 1);
+	TEST_CHECK_EQ(traces[SERVICE_MQTT].lastIp, BROKER_IP);
+	TEST_CHECK(!download.complete);
+
+	echoesBefore = echoes;
+	*published = PublishUntilDownloaded(0);
+	double ms = (double)(HostWincNowNs() - start) / 1e6;
+
+	TEST_CHECK_EQ(download.responseCode, 200);
+	TEST_CHECK(download.complete);
+	TEST_CHECK_EQ(download.received, FILE_SIZE);
+	TEST_CHECK_EQ(download.wrong, 0);
+	TEST_CHECK_EQ(download.reason, 0);
+	TEST_CHECK(*published > 10);
+	TEST_CHECK_EQ(echoes - echoesBefore, *published);
+	TEST_CHECK_EQ(echoesOutOfOrder, 0);
+	TEST_CHECK(mqtt.isConnected);
+	//The stacks took turns, not one after the other
+	TEST_CHECK(switches > 20);
+	CheckRouting();
+	return ms;
+}
+
+/**************************************************************************//**
+* @fn		static void TestSocketReuse(void)
+* @brief	The download sockets go round. The broker drops MQTT, which reconnects on a number HTTP had used: its events
+*			must reach MQTT although the cached owner of the socket is HTTP.
+*****************************************************************************/
+static void TestSocketReuse(void)
+{
+	SOCKET oldMqttSocket = (SOCKET)mqtt.network.socket;
+	uint32_t connects = broker.connects;
+
+	for(uint32_t file = 1; file <= REUSE_DOWNLOADS; file++)
+	{
+		uint32_t echoesBefore = echoes;
+
+		StartDownload(FILE_HOST, file);
+		uint32_t published = PublishUntilDownloaded((file == DROP_DOWNLOAD) ? FILE_SIZE / 2 : 0);
+
+		TEST_CHECK(download.complete);
+		TEST_CHECK_EQ(download.received, FILE_SIZE);
+		TEST_CHECK_EQ(download.wrong, 0);
+		if(file != DROP_DOWNLOAD)
+		{
+			TEST_CHECK_EQ(echoes - echoesBefore, published);
+		}
+	}
+
+	TEST_CHECK_EQ(broker.connects, connects + 1);
+	TEST_CHECK(mqtt.isConnected);
+	TEST_CHECK(mqtt.network.socket != oldMqttSocket);
+	TEST_CHECK(httpSockets & (1u << mqtt.network.socket));
+	TEST_CHECK_EQ(echoesOutOfOrder, 0);
+	CheckRouting();
+
+	//Owners are cached: about one ownsSocket call per event
+	uint32_t calls = traces[SERVICE_HTTP].ownsCalls + traces[SERVICE_MQTT].ownsCalls;
+	uint32_t events = traces[SERVICE_HTTP].events + traces[SERVICE_MQTT].events;
+	TEST_CHECK(calls < events + events / 10);
+}
+
+/**************************************************************************//**
+* @fn		static void TestDns(void)
+* @brief	A DNS reply reaches every service waiting for the host and no other; one nobody waits for is logged;
+*			an unknown host fails the download only
+*****************************************************************************/
+static void TestDns(void)
+{
+	const struct HostWincStats *stats = HostWincGetStats();
+	uint32_t resolves = stats->resolves;
+	uint32_t httpResolves = traces[SERVICE_HTTP].resolves, mqttResolves = traces[SERVICE_MQTT].resolves;
+
+	traces[SERVICE_PROBE_A].waiting = traces[SERVICE_PROBE_B].waiting = true;
+	gethostbyname((uint8 *)PROBE_HOST);
+	while(stats->resolves == resolves) m2m_wifi_handle_events(NULL);
+	TEST_CHECK_EQ(traces[SERVICE_PROBE_A].resolves, 1);
+	TEST_CHECK_EQ(traces[SERVICE_PROBE_A].lastIp, PROBE_IP);
+	TEST_CHECK_EQ(traces[SERVICE_PROBE_B].resolves, 1);
+	TEST_CHECK_EQ(traces[SERVICE_PROBE_B].lastIp, PROBE_IP);
+
+	//Nobody waits any more
+	resolves = stats->resolves;
+	gethostbyname((uint8 *)PROBE_HOST);
+	while(stats->resolves == resolves) m2m_wifi_handle_events(NULL);
+	TEST_CHECK_EQ(traces[SERVICE_PROBE_A].resolves, 1);
+	TEST_CHECK_EQ(traces[SERVICE_PROBE_B].resolves, 1);
+	TEST_CHECK_EQ(nobodyLogs, 1);
+	TEST_CHECK_EQ(traces[SERVICE_HTTP].resolves, httpResolves);
+	TEST_CHECK_EQ(traces[SERVICE_MQTT].resolves, mqttResolves);
+
+	//Unknown host: the download fails, MQTT keeps going
+	StartDownload("nowhere.example", 0);
+	RunUntilDownloaded();
+	TEST_CHECK_EQ(download.reason, -EHOSTUNREACH);
+	TEST_CHECK_EQ(traces[SERVICE_HTTP].resolves, httpResolves + 1);
+	TEST_CHECK_EQ(traces[SERVICE_HTTP].lastIp, 0);
+	uint32_t echoesBefore = echoes;
+	char text[16];
+	snprintf(text, sizeof(text), "%lu", (unsigned long)messageNext++);
+	TEST_CHECK_EQ(mqtt_publish(&mqtt, ECHO_TOPIC, text, (uint32_t)strlen(text), 1, 0), SUCCESS);
+	mqtt_yield(&mqtt, 10);
+	TEST_CHECK_EQ(echoes, echoesBefore + 1);
+	CheckRouting();
+}
+
+static void Bench(double concurrentMs, uint32_t published)
+{
+	uint64_t start = HostWincNowNs();
+	const uint32_t calls = 2000000;
+	SOCKET owned = (SOCKET)mqtt.network.socket;
+	SOCKET unowned = MAX_SOCKET - 1;
+	uint32_t ownsCalls = traces[SERVICE_MQTT].ownsCalls;
+
+	StartDownload(FILE_HOST, 100);
+	RunUntilDownloaded();
+	double aloneMs = (double)(HostWincNowNs() - start) / 1e6;
+	TEST_CHECK_EQ(download.wrong, 0);
+	printf("bench: %u KB download: %.1f ms alone (%.0f KB/s), %.1f ms beside %lu MQTT round trips (%.0f per s)\n",
+		FILE_SIZE / 1024, aloneMs, FILE_SIZE / aloneMs * 1000.0 / 1024.0, concurrentMs, (unsigned long)published,
+		published * 1000.0 / concurrentMs);
+
+	//An event type no stack handles, so only the dispatch is measured
+	double t0 = TestSeconds();
+	for(uint32_t i = 0; i < calls; i++) SocketDemuxEventHandler(owned, 0, NULL);
+	double cached = (TestSeconds() - t0) * 1e9 / calls;
+	TEST_CHECK_EQ(traces[SERVICE_MQTT].ownsCalls - ownsCalls, calls);
+	t0 = TestSeconds();
+	for(uint32_t i = 0; i < calls; i++) SocketDemuxEventHandler(unowned, 0, NULL);
+	double scanned = (TestSeconds() - t0) * 1e9 / calls;
+	printf("bench: dispatch: %.1f ns per event to a cached owner, %.1f ns for a socket nobody owns (%d services asked)\n",
+		cached, scanned, SERVICE_COUNT);
+}
+
+int main(void)
+{
+	struct sw_timer_config timerConfig;
+	struct http_client_config httpConfig;
+	struct mqtt_config mqttConfig;
+	uint32_t published;
+
+	HostWincAddHost(FILE_HOST, FILE_IP);
+	HostWincAddHost(BROKER_HOST, BROKER_IP);
+	HostWincAddHost(PROBE_HOST, PROBE_IP);
+	HostWincListen(&fileServer);
+	HostWincListen(&brokerServer);
+
+	//As WifiHandler.c sets the stacks up
+	sw_timer_get_config_defaults(&timerConfig);
+	sw_timer_init(&timers, &timerConfig);
+	sw_timer_enable(&timers);
+	http_client_get_config_defaults(&httpConfig);
+	httpConfig.recv_buffer_size = HTTP_BUFFER_SIZE;
+	httpConfig.timer_inst = &timers;
+	TEST_CHECK_EQ(http_client_init(&http, &httpConfig), 0);
+	http_client_register_callback(&http, HttpCallback);
+	mqtt_get_config_defaults(&mqttConfig);
+	mqttConfig.read_buffer = mqttReadBuffer;
+	mqttConfig.send_buffer = mqttSendBuffer;
+	mqttConfig.read_buffer_size = MQTT_BUFFER_SIZE;
+	mqttConfig.send_buffer_size = MQTT_BUFFER_SIZE;
+	TEST_CHECK_EQ(mqtt_init(&mqtt, &mqttConfig), SUCCESS);
+	socketInit();
+
+	TestRegister();
+	double concurrentMs = TestConcurrent(&published);
+	TestSocketReuse();
+	TestDns();
+
+	Bench(concurrentMs, published);
+	return TEST_RESULT();
+}
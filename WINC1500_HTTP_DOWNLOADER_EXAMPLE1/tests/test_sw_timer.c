@@ -0,0 +1,439 @@
+/**************************************************************************//**
+* @file      test_sw_timer.c
+* @brief     Host tests for the sw_timer wheel on a stub FreeRTOS tick: exact expiry of one shot and periodic timers,
+*			registration limits, and random operations on hundreds of timers across the 32 bit tick wrap.
+The random test keeps a model of every timer: the unit of accuracy it must fire in and its period. Callbacks check the
+model and sometimes enable, disable or unregister timers themselves. Time moves tick by tick, in late jumps, or by
+sleeping for what sw_timer_get_next_expiry() returns, the way the WiFi task waits. The benchmark compares one tick of
+the wheel with a scan of every timer, as the stock ASF timer did.
+
+******************************************************************************/
+
+#include "test.h"
+#include "iot/sw_timer.h"
+
+#define TIMER_COUNT		CONF_SW_TIMER_COUNT		///<Timers of the module, from the stub conf_sw_timer.h
+#define ACCURACY_MS		10						///<Accuracy of the module under test, in ms
+#define UNIT_TICKS		pdMS_TO_TICKS(ACCURACY_MS)	///<Ticks in one unit of accuracy
+#define ROUNDS			4						///<Random runs, each from its own tick before the wrap
+#define ROUND_OPS		400000					///<Random operations per run
+#define BENCH_TICKS		200000					///<Ticks timed by the benchmark
+
+//What a timer must do, as far as the test knows
+typedef struct TimerModel
+{
+	bool registered;	///<Registered and not unregistered since
+	bool enabled;		///<Callback enabled and not fired yet, or periodic
+	uint32_t period;	///<Period in units of accuracy, 0 for a one shot timer
+	uint32_t expire;	///<Unit of accuracy the timer fires in
+} TimerModel;
+
+static struct sw_timer_module timers;		///<Module under test
+static TimerModel model[TIMER_COUNT];		///<Model of every timer
+static uint32_t baseTick;					///<Tick of sw_timer_enable(), where unit 0 starts
+static uint32_t firedCount;					///<Callbacks run
+static int lastFired;						///<Timer of the last callback, -1 if none
+
+/**************************************************************************//**
+* @fn		static uint32_t CurrentUnit(void)
+* @brief	Unit of accuracy the stub tick is in
+*****************************************************************************/
+static uint32_t CurrentUnit(void)
+{
+	return (hostTickCount - baseTick) / UNIT_TICKS;
+}
+
+/**************************************************************************//**
+* @fn		static void Start(void)
+* @brief	Initializes and enables the module at the stub tick, with every timer unregistered
+*****************************************************************************/
+static void Start(void)
+{
+	struct sw_timer_config config;
+
+	sw_timer_get_config_defaults(&config);
+	config.accuracy = ACCURACY_MS;
+	sw_timer_init(&timers, &config);
+	sw_timer_enable(&timers);
+	baseTick = hostTickCount;
+	memset(model, 0, sizeof(model));
+	firedCount = 0;
+	lastFired = -1;
+}
+
+/**************************************************************************//**
+* @fn		static void RecordCallback(struct sw_timer_module *const module, int timer_id, void *context, int period)
+* @brief	Callback of the fixed tests: records which timer fired
+*****************************************************************************/
+static void RecordCallback(struct sw_timer_module *const module, int timer_id, void *context, int period)
+{
+	TEST_CHECK(module == &timers);
+	TEST_CHECK(context == &model[timer_id]);
+	TEST_CHECK_EQ(period, model[timer_id].period);
+	firedCount++;
+	lastFired = timer_id;
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t RunUntilFired(uint32_t maxTicks)
+* @brief	Moves the tick one at a time, calling sw_timer_task() each time, until a callback runs
+* @return	Ticks moved, or maxTicks + 1 if nothing fired
+*****************************************************************************/
+static uint32_t RunUntilFired(uint32_t maxTicks)
+{
+	uint32_t fired = firedCount;
+
+	for(uint32_t ticks = 1; ticks <= maxTicks; ticks++)
+	{
+		hostTickCount++;
+		sw_timer_task(&timers);
+		if(firedCount != fired) return ticks;
+	}
+	return maxTicks + 1;
+}
+
+/**************************************************************************//**
+* @fn		static void TestExpiry(void)
+* @brief	One shot and periodic timers fire in the unit after their delay has passed, also across the tick wrap,
+*			and sw_timer_get_next_expiry() gives the wait exactly
+*****************************************************************************/
+static void TestExpiry(void)
+{
+	int once, every;
+
+	//Five ticks into a unit, so the delay counts from the unit the timer was enabled in
+	hostTickCount = 0xFFFFFFFFUL - 40;
+	Start();
+	once = sw_timer_register_callback(&timers, RecordCallback, &model[0], 0);
+	every = sw_timer_register_callback(&timers, RecordCallback, &model[1], 50);
+	TEST_CHECK_EQ(once, 0);
+	TEST_CHECK_EQ(every, 1);
+	model[1].period = 50 / ACCURACY_MS;
+	TEST_CHECK_EQ(sw_timer_get_next_expiry(&timers), SW_TIMER_NO_EXPIRY);
+
+	hostTickCount += 5;
+	sw_timer_enable_callback(&timers, once, 100);
+	TEST_CHECK_EQ(sw_timer_get_next_expiry(&timers), 11 * UNIT_TICKS - 5);
+	TEST_CHECK_EQ(RunUntilFired(1000), 11 * UNIT_TICKS - 5);
+	TEST_CHECK_EQ(lastFired, once);
+	TEST_CHECK(hostTickCount < baseTick);
+	TEST_CHECK_EQ(RunUntilFired(1000), 1001);
+	TEST_CHECK_EQ(sw_timer_get_next_expiry(&timers), SW_TIMER_NO_EXPIRY);
+
+	sw_timer_enable_callback(&timers, every, 0);
+	TEST_CHECK_EQ(RunUntilFired(1000), UNIT_TICKS);
+	for(int i = 0; i < 5; i++)
+	{
+		TEST_CHECK_EQ(sw_timer_get_next_expiry(&timers), 5 * UNIT_TICKS);
+		TEST_CHECK_EQ(RunUntilFired(1000), 5 * UNIT_TICKS);
+		TEST_CHECK_EQ(lastFired, every);
+	}
+	sw_timer_disable_callback(&timers, every);
+	TEST_CHECK_EQ(RunUntilFired(1000), 1001);
+
+	//A timer far beyond the wheel is parked on its top level and still fires on time
+	sw_timer_enable_callback(&timers, once, 600000);
+	TEST_CHECK_EQ(RunUntilFired(700000), 60001 * UNIT_TICKS);
+	TEST_CHECK_EQ(lastFired, once);
+
+	//Late calls catch up and fire every unit that was missed, each in its own unit
+	sw_timer_enable_callback(&timers, every, 0);
+	hostTickCount += 100 * UNIT_TICKS;
+	sw_timer_task(&timers);
+	TEST_CHECK_EQ(firedCount, 6 + 1 + 1 + 20);
+	TEST_CHECK_EQ(RunUntilFired(1000), UNIT_TICKS);
+
+	//Registration stops at CONF_SW_TIMER_COUNT and reuses the lowest free entry
+	sw_timer_unregister_callback(&timers, every);
+	for(int i = 1; i < TIMER_COUNT; i++) TEST_CHECK_EQ(sw_timer_register_callback(&timers, RecordCallback, NULL, 0), i);
+	TEST_CHECK_EQ(sw_timer_register_callback(&timers, RecordCallback, NULL, 0), -1);
+	sw_timer_unregister_callback(&timers, 7);
+	TEST_CHECK_EQ(sw_timer_register_callback(&timers, RecordCallback, NULL, 0), 7);
+	TEST_CHECK_EQ(RunUntilFired(1000), 1001);
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t RandomDelay(void)
+* @brief	Delay in ms: mostly within level 0, some on the upper levels, a few beyond the whole wheel
+*****************************************************************************/
+static uint32_t RandomDelay(void)
+{
+	uint32_t r = TestRandom();
+
+	switch(r % 16)
+	{
+		case 15:
+			return 330000 + (r >> 4) % 200000;
+		case 14:
+			return (r >> 4) % 330000;
+		case 13:
+		case 12:
+		case 11:
+			return (r >> 4) % 10000;
+		default:
+			return (r >> 4) % 320;
+	}
+}
+
+static void ModelCallback(struct sw_timer_module *const module, int timer_id, void *context, int period);
+
+/**************************************************************************//**
+* @fn		static void RandomOp(void)
+* @brief	Enables, disables, unregisters or registers a random timer, in the module and in the model
+*****************************************************************************/
+static void RandomOp(void)
+{
+	uint32_t r = TestRandom();
+	int id = (r >> 8) % TIMER_COUNT;
+	TimerModel *timer = &model[id];
+	uint32_t ms;
+	int slot;
+
+	switch(r % 6)
+	{
+		case 0:
+		case 1:
+		case 2:
+			if(!timer->registered) break;
+			ms = RandomDelay();
+			sw_timer_enable_callback(&timers, id, ms);
+			timer->enabled = true;
+			timer->expire = CurrentUnit() + ms / ACCURACY_MS + 1;
+			break;
+
+		case 3:
+			if(!timer->registered) break;
+			sw_timer_disable_callback(&timers, id);
+			timer->enabled = false;
+			break;
+
+		default:
+			if(timer->registered)
+			{
+				sw_timer_unregister_callback(&timers, id);
+				timer->registered = false;
+				timer->enabled = false;
+				break;
+			}
+			for(slot = 0; slot < TIMER_COUNT && model[slot].registered; slot++);
+			ms = (r & 0x80) ? 0 : RandomDelay();
+			TEST_CHECK_EQ(sw_timer_register_callback(&timers, ModelCallback, &model[slot], ms), slot);
+			model[slot].registered = true;
+			model[slot].enabled = false;
+			model[slot].period = ms / ACCURACY_MS;
+			break;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void ModelCallback(struct sw_timer_module *const module, int timer_id, void *context, int period)
+* @brief	Callback of the random test: checks the timer was due in this unit, then sometimes changes timers itself
+*****************************************************************************/
+static void ModelCallback(struct sw_timer_module *const module, int timer_id, void *context, int period)
+{
+	TimerModel *timer = &model[timer_id];
+	uint32_t now = module->now;
+
+	TEST_CHECK(context == timer);
+	TEST_CHECK(timer->enabled);
+	TEST_CHECK_EQ(now, timer->expire);
+	TEST_CHECK_EQ(period, timer->period);
+	TEST_CHECK((int32_t)(hostTickCount - (baseTick + now * UNIT_TICKS)) >= 0);
+	firedCount++;
+
+	if(timer->period > 0) timer->expire = now + timer->period;
+	else timer->enabled = false;
+
+	switch(TestRandom() % 16)
+	{
+		case 0:
+			//Nested calls do nothing
+			sw_timer_task(module);
+			TEST_CHECK_EQ(module->now, now);
+			break;
+		case 1:
+		case 2:
+		case 3:
+			RandomOp();
+			break;
+		default:
+			break;
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void CheckModel(void)
+* @brief	Right after sw_timer_task(): nothing is overdue and every timer is enabled as the model says
+*****************************************************************************/
+static void CheckModel(void)
+{
+	uint32_t unit = CurrentUnit();
+	unsigned wrong = 0;
+
+	for(int id = 0; id < TIMER_COUNT; id++)
+	{
+		if(timers.handler[id].used != model[id].registered) wrong++;
+		if(timers.handler[id].callback_enable != model[id].enabled) wrong++;
+		if((timers.handler[id].list != SW_TIMER_NONE) != model[id].enabled) wrong++;
+		if(model[id].enabled && (int32_t)(model[id].expire - unit) <= 0) wrong++;
+	}
+	TEST_CHECK_EQ(wrong, 0);
+}
+
+/**************************************************************************//**
+* @fn		static uint32_t CheckNextExpiry(void)
+* @brief	sw_timer_get_next_expiry() never sleeps past a timer and only says "none" when no timer is enabled
+* @return	The value it gave
+*****************************************************************************/
+static uint32_t CheckNextExpiry(void)
+{
+	uint32_t next = sw_timer_get_next_expiry(&timers);
+	uint32_t soonest = SW_TIMER_NO_EXPIRY;
+	int32_t ticks;
+
+	for(int id = 0; id < TIMER_COUNT; id++)
+	{
+		if(!model[id].enabled) continue;
+		ticks = (int32_t)(baseTick + model[id].expire * UNIT_TICKS - hostTickCount);
+		if(ticks < 0) ticks = 0;
+		if((uint32_t)ticks < soonest) soonest = (uint32_t)ticks;
+	}
+	if(soonest == SW_TIMER_NO_EXPIRY) TEST_CHECK_EQ(next, SW_TIMER_NO_EXPIRY);
+	else TEST_CHECK(next <= soonest);
+	return next;
+}
+
+/**************************************************************************//**
+* @fn		static void AdvanceTime(void)
+* @brief	Moves the stub tick tick by tick, in one late jump, or by the wait sw_timer_get_next_expiry() gives
+*****************************************************************************/
+static void AdvanceTime(void)
+{
+	uint32_t r = TestRandom();
+	uint32_t next;
+
+	switch(r % 4)
+	{
+		case 0:
+			for(uint32_t n = 1 + (r >> 8) % 40; n > 0; n--)
+			{
+				hostTickCount++;
+				sw_timer_task(&timers);
+			}
+			break;
+
+		case 1:
+			hostTickCount += (r >> 8) % 2000;
+			sw_timer_task(&timers);
+			break;
+
+		default:
+			next = CheckNextExpiry();
+			hostTickCount += (next == SW_TIMER_NO_EXPIRY) ? 100 : next;
+			sw_timer_task(&timers);
+			break;
+	}
+	CheckModel();
+}
+
+/**************************************************************************//**
+* @fn		static void TestRandomOps(void)
+* @brief	Random operations on every timer of the module, each run starting some time before the tick wraps
+*****************************************************************************/
+static void TestRandomOps(void)
+{
+	uint32_t checks = testChecks;
+	uint32_t fired = 0;
+	uint32_t previous;
+	bool wrapped;
+	double start = TestSeconds();
+
+	for(int round = 0; round < ROUNDS; round++)
+	{
+		hostTickCount = 0UL - (10000000UL + TestRandom() % 10000000UL);
+		Start();
+		wrapped = false;
+		for(int op = 0; op < ROUND_OPS; op++)
+		{
+			previous = hostTickCount;
+			if(TestRandom() % 4 == 0) AdvanceTime();
+			else RandomOp();
+			if(hostTickCount < previous) wrapped = true;
+		}
+		TEST_CHECK(wrapped);
+		fired += firedCount;
+	}
+	TEST_CHECK(fired > ROUNDS * ROUND_OPS / 8);
+	printf("bench: %d x %d random ops, %u callbacks, %u checks in %.2f s\n", ROUNDS, ROUND_OPS, (unsigned)fired,
+		(unsigned)(testChecks - checks), TestSeconds() - start);
+}
+
+/**************************************************************************//**
+* @fn		static void CountCallback(struct sw_timer_module *const module, int timer_id, void *context, int period)
+* @brief	Callback of the benchmark
+*****************************************************************************/
+static void CountCallback(struct sw_timer_module *const module, int timer_id, void *context, int period)
+{
+	(void)module;
+	(void)timer_id;
+	(void)context;
+	(void)period;
+	firedCount++;
+}
+
+/**************************************************************************//**
+* @fn		static void Benchmark(void)
+* @brief	Cost of one tick with every timer enabled, against scanning every timer each unit as the ASF timer did
+*****************************************************************************/
+static void Benchmark(void)
+{
+	static uint32_t expire[TIMER_COUNT];
+	static uint32_t period[TIMER_COUNT];
+	sw_timer_callback_t callback = CountCallback;
+	uint32_t wheelFired;
+	uint32_t now = 0;
+	double start;
+
+	hostTickCount = 0;
+	Start();
+	for(int id = 0; id < TIMER_COUNT; id++)
+	{
+		period[id] = 1 + TestRandom() % 500;
+		expire[id] = period[id];
+		sw_timer_register_callback(&timers, CountCallback, NULL, period[id] * ACCURACY_MS);
+		sw_timer_enable_callback(&timers, id, (period[id] - 1) * ACCURACY_MS);
+	}
+
+	start = TestSeconds();
+	for(uint32_t tick = 0; tick < BENCH_TICKS; tick++)
+	{
+		hostTickCount++;
+		sw_timer_task(&timers);
+	}
+	printf("bench: timer wheel %.1f ns per tick, %d timers\n", (TestSeconds() - start) * 1e9 / BENCH_TICKS, TIMER_COUNT);
+	wheelFired = firedCount;
+
+	firedCount = 0;
+	start = TestSeconds();
+	for(uint32_t tick = 0; tick < BENCH_TICKS; tick++)
+	{
+		if((tick + 1) % UNIT_TICKS != 0) continue;
+		now++;
+		for(int id = 0; id < TIMER_COUNT; id++)
+		{
+			if(expire[id] != now) continue;
+			expire[id] += period[id];
+			callback(&timers, id, NULL, period[id]);
+		}
+	}
+	printf("bench: linear scan %.1f ns per tick\n", (TestSeconds() - start) * 1e9 / BENCH_TICKS);
+	TEST_CHECK_EQ(wheelFired, firedCount);
+}
+
+int main(void)
+{
+	TestExpiry();
+	TestRandomOps();
+	Benchmark();
+	return TEST_RESULT();
+}
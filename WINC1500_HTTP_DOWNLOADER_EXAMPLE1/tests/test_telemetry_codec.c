@@ -0,0 +1,349 @@
+/**************************************************************************//**
+* @file      test_telemetry_codec.c
+* @brief     Host tests for TelemetryCodec: round trips of both codecs, truncated buffers and payloads, and the
+*			encoding cost of a full batch.
+
+******************************************************************************/
+
+#include <stdlib.h>
+#include "test.h"
+#include "WifiHandlerThread/TelemetryCodec.h"
+
+#define BENCH_ROUNDS	20000	///<Batches encoded per codec by the benchmark
+
+/**************************************************************************//**
+* @fn		static uint32_t Get16(const uint8_t *p)
+* @brief	Little endian reads, the way the peer decodes the binary schema
+*****************************************************************************/
+static uint32_t Get16(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+	return Get16(p) | (Get16(p + 2) << 16);
+}
+
+/**************************************************************************//**
+* @fn		static int JsonArray(const char *json, const char *key, long *values, int max)
+* @brief	Reads the integer array "key":[...] of a JSON payload
+* @return	Number of values read, or -1 if the key is missing
+*****************************************************************************/
+static int JsonArray(const char *json, const char *key, long *values, int max)
+{
+	char pattern[16];
+	const char *p;
+	int count = 0;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\":[", key);
+	p = strstr(json, pattern);
+	if(p == NULL) return -1;
+	p += strlen(pattern);
+	while(*p != ']' && count < max)
+	{
+		char *end;
+		values[count++] = strtol(p, &end, 10);
+		p = (*end == ',') ? end + 1 : end;
+	}
+	return count;
+}
+
+/**************************************************************************//**
+* @fn		static void UndoDeltas(long *values, int count)
+* @brief	Turns a delta-encoded array back into absolute values
+*****************************************************************************/
+static void UndoDeltas(long *values, int count)
+{
+	for(int i = 1; i < count; i++) values[i] += values[i - 1];
+}
+
+static void FillImuBatch(struct ImuBatch *batch, uint8_t count, uint32_t t0)
+{
+	struct ImuDataPacket sample;
+	uint32_t tick = t0;
+
+	TelemetryBatchImuReset(batch);
+	for(uint8_t i = 0; i < count; i++)
+	{
+		sample.xmg = (int16_t)TestRandom();
+		sample.ymg = (int16_t)TestRandom();
+		sample.zmg = (int16_t)(TestRandom() % 2000) - 1000;
+		TelemetryBatchImuAdd(batch, tick, &sample);
+		tick += 1 + TestRandom() % 200;
+	}
+}
+
+static void FillDistanceBatch(struct DistanceBatch *batch, uint8_t count, uint32_t t0)
+{
+	uint32_t tick = t0;
+
+	TelemetryBatchDistanceReset(batch);
+	for(uint8_t i = 0; i < count; i++)
+	{
+		TelemetryBatchDistanceAdd(batch, tick, (uint16_t)(TestRandom() % 4500));
+		tick += 1 + TestRandom() % 200;
+	}
+}
+
+static void TestBatchWindow(void)
+{
+	struct ImuBatch imu;
+	struct ImuDataPacket sample = {1, 2, 3};
+	const uint32_t start = 0xFFFFFF00UL;
+
+	TelemetryBatchImuReset(&imu);
+	TEST_CHECK(!TelemetryBatchImuReady(&imu, 5000, 1000));
+	TEST_CHECK(!TelemetryBatchImuAdd(&imu, start, &sample));
+	TEST_CHECK(!TelemetryBatchImuReady(&imu, start + 999, 1000));
+	TEST_CHECK(TelemetryBatchImuReady(&imu, start + 1000, 1000));	//Across the tick wrap
+	for(int i = 1; i < TELEMETRY_BATCH_MAX_SAMPLES - 1; i++) TEST_CHECK(!TelemetryBatchImuAdd(&imu, start, &sample));
+	TEST_CHECK(TelemetryBatchImuAdd(&imu, start, &sample));
+	TEST_CHECK(TelemetryBatchImuAdd(&imu, start, &sample));	//Dropped, still full
+	TEST_CHECK_EQ(imu.count, TELEMETRY_BATCH_MAX_SAMPLES);
+	TEST_CHECK(TelemetryBatchImuReady(&imu, start, 1000));
+}
+
+static void TestBinaryImuRoundTrip(void)
+{
+	struct ImuBatch batch;
+	uint8_t buffer[TELEMETRY_BATCH_MSG_SIZE];
+
+	for(uint8_t count = 1; count <= TELEMETRY_BATCH_MAX_SAMPLES; count++)
+	{
+		size_t length;
+		uint32_t tick;
+
+		FillImuBatch(&batch, count, 0xFFFFFFF0UL - count);
+		length = telemetryCodecBinary.encodeImu(&batch, buffer, sizeof(buffer));
+		TEST_CHECK_EQ(length, 6 + 8 * (size_t)count);
+		TEST_CHECK_EQ(buffer[0], TELEMETRY_BINARY_TYPE_IMU);
+		TEST_CHECK_EQ(buffer[1], count);
+		tick = Get32(&buffer[2]);
+		for(uint8_t i = 0; i < count; i++)
+		{
+			const uint8_t *p = &buffer[6 + 8 * i];
+			tick += Get16(p);
+			TEST_CHECK_EQ(tick, batch.tick[i]);
+			TEST_CHECK_EQ((int16_t)Get16(p + 2), batch.sample[i].xmg);
+			TEST_CHECK_EQ((int16_t)Get16(p + 4), batch.sample[i].ymg);
+			TEST_CHECK_EQ((int16_t)Get16(p + 6), batch.sample[i].zmg);
+		}
+	}
+}
+
+static void TestBinaryDistanceRoundTrip(void)
+{
+	struct DistanceBatch batch;
+	uint8_t buffer[TELEMETRY_BATCH_MSG_SIZE];
+	size_t length;
+	uint32_t tick;
+
+	FillDistanceBatch(&batch, TELEMETRY_BATCH_MAX_SAMPLES, 12345);
+	batch.tick[3] = batch.tick[2] + 70000;	//Gap longer than 16 bits saturates
+	for(int i = 4; i < batch.count; i++) batch.tick[i] = batch.tick[i - 1] + 10;
+
+	length = telemetryCodecBinary.encodeDistance(&batch, buffer, sizeof(buffer));
+	TEST_CHECK_EQ(length, 6 + 4 * TELEMETRY_BATCH_MAX_SAMPLES);
+	TEST_CHECK_EQ(buffer[0], TELEMETRY_BINARY_TYPE_DISTANCE);
+	tick = Get32(&buffer[2]);
+	TEST_CHECK_EQ(tick, 12345);
+	TEST_CHECK_EQ(Get16(&buffer[6 + 4 * 3]), 0xFFFF);
+	for(int i = 0; i < batch.count; i++)
+	{
+		TEST_CHECK_EQ(Get16(&buffer[6 + 4 * i + 2]), batch.distance[i]);
+		if(i != 3)
+		{
+			tick += Get16(&buffer[6 + 4 * i]);
+			TEST_CHECK_EQ(tick, batch.tick[i]);
+		}
+		else
+		{
+			tick = batch.tick[i];
+		}
+	}
+}
+
+static void TestJsonRoundTrip(void)
+{
+	struct ImuBatch imu;
+	struct DistanceBatch distance;
+	char buffer[TELEMETRY_BATCH_MSG_SIZE];
+	long values[TELEMETRY_BATCH_MAX_SAMPLES + 1];
+	size_t length;
+	char *t;
+
+	//Worst case values must still fit, TELEMETRY_BATCH_MAX_SAMPLES is sized for it
+	TelemetryBatchImuReset(&imu);
+	for(int i = 0; i < TELEMETRY_BATCH_MAX_SAMPLES; i++)
+	{
+		struct ImuDataPacket sample = {(i & 1) ? -32768 : 32767, (i & 1) ? 32767 : -32768, (i & 1) ? -32768 : 32767};
+		TelemetryBatchImuAdd(&imu, 4000000000UL + (uint32_t)i * 65535UL, &sample);
+	}
+	length = telemetryCodecJson.encodeImu(&imu, (uint8_t *)buffer, sizeof(buffer));
+	TEST_CHECK(length > 0);
+	TEST_CHECK_EQ(strlen(buffer), length);
+
+	FillImuBatch(&imu, TELEMETRY_BATCH_MAX_SAMPLES, 77);
+	length = telemetryCodecJson.encodeImu(&imu, (uint8_t *)buffer, sizeof(buffer));
+	TEST_CHECK(length > 0 && buffer[0] == '{' && buffer[length - 1] == '}');
+	t = strstr(buffer, "\"t\":");
+	TEST_CHECK(t != NULL && strtoul(t + 4, NULL, 10) == 77);
+	TEST_CHECK_EQ(JsonArray(buffer, "dt", values, TELEMETRY_BATCH_MAX_SAMPLES + 1), TELEMETRY_BATCH_MAX_SAMPLES);
+	TEST_CHECK_EQ(values[0], 0);
+	UndoDeltas(values, TELEMETRY_BATCH_MAX_SAMPLES);
+	for(int i = 0; i < TELEMETRY_BATCH_MAX_SAMPLES; i++) TEST_CHECK_EQ(77 + values[i], imu.tick[i]);
+	TEST_CHECK_EQ(JsonArray(buffer, "x", values, TELEMETRY_BATCH_MAX_SAMPLES + 1), TELEMETRY_BATCH_MAX_SAMPLES);
+	UndoDeltas(values, TELEMETRY_BATCH_MAX_SAMPLES);
+	for(int i = 0; i < TELEMETRY_BATCH_MAX_SAMPLES; i++) TEST_CHECK_EQ(values[i], imu.sample[i].xmg);
+	TEST_CHECK_EQ(JsonArray(buffer, "z", values, TELEMETRY_BATCH_MAX_SAMPLES + 1), TELEMETRY_BATCH_MAX_SAMPLES);
+	UndoDeltas(values, TELEMETRY_BATCH_MAX_SAMPLES);
+	for(int i = 0; i < TELEMETRY_BATCH_MAX_SAMPLES; i++) TEST_CHECK_EQ(values[i], imu.sample[i].zmg);
+
+	FillDistanceBatch(&distance, 5, 1000);
+	length = telemetryCodecJson.encodeDistance(&distance, (uint8_t *)buffer, sizeof(buffer));
+	TEST_CHECK(length > 0);
+	TEST_CHECK_EQ(JsonArray(buffer, "d", values, TELEMETRY_BATCH_MAX_SAMPLES + 1), 5);
+	UndoDeltas(values, 5);
+	for(int i = 0; i < 5; i++) TEST_CHECK_EQ(values[i], distance.distance[i]);
+
+	//Empty batches are never published
+	TelemetryBatchDistanceReset(&distance);
+	TEST_CHECK_EQ(telemetryCodecJson.encodeDistance(&distance, (uint8_t *)buffer, sizeof(buffer)), 0);
+	TEST_CHECK_EQ(telemetryCodecBinary.encodeDistance(&distance, (uint8_t *)buffer, sizeof(buffer)), 0);
+}
+
+static void TestGameRoundTrip(const TelemetryCodec *codec)
+{
+	for(int moves = 0; moves <= GAME_SIZE; moves++)
+	{
+		struct GameDataPacket game, decoded;
+		uint8_t buffer[128];
+		size_t length;
+
+		memset(game.game, 0xFF, sizeof(game.game));
+		for(int i = 0; i < moves; i++) game.game[i] = (uint8_t)(TestRandom() % 16);
+		if(moves == 3) game.game[1] = 254;	//Largest move that is not the end marker
+
+		length = codec->encodeGame(&game, buffer, sizeof(buffer));
+		TEST_CHECK(length > 0);
+		TEST_CHECK(TelemetryCodecDecodeGame(buffer, length, &decoded));
+		TEST_CHECK(memcmp(game.game, decoded.game, GAME_SIZE) == 0);
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestTruncatedBuffers(void)
+* @brief	Every encoder must return 0 for every buffer shorter than its payload, and stay inside the buffer.
+* The buffers are allocated to the exact length so the address sanitizer catches any overflow.
+*****************************************************************************/
+static void TestTruncatedBuffers(void)
+{
+	const TelemetryCodec *codecs[] = {&telemetryCodecJson, &telemetryCodecBinary};
+	struct ImuBatch imu;
+	struct DistanceBatch distance;
+	struct GameDataPacket game;
+	uint8_t full[TELEMETRY_BATCH_MSG_SIZE];
+
+	FillImuBatch(&imu, TELEMETRY_BATCH_MAX_SAMPLES, 100000);
+	FillDistanceBatch(&distance, TELEMETRY_BATCH_MAX_SAMPLES, 100000);
+	memset(game.game, 3, sizeof(game.game));
+
+	for(unsigned c = 0; c < 2; c++)
+	{
+		size_t need[3];
+		need[0] = codecs[c]->encodeImu(&imu, full, sizeof(full));
+		need[1] = codecs[c]->encodeDistance(&distance, full, sizeof(full));
+		need[2] = codecs[c]->encodeGame(&game, full, sizeof(full));
+
+		for(unsigned kind = 0; kind < 3; kind++)
+		{
+			//The JSON encoders also write the terminating NULL
+			size_t fits = need[kind] + (codecs[c] == &telemetryCodecJson ? 1 : 0);
+			TEST_CHECK(need[kind] > 0);
+			for(size_t length = 0; length <= fits; length++)
+			{
+				uint8_t *buffer = malloc(length ? length : 1);
+				size_t got = (kind == 0) ? codecs[c]->encodeImu(&imu, buffer, length) :
+							 (kind == 1) ? codecs[c]->encodeDistance(&distance, buffer, length) :
+										   codecs[c]->encodeGame(&game, buffer, length);
+				TEST_CHECK_EQ(got, (length == fits) ? need[kind] : 0);
+				free(buffer);
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+* @fn		static void TestTruncatedPayloads(void)
+* @brief	The game decoder must stay inside the payload length, whatever follows it
+*****************************************************************************/
+static void TestTruncatedPayloads(void)
+{
+	static const char json[] = "{\"game\":[1,2,13,4]}";
+	struct GameDataPacket game;
+	uint8_t binary[8] = {'G', 4, 1, 2, 13, 4};
+
+	for(size_t length = 0; length <= sizeof(json) - 1; length++)
+	{
+		uint8_t *payload = malloc(length ? length : 1);
+		bool ok;
+
+		memcpy(payload, json, length);
+		ok = TelemetryCodecDecodeGame(payload, length, &game);
+		TEST_CHECK_EQ(ok, length >= 9);	//The "{"game":[" prefix must be complete
+		if(length == 10) TEST_CHECK(game.game[0] == 1 && game.game[1] == 0xFF);
+		if(length == 14) TEST_CHECK(game.game[2] == 1 && game.game[3] == 0xFF);	//"13" cut after its first digit
+		free(payload);
+	}
+	for(size_t length = 0; length <= 6; length++)
+	{
+		uint8_t *payload = malloc(length ? length : 1);
+		memcpy(payload, binary, length);
+		TEST_CHECK_EQ(TelemetryCodecDecodeGame(payload, length, &game), length == 6);
+		free(payload);
+	}
+
+	//Malformed payloads
+	TEST_CHECK(!TelemetryCodecDecodeGame((const uint8_t *)"{\"game\":[300]}", 14, &game));
+	binary[1] = GAME_SIZE + 1;
+	TEST_CHECK(!TelemetryCodecDecodeGame(binary, sizeof(binary), &game));
+	binary[0] = 'X';
+	binary[1] = 2;
+	TEST_CHECK(!TelemetryCodecDecodeGame(binary, sizeof(binary), &game));
+}
+
+/**************************************************************************//**
+* @fn		static void Benchmark(void)
+* @brief	Payload size and encoding time of a full IMU batch with each codec
+*****************************************************************************/
+static void Benchmark(void)
+{
+	const TelemetryCodec *codecs[] = {&telemetryCodecJson, &telemetryCodecBinary};
+	struct ImuBatch imu;
+	uint8_t buffer[TELEMETRY_BATCH_MSG_SIZE];
+
+	FillImuBatch(&imu, TELEMETRY_BATCH_MAX_SAMPLES, 1000);
+	for(unsigned c = 0; c < 2; c++)
+	{
+		size_t length = 0;
+		double start = TestSeconds();
+		for(int i = 0; i < BENCH_ROUNDS; i++) length = codecs[c]->encodeImu(&imu, buffer, sizeof(buffer));
+		printf("bench: %-6s %2d-sample IMU batch %3zu bytes, %.2f us per batch\n", codecs[c]->name,
+			   TELEMETRY_BATCH_MAX_SAMPLES, length, (TestSeconds() - start) * 1e6 / BENCH_ROUNDS);
+	}
+}
+
+int main(void)
+{
+	TestBatchWindow();
+	TestBinaryImuRoundTrip();
+	TestBinaryDistanceRoundTrip();
+	TestJsonRoundTrip();
+	TestGameRoundTrip(&telemetryCodecJson);
+	TestGameRoundTrip(&telemetryCodecBinary);
+	TestTruncatedBuffers();
+	TestTruncatedPayloads();
+	Benchmark();
+	return TEST_RESULT();
+}
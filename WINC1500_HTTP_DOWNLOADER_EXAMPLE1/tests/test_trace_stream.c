@@ -0,0 +1,846 @@
+/**************************************************************************//**
+* @file      test_trace_stream.c
+* @brief     Host tests for the Tracealyzer stream of the firmware: the streaming recorder and the UART stream port, on
+*			 the simulated trace UART of host_console.c, decoded the way Tracealyzer reads a .psf capture.
+The host side sends the start and stop commands and collects what comes out of the UART, as tools/trace_capture.py
+does. A scheduler model stands for the kernel: it calls the recorder where the trace hooks of trcKernelPort.h would,
+with the same arguments, and logs each event it stores. The firmware's task mix runs on it: the IMU task woken by the
+FIFO watermark interrupt, the Wi-Fi task's 100 ms passes with a telemetry publish every second under
+vTaskSuspendAll() as in WifiHandler.c, and the control task's telemetry every 300 ms. TzCtrl is the test code itself:
+it runs a pass of its loop, then delays, and blocks in the stream port while a buffer page is sent. Its own kernel
+calls, the delay and the port's notification waits, are not traced by the model.
+The decoded capture must start with the header, symbol and object tables, then hold the events the model logged, in
+order and with their timestamps, with no gap in the event counter. The stalls the publish causes must show: the ticks
+the kernel pends while the scheduler is suspended come late in the trace, by as much as the model held them. A second
+session must start over with a new header, after a noisy line. An interrupt storm must drop events without breaking
+the stream: the gaps in the event counter must add up to the recorder's count of dropped events.
+The benchmark gives the trace bandwidth of the firmware's task mix and how full the buffer gets.
+
+******************************************************************************/
+
+#include <stdlib.h>
+#include "test.h"
+#include "host_console.h"
+#include "host_trace.h"
+#include "IMU/ImuAcquisition.h"
+#include "WifiHandlerThread/TelemetryBatch.h"
+
+#define WIFI_TASK_PERIOD_MS			100		///<As in WifiHandler.h
+#define CONTROL_TELEMETRY_PERIOD_MS	300		///<As in ControlThread.c
+#define PUBLISH_SUSPEND_US			5000	///<mqtt_publish() of a telemetry batch, with the scheduler suspended
+#define NS_PER_TICK					(1000000000ULL / configTICK_RATE_HZ)
+#define TS_HZ						32768	///<Timestamp clock, TRC_HWTC_FREQ_HZ
+#define STORM_PERIOD_US				20		///<Interrupt rate of the storm
+#define STORM_MS					40
+#define SESSION_MS					2000
+#define BENCH_MS					10000
+#define DRAIN_MS					50		///<Time the stop command and the last full pages take
+#define BUFFER_SIZE					((TRC_CFG_PAGED_EVENT_BUFFER_PAGE_COUNT) * (TRC_CFG_PAGED_EVENT_BUFFER_PAGE_SIZE))
+#define CAPTURE_MAX					(1024 * 1024)
+#define EXPECTED_MAX				65536
+#define DECODED_MAX					65536
+#define HEADER_SIZE					24		///<PSFHeaderInfo
+#define SYMBOL_SLOT_SIZE			(4 + ((TRC_CFG_SYMBOL_MAX_LENGTH) + 3) / 4 * 4)
+#define OBJECT_SLOT_SIZE			8
+#define EXTENSION_INFO_SIZE			4
+#define START_SIZE					(HEADER_SIZE + (TRC_CFG_SYMBOL_TABLE_SLOTS) * SYMBOL_SLOT_SIZE + \
+									 (TRC_CFG_OBJECT_DATA_SLOTS) * OBJECT_SLOT_SIZE + EXTENSION_INFO_SIZE)
+
+//Tasks of the firmware, as main21.c creates them, then TzCtrl and the idle task
+enum { TASK_CLI, TASK_WIFI, TASK_UI, TASK_CONTROL, TASK_IMU, TASK_TZCTRL, TASK_IDLE, TASK_COUNT };
+
+//A task of the scheduler model
+struct Task
+{
+	struct HostTraceTask tcb;
+	uint32_t periodTicks;		///<Delay at the end of each pass, or timeout of its notification wait. 0 to block for good
+	bool notifyWait;			///<Waits on its notification with xTaskNotifyWait(), woken by an interrupt, instead of vTaskDelay()
+	uint32_t runUs;				///<CPU time of a pass
+	uint32_t burstEvery;		///<Every burstEvery-th pass starts with a telemetry publish. 0 for none
+
+	bool ready;
+	bool blocked;				///<In its delay or its wait, until wakeTick
+	TickType_t wakeTick;
+	bool pendingReady;			///<Woken while the scheduler was suspended
+	bool notified;				///<Its wait ends on a notification: the pass starts with its return
+	bool timedOut;				///<Its wait timed out
+	bool notifyPending;			///<Notified while it was not waiting
+	bool publishing;			///<Holds the scheduler suspended
+	uint64_t leftNs;			///<CPU time left of the pass
+	uint64_t publishLeftNs;		///<Time left of the publish at the start of the pass
+	uint32_t passes;
+};
+
+//An event the model stored, as the decoder must find it
+struct Expected
+{
+	uint16_t code;
+	uint8_t paramCount;			///<Parameters before the string, if any
+	uint32_t param[3];
+	const char *text;			///<String of a string event, NULL for none
+	uint32_t ts;
+};
+
+//An event as Tracealyzer reads it from the stream
+struct Decoded
+{
+	uint16_t code;
+	uint16_t count;				///<EventCount
+	uint32_t ts;
+	uint8_t words;				///<Parameter words, string included
+	uint32_t param[15];
+};
+
+//What the decoder found in a capture
+struct Capture
+{
+	uint32_t events;			///<Events decoded after the start events
+	uint32_t matched;			///<Events that match the model's log
+	uint32_t mismatched;		///<Events that are not the next ones of the log
+	uint32_t gaps;				///<Events missing from the event counter
+	uint32_t stackReports;		///<UNUSED_STACK reports with the watermark of a known task
+	uint32_t session;			///<Session counter of TRACE_START
+	uint32_t stalls;			///<Bursts of ticks that came more than a tick late
+	uint32_t maxTickLate;		///<Longest time a tick was held, in timestamp counts
+	bool backwards;				///<A timestamp went back
+	bool header;				///<Header, symbol and object tables and start events as expected
+};
+
+static struct Task tasks[TASK_COUNT];
+static struct Task *running;
+static uint64_t runSince;					///<Time the running task last got the CPU
+static TickType_t kernelTick;				///<xTickCount
+static uint32_t pendedTicks;				///<uxPendedTicks
+static bool suspended;						///<uxSchedulerSuspended
+static bool tzNotified;						///<TzCtrl was woken by the stream port's notification
+static uint64_t nextTickNs;
+static uint64_t nextInt1Ns;
+static uint64_t nextStormNs;
+static uint64_t stormEndNs;
+static traceHandle int1Isr;
+static traceHandle stormIsr;
+static traceString publishChannel;
+static uint32_t publishes;
+
+//What the model did in a session
+static uint32_t stalls;						///<Resumes with pended ticks
+static uint64_t maxTickLateNs;				///<Longest a pended tick waited
+
+extern uint32_t uiTraceTickCount;
+extern volatile uint32_t uiTraceSystemState;
+extern uint32_t DroppedEventCounter;
+extern uint32_t TotalBytesRemaining;
+extern uint32_t TotalBytesRemaining_LowWaterMark;
+
+static struct Expected expected[EXPECTED_MAX];
+static uint32_t expectedCount;
+static uint8_t capture[CAPTURE_MAX];
+static size_t captureLength;
+static struct Decoded decoded[DECODED_MAX];
+
+/******************************************************************************
+* Scheduler model
+******************************************************************************/
+static uint32_t Handle(const void *object)
+{
+	return (uint32_t)(uintptr_t)object;
+}
+
+static void Expect(uint16_t code, uint8_t paramCount, uint32_t p1, uint32_t p2, const char *text)
+{
+	if(!xTraceIsRecordingEnabled() || expectedCount >= EXPECTED_MAX) return;
+	expected[expectedCount++] = (struct Expected){ .code = code, .paramCount = paramCount, .param = { p1, p2 },
+		.text = text, .ts = RuntimeStatsGetCounter() };
+}
+
+static void Event1(uint16_t code, uint32_t p1)
+{
+	Expect(code, 1, p1, 0, NULL);
+	prvTraceStoreEvent1(code, p1);
+}
+
+static void Event2(uint16_t code, uint32_t p1, uint32_t p2)
+{
+	Expect(code, 2, p1, p2, NULL);
+	prvTraceStoreEvent2(code, p1, p2);
+}
+
+/**************************************************************************//**
+* @fn		static void CreateTask(int id, const char *name, UBaseType_t priority, uint32_t stackLeft)
+* @brief	xTaskCreateStatic(): traceTASK_CREATE
+*****************************************************************************/
+static void CreateTask(int id, const char *name, UBaseType_t priority, uint32_t stackLeft)
+{
+	struct HostTraceTask *tcb = &tasks[id].tcb;
+
+	tcb->pcTaskName = name;
+	tcb->uxPriority = priority;
+	tcb->stackHighWaterMark = stackLeft;
+	prvAddTaskToStackMonitor(tcb);
+	prvTraceSaveObjectSymbol(tcb, tcb->pcTaskName);
+	prvTraceSaveObjectData(tcb, tcb->uxPriority);
+	Expect(PSF_EVENT_OBJ_NAME, 1, Handle(tcb), 0, tcb->pcTaskName);
+	prvTraceStoreStringEvent(1, PSF_EVENT_OBJ_NAME, tcb->pcTaskName, tcb);
+	Event2(PSF_EVENT_TASK_CREATE, Handle(tcb), tcb->uxPriority);
+}
+
+//Time of the current phase end of the running task: its pass, or the publish at its start
+static uint64_t PhaseEnd(void)
+{
+	if(running == &tasks[TASK_IDLE] || running == &tasks[TASK_TZCTRL]) return UINT64_MAX;
+	return runSince + (running->publishing ? running->publishLeftNs : running->leftNs);
+}
+
+//Charges the CPU time since the running task got it
+static void Consume(uint64_t now)
+{
+	if(PhaseEnd() != UINT64_MAX)
+	{
+		if(running->publishing) running->publishLeftNs -= now - runSince;
+		else running->leftNs -= now - runSince;
+	}
+	runSince = now;
+}
+
+static void StartPass(struct Task *task)
+{
+	task->leftNs = (uint64_t)task->runUs * 1000;
+	task->passes++;
+	if(task->burstEvery != 0 && task->passes % task->burstEvery == 0) task->publishLeftNs = (uint64_t)PUBLISH_SUSPEND_US * 1000;
+}
+
+//prvAddTaskToReadyList(): traceMOVED_TASK_TO_READY_STATE
+static void MakeReady(struct Task *task)
+{
+	task->ready = true;
+	Event1(PSF_EVENT_TASK_READY, Handle(&task->tcb));
+	if(task != &tasks[TASK_TZCTRL]) StartPass(task);
+}
+
+//vTaskSuspendAll(), then the publish, which logs it as a user event
+static void StartPublish(void)
+{
+	running->publishing = true;
+	suspended = true;
+	hostSchedulerState = taskSCHEDULER_SUSPENDED;
+	Expect(PSF_EVENT_USER_EVENT + 2, 2, Handle(publishChannel), publishes, "publish %d");
+	vTracePrintF(publishChannel, "publish %d", publishes);
+	publishes++;
+}
+
+/**************************************************************************//**
+* @fn		static void SwitchIn(struct Task *task)
+* @brief	The scheduler gives the CPU to the task: traceTASK_SWITCHED_IN, then the return of its wait
+*****************************************************************************/
+static void SwitchIn(struct Task *task)
+{
+	Consume(HostConsoleNowNs());
+	running = task;
+	HostTraceSetCurrentTask(&task->tcb);
+	uiTraceSystemState = TRC_STATE_IN_TASKSWITCH;
+	if(prvIsNewTCB(&task->tcb)) Event2(PSF_EVENT_TASK_ACTIVATE, Handle(&task->tcb), task->tcb.uxPriority);
+	uiTraceSystemState = TRC_STATE_IN_APPLICATION;
+
+	if(task->notifyWait && (task->notified || task->timedOut))
+	{
+		Event2(task->notified ? PSF_EVENT_TASK_NOTIFY_WAIT : PSF_EVENT_TASK_NOTIFY_WAIT_FAILED, Handle(&task->tcb), task->periodTicks);
+	}
+	task->notified = task->timedOut = false;
+	if(task->publishLeftNs > 0 && !task->publishing) StartPublish();
+}
+
+//Switches to the highest priority ready task, unless the scheduler is suspended. Tasks of the same priority as the running one wait
+static void Reschedule(void)
+{
+	struct Task *best = (running->ready) ? running : NULL;
+
+	if(suspended) return;
+	for(int i = 0; i < TASK_COUNT; i++)
+	{
+		if(tasks[i].ready && (best == NULL || tasks[i].tcb.uxPriority > best->tcb.uxPriority)) best = &tasks[i];
+	}
+	if(best != running) SwitchIn(best);
+}
+
+static void Block(struct Task *task, TickType_t wakeTick)
+{
+	task->ready = false;
+	task->blocked = true;
+	task->wakeTick = wakeTick;
+	Reschedule();
+}
+
+//xTaskIncrementTick() with the scheduler running: traceTASK_INCREMENT_TICK, then the tasks whose wait times out
+static void IncrementTick(void)
+{
+	if(pendedTicks == 0) uiTraceTickCount++;
+	Event1(PSF_EVENT_NEW_TIME, kernelTick + 1);
+	kernelTick++;
+	for(int i = 0; i < TASK_COUNT; i++)
+	{
+		if(tasks[i].blocked && tasks[i].wakeTick == kernelTick)
+		{
+			tasks[i].blocked = false;
+			tasks[i].timedOut = true;
+			MakeReady(&tasks[i]);
+		}
+	}
+}
+
+static void Tick(void)
+{
+	nextTickNs += NS_PER_TICK;
+	if(suspended)
+	{
+		uiTraceTickCount++;
+		pendedTicks++;
+		return;
+	}
+	IncrementTick();
+	Reschedule();
+}
+
+//xTaskResumeAll(): the tasks woken meanwhile, then the pended ticks
+static void ResumeAll(void)
+{
+	uint64_t now = HostConsoleNowNs();
+
+	running->publishing = false;
+	suspended = false;
+	hostSchedulerState = taskSCHEDULER_RUNNING;
+	for(int i = 0; i < TASK_COUNT; i++)
+	{
+		if(tasks[i].pendingReady)
+		{
+			tasks[i].pendingReady = false;
+			MakeReady(&tasks[i]);
+		}
+	}
+	if(pendedTicks > 0) stalls++;
+	while(pendedTicks > 0)
+	{
+		uint64_t late = now - (uint64_t)(kernelTick + 1) * NS_PER_TICK;
+		if(late > maxTickLateNs) maxTickLateNs = late;
+		IncrementTick();
+		pendedTicks--;
+	}
+	Reschedule();
+}
+
+/**************************************************************************//**
+* @fn		static bool NotifyFromIsr(struct Task *task)
+* @brief	xTaskNotifyFromISR() or vTaskNotifyGiveFromISR()
+* @return	xHigherPriorityTaskWoken
+*****************************************************************************/
+static bool NotifyFromIsr(struct Task *task)
+{
+	Event1((task == &tasks[TASK_TZCTRL]) ? PSF_EVENT_TASK_NOTIFY_GIVE_FROM_ISR : PSF_EVENT_TASK_NOTIFY_FROM_ISR, Handle(&task->tcb));
+	if(!task->blocked || task->pendingReady)
+	{
+		task->notifyPending = true;
+		return false;
+	}
+	task->blocked = false;
+	task->notified = true;
+	if(suspended) task->pendingReady = true;
+	else MakeReady(task);
+	return task->tcb.uxPriority > running->tcb.uxPriority;
+}
+
+static void IsrEnd(bool switchRequired)
+{
+	if(!switchRequired || suspended) Expect(PSF_EVENT_TS_RESUME, 1, Handle(&running->tcb), 0, NULL);
+	vTraceStoreISREnd(switchRequired);
+	Reschedule();
+}
+
+//FIFO watermark interrupt of the LSM6DS3
+static void Int1Isr(void)
+{
+	nextInt1Ns += (uint64_t)IMU_ACQ_BLOCK_SAMPLES * IMU_ACQ_SAMPLE_PERIOD_US * 1000;
+	Expect(PSF_EVENT_ISR_BEGIN, 1, Handle(int1Isr), 0, NULL);
+	vTraceStoreISRBegin(int1Isr);
+	IsrEnd(NotifyFromIsr(&tasks[TASK_IMU]));
+}
+
+//An interrupt that keeps firing and wakes nothing, as a stuck EXTINT line
+static void StormIsr(void)
+{
+	nextStormNs += STORM_PERIOD_US * 1000;
+	if(nextStormNs > stormEndNs) nextStormNs = UINT64_MAX;
+	Expect(PSF_EVENT_ISR_BEGIN, 1, Handle(stormIsr), 0, NULL);
+	vTraceStoreISRBegin(stormIsr);
+	IsrEnd(false);
+}
+
+//The running task is done with its publish, or with its pass
+static void PhaseDone(void)
+{
+	struct Task *task = running;
+
+	if(task->publishing)
+	{
+		task->publishLeftNs = 0;
+		ResumeAll();
+		return;
+	}
+	if(task->notifyWait && task->notifyPending)
+	{
+		//Notified during the pass: the wait returns at once
+		task->notifyPending = false;
+		Event2(PSF_EVENT_TASK_NOTIFY_WAIT, Handle(&task->tcb), task->periodTicks);
+		StartPass(task);
+		return;
+	}
+	if(task->notifyWait) Event2(PSF_EVENT_TASK_NOTIFY_WAIT_BLOCK, Handle(&task->tcb), task->periodTicks);
+	else Event1(PSF_EVENT_TASK_DELAY, task->periodTicks);
+	Block(task, kernelTick + task->periodTicks);
+}
+
+/**************************************************************************//**
+* @fn		static void Step(void)
+* @brief	Runs the next thing that happens while TzCtrl is blocked: a UART event, the end of the running task's
+*			phase, the tick or an interrupt
+*****************************************************************************/
+static void Step(void)
+{
+	uint64_t endAt = PhaseEnd();
+	uint64_t uartAt = HostConsoleNextEventNs();
+	uint64_t at = endAt;
+
+	if(uartAt < at) at = uartAt;
+	if(nextTickNs < at) at = nextTickNs;
+	if(nextInt1Ns < at) at = nextInt1Ns;
+	if(nextStormNs < at) at = nextStormNs;
+
+	HostConsoleRunUntil(at);
+	Consume(at);
+	if(at == uartAt)
+	{
+		//A page is out: the write callback notifies TzCtrl
+		if(tasks[TASK_TZCTRL].blocked && hostCurrentTask->notified)
+		{
+			tzNotified = true;
+			NotifyFromIsr(&tasks[TASK_TZCTRL]);
+			Reschedule();
+		}
+	}
+	else if(at == endAt) PhaseDone();
+	else if(at == nextTickNs) Tick();
+	else if(at == nextInt1Ns) Int1Isr();
+	else StormIsr();
+}
+
+/**************************************************************************//**
+* @fn		static bool Wait(TickType_t deadline)
+* @brief	Wait function of the RTOS stand-in: TzCtrl blocks until the deadline tick or its notification, and the
+*			firmware runs until the scheduler gives TzCtrl the CPU back
+* @return	true if TzCtrl was woken by its notification
+*****************************************************************************/
+static bool Wait(TickType_t deadline)
+{
+	struct Task *tz = &tasks[TASK_TZCTRL];
+
+	if(running == tz) Block(tz, deadline);
+	while(running != tz) Step();
+	if(!tzNotified) return false;
+	tzNotified = false;
+	return true;
+}
+
+/******************************************************************************
+* Host side
+******************************************************************************/
+
+//Moves what the trace UART sent into the capture
+static void Collect(void)
+{
+	size_t length;
+	const uint8_t *output = HostConsoleOutput(&length);
+
+	if(length > CAPTURE_MAX - captureLength) length = CAPTURE_MAX - captureLength;
+	memcpy(capture + captureLength, output, length);
+	captureLength += length;
+	HostConsoleClearOutput();
+}
+
+//Runs TzCtrl's loop for ms
+static void RunTzCtrl(uint32_t ms)
+{
+	uint64_t end = HostConsoleNowNs() + (uint64_t)ms * 1000000ULL;
+
+	while(HostConsoleNowNs() < end)
+	{
+		HostTraceControl();
+		Collect();
+		vTaskDelay(TRC_CFG_CTRL_TASK_DELAY);
+	}
+}
+
+//Builds a Tracealyzer command, as trace_capture.py does
+static void Command(uint8_t *command, uint8_t code, uint8_t param1)
+{
+	uint16_t checksum = 0xFFFF - code - param1;
+
+	memset(command, 0, 8);
+	command[0] = code;
+	command[1] = param1;
+	command[6] = (uint8_t)checksum;
+	command[7] = (uint8_t)(checksum >> 8);
+}
+
+/**************************************************************************//**
+* @fn		static void StartSession(const uint8_t *noise, size_t noiseLength)
+* @brief	Sends the start command, after some noise on the line, and waits for the recorder to start
+*****************************************************************************/
+static void StartSession(const uint8_t *noise, size_t noiseLength)
+{
+	static uint8_t text[64];
+
+	if(noiseLength > 0) memcpy(text, noise, noiseLength);
+	Command(text + noiseLength, CMD_SET_ACTIVE, 1);
+	captureLength = 0;
+	expectedCount = 0;
+	stalls = 0;
+	maxTickLateNs = 0;
+	HostConsoleType(text, noiseLength + 8, false);
+	for(int i = 0; i < 10 && !xTraceIsRecordingEnabled(); i++) RunTzCtrl(1);
+	TEST_CHECK(xTraceIsRecordingEnabled());
+}
+
+//Sends the stop command, then collects the last full pages
+static void StopSession(void)
+{
+	static uint8_t text[8];
+
+	Command(text, CMD_SET_ACTIVE, 0);
+	HostConsoleType(text, sizeof(text), false);
+	RunTzCtrl(DRAIN_MS);
+	TEST_CHECK(!xTraceIsRecordingEnabled());
+}
+
+/******************************************************************************
+* Decoder
+******************************************************************************/
+static uint32_t Read32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t Read16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+//Looks a name up in the symbol table of the capture
+static uint32_t Symbol(const char *name)
+{
+	const uint8_t *table = capture + HEADER_SIZE;
+
+	for(int i = 0; i < TRC_CFG_SYMBOL_TABLE_SLOTS; i++)
+	{
+		const uint8_t *slot = table + i * SYMBOL_SLOT_SIZE;
+		if(Read32(slot) != 0 && strncmp((const char *)slot + 4, name, SYMBOL_SLOT_SIZE - 4) == 0) return Read32(slot);
+	}
+	return 0;
+}
+
+//Looks an object up in the object data table of the capture
+static uint32_t ObjectData(uint32_t address)
+{
+	const uint8_t *table = capture + HEADER_SIZE + TRC_CFG_SYMBOL_TABLE_SLOTS * SYMBOL_SLOT_SIZE;
+
+	for(int i = 0; i < TRC_CFG_OBJECT_DATA_SLOTS; i++)
+	{
+		if(Read32(table + i * OBJECT_SLOT_SIZE) == address) return Read32(table + i * OBJECT_SLOT_SIZE + 4);
+	}
+	return UINT32_MAX;
+}
+
+//Parameters before the string of a string event, -1 if the event has no string
+static int StringArgs(uint16_t code)
+{
+	if(code == PSF_EVENT_OBJ_NAME) return 1;
+	if(code == PSF_EVENT_DEFINE_ISR) return 2;
+	if(code >= PSF_EVENT_USER_EVENT && code <= PSF_EVENT_USER_EVENT + 15) return code - PSF_EVENT_USER_EVENT;
+	return -1;
+}
+
+static bool Matches(const struct Decoded *event, const struct Expected *e)
+{
+	if(event->code != e->code || event->ts != e->ts) return false;
+	if(e->text == NULL) return event->words == e->paramCount && memcmp(event->param, e->param, e->paramCount * 4) == 0;
+
+	size_t length = strlen(e->text);
+	if(event->words != e->paramCount + (length + 4) / 4 || memcmp(event->param, e->param, e->paramCount * 4) != 0) return false;
+	return memcmp(&event->param[e->paramCount], e->text, length + 1) == 0;
+}
+
+/**************************************************************************//**
+* @fn		static struct Capture Decode(void)
+* @brief	Reads the capture as Tracealyzer does, and checks it against the model's log
+*****************************************************************************/
+static struct Capture Decode(void)
+{
+	struct Capture result = { 0 };
+	size_t pos = START_SIZE;
+	uint32_t count = 0;
+	uint32_t next = 0;				///<Next entry of the log to match
+	uint32_t warnings;
+	int64_t minLate = INT64_MAX, maxLate = INT64_MIN;
+	bool late = false;
+
+	if(captureLength < START_SIZE) return result;
+	TEST_CHECK_EQ(Read32(capture), 0x50534600);
+	TEST_CHECK_EQ(Read16(capture + 4), 6);
+	TEST_CHECK_EQ(Read16(capture + 6), TRACE_KERNEL_VERSION);
+	TEST_CHECK_EQ(Read16(capture + 16), SYMBOL_SLOT_SIZE);
+	TEST_CHECK_EQ(Read16(capture + 18), TRC_CFG_SYMBOL_TABLE_SLOTS);
+	TEST_CHECK_EQ(Read16(capture + 20), OBJECT_SLOT_SIZE);
+	TEST_CHECK_EQ(Read16(capture + 22), TRC_CFG_OBJECT_DATA_SLOTS);
+	warnings = Symbol("#WFR");
+
+	//Events
+	while(pos + 8 <= captureLength && count < DECODED_MAX)
+	{
+		struct Decoded *event = &decoded[count];
+		uint16_t id = Read16(capture + pos);
+
+		event->code = id & 0x0FFF;
+		event->words = id >> 12;
+		event->count = Read16(capture + pos + 2);
+		event->ts = Read32(capture + pos + 4);
+		if(pos + 8 + event->words * 4 > captureLength) break;
+		for(int i = 0; i < event->words; i++) event->param[i] = Read32(capture + pos + 8 + i * 4);
+		pos += 8 + event->words * 4;
+		if(count > 0 && event->ts < decoded[count - 1].ts) result.backwards = true;
+		if(count > 0) result.gaps += (uint16_t)(event->count - decoded[count - 1].count - 1);
+		count++;
+	}
+	TEST_CHECK_EQ(pos, captureLength);
+
+	//The start events: the tick count, TzCtrl and the session, then the timestamp clock
+	result.header = count >= 2 && decoded[0].code == PSF_EVENT_TRACE_START && decoded[0].count == 1 && decoded[0].words == 3 &&
+		decoded[0].param[1] == Handle(&tasks[TASK_TZCTRL].tcb) && decoded[1].code == PSF_EVENT_TS_CONFIG &&
+		decoded[1].count == 2 && decoded[1].param[0] == TS_HZ && decoded[1].param[1] == configTICK_RATE_HZ &&
+		decoded[1].param[2] == TRC_HWTC_TYPE;
+	result.header = result.header && Symbol("#WFR") != 0 && Symbol("INT1") != 0 && Symbol("MQTT") != 0;
+	for(int i = 0; i < TASK_COUNT; i++)
+	{
+		uint32_t address = Symbol(tasks[i].tcb.pcTaskName);
+		result.header = result.header && address == Handle(&tasks[i].tcb) && ObjectData(address) == tasks[i].tcb.uxPriority;
+	}
+	if(count < 2) return result;
+	result.session = decoded[0].param[2];
+
+	for(uint32_t i = 2; i < count; i++)
+	{
+		struct Decoded *event = &decoded[i];
+
+		result.events++;
+		if(event->code == PSF_EVENT_UNUSED_STACK)
+		{
+			//The stack monitor reports from TzCtrl
+			for(int t = 0; t < TASK_COUNT; t++)
+			{
+				if(event->param[0] == Handle(&tasks[t].tcb) && event->param[1] == tasks[t].tcb.stackHighWaterMark) result.stackReports++;
+			}
+			continue;
+		}
+		if(StringArgs(event->code) > 0 && event->param[0] == warnings) continue;
+
+		//The model's events, in order. Events the recorder dropped are skipped
+		uint32_t e = next;
+		while(e < expectedCount && !Matches(event, &expected[e]) && result.gaps > 0) e++;
+		if(e < expectedCount && Matches(event, &expected[e]))
+		{
+			result.matched++;
+			next = e + 1;
+		}
+		else
+		{
+			result.mismatched++;
+		}
+
+		//A tick is late by its timestamp against its number. Compared in thousandths of a count
+		if(event->code == PSF_EVENT_NEW_TIME)
+		{
+			int64_t lateBy = (int64_t)event->ts * 1000 - (int64_t)event->param[0] * (TS_HZ * 1000 / configTICK_RATE_HZ);
+			if(lateBy < minLate) minLate = lateBy;
+			if(lateBy > maxLate) maxLate = lateBy;
+			if(lateBy - minLate > TS_HZ * 1000 / configTICK_RATE_HZ)
+			{
+				if(!late) result.stalls++;
+				late = true;
+			}
+			else
+			{
+				late = false;
+			}
+		}
+	}
+	if(maxLate > minLate) result.maxTickLate = (uint32_t)((maxLate - minLate) / 1000);
+	return result;
+}
+
+//Writes the capture where trace_capture.py --check can read it
+static void Save(const char *program)
+{
+	char path[512];
+	FILE *file;
+
+	snprintf(path, sizeof(path), "%s.psf", program);
+	file = fopen(path, "wb");
+	TEST_CHECK(file != NULL);
+	if(file == NULL) return;
+	TEST_CHECK_EQ(fwrite(capture, 1, captureLength, file), captureLength);
+	fclose(file);
+}
+
+/******************************************************************************
+* Tests
+******************************************************************************/
+
+//The firmware, with the recorder initialized as main21.c does, then the scheduler running TzCtrl
+static void Boot(void)
+{
+	memset(tasks, 0, sizeof(tasks));
+	HostConsoleReset();
+	vTraceEnable(TRC_INIT);
+	HostConsoleSetRaw(true);
+	HostRtosSetWait(Wait);
+
+	CreateTask(TASK_TZCTRL, "TzCtrl", TRC_CFG_CTRL_TASK_PRIORITY, 90);
+	CreateTask(TASK_CLI, "CLI_TASK", 4, 180);
+	CreateTask(TASK_WIFI, "WIFI_TASK", 3, 240);
+	CreateTask(TASK_UI, "UI Task", 2, 120);
+	CreateTask(TASK_CONTROL, "Control Task", 4, 150);
+	CreateTask(TASK_IMU, "IMU Task", IMU_ACQ_TASK_PRIORITY, 70);
+	CreateTask(TASK_IDLE, "IDLE", 0, 40);
+	int1Isr = xTraceSetISRProperties("INT1", 1);
+	stormIsr = xTraceSetISRProperties("EIC storm", 1);
+	publishChannel = xTraceRegisterString("MQTT");
+
+	tasks[TASK_WIFI] = (struct Task){ .tcb = tasks[TASK_WIFI].tcb, .periodTicks = WIFI_TASK_PERIOD_MS, .runUs = 400,
+		.burstEvery = TELEMETRY_BATCH_WINDOW_MS / WIFI_TASK_PERIOD_MS };
+	tasks[TASK_CONTROL] = (struct Task){ .tcb = tasks[TASK_CONTROL].tcb, .periodTicks = CONTROL_TELEMETRY_PERIOD_MS, .runUs = 200 };
+	tasks[TASK_IMU] = (struct Task){ .tcb = tasks[TASK_IMU].tcb, .periodTicks = IMU_ACQ_POLL_MS, .notifyWait = true, .runUs = 150 };
+	tasks[TASK_IDLE].ready = true;
+	tasks[TASK_TZCTRL].ready = true;
+	for(int i = 0; i < TASK_COUNT; i++)
+	{
+		tasks[i].blocked = tasks[i].periodTicks != 0;
+		tasks[i].wakeTick = hostTickCount + tasks[i].periodTicks;
+	}
+
+	kernelTick = hostTickCount;
+	nextTickNs = (uint64_t)(hostTickCount + 1) * NS_PER_TICK;
+	nextInt1Ns = HostConsoleNowNs() + 7000000ULL;
+	nextStormNs = UINT64_MAX;
+	running = &tasks[TASK_IDLE];
+	SwitchIn(&tasks[TASK_TZCTRL]);
+}
+
+static void TestFirstSession(const char *program)
+{
+	StartSession(NULL, 0);
+	uint32_t bytesBefore = HostConsoleGetStats()->typed;
+	RunTzCtrl(SESSION_MS);
+	StopSession();
+	TEST_CHECK_EQ(HostConsoleGetStats()->typed - bytesBefore, 8);
+	Save(program);
+
+	struct Capture c = Decode();
+	TEST_CHECK(c.header);
+	TEST_CHECK_EQ(c.session, 0);
+	TEST_CHECK(!c.backwards);
+	TEST_CHECK_EQ(c.gaps, 0);
+	TEST_CHECK_EQ(DroppedEventCounter, 0);
+	TEST_CHECK_EQ(c.mismatched, 0);
+	//Everything but the last page, which is never full, is out
+	TEST_CHECK(c.matched > 1000);
+	TEST_CHECK(expectedCount - c.matched <= TRC_CFG_PAGED_EVENT_BUFFER_PAGE_SIZE / 12);
+	TEST_CHECK(c.stackReports > 0);
+
+	//Each publish held the tick back, and the trace shows by how much
+	TEST_CHECK(stalls >= SESSION_MS / TELEMETRY_BATCH_WINDOW_MS);
+	TEST_CHECK_EQ(c.stalls, stalls);
+	TEST_CHECK(maxTickLateNs >= (PUBLISH_SUSPEND_US - 1000) * 1000ULL);
+	TEST_CHECK(labs((long)c.maxTickLate - (long)(maxTickLateNs * TS_HZ / 1000000000ULL)) <= 1);
+	TEST_CHECK_EQ(hostPrimask, 0);
+}
+
+//Stopped, the recorder sends nothing. Restarted after noise on the line, it starts over with a new header
+static void TestRestart(void)
+{
+	static const uint8_t noise[] = { 0x55, 0xAA, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x12, 0x34 };
+
+	captureLength = 0;
+	RunTzCtrl(100);
+	TEST_CHECK_EQ(captureLength, 0);
+
+	StartSession(noise, sizeof(noise));
+	RunTzCtrl(500);
+	StopSession();
+
+	//Only the page being written is still in use, not the one the first session left partly written
+	TEST_CHECK(TotalBytesRemaining >= BUFFER_SIZE - TRC_CFG_PAGED_EVENT_BUFFER_PAGE_SIZE);
+
+	struct Capture c = Decode();
+	TEST_CHECK(c.header);
+	TEST_CHECK_EQ(c.session, 1);
+	TEST_CHECK_EQ(c.gaps, 0);
+	TEST_CHECK_EQ(c.mismatched, 0);
+	TEST_CHECK(c.matched > 100);
+	TEST_CHECK(expectedCount - c.matched <= TRC_CFG_PAGED_EVENT_BUFFER_PAGE_SIZE / 12);
+}
+
+//An interrupt storm overruns the buffer: events are dropped, and the stream still decodes
+static void TestOverload(void)
+{
+	uint32_t dropped = DroppedEventCounter;
+
+	StartSession(NULL, 0);
+	RunTzCtrl(100);
+	nextStormNs = HostConsoleNowNs() + 1000000ULL;
+	stormEndNs = nextStormNs + STORM_MS * 1000000ULL;
+	RunTzCtrl(STORM_MS + 200);
+	StopSession();
+
+	struct Capture c = Decode();
+	TEST_CHECK(c.header);
+	TEST_CHECK(DroppedEventCounter - dropped > 1000);
+	TEST_CHECK_EQ(c.gaps, DroppedEventCounter - dropped);
+	TEST_CHECK_EQ(c.mismatched, 0);
+	TEST_CHECK(!c.backwards);
+	TEST_CHECK(xTraceGetLastError() == NULL);
+	TEST_CHECK(TotalBytesRemaining >= BUFFER_SIZE - TRC_CFG_PAGED_EVENT_BUFFER_PAGE_SIZE);
+}
+
+static void BenchRun(void)
+{
+	uint64_t txBefore = HostConsoleGetStats()->txBusyNs;
+
+	TotalBytesRemaining_LowWaterMark = UINT32_MAX;
+	StartSession(NULL, 0);
+	RunTzCtrl(BENCH_MS);
+	StopSession();
+
+	struct Capture c = Decode();
+	uint64_t txNs = HostConsoleGetStats()->txBusyNs - txBefore;
+	printf("bench: trace of the firmware tasks: %.0f bytes/s, %.1f%% of the UART at %d baud, %.1f events/ms, buffer low-water "
+		"mark %u of %u bytes, %u events dropped, longest tick held %.2f ms\n", captureLength * 1000.0 / (BENCH_MS + DRAIN_MS),
+		txNs / ((BENCH_MS + DRAIN_MS) * 1e4), TRC_CFG_UART_BAUDRATE, c.events / (double)BENCH_MS, TotalBytesRemaining_LowWaterMark,
+		BUFFER_SIZE, c.gaps, c.maxTickLate * 1000.0 / TS_HZ);
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	Boot();
+	TestFirstSession(argv[0]);
+	TestRestart();
+	TestOverload();
+	BenchRun();
+	return TEST_RESULT();
+}
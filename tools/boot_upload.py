@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""Write the main application through the bootloader serial upload (src/SerialUpload).
+
+Start the tool, then reset the board: the bootloader listens for HELLO for
+100 ms after reset at 115200 baud, and stays in upload mode while the
+application is missing. The rest of the session runs at --baud. Rows are sent
+in windows; the bootloader programs a window on COMMIT and answers the rows
+that read back correctly, the others are sent again. The image must be signed
+with image_sign.py: END carries the signature, and the bootloader only
+programs row 0, and so only starts the image, if it is valid.
+
+    image_sign.py sign "ESE516 MAIN FW.bin" FW.BIN
+    boot_upload.py COM4 FW.BIN
+    boot_upload.py COM4 FW.BIN --baud 460800
+    boot_upload.py --simulate tests/build/boot_upload_sim FW.BIN --error-rate 0.05
+
+--simulate runs the whole protocol over a pseudo terminal against
+SerialUpload.c and ImageInstall.c built for the host ("make test" in
+WINC1500_HTTP_DOWNLOADER_EXAMPLE1/tests builds the simulator and runs it),
+which corrupts frames at the given rate. It needs Linux.
+
+Requires pyserial, except with --simulate.
+"""
+
+import argparse
+import os
+import select
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+
+import image_sign
+from host_link import Decoder, encode
+
+BAUDRATE = 115200
+ROW_SIZE = 256
+APP_START = 0x12000
+RESPONSE = 0x80
+CMD_HELLO, CMD_START, CMD_DATA, CMD_COMMIT, CMD_END = 0x01, 0x02, 0x03, 0x04, 0x05
+STATUS_OK = 0x00
+STATUS_NAMES = {0x10: "unknown request", 0x11: "bad argument", 0x12: "no image started",
+                0x13: "rows missing", 0x14: "signature rejected by the bootloader key",
+                0x15: "row 0 could not be written"}
+
+
+class Uploader:
+    def __init__(self, link, timeout=1.0):
+        self.link = link
+        self.timeout = timeout
+        self.decoder = Decoder()
+        self.pending = []
+        self.seq = 0
+        self.resent = 0
+
+    def send(self, ptype, data=b""):
+        self.seq = (self.seq + 1) & 0xFF
+        self.link.write(encode(ptype, self.seq, data))
+        return self.seq
+
+    def answer(self, ptype, seq, timeout):
+        """Returns the data after the status of the answer to seq, or None on timeout."""
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            while self.pending:
+                rtype, rseq, rdata = self.pending.pop(0)
+                if rtype == ptype | RESPONSE and rseq == seq and rdata:
+                    if rdata[0] != STATUS_OK:
+                        raise RuntimeError(STATUS_NAMES.get(rdata[0], "status 0x%02X" % rdata[0]))
+                    return rdata[1:]
+            self.pending += self.decoder.feed(self.link.read(512))
+        return None
+
+    def call(self, ptype, data=b"", timeout=None, retries=3):
+        for _ in range(retries):
+            answer = self.answer(ptype, self.send(ptype, data), timeout or self.timeout)
+            if answer is not None:
+                return answer
+        raise TimeoutError("no answer to request 0x%02X" % ptype)
+
+    def hello(self, baudrate, wait):
+        """Sends HELLO until the bootloader answers, then follows it to the new baud rate."""
+        self.link.baudrate = BAUDRATE
+        deadline = time.time() + wait
+        while time.time() < deadline:
+            answer = self.answer(CMD_HELLO, self.send(CMD_HELLO, struct.pack("<I", baudrate)), 0.05)
+            if answer is not None:
+                row_size, window, max_size = struct.unpack("<HBI", answer[:7])
+                if row_size != ROW_SIZE:
+                    raise RuntimeError("bootloader rows are %d bytes" % row_size)
+                self.link.baudrate = baudrate
+                return window, max_size
+        raise TimeoutError("no bootloader answered in %d s. Reset the board while the tool waits" % wait)
+
+    def upload(self, image, signature, window):
+        rows = len(image) // ROW_SIZE
+        self.call(CMD_START, struct.pack("<I", len(image)))
+
+        # In order: the bootloader hashes the rows it has in sequence, and keeps row 0 until END
+        todo = list(range(rows))
+        stalled = 0
+        while todo:
+            batch = todo[:window]
+            for row in batch:
+                self.send(CMD_DATA, struct.pack("<H", row) + image[row * ROW_SIZE:(row + 1) * ROW_SIZE])
+            answer = self.call(CMD_COMMIT, timeout=2.0)
+            written = set(struct.unpack("<%dH" % (len(answer) // 2), answer))
+            missed = [row for row in batch if row not in written]
+            self.resent += len(missed)
+            todo = todo[len(batch):] + missed
+            stalled = stalled + 1 if len(missed) == len(batch) else 0
+            if stalled > 5:
+                raise RuntimeError("no row was written in 5 windows")
+        self.call(CMD_END, signature, timeout=2.0)
+        return rows
+
+
+class PtyLink:
+    """Slave side of a pseudo terminal, with the part of the pyserial interface Uploader uses.
+
+    The baud rate is only recorded: a pseudo terminal runs at the speed of the processes on it."""
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.baudrate = BAUDRATE
+        tty.setraw(fd)
+
+    def write(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def read(self, size):
+        if not select.select([self.fd], [], [], 0.01)[0]:
+            return b""
+        return os.read(self.fd, size)
+
+
+def simulate(image, signature, opts):
+    """Uploads to the bootloader code itself, built for the host (tests/boot_upload_sim.c), on a pseudo terminal.
+
+    The simulator corrupts frames at --error-rate and writes its flash to a file when it stops: once END installs
+    the image, or when the line closes. Returns 0 if the outcome is the one expected."""
+    master, slave = os.openpty()
+    with tempfile.TemporaryDirectory() as tmp:
+        dump = os.path.join(tmp, "flash.bin")
+        target = subprocess.Popen([opts.simulate, "--error-rate", str(opts.error_rate), dump], stdin=master, stdout=master)
+        os.close(master)
+        link = PtyLink(slave)
+        uploader = Uploader(link, timeout=0.2)
+        refused = None
+        started = time.time()
+        try:
+            window, _ = uploader.hello(opts.baud, 2)
+            rows = uploader.upload(image, signature, min(window, opts.window))
+        except RuntimeError as error:
+            refused = str(error)
+        elapsed = time.time() - started
+        os.close(slave)
+        try:
+            status = target.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            target.kill()
+            status = None
+        flash = b""
+        if os.path.exists(dump):
+            with open(dump, "rb") as f:
+                flash = f.read()
+
+    if opts.expect_refusal:
+        # The simulator exits with 2 when it is left without a bootable application
+        ok = refused is not None and status == 2
+        print("Simulated bootloader %s the image%s" % ("refused" if refused else "ACCEPTED",
+                                                        ": %s" % refused if refused else ""))
+        return 0 if ok else 1
+
+    if refused is not None:
+        print("Simulated bootloader refused the image: %s" % refused)
+        return 1
+    ok = status == 0 and flash[APP_START:APP_START + len(image)] == image
+    print("Simulated %d rows in %.2f s: %d rows sent again, flash %s" %
+          (rows, elapsed, uploader.resent, "matches" if ok else "DIFFERS"))
+    return 0 if ok else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--simulate", metavar="SIM", help="upload to the bootloader built for the host, "
+                        "tests/build/boot_upload_sim, on a pty")
+    parser.add_argument("--expect-refusal", action="store_true", help="with --simulate, succeed only if the "
+                        "bootloader refuses the image and is left without an application")
+    parser.add_argument("--baud", type=int, default=921600, help="baud rate after HELLO")
+    parser.add_argument("--window", type=int, default=16, help="rows per COMMIT, at most what the bootloader allows")
+    parser.add_argument("--wait", type=int, default=30, help="seconds to wait for the bootloader")
+    parser.add_argument("--error-rate", type=float, default=0.02, help="share of frames the simulator corrupts")
+    parser.add_argument("args", nargs="+", metavar="PORT IMAGE | IMAGE")
+    opts = parser.parse_args()
+
+    if len(opts.args) != (1 if opts.simulate else 2):
+        parser.error("expected a serial port and an image, or --simulate and an image")
+    with open(opts.args[-1], "rb") as f:
+        try:
+            image, signature = image_sign.split_signed(f.read())
+        except ValueError as error:
+            print("%s: %s. Sign it with image_sign.py first" % (opts.args[-1], error))
+            return 1
+    if opts.simulate:
+        return simulate(image, signature, opts)
+
+    import serial
+
+    with serial.Serial(opts.args[0], BAUDRATE, timeout=0.01) as link:
+        uploader = Uploader(link)
+        print("Waiting for the bootloader, reset the board")
+        window, max_size = uploader.hello(opts.baud, opts.wait)
+        if len(image) > max_size:
+            print("Image of %d bytes does not fit in %d bytes" % (len(image), max_size))
+            return 1
+        started = time.time()
+        rows = uploader.upload(image, signature, min(window, opts.window))
+        elapsed = time.time() - started
+    print("%d bytes (%d rows) in %.1f s, %.0f B/s, %d rows sent again" %
+          (len(image), rows, elapsed, len(image) / elapsed, uploader.resent))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Send a script of CLI commands to the console and check nothing was lost.
+
+The console runs at 115200 8N1 and pauses the host with XON/XOFF while its RX
+buffer is nearly full. Every line of the script is sent at full speed, then the
+"console" command is run to read the RX counters. The script passes if the
+console received every character and dropped none. Commands missing from the
+echo are reported too: the TX ring overwrites old text when commands print
+faster than 115200 baud, so they do not fail the script.
+
+    cli_script.py COM4 commands.txt
+    cli_script.py COM4 --repeat 200 "getdistance"
+
+Requires pyserial.
+"""
+
+import argparse
+import re
+import sys
+import time
+
+BAUDRATE = 115200
+STATS = re.compile(rb"RX (\d+) dropped (\d+) xoff (\d+)")
+
+
+def read_stats(link):
+    link.write(b"console\r\n")
+    data = b""
+    deadline = time.time() + 2
+    while time.time() < deadline:
+        data += link.read(256)
+        match = STATS.search(data)
+        if match:
+            return tuple(int(v) for v in match.groups())
+    raise RuntimeError("no answer to the console command")
+
+
+def drain(link, quiet):
+    """Reads until the console has been silent for quiet seconds."""
+    data = b""
+    last = time.time()
+    while time.time() - last < quiet:
+        chunk = link.read(4096)
+        if chunk:
+            data += chunk
+            last = time.time()
+    return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("script", help="file with one command per line, or a command when --repeat is given")
+    parser.add_argument("--repeat", type=int, default=0, help="send the command given as script this many times")
+    parser.add_argument("--quiet", type=float, default=1.0, help="seconds of silence that end the script output")
+    opts = parser.parse_args()
+
+    if opts.repeat:
+        lines = [opts.script] * opts.repeat
+    else:
+        with open(opts.script) as f:
+            lines = [line.strip() for line in f if line.strip()]
+    payload = "".join(line + "\r\n" for line in lines).encode("ascii")
+
+    with serial_port(opts.port) as link:
+        drain(link, 0.2)
+        before = read_stats(link)
+        drain(link, 0.2)
+
+        started = time.time()
+        link.write(payload)
+        link.flush()
+        output = drain(link, opts.quiet)
+        elapsed = time.time() - started
+
+        after = read_stats(link)
+
+    received = after[0] - before[0] - len(b"console\r\n")
+    dropped = after[1] - before[1]
+    pauses = after[2] - before[2]
+
+    # The echo of each command is followed by the line separator written by the CLI
+    missing = 0
+    position = 0
+    for line in lines:
+        found = output.find(line.encode("ascii") + b"\r\n", position)
+        if found < 0:
+            missing += 1
+        else:
+            position = found + len(line)
+
+    print("Sent %d bytes in %d lines, %.1f s" % (len(payload), len(lines), elapsed))
+    print("Console received %d, dropped %d, paused %d times" % (received, dropped, pauses))
+    print("Commands not echoed: %d" % missing)
+    return 0 if received == len(payload) and dropped == 0 else 1
+
+
+def serial_port(port):
+    import serial
+
+    return serial.Serial(port, BAUDRATE, timeout=0.05, xonxoff=True)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+"""Host side of the binary protocol on the console UART (src/HostLink).
+
+Packets are SLIP framed with XON/XOFF escaped too, so the console keeps its
+software flow control. See HostLink.h for the packet layout.
+
+    host_link.py COM4 ping
+    host_link.py COM4 cli "top"
+    host_link.py COM4 get LOG.TXT log.txt
+    host_link.py COM4 put fw.bin TESTFW.BIN
+    host_link.py COM4 stream imu.csv --seconds 10
+    host_link.py COM4 bench
+
+Requires pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+BAUDRATE = 115200
+
+END, ESC = 0xC0, 0xDB
+ESCAPES = {0xC0: 0xDC, 0xDB: 0xDD, 0x11: 0xDE, 0x13: 0xDF}
+UNESCAPES = {v: k for k, v in ESCAPES.items()}
+
+MAX_DATA = 208
+RESPONSE = 0x80
+CMD_PING, CMD_CLI, CMD_BULK = 0x01, 0x02, 0x03
+CMD_STREAM = 0x10
+CMD_FILE_OPEN, CMD_FILE_READ, CMD_FILE_WRITE, CMD_FILE_CLOSE = 0x20, 0x21, 0x22, 0x23
+EVENT_IMU = 0x90
+FILE_READ, FILE_WRITE = 0, 1
+
+STATUS_OK, STATUS_MORE = 0x00, 0x01
+STATUS_NAMES = {0x10: "unknown request", 0x11: "bad argument", 0x12: "SD card busy or not mounted",
+                0x13: "no file open", 0x14: "file system error"}
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def encode(ptype, seq, data=b""):
+    packet = bytes([ptype, seq]) + bytes(data)
+    packet += struct.pack("<H", crc16(packet))
+    frame = bytearray([END])
+    for byte in packet:
+        if byte in ESCAPES:
+            frame += bytes([ESC, ESCAPES[byte]])
+        else:
+            frame.append(byte)
+    frame.append(END)
+    return bytes(frame)
+
+
+class Decoder:
+    """Splits the console output into packets. Text outside frames is kept apart."""
+
+    def __init__(self):
+        self.packet = None
+        self.escape = False
+        self.text = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data):
+        packets = []
+        for byte in data:
+            if byte == END:
+                if self.packet:
+                    packet = bytes(self.packet)
+                    if len(packet) >= 4 and crc16(packet[:-2]) == struct.unpack_from("<H", packet, len(packet) - 2)[0]:
+                        packets.append((packet[0], packet[1], packet[2:-2]))
+                    else:
+                        self.crc_errors += 1
+                    self.packet = None
+                else:
+                    self.packet = bytearray()
+                self.escape = False
+            elif self.packet is None:
+                self.text.append(byte)
+            elif byte == ESC:
+                self.escape = True
+            else:
+                if self.escape:
+                    byte = UNESCAPES.get(byte, byte)
+                    self.escape = False
+                self.packet.append(byte)
+        return packets
+
+
+class HostLink:
+    def __init__(self, port, timeout=1.0):
+        import serial
+
+        self.link = serial.Serial(port, BAUDRATE, timeout=0.02, xonxoff=True)
+        self.timeout = timeout
+        self.decoder = Decoder()
+        self.pending = []
+        self.seq = 0
+        self.events = []
+
+    def close(self):
+        self.link.close()
+
+    def receive(self, timeout):
+        """Returns the next packet, or None on timeout. IMU events are queued in self.events."""
+        deadline = time.time() + timeout
+        while True:
+            while self.pending:
+                packet = self.pending.pop(0)
+                if packet[0] == EVENT_IMU:
+                    self.events.append(packet)
+                else:
+                    return packet
+            if time.time() > deadline:
+                return None
+            self.pending += self.decoder.feed(self.link.read(4096))
+
+    def request(self, ptype, data=b"", retries=3):
+        """Sends a request and yields the data of every answer until the last one."""
+        self.seq = (self.seq + 1) & 0xFF
+        answered = False
+        for _ in range(retries):
+            self.link.write(encode(ptype, self.seq, data))
+            while True:
+                packet = self.receive(self.timeout)
+                if packet is None:
+                    break
+                rtype, rseq, rdata = packet
+                if rtype != ptype | RESPONSE or rseq != self.seq:
+                    continue
+                status = rdata[0]
+                if status not in (STATUS_OK, STATUS_MORE):
+                    extra = " (FRESULT %d)" % rdata[1] if len(rdata) > 1 else ""
+                    raise RuntimeError(STATUS_NAMES.get(status, "status 0x%02X" % status) + extra)
+                answered = True
+                yield rdata[1:]
+                if status == STATUS_OK:
+                    return
+            if answered:
+                break  # A partly answered request cannot be repeated
+        raise TimeoutError("no answer to request 0x%02X" % ptype)
+
+    def call(self, ptype, data=b""):
+        return b"".join(self.request(ptype, data))
+
+
+def cmd_ping(link, opts):
+    payload = bytes(range(32))
+    started = time.time()
+    answer = link.call(CMD_PING, payload)
+    print("%s in %.1f ms" % ("OK" if answer == payload else "MISMATCH", (time.time() - started) * 1000))
+
+
+def cmd_cli(link, opts):
+    for chunk in link.request(CMD_CLI, opts.command.encode("ascii")):
+        sys.stdout.write(chunk.decode("ascii", "replace"))
+
+
+def cmd_get(link, opts):
+    size = struct.unpack("<I", link.call(CMD_FILE_OPEN, bytes([FILE_READ]) + opts.remote.encode("ascii")))[0]
+    offset = 0
+    started = time.time()
+    with open(opts.local, "wb") as out:
+        while offset < size:
+            chunk = link.call(CMD_FILE_READ, struct.pack("<IB", offset, MAX_DATA - 1))
+            if not chunk:
+                break
+            out.write(chunk)
+            offset += len(chunk)
+    link.call(CMD_FILE_CLOSE)
+    print("%d bytes in %.1f s" % (offset, time.time() - started))
+
+
+def cmd_put(link, opts):
+    with open(opts.local, "rb") as f:
+        data = f.read()
+    link.call(CMD_FILE_OPEN, bytes([FILE_WRITE]) + opts.remote.encode("ascii"))
+    started = time.time()
+    step = MAX_DATA - 4
+    for offset in range(0, len(data), step):
+        link.call(CMD_FILE_WRITE, struct.pack("<I", offset) + data[offset:offset + step])
+    link.call(CMD_FILE_CLOSE)
+    print("%d bytes in %.1f s" % (len(data), time.time() - started))
+
+
+def cmd_stream(link, opts):
+    link.call(CMD_STREAM, b"\x01")
+    samples = lost = 0
+    expected = None
+    started = time.time()
+    with open(opts.csv, "w") as out:
+        out.write("sequence,gx,gy,gz,ax,ay,az\n")
+        try:
+            while time.time() - started < opts.seconds:
+                link.receive(0.1)
+                for _, _, data in link.events:
+                    tick, sequence, period_us, count, flags = struct.unpack_from("<IIHBB", data)
+                    if expected is not None and sequence != expected:
+                        lost += sequence - expected
+                    expected = sequence + count
+                    for i in range(count):
+                        values = struct.unpack_from("<6h", data, 12 + 12 * i)
+                        out.write("%d,%s\n" % (sequence + i, ",".join(str(v) for v in values)))
+                    samples += count
+                link.events = []
+        except KeyboardInterrupt:
+            pass
+        finally:
+            link.call(CMD_STREAM, b"\x00")
+    elapsed = time.time() - started
+    print("%d samples in %.1f s (%.0f/s), %d lost" % (samples, elapsed, samples / elapsed, lost))
+
+
+def cmd_bench(link, opts):
+    count = opts.frames
+    received = 0
+    started = time.time()
+    for n, chunk in enumerate(link.request(CMD_BULK, struct.pack("<H", count))):
+        if chunk != bytes((n + i) & 0xFF for i in range(1, MAX_DATA)):
+            raise RuntimeError("bad filler in frame %d" % n)
+        received += len(chunk)
+    binary = received / (time.time() - started)
+
+    # Same amount of output through the text CLI, as a terminal user would get it
+    text = 0
+    started = time.time()
+    while text < received:
+        link.link.write(b"pools\r\n")
+        text += len(drain_text(link, 0.3))
+    text_rate = text / (time.time() - started)
+
+    print("binary: %d payload bytes, %.0f B/s (%.0f%% of the line rate)" % (received, binary, binary * 1000 / BAUDRATE))
+    print("text:   %d output bytes, %.0f B/s" % (text, text_rate))
+
+
+def drain_text(link, quiet):
+    """Returns the console text until it has been silent for quiet seconds."""
+    link.decoder.text = bytearray()
+    last = time.time()
+    while time.time() - last < quiet:
+        data = link.link.read(4096)
+        if data:
+            link.pending += link.decoder.feed(data)
+            last = time.time()
+    return bytes(link.decoder.text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    sub = parser.add_subparsers(dest="action", required=True)
+    sub.add_parser("ping")
+    p = sub.add_parser("cli")
+    p.add_argument("command")
+    p = sub.add_parser("get")
+    p.add_argument("remote", help="8.3 name on the SD card")
+    p.add_argument("local")
+    p = sub.add_parser("put")
+    p.add_argument("local")
+    p.add_argument("remote", help="8.3 name on the SD card")
+    p = sub.add_parser("stream")
+    p.add_argument("csv")
+    p.add_argument("--seconds", type=float, default=10)
+    p = sub.add_parser("bench")
+    p.add_argument("--frames", type=int, default=100)
+    opts = parser.parse_args()
+
+    link = HostLink(opts.port)
+    try:
+        globals()["cmd_" + opts.action](link, opts)
+    finally:
+        link.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
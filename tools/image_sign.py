@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""Sign application images for the bootloader (src/ImageInstall).
+
+The bootloader only installs images signed with the private key that matches
+the public key built into it (src/ImageInstall/ImageKey.h). A signed image is
+the binary padded with 0xFF to whole 256-byte rows, followed by a trailer:
+
+    "SIG1" | image size (4, little endian) | Ed25519 signature (64)
+
+The signature covers the SHA-256 digest of the padded image, so the
+bootloader hashes the rows as it writes them and checks the signature once.
+
+    image_sign.py keygen release.key --header ImageKey.h
+    image_sign.py sign --key release.key "ESE516 MAIN FW.bin" FW.BIN
+    image_sign.py verify --key release.key FW.BIN
+    image_sign.py vectors
+    image_sign.py vectors --c
+
+Without --key the development key is used. Its private half is the first test
+vector of RFC 8032, so anyone can sign with it: generate a key of your own
+before shipping. "vectors" checks this file against the RFC 8032 and FIPS
+180-4 test vectors and prints them, for comparison with the benchmark output
+of the bootloader. With --c it prints the extra vectors of the host test
+(tests/test_image_crypto.c) as C initializers instead.
+
+Needs only the Python standard library.
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+ROW_SIZE = 256
+MAGIC = b"SIG1"
+TRAILER_SIZE = 4 + 4 + 64
+
+# Development key: RFC 8032 section 7.1, test 1
+DEV_SECRET = bytes.fromhex("9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60")
+
+# Ed25519 (RFC 8032 section 5.1), straight from the specification. Slow but only signs one digest.
+P = 2 ** 255 - 19
+L = 2 ** 252 + 27742317777372353535851937790883648493
+D = -121665 * pow(121666, P - 2, P) % P
+SQRT_M1 = pow(2, (P - 1) // 4, P)
+
+
+def point_add(p, q):
+    x1, y1, z1, t1 = p
+    x2, y2, z2, t2 = q
+    a = (y1 - x1) * (y2 - x2) % P
+    b = (y1 + x1) * (y2 + x2) % P
+    c = 2 * t1 * t2 * D % P
+    d = 2 * z1 * z2 % P
+    e, f, g, h = b - a, d - c, d + c, b + a
+    return e * f % P, g * h % P, f * g % P, e * h % P
+
+
+def point_mul(s, p):
+    q = (0, 1, 1, 0)
+    while s > 0:
+        if s & 1:
+            q = point_add(q, p)
+        p = point_add(p, p)
+        s >>= 1
+    return q
+
+
+def point_encode(p):
+    x, y, z, _ = p
+    zi = pow(z, P - 2, P)
+    x, y = x * zi % P, y * zi % P
+    return int.to_bytes(y | ((x & 1) << 255), 32, "little")
+
+
+def point_decode(s):
+    y = int.from_bytes(s, "little")
+    sign = y >> 255
+    y &= (1 << 255) - 1
+    if y >= P:
+        return None
+    x2 = (y * y - 1) * pow(D * y * y + 1, P - 2, P) % P
+    x = pow(x2, (P + 3) // 8, P)
+    if (x * x - x2) % P != 0:
+        x = x * SQRT_M1 % P
+    if (x * x - x2) % P != 0 or (x == 0 and sign):
+        return None
+    if x & 1 != sign:
+        x = P - x
+    return x, y, 1, x * y % P
+
+
+G_Y = 4 * pow(5, P - 2, P) % P
+BASE = point_decode(int.to_bytes(G_Y, 32, "little"))
+
+
+def sha512_int(data):
+    return int.from_bytes(hashlib.sha512(data).digest(), "little")
+
+
+def secret_expand(secret):
+    h = hashlib.sha512(secret).digest()
+    a = int.from_bytes(h[:32], "little")
+    a &= (1 << 254) - 8
+    a |= 1 << 254
+    return a, h[32:]
+
+
+def public_key(secret):
+    return point_encode(point_mul(secret_expand(secret)[0], BASE))
+
+
+def sign(secret, message):
+    a, prefix = secret_expand(secret)
+    public = point_encode(point_mul(a, BASE))
+    r = sha512_int(prefix + message) % L
+    rs = point_encode(point_mul(r, BASE))
+    k = sha512_int(rs + public + message) % L
+    return rs + int.to_bytes((r + k * a) % L, 32, "little")
+
+
+def verify(public, message, signature):
+    a = point_decode(public)
+    s = int.from_bytes(signature[32:], "little")
+    if a is None or s >= L:
+        return False
+    k = sha512_int(signature[:32] + public + message) % L
+    # [S]B - [k]A == R, compared encoded like the bootloader does
+    neg_a = (P - a[0], a[1], a[2], P - a[3])
+    return point_encode(point_add(point_mul(s, BASE), point_mul(k, neg_a))) == signature[:32]
+
+
+def pad_image(data):
+    """Pads the image with 0xFF to whole rows, as it ends up in the flash."""
+    return data + b"\xff" * (-len(data) % ROW_SIZE)
+
+
+def sign_image(secret, image):
+    image = pad_image(image)
+    signature = sign(secret, hashlib.sha256(image).digest())
+    return image + MAGIC + struct.pack("<I", len(image)) + signature
+
+
+def split_signed(data):
+    """Returns (image, signature) of a signed file, or raises ValueError."""
+    if len(data) < TRAILER_SIZE or data[-TRAILER_SIZE:-TRAILER_SIZE + 4] != MAGIC:
+        raise ValueError("no signature trailer")
+    size = struct.unpack("<I", data[-TRAILER_SIZE + 4:-TRAILER_SIZE + 8])[0]
+    if size != len(data) - TRAILER_SIZE or size % ROW_SIZE:
+        raise ValueError("trailer size %d does not match the file" % size)
+    return data[:size], data[-64:]
+
+
+def load_secret(path):
+    if path is None:
+        print("warning: signing with the public development key", file=sys.stderr)
+        return DEV_SECRET
+    with open(path, "rb") as f:
+        secret = bytes.fromhex(f.read().decode().strip())
+    if len(secret) != 32:
+        raise ValueError("%s does not hold a 32 byte key in hex" % path)
+    return secret
+
+
+def c_header(public):
+    rows = ["\t" + ", ".join("0x%02x" % b for b in public[i:i + 8]) for i in range(0, 32, 8)]
+    return ("static const uint8_t imageVerifyPublicKey[ED25519_PUBLIC_KEY_SIZE] = {\n" +
+            ",\n".join(rows) + "\n};\n")
+
+
+# RFC 8032 section 7.1 tests 1 to 3: secret, public key, message, signature
+RFC8032_VECTORS = [
+    ("9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60",
+     "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a", "",
+     "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46b"
+     "d25bf5f0595bbe24655141438e7a100b"),
+    ("4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb",
+     "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c", "72",
+     "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da085ac1e43e15996e458f3613d0f11d8c"
+     "387b2eaeb4302aeeb00d291612bb0c00"),
+    ("c5aa8df43f9f837bedb7442f31dcb7b166d38535076f094b85ce3a2e0b4458f7",
+     "fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025", "af82",
+     "6291d657deec24024827e69c3abe01a30ce548a284743a445e3680d7db5ac3ac18ff9b538d16f290ae67f760984dc659"
+     "4a7c15e9716ed28dc027beceea1ec40a"),
+]
+
+# FIPS 180-4 examples
+SHA256_VECTORS = [
+    (b"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"),
+    (b"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"),
+]
+
+# Extra vectors for the host test: message lengths around the SHA-512 and SHA-256 block boundaries. The message of
+# length n is the bytes (7 * i + n) & 0xFF, signed with the key SHA-256("test key n").
+C_ED25519_LENGTHS = (0, 1, 32, 47, 48, 63, 64, 111, 112, 127, 128, 200, 255)
+C_SHA256_LENGTHS = (55, 56, 63, 64, 65, 119, 120, 128, 1000)
+
+
+def test_message(n):
+    return bytes((7 * i + n) & 0xFF for i in range(n))
+
+
+def c_vectors():
+    lines = ["//Generated by tools/image_sign.py vectors --c: length, public key, signature",
+             "static const Ed25519Vector ed25519Vectors[] = {"]
+    for n in C_ED25519_LENGTHS:
+        secret = hashlib.sha256(b"test key %d" % n).digest()
+        public, signature = public_key(secret), sign(secret, test_message(n))
+        assert verify(public, test_message(n), signature)
+        lines.append('\t{%d, "%s",\n\t\t"%s"\n\t\t"%s"},' % (n, public.hex(), signature[:32].hex(), signature[32:].hex()))
+    lines += ["};", "", "//Generated by tools/image_sign.py vectors --c: length, SHA-256", "static const Sha256Vector sha256Vectors[] = {"]
+    for n in C_SHA256_LENGTHS:
+        lines.append('\t{%d, "%s"},' % (n, hashlib.sha256(test_message(n)).hexdigest()))
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def check_vectors():
+    ok = True
+    for secret, public, message, signature in RFC8032_VECTORS:
+        secret, public, message, signature = map(bytes.fromhex, (secret, public, message, signature))
+        good = (public_key(secret) == public and sign(secret, message) == signature and
+                verify(public, message, signature) and
+                not verify(public, message + b"\x00", signature))
+        ok &= good
+        print("Ed25519 msg=%-4s %s" % (message.hex() or "''", "ok" if good else "FAILED"))
+    for message, digest in SHA256_VECTORS:
+        good = hashlib.sha256(message).hexdigest() == digest
+        ok &= good
+        print("SHA-256 %s... %s %s" % (message[:8].decode(), digest, "ok" if good else "FAILED"))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("keygen", help="create a signing key")
+    p.add_argument("keyfile")
+    p.add_argument("--header", help="also write the public key as a C array for ImageKey.h")
+    p = sub.add_parser("sign", help="append the signature trailer to an image")
+    p.add_argument("--key", help="private key file from keygen, default the development key")
+    p.add_argument("image")
+    p.add_argument("output")
+    p = sub.add_parser("verify", help="check a signed image")
+    p.add_argument("--key", help="private key file from keygen, default the development key")
+    p.add_argument("signed")
+    p = sub.add_parser("vectors", help="check and print the test vectors")
+    p.add_argument("--c", action="store_true", help="print the vectors of the host test as C initializers")
+    opts = parser.parse_args()
+
+    if opts.command == "keygen":
+        secret = os.urandom(32)
+        with open(opts.keyfile, "w") as f:
+            f.write(secret.hex() + "\n")
+        os.chmod(opts.keyfile, 0o600)
+        public = public_key(secret)
+        print("Public key %s" % public.hex())
+        if opts.header:
+            with open(opts.header, "w") as f:
+                f.write(c_header(public))
+            print("Paste %s into src/ImageInstall/ImageKey.h" % opts.header)
+    elif opts.command == "sign":
+        with open(opts.image, "rb") as f:
+            image = f.read()
+        signed = sign_image(load_secret(opts.key), image)
+        with open(opts.output, "wb") as f:
+            f.write(signed)
+        print("%s: %d bytes, %d rows, SHA-256 %s" % (opts.output, len(signed), (len(signed) - TRAILER_SIZE) // ROW_SIZE,
+                                                    hashlib.sha256(signed[:-TRAILER_SIZE]).hexdigest()))
+    elif opts.command == "verify":
+        with open(opts.signed, "rb") as f:
+            image, signature = split_signed(f.read())
+        good = verify(public_key(load_secret(opts.key)), hashlib.sha256(image).digest(), signature)
+        print("Signature %s" % ("valid" if good else "INVALID"))
+        return 0 if good else 1
+    elif opts.c:
+        print(c_vectors())
+    else:
+        return 0 if check_vectors() else 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
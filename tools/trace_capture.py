@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Capture a Tracealyzer stream from the trace UART into a .psf file.
+
+The firmware runs the recorder in streaming mode over SERCOM3 (EXT1 pins 9/10,
+921600 8N1, see streamports/UART). Tracing starts when this tool sends the
+start command and stops when it is interrupted with Ctrl-C. Open the .psf file
+in Tracealyzer with File > Open.
+
+    trace_capture.py COM5 session.psf
+    trace_capture.py --check session.psf
+
+Requires pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+BAUDRATE = 921600
+CMD_SET_ACTIVE = 1
+PSF_MAGIC = b"\x00\x46\x53\x50"  # 0x50534600, little endian
+PSF_HEADER = struct.Struct("<IHH")  # magic, version, platform
+
+
+def command(code, param1=0):
+    """Builds an 8 byte Tracealyzer command with its checksum."""
+    body = bytes([code, param1, 0, 0, 0, 0])
+    checksum = 0xFFFF - sum(body)
+    return body + struct.pack("<H", checksum)
+
+
+def parse_header(data):
+    """Returns (version, platform) of a PSF stream, or None if it is not one."""
+    if len(data) < PSF_HEADER.size:
+        return None
+    magic, version, platform = PSF_HEADER.unpack_from(data)
+    if magic != 0x50534600:
+        return None
+    return version, platform
+
+
+def check(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    header = parse_header(data)
+    if header is None:
+        print("%s: not a PSF stream" % path)
+        return 1
+    print("%s: PSF version %d, platform 0x%04X, %d bytes" % (path, header[0], header[1], len(data)))
+    return 0
+
+
+def capture(port, path, timeout):
+    import serial
+
+    with serial.Serial(port, BAUDRATE, timeout=0.1) as link, open(path, "wb") as out:
+        link.reset_input_buffer()
+        link.write(command(CMD_SET_ACTIVE, 1))
+
+        # Anything sent before the start command was processed is dropped
+        pending = b""
+        deadline = time.time() + timeout
+        while True:
+            pending += link.read(256)
+            start = pending.find(PSF_MAGIC)
+            if start >= 0:
+                pending = pending[start:]
+                break
+            pending = pending[-(len(PSF_MAGIC) - 1):]
+            if time.time() > deadline:
+                link.write(command(CMD_SET_ACTIVE, 0))
+                print("No trace stream on %s after %d s" % (port, timeout))
+                return 1
+
+        out.write(pending)
+        total = len(pending)
+        started = last = time.time()
+        print("Capturing to %s, Ctrl-C to stop" % path)
+        try:
+            while True:
+                chunk = link.read(4096)
+                if chunk:
+                    out.write(chunk)
+                    total += len(chunk)
+                now = time.time()
+                if now - last >= 1.0:
+                    last = now
+                    sys.stdout.write("\r%8d bytes, %6.1f kB/s" % (total, total / (now - started) / 1024))
+                    sys.stdout.flush()
+        except KeyboardInterrupt:
+            pass
+        finally:
+            link.write(command(CMD_SET_ACTIVE, 0))
+        print("\n%d bytes in %.1f s" % (total, time.time() - started))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--check", action="store_true", help="only validate the header of an existing .psf file")
+    parser.add_argument("--timeout", type=int, default=5, help="seconds to wait for the stream to start")
+    parser.add_argument("args", nargs="+", metavar="PORT PSF | PSF")
+    opts = parser.parse_args()
+
+    if opts.check:
+        return check(opts.args[0])
+    if len(opts.args) != 2:
+        parser.error("expected a serial port and an output file")
+    return capture(opts.args[0], opts.args[1], opts.timeout)
+
+
+if __name__ == "__main__":
+    sys.exit(main())